@@ -193,6 +193,7 @@ typedef struct _jobpool {
 	uint64_t jobs_time_max[TASK_COUNT];
 	uint64_t jobs_time[TASK_COUNT];
 	uint32_t jobs_count[TASK_COUNT];
+	uint32_t jobs_reactor; // reads served by mainserv reactors
 	uint32_t nextjobid;
 } jobpool;
 
@@ -603,6 +604,7 @@ void* job_pool_new(void* (*worker_fn)(void*)) {
 	for (i=0 ; i<JHASHSIZE ; i++) {
 		jp->jobhash[i]=NULL;
 	}
+	jp->jobs_reactor = 0;
 	jp->nextjobid = 1;
 	job_spawn_worker(jp);
 	zassert(pthread_mutex_unlock(&(jp->jobslock)));
@@ -612,7 +614,7 @@ void* job_pool_new(void* (*worker_fn)(void*)) {
 uint32_t job_pool_jobs_count(jobpool *jp) {
 	uint32_t res;
 	zassert(pthread_mutex_lock(&(jp->jobslock)));
-	res = (jp->workers_total - jp->workers_avail) + queue_elements(jp->jobqueue);
+	res = (jp->workers_total - jp->workers_avail) + queue_elements(jp->jobqueue) + jp->jobs_reactor;
 	zassert(pthread_mutex_unlock(&(jp->jobslock)));
 	return res;
 }
@@ -815,9 +817,85 @@ uint32_t job_write(void (*callback)(uint8_t status,void *extra),void *extra,uint
 }
 */
 
+/* called from reactor thread */
+static void job_reactor_finished(uint8_t status,void *extra) {
+	jobpool* jp = hp_pool;
+	job *jptr = (job*)extra;
+	uint64_t tasktime;
+	uint32_t jobid;
+
+	zassert(pthread_mutex_lock(&(jp->jobslock)));
+	tasktime = (monotonic_useconds()-jptr->starttime);
+	jp->jobs_count[jptr->tasktype & 0x7]++;
+	jp->jobs_time[jptr->tasktype & 0x7] += tasktime;
+	if (tasktime > jp->jobs_time_max[jptr->tasktype & 0x7]) {
+		jp->jobs_time_max[jptr->tasktype & 0x7] = tasktime;
+	}
+	if (tasktime > jp->jobs_time_max_glob[jptr->tasktype & 0x7]) {
+		jp->jobs_time_max_glob[jptr->tasktype & 0x7] = tasktime;
+	}
+	jptr->tasktype |= 0x80;
+	jptr->starttime = 0;
+	jobid = jptr->jobid;
+	jp->jobs_reactor--;
+	zassert(pthread_mutex_unlock(&(jp->jobslock)));
+	job_send_status(jp,jobid,status);
+}
+
+/* read served by one of mainserv reactors - no worker thread is used */
+static inline uint32_t job_reactor_read(void (*callback)(uint8_t status,void *extra),void *extra,int sock,const uint8_t *packet,uint32_t length) {
+	jobpool* jp = hp_pool;
+	uint32_t jobid;
+	uint32_t jhpos;
+	job **jhandle,*jptr;
+
+	jptr = malloc(sizeof(job));
+	passert(jptr);
+
+	zassert(pthread_mutex_lock(&(jp->jobslock)));
+	jobid = jp->nextjobid;
+	jp->nextjobid++;
+	if (jp->nextjobid==0) {
+		jp->nextjobid=1;
+	}
+	jhpos = JHASHPOS(jobid);
+	jptr->jobid = jobid;
+	jptr->callback = callback;
+	jptr->extra = extra;
+	jptr->args = NULL;
+	jptr->jstate = JSTATE_INPROGRESS;
+	jptr->starttime = monotonic_useconds();
+	jptr->chunkid = 0;
+	jptr->tasktype = job_op_to_tasktype(OP_SERV_READ);
+	jptr->next = jp->jobhash[jhpos];
+	jp->jobhash[jhpos] = jptr;
+	jp->jobs_reactor++;
+	zassert(pthread_mutex_unlock(&(jp->jobslock)));
+	if (mainserv_reactor_read(sock,packet,length,job_reactor_finished,jptr)==0) {
+		zassert(pthread_mutex_lock(&(jp->jobslock)));
+		jp->jobs_reactor--;
+		jhandle = jp->jobhash+jhpos;
+		while ((jptr = *jhandle)) {
+			if (jptr->jobid==jobid) {
+				*jhandle = jptr->next;
+				free(jptr);
+				break;
+			} else {
+				jhandle = &(jptr->next);
+			}
+		}
+		zassert(pthread_mutex_unlock(&(jp->jobslock)));
+		return 0;
+	}
+	return jobid;
+}
+
 uint32_t job_serv_read(void (*callback)(uint8_t status,void *extra),void *extra,int sock,const uint8_t *packet,uint32_t length) {
 	jobpool* jp = hp_pool;
 	chunk_rw_args *args;
+	if (mainserv_reactor_enabled()) {
+		return job_reactor_read(callback,extra,sock,packet,length);
+	}
 	args = malloc(sizeof(chunk_rw_args));
 	passert(args);
 	args->sock = sock;
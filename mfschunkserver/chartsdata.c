@@ -54,6 +54,8 @@ void chartsdata_refresh(void) {
 	uint32_t i,opr,opw,dbr,dbw,dopr,dopw,movl,movh,repl;
 	uint32_t op_cr,op_de,op_ve,op_du,op_tr,op_dt,op_te,op_sp;
 	uint32_t jobs;
+	uint32_t wnext50,wnext99,wlocal50,wlocal99;
+	uint32_t bchits,bcmisses;
 	uint64_t scpu,ucpu;
 	uint64_t rss,virt;
 	uint64_t uspace,tspace,tduspace,tdtspace;
@@ -86,6 +88,11 @@ void chartsdata_refresh(void) {
 	data[CHARTS_CSSERVOUT] += bout;
 	data[CHARTS_HLOPR] = opr;
 	data[CHARTS_HLOPW] = opw;
+	mainserv_write_latency(&wnext50,&wnext99,&wlocal50,&wlocal99);
+	data[CHARTS_WNEXT_P50] = wnext50;
+	data[CHARTS_WNEXT_P99] = wnext99;
+	data[CHARTS_WLOCAL_P50] = wlocal50;
+	data[CHARTS_WLOCAL_P99] = wlocal99;
 	hdd_stats(&bin,&bout,&opr,&opw,&dbr,&dbw,&dopr,&dopw,&movl,&movh,data+CHARTS_RTIME,data+CHARTS_WTIME);
 	data[CHARTS_HDRBYTESR] = bin;
 	data[CHARTS_HDRBYTESW] = bout;
@@ -97,6 +104,12 @@ void chartsdata_refresh(void) {
 	data[CHARTS_DATALLOPW] = dopw;
 	data[CHARTS_MOVELS] = movl;
 	data[CHARTS_MOVEHS] = movh;
+	hdd_block_cache_stats(&bchits,&bcmisses);
+	data[CHARTS_BCACHE_HITS] = bchits;
+	data[CHARTS_BCACHE_MISSES] = bcmisses;
+	if (bchits+bcmisses>0) {
+		data[CHARTS_BCACHE_RATIO] = (UINT64_C(100000)*bchits)/(bchits+bcmisses);
+	}
 	replicator_stats(data+CHARTS_CSREPIN,data+CHARTS_CSREPOUT,&repl);
 	data[CHARTS_REPL] = repl;
 	hdd_op_stats(&op_cr,&op_de,&op_ve,&op_du,&op_tr,&op_dt,&op_te,&op_sp);
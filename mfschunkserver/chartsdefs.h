@@ -70,8 +70,15 @@
 #define CHARTS_HDD_MFR 45
 #define CHARTS_HDD_DMG 46
 #define CHARTS_USAGE_DIFF 47
+#define CHARTS_WNEXT_P50 48
+#define CHARTS_WNEXT_P99 49
+#define CHARTS_WLOCAL_P50 50
+#define CHARTS_WLOCAL_P99 51
+#define CHARTS_BCACHE_HITS 52
+#define CHARTS_BCACHE_MISSES 53
+#define CHARTS_BCACHE_RATIO 54
 
-#define CHARTS 48
+#define CHARTS 55
 
 #define STRID(a,b,c,d) (((((uint8_t)a)*256U+(uint8_t)b)*256U+(uint8_t)c)*256U+(uint8_t)d)
 
@@ -125,6 +132,13 @@
 	{"hddmfr"       ,STRID('H','D','M','R'),CHARTS_MODE_MAX,0,CHARTS_SCALE_NONE ,   1,    1}, \
 	{"hdddmg"       ,STRID('H','D','D','M'),CHARTS_MODE_MAX,0,CHARTS_SCALE_NONE ,   1,    1}, \
 	{"udiff"        ,STRID('U','D','I','F'),CHARTS_MODE_MAX,0,CHARTS_SCALE_MILI ,   1,    1}, \
+	{"wnextp50"     ,STRID('W','N','5','0'),CHARTS_MODE_MAX,0,CHARTS_SCALE_MICRO,   1,    1}, \
+	{"wnextp99"     ,STRID('W','N','9','9'),CHARTS_MODE_MAX,0,CHARTS_SCALE_MICRO,   1,    1}, \
+	{"wlocalp50"    ,STRID('W','L','5','0'),CHARTS_MODE_MAX,0,CHARTS_SCALE_MICRO,   1,    1}, \
+	{"wlocalp99"    ,STRID('W','L','9','9'),CHARTS_MODE_MAX,0,CHARTS_SCALE_MICRO,   1,    1}, \
+	{"bchits"       ,STRID('B','C','H','T'),CHARTS_MODE_ADD,0,CHARTS_SCALE_NONE ,   1,    1}, \
+	{"bcmisses"     ,STRID('B','C','M','S'),CHARTS_MODE_ADD,0,CHARTS_SCALE_NONE ,   1,    1}, \
+	{"bchitratio"   ,STRID('B','C','H','R'),CHARTS_MODE_MAX,0,CHARTS_SCALE_MILI ,   1,    1}, \
 	{NULL           ,0                     ,0              ,0,0                 ,   0,    0}  \
 };
 
@@ -42,11 +42,21 @@
 #ifdef HAVE_SYS_MMAN_H
 #include <sys/mman.h>
 #endif
+#if defined(HAVE_LINUX_IO_URING_H) && defined(__linux__)
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && defined(__NR_io_uring_register)
+#define USE_IO_URING 1
+#endif
+#endif
 
 #include "MFSCommunication.h"
 #include "cfg.h"
 #include "datapack.h"
 #include "crc.h"
+#include "hashfn.h"
+#include "ecrs.h"
 #include "main.h"
 #include "masterconn.h"
 #include "mfslog.h"
@@ -96,6 +106,22 @@
 
 #define CHUNKDB_REC_SIZE 23
 
+/* chunk journal (per folder '.chunkjdb' snapshot + '.chunkjournal.N' files) */
+#define CHUNKJDB_HDR_SIZE 12
+#define CHUNKJDB_REC_SIZE 14
+#define CHUNKJOURNAL_HDR_SIZE 16
+#define CHUNKJOURNAL_REC_SIZE 18
+#define CHUNKJOURNAL_PUT 1
+#define CHUNKJOURNAL_DEL 2
+#define CHUNKJOURNAL_MIN_RECORDS 100000
+#define CHUNKJOURNAL_RETRY_DELAY 60.0
+
+/* max number of chunks synced by delayed ops in one pass */
+#define FSYNC_MAX_GROUP 1024
+
+/* max number of blocks read in one io_uring batch */
+#define IO_URING_MAX_DEPTH 64
+
 #define LOCKED_CHUNK_WAIT_USECS 10000000
 
 #define INODE_REDUCE_LOG_FREQ 60.0
@@ -115,6 +141,14 @@
 
 #define RANDOM_CHUNK_RETRIES 50
 
+/* local tiering - chunk heat (number of reads) is halved every TIER_HEAT_HALFLIFE seconds */
+#define TIER_HEAT_HALFLIFE 600
+#define TIER_COLD_SAMPLES 16
+#define TIER_PROMOTE_QUEUE 4096
+#define TIER_ANY 0
+#define TIER_FAST 1
+#define TIER_STD 2
+
 // HASHSIZE / (60 * 1000)
 #define KNOWNBLOCKS_HASH_PER_CYCLE 280
 
@@ -235,6 +269,7 @@ typedef struct chunk {
 	uint16_t pathid;
 	uint16_t hdrsize;
 	uint32_t diskusage;
+	uint32_t jversion;	// version stored in chunk journal (0 - not stored)
 	double opento;
 	double crcto;
 	uint8_t crcchanged;
@@ -244,6 +279,9 @@ typedef struct chunk {
 #define CH_LOCKED 1
 #define CH_DELETED 2
 	uint8_t state;	// CH_AVAIL,CH_LOCKED,CH_DELETED
+	uint16_t jpathid;	// pathid stored in chunk journal
+	uint16_t heat;		// decayed number of reads (local tiering)
+	uint16_t heatstamp;	// heat half-life period of last update
 	cntcond *ccond;
 	uint8_t *crc;
 	int fd;
@@ -256,6 +294,7 @@ typedef struct chunk {
 	uint8_t fileversion;
 	uint8_t validattr;
 	uint8_t testedflag;
+	uint8_t jverify;	// loaded from chunk journal - file name not confirmed yet
 	uint32_t testtime;
 	struct chunk *testnext,**testprev;
 	struct chunk *next;
@@ -275,6 +314,16 @@ typedef struct hddstats {
 	uint64_t nsecfsyncmax;
 } hddstats;
 
+/* fsync request waiting in folder queue */
+typedef struct fsyncreq {
+	const int *fds;
+	int *errs;
+	uint32_t cnt;
+	uint8_t journal;	// chunk journal of the folder has to be synced too
+	uint8_t done;
+	struct fsyncreq *next;
+} fsyncreq;
+
 typedef struct folder {
 	char *path;
 #define SCST_WORKING 0
@@ -306,6 +355,7 @@ typedef struct folder {
 #define REBALANCE_DST 2
 	uint8_t tmpbalancemode;
 	uint8_t ignoresize;
+	uint8_t fasttier;
 	uint8_t scanprogress;
 #define LMODE_NONE 0
 #define LMODE_LIMIT_TOTAL_POS_CONST 1
@@ -344,6 +394,12 @@ typedef struct folder {
 	ino_t lockinode;
 	int lfd;
 	int dumpfd;
+	int jfd;		// current chunk journal (locked by journallock)
+	uint32_t jgen;
+	uint32_t jrecords;
+	uint8_t jdirty;
+	uint8_t jdumpneeded;
+	double jretry;
 	double read_corr;
 	double write_corr;
 	uint32_t read_dist;
@@ -375,6 +431,13 @@ typedef struct folder {
 	double wfrlast;
 	uint32_t wfrcount;
 	waitforremoval *wfrchunks;
+	fsyncreq *fsynchead,**fsynctail;	// fsync group commit (locked by fsynclock)
+	uint32_t fsyncqueued;
+	uint8_t fsyncactive;
+	uint32_t fsyncmaxbatch;
+	uint32_t fsyncpass;	// last hdd_delayed_fsync pass (used only by delayed ops thread)
+	uint64_t fsyncbatches;
+	uint64_t fsyncbatched;
 	struct folder *next;
 } folder;
 
@@ -431,8 +494,17 @@ static uint32_t HDDRoundRobinChunkCount = 10000;
 static uint32_t HDDKeepDuplicatesHours = 7*24;
 static uint64_t LeaveFree;
 static uint8_t DoFsyncBeforeClose = 0;
+static uint32_t FsyncGroupMin = 0;
+static uint8_t UseIOUring = 0;
+static uint32_t IOUringDepth = 16;
+static uint8_t ReadSendfileMode = 0;
+static uint64_t BlockCacheSize = 0;
+static uint32_t TierHighUsage = 90;
+static uint32_t TierLowUsage = 80;
+static uint32_t TierPromoteReads = 16;
 static uint32_t MinTimeBetweenTests = 86400;
 static int32_t MinFlushCacheTime = 86400;
+static uint8_t ChunkJournal = 1;
 
 /* cfg data - locked by folderlock together with folderhead */
 static cfgline *cfglinehead = NULL;
@@ -462,7 +534,7 @@ static uint8_t hddspacechanged = 0;
 static uint8_t hddspacerecalc = 0;
 static uint8_t global_rebalance_is_on = 0;
 
-static pthread_t hsrebalancethread,rebalancethread,foldersthread,delayedthread,testerthread,knowndiskusagethread;
+static pthread_t hsrebalancethread,rebalancethread,tierthread,foldersthread,delayedthread,testerthread,knowndiskusagethread;
 static uint8_t term = 0;
 static uint8_t folderactions = 0;
 static pthread_mutex_t termlock = PTHREAD_MUTEX_INITIALIZER;
@@ -487,13 +559,32 @@ static pthread_mutex_t folderlock = PTHREAD_MUTEX_INITIALIZER;
 // chunk tester
 static pthread_mutex_t testlock = PTHREAD_MUTEX_INITIALIZER;
 
+// chunk journals (jfd,jgen,jrecords,jdirty in folders and jversion,jpathid in chunks) - always taken as the last one
+static pthread_mutex_t journallock = PTHREAD_MUTEX_INITIALIZER;
+
+// fsync queues in folders
+static pthread_mutex_t fsynclock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t fsynccond = PTHREAD_COND_INITIALIZER;
+
 static pthread_cond_t highspeed_cond = PTHREAD_COND_INITIALIZER;
 
+// tiering - promotion queue and counters (tiering options are locked by folderlock)
+static pthread_mutex_t tierlock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t tierpromoteq[TIER_PROMOTE_QUEUE];
+static uint32_t tierpromoteqhead = 0;
+static uint32_t tierpromoteqcnt = 0;
+static uint64_t tierpromotions = 0;
+static uint64_t tierdemotions = 0;
+
 #ifndef PRESERVE_BLOCK
 static pthread_key_t hdrbufferkey;
 static pthread_key_t blockbufferkey;
 #endif
 
+#ifdef USE_IO_URING
+static pthread_key_t uringkey;
+#endif
+
 /*
 static uint8_t wait_for_scan = 0;
 static uint32_t scanprogress;
@@ -1434,6 +1525,149 @@ static inline void hdd_add_chunk_to_folder(chunk *c,folder *f) {
 	}
 }
 
+static inline void hdd_journal_fname(char fname[PATH_MAX],const folder *f,uint32_t gen) {
+	snprintf(fname,PATH_MAX,"%s.chunkjournal.%"PRIu32,f->path,gen);
+	fname[PATH_MAX-1] = 0;
+}
+
+/* removes journal files with generation lower than 'belowgen', returns highest generation of remaining files */
+static uint32_t hdd_journal_cleanup(folder *f,uint32_t belowgen) {
+	DIR *dd;
+	struct dirent *de;
+	char fname[PATH_MAX];
+	char *endp;
+	unsigned long gen;
+	uint32_t maxgen;
+
+	maxgen = 0;
+	dd = opendir(f->path);
+	if (dd==NULL) {
+		return 0;
+	}
+	while ((de = readdir(dd)) != NULL) {
+		if (strncmp(de->d_name,".chunkjournal.",14)!=0 || de->d_name[14]<'0' || de->d_name[14]>'9') {
+			continue;
+		}
+		gen = strtoul(de->d_name+14,&endp,10);
+		if (*endp!='\0' || gen>UINT32_MAX) {
+			continue;
+		}
+		if (gen<belowgen) {
+			hdd_journal_fname(fname,f,gen);
+			unlink(fname);
+		} else if (gen>maxgen) {
+			maxgen = gen;
+		}
+	}
+	closedir(dd);
+	return maxgen;
+}
+
+/* snapshot and journals are useless (or broken) - remove them */
+static void hdd_journal_drop_files(folder *f) {
+	char fname[PATH_MAX];
+
+	snprintf(fname,PATH_MAX,"%s.chunkjdb",f->path);
+	fname[PATH_MAX-1] = 0;
+	unlink(fname);
+	hdd_journal_cleanup(f,UINT32_MAX);
+	f->jgen = 0;
+}
+
+// journallock:locked
+static void hdd_journal_int_write(folder *f,uint8_t type,uint64_t chunkid,uint32_t version,uint16_t pathid) {
+	uint8_t buff[CHUNKJOURNAL_REC_SIZE];
+	uint8_t *wptr;
+
+	wptr = buff;
+	put8bit(&wptr,type);
+	put8bit(&wptr,pathid);
+	put64bit(&wptr,chunkid);
+	put32bit(&wptr,version);
+	put32bit(&wptr,mycrc32(0,buff,CHUNKJOURNAL_REC_SIZE-4));
+	if (write(f->jfd,buff,CHUNKJOURNAL_REC_SIZE)!=CHUNKJOURNAL_REC_SIZE) {
+		mfs_log(MFSLOG_ERRNO_SYSLOG,MFSLOG_WARNING,"disk %s: chunk journal write error - journal dropped (full scan will be needed after crash)",f->path);
+		close(f->jfd);
+		f->jfd = -1;
+		f->jrecords = 0;
+		f->jretry = monotonic_seconds() + CHUNKJOURNAL_RETRY_DELAY;
+		hdd_journal_drop_files(f);
+		return;
+	}
+	f->jrecords++;
+	f->jdirty = 1;
+}
+
+/* called when chunk is released - stores new version/pathid in the journal of its folder */
+static inline void hdd_journal_chunk_update(chunk *c) {
+	if (c->owner==NULL || c->pathid>255 || (c->version==c->jversion && c->pathid==c->jpathid)) {
+		return;
+	}
+	zassert(pthread_mutex_lock(&journallock));
+	if (c->owner->jfd>=0) {
+		hdd_journal_int_write(c->owner,CHUNKJOURNAL_PUT,c->chunkid,c->version,c->pathid);
+	}
+	c->jversion = c->version;
+	c->jpathid = c->pathid;
+	zassert(pthread_mutex_unlock(&journallock));
+}
+
+/* called just before chunk leaves its folder (deleted or moved) */
+static inline void hdd_journal_chunk_remove(chunk *c) {
+	if (c->owner==NULL) {
+		return;
+	}
+	zassert(pthread_mutex_lock(&journallock));
+	if (c->owner->jfd>=0 && c->jversion!=0) {
+		hdd_journal_int_write(c->owner,CHUNKJOURNAL_DEL,c->chunkid,0,0);
+	}
+	c->jversion = 0;
+	c->jpathid = 0xFFFF;
+	zassert(pthread_mutex_unlock(&journallock));
+}
+
+static inline int hdd_check_filename(const char *fname,uint64_t *chunkid,uint32_t *version);
+
+/* renames of chunk files are not synced, so after crash the version of chunk loaded from journal may differ from the one on disk - file with expected name doesn't exist, so look for any file of this chunk in its subfolder and use the newest one */
+// chunk:locked
+static int hdd_chunk_jverify(chunk *c) {
+	char fname[PATH_MAX];
+	char *p;
+	DIR *dd;
+	struct dirent *de;
+	uint64_t namechunkid;
+	uint32_t nameversion,version;
+	uint8_t found;
+
+	c->jverify = 0;
+	hdd_generate_filename(fname,c);
+	p = strrchr(fname,'/');
+	if (c->owner==NULL || p==NULL) {
+		return -1;
+	}
+	*p = '\0';
+	dd = opendir(fname);
+	if (dd==NULL) {
+		return -1;
+	}
+	found = 0;
+	version = 0;
+	while ((de = readdir(dd)) != NULL) {
+		if (hdd_check_filename(de->d_name,&namechunkid,&nameversion)==0 && namechunkid==c->chunkid && (found==0 || nameversion>version)) {
+			version = nameversion;
+			found = 1;
+		}
+	}
+	closedir(dd);
+	if (found==0) {
+		return -1;
+	}
+	mfs_log(MFSLOG_SYSLOG,MFSLOG_NOTICE,"chunk %016"PRIX64": version %08"PRIX32" from chunk journal not found on disk - using version %08"PRIX32,c->chunkid,c->version,version);
+	c->version = version;
+	hdd_report_changed_chunk(c->chunkid,c->version|((c->owner->markforremoval!=MFR_NO)?0x80000000:0));
+	return 0;
+}
+
 uint8_t hdd_clear_errors(uint32_t pleng,const uint8_t *path) {
 	folder *f;
 	uint32_t i;
@@ -1546,6 +1780,7 @@ static int hdd_timed_wait(pthread_cond_t *cond, pthread_mutex_t *mutex, uint32_t
 }
 
 static void hdd_chunk_release(chunk *c) {
+	hdd_journal_chunk_update(c);
 	zassert(pthread_mutex_lock(&hashlock));
 //	mfs_log(MFSLOG_SYSLOG,MFSLOG_DEBUG,"hdd_chunk_release got chunk: %016"PRIX64" (c->state:%u)",c->chunkid,c->state);
 	if (c->state==CH_LOCKED) {
@@ -1559,9 +1794,47 @@ static void hdd_chunk_release(chunk *c) {
 	zassert(pthread_mutex_unlock(&hashlock));
 }
 
+/* called by leader of fsync group - one sync for all journal requests from the batch */
+static void hdd_journal_datasync(folder *f) {
+	int fd;
+
+	zassert(pthread_mutex_lock(&journallock));
+	fd = (f->jfd>=0)?dup(f->jfd):-1;
+	zassert(pthread_mutex_unlock(&journallock));
+	if (fd>=0) {
+		if (fdatasync(fd)<0) {
+			mfs_log(MFSLOG_ERRNO_SYSLOG,MFSLOG_NOTICE,"disk %s: chunk journal fdatasync error",f->path);
+		}
+		close(fd);
+	}
+}
+
+static void hdd_folder_sync(folder *f,fsyncreq *req);
+
+/* journal records are synced by maintenance only once per second - operations creating chunks or changing their versions have to sync them before reply, otherwise after crash master could know newer version than the replayed one */
+/* it is done by fsync group commit of the folder, so concurrent operations share one journal sync */
+// chunk:locked (folder can't be removed)
+static void hdd_journal_sync(folder *f) {
+	fsyncreq req;
+
+	req.fds = NULL;
+	req.errs = NULL;
+	req.cnt = 0;
+	req.journal = 1;
+	hdd_folder_sync(f,&req);
+}
+
+static void hdd_chunk_release_jsync(chunk *c) {
+	hdd_journal_chunk_update(c);
+	if (c->owner!=NULL) {
+		hdd_journal_sync(c->owner);
+	}
+	hdd_chunk_release(c);
+}
+
 static int hdd_chunk_getattr(chunk *c,uint8_t forceflag) {
 	struct stat sb;
-	int err;
+	int err,res;
 
 	err = 0;
 	if (c->fd>=0) {
@@ -1580,7 +1853,16 @@ static int hdd_chunk_getattr(chunk *c,uint8_t forceflag) {
 	} else {
 		char fname[PATH_MAX];
 		hdd_generate_filename(fname,c);
-		if (stat(fname,&sb)<0) {
+		res = stat(fname,&sb);
+		if (res<0 && errno==ENOENT && c->jverify) {
+			if (hdd_chunk_jverify(c)==0) {
+				hdd_generate_filename(fname,c);
+				res = stat(fname,&sb);
+			} else {
+				errno = ENOENT;
+			}
+		}
+		if (res<0) {
 			mfs_log(MFSLOG_ERRNO_SYSLOG,MFSLOG_WARNING,"hdd_chunk_getattr: chunk %s stat error",fname);
 			if (forceflag==0) {
 				return -1;
@@ -1593,6 +1875,7 @@ static int hdd_chunk_getattr(chunk *c,uint8_t forceflag) {
 			}
 		}
 	}
+	c->jverify = 0;
 	if ((sb.st_mode & S_IFMT) != S_IFREG) {
 		mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"hdd_chunk_getattr: chunk %016"PRIX64" wrong file mode",c->chunkid);
 		return -1; // this error can't be ignored
@@ -1705,6 +1988,11 @@ static int hdd_chunk_get(uint64_t chunkid,chunk **cptr,uint8_t cflag) {
 #endif
 			c->validattr = 0;
 			c->fileversion = 0;
+			c->jversion = 0;
+			c->jpathid = 0xFFFF;
+			c->jverify = 0;
+			c->heat = 0;
+			c->heatstamp = 0;
 			c->testnext = NULL;
 			c->testprev = NULL;
 			c->next = hashtab[hashpos];
@@ -1757,6 +2045,11 @@ static int hdd_chunk_get(uint64_t chunkid,chunk **cptr,uint8_t cflag) {
 #endif /* PRESERVE_BLOCK */
 				c->validattr = 0;
 				c->fileversion = 0;
+				c->jversion = 0;
+				c->jpathid = 0xFFFF;
+				c->jverify = 0;
+				c->heat = 0;
+				c->heatstamp = 0;
 				c->state = CH_LOCKED;
 //				mfs_log(MFSLOG_SYSLOG,MFSLOG_DEBUG,"hdd_chunk_get returns chunk: %016"PRIX64" (c->state:%u)",c->chunkid,c->state);
 				zassert(pthread_mutex_unlock(&hashlock));
@@ -1819,6 +2112,7 @@ static void hdd_chunk_delete(chunk *c) {
 	folder *f;
 	int res;
 
+	hdd_journal_chunk_remove(c);
 	zassert(pthread_mutex_lock(&folderlock));
 	f = c->owner;
 	hdd_remove_chunk_from_folder(c,f);
@@ -2128,7 +2422,79 @@ static inline void hdd_refresh_usage(folder *f) {
 	}
 }
 
-static inline folder* hdd_getfolder(void) {
+/* local tiering */
+
+static inline uint16_t hdd_tier_period(void) {
+	return (uint16_t)(monotonic_seconds()/TIER_HEAT_HALFLIFE);
+}
+
+/* chunk heat decayed to given period - chunk has to be locked (or available with hashlock locked) */
+static inline uint16_t hdd_chunk_heat(chunk *c,uint16_t period) {
+	uint16_t d;
+
+	d = period - c->heatstamp;
+	if (d>=16) {
+		return 0;
+	}
+	return c->heat>>d;
+}
+
+/* registers reads of blocks of locked chunk - chunks from standard folders that became hot are queued for promotion */
+static inline void hdd_chunk_heat_add(chunk *c,uint32_t blocks) {
+	uint16_t period;
+	uint32_t heat;
+
+	period = hdd_tier_period();
+	heat = hdd_chunk_heat(c,period);
+	c->heat = (heat+blocks>0xFFFF)?0xFFFF:(heat+blocks);
+	c->heatstamp = period;
+	if (heat<TierPromoteReads && c->heat>=TierPromoteReads && c->owner!=NULL && c->owner->fasttier==0) {
+		zassert(pthread_mutex_lock(&tierlock));
+		if (tierpromoteqcnt<TIER_PROMOTE_QUEUE) {
+			tierpromoteq[(tierpromoteqhead+tierpromoteqcnt)%TIER_PROMOTE_QUEUE] = c->chunkid;
+			tierpromoteqcnt++;
+		}
+		zassert(pthread_mutex_unlock(&tierlock));
+	}
+}
+
+static inline int hdd_tier_match(folder *f,uint8_t tier) {
+	return (tier==TIER_ANY || (tier==TIER_FAST && f->fasttier) || (tier==TIER_STD && f->fasttier==0));
+}
+
+/* new chunks go to fast folders until their usage reaches TierHighUsage - folderlock has to be locked */
+static inline uint8_t hdd_tier_for_new_chunk(void) {
+	folder *f;
+	uint64_t fastused,fasttotal;
+	uint8_t fastok,stdok;
+
+	fastused = 0;
+	fasttotal = 0;
+	fastok = 0;
+	stdok = 0;
+	for (f=folderhead ; f ; f=f->next) {
+		if (f->damaged==0 && f->toremove==REMOVING_NO && f->markforremoval==MFR_NO && f->scanstate==SCST_WORKING && f->total>0 && f->balancemode!=REBALANCE_FORCE_SRC) {
+			if (f->fasttier) {
+				fastused += f->total - f->avail;
+				fasttotal += f->total;
+				if (f->avail * UINT64_C(1000) >= f->total) { // space used <= 99.9%
+					fastok = 1;
+				}
+			} else if (f->avail>0) {
+				stdok = 1;
+			}
+		}
+	}
+	if (fasttotal==0 || stdok==0) {
+		return TIER_ANY;
+	}
+	if (fastok && fastused * 100 < fasttotal * TierHighUsage) {
+		return TIER_FAST;
+	}
+	return TIER_STD;
+}
+
+static inline folder* hdd_getfolder_tier(uint8_t tier) {
 	folder *f,*bf;
 	double minerr,err,expdist;
 //	double usage;
@@ -2147,7 +2513,7 @@ static inline folder* hdd_getfolder(void) {
 	onlygood = 0;
 
 	for (f=folderhead ; f ; f=f->next) {
-		if (f->damaged==0 && f->toremove==REMOVING_NO && f->markforremoval==MFR_NO && f->scanstate==SCST_WORKING && f->total>0 && f->avail>0 && f->balancemode!=REBALANCE_FORCE_SRC) {
+		if (f->damaged==0 && f->toremove==REMOVING_NO && f->markforremoval==MFR_NO && f->scanstate==SCST_WORKING && f->total>0 && f->avail>0 && f->balancemode!=REBALANCE_FORCE_SRC && hdd_tier_match(f,tier)) {
 			if (f->avail * UINT64_C(1000) >= f->total) { // space used <= 99.9%
 				notfull_cnt++;
 			}
@@ -2155,7 +2521,7 @@ static inline folder* hdd_getfolder(void) {
 	}
 
 	for (f=folderhead ; f ; f=f->next) {
-		if (f->damaged==0 && f->toremove==REMOVING_NO && f->markforremoval==MFR_NO && f->scanstate==SCST_WORKING && f->total>0 && f->avail>0 && f->balancemode!=REBALANCE_FORCE_SRC) {
+		if (f->damaged==0 && f->toremove==REMOVING_NO && f->markforremoval==MFR_NO && f->scanstate==SCST_WORKING && f->total>0 && f->avail>0 && f->balancemode!=REBALANCE_FORCE_SRC && hdd_tier_match(f,tier)) {
 			if (notfull_cnt==0 || f->avail * UINT64_C(1000) >= f->total) { // space used <= 99.9%
 				if (f->rebalance_last_usec + REBALANCE_GRACE_PERIOD < usectime) {
 					good_cnt++;
@@ -2174,7 +2540,7 @@ static inline folder* hdd_getfolder(void) {
 	bf = NULL;
 	minerr = 0.0; // make some old compilers happy
 	for (f=folderhead ; f ; f=f->next) {
-		if (f->damaged==0 && f->toremove==REMOVING_NO && f->markforremoval==MFR_NO && f->scanstate==SCST_WORKING && f->total>0 && f->avail>0 && f->balancemode!=REBALANCE_FORCE_SRC) {
+		if (f->damaged==0 && f->toremove==REMOVING_NO && f->markforremoval==MFR_NO && f->scanstate==SCST_WORKING && f->total>0 && f->avail>0 && f->balancemode!=REBALANCE_FORCE_SRC && hdd_tier_match(f,tier)) {
 			if (notfull_cnt==0 || f->avail * UINT64_C(1000) >= f->total) { // space used <= 99.9%
 				if (onlygood==0 || (f->rebalance_last_usec + REBALANCE_GRACE_PERIOD < usectime)) {
 					f->write_dist++;
@@ -2206,6 +2572,18 @@ static inline folder* hdd_getfolder(void) {
 	}
 	return bf;
 }
+
+static inline folder* hdd_getfolder(void) {
+	folder *f;
+	uint8_t tier;
+
+	tier = hdd_tier_for_new_chunk();
+	f = hdd_getfolder_tier(tier);
+	if (f==NULL && tier!=TIER_ANY) {
+		f = hdd_getfolder_tier(TIER_ANY);
+	}
+	return f;
+}
 /*
 static inline folder* hdd_getfolder(void) {
 	folder *f,*bf;
@@ -2498,6 +2876,7 @@ static inline void hdd_folder_dump_chunkdb_end(folder *f) {
 		}
 		free(fname_src);
 		free(fname_dst);
+		hdd_journal_drop_files(f); // '.chunkdb' is always newer than journal
 		mfs_log(MFSLOG_SYSLOG,MFSLOG_INFO,"disk %s: '.chunkdb' has been written",f->path);
 	}
 }
@@ -2537,6 +2916,220 @@ static inline void hdd_folder_dump_chunkdb_chunk(folder *f,chunk *c) {
 	}
 }
 
+/* closes current journal, but leaves files - they are still valid (used before '.chunkdb' is written) */
+static void hdd_journal_stop(folder *f) {
+	zassert(pthread_mutex_lock(&journallock));
+	if (f->jfd>=0) {
+		close(f->jfd);
+		f->jfd = -1;
+	}
+	f->jrecords = 0;
+	zassert(pthread_mutex_unlock(&journallock));
+}
+
+/* writes compacted snapshot of the folder - all changes made after journal 'gen' has been started are also in that journal */
+static int hdd_journal_dump(folder *f,uint32_t gen) {
+	char fname[PATH_MAX],tmpfname[PATH_MAX];
+	uint8_t *buff,*wptr;
+	uint32_t bsize,pleng,i,j;
+	chunk *c;
+	int fd;
+
+	snprintf(tmpfname,PATH_MAX,"%s.tmp_chunkjdb",f->path);
+	tmpfname[PATH_MAX-1] = 0;
+	snprintf(fname,PATH_MAX,"%s.chunkjdb",f->path);
+	fname[PATH_MAX-1] = 0;
+	fd = open(tmpfname,O_WRONLY | O_TRUNC | O_CREAT,0666);
+	if (fd<0) {
+		mfs_log(MFSLOG_ERRNO_SYSLOG,MFSLOG_WARNING,"%s: open error",tmpfname);
+		return -1;
+	}
+	pleng = strlen(f->path);
+	bsize = 65536;
+	if (bsize<CHUNKJDB_HDR_SIZE+2+pleng+4) {
+		bsize = CHUNKJDB_HDR_SIZE+2+pleng+4;
+	}
+	buff = malloc(bsize);
+	passert(buff);
+	wptr = buff;
+	memcpy(wptr,"MFS CHJSNAP1",CHUNKJDB_HDR_SIZE);
+	wptr += CHUNKJDB_HDR_SIZE;
+	put16bit(&wptr,pleng);
+	memcpy(wptr,f->path,pleng);
+	wptr += pleng;
+	put32bit(&wptr,gen);
+	for (i=0 ; i<=HASHSIZE ; i+=65536) {
+		if (i<HASHSIZE) {
+			zassert(pthread_mutex_lock(&folderlock));
+			zassert(pthread_mutex_lock(&hashlock));
+			for (j=i ; j<i+65536 ; j++) {
+				for (c=hashtab[j] ; c ; c=c->next) {
+					if (c->owner==f && c->jversion!=0 && c->jpathid<256) {
+						if ((uint32_t)(wptr-buff)+CHUNKJDB_REC_SIZE>bsize) {
+							uint32_t l = wptr-buff;
+							bsize *= 2;
+							buff = realloc(buff,bsize);
+							passert(buff);
+							wptr = buff+l;
+						}
+						put64bit(&wptr,c->chunkid);
+						put32bit(&wptr,c->jversion);
+						put16bit(&wptr,c->jpathid);
+					}
+				}
+			}
+			zassert(pthread_mutex_unlock(&hashlock));
+			zassert(pthread_mutex_unlock(&folderlock));
+		} else {
+			memset(wptr,0,CHUNKJDB_REC_SIZE);
+			wptr += CHUNKJDB_REC_SIZE;
+		}
+		if (write(fd,buff,wptr-buff)!=(ssize_t)(wptr-buff)) {
+			mfs_log(MFSLOG_ERRNO_SYSLOG,MFSLOG_WARNING,"%s: write error",tmpfname);
+			free(buff);
+			close(fd);
+			unlink(tmpfname);
+			return -1;
+		}
+		wptr = buff;
+	}
+	free(buff);
+	if (fsync(fd)<0 || close(fd)<0) {
+		mfs_log(MFSLOG_ERRNO_SYSLOG,MFSLOG_WARNING,"%s: fsync/close error",tmpfname);
+		unlink(tmpfname);
+		return -1;
+	}
+	if (rename(tmpfname,fname)<0) {
+		mfs_log(MFSLOG_ERRNO_SYSLOG,MFSLOG_WARNING,"%s->%s: rename error",tmpfname,fname);
+		unlink(tmpfname);
+		return -1;
+	}
+	fd = open(f->path,O_RDONLY);
+	if (fd>=0) { // make rename persistent before older journals are removed
+		if (fsync(fd)<0) {
+			mfs_log(MFSLOG_ERRNO_SYSLOG,MFSLOG_NOTICE,"%s: fsync error",f->path);
+		}
+		close(fd);
+	}
+	return 0;
+}
+
+/* starts new journal generation and writes snapshot for it */
+static void hdd_journal_rotate(folder *f) {
+	char fname[PATH_MAX];
+	uint8_t hdr[CHUNKJOURNAL_HDR_SIZE];
+	uint8_t *wptr;
+	uint32_t gen;
+	uint64_t st;
+	int fd;
+
+	st = monotonic_useconds();
+	gen = hdd_journal_cleanup(f,0);
+	if (gen<f->jgen) {
+		gen = f->jgen;
+	}
+	gen++;
+	hdd_journal_fname(fname,f,gen);
+	fd = open(fname,O_WRONLY | O_TRUNC | O_CREAT | O_APPEND,0666);
+	if (fd>=0) {
+		wptr = hdr;
+		memcpy(wptr,"MFS CHJOURN1",12);
+		wptr += 12;
+		put32bit(&wptr,gen);
+		if (write(fd,hdr,CHUNKJOURNAL_HDR_SIZE)!=CHUNKJOURNAL_HDR_SIZE) {
+			close(fd);
+			unlink(fname);
+			fd = -1;
+		}
+	}
+	if (fd<0) {
+		mfs_log(MFSLOG_ERRNO_SYSLOG,MFSLOG_WARNING,"%s: can't create chunk journal",fname);
+		f->jretry = monotonic_seconds() + CHUNKJOURNAL_RETRY_DELAY;
+		return;
+	}
+	zassert(pthread_mutex_lock(&journallock));
+	if (f->jfd>=0) {
+		if (fdatasync(f->jfd)<0) {
+			mfs_log(MFSLOG_ERRNO_SYSLOG,MFSLOG_NOTICE,"disk %s: chunk journal fdatasync error",f->path);
+		}
+		close(f->jfd);
+	}
+	f->jfd = fd;
+	f->jgen = gen;
+	f->jrecords = 0;
+	f->jdirty = 0;
+	zassert(pthread_mutex_unlock(&journallock));
+	if (hdd_journal_dump(f,gen)<0) {
+		f->jdumpneeded = 1;
+		f->jretry = monotonic_seconds() + CHUNKJOURNAL_RETRY_DELAY;
+		return;
+	}
+	f->jdumpneeded = 0;
+	hdd_journal_cleanup(f,gen);
+	mfs_log(MFSLOG_SYSLOG,MFSLOG_INFO,"disk %s: chunk journal snapshot (generation %"PRIu32") has been written in %.3lfs",f->path,gen,(monotonic_useconds()-st)/1000000.0);
+}
+
+static inline uint8_t hdd_journal_folder_ok(folder *f) {
+	return (f->scanstate==SCST_WORKING && f->toremove==REMOVING_NO && f->damaged==0 && f->markforremoval!=MFR_READONLY && f->isro==0)?1:0;
+}
+
+/* called from folders thread - the only thread that rotates journals and removes folders */
+static void hdd_journal_maintenance(void) {
+	folder *f;
+	double now;
+	int *fdtab;
+	uint32_t fdcnt,i;
+
+	now = monotonic_seconds();
+	for (;;) {
+		zassert(pthread_mutex_lock(&folderlock));
+		for (f=folderhead ; f ; f=f->next) {
+			if (ChunkJournal && hdd_journal_folder_ok(f)) {
+				if ((f->jfd<0 || f->jdumpneeded || f->jrecords>=CHUNKJOURNAL_MIN_RECORDS+f->chunkcount/2) && f->jretry<=now) {
+					break;
+				}
+			} else if (f->jfd>=0 && f->toremove==REMOVING_NO) {
+				hdd_journal_stop(f);
+				hdd_journal_drop_files(f);
+			}
+		}
+		zassert(pthread_mutex_unlock(&folderlock));
+		if (f==NULL) {
+			break;
+		}
+		hdd_journal_rotate(f);
+		if (f->jfd<0 && f->jretry<=now) { // shouldn't happen
+			f->jretry = now + CHUNKJOURNAL_RETRY_DELAY;
+		}
+	}
+	fdcnt = 0;
+	fdtab = NULL;
+	zassert(pthread_mutex_lock(&folderlock));
+	zassert(pthread_mutex_lock(&journallock));
+	for (f=folderhead ; f ; f=f->next) {
+		fdcnt++;
+	}
+	if (fdcnt>0) {
+		fdtab = malloc(sizeof(int)*fdcnt);
+		passert(fdtab);
+	}
+	fdcnt = 0;
+	for (f=folderhead ; f ; f=f->next) {
+		if (f->jfd>=0 && f->jdirty) {
+			fdtab[fdcnt++] = f->jfd;
+			f->jdirty = 0;
+		}
+	}
+	zassert(pthread_mutex_unlock(&journallock));
+	zassert(pthread_mutex_unlock(&folderlock));
+	for (i=0 ; i<fdcnt ; i++) {
+		fdatasync(fdtab[i]);
+	}
+	if (fdtab!=NULL) {
+		free(fdtab);
+	}
+}
+
 uint8_t hdd_senddata(folder *f,int rmflag) {
 	uint32_t i;
 	uint8_t markforremoval;
@@ -2714,6 +3307,7 @@ void hdd_check_folders(void) {
 					nobreak;
 				case SCST_WORKING:
 					if (f->toremove==REMOVING_START) {
+						hdd_journal_stop(f);
 						hdd_folder_dump_chunkdb_begin(f);
 						f->toremove = REMOVING_INPROGRESS;
 					}
@@ -3264,80 +3858,258 @@ void hdd_test_show_openedchunks(void) {
 }
 #endif
 
-void hdd_delayed_ops(void) {
-	dopchunk **ccp,*cc,*tcc;
-	uint32_t dhashpos;
-	uint8_t dofsync;
-	chunk *c;
+/* syncs all files from one batch - leader of fsync group does it without fsynclock */
+static void hdd_fsync_batch(folder *f,fsyncreq *batch,uint32_t bcnt,uint32_t groupmin) {
+	fsyncreq *r;
+	uint32_t i;
 	uint64_t ts,te;
-	struct stat sb;
-	static double lastreport = 0.0;
-	char fname[PATH_MAX];
-//	int status;
+	uint8_t jsync;
 
-//	printf("delayed ops: before lock\n");
-	zassert(pthread_mutex_lock(&doplock));
-	dofsync = DoFsyncBeforeClose;
-	zassert(pthread_mutex_unlock(&doplock));
+	jsync = 0;
+	for (r=batch ; r ; r=r->next) {
+		if (r->journal) {
+			jsync = 1;
+		}
+	}
 
-	zassert(pthread_mutex_lock(&ndoplock));
-//	printf("delayed ops: after lock\n");
-/* append new chunks */
-	cc = newdopchunks;
-	while (cc) {
-		dhashpos = DHASHPOS(cc->chunkid);
-		for (tcc=dophashtab[dhashpos] ; tcc && tcc->chunkid!=cc->chunkid ; tcc=tcc->next) {}
-		if (tcc) {	// found - ignore
-			tcc = cc;
-			cc = cc->next;
-			free(tcc);
-		} else {	// not found - add
-			tcc = cc;
-			cc = cc->next;
-			tcc->next = dophashtab[dhashpos];
-			dophashtab[dhashpos] = tcc;
+#ifdef HAVE_SYNC_FILE_RANGE
+	if (bcnt>1) { // start writeback of all files at once, so the disk can write them in one pass
+		for (r=batch ; r ; r=r->next) {
+			for (i=0 ; i<r->cnt ; i++) {
+				sync_file_range(r->fds[i],0,0,SYNC_FILE_RANGE_WRITE);
+			}
 		}
 	}
-	newdopchunks = NULL;
-	zassert(pthread_mutex_unlock(&ndoplock));
-/* check all */
-//	printf("delayed ops: before loop\n");
-	for (dhashpos=0 ; dhashpos<DHASHSIZE ; dhashpos++) {
-		ccp = dophashtab+dhashpos;
-		while ((cc=*ccp)) {
-//			printf("find chunk: %llu\n",cc->chunkid);
-			c = hdd_chunk_tryfind(cc->chunkid);
-//			if (c!=NULL && c!=CHUNKLOCKED) {
-//				printf("found chunk: %llu (c->state:%u c->crcrefcount:%u)\n",cc->chunkid,c->state,c->crcrefcount);
-//			}
-//			c = hdd_chunk_find(cc->chunkid);
-			if (c==NULL) {	// no chunk - delete entry
-				*ccp = cc->next;
-				free(cc);
-			} else if (c==CHUNKLOCKED) {	// locked chunk - just ignore
-				ccp = &(cc->next);
+#endif
+#if defined(HAVE_SYNCFS) && !defined(F_FULLFSYNC)
+	if (groupmin>0 && bcnt>=groupmin) {
+		for (r=batch ; r->cnt==0 ; r=r->next) {} // journal requests have no files
+		ts = monotonic_nseconds();
+		if (syncfs(r->fds[0])>=0) { // journal is synced too
+			te = monotonic_nseconds();
+			if (f!=NULL) {
+				hdd_stats_datafsync(f,te-ts);
+			}
+			for (r=batch ; r ; r=r->next) {
+				for (i=0 ; i<r->cnt ; i++) {
+					r->errs[i] = 0;
+				}
+			}
+			return;
+		}
+		// on error sync every file separately, so error can be assigned to chunks
+	}
+#else
+	(void)groupmin;
+#endif
+	for (r=batch ; r ; r=r->next) {
+		for (i=0 ; i<r->cnt ; i++) {
+			ts = monotonic_nseconds();
+#ifdef F_FULLFSYNC
+			if (fcntl(r->fds[i],F_FULLFSYNC)<0) {
+#else
+			if (fsync(r->fds[i])<0) {
+#endif
+				r->errs[i] = (errno!=0)?errno:EIO;
+			} else {
+				r->errs[i] = 0;
+			}
+			te = monotonic_nseconds();
+			if (f!=NULL) {
+				hdd_stats_datafsync(f,te-ts);
+			}
+		}
+	}
+	if (jsync) {
+		hdd_journal_datasync(f);
+	}
+}
+
+/* group commit - syncs given files (and chunk journal) ; fsyncs requested by other threads for the same folder in the meantime are done together */
+static void hdd_folder_sync(folder *f,fsyncreq *req) {
+	fsyncreq *batch,*r,*rn;
+	uint32_t bcnt,groupmin;
+
+	req->done = 0;
+	req->next = NULL;
+	zassert(pthread_mutex_lock(&fsynclock));
+	groupmin = FsyncGroupMin;
+	if (f==NULL) {
+		zassert(pthread_mutex_unlock(&fsynclock));
+		hdd_fsync_batch(NULL,req,req->cnt,groupmin);
+		return;
+	}
+	*(f->fsynctail) = req;
+	f->fsynctail = &(req->next);
+	f->fsyncqueued += req->cnt;
+	while (req->done==0) {
+		if (f->fsyncactive==0) {
+			f->fsyncactive = 1;
+			batch = f->fsynchead;
+			bcnt = f->fsyncqueued;
+			f->fsynchead = NULL;
+			f->fsynctail = &(f->fsynchead);
+			f->fsyncqueued = 0;
+			zassert(pthread_mutex_unlock(&fsynclock));
+			hdd_fsync_batch(f,batch,bcnt,groupmin);
+			zassert(pthread_mutex_lock(&fsynclock));
+			for (r=batch ; r ; r=rn) {
+				rn = r->next;
+				r->done = 1;
+			}
+			f->fsyncbatches++;
+			f->fsyncbatched += bcnt;
+			if (bcnt>f->fsyncmaxbatch) {
+				f->fsyncmaxbatch = bcnt;
+			}
+			f->fsyncactive = 0;
+			zassert(pthread_cond_broadcast(&fsynccond));
+		} else {
+			zassert(pthread_cond_wait(&fsynccond,&fsynclock));
+		}
+	}
+	zassert(pthread_mutex_unlock(&fsynclock));
+}
+
+static void hdd_folder_fsync(folder *f,const int *fds,uint32_t cnt,int *errs) {
+	fsyncreq req;
+
+	req.fds = fds;
+	req.errs = errs;
+	req.cnt = cnt;
+	req.journal = 0;
+	hdd_folder_sync(f,&req);
+}
+
+/* fsync all idle chunks that need it - chunks from the same folder are synced as one group ; folders are processed one by one, so only chunks of the folder being synced are locked */
+static void hdd_delayed_fsync(void) {
+	static chunk **fsc = NULL;
+	static int *fds = NULL;
+	static int *errs = NULL;
+	static uint32_t pass = 0;
+	dopchunk *cc;
+	chunk *c;
+	folder *f;
+	uint32_t dhashpos,cnt,i;
+	char fname[PATH_MAX];
+
+	if (fsc==NULL) {
+		fsc = malloc(sizeof(chunk*)*FSYNC_MAX_GROUP);
+		passert(fsc);
+		fds = malloc(sizeof(int)*FSYNC_MAX_GROUP);
+		passert(fds);
+		errs = malloc(sizeof(int)*FSYNC_MAX_GROUP);
+		passert(errs);
+	}
+	pass++;
+	if (pass==0) {
+		pass = 1;
+	}
+	for (;;) {
+		f = NULL;
+		cnt = 0;
+		for (dhashpos=0 ; dhashpos<DHASHSIZE && cnt<FSYNC_MAX_GROUP ; dhashpos++) {
+			for (cc=dophashtab[dhashpos] ; cc && cnt<FSYNC_MAX_GROUP ; cc=cc->next) {
+				c = hdd_chunk_tryfind(cc->chunkid);
+				if (c==NULL || c==CHUNKLOCKED) {
+					continue;
+				}
+				if (c->crcrefcount==0 && c->fd>=0 && c->fsyncneeded && c->owner!=NULL && c->owner->fsyncpass!=pass && (f==NULL || c->owner==f)) {
+					f = c->owner;
+					fds[cnt] = c->fd;
+					fsc[cnt++] = c;
+				} else {
+					hdd_chunk_release(c);
+				}
+			}
+		}
+		if (f==NULL) {
+			break;
+		}
+		f->fsyncpass = pass;
+		hdd_folder_fsync(f,fds,cnt,errs);
+		for (i=0 ; i<cnt ; i++) {
+			c = fsc[i];
+			if (errs[i]!=0) {
+				errno = errs[i];
+				hdd_error_occurred(c,1); // uses and preserves errno !!!
+				hdd_generate_filename(fname,c); // preserves errno !!!
+				mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"hdd_delayed_ops: file:%s - fsync error",fname);
+			}
+			c->fsyncneeded = 0;
+			hdd_chunk_release(c);
+		}
+	}
+}
+
+void hdd_delayed_ops(void) {
+	dopchunk **ccp,*cc,*tcc;
+	uint32_t dhashpos;
+	uint8_t dofsync;
+	chunk *c;
+	int ferr;
+	struct stat sb;
+	static double lastreport = 0.0;
+	char fname[PATH_MAX];
+//	int status;
+
+//	printf("delayed ops: before lock\n");
+	zassert(pthread_mutex_lock(&doplock));
+	dofsync = DoFsyncBeforeClose;
+	zassert(pthread_mutex_unlock(&doplock));
+
+	zassert(pthread_mutex_lock(&ndoplock));
+//	printf("delayed ops: after lock\n");
+/* append new chunks */
+	cc = newdopchunks;
+	while (cc) {
+		dhashpos = DHASHPOS(cc->chunkid);
+		for (tcc=dophashtab[dhashpos] ; tcc && tcc->chunkid!=cc->chunkid ; tcc=tcc->next) {}
+		if (tcc) {	// found - ignore
+			tcc = cc;
+			cc = cc->next;
+			free(tcc);
+		} else {	// not found - add
+			tcc = cc;
+			cc = cc->next;
+			tcc->next = dophashtab[dhashpos];
+			dophashtab[dhashpos] = tcc;
+		}
+	}
+	newdopchunks = NULL;
+	zassert(pthread_mutex_unlock(&ndoplock));
+	if (dofsync) {
+		hdd_delayed_fsync();
+	}
+/* check all */
+//	printf("delayed ops: before loop\n");
+	for (dhashpos=0 ; dhashpos<DHASHSIZE ; dhashpos++) {
+		ccp = dophashtab+dhashpos;
+		while ((cc=*ccp)) {
+//			printf("find chunk: %llu\n",cc->chunkid);
+			c = hdd_chunk_tryfind(cc->chunkid);
+//			if (c!=NULL && c!=CHUNKLOCKED) {
+//				printf("found chunk: %llu (c->state:%u c->crcrefcount:%u)\n",cc->chunkid,c->state,c->crcrefcount);
+//			}
+//			c = hdd_chunk_find(cc->chunkid);
+			if (c==NULL) {	// no chunk - delete entry
+				*ccp = cc->next;
+				free(cc);
+			} else if (c==CHUNKLOCKED) {	// locked chunk - just ignore
+				ccp = &(cc->next);
 			} else if (c->crcrefcount>0) {	// io in progress - skip entry
 				hdd_chunk_release(c);
 				ccp = &(cc->next);
 			} else {
 				double now;
-				if (c->fd>=0 && c->fsyncneeded && dofsync) {
-					ts = monotonic_nseconds();
-#ifdef F_FULLFSYNC
-					if (fcntl(c->fd,F_FULLFSYNC)<0) {
+				if (c->fd>=0 && c->fsyncneeded && dofsync) { // changed after hdd_delayed_fsync
+					hdd_folder_fsync(c->owner,&(c->fd),1,&ferr);
+					if (ferr!=0) {
+						errno = ferr;
 						hdd_error_occurred(c,1); // uses and preserves errno !!!
 						hdd_generate_filename(fname,c); // preserves errno !!!
-						mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"hdd_delayed_ops: file:%s - fsync (via fcntl) error",fname);
+						mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"hdd_delayed_ops: file:%s - fsync error",fname);
 					}
-#else
-					if (fsync(c->fd)<0) {
-						hdd_error_occurred(c,1); // uses and preserves errno !!!
-						hdd_generate_filename(fname,c); // preserves errno !!!
-						mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"hdd_delayed_ops: file:%s - fsync (direct call) error",fname);
-					}
-#endif
-					te = monotonic_nseconds();
-					hdd_stats_datafsync(c->owner,te-ts);
 					c->fsyncneeded = 0;
 				}
 				now = monotonic_seconds();
@@ -3617,6 +4389,7 @@ int hdd_open(uint64_t chunkid,uint32_t version) {
 
 int hdd_close(uint64_t chunkid,uint8_t forcefsync) {
 	int status;
+	int ferr;
 	chunk *c;
 	char fname[PATH_MAX];
 
@@ -3632,19 +4405,13 @@ int hdd_close(uint64_t chunkid,uint8_t forcefsync) {
 		hdd_error_occurred(c,1);	// uses and preserves errno !!!
 	}
 	if (forcefsync) {
-#ifdef F_FULLFSYNC
-		if (fcntl(c->fd,F_FULLFSYNC)<0) {
-			hdd_error_occurred(c,1); // uses and preserves errno !!!
-			hdd_generate_filename(fname,c); // preserves errno !!!
-			mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"hdd_close: file:%s - fsync (via fcntl) error",fname);
-		}
-#else
-		if (fsync(c->fd)<0) {
+		hdd_folder_fsync(c->owner,&(c->fd),1,&ferr);
+		if (ferr!=0) {
+			errno = ferr;
 			hdd_error_occurred(c,1); // uses and preserves errno !!!
 			hdd_generate_filename(fname,c); // preserves errno !!!
-			mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"hdd_close: file:%s - fsync (direct call) error",fname);
+			mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"hdd_close: file:%s - fsync error",fname);
 		}
-#endif
 		c->fsyncneeded = 0;
 	}
 	hdd_chunk_release(c);
@@ -3693,6 +4460,357 @@ void hdd_precache_data(uint64_t chunkid,uint32_t offset,uint32_t size) {
 #endif
 }
 
+/* block cache - crc-verified blocks of hot chunks kept in memory */
+/* eviction is done using S3-FIFO: new blocks go to small fifo queue, blocks read again before leaving it are moved to main queue (blocks read only once - like scans - are dropped quickly), blocks dropped from small queue are remembered in ghost queue (keys only) and go directly to main queue when read again */
+
+#define BCACHE_SHARDS 16
+#define BCACHE_SMALL_PERCENT 10
+#define BCACHE_MAX_FREQ 3
+
+enum {BCQ_SMALL,BCQ_MAIN,BCQ_GHOST};
+
+typedef struct _bcentry {
+	uint64_t chunkid;
+	uint32_t version;
+	uint16_t blocknum;
+	uint8_t queue;
+	uint8_t freq;
+	uint8_t *data;				// NULL in ghost queue
+	struct _bcentry *hnext;
+	struct _bcentry *qnext,*qprev;		// qnext - towards tail (older entries)
+} bcentry;
+
+typedef struct _bcqueue {
+	bcentry *head,*tail;
+	uint32_t cnt;
+} bcqueue;
+
+typedef struct _bcshard {
+	pthread_mutex_t lock;
+	bcentry **hashtab;
+	uint32_t hashmask;
+	uint32_t cap;				// max number of blocks kept in memory
+	uint32_t used;
+	bcqueue q[3];
+	uint64_t hits,misses,evictions;
+} bcshard;
+
+static bcshard bcache[BCACHE_SHARDS];
+
+static inline uint64_t hdd_bcache_hash(uint64_t chunkid,uint32_t version,uint16_t blocknum) {
+	return hash64(chunkid ^ (((uint64_t)version)<<22) ^ (((uint64_t)blocknum)<<54));
+}
+
+static inline bcshard* hdd_bcache_shard(uint64_t hash) {
+	return bcache + (hash>>60);
+}
+
+static inline void hdd_bcache_qadd(bcshard *s,bcentry *e,uint8_t queue) {
+	bcqueue *q = s->q+queue;
+	e->queue = queue;
+	e->qprev = NULL;
+	e->qnext = q->head;
+	if (q->head) {
+		q->head->qprev = e;
+	} else {
+		q->tail = e;
+	}
+	q->head = e;
+	q->cnt++;
+}
+
+static inline void hdd_bcache_qremove(bcshard *s,bcentry *e) {
+	bcqueue *q = s->q+e->queue;
+	if (e->qprev) {
+		e->qprev->qnext = e->qnext;
+	} else {
+		q->head = e->qnext;
+	}
+	if (e->qnext) {
+		e->qnext->qprev = e->qprev;
+	} else {
+		q->tail = e->qprev;
+	}
+	q->cnt--;
+}
+
+static inline bcentry* hdd_bcache_hfind(bcshard *s,uint64_t hash,uint64_t chunkid,uint32_t version,uint16_t blocknum) {
+	bcentry *e;
+	for (e=s->hashtab[hash & s->hashmask] ; e ; e=e->hnext) {
+		if (e->chunkid==chunkid && e->blocknum==blocknum && e->version==version) {
+			return e;
+		}
+	}
+	return NULL;
+}
+
+static inline void hdd_bcache_hremove(bcshard *s,bcentry *e) {
+	bcentry **ep;
+	ep = s->hashtab + (hdd_bcache_hash(e->chunkid,e->version,e->blocknum) & s->hashmask);
+	while (*ep!=e) {
+		ep = &((*ep)->hnext);
+	}
+	*ep = e->hnext;
+}
+
+/* removes entry from cache - returns its data buffer (or NULL for ghost entries) */
+static inline uint8_t* hdd_bcache_drop(bcshard *s,bcentry *e) {
+	uint8_t *data;
+	hdd_bcache_qremove(s,e);
+	hdd_bcache_hremove(s,e);
+	data = e->data;
+	free(e);
+	return data;
+}
+
+/* ghost queue remembers as many keys as there are blocks in main queue */
+static inline void hdd_bcache_ghost_trim(bcshard *s) {
+	while (s->q[BCQ_GHOST].cnt>0 && s->q[BCQ_GHOST].cnt > s->cap - (s->cap*BCACHE_SMALL_PERCENT)/100) {
+		hdd_bcache_drop(s,s->q[BCQ_GHOST].tail);
+	}
+}
+
+/* frees one block - returns its buffer */
+static uint8_t* hdd_bcache_evict(bcshard *s) {
+	bcentry *e;
+	uint8_t *data;
+	uint32_t smallcap;
+
+	smallcap = (s->cap*BCACHE_SMALL_PERCENT)/100;
+	if (smallcap==0) {
+		smallcap = 1;
+	}
+	for (;;) {
+		if (s->q[BCQ_SMALL].cnt>=smallcap || s->q[BCQ_MAIN].cnt==0) {
+			e = s->q[BCQ_SMALL].tail;
+			hdd_bcache_qremove(s,e);
+			if (e->freq>0) { // read again - move to main queue
+				e->freq = 0;
+				hdd_bcache_qadd(s,e,BCQ_MAIN);
+			} else {
+				data = e->data;
+				e->data = NULL;
+				hdd_bcache_qadd(s,e,BCQ_GHOST);
+				hdd_bcache_ghost_trim(s);
+				s->evictions++;
+				s->used--;
+				return data;
+			}
+		} else {
+			e = s->q[BCQ_MAIN].tail;
+			if (e->freq>0) { // give it another chance
+				e->freq--;
+				hdd_bcache_qremove(s,e);
+				hdd_bcache_qadd(s,e,BCQ_MAIN);
+			} else {
+				s->evictions++;
+				s->used--;
+				return hdd_bcache_drop(s,e);
+			}
+		}
+	}
+}
+
+/* copies part of cached block to buffer - returns 1 on hit and 0 on miss */
+static int hdd_bcache_get(uint64_t chunkid,uint32_t version,uint16_t blocknum,uint8_t *buffer,uint32_t offset,uint32_t size) {
+	bcshard *s;
+	bcentry *e;
+	uint64_t hash;
+
+	hash = hdd_bcache_hash(chunkid,version,blocknum);
+	s = hdd_bcache_shard(hash);
+	zassert(pthread_mutex_lock(&(s->lock)));
+	if (s->cap==0) {
+		zassert(pthread_mutex_unlock(&(s->lock)));
+		return 0;
+	}
+	e = hdd_bcache_hfind(s,hash,chunkid,version,blocknum);
+	if (e==NULL || e->data==NULL) {
+		s->misses++;
+		zassert(pthread_mutex_unlock(&(s->lock)));
+		return 0;
+	}
+	memcpy(buffer,e->data+offset,size);
+	if (e->freq<BCACHE_MAX_FREQ) {
+		e->freq++;
+	}
+	s->hits++;
+	zassert(pthread_mutex_unlock(&(s->lock)));
+	return 1;
+}
+
+/* stores whole block (already verified against its crc) */
+static void hdd_bcache_put(uint64_t chunkid,uint32_t version,uint16_t blocknum,const uint8_t *block) {
+	bcshard *s;
+	bcentry *e;
+	uint8_t *data;
+	uint64_t hash;
+
+	hash = hdd_bcache_hash(chunkid,version,blocknum);
+	s = hdd_bcache_shard(hash);
+	zassert(pthread_mutex_lock(&(s->lock)));
+	if (s->cap==0) {
+		zassert(pthread_mutex_unlock(&(s->lock)));
+		return;
+	}
+	e = hdd_bcache_hfind(s,hash,chunkid,version,blocknum);
+	if (e!=NULL && e->data!=NULL) {
+		memcpy(e->data,block,MFSBLOCKSIZE);
+		zassert(pthread_mutex_unlock(&(s->lock)));
+		return;
+	}
+	if (s->used<s->cap) {
+		data = malloc(MFSBLOCKSIZE);
+		passert(data);
+	} else {
+		data = hdd_bcache_evict(s);
+	}
+	s->used++;
+	memcpy(data,block,MFSBLOCKSIZE);
+	e = hdd_bcache_hfind(s,hash,chunkid,version,blocknum); // ghost entry could be dropped during eviction
+	if (e!=NULL) { // ghost hit - goes directly to main queue
+		hdd_bcache_qremove(s,e);
+		e->data = data;
+		e->freq = 0;
+		hdd_bcache_qadd(s,e,BCQ_MAIN);
+	} else {
+		e = malloc(sizeof(bcentry));
+		passert(e);
+		e->chunkid = chunkid;
+		e->version = version;
+		e->blocknum = blocknum;
+		e->freq = 0;
+		e->data = data;
+		e->hnext = s->hashtab[hash & s->hashmask];
+		s->hashtab[hash & s->hashmask] = e;
+		hdd_bcache_qadd(s,e,BCQ_SMALL);
+	}
+	zassert(pthread_mutex_unlock(&(s->lock)));
+}
+
+/* has to be called before block is modified */
+static void hdd_bcache_invalidate(uint64_t chunkid,uint32_t version,uint16_t blocknum) {
+	bcshard *s;
+	bcentry *e;
+	uint64_t hash;
+
+	hash = hdd_bcache_hash(chunkid,version,blocknum);
+	s = hdd_bcache_shard(hash);
+	zassert(pthread_mutex_lock(&(s->lock)));
+	if (s->cap>0) {
+		e = hdd_bcache_hfind(s,hash,chunkid,version,blocknum);
+		if (e!=NULL) {
+			if (e->data!=NULL) {
+				s->used--;
+			}
+			free(hdd_bcache_drop(s,e));
+		}
+	}
+	zassert(pthread_mutex_unlock(&(s->lock)));
+}
+
+static inline void hdd_bcache_invalidate_chunk(chunk *c) {
+	uint16_t b;
+
+	if (BlockCacheSize==0) {
+		return;
+	}
+	for (b=0 ; b<c->blocks ; b++) {
+		hdd_bcache_invalidate(c->chunkid,c->version,b);
+	}
+}
+
+/* sets new cache size - on shrink extra blocks are freed immediately */
+static void hdd_bcache_resize(uint64_t size) {
+	bcshard *s;
+	bcentry **nhashtab,*e,*en;
+	uint32_t i,j,cap,hsize;
+
+	cap = size / (MFSBLOCKSIZE * BCACHE_SHARDS);
+	if (size>0 && cap==0) {
+		cap = 1;
+	}
+	hsize = 1024;
+	while (hsize<cap*2 && hsize<0x40000000) { // resident and ghost entries
+		hsize <<= 1;
+	}
+	for (i=0 ; i<BCACHE_SHARDS ; i++) {
+		s = bcache+i;
+		zassert(pthread_mutex_lock(&(s->lock)));
+		s->cap = cap;
+		while (s->used>cap) {
+			free(hdd_bcache_evict(s));
+		}
+		hdd_bcache_ghost_trim(s);
+		if (cap>0 && hsize!=s->hashmask+1) {
+			nhashtab = malloc(sizeof(bcentry*)*hsize);
+			passert(nhashtab);
+			memset(nhashtab,0,sizeof(bcentry*)*hsize);
+			if (s->hashtab!=NULL) {
+				for (j=0 ; j<=s->hashmask ; j++) {
+					for (e=s->hashtab[j] ; e ; e=en) {
+						en = e->hnext;
+						e->hnext = nhashtab[hdd_bcache_hash(e->chunkid,e->version,e->blocknum) & (hsize-1)];
+						nhashtab[hdd_bcache_hash(e->chunkid,e->version,e->blocknum) & (hsize-1)] = e;
+					}
+				}
+				free(s->hashtab);
+			}
+			s->hashtab = nhashtab;
+			s->hashmask = hsize-1;
+		}
+		zassert(pthread_mutex_unlock(&(s->lock)));
+	}
+	BlockCacheSize = size;
+}
+
+static void hdd_bcache_init(void) {
+	uint32_t i;
+	for (i=0 ; i<BCACHE_SHARDS ; i++) {
+		memset(bcache+i,0,sizeof(bcshard));
+		zassert(pthread_mutex_init(&(bcache[i].lock),NULL));
+	}
+}
+
+static void hdd_bcache_term(void) {
+	uint32_t i;
+	hdd_bcache_resize(0);
+	for (i=0 ; i<BCACHE_SHARDS ; i++) {
+		if (bcache[i].hashtab!=NULL) {
+			free(bcache[i].hashtab);
+		}
+		zassert(pthread_mutex_destroy(&(bcache[i].lock)));
+	}
+}
+
+static void hdd_bcache_getstats(uint64_t *used,uint64_t *hits,uint64_t *misses,uint64_t *evictions) {
+	uint32_t i;
+	*used = 0;
+	*hits = 0;
+	*misses = 0;
+	*evictions = 0;
+	for (i=0 ; i<BCACHE_SHARDS ; i++) {
+		zassert(pthread_mutex_lock(&(bcache[i].lock)));
+		*used += (uint64_t)(bcache[i].used) * MFSBLOCKSIZE;
+		*hits += bcache[i].hits;
+		*misses += bcache[i].misses;
+		*evictions += bcache[i].evictions;
+		zassert(pthread_mutex_unlock(&(bcache[i].lock)));
+	}
+}
+
+/* hits and misses since last call (for charts) */
+void hdd_block_cache_stats(uint32_t *hits,uint32_t *misses) {
+	static uint64_t lasthits = 0,lastmisses = 0;
+	uint64_t used,h,m,e;
+
+	hdd_bcache_getstats(&used,&h,&m,&e);
+	*hits = h - lasthits;
+	*misses = m - lastmisses;
+	lasthits = h;
+	lastmisses = m;
+}
+
 int hdd_read(uint64_t chunkid,uint32_t version,uint16_t blocknum,uint8_t *buffer,uint32_t offset,uint32_t size,uint8_t *crcbuff) {
 	chunk *c;
 	int ret;
@@ -3732,6 +4850,7 @@ int hdd_read(uint64_t chunkid,uint32_t version,uint16_t blocknum,uint8_t *buffer
 		hdd_chunk_release(c);
 		return MFS_ERROR_WRONGOFFSET;
 	}
+	hdd_chunk_heat_add(c,1);
 	if (blocknum>=c->blocks) {
 		memset(buffer,0,size);
 		if (size==MFSBLOCKSIZE) {
@@ -3743,6 +4862,17 @@ int hdd_read(uint64_t chunkid,uint32_t version,uint16_t blocknum,uint8_t *buffer
 		hdd_chunk_release(c);
 		return MFS_STATUS_OK;
 	}
+	if (BlockCacheSize>0 && hdd_bcache_get(chunkid,c->version,blocknum,buffer,offset,size)) {
+		if (offset==0 && size==MFSBLOCKSIZE) {
+			rcrcptr = (c->crc)+(4*blocknum);
+			crc = get32bit(&rcrcptr);
+		} else {
+			crc = mycrc32(0,buffer,size);
+		}
+		put32bit(&crcbuff,crc);
+		hdd_chunk_release(c);
+		return MFS_STATUS_OK;
+	}
 	if (offset==0 && size==MFSBLOCKSIZE) {
 #ifdef PRESERVE_BLOCK
 		if (c->blockno==blocknum) {
@@ -3780,6 +4910,9 @@ int hdd_read(uint64_t chunkid,uint32_t version,uint16_t blocknum,uint8_t *buffer
 			hdd_chunk_release(c);
 			return MFS_ERROR_IO;
 		}
+		if (BlockCacheSize>0) {
+			hdd_bcache_put(chunkid,c->version,blocknum,buffer);
+		}
 	} else {
 #ifdef PRESERVE_BLOCK
 		if (c->blockno != blocknum) {
@@ -3836,8 +4969,14 @@ int hdd_read(uint64_t chunkid,uint32_t version,uint16_t blocknum,uint8_t *buffer
 		}
 #ifdef PRESERVE_BLOCK
 		memcpy(buffer,c->block+offset,size);
+		if (BlockCacheSize>0) {
+			hdd_bcache_put(chunkid,c->version,blocknum,c->block);
+		}
 #else /* PRESERVE_BLOCK */
 		memcpy(buffer,blockbuffer+offset,size);
+		if (BlockCacheSize>0) {
+			hdd_bcache_put(chunkid,c->version,blocknum,blockbuffer);
+		}
 #endif /* PRESERVE_BLOCK */
 	}
 	put32bit(&crcbuff,crc);
@@ -3845,7 +4984,584 @@ int hdd_read(uint64_t chunkid,uint32_t version,uint16_t blocknum,uint8_t *buffer
 	return MFS_STATUS_OK;
 }
 
-int hdd_write(uint64_t chunkid,uint32_t version,uint16_t blocknum,const uint8_t *buffer,uint32_t offset,uint32_t size,const uint8_t *crcbuff) {
+/* io_uring backend - per thread rings with registered block buffers */
+
+#ifdef USE_IO_URING
+
+#define URING_UNAVAILABLE ((void*)1)
+
+typedef struct _hdd_uring {
+	int fd;
+	uint32_t depth;
+	uint8_t fixedbuffers;
+	void *sqptr,*cqptr;
+	size_t sqsize,cqsize;
+	uint32_t *sqhead,*sqtail,*sqmask,*sqarray;
+	struct io_uring_sqe *sqes;
+	size_t sqessize;
+	uint32_t *cqhead,*cqtail,*cqmask;
+	struct io_uring_cqe *cqes;
+	uint8_t *buffers;
+	struct iovec iov[IO_URING_MAX_DEPTH];
+} hdd_uring;
+
+static uint8_t uring_error_reported = 0;
+
+static void hdd_uring_free(void *arg) {
+	hdd_uring *r = (hdd_uring*)arg;
+
+	if (r==NULL || r==URING_UNAVAILABLE) {
+		return;
+	}
+	if (r->sqes!=MAP_FAILED) {
+		munmap(r->sqes,r->sqessize);
+	}
+	if (r->cqptr!=MAP_FAILED && r->cqptr!=r->sqptr) {
+		munmap(r->cqptr,r->cqsize);
+	}
+	if (r->sqptr!=MAP_FAILED) {
+		munmap(r->sqptr,r->sqsize);
+	}
+	close(r->fd); // also unregisters buffers
+	if (r->buffers!=NULL) {
+		free(r->buffers);
+	}
+	free(r);
+}
+
+static hdd_uring* hdd_uring_new(uint32_t depth) {
+	struct io_uring_params p;
+	hdd_uring *r;
+	uint8_t singlemmap;
+	uint32_t i;
+	void *bptr;
+
+	r = malloc(sizeof(hdd_uring));
+	passert(r);
+	memset(&p,0,sizeof(p));
+	r->fd = syscall(__NR_io_uring_setup,depth,&p);
+	if (r->fd<0) {
+		free(r);
+		return NULL;
+	}
+	r->depth = depth;
+	r->buffers = NULL;
+	r->sqes = MAP_FAILED;
+	r->cqptr = MAP_FAILED;
+	r->sqsize = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+	r->cqsize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	r->sqessize = p.sq_entries * sizeof(struct io_uring_sqe);
+#ifdef IORING_FEAT_SINGLE_MMAP
+	singlemmap = (p.features & IORING_FEAT_SINGLE_MMAP)?1:0;
+#else
+	singlemmap = 0;
+#endif
+	if (singlemmap) {
+		if (r->cqsize > r->sqsize) {
+			r->sqsize = r->cqsize;
+		}
+		r->cqsize = r->sqsize;
+	}
+	r->sqptr = mmap(NULL,r->sqsize,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,r->fd,IORING_OFF_SQ_RING);
+	if (r->sqptr==MAP_FAILED) {
+		hdd_uring_free(r);
+		return NULL;
+	}
+	if (singlemmap) {
+		r->cqptr = r->sqptr;
+	} else {
+		r->cqptr = mmap(NULL,r->cqsize,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,r->fd,IORING_OFF_CQ_RING);
+		if (r->cqptr==MAP_FAILED) {
+			hdd_uring_free(r);
+			return NULL;
+		}
+	}
+	r->sqes = mmap(NULL,r->sqessize,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,r->fd,IORING_OFF_SQES);
+	if (r->sqes==MAP_FAILED) {
+		hdd_uring_free(r);
+		return NULL;
+	}
+	r->sqhead = (uint32_t*)((uint8_t*)(r->sqptr) + p.sq_off.head);
+	r->sqtail = (uint32_t*)((uint8_t*)(r->sqptr) + p.sq_off.tail);
+	r->sqmask = (uint32_t*)((uint8_t*)(r->sqptr) + p.sq_off.ring_mask);
+	r->sqarray = (uint32_t*)((uint8_t*)(r->sqptr) + p.sq_off.array);
+	r->cqhead = (uint32_t*)((uint8_t*)(r->cqptr) + p.cq_off.head);
+	r->cqtail = (uint32_t*)((uint8_t*)(r->cqptr) + p.cq_off.tail);
+	r->cqmask = (uint32_t*)((uint8_t*)(r->cqptr) + p.cq_off.ring_mask);
+	r->cqes = (struct io_uring_cqe*)((uint8_t*)(r->cqptr) + p.cq_off.cqes);
+
+	if (posix_memalign(&bptr,4096,(size_t)depth * MFSBLOCKSIZE)!=0) {
+		hdd_uring_free(r);
+		return NULL;
+	}
+	r->buffers = bptr;
+	for (i=0 ; i<depth ; i++) {
+		r->iov[i].iov_base = r->buffers + (size_t)i * MFSBLOCKSIZE;
+		r->iov[i].iov_len = MFSBLOCKSIZE;
+	}
+	// registering can fail when RLIMIT_MEMLOCK is too low - then use ordinary (not fixed) buffers
+	r->fixedbuffers = (syscall(__NR_io_uring_register,r->fd,IORING_REGISTER_BUFFERS,r->iov,depth)==0)?1:0;
+	return r;
+}
+
+static hdd_uring* hdd_uring_get(void) {
+	hdd_uring *r;
+	uint32_t depth;
+	int errmem;
+
+	if (UseIOUring==0) {
+		return NULL;
+	}
+	depth = IOUringDepth;
+	r = pthread_getspecific(uringkey);
+	if (r==URING_UNAVAILABLE) {
+		return NULL;
+	}
+	if (r!=NULL && r->depth!=depth) { // depth changed (reload)
+		hdd_uring_free(r);
+		r = NULL;
+	}
+	if (r==NULL) {
+		r = hdd_uring_new(depth);
+		if (r==NULL) {
+			errmem = errno;
+			if (uring_error_reported==0) {
+				uring_error_reported = 1;
+				errno = errmem;
+				mfs_log(MFSLOG_ERRNO_SYSLOG,MFSLOG_WARNING,"hdd space manager: can't initialize io_uring - using standard I/O");
+			}
+			zassert(pthread_setspecific(uringkey,URING_UNAVAILABLE));
+			return NULL;
+		}
+		zassert(pthread_setspecific(uringkey,r));
+	}
+	return r;
+}
+
+static inline void hdd_uring_prep_read(hdd_uring *r,int fd,uint32_t bufindx,uint64_t foffset) {
+	struct io_uring_sqe *sqe;
+	uint32_t tail,idx;
+
+	tail = *(r->sqtail);
+	idx = tail & *(r->sqmask);
+	sqe = r->sqes + idx;
+	memset(sqe,0,sizeof(struct io_uring_sqe));
+	if (r->fixedbuffers) {
+		sqe->opcode = IORING_OP_READ_FIXED;
+		sqe->addr = (uint64_t)(uintptr_t)(r->iov[bufindx].iov_base);
+		sqe->len = MFSBLOCKSIZE;
+		sqe->buf_index = bufindx;
+	} else {
+		sqe->opcode = IORING_OP_READV;
+		sqe->addr = (uint64_t)(uintptr_t)(r->iov + bufindx);
+		sqe->len = 1;
+	}
+	sqe->fd = fd;
+	sqe->off = foffset;
+	sqe->user_data = bufindx;
+	r->sqarray[idx] = idx;
+	__atomic_store_n(r->sqtail,tail+1,__ATOMIC_RELEASE);
+}
+
+/* submits 'tosubmit' prepared entries and waits for at least one completion, returns number of submitted entries or -1 on error */
+static inline int hdd_uring_enter(hdd_uring *r,uint32_t tosubmit) {
+	int ret;
+
+	do {
+		ret = syscall(__NR_io_uring_enter,r->fd,tosubmit,1,IORING_ENTER_GETEVENTS,NULL,0);
+	} while (ret<0 && errno==EINTR);
+	return ret;
+}
+
+typedef struct _hdd_mread {
+	uint16_t blocknum;
+	uint16_t offset;
+	uint32_t size;
+	uint32_t crc;
+	uint32_t partcrc;
+	uint32_t bcrc;
+	int32_t ret;
+	int error;
+	uint8_t status;
+	uint8_t done;
+} hdd_mread;
+
+/* checks crc of one block read by hdd_read_multi and copies requested part to destination buffer, errors are not reported here */
+static void hdd_mread_check(chunk *c,hdd_mread *mr,const uint8_t *block,uint8_t *buffer,uint8_t *crcbuff) {
+	const uint8_t *rcrcptr;
+	uint32_t precrc,postcrc;
+
+	if (mr->offset==0 && mr->size==MFSBLOCKSIZE) {
+		mr->crc = mycrc32(0,block,MFSBLOCKSIZE);
+		mr->partcrc = mr->crc;
+	} else {
+		precrc = mycrc32(0,block,mr->offset);
+		mr->partcrc = mycrc32(0,block+mr->offset,mr->size);
+		postcrc = mycrc32(0,block+mr->offset+mr->size,MFSBLOCKSIZE-(mr->offset+mr->size));
+		if (mr->offset==0) {
+			mr->crc = mycrc32_combine(mr->partcrc,postcrc,MFSBLOCKSIZE-(mr->offset+mr->size));
+		} else {
+			mr->crc = mycrc32_combine(precrc,mr->partcrc,mr->size);
+			if ((mr->offset+mr->size)<MFSBLOCKSIZE) {
+				mr->crc = mycrc32_combine(mr->crc,postcrc,MFSBLOCKSIZE-(mr->offset+mr->size));
+			}
+		}
+	}
+	rcrcptr = (c->crc)+(4*mr->blocknum);
+	mr->bcrc = get32bit(&rcrcptr);
+	if (mr->bcrc!=mr->crc) {
+		mr->status = MFS_ERROR_CRC;
+	} else if (mr->ret!=MFSBLOCKSIZE) {
+		mr->status = MFS_ERROR_IO;
+	} else {
+		memcpy(buffer,block+mr->offset,mr->size);
+		put32bit(&crcbuff,mr->partcrc);
+		mr->status = MFS_STATUS_OK;
+	}
+	mr->done = 1;
+}
+
+#endif /* USE_IO_URING */
+
+uint32_t hdd_read_batch_size(void) {
+#ifdef USE_IO_URING
+	hdd_uring *r;
+
+	r = hdd_uring_get();
+	if (r!=NULL) {
+		return r->depth;
+	}
+#endif
+	return 1;
+}
+
+/* reads range (offset,size) of the chunk - all blocks from this range are read at once (when io_uring is in use), data from consecutive blocks are stored in 'buffers' and crc's in 'crcbuffs' (the same layout as in hdd_read) ; number of blocks read successfully is returned in 'okblocks' */
+int hdd_read_multi(uint64_t chunkid,uint32_t version,uint32_t offset,uint32_t size,uint8_t * const *buffers,uint8_t * const *crcbuffs,uint16_t *okblocks) {
+	uint32_t i,blockcnt,bsize;
+	uint16_t firstblock,boffset;
+	uint8_t status;
+#ifdef USE_IO_URING
+	hdd_mread mrtab[IO_URING_MAX_DEPTH];
+	hdd_mread *mr;
+	chunk *c;
+	char fname[PATH_MAX];
+	uint8_t *cptr;
+	const uint8_t *rcrcptr;
+	hdd_uring *r;
+	struct io_uring_cqe *cqe;
+	uint32_t toprep,tosubmit,inflight,head,tail,lastread,rdone;
+	uint64_t ts,te;
+	int ret;
+#endif
+
+	*okblocks = 0;
+	if (size==0) {
+		return MFS_STATUS_OK;
+	}
+	if (offset>=MFSCHUNKSIZE || size>MFSCHUNKSIZE || offset+size>MFSCHUNKSIZE) {
+		return MFS_ERROR_WRONGOFFSET;
+	}
+	firstblock = offset>>MFSBLOCKBITS;
+	blockcnt = ((offset+size-1)>>MFSBLOCKBITS) - firstblock + 1;
+#ifdef USE_IO_URING
+	r = hdd_uring_get();
+	if (r==NULL || blockcnt>r->depth)
+#endif
+	{
+		// standard I/O - block by block
+		for (i=0 ; i<blockcnt ; i++) {
+			boffset = (i==0)?(offset&MFSBLOCKMASK):0;
+			if (i==blockcnt-1) {
+				bsize = ((offset+size-1)&MFSBLOCKMASK)+1-boffset;
+			} else {
+				bsize = MFSBLOCKSIZE-boffset;
+			}
+			status = hdd_read(chunkid,version,firstblock+i,buffers[i],boffset,bsize,crcbuffs[i]);
+			if (status!=MFS_STATUS_OK) {
+				return status;
+			}
+			(*okblocks)++;
+		}
+		return MFS_STATUS_OK;
+	}
+#ifdef USE_IO_URING
+	if (hdd_chunk_find(chunkid,&c)==2) {
+		return MFS_ERROR_NOTDONE;
+	}
+	if (c==NULL) {
+		return MFS_ERROR_NOCHUNK;
+	}
+	if (c->version!=version && version>0) {
+		hdd_chunk_release(c);
+		return MFS_ERROR_WRONGVERSION;
+	}
+	hdd_chunk_heat_add(c,blockcnt);
+	toprep = 0;
+	for (i=0 ; i<blockcnt ; i++) {
+		mr = mrtab+i;
+		mr->blocknum = firstblock+i;
+		mr->offset = (i==0)?(offset&MFSBLOCKMASK):0;
+		if (i==blockcnt-1) {
+			mr->size = ((offset+size-1)&MFSBLOCKMASK)+1-mr->offset;
+		} else {
+			mr->size = MFSBLOCKSIZE-mr->offset;
+		}
+		mr->done = 0;
+		if (mr->blocknum>=c->blocks) {
+			memset(buffers[i],0,mr->size);
+			mr->partcrc = (mr->size==MFSBLOCKSIZE)?emptyblockcrc:mycrc32_zeroblock(0,mr->size);
+			cptr = crcbuffs[i];
+			put32bit(&cptr,mr->partcrc);
+			mr->status = MFS_STATUS_OK;
+			mr->done = 1;
+		} else if (BlockCacheSize>0 && hdd_bcache_get(chunkid,c->version,mr->blocknum,buffers[i],mr->offset,mr->size)) {
+			if (mr->size==MFSBLOCKSIZE) {
+				rcrcptr = c->crc+(4*mr->blocknum);
+				mr->partcrc = get32bit(&rcrcptr);
+			} else {
+				mr->partcrc = mycrc32(0,buffers[i],mr->size);
+			}
+			cptr = crcbuffs[i];
+			put32bit(&cptr,mr->partcrc);
+			mr->status = MFS_STATUS_OK;
+			mr->done = 1;
+#ifdef PRESERVE_BLOCK
+		} else if (c->blockno==mr->blocknum) {
+			mr->ret = MFSBLOCKSIZE;
+			mr->error = 0;
+			hdd_mread_check(c,mr,c->block,buffers[i],crcbuffs[i]);
+#endif
+		} else {
+			hdd_uring_prep_read(r,c->fd,i,c->hdrsize+CHUNKCRCSIZE+(((uint32_t)(mr->blocknum))<<MFSBLOCKBITS));
+			toprep++;
+		}
+	}
+	tosubmit = toprep;
+	inflight = 0;
+	lastread = blockcnt;
+	rdone = 0;
+	ts = monotonic_nseconds();
+	te = ts;
+	while (tosubmit>0 || inflight>0) {
+		ret = hdd_uring_enter(r,tosubmit);
+		if (ret<0) {
+			if (inflight==0) { // nothing submitted - can't continue
+				int errmem = errno;
+				for (i=0 ; i<blockcnt ; i++) {
+					if (mrtab[i].done==0) {
+						mrtab[i].ret = -1;
+						mrtab[i].error = errmem;
+						mrtab[i].status = MFS_ERROR_IO;
+						mrtab[i].done = 1;
+					}
+				}
+				// withdraw not submitted entries
+				__atomic_store_n(r->sqtail,*(r->sqtail)-tosubmit,__ATOMIC_RELEASE);
+				break;
+			}
+			ret = 0;
+		}
+		tosubmit -= ret;
+		inflight += ret;
+		/* crc checks are done here - while other reads are still in progress */
+		head = *(r->cqhead);
+		tail = __atomic_load_n(r->cqtail,__ATOMIC_ACQUIRE);
+		while (head!=tail) {
+			cqe = r->cqes + (head & *(r->cqmask));
+			i = cqe->user_data;
+			mr = mrtab+i;
+			if (cqe->res<0) {
+				mr->ret = -1;
+				mr->error = -(cqe->res);
+			} else {
+				mr->ret = cqe->res;
+				mr->error = 0;
+			}
+			head++;
+			__atomic_store_n(r->cqhead,head,__ATOMIC_RELEASE);
+			inflight--;
+			rdone++;
+			te = monotonic_nseconds();
+			hdd_mread_check(c,mr,r->buffers+(size_t)i*MFSBLOCKSIZE,buffers[i],crcbuffs[i]);
+			if (mr->status==MFS_STATUS_OK && BlockCacheSize>0) {
+				hdd_bcache_put(chunkid,c->version,mr->blocknum,r->buffers+(size_t)i*MFSBLOCKSIZE);
+			}
+			if (mr->status==MFS_STATUS_OK && (lastread==blockcnt || i>lastread)) {
+				lastread = i;
+			}
+		}
+	}
+	/* whole batch is one read operation - charge its time once */
+	if (rdone>0) {
+		hdd_stats_dataread(c->owner,rdone*MFSBLOCKSIZE,te-ts);
+	}
+#ifdef PRESERVE_BLOCK
+	if (lastread<blockcnt) {
+		c->blockno = mrtab[lastread].blocknum;
+		memcpy(c->block,r->buffers+(size_t)lastread*MFSBLOCKSIZE,MFSBLOCKSIZE);
+	}
+#endif
+	/* errors are reported in order - only the first one */
+	status = MFS_STATUS_OK;
+	for (i=0 ; i<blockcnt && status==MFS_STATUS_OK ; i++) {
+		mr = mrtab+i;
+		if (mr->status==MFS_STATUS_OK) {
+			(*okblocks)++;
+			continue;
+		}
+		status = mr->status;
+		errno = mr->error;
+		hdd_error_occurred(c,1);	// uses and preserves errno !!!
+		hdd_generate_filename(fname,c); // preserves errno !!!
+		if (status==MFS_ERROR_CRC) {
+			mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"read_block_from_chunk: file: %s ; block: %"PRIu16" - crc error (data crc: %08"PRIX32" ; check crc: %08"PRIX32")",fname,mr->blocknum,mr->crc,mr->bcrc);
+		} else {
+			mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"read_block_from_chunk: file: %s ; block: %"PRIu16" - read error",fname,mr->blocknum);
+		}
+	}
+	hdd_chunk_release(c);
+	return status;
+#endif
+}
+
+
+uint8_t hdd_read_sendfile_mode(void) {
+	return ReadSendfileMode;
+}
+
+/* zero-copy read support: checks whole blocks firstblock .. firstblock+blockcnt-1 and returns their crc's (same layout as in hdd_read) and position of data in chunk file, so caller can send data directly from file (sendfile) */
+/* with 'verify' data crc is checked using read-only mapping of the file (no copy) ; number of blocks that can be sent this way is returned in 'okblocks' - the rest (blocks not present in file etc.) has to be read using hdd_read */
+/* returned descriptor is valid as long as chunk is opened (hdd_open/hdd_close) */
+int hdd_read_sendfile(uint64_t chunkid,uint32_t version,uint16_t firstblock,uint16_t blockcnt,uint8_t verify,uint8_t * const *crcbuffs,uint16_t *okblocks,int *fd,uint64_t *foffset) {
+	chunk *c;
+	struct stat st;
+	const uint8_t *rcrcptr;
+	uint8_t *wcrcptr;
+	uint32_t i,bcrc;
+	uint64_t fpos;
+#ifdef HAVE_MMAP
+	uint8_t *map;
+	uint64_t mapoffset;
+	size_t maplength;
+	long pagesize;
+	uint32_t crc;
+	uint64_t ts,te;
+	char fname[PATH_MAX];
+#endif
+
+	*okblocks = 0;
+	if (blockcnt==0) {
+		return MFS_STATUS_OK;
+	}
+	if (firstblock>=MFSBLOCKSINCHUNK || blockcnt>MFSBLOCKSINCHUNK-firstblock) {
+		return MFS_ERROR_BNUMTOOBIG;
+	}
+#ifndef HAVE_MMAP
+	if (verify) {
+		return MFS_STATUS_OK;
+	}
+#endif
+	if (hdd_chunk_find(chunkid,&c)==2) {
+		return MFS_ERROR_NOTDONE;
+	}
+	if (c==NULL) {
+		return MFS_ERROR_NOCHUNK;
+	}
+	if (c->version!=version && version>0) {
+		hdd_chunk_release(c);
+		return MFS_ERROR_WRONGVERSION;
+	}
+	if (c->fd<0 || c->crc==NULL || firstblock>=c->blocks) {
+		hdd_chunk_release(c);
+		return MFS_STATUS_OK;
+	}
+	if (blockcnt>c->blocks-firstblock) {
+		blockcnt = c->blocks-firstblock;
+	}
+	fpos = c->hdrsize+CHUNKCRCSIZE+(((uint64_t)firstblock)<<MFSBLOCKBITS);
+	// never send (or map) more than file really has - short file has to be handled (and reported) by hdd_read
+	if (fstat(c->fd,&st)<0 || (uint64_t)st.st_size<fpos+MFSBLOCKSIZE) {
+		hdd_chunk_release(c);
+		return MFS_STATUS_OK;
+	}
+	if ((uint64_t)st.st_size<fpos+(((uint64_t)blockcnt)<<MFSBLOCKBITS)) {
+		blockcnt = (st.st_size-fpos)>>MFSBLOCKBITS;
+	}
+#ifdef HAVE_MMAP
+	map = NULL;
+	mapoffset = 0;
+	maplength = 0;
+	ts = 0;
+	if (verify) {
+		pagesize = sysconf(_SC_PAGESIZE);
+		if (pagesize<=0) {
+			pagesize = 4096;
+		}
+		mapoffset = fpos - (fpos % pagesize);
+		maplength = (fpos-mapoffset) + (((uint32_t)blockcnt)<<MFSBLOCKBITS);
+		ts = monotonic_nseconds();
+#ifdef MAP_POPULATE
+		map = mmap(NULL,maplength,PROT_READ,MAP_SHARED|MAP_POPULATE,c->fd,mapoffset);
+#else
+		map = mmap(NULL,maplength,PROT_READ,MAP_SHARED,c->fd,mapoffset);
+#endif
+		if (map==MAP_FAILED) {
+			hdd_chunk_release(c);
+			return MFS_STATUS_OK;
+		}
+	}
+#endif
+	rcrcptr = (c->crc)+(4*firstblock);
+	for (i=0 ; i<blockcnt ; i++) {
+		bcrc = get32bit(&rcrcptr);
+#ifdef HAVE_MMAP
+		if (map!=NULL) {
+			crc = mycrc32(0,map+(fpos-mapoffset)+(i<<MFSBLOCKBITS),MFSBLOCKSIZE);
+			if (crc!=bcrc) {
+				te = monotonic_nseconds();
+				hdd_stats_dataread(c->owner,(i+1)<<MFSBLOCKBITS,te-ts);
+				munmap(map,maplength);
+				errno = 0;
+				hdd_error_occurred(c,1);	// uses and preserves errno !!!
+				hdd_generate_filename(fname,c);
+				mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"read_block_from_chunk: file: %s ; block: %"PRIu32" - crc error (data crc: %08"PRIX32" ; check crc: %08"PRIX32")",fname,firstblock+i,crc,bcrc);
+				hdd_chunk_release(c);
+				return MFS_ERROR_CRC;
+			}
+		}
+#endif
+		wcrcptr = crcbuffs[i];
+		put32bit(&wcrcptr,bcrc);
+		(*okblocks)++;
+	}
+#ifdef HAVE_MMAP
+	if (map!=NULL) {
+		te = monotonic_nseconds();
+		hdd_stats_dataread(c->owner,((uint32_t)blockcnt)<<MFSBLOCKBITS,te-ts);
+		munmap(map,maplength);
+	}
+#endif
+	hdd_chunk_heat_add(c,*okblocks);
+	*fd = c->fd;
+	*foffset = fpos;
+	hdd_chunk_release(c);
+	return MFS_STATUS_OK;
+}
+
+/* without 'verify' data is read from disk by sendfile itself - caller reports amount of sent data and time of sending */
+void hdd_read_sendfile_stats(uint64_t chunkid,uint32_t size,uint64_t rtime) {
+	chunk *c;
+
+	if (hdd_chunk_find(chunkid,&c)==2 || c==NULL) {
+		return;
+	}
+	if (c->owner!=NULL) {
+		hdd_stats_dataread(c->owner,size,rtime);
+	}
+	hdd_chunk_release(c);
+}
+
+static inline int hdd_write_block(uint64_t chunkid,uint32_t version,uint16_t blocknum,const uint8_t *buffer,uint32_t offset,uint32_t size,const uint8_t *crcbuff,uint8_t crcverified) {
 	chunk *c;
 	int ret;
 	int error;
@@ -3887,6 +5603,9 @@ int hdd_write(uint64_t chunkid,uint32_t version,uint16_t blocknum,const uint8_t
 		hdd_chunk_release(c);
 		return MFS_ERROR_WRONGOFFSET;
 	}
+	if (BlockCacheSize>0) {
+		hdd_bcache_invalidate(chunkid,c->version,blocknum);
+	}
 	crc = get32bit(&crcbuff);
 #ifdef HAVE___SYNC_OP_AND_FETCH
 	if (blocknum>=c->blocks && __sync_or_and_fetch(&Sparsification,0)) { // new block - may be sparsified
@@ -3952,13 +5671,13 @@ int hdd_write(uint64_t chunkid,uint32_t version,uint16_t blocknum,const uint8_t
 			size = datasize;
 			crc = chcrc;
 		} else {
-			if (crc!=mycrc32(0,buffer,size)) {
+			if (crcverified==0 && crc!=mycrc32(0,buffer,size)) {
 				hdd_chunk_release(c);
 				return MFS_ERROR_CRC;
 			}
 		}
 	} else {
-		if (crc!=mycrc32(0,buffer,size)) {
+		if (crcverified==0 && crc!=mycrc32(0,buffer,size)) {
 			hdd_chunk_release(c);
 			return MFS_ERROR_CRC;
 		}
@@ -4157,6 +5876,15 @@ int hdd_write(uint64_t chunkid,uint32_t version,uint16_t blocknum,const uint8_t
 	return MFS_STATUS_OK;
 }
 
+int hdd_write(uint64_t chunkid,uint32_t version,uint16_t blocknum,const uint8_t *buffer,uint32_t offset,uint32_t size,const uint8_t *crcbuff) {
+	return hdd_write_block(chunkid,version,blocknum,buffer,offset,size,crcbuff,0);
+}
+
+/* the same as hdd_write, but caller has already checked data against crcbuff (i.e. while receiving it) */
+int hdd_write_verified(uint64_t chunkid,uint32_t version,uint16_t blocknum,const uint8_t *buffer,uint32_t offset,uint32_t size,const uint8_t *crcbuff) {
+	return hdd_write_block(chunkid,version,blocknum,buffer,offset,size,crcbuff,1);
+}
+
 
 
 /* chunk info */
@@ -4389,7 +6117,7 @@ static int hdd_int_create(uint64_t chunkid,uint32_t version) {
 		hdd_chunk_delete(c);
 		return status;
 	}
-	hdd_chunk_release(c);
+	hdd_chunk_release_jsync(c);
 	return MFS_STATUS_OK;
 }
 
@@ -4769,7 +6497,7 @@ static int hdd_int_duplicate(uint64_t chunkid,uint32_t version,uint32_t newversi
 		c->owner->needrefresh = 1;
 		zassert(pthread_mutex_unlock(&folderlock));
 	}
-	hdd_chunk_release(c);
+	hdd_chunk_release_jsync(c);
 	hdd_chunk_release(oc);
 	return MFS_STATUS_OK;
 }
@@ -4813,7 +6541,7 @@ int hdd_rep_setversion(uint64_t chunkid,uint32_t version) {
 		hdd_chunk_release(c);
 		return MFS_ERROR_IO;
 	}
-	hdd_chunk_release(c);
+	hdd_chunk_release_jsync(c);
 	return MFS_STATUS_OK;
 }
 
@@ -4869,7 +6597,7 @@ static int hdd_int_version(uint64_t chunkid,uint32_t version,uint32_t newversion
 	if (status!=MFS_STATUS_OK) {
 		hdd_error_occurred(c,1);	// uses and preserves errno !!!
 	}
-	hdd_chunk_release(c);
+	hdd_chunk_release_jsync(c);
 	return status;
 }
 
@@ -5025,7 +6753,7 @@ static int hdd_int_truncate(uint64_t chunkid,uint32_t version,uint32_t newversio
 	if (status!=MFS_STATUS_OK) {
 		hdd_error_occurred(c,1);	// uses and preserves errno !!!
 	}
-	hdd_chunk_release(c);
+	hdd_chunk_release_jsync(c);
 	return status;
 }
 
@@ -5614,7 +7342,7 @@ static int hdd_int_duptrunc(uint64_t chunkid,uint32_t version,uint32_t newversio
 		c->owner->needrefresh = 1;
 		zassert(pthread_mutex_unlock(&folderlock));
 	}
-	hdd_chunk_release(c);
+	hdd_chunk_release_jsync(c);
 	hdd_chunk_release(oc);
 	return MFS_STATUS_OK;
 }
@@ -5652,59 +7380,11 @@ static int hdd_int_delete(uint64_t chunkid,uint32_t version) {
 			zassert(pthread_mutex_unlock(&folderlock));
 		}
 	}
+	hdd_bcache_invalidate_chunk(c);
 	hdd_chunk_delete(c);
 	return MFS_STATUS_OK;
 }
 
-static void xordata(uint8_t *dst,const uint8_t *src,uint32_t leng) {
-	uint32_t *dst4;
-	const uint32_t *src4;
-#define XOR_ONE_BYTE (*dst++)^=(*src++)
-#define XOR_FOUR_BYTES (*dst4++)^=(*src4++)
-	if (((unsigned long)dst&3)==((unsigned long)src&3)) {
-		while (leng && ((unsigned long)src & 3)) {
-			XOR_ONE_BYTE;
-			leng--;
-		}
-		dst4 = (uint32_t*)dst;
-		src4 = (const uint32_t*)src;
-		while (leng>=32) {
-			XOR_FOUR_BYTES;
-			XOR_FOUR_BYTES;
-			XOR_FOUR_BYTES;
-			XOR_FOUR_BYTES;
-			XOR_FOUR_BYTES;
-			XOR_FOUR_BYTES;
-			XOR_FOUR_BYTES;
-			XOR_FOUR_BYTES;
-			leng-=32;
-		}
-		while (leng>=4) {
-			XOR_FOUR_BYTES;
-			leng-=4;
-		}
-		src = (const uint8_t*)src4;
-		dst = (uint8_t*)dst4;
-		if (leng) do {
-			XOR_ONE_BYTE;
-		} while (--leng);
-	} else {
-		while (leng>=8) {
-			XOR_ONE_BYTE;
-			XOR_ONE_BYTE;
-			XOR_ONE_BYTE;
-			XOR_ONE_BYTE;
-			XOR_ONE_BYTE;
-			XOR_ONE_BYTE;
-			XOR_ONE_BYTE;
-			XOR_ONE_BYTE;
-			leng-=8;
-		}
-		if (leng>0) do {
-			XOR_ONE_BYTE;
-		} while (--leng);
-	}
-}
 #define EXIT_FLAG_SRC_ERROR 0x01
 #define EXIT_FLAG_DST_ERROR 0x02
 #define EXIT_FLAG_SRC_IO 0x04
@@ -5719,11 +7399,15 @@ static int hdd_int_split(uint64_t chunkid,uint32_t version,uint8_t parts,uint32_
 	uint32_t bcrc;
 	uint8_t *ptr;
 	chunk *c,*oc;
-	chunk *ctab[9];
+	chunk *ctab[ECRS_MAX_PARTS];
 	uint8_t *auxblocks;
 	uint8_t pos,bg;
 	const uint8_t* srcptr[32];
 	uint32_t srccrc[32];
+	const uint8_t* dotsrc[ECRS_MAX_DATA_PARTS];
+	uint8_t dotcoefs[ECRS_MAX_DATA_PARTS];
+	uint8_t coefs[ECRS_MAX_DATA_PARTS];
+	uint8_t srccnt,cpart;
 	uint8_t mustreadall;
 	uint32_t i,mask;
 	uint64_t ecidpart;
@@ -5734,7 +7418,7 @@ static int hdd_int_split(uint64_t chunkid,uint32_t version,uint8_t parts,uint32_
 	const uint8_t *p,*e;
 	uint8_t sp;
 	uint32_t nzstart,nzend;
-	uint32_t truncpos[9];
+	uint32_t truncpos[ECRS_MAX_PARTS];
 	uint16_t block,partblock;
 	int32_t retsize;
 	uint8_t part;
@@ -5748,17 +7432,15 @@ static int hdd_int_split(uint64_t chunkid,uint32_t version,uint8_t parts,uint32_
 
 	if (parts==8) {
 		datamask = 0x0FF;
-		csummask = 0x100;
 		ecidstart = UINT64_C(0x2000000000000000);
-		allparts = 9;
 	} else if (parts==4) {
 		datamask = 0x00F;
-		csummask = 0x010;
 		ecidstart = UINT64_C(0x1000000000000000);
-		allparts = 5;
 	} else {
 		return MFS_ERROR_EINVAL;
 	}
+	csummask = ((UINT32_C(1)<<ECRS_MAX_CHKSUM_PARTS)-1)<<parts;
+	allparts = parts+ECRS_MAX_CHKSUM_PARTS;
 
 	if ((missingparts & (datamask|csummask)) != missingparts) {
 		return MFS_ERROR_EINVAL;
@@ -5960,8 +7642,12 @@ static int hdd_int_split(uint64_t chunkid,uint32_t version,uint8_t parts,uint32_
 		}
 
 		if ((parts==8 && (block&0x1F)==0x1F) || (parts==4 && (block&0x0F)==0x0F) || block+1==oc->blocks) {
-			c = ctab[parts];
-			if (c!=NULL) {
+			for (cpart=parts ; cpart<allparts ; cpart++) {
+				c = ctab[cpart];
+				if (c==NULL) {
+					continue;
+				}
+				ecrs_chksum_coefs(parts,cpart-parts,coefs);
 				for (bg=0 ; bg<4 ; bg++) {
 					if (parts==8) {
 						partblock = ((block>>3)&~3) | bg;
@@ -5970,21 +7656,24 @@ static int hdd_int_split(uint64_t chunkid,uint32_t version,uint8_t parts,uint32_
 					}
 					wcrcptr = (c->crc)+4*(partblock);
 					blockptr = auxblocks+(4*parts)*MFSBLOCKSIZE;
-					if (srcptr[bg]!=NULL) {
-						memcpy(blockptr,srcptr[bg],MFSBLOCKSIZE);
-						bcrc = srccrc[bg]^emptyblockcrc;
-					} else {
-						memset(blockptr,0,MFSBLOCKSIZE);
-						bcrc = 0; // emptyblockcrc^emptyblockcrc
-					}
-					for (part=1 ; part<parts ; part++) {
+					srccnt = 0;
+					bcrc = 0;
+					for (part=0 ; part<parts ; part++) {
 						if (srcptr[bg+4*part]!=NULL) {
-							xordata(blockptr,srcptr[bg+4*part],MFSBLOCKSIZE);
+							dotsrc[srccnt] = srcptr[bg+4*part];
+							dotcoefs[srccnt] = coefs[part];
+							srccnt++;
 							bcrc ^= srccrc[bg+4*part];
 						} else {
 							bcrc ^= emptyblockcrc;
 						}
 					}
+					if (cpart==parts) { // first checksum part is a plain xor, so its crc can be calculated from source crc's (parts is even)
+						ecrs_dotprod(blockptr,dotsrc,dotcoefs,srccnt,MFSBLOCKSIZE);
+						bcrc ^= emptyblockcrc;
+					} else {
+						bcrc = ecrs_dotprod_crc(blockptr,dotsrc,dotcoefs,srccnt,MFSBLOCKSIZE);
+					}
 					writeptr = blockptr;
 					if (sp) {
 						// sparsify
@@ -6032,9 +7721,9 @@ static int hdd_int_split(uint64_t chunkid,uint32_t version,uint8_t parts,uint32_
 					}
 					hdd_stats_write(nzend-nzstart);
 					if (nzend!=MFSBLOCKSIZE) {
-						truncpos[parts] = c->hdrsize+CHUNKCRCSIZE+(((uint32_t)partblock)<<MFSBLOCKBITS)+MFSBLOCKSIZE;
+						truncpos[cpart] = c->hdrsize+CHUNKCRCSIZE+(((uint32_t)partblock)<<MFSBLOCKBITS)+MFSBLOCKSIZE;
 					} else {
-						truncpos[parts] = 0;
+						truncpos[cpart] = 0;
 					}
 					put32bit(&wcrcptr,bcrc);
 					if (partblock>=c->blocks) {
@@ -6102,6 +7791,12 @@ static int hdd_int_split(uint64_t chunkid,uint32_t version,uint8_t parts,uint32_
 	f->needrefresh = 1;
 	zassert(pthread_mutex_unlock(&folderlock));
 
+	for (i=0 ; i<allparts ; i++) {
+		if (ctab[i]!=NULL) {
+			hdd_journal_chunk_update(ctab[i]);
+		}
+	}
+	hdd_journal_sync(f);
 	for (i=0 ; i<allparts ; i++) {
 		c = ctab[i];
 		if (c!=NULL) {
@@ -6253,7 +7948,8 @@ chunk* hdd_random_chunk(folder *f) {
 	return NULL;
 }
 
-static int hdd_int_move(folder *fsrc,folder *fdst) {
+/* moves given chunk (or random one when chunkid is zero) from fsrc to fdst */
+static int hdd_int_move(folder *fsrc,folder *fdst,uint64_t chunkid) {
 	uint8_t *wptr;
 	const uint8_t *rptr;
 	uint16_t block;
@@ -6312,10 +8008,33 @@ static int hdd_int_move(folder *fsrc,folder *fdst) {
 		return MFS_ERROR_NOTDONE;
 	}
 	zassert(pthread_mutex_unlock(&folderlock));
-	c = hdd_random_chunk(fsrc);
-	if (c==NULL) {
-		mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"move chunk %s -> %s (can't find valid chunk to move)",fsrc->path,fdst->path);
-		return MFS_ERROR_NOCHUNK;
+	if (chunkid==0) {
+		c = hdd_random_chunk(fsrc);
+		if (c==NULL) {
+			mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"move chunk %s -> %s (can't find valid chunk to move)",fsrc->path,fdst->path);
+			return MFS_ERROR_NOCHUNK;
+		}
+	} else {
+		c = hdd_chunk_tryfind(chunkid);
+		if (c==NULL) {
+			return MFS_ERROR_NOCHUNK;
+		}
+		if (c==CHUNKLOCKED) { // busy - try later
+			return MFS_ERROR_NOTDONE;
+		}
+		if (c->owner!=fsrc || c->damaged) {
+			hdd_chunk_release(c);
+			return MFS_ERROR_NOCHUNK;
+		}
+		if (c->crcrefcount>0) { // being read right now
+			hdd_chunk_release(c);
+			return MFS_ERROR_NOTDONE;
+		}
+		if (c->validattr==0 && hdd_chunk_getattr(c,0)<0) {
+			hdd_error_occurred(c,1);
+			hdd_chunk_release(c);
+			return MFS_ERROR_NOCHUNK;
+		}
 	}
 #ifdef MFSDEBUG
 	mfs_log(MFSLOG_SYSLOG,MFSLOG_DEBUG,"move chunk %s -> %s (chunk: %016"PRIX64"_%08"PRIX32")",fsrc->path,fdst->path,c->chunkid,c->version);
@@ -6526,6 +8245,7 @@ static int hdd_int_move(folder *fsrc,folder *fdst) {
 	zassert(pthread_mutex_lock(&folderlock));
 	fsrc->needrefresh = 1;
 	fdst->needrefresh = 1;
+	hdd_journal_chunk_remove(c);
 	hdd_remove_chunk_from_folder(c,fsrc);
 	hdd_add_chunk_to_folder(c,fdst);
 	zassert(pthread_mutex_unlock(&folderlock));
@@ -6534,7 +8254,8 @@ static int hdd_int_move(folder *fsrc,folder *fdst) {
 	c->pathid = newpathid;
 	hdd_add_chunk_to_test_chain(c,fdst,1);
 	zassert(pthread_mutex_unlock(&testlock));
-	hdd_chunk_release(c);
+	hdd_journal_sync(fsrc); // removal from source has to be stored first - after crash chunk found in both journals could be removed from destination
+	hdd_chunk_release_jsync(c);
 	return MFS_STATUS_OK;
 }
 
@@ -6554,7 +8275,7 @@ int hdd_move(void *fsrcv,void *fdstv) {
 	int status;
 	folder *fsrc = (folder*)fsrcv;
 	folder *fdst = (folder*)fdstv;
-	status = hdd_int_move(fsrc,fdst);
+	status = hdd_int_move(fsrc,fdst,0);
 	if (status!=MFS_STATUS_OK) {
 		// in case of error - wait a little
 		portable_usleep(1000);
@@ -6567,7 +8288,7 @@ static inline int hdd_server_can_be_used_for_replication(folder *f) {
 }
 
 static inline int hdd_server_can_be_used_for_rebalancing(folder *f) {
-	return (hdd_server_can_be_used_for_replication(f) && f->balancemode==REBALANCE_STD && f->total>REBALANCE_TOTAL_MIN);
+	return (hdd_server_can_be_used_for_replication(f) && f->balancemode==REBALANCE_STD && f->fasttier==0 && f->total>REBALANCE_TOTAL_MIN);
 }
 
 static inline int hdd_server_can_be_used_as_a_source(folder *f) {
@@ -6972,7 +8693,7 @@ void* hdd_rebalance_thread(void *arg) {
 #endif
 			}
 			st = monotonic_useconds();
-			if (hdd_int_move(fsrc,fdst)!=MFS_STATUS_OK) {
+			if (hdd_int_move(fsrc,fdst,0)!=MFS_STATUS_OK) {
 				// in case of error - wait a little
 				portable_usleep(1000);
 			}
@@ -7036,6 +8757,219 @@ void* hdd_rebalance_thread(void *arg) {
 	return arg;
 }
 
+/* returns the coldest of few randomly chosen chunks - folderlock has to be locked */
+static uint64_t hdd_tier_cold_chunk(folder *f) {
+	uint32_t i,heat,minheat;
+	uint16_t period;
+	uint64_t chunkid;
+	chunk *c;
+
+	chunkid = 0;
+	minheat = 0;
+	period = hdd_tier_period();
+	zassert(pthread_mutex_lock(&hashlock));
+	for (i=0 ; i<TIER_COLD_SAMPLES && f->chunkcount>0 ; i++) {
+		c = f->chunktab[rndu32_ranged(f->chunkcount)];
+		if (c->state==CH_AVAIL && c->damaged==0) {
+			heat = hdd_chunk_heat(c,period);
+			if (chunkid==0 || heat<minheat) {
+				minheat = heat;
+				chunkid = c->chunkid;
+			}
+		}
+	}
+	zassert(pthread_mutex_unlock(&hashlock));
+	return chunkid;
+}
+
+/* returns next hot chunk stored in standard folder and its folder ; chunks bigger than 'maxsize' are skipped (would be demoted again) - folderlock has to be locked */
+static uint64_t hdd_tier_hot_chunk(folder **fsrc,uint64_t maxsize) {
+	uint64_t chunkid;
+	chunk *c;
+
+	*fsrc = NULL;
+	for (;;) {
+		zassert(pthread_mutex_lock(&tierlock));
+		if (tierpromoteqcnt==0) {
+			zassert(pthread_mutex_unlock(&tierlock));
+			return 0;
+		}
+		chunkid = tierpromoteq[tierpromoteqhead];
+		tierpromoteqhead = (tierpromoteqhead+1)%TIER_PROMOTE_QUEUE;
+		tierpromoteqcnt--;
+		zassert(pthread_mutex_unlock(&tierlock));
+		zassert(pthread_mutex_lock(&hashlock));
+		for (c=hashtab[HASHPOS(chunkid)] ; c && c->chunkid!=chunkid ; c=c->next) {}
+		if (c!=NULL && c->state!=CH_DELETED && c->damaged==0 && c->owner!=NULL && c->owner->fasttier==0 && (uint64_t)(c->blocks)*MFSBLOCKSIZE<maxsize) {
+			*fsrc = c->owner;
+			zassert(pthread_mutex_unlock(&hashlock));
+			return chunkid;
+		}
+		zassert(pthread_mutex_unlock(&hashlock));
+	}
+}
+
+/* local tiering - hot chunks are moved to fast folders ('+' in mfshdd.cfg) and cold ones back to standard folders when fast folders are full */
+void* hdd_tier_thread(void *arg) {
+	folder *f,*fsrc,*fdst;
+	uint64_t chunkid;
+	uint64_t fastused,fasttotal;
+	double usage,dstusage;
+	double monotonic_time;
+	uint32_t perc,stdcnt;
+	uint8_t demote,changed,promote;
+	int status;
+	uint64_t st,en;
+
+	ionice_low();
+
+	demote = 0;
+	for (;;) {
+		zassert(pthread_mutex_lock(&testlock));
+		perc = HDDRebalancePerc;
+		zassert(pthread_mutex_unlock(&testlock));
+		zassert(pthread_mutex_lock(&termlock));
+		if (term) {
+			zassert(pthread_mutex_unlock(&termlock));
+			return arg;
+		}
+		zassert(pthread_mutex_unlock(&termlock));
+
+		zassert(pthread_mutex_lock(&folderlock));
+		fastused = 0;
+		fasttotal = 0;
+		stdcnt = 0;
+		changed = 0;
+		monotonic_time = 0.0;
+		for (f=folderhead ; f ; f=f->next) {
+			if (hdd_server_can_be_used_for_replication(f)) {
+				if (f->needrefresh) {
+					hdd_refresh_usage(f);
+					f->needrefresh = 0;
+					if (monotonic_time==0.0) {
+						monotonic_time = monotonic_seconds();
+					}
+					f->lastrefresh = monotonic_time;
+					changed = 1;
+				}
+				if (f->fasttier) {
+					fastused += f->total - f->avail;
+					fasttotal += f->total;
+				} else {
+					stdcnt++;
+				}
+			}
+		}
+		fsrc = NULL;
+		fdst = NULL;
+		chunkid = 0;
+		if (folderactions && perc>0 && fasttotal>0 && stdcnt>0) {
+			usage = (double)fastused / (double)fasttotal;
+			if (usage*100.0 > TierHighUsage) {
+				demote = 1;
+			} else if (usage*100.0 < TierLowUsage) {
+				demote = 0;
+			}
+			if (demote) {
+				// the most used fast folder -> the least used standard folder
+				usage = 0.0;
+				dstusage = 0.0;
+				for (f=folderhead ; f ; f=f->next) {
+					if (hdd_server_can_be_used_for_replication(f)) {
+						if (f->fasttier && f->chunkcount>0 && (fsrc==NULL || (double)(f->total-f->avail)/f->total > usage)) {
+							fsrc = f;
+							usage = (double)(f->total-f->avail)/f->total;
+						} else if (f->fasttier==0 && f->balancemode!=REBALANCE_FORCE_SRC && f->wfrcount==0 && (double)(f->total-f->avail)/f->total < REBALANCE_DST_MAX_USAGE && (fdst==NULL || (double)(f->total-f->avail)/f->total < dstusage)) {
+							fdst = f;
+							dstusage = (double)(f->total-f->avail)/f->total;
+						}
+					}
+				}
+				if (fsrc!=NULL && fdst!=NULL) {
+					chunkid = hdd_tier_cold_chunk(fsrc);
+				}
+			} else if (fastused*100 < fasttotal*TierLowUsage && TierPromoteReads>0) {
+				// hot chunk -> the least used fast folder
+				dstusage = 0.0;
+				for (f=folderhead ; f ; f=f->next) {
+					if (hdd_server_can_be_used_for_replication(f) && f->fasttier && f->wfrcount==0 && (double)(f->total-f->avail)/f->total*100.0 < TierLowUsage && (fdst==NULL || (double)(f->total-f->avail)/f->total < dstusage)) {
+						fdst = f;
+						dstusage = (double)(f->total-f->avail)/f->total;
+					}
+				}
+				if (fdst!=NULL) {
+					chunkid = hdd_tier_hot_chunk(&fsrc,(fasttotal*TierLowUsage)/100-fastused);
+				}
+			}
+		} else {
+			// tiering not active - forget queued chunks
+			zassert(pthread_mutex_lock(&tierlock));
+			tierpromoteqcnt = 0;
+			zassert(pthread_mutex_unlock(&tierlock));
+		}
+		if (chunkid>0 && fsrc!=NULL && fdst!=NULL) {
+			fsrc->rebalance_in_progress++;
+			fdst->rebalance_in_progress++;
+		} else {
+			chunkid = 0;
+		}
+		zassert(pthread_mutex_unlock(&folderlock));
+		if (changed) {
+#ifdef HAVE___SYNC_FETCH_AND_OP
+			__sync_fetch_and_or(&hddspacerecalc,1);
+#else
+			zassert(pthread_mutex_lock(&dclock));
+			hddspacerecalc = 1;
+			zassert(pthread_mutex_unlock(&dclock));
+#endif
+		}
+		if (chunkid==0) {
+			sleep(1);
+			continue;
+		}
+		st = monotonic_useconds();
+		status = hdd_int_move(fsrc,fdst,chunkid);
+		en = monotonic_useconds();
+		zassert(pthread_mutex_lock(&folderlock));
+		fsrc->rebalance_in_progress--;
+		fdst->rebalance_in_progress--;
+		fdst->rebalance_last_usec = en;
+		promote = fdst->fasttier;
+		zassert(pthread_mutex_unlock(&folderlock));
+		if (status==MFS_STATUS_OK) {
+			hdd_stats_move(0);
+			zassert(pthread_mutex_lock(&tierlock));
+			if (promote) {
+				tierpromotions++;
+			} else {
+				tierdemotions++;
+			}
+			zassert(pthread_mutex_unlock(&tierlock));
+		} else {
+			if (status==MFS_ERROR_NOTDONE && promote) { // busy hot chunk - try again later
+				zassert(pthread_mutex_lock(&tierlock));
+				if (tierpromoteqcnt<TIER_PROMOTE_QUEUE) {
+					tierpromoteq[(tierpromoteqhead+tierpromoteqcnt)%TIER_PROMOTE_QUEUE] = chunkid;
+					tierpromoteqcnt++;
+				}
+				zassert(pthread_mutex_unlock(&tierlock));
+			}
+			portable_usleep(1000);
+		}
+		if (perc<100 && en>st) {
+			en -= st;
+			st = en;
+			en *= 100;
+			en /= perc;
+			en -= st;
+			if (en>0) {
+				portable_usleep(en);
+			}
+		}
+	}
+	return arg;
+}
+
 void* hdd_tester_thread(void* arg) {
 	folder *f,*tf;
 	chunk *c;
@@ -7457,7 +9391,7 @@ void hdd_create_filename_for_path(char fname[PATH_MAX],const char *fpath,uint16_
 	}
 }
 
-static inline void hdd_add_chunk(folder *f,uint16_t pathid,uint64_t chunkid,uint32_t version,uint16_t blocks,uint16_t hdrsize,uint8_t testedflag,uint32_t diskusage) {
+static inline void hdd_add_chunk(folder *f,uint16_t pathid,uint64_t chunkid,uint32_t version,uint16_t blocks,uint16_t hdrsize,uint8_t testedflag,uint32_t diskusage,uint8_t jverify) {
 	struct stat sb;
 	folder *prevf,*currf;
 	chunk *c;
@@ -7469,31 +9403,39 @@ static inline void hdd_add_chunk(folder *f,uint16_t pathid,uint64_t chunkid,uint
 	} else if (f->lmode!=LMODE_NONE) {
 		hdd_create_filename(fname,f->path,pathid,chunkid,version);
 		if (stat(fname,&sb)<0) {
-			if (f->markforremoval!=MFR_READONLY) {
-				hdd_wfr_add(f,chunkid,version,pathid); // add file to 'wait for removal' queue
+			if (jverify==0) {
+				if (f->markforremoval!=MFR_READONLY) {
+					hdd_wfr_add(f,chunkid,version,pathid); // add file to 'wait for removal' queue
+				}
+				return;
 			}
-			return;
-		}
-		if ((sb.st_mode & S_IFMT) != S_IFREG) {
-			mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"%s: is not regular file",fname);
-			return;
-		}
-		hdrsize = (sb.st_size - CHUNKCRCSIZE) & MFSBLOCKMASK;
-		if (hdrsize!=OLDHDRSIZE && hdrsize!=NEWHDRSIZE) {
-			if (f->markforremoval!=MFR_READONLY) {
-				hdd_wfr_add(f,chunkid,version,pathid); // add file to 'wait for removal' queue
+			// chunk from journal could have been renamed just before crash - attributes will be read after verification
+			hdrsize = 0;
+			blocks = 0;
+			diskusage = 0;
+			validattr = 0;
+		} else {
+			if ((sb.st_mode & S_IFMT) != S_IFREG) {
+				mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"%s: is not regular file",fname);
+				return;
+			}
+			hdrsize = (sb.st_size - CHUNKCRCSIZE) & MFSBLOCKMASK;
+			if (hdrsize!=OLDHDRSIZE && hdrsize!=NEWHDRSIZE) {
+				if (f->markforremoval!=MFR_READONLY) {
+					hdd_wfr_add(f,chunkid,version,pathid); // add file to 'wait for removal' queue
+				}
+				return;
 			}
-			return;
-		}
-		if (sb.st_size<(hdrsize+CHUNKCRCSIZE) || sb.st_size>((uint32_t)hdrsize+CHUNKCRCSIZE+MFSCHUNKSIZE)) {
-			if (f->markforremoval!=MFR_READONLY) {
-				hdd_wfr_add(f,chunkid,version,pathid); // add file to 'wait for removal' queue
+			if (sb.st_size<(hdrsize+CHUNKCRCSIZE) || sb.st_size>((uint32_t)hdrsize+CHUNKCRCSIZE+MFSCHUNKSIZE)) {
+				if (f->markforremoval!=MFR_READONLY) {
+					hdd_wfr_add(f,chunkid,version,pathid); // add file to 'wait for removal' queue
+				}
+				return;
 			}
-			return;
+			blocks = (sb.st_size - hdrsize - CHUNKCRCSIZE) / MFSBLOCKSIZE;
+			diskusage = (sb.st_blocks * 512U);
+			validattr = 1;
 		}
-		blocks = (sb.st_size - hdrsize - CHUNKCRCSIZE) / MFSBLOCKSIZE;
-		diskusage = (sb.st_blocks * 512U);
-		validattr = 1;
 	} else {
 		hdrsize = 0;
 		blocks = 0;
@@ -7524,6 +9466,7 @@ static inline void hdd_add_chunk(folder *f,uint16_t pathid,uint64_t chunkid,uint
 			c->diskusage = diskusage;
 			c->hdrsize = hdrsize;
 			c->validattr = validattr;
+			c->jverify = validattr?0:jverify;
 			c->testtime = 0;
 			zassert(pthread_mutex_lock(&testlock));
 			hdd_remove_chunk_from_test_chain(c,prevf);
@@ -7539,6 +9482,7 @@ static inline void hdd_add_chunk(folder *f,uint16_t pathid,uint64_t chunkid,uint
 		c->diskusage = diskusage;
 		c->hdrsize = hdrsize;
 		c->validattr = validattr;
+		c->jverify = validattr?0:jverify;
 		c->testtime = 0;
 		zassert(pthread_mutex_lock(&testlock));
 		hdd_add_chunk_to_test_chain(c,currf,testedflag);
@@ -7547,6 +9491,7 @@ static inline void hdd_add_chunk(folder *f,uint16_t pathid,uint64_t chunkid,uint
 	}
 	zassert(pthread_mutex_lock(&folderlock));
 	if (prevf) {
+		hdd_journal_chunk_remove(c);
 		hdd_remove_chunk_from_folder(c,prevf);
 		if (validattr) {
 			if (prevf->knowncount_next>0 && prevf->knowndiskusage_next>=diskusage) {
@@ -7566,6 +9511,244 @@ static inline void hdd_add_chunk(folder *f,uint16_t pathid,uint64_t chunkid,uint
 	hdd_chunk_release(c);
 }
 
+typedef struct _jentry {
+	uint64_t chunkid;
+	uint32_t version; // 0 - deleted
+	uint16_t pathid;
+} jentry;
+
+typedef struct _jtable {
+	jentry *tab;
+	uint32_t size; // power of 2
+	uint32_t used;
+} jtable;
+
+static void hdd_jtable_put(jtable *jt,uint64_t chunkid,uint32_t version,uint16_t pathid) {
+	uint32_t pos,i;
+	jentry *otab;
+	uint32_t osize;
+
+	if (jt->used*4 >= jt->size*3) {
+		otab = jt->tab;
+		osize = jt->size;
+		jt->size *= 2;
+		jt->tab = calloc(jt->size,sizeof(jentry));
+		passert(jt->tab);
+		jt->used = 0;
+		for (i=0 ; i<osize ; i++) {
+			if (otab[i].chunkid!=0) {
+				hdd_jtable_put(jt,otab[i].chunkid,otab[i].version,otab[i].pathid);
+			}
+		}
+		free(otab);
+	}
+	pos = hash64(chunkid) & (jt->size-1);
+	while (jt->tab[pos].chunkid!=0 && jt->tab[pos].chunkid!=chunkid) {
+		pos = (pos+1) & (jt->size-1);
+	}
+	if (jt->tab[pos].chunkid==0) {
+		jt->tab[pos].chunkid = chunkid;
+		jt->used++;
+	}
+	jt->tab[pos].version = version;
+	jt->tab[pos].pathid = pathid;
+}
+
+static uint8_t* hdd_journal_read_file(const char *fname,uint32_t *leng) {
+	struct stat sb;
+	uint8_t *buff;
+	int fd;
+
+	fd = open(fname,O_RDONLY);
+	if (fd<0) {
+		return NULL;
+	}
+	if (fstat(fd,&sb)<0 || sb.st_size>UINT32_MAX) {
+		close(fd);
+		return NULL;
+	}
+	buff = malloc(sb.st_size+1);
+	if (buff==NULL) {
+		close(fd);
+		return NULL;
+	}
+	if (read(fd,buff,sb.st_size)!=sb.st_size) {
+		free(buff);
+		close(fd);
+		return NULL;
+	}
+	close(fd);
+	*leng = sb.st_size;
+	return buff;
+}
+
+/* no valid '.chunkdb' (crash) - rebuild chunk list from journal snapshot ('.chunkjdb') and following journals */
+static int hdd_folder_journal_load(folder *f,char *fullname,uint16_t plen) {
+	char fname[PATH_MAX];
+	jtable jt;
+	uint8_t *buff;
+	const uint8_t *rptr,*endbuff;
+	uint32_t leng,gen,sgen,maxgen,records,crc,i;
+	uint64_t chunkid,rcnt;
+	uint32_t version;
+	uint16_t pathid;
+	uint8_t type,last,scanterm;
+	uint8_t lastperc,currentperc;
+	uint64_t lasttime,currenttime,begintime;
+
+	if (ChunkJournal==0) {
+		hdd_journal_drop_files(f);
+		return -1;
+	}
+	begintime = monotonic_useconds();
+	memcpy(fullname+plen,".chunkjdb",9);
+	fullname[plen+9] = '\0';
+	buff = hdd_journal_read_file(fullname,&leng);
+	if (buff==NULL) {
+		hdd_journal_drop_files(f);
+		return -1;
+	}
+	rptr = buff;
+	endbuff = buff+leng;
+	if (leng<CHUNKJDB_HDR_SIZE+2 || memcmp(rptr,"MFS CHJSNAP1",CHUNKJDB_HDR_SIZE)!=0) {
+		mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"scanning folder %s: wrong header in .chunkjdb - fallback to standard scan",f->path);
+		free(buff);
+		hdd_journal_drop_files(f);
+		return -1;
+	}
+	rptr += CHUNKJDB_HDR_SIZE;
+	i = get16bit(&rptr);
+	if (rptr+i+4>endbuff || i!=plen || memcmp(rptr,fullname,plen)!=0) {
+		mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"scanning folder %s: wrong path in .chunkjdb - fallback to standard scan",f->path);
+		free(buff);
+		hdd_journal_drop_files(f);
+		return -1;
+	}
+	rptr += i;
+	sgen = get32bit(&rptr);
+	jt.size = 65536;
+	while (jt.size < (endbuff-rptr)/CHUNKJDB_REC_SIZE*2 && jt.size < 0x80000000U) {
+		jt.size *= 2;
+	}
+	jt.tab = calloc(jt.size,sizeof(jentry));
+	passert(jt.tab);
+	jt.used = 0;
+	chunkid = 0;
+	version = 0;
+	pathid = 0;
+	while (rptr+CHUNKJDB_REC_SIZE<=endbuff) {
+		chunkid = get64bit(&rptr);
+		version = get32bit(&rptr);
+		pathid = get16bit(&rptr);
+		if (chunkid==0 || version==0 || pathid>255) {
+			break;
+		}
+		hdd_jtable_put(&jt,chunkid,version,pathid);
+	}
+	free(buff);
+	if (rptr!=endbuff || chunkid!=0 || version!=0 || pathid!=0) {
+		mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"scanning folder %s: data malformed in .chunkjdb - fallback to standard scan",f->path);
+		free(jt.tab);
+		hdd_journal_drop_files(f);
+		return -1;
+	}
+
+	maxgen = hdd_journal_cleanup(f,sgen);
+	if (maxgen<sgen) { // journal is always created before snapshot
+		mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"scanning folder %s: chunk journal %"PRIu32" not found - fallback to standard scan",f->path,sgen);
+		free(jt.tab);
+		hdd_journal_drop_files(f);
+		return -1;
+	}
+	records = 0;
+	for (gen=sgen ; gen<=maxgen ; gen++) {
+		hdd_journal_fname(fname,f,gen);
+		buff = hdd_journal_read_file(fname,&leng);
+		last = (gen==maxgen)?1:0;
+		if (buff==NULL || leng<CHUNKJOURNAL_HDR_SIZE || memcmp(buff,"MFS CHJOURN1",12)!=0) {
+			mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"scanning folder %s: chunk journal %"PRIu32" missing or malformed - fallback to standard scan",f->path,gen);
+			if (buff) {
+				free(buff);
+			}
+			free(jt.tab);
+			hdd_journal_drop_files(f);
+			return -1;
+		}
+		rptr = buff+12;
+		endbuff = buff+leng;
+		if (get32bit(&rptr)!=gen) {
+			mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"scanning folder %s: chunk journal %"PRIu32" has wrong generation - fallback to standard scan",f->path,gen);
+			free(buff);
+			free(jt.tab);
+			hdd_journal_drop_files(f);
+			return -1;
+		}
+		while (rptr+CHUNKJOURNAL_REC_SIZE<=endbuff) {
+			crc = mycrc32(0,rptr,CHUNKJOURNAL_REC_SIZE-4);
+			type = get8bit(&rptr);
+			pathid = get8bit(&rptr);
+			chunkid = get64bit(&rptr);
+			version = get32bit(&rptr);
+			if (get32bit(&rptr)!=crc || chunkid==0 || (type!=CHUNKJOURNAL_PUT && type!=CHUNKJOURNAL_DEL) || (type==CHUNKJOURNAL_PUT && version==0)) {
+				rptr -= CHUNKJOURNAL_REC_SIZE;
+				break;
+			}
+			hdd_jtable_put(&jt,chunkid,(type==CHUNKJOURNAL_PUT)?version:0,pathid);
+			records++;
+		}
+		free(buff);
+		if (rptr!=endbuff && last==0) { // torn record is allowed only at the end of the last journal
+			mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"scanning folder %s: data malformed in chunk journal %"PRIu32" - fallback to standard scan",f->path,gen);
+			free(jt.tab);
+			hdd_journal_drop_files(f);
+			return -1;
+		}
+	}
+	f->jgen = maxgen;
+
+	mfs_log(MFSLOG_SYSLOG,MFSLOG_INFO,"scanning folder %s: valid chunk journal found (snapshot generation %"PRIu32", %"PRIu32" journal records) - full scan not needed",f->path,sgen,records);
+
+	records = jt.used;
+	rcnt = 0;
+	scanterm = 0;
+	lastperc = 0;
+	lasttime = monotonic_useconds();
+
+	for (i=0 ; i<jt.size && scanterm==0 ; i++) {
+		if (jt.tab[i].chunkid==0 || jt.tab[i].version==0) {
+			continue;
+		}
+		// attributes are not journaled - they will be read when chunk is opened (or tested) and then file name is also verified
+		hdd_add_chunk(f,jt.tab[i].pathid,jt.tab[i].chunkid,jt.tab[i].version,0xFFFF,0,0,0,1);
+		rcnt++;
+		if ((rcnt%10000)==0) {
+			currentperc = (rcnt*100)/records;
+			currenttime = monotonic_useconds();
+			zassert(pthread_mutex_lock(&folderlock));
+			if (f->scanstate==SCST_BGJOBTERMINATE) {
+				scanterm = 1;
+			}
+			f->scanprogress = currentperc;
+			zassert(pthread_mutex_unlock(&folderlock));
+			if (currentperc>lastperc && currenttime>lasttime+1000000) {
+				lastperc=currentperc;
+				lasttime=currenttime;
+#ifdef HAVE___SYNC_FETCH_AND_OP
+				__sync_fetch_and_or(&hddspacerecalc,1);
+#else
+				zassert(pthread_mutex_lock(&dclock));
+				hddspacerecalc = 1; // report chunk count to master
+				zassert(pthread_mutex_unlock(&dclock));
+#endif
+				mfs_log(MFSLOG_SYSLOG,MFSLOG_INFO,"scanning folder %s: %"PRIu8"%% (%"PRIu64"s)",f->path,lastperc,(currenttime-begintime)/1000000);
+			}
+		}
+	}
+	free(jt.tab);
+	mfs_log(MFSLOG_SYSLOG,MFSLOG_INFO,"scanning folder %s: chunk journal replayed (%"PRIu64" chunks) in %.3lfs",f->path,rcnt,(monotonic_useconds()-begintime)/1000000.0);
+	return 0;
+}
+
 static inline int hdd_folder_fastscan(folder *f,char *fullname,uint16_t plen) {
 	struct stat sb;
 	int fd;
@@ -7622,7 +9805,7 @@ static inline int hdd_folder_fastscan(folder *f,char *fullname,uint16_t plen) {
 
 	fd = open(fullname,O_RDONLY);
 	if (fd<0) {
-		return -1;
+		return hdd_folder_journal_load(f,fullname,plen);
 	}
 	if (fstat(fd,&sb)<0) {
 		close(fd);
@@ -7746,7 +9929,7 @@ static inline int hdd_folder_fastscan(folder *f,char *fullname,uint16_t plen) {
 		if (chunkid==0 && version==0 && blocks==0 && pathid==0 && testedflag==0 && diskusage==0) {
 			break;
 		}
-		hdd_add_chunk(f,pathid,chunkid,version,blocks,hdrsize,testedflag,diskusage);
+		hdd_add_chunk(f,pathid,chunkid,version,blocks,hdrsize,testedflag,diskusage,0);
 		rcnt++;
 		if ((rcnt%10000)==0) {
 			currentperc = (rcnt*100)/records;
@@ -8047,7 +10230,7 @@ void* hdd_folder_scan(void *arg) {
 						continue;
 					}
 //					memcpy(fullname+plen,de->d_name,36);
-					hdd_add_chunk(f,subf,namechunkid,nameversion,0xFFFF,0,0,0);
+					hdd_add_chunk(f,subf,namechunkid,nameversion,0xFFFF,0,0,0,0);
 					tcheckcnt++;
 					if (tcheckcnt>=1000) {
 						zassert(pthread_mutex_lock(&folderlock));
@@ -8133,6 +10316,7 @@ void hdd_setmetaid(uint64_t metaid) { // metaid has been verified with master -
 void* hdd_folders_thread(void *arg) {
 	for (;;) {
 		hdd_check_folders();
+		hdd_journal_maintenance();
 		zassert(pthread_mutex_lock(&termlock));
 		if (term) {
 			zassert(pthread_mutex_unlock(&termlock));
@@ -8197,6 +10381,7 @@ void hdd_term(void) {
 		zassert(pthread_join(foldersthread,NULL));
 		zassert(pthread_join(hsrebalancethread,NULL));
 		zassert(pthread_join(rebalancethread,NULL));
+		zassert(pthread_join(tierthread,NULL));
 		zassert(pthread_join(delayedthread,NULL));
 	}
 	zassert(pthread_mutex_lock(&folderlock));
@@ -8213,6 +10398,7 @@ void hdd_term(void) {
 			m++;
 		}
 		if (f->scanstate==SCST_WORKING && f->toremove==REMOVING_NO) {
+			hdd_journal_stop(f);
 			hdd_folder_dump_chunkdb_begin(f);
 		}
 	}
@@ -8340,6 +10526,7 @@ void hdd_term(void) {
 		dmcn = dmc->next;
 		free(dmc);
 	}
+	hdd_bcache_term();
 	mfs_log(MFSLOG_SYSLOG,MFSLOG_INFO,"hddspacemgr: terminating done");
 }
 
@@ -8382,7 +10569,7 @@ int hdd_size_parse_u64(const char *str,uint64_t *ret) {
 
 int hdd_parseline(char *hddcfgline) {
 	uint32_t l,p;
-	int lfd,mfr,bm,is;
+	int lfd,mfr,bm,is,ft;
 	int mfd;
 	char *pptr;
 	char *lockfname;
@@ -8506,12 +10693,15 @@ int hdd_parseline(char *hddcfgline) {
 	mfr = MFR_NO;
 	bm = REBALANCE_STD;
 	is = 0;
+	ft = 0;
 	pptr = hddcfgline;
 	while (1) {
 		if (*pptr == '*') {
 			mfr = MFR_YES;
 		} else if (*pptr == '~') {
 			is = 1;
+		} else if (*pptr == '+') {
+			ft = 1;
 		} else if (*pptr == '>') {
 			bm = REBALANCE_FORCE_DST;
 		} else if (*pptr == '<') {
@@ -8760,6 +10950,7 @@ int hdd_parseline(char *hddcfgline) {
 			f->markforremoval = mfr;
 			f->balancemode = bm;
 			f->ignoresize = is;
+			f->fasttier = ft;
 			cl->f = f;
 			zassert(pthread_mutex_unlock(&folderlock));
 			if (lfd>=0) {
@@ -8773,6 +10964,7 @@ int hdd_parseline(char *hddcfgline) {
 	f->markforremoval = mfr;
 	f->balancemode = bm;
 	f->ignoresize = is;
+	f->fasttier = ft;
 	f->damaged = 0;
 	f->scanstate = SCST_SCANNEEDED;
 	f->sendneeded = 0;
@@ -8812,6 +11004,20 @@ int hdd_parseline(char *hddcfgline) {
 	f->lockinode = sb.st_ino;
 	f->lfd = lfd;
 	f->dumpfd = -1;
+	f->jfd = -1;
+	f->jgen = 0;
+	f->jrecords = 0;
+	f->jdirty = 0;
+	f->jdumpneeded = 0;
+	f->jretry = 0.0;
+	f->fsynchead = NULL;
+	f->fsynctail = &(f->fsynchead);
+	f->fsyncqueued = 0;
+	f->fsyncactive = 0;
+	f->fsyncmaxbatch = 0;
+	f->fsyncpass = 0;
+	f->fsyncbatches = 0;
+	f->fsyncbatched = 0;
 	f->testedhead = NULL;
 	f->testedtail = &(f->testedhead);
 	f->testneededhead = NULL;
@@ -9042,6 +11248,9 @@ void hdd_info(FILE *fd) {
 	uint32_t c;
 	folder *f;
 	uint32_t i;
+	uint64_t bcused,bchits,bcmisses,bcevictions;
+	uint64_t promotions,demotions;
+	uint32_t promoteq;
 	double now,wd;
 	uint32_t dur,chdone,etas,etam,etah,etad;
 	time_t t;
@@ -9055,6 +11264,20 @@ void hdd_info(FILE *fd) {
 	zassert(pthread_mutex_lock(&dclock));
 	fprintf(fd,"error counter: %"PRIu32"\n",errorcounter);
 	zassert(pthread_mutex_unlock(&dclock));
+	hdd_bcache_getstats(&bcused,&bchits,&bcmisses,&bcevictions);
+	fprintf(fd,"block cache: %"PRIu64"/%"PRIu64"\n",bcused,BlockCacheSize);
+	fprintf(fd,"block cache hits: %"PRIu64"\nblock cache misses: %"PRIu64"\nblock cache evictions: %"PRIu64"\n",bchits,bcmisses,bcevictions);
+	if (bchits+bcmisses>0) {
+		fprintf(fd,"block cache hit ratio: %.2lf%%\n",100.0*bchits/(bchits+bcmisses));
+	} else {
+		fprintf(fd,"block cache hit ratio: no data\n");
+	}
+	zassert(pthread_mutex_lock(&tierlock));
+	promotions = tierpromotions;
+	demotions = tierdemotions;
+	promoteq = tierpromoteqcnt;
+	zassert(pthread_mutex_unlock(&tierlock));
+	fprintf(fd,"tier promotions: %"PRIu64"\ntier demotions: %"PRIu64"\ntier promote queue: %"PRIu32"\n",promotions,demotions,promoteq);
 	fprintf(fd,"\n");
 	zassert(pthread_mutex_lock(&folderlock));
 	for (f=folderhead ; f ; f=f->next) {
@@ -9064,6 +11287,7 @@ void hdd_info(FILE *fd) {
 		fprintf(fd,"removestate: %s\n",hdd_info_removestate_name(f->toremove));
 		fprintf(fd,"markforremoval: %s\n",hdd_info_markforremoval_name(f->markforremoval));
 		fprintf(fd,"balancemode: %s\n",hdd_info_balancemode_name(f->balancemode));
+		fprintf(fd,"tier: %s\n",(f->fasttier)?"FAST":"STD");
 		fprintf(fd,"damaged: %s\n",(f->damaged)?"YES":"NO");
 		wd = (now - f->totalerrorstart) / 86400.0;
 		fprintf(fd,"totalerrorcounter: %"PRIu32"\nworking_days: %.1lf\navg_errors_per_day: %.4lf\n",f->totalerrorcounter,wd,f->totalerrorcounter/wd);
@@ -9081,7 +11305,22 @@ void hdd_info(FILE *fd) {
 		}
 		fprintf(fd,"worstread: %.6lfs\nworstwrite: %.6lfs\nworstfsync: %.6lfs\n",f->monotonic.nsecreadmax/1000000000.0,f->monotonic.nsecwritemax/1000000000.0,f->monotonic.nsecfsyncmax/1000000000.0);
 		zassert(pthread_mutex_unlock(&statslock));
+		zassert(pthread_mutex_lock(&fsynclock));
+		fprintf(fd,"fsync_queue: %"PRIu32"\nfsync_batches: %"PRIu64"\n",f->fsyncqueued,f->fsyncbatches);
+		if (f->fsyncbatches>0) {
+			fprintf(fd,"fsync_avg_batch: %.2lf\nfsync_max_batch: %"PRIu32"\n",(double)(f->fsyncbatched)/(double)(f->fsyncbatches),f->fsyncmaxbatch);
+		} else {
+			fprintf(fd,"fsync_avg_batch: no data\nfsync_max_batch: 0\n");
+		}
+		zassert(pthread_mutex_unlock(&fsynclock));
 		fprintf(fd,"ignoresize: %u\nscanprogress: %u\n",f->ignoresize,f->scanprogress);
+		zassert(pthread_mutex_lock(&journallock));
+		if (f->jfd>=0) {
+			fprintf(fd,"chunk_journal_gen: %"PRIu32"\nchunk_journal_records: %"PRIu32"\n",f->jgen,f->jrecords);
+		} else {
+			fprintf(fd,"chunk_journal_gen: -\n");
+		}
+		zassert(pthread_mutex_unlock(&journallock));
 		fprintf(fd,"limit_mode: %s\n",hdd_info_limit_mode_name(f->lmode));
 		if (LDATA_IS_RATIO(f->lmode)) {
 			fprintf(fd,"limit_percent: %.4lf\n",f->ldata*100.0);
@@ -9135,6 +11374,8 @@ void hdd_info(FILE *fd) {
 
 static inline void hdd_options_common(uint8_t initflag) {
 	char *LeaveFreeStr;
+	char *BlockCacheStr;
+	uint64_t bcsize;
 	uint8_t sp;
 	uint32_t tmp;
 
@@ -9209,9 +11450,66 @@ static inline void hdd_options_common(uint8_t initflag) {
 	MinTimeBetweenTests = cfg_getsperiod("HDD_MIN_TEST_INTERVAL","1d");
 	MinFlushCacheTime = cfg_getsperiod("HDD_FADVISE_MIN_TIME","1d");
 	zassert(pthread_mutex_unlock(&testlock));
+	zassert(pthread_mutex_lock(&folderlock));
+	TierHighUsage = cfg_getuint32("HDD_TIER_HIGH_USAGE",90);
+	if (TierHighUsage>99) {
+		TierHighUsage = 99;
+	}
+	if (TierHighUsage<2) {
+		TierHighUsage = 2;
+	}
+	TierLowUsage = cfg_getuint32("HDD_TIER_LOW_USAGE",80);
+	if (TierLowUsage>=TierHighUsage) {
+		mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"hdd space manager: HDD_TIER_LOW_USAGE should be lower than HDD_TIER_HIGH_USAGE - changed to %"PRIu32,TierHighUsage-1);
+		TierLowUsage = TierHighUsage-1;
+	}
+	TierPromoteReads = cfg_getuint32("HDD_TIER_PROMOTE_READS",16);
+	if (TierPromoteReads>32768) {
+		TierPromoteReads = 32768;
+	}
+	zassert(pthread_mutex_unlock(&folderlock));
 	zassert(pthread_mutex_lock(&doplock));
 	DoFsyncBeforeClose = cfg_getuint8("HDD_FSYNC_BEFORE_CLOSE",0);
 	zassert(pthread_mutex_unlock(&doplock));
+	zassert(pthread_mutex_lock(&fsynclock));
+	FsyncGroupMin = cfg_getuint32("HDD_FSYNC_GROUP_MIN",0);
+#if !defined(HAVE_SYNCFS) || defined(F_FULLFSYNC)
+	if (FsyncGroupMin>0) {
+		mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"HDD_FSYNC_GROUP_MIN: syncfs is not supported on this platform - fsyncs will be grouped, but every file will be synced separately");
+	}
+#endif
+	zassert(pthread_mutex_unlock(&fsynclock));
+
+	ChunkJournal = cfg_getuint8("HDD_CHUNKDB_JOURNAL",1);
+
+	UseIOUring = cfg_getuint8("HDD_USE_IO_URING",0);
+#ifndef USE_IO_URING
+	if (UseIOUring) {
+		mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_NOTICE,"hdd space manager: io_uring is not supported in this build - ignoring HDD_USE_IO_URING option");
+		UseIOUring = 0;
+	}
+#endif
+	tmp = cfg_getuint32("HDD_IO_URING_DEPTH",16);
+	if (tmp<2) {
+		mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"hdd space manager: io_uring depth too small - changed to 2");
+		tmp = 2;
+	} else if (tmp>IO_URING_MAX_DEPTH) {
+		mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"hdd space manager: io_uring depth too big - changed to %u",IO_URING_MAX_DEPTH);
+		tmp = IO_URING_MAX_DEPTH;
+	}
+	IOUringDepth = tmp;
+
+	ReadSendfileMode = cfg_getuint8("HDD_READ_SENDFILE",0);
+#ifndef HAVE_SYS_SENDFILE_H
+	if (ReadSendfileMode) {
+		mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_NOTICE,"hdd space manager: sendfile is not supported in this build - ignoring HDD_READ_SENDFILE option");
+		ReadSendfileMode = 0;
+	}
+#endif
+	if (ReadSendfileMode>2) {
+		mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"hdd space manager: unknown HDD_READ_SENDFILE mode (%"PRIu8") - using 1 (verify data)",ReadSendfileMode);
+		ReadSendfileMode = 1;
+	}
 
 	LeaveFreeStr = cfg_getstr("HDD_LEAVE_SPACE_DEFAULT","256MiB");
 	if (hdd_size_parse_u64(LeaveFreeStr,&LeaveFree)<0) {
@@ -9227,6 +11525,17 @@ static inline void hdd_options_common(uint8_t initflag) {
 		mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_NOTICE,"hdd space manager: HDD_LEAVE_SPACE_DEFAULT < chunk size - leaving so small space on hdd is not recommended");
 	}
 
+	BlockCacheStr = cfg_getstr("HDD_BLOCK_CACHE_SIZE","0");
+	if (hdd_size_parse_u64(BlockCacheStr,&bcsize)<0) {
+		mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"hdd space manager: HDD_BLOCK_CACHE_SIZE parse error - %s",initflag?"block cache disabled":"left unchanged");
+	} else if (bcsize!=BlockCacheSize) {
+		hdd_bcache_resize(bcsize);
+		if (bcsize>0 && ReadSendfileMode>0) {
+			mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_NOTICE,"hdd space manager: block cache is not used for reads done by sendfile (HDD_READ_SENDFILE)");
+		}
+	}
+	free(BlockCacheStr);
+
 	sp = cfg_getuint8("HDD_SPARSIFY_ON_WRITE",1);
 #ifdef HAVE___SYNC_OP_AND_FETCH
 	if (sp) {
@@ -9261,6 +11570,7 @@ int hdd_late_init(void) {
 	zassert(lwt_minthread_create(&testerthread,0,hdd_tester_thread,NULL));
 	zassert(lwt_minthread_create(&foldersthread,0,hdd_folders_thread,NULL));
 	zassert(lwt_minthread_create(&rebalancethread,0,hdd_rebalance_thread,NULL));
+	zassert(lwt_minthread_create(&tierthread,0,hdd_tier_thread,NULL));
 	zassert(lwt_minthread_create(&hsrebalancethread,0,hdd_highspeed_rebalance_thread,NULL));
 	zassert(lwt_minthread_create(&delayedthread,0,hdd_delayed_thread,NULL));
 	return 0;
@@ -9321,6 +11631,9 @@ int hdd_init(void) {
 	zassert(pthread_key_create(&hdrbufferkey,free));
 	zassert(pthread_key_create(&blockbufferkey,hdd_blockbuffer_free));
 #endif /* PRESERVE_BLOCK */
+#ifdef USE_IO_URING
+	zassert(pthread_key_create(&uringkey,hdd_uring_free));
+#endif
 
 	emptyblockcrc = mycrc32_zeroblock(0,MFSBLOCKSIZE);
 	myalloc(emptychunkcrc,CHUNKCRCSIZE);
@@ -9329,6 +11642,8 @@ int hdd_init(void) {
 	for (i=0 ; i<CHUNKCRCSIZE ; i+=sizeof(uint32_t)) {
 		put32bit(&ptr,emptyblockcrc);
 	}
+	ecrs_init();
+	hdd_bcache_init();
 
 	hdd_options_common(1);
 
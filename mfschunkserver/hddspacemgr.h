@@ -25,6 +25,7 @@
 #include "MFSCommunication.h"
 
 void hdd_stats(uint64_t *br,uint64_t *bw,uint32_t *opr,uint32_t *opw,uint32_t *dbr,uint32_t *dbw,uint32_t *dopr,uint32_t *dopw,uint32_t *movl,uint32_t *movh,uint64_t *rtime,uint64_t *wtime);
+void hdd_block_cache_stats(uint32_t *hits,uint32_t *misses);
 void hdd_op_stats(uint32_t *op_create,uint32_t *op_delete,uint32_t *op_version,uint32_t *op_duplicate,uint32_t *op_truncate,uint32_t *op_duptrunc,uint32_t *op_test,uint32_t *op_split);
 void hdd_get_chart_data(uint32_t *copychunkcount,uint32_t *ec4chunkcount,uint32_t *ec8chunkcount,uint32_t *hddok,uint32_t *hddmfr,uint32_t *hdddmg,uint32_t *usagediff);
 uint32_t hdd_errorcounter(void);
@@ -82,7 +83,13 @@ void hdd_precache_data(uint64_t chunkid,uint32_t offset,uint32_t size);
 int hdd_open(uint64_t chunkid,uint32_t version);
 int hdd_close(uint64_t chunkid,uint8_t forcefsync);
 int hdd_read(uint64_t chunkid,uint32_t version,uint16_t blocknum,uint8_t *buffer,uint32_t offset,uint32_t size,uint8_t *crcbuff);
+uint32_t hdd_read_batch_size(void);
+int hdd_read_multi(uint64_t chunkid,uint32_t version,uint32_t offset,uint32_t size,uint8_t * const *buffers,uint8_t * const *crcbuffs,uint16_t *okblocks);
+uint8_t hdd_read_sendfile_mode(void);
+int hdd_read_sendfile(uint64_t chunkid,uint32_t version,uint16_t firstblock,uint16_t blockcnt,uint8_t verify,uint8_t * const *crcbuffs,uint16_t *okblocks,int *fd,uint64_t *foffset);
+void hdd_read_sendfile_stats(uint64_t chunkid,uint32_t size,uint64_t rtime);
 int hdd_write(uint64_t chunkid,uint32_t version,uint16_t blocknum,const uint8_t *buffer,uint32_t offset,uint32_t size,const uint8_t *crcbuff);
+int hdd_write_verified(uint64_t chunkid,uint32_t version,uint16_t blocknum,const uint8_t *buffer,uint32_t offset,uint32_t size,const uint8_t *crcbuff);
 
 /* chunk info */
 int hdd_get_chunk_info(uint64_t chunkid,uint32_t version,uint8_t requested_info,uint8_t *info_buff);
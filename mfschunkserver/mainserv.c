@@ -45,6 +45,7 @@
 #include "lwthread.h"
 #include "clocks.h"
 #include "portable.h"
+#include "pcqueue.h"
 #include "mainserv.h"
 #ifdef USE_CONNCACHE
 #include "conncache.h"
@@ -52,8 +53,13 @@
 #ifdef HAVE_SYS_MMAN_H
 #include <sys/mman.h>
 #endif
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
+#endif
 
-#include "crc.h" // tests only
+#include "crc.h"
 
 
 #define SERV_TIMEOUT 5000
@@ -62,6 +68,21 @@
 
 #define SMALL_PACKET_SIZE 12
 
+/* max number of blocks read from disk at once (io_uring / sendfile) */
+#define MAINSERV_READ_MAX_BATCH 64
+
+/* CSTOCL_READ_DATA header: cmd,leng,chunkid,blocknum,blockoffset,blocksize,crc */
+#define READ_DATA_HDR_SIZE (8+8+2+2+4+4)
+
+/* CLTOCS_WRITE_DATA header: cmd,leng,chunkid,writeid,blocknum,offset,size,crc */
+#define WRITE_DATA_HDR_SIZE (8+8+4+2+2+4+4)
+
+/* write data is forwarded (and its crc calculated) in pieces of this size */
+#define WRITE_FORWARD_PIECE 16384
+
+/* max number of write statuses sent to previous server in one packet train */
+#define WRITE_ACK_BATCH 64
+
 #define CONNECT_RETRIES 10
 #define CONNECT_TIMEOUT(cnt) (((cnt)%2)?(300*(1<<((cnt)>>1))):(200*(1<<((cnt)>>1))))
 
@@ -141,6 +162,77 @@ static inline void mainserv_bytesout(uint64_t bytes) {
 #endif
 }
 
+/* write chain latency histograms - bucket 'b' counts times from 2^b to 2^(b+1) microseconds */
+#define WLAT_BUCKETS 32
+enum {WLAT_NEXT,WLAT_LOCAL,WLAT_KINDS};
+
+static uint32_t wlat_hist[WLAT_KINDS][WLAT_BUCKETS];
+
+static inline void mainserv_wlat_add(uint8_t kind,uint64_t usec) {
+	uint32_t b;
+	b = 0;
+	while (usec>1 && b<WLAT_BUCKETS-1) {
+		usec >>= 1;
+		b++;
+	}
+#ifdef HAVE___SYNC_FETCH_AND_OP
+	__sync_fetch_and_add(wlat_hist[kind]+b,1);
+#else
+	zassert(pthread_mutex_lock(&statslock));
+	wlat_hist[kind][b]++;
+	zassert(pthread_mutex_unlock(&statslock));
+#endif
+}
+
+static inline uint32_t mainserv_wlat_percentile(const uint32_t *hist,uint32_t total,uint32_t pct) {
+	uint64_t target,sum,lo,hi;
+	uint32_t b;
+	if (total==0) {
+		return 0;
+	}
+	target = ((uint64_t)total * pct + 99) / 100;
+	sum = 0;
+	for (b=0 ; b<WLAT_BUCKETS ; b++) {
+		if (hist[b]>0 && sum+hist[b]>=target) {
+			lo = (b==0)?0:(UINT64_C(1)<<b);
+			hi = UINT64_C(2)<<b;
+			return lo + ((hi-lo) * (target-sum)) / hist[b];
+		}
+		sum += hist[b];
+	}
+	return UINT32_C(0xFFFFFFFF);
+}
+
+/* median and 99th percentile of next hop ack times and local write times (in microseconds) since last call */
+void mainserv_write_latency(uint32_t *nextp50,uint32_t *nextp99,uint32_t *localp50,uint32_t *localp99) {
+	uint32_t hist[WLAT_KINDS][WLAT_BUCKETS];
+	uint32_t total[WLAT_KINDS];
+	uint32_t k,b;
+
+#ifndef HAVE___SYNC_FETCH_AND_OP
+	zassert(pthread_mutex_lock(&statslock));
+#endif
+	for (k=0 ; k<WLAT_KINDS ; k++) {
+		total[k] = 0;
+		for (b=0 ; b<WLAT_BUCKETS ; b++) {
+#ifdef HAVE___SYNC_FETCH_AND_OP
+			hist[k][b] = __sync_fetch_and_and(wlat_hist[k]+b,0);
+#else
+			hist[k][b] = wlat_hist[k][b];
+			wlat_hist[k][b] = 0;
+#endif
+			total[k] += hist[k][b];
+		}
+	}
+#ifndef HAVE___SYNC_FETCH_AND_OP
+	zassert(pthread_mutex_unlock(&statslock));
+#endif
+	*nextp50 = mainserv_wlat_percentile(hist[WLAT_NEXT],total[WLAT_NEXT],50);
+	*nextp99 = mainserv_wlat_percentile(hist[WLAT_NEXT],total[WLAT_NEXT],99);
+	*localp50 = mainserv_wlat_percentile(hist[WLAT_LOCAL],total[WLAT_LOCAL],50);
+	*localp99 = mainserv_wlat_percentile(hist[WLAT_LOCAL],total[WLAT_LOCAL],99);
+}
+
 static inline int32_t mainserv_toread(int sock,uint8_t *ptr,uint32_t leng,uint32_t timeout) {
 	int32_t r;
 	r = tcptoread(sock,ptr,leng,timeout,timeout*30);
@@ -173,6 +265,29 @@ static inline int32_t mainserv_toforward(int sock1,int sock2,uint8_t *ptr,uint32
 	return r;
 }
 
+/* forwards CLTOCS_WRITE_DATA packet (header already received) to the next server while it arrives and calculates crc of its data in the meantime */
+static inline int32_t mainserv_forward_data(int sock1,int sock2,uint8_t *ptr,uint32_t leng,uint32_t *crc,uint32_t timeout) {
+	uint32_t pos,end,crcpos;
+
+	*crc = 0;
+	pos = 8;
+	while (pos<leng) {
+		end = pos + WRITE_FORWARD_PIECE;
+		if (end>leng) {
+			end = leng;
+		}
+		if (mainserv_toforward(sock1,sock2,ptr,end,pos,(pos==8)?0:pos,timeout)!=(int32_t)end) {
+			return -1;
+		}
+		if (end>WRITE_DATA_HDR_SIZE) {
+			crcpos = (pos>WRITE_DATA_HDR_SIZE)?pos:WRITE_DATA_HDR_SIZE;
+			*crc = mycrc32(*crc,ptr+crcpos,end-crcpos);
+		}
+		pos = end;
+	}
+	return leng;
+}
+
 uint8_t* mainserv_create_packet(uint8_t **wptr,uint32_t cmd,uint32_t leng) {
 	uint8_t *ptr;
 	ptr = malloc(leng+8);
@@ -337,6 +452,71 @@ static inline void mainserv_sock_nop_del(sock_nops* sn) {
 	sn->bytesleft = 0;
 }
 
+#ifdef HAVE_SYS_SENDFILE_H
+/* sends packet header followed by 'leng' bytes taken directly (without copying to user space) from file 'fd' at 'foffset' */
+static int32_t mainserv_sendfile(int sock,const uint8_t *hdr,uint32_t hleng,int fd,uint64_t foffset,uint32_t leng,uint32_t timeout) {
+	uint32_t sent,total;
+	ssize_t i;
+	off_t off;
+	struct pollfd pfd;
+	uint64_t deadline,now;
+	uint32_t msecpoll;
+
+	sent = 0;
+	total = hleng+leng;
+	deadline = 0;
+	pfd.fd = sock;
+	pfd.events = POLLOUT;
+	while (sent<total) {
+		if (sent<hleng) {
+#ifdef MSG_MORE
+			i = send(sock,hdr+sent,hleng-sent,MSG_MORE);
+#else
+			i = write(sock,hdr+sent,hleng-sent);
+#endif
+		} else {
+			off = foffset+(sent-hleng);
+			i = sendfile(sock,fd,&off,total-sent);
+			if (i==0) { // file has been truncated in the meantime
+				errno = EIO;
+				break;
+			}
+		}
+		if (i>0) {
+			sent += i;
+			continue;
+		}
+		if (ERRNO_ERROR) {
+			break;
+		}
+		now = monotonic_useconds();
+		if (deadline==0) {
+			deadline = now + (uint64_t)timeout*30000;
+		} else if (now>=deadline) {
+			errno = ETIMEDOUT;
+			break;
+		}
+		msecpoll = (deadline-now)/1000;
+		if (msecpoll>timeout) {
+			msecpoll = timeout;
+		}
+		pfd.revents = 0;
+		i = poll(&pfd,1,msecpoll);
+		if (i<0 && errno!=EINTR) {
+			break;
+		}
+		if (i==0) {
+			errno = ETIMEDOUT;
+			break;
+		}
+	}
+	if (sent>0) {
+		mainserv_bytesout(sent);
+	}
+	return (sent==total)?(int32_t)sent:-1;
+}
+#endif
+
 uint8_t mainserv_read(int sock,const uint8_t *data,uint32_t length) {
 	uint64_t chunkid;
 	uint32_t version;
@@ -354,6 +534,20 @@ uint8_t mainserv_read(int sock,const uint8_t *data,uint32_t length) {
 	const uint8_t *rptr;
 	uint8_t hdr[8];
 	uint32_t cmd,leng;
+	uint32_t batch,bcnt,bsum;
+	uint16_t okblocks;
+	uint8_t *bpackets[MAINSERV_READ_MAX_BATCH];
+	uint8_t *bbuffs[MAINSERV_READ_MAX_BATCH];
+	uint8_t *bcrcs[MAINSERV_READ_MAX_BATCH];
+	uint32_t bsizes[MAINSERV_READ_MAX_BATCH];
+#ifdef HAVE_SYS_SENDFILE_H
+	uint8_t sfmode;
+	uint8_t sfhdrs[MAINSERV_READ_MAX_BATCH][READ_DATA_HDR_SIZE];
+	int sffd;
+	uint64_t sfoffset;
+	uint64_t sfstart;
+#endif
+	uint32_t sfsent;
 	sock_nops sn;
 
 	if (length!=20 && length!=21) {
@@ -423,52 +617,195 @@ uint8_t mainserv_read(int sock,const uint8_t *data,uint32_t length) {
 		}
 	}
 	rcvd = 0;
+	batch = hdd_read_batch_size();
+	if (batch>MAINSERV_READ_MAX_BATCH) {
+		batch = MAINSERV_READ_MAX_BATCH;
+	}
+#ifdef HAVE_SYS_SENDFILE_H
+	sfmode = hdd_read_sendfile_mode();
+#endif
 	while (size>0) {
-		blocknum = (offset)>>MFSBLOCKBITS;
-		blockoffset = (offset)&MFSBLOCKMASK;
-		if (((offset+size-1)>>MFSBLOCKBITS) == blocknum) {	// last block
-			blocksize = size;
-		} else {
-			blocksize = MFSBLOCKSIZE-blockoffset;
-		}
-		packet = mainserv_create_packet(&wptr,CSTOCL_READ_DATA,8+2+2+4+4+blocksize);
-		put64bit(&wptr,chunkid);
-		put16bit(&wptr,blocknum);
-		put16bit(&wptr,blockoffset);
-		put32bit(&wptr,blocksize);
-		if (protover) {
-			mainserv_sock_nop_add(&sn);
-		}
-		status = hdd_read(chunkid,version,blocknum,wptr+4,blockoffset,blocksize,wptr);
-		if (protover) {
-			mainserv_sock_nop_del(&sn);
-			if (sn.error) {
+		sfsent = 0;
+#ifdef HAVE_SYS_SENDFILE_H
+		if (sfmode && (offset&MFSBLOCKMASK)==0 && size>=MFSBLOCKSIZE) { // whole blocks - send them directly from file
+			bcnt = size>>MFSBLOCKBITS;
+			if (bcnt>MAINSERV_READ_MAX_BATCH) {
+				bcnt = MAINSERV_READ_MAX_BATCH;
+			}
+			blocknum = offset>>MFSBLOCKBITS;
+			for (i=0 ; i<(int32_t)bcnt ; i++) {
+				wptr = sfhdrs[i];
+				put32bit(&wptr,CSTOCL_READ_DATA);
+				put32bit(&wptr,8+2+2+4+4+MFSBLOCKSIZE);
+				put64bit(&wptr,chunkid);
+				put16bit(&wptr,blocknum+i);
+				put16bit(&wptr,0);
+				put32bit(&wptr,MFSBLOCKSIZE);
+				bcrcs[i] = wptr;
+			}
+			if (protover) {
+				mainserv_sock_nop_add(&sn);
+			}
+			status = hdd_read_sendfile(chunkid,version,blocknum,bcnt,(sfmode==1)?1:0,bcrcs,&okblocks,&sffd,&sfoffset);
+			if (protover) {
+				mainserv_sock_nop_del(&sn);
+				if (sn.error) {
+					hdd_close(chunkid,0);
+					return 0;
+				}
+			}
+			if (status!=MFS_STATUS_OK) {
 				hdd_close(chunkid,0);
-				return 0;
+				packet = mainserv_create_packet(&wptr,CSTOCL_READ_STATUS,8+1);
+				put64bit(&wptr,chunkid);
+				put8bit(&wptr,status);
+				ret = mainserv_send_and_free("read status",sock,packet,8+1);
+#ifdef HAVE___SYNC_FETCH_AND_OP
+				__sync_fetch_and_add(&stats_hlopr,1);
+#else
+				zassert(pthread_mutex_lock(&statslock));
+				stats_hlopr++;
+				zassert(pthread_mutex_unlock(&statslock));
+#endif
+				return ret;
+			}
+			if (okblocks==0) { // blocks not available this way (not present in file etc.) - use normal path for the rest of this request
+				sfmode = 0;
+			}
+			sfstart = monotonic_nseconds();
+			for (i=0 ; i<(int32_t)okblocks ; i++) {
+				if (mainserv_sendfile(sock,sfhdrs[i],READ_DATA_HDR_SIZE,sffd,sfoffset+(((uint64_t)i)<<MFSBLOCKBITS),MFSBLOCKSIZE,SERV_TIMEOUT)<0) {
+					if (errno==EPIPE || errno==ECONNRESET) {
+						mfs_log(MFSLOG_SYSLOG,MFSLOG_NOTICE,"sendfile: 'send(read data)' disconnected");
+					} else {
+						mfs_log(MFSLOG_ERRNO_SYSLOG,MFSLOG_NOTICE,"sendfile: 'send(read data)' failed");
+					}
+					hdd_close(chunkid,0);
+					return 0;
+				}
+			}
+			sfsent = ((uint32_t)okblocks)<<MFSBLOCKBITS;
+			if (sfmode==2 && sfsent>0) { // data has been read from disk by sendfile - charge it to disk stats
+				hdd_read_sendfile_stats(chunkid,sfsent,monotonic_nseconds()-sfstart);
 			}
 		}
-		if (status!=MFS_STATUS_OK) {
-			free(packet);
-			hdd_close(chunkid,0);
-			packet = mainserv_create_packet(&wptr,CSTOCL_READ_STATUS,8+1);
+#endif
+		if (sfsent>0) {
+			offset += sfsent;
+			size -= sfsent;
+		} else if (batch>1 && ((offset&MFSBLOCKMASK)+size)>MFSBLOCKSIZE) { // more than one block - read them at once
+			bcnt = 0;
+			bsum = 0;
+			while (bcnt<batch && bsum<size) {
+				blocknum = (offset+bsum)>>MFSBLOCKBITS;
+				blockoffset = (offset+bsum)&MFSBLOCKMASK;
+				if (((offset+size-1)>>MFSBLOCKBITS) == blocknum) {	// last block
+					blocksize = size-bsum;
+				} else {
+					blocksize = MFSBLOCKSIZE-blockoffset;
+				}
+				bpackets[bcnt] = mainserv_create_packet(&wptr,CSTOCL_READ_DATA,8+2+2+4+4+blocksize);
+				put64bit(&wptr,chunkid);
+				put16bit(&wptr,blocknum);
+				put16bit(&wptr,blockoffset);
+				put32bit(&wptr,blocksize);
+				bcrcs[bcnt] = wptr;
+				bbuffs[bcnt] = wptr+4;
+				bsizes[bcnt] = blocksize;
+				bsum += blocksize;
+				bcnt++;
+			}
+			if (protover) {
+				mainserv_sock_nop_add(&sn);
+			}
+			status = hdd_read_multi(chunkid,version,offset,bsum,bbuffs,bcrcs,&okblocks);
+			if (protover) {
+				mainserv_sock_nop_del(&sn);
+				if (sn.error) {
+					for (i=0 ; i<(int32_t)bcnt ; i++) {
+						free(bpackets[i]);
+					}
+					hdd_close(chunkid,0);
+					return 0;
+				}
+			}
+			for (i=0 ; i<(int32_t)bcnt ; i++) {
+				if (i<(int32_t)okblocks) {
+					if (mainserv_send_and_free("read data",sock,bpackets[i],8+2+2+4+4+bsizes[i])==0) {
+						for (i++ ; i<(int32_t)bcnt ; i++) {
+							free(bpackets[i]);
+						}
+						hdd_close(chunkid,0);
+						return 0;
+					}
+				} else {
+					free(bpackets[i]);
+				}
+			}
+			if (status!=MFS_STATUS_OK) {
+				hdd_close(chunkid,0);
+				packet = mainserv_create_packet(&wptr,CSTOCL_READ_STATUS,8+1);
+				put64bit(&wptr,chunkid);
+				put8bit(&wptr,status);
+				ret = mainserv_send_and_free("read status",sock,packet,8+1);
+#ifdef HAVE___SYNC_FETCH_AND_OP
+				__sync_fetch_and_add(&stats_hlopr,1);
+#else
+				zassert(pthread_mutex_lock(&statslock));
+				stats_hlopr++;
+				zassert(pthread_mutex_unlock(&statslock));
+#endif
+				return ret;
+			}
+			offset += bsum;
+			size -= bsum;
+		} else {
+			blocknum = (offset)>>MFSBLOCKBITS;
+			blockoffset = (offset)&MFSBLOCKMASK;
+			if (((offset+size-1)>>MFSBLOCKBITS) == blocknum) {	// last block
+				blocksize = size;
+			} else {
+				blocksize = MFSBLOCKSIZE-blockoffset;
+			}
+			packet = mainserv_create_packet(&wptr,CSTOCL_READ_DATA,8+2+2+4+4+blocksize);
 			put64bit(&wptr,chunkid);
-			put8bit(&wptr,status);
-			ret = mainserv_send_and_free("read status",sock,packet,8+1);
+			put16bit(&wptr,blocknum);
+			put16bit(&wptr,blockoffset);
+			put32bit(&wptr,blocksize);
+			if (protover) {
+				mainserv_sock_nop_add(&sn);
+			}
+			status = hdd_read(chunkid,version,blocknum,wptr+4,blockoffset,blocksize,wptr);
+			if (protover) {
+				mainserv_sock_nop_del(&sn);
+				if (sn.error) {
+					hdd_close(chunkid,0);
+					return 0;
+				}
+			}
+			if (status!=MFS_STATUS_OK) {
+				free(packet);
+				hdd_close(chunkid,0);
+				packet = mainserv_create_packet(&wptr,CSTOCL_READ_STATUS,8+1);
+				put64bit(&wptr,chunkid);
+				put8bit(&wptr,status);
+				ret = mainserv_send_and_free("read status",sock,packet,8+1);
 #ifdef HAVE___SYNC_FETCH_AND_OP
-			__sync_fetch_and_add(&stats_hlopr,1);
+				__sync_fetch_and_add(&stats_hlopr,1);
 #else
-			zassert(pthread_mutex_lock(&statslock));
-			stats_hlopr++;
-			zassert(pthread_mutex_unlock(&statslock));
+				zassert(pthread_mutex_lock(&statslock));
+				stats_hlopr++;
+				zassert(pthread_mutex_unlock(&statslock));
 #endif
-			return ret;
-		}
-		if (mainserv_send_and_free("read data",sock,packet,8+2+2+4+4+blocksize)==0) {
-			hdd_close(chunkid,0);
-			return 0;
+				return ret;
+			}
+			if (mainserv_send_and_free("read data",sock,packet,8+2+2+4+4+blocksize)==0) {
+				hdd_close(chunkid,0);
+				return 0;
+			}
+			offset += blocksize;
+			size -= blocksize;
 		}
-		offset += blocksize;
-		size -= blocksize;
 		i = read(sock,hdr+rcvd,(8-rcvd));
 		if (i<0) { // error or nothing to read
 			if (ERRNO_ERROR) {
@@ -508,6 +845,604 @@ uint8_t mainserv_read(int sock,const uint8_t *data,uint32_t length) {
 	return ret;
 }
 
+/* event driven read data plane - fixed number of reactor threads serve many read requests at once, blocking disk operations are done by small pool of i/o threads */
+
+#define RX_MAX_REQUESTS 4096
+#define RX_MIN_BATCH 8
+#define RX_POLL_TIMEOUT 100
+
+enum {RX_OPEN,RX_DATA,RX_FINISH,RX_DONE};
+
+typedef struct rx_packet {
+	uint8_t *packet;
+	const uint8_t *startptr;
+	uint32_t bytesleft;
+	struct rx_packet *next;
+} rx_packet;
+
+struct reactor;
+
+typedef struct rx_request {
+	int sock;
+	uint8_t protover;
+	uint8_t phase;
+	uint8_t failed;
+	uint8_t opened;
+	uint8_t iobusy;
+	uint8_t hddstatus; // set by i/o thread
+	uint64_t chunkid;
+	uint32_t version;
+	uint32_t offset,size; // range not read yet (i/o thread only)
+	rx_packet *iohead,**iotail; // packets prepared by i/o thread
+	rx_packet *outhead,**outtail;
+	uint32_t outbytes;
+	uint32_t hdrrcvd;
+	uint8_t hdr[8];
+	uint64_t lastprogress,lastsend;
+	void (*callback)(uint8_t status,void *extra);
+	void *extra;
+	struct reactor *rx;
+	struct rx_request *ionext;
+	struct rx_request *next,**prev;
+} rx_request;
+
+typedef struct reactor {
+	pthread_t thread_id;
+	int pipe[2];
+	pthread_mutex_t lock;
+	rx_request *newhead; // waiting for reactor (lock)
+	rx_request *iodone; // i/o finished (lock)
+	uint8_t notified; // (lock)
+	uint32_t reqcnt; // (lock)
+	rx_request *head; // reactor thread only
+	uint8_t term;
+} reactor;
+
+static reactor *reactors = NULL;
+static uint32_t reactors_cnt = 0;
+static uint32_t reactors_next = 0;
+static uint32_t rx_io_threads_cnt = 0;
+static pthread_t *rx_io_threads;
+static void *rx_ioqueue = NULL;
+
+static inline void mainserv_rx_wakeup(reactor *rx) {
+	uint8_t b = 0;
+	if (rx->notified==0) {
+		rx->notified = 1;
+		eassert(write(rx->pipe[1],&b,1)==1);
+	}
+}
+
+static inline void mainserv_rx_append(rx_request *rr,uint8_t *packet,uint32_t leng) {
+	rx_packet *p;
+	p = malloc(sizeof(rx_packet));
+	passert(p);
+	p->packet = packet;
+	p->startptr = packet;
+	p->bytesleft = leng;
+	p->next = NULL;
+	*(rr->outtail) = p;
+	rr->outtail = &(p->next);
+	rr->outbytes += leng;
+}
+
+static inline void mainserv_rx_status(rx_request *rr,uint8_t status) {
+	uint8_t *packet,*wptr;
+	packet = mainserv_create_packet(&wptr,CSTOCL_READ_STATUS,8+1);
+	put64bit(&wptr,rr->chunkid);
+	put8bit(&wptr,status);
+	mainserv_rx_append(rr,packet,8+8+1);
+	rr->phase = RX_FINISH;
+}
+
+static inline void mainserv_rx_free_packets(rx_packet *p) {
+	rx_packet *pn;
+	while (p) {
+		pn = p->next;
+		free(p->packet);
+		free(p);
+		p = pn;
+	}
+}
+
+/* i/o thread - open chunk or read next portion of data */
+static inline void mainserv_rx_do_io(rx_request *rr) {
+	uint32_t batch,bcnt,bsum,blocksize;
+	uint16_t blocknum,blockoffset,okblocks;
+	uint8_t *bpackets[MAINSERV_READ_MAX_BATCH];
+	uint8_t *bbuffs[MAINSERV_READ_MAX_BATCH];
+	uint8_t *bcrcs[MAINSERV_READ_MAX_BATCH];
+	uint32_t bsizes[MAINSERV_READ_MAX_BATCH];
+	uint8_t *wptr;
+	rx_packet *p;
+	uint32_t i;
+	int status;
+
+	if (rr->failed) {
+		if (rr->opened) {
+			hdd_close(rr->chunkid,0);
+			rr->opened = 0;
+		}
+		return;
+	}
+	if (rr->opened==0) {
+		status = hdd_open(rr->chunkid,rr->version);
+		if (status==MFS_STATUS_OK) {
+			rr->opened = 1;
+			hdd_precache_data(rr->chunkid,rr->offset,rr->size);
+		}
+		rr->hddstatus = status;
+		return;
+	}
+	batch = hdd_read_batch_size();
+	if (batch<=1) {
+		batch = RX_MIN_BATCH;
+	}
+	if (batch>MAINSERV_READ_MAX_BATCH) {
+		batch = MAINSERV_READ_MAX_BATCH;
+	}
+	bcnt = 0;
+	bsum = 0;
+	while (bcnt<batch && bsum<rr->size) {
+		blocknum = (rr->offset+bsum)>>MFSBLOCKBITS;
+		blockoffset = (rr->offset+bsum)&MFSBLOCKMASK;
+		if (((rr->offset+rr->size-1)>>MFSBLOCKBITS) == blocknum) {	// last block
+			blocksize = rr->size-bsum;
+		} else {
+			blocksize = MFSBLOCKSIZE-blockoffset;
+		}
+		bpackets[bcnt] = mainserv_create_packet(&wptr,CSTOCL_READ_DATA,8+2+2+4+4+blocksize);
+		put64bit(&wptr,rr->chunkid);
+		put16bit(&wptr,blocknum);
+		put16bit(&wptr,blockoffset);
+		put32bit(&wptr,blocksize);
+		bcrcs[bcnt] = wptr;
+		bbuffs[bcnt] = wptr+4;
+		bsizes[bcnt] = blocksize;
+		bsum += blocksize;
+		bcnt++;
+	}
+	status = hdd_read_multi(rr->chunkid,rr->version,rr->offset,bsum,bbuffs,bcrcs,&okblocks);
+	for (i=0 ; i<bcnt ; i++) {
+		if (i<okblocks) {
+			p = malloc(sizeof(rx_packet));
+			passert(p);
+			p->packet = bpackets[i];
+			p->startptr = bpackets[i];
+			p->bytesleft = 8+8+2+2+4+4+bsizes[i];
+			p->next = NULL;
+			*(rr->iotail) = p;
+			rr->iotail = &(p->next);
+		} else {
+			free(bpackets[i]);
+		}
+	}
+	rr->offset += bsum;
+	rr->size -= bsum;
+	rr->hddstatus = status;
+	if (status!=MFS_STATUS_OK || rr->size==0) {
+		hdd_close(rr->chunkid,0);
+		rr->opened = 0;
+	}
+}
+
+void* mainserv_rx_io_thread(void *arg) {
+	rx_request *rr;
+	reactor *rx;
+	uint32_t id,op;
+	uint8_t *data;
+
+	for (;;) {
+		queue_get(rx_ioqueue,&id,&op,&data,NULL);
+		if (data==NULL) { // queue has been closed
+			return arg;
+		}
+		rr = (rx_request*)data;
+		mainserv_rx_do_io(rr);
+		rx = rr->rx;
+		zassert(pthread_mutex_lock(&(rx->lock)));
+		rr->ionext = rx->iodone;
+		rx->iodone = rr;
+		mainserv_rx_wakeup(rx);
+		zassert(pthread_mutex_unlock(&(rx->lock)));
+	}
+	return arg;
+}
+
+static inline void mainserv_rx_submit(rx_request *rr) {
+	rr->iobusy = 1;
+	queue_put(rx_ioqueue,0,0,(uint8_t*)rr,1);
+}
+
+/* reactor thread: data from i/o thread is ready */
+static inline void mainserv_rx_io_finished(rx_request *rr) {
+	rr->iobusy = 0;
+	if (rr->iohead) {
+		*(rr->outtail) = rr->iohead;
+		rr->outtail = rr->iotail;
+		while (rr->iohead) {
+			rr->outbytes += rr->iohead->bytesleft;
+			rr->iohead = rr->iohead->next;
+		}
+		rr->iotail = &(rr->iohead);
+	}
+	if (rr->failed || (rr->phase!=RX_OPEN && rr->phase!=RX_DATA)) {
+		return;
+	}
+	if (rr->hddstatus!=MFS_STATUS_OK) {
+		mainserv_rx_status(rr,rr->hddstatus);
+	} else if (rr->phase==RX_OPEN) {
+		rr->phase = RX_DATA;
+	} else if (rr->size==0) {
+		mainserv_rx_status(rr,MFS_STATUS_OK);
+	}
+}
+
+static inline void mainserv_rx_read_socket(rx_request *rr) {
+	const uint8_t *rptr;
+	uint32_t cmd,leng;
+	int32_t i;
+
+	for (;;) {
+		i = read(rr->sock,rr->hdr+rr->hdrrcvd,8-rr->hdrrcvd);
+		if (i==0) {
+			rr->failed = 1;
+			return;
+		}
+		if (i<0) {
+			if (ERRNO_ERROR) {
+				rr->failed = 1;
+			}
+			return;
+		}
+		mainserv_bytesin(i);
+		rr->hdrrcvd += i;
+		if (rr->hdrrcvd==8) {
+			rptr = rr->hdr;
+			cmd = get32bit(&rptr);
+			leng = get32bit(&rptr);
+			if (cmd!=ANTOAN_NOP || leng!=0) { // only nops are expected here
+				rr->failed = 1;
+				return;
+			}
+			rr->hdrrcvd = 0;
+		}
+	}
+}
+
+static inline void mainserv_rx_write_socket(rx_request *rr,uint64_t now) {
+	rx_packet *p;
+	int32_t i;
+
+	while ((p=rr->outhead)!=NULL) {
+		i = write(rr->sock,p->startptr,p->bytesleft);
+		if (i<0) {
+			if (ERRNO_ERROR) {
+				rr->failed = 1;
+			}
+			return;
+		}
+		if (i==0) {
+			rr->failed = 1;
+			return;
+		}
+		mainserv_bytesout(i);
+		rr->lastprogress = now;
+		rr->lastsend = now;
+		p->startptr += i;
+		p->bytesleft -= i;
+		rr->outbytes -= i;
+		if (p->bytesleft>0) {
+			return;
+		}
+		rr->outhead = p->next;
+		if (rr->outhead==NULL) {
+			rr->outtail = &(rr->outhead);
+		}
+		free(p->packet);
+		free(p);
+	}
+}
+
+void* mainserv_rx_thread(void *arg) {
+	reactor *rx = (reactor*)arg;
+	rx_request *rr,*rrn,*iol;
+	struct pollfd *pfd;
+	uint32_t pfdsize,pfdcnt,queuelimit;
+	uint64_t now;
+	uint8_t *packet,*wptr;
+	uint8_t pipebuff[256];
+	uint8_t term;
+
+	pfdsize = 64;
+	pfd = malloc(sizeof(struct pollfd)*pfdsize);
+	passert(pfd);
+	for (;;) {
+		zassert(pthread_mutex_lock(&(rx->lock)));
+		rr = rx->newhead;
+		rx->newhead = NULL;
+		iol = rx->iodone;
+		rx->iodone = NULL;
+		rx->notified = 0;
+		term = rx->term;
+		zassert(pthread_mutex_unlock(&(rx->lock)));
+		if (term) {
+			break;
+		}
+		while (rr) {
+			rrn = rr->next;
+			rr->next = rx->head;
+			if (rr->next) {
+				rr->next->prev = &(rr->next);
+			}
+			rr->prev = &(rx->head);
+			rx->head = rr;
+			if (rr->phase==RX_OPEN) {
+				mainserv_rx_submit(rr);
+			}
+			rr = rrn;
+		}
+		while (iol) {
+			rr = iol;
+			iol = rr->ionext;
+			mainserv_rx_io_finished(rr);
+		}
+
+		now = monotonic_useconds();
+		queuelimit = hdd_read_batch_size();
+		if (queuelimit<=1) {
+			queuelimit = RX_MIN_BATCH;
+		}
+		queuelimit *= MFSBLOCKSIZE;
+		for (rr=rx->head ; rr ; rr=rrn) {
+			rrn = rr->next;
+			if (rr->failed==0) {
+				mainserv_rx_write_socket(rr,now);
+			}
+			if (rr->failed==0 && rr->phase==RX_DATA && rr->iobusy==0 && rr->outbytes<queuelimit) {
+				mainserv_rx_submit(rr); // read next portion while previous is being sent
+			}
+			if (rr->failed==0 && rr->outhead==NULL && rr->protover && rr->phase!=RX_FINISH && rr->lastsend + NOPS_INTERVAL <= now) {
+				packet = mainserv_create_packet(&wptr,ANTOAN_NOP,0);
+				mainserv_rx_append(rr,packet,8);
+				rr->lastsend = now;
+				rr->lastprogress = now;
+			}
+			if (rr->failed==0 && rr->outhead!=NULL && rr->lastprogress + (uint64_t)SERV_TIMEOUT*1000 < now) {
+				mfs_log(MFSLOG_SYSLOG,MFSLOG_NOTICE,"read reactor: 'send(read data)' timed out");
+				rr->failed = 1;
+			}
+			if (rr->failed && rr->iobusy==0 && rr->opened) {
+				mainserv_rx_submit(rr); // close chunk in i/o thread
+			}
+			if ((rr->failed && rr->iobusy==0 && rr->opened==0) || (rr->phase==RX_FINISH && rr->outhead==NULL)) {
+				*(rr->prev) = rr->next;
+				if (rr->next) {
+					rr->next->prev = rr->prev;
+				}
+				mainserv_rx_free_packets(rr->outhead);
+#ifdef HAVE___SYNC_FETCH_AND_OP
+				__sync_fetch_and_add(&stats_hlopr,1);
+#else
+				zassert(pthread_mutex_lock(&statslock));
+				stats_hlopr++;
+				zassert(pthread_mutex_unlock(&statslock));
+#endif
+				zassert(pthread_mutex_lock(&(rx->lock)));
+				rx->reqcnt--;
+				zassert(pthread_mutex_unlock(&(rx->lock)));
+				rr->callback((rr->failed)?0:1,rr->extra);
+				free(rr);
+			}
+		}
+
+		pfdcnt = 0;
+		for (rr=rx->head ; rr ; rr=rr->next) {
+			pfdcnt++;
+		}
+		if (pfdcnt+1>pfdsize) {
+			pfdsize = (pfdcnt+1)*3/2;
+			free(pfd);
+			pfd = malloc(sizeof(struct pollfd)*pfdsize);
+			passert(pfd);
+		}
+		pfd[0].fd = rx->pipe[0];
+		pfd[0].events = POLLIN;
+		pfd[0].revents = 0;
+		pfdcnt = 1;
+		for (rr=rx->head ; rr ; rr=rr->next) {
+			pfd[pfdcnt].fd = rr->sock;
+			pfd[pfdcnt].events = (rr->failed)?0:POLLIN;
+			if (rr->outhead!=NULL && rr->failed==0) {
+				pfd[pfdcnt].events |= POLLOUT;
+			}
+			pfd[pfdcnt].revents = 0;
+			pfdcnt++;
+		}
+		if (poll(pfd,pfdcnt,RX_POLL_TIMEOUT)<0) {
+			if (errno!=EINTR) {
+				mfs_log(MFSLOG_ERRNO_SYSLOG,MFSLOG_WARNING,"read reactor: poll error");
+				portable_usleep(10000);
+			}
+			continue;
+		}
+		if (pfd[0].revents & POLLIN) {
+			if (read(rx->pipe[0],pipebuff,256)<0) {
+				mfs_log(MFSLOG_ERRNO_SYSLOG,MFSLOG_WARNING,"read reactor: pipe read error");
+			}
+		}
+		now = monotonic_useconds();
+		pfdcnt = 1;
+		for (rr=rx->head ; rr ; rr=rr->next) {
+			if (rr->failed==0) {
+				if (pfd[pfdcnt].revents & (POLLERR|POLLHUP)) {
+					rr->failed = 1;
+				} else {
+					if (pfd[pfdcnt].revents & POLLIN) {
+						mainserv_rx_read_socket(rr);
+					}
+					if ((pfd[pfdcnt].revents & POLLOUT) && rr->failed==0) {
+						mainserv_rx_write_socket(rr,now);
+					}
+				}
+			}
+			pfdcnt++;
+		}
+	}
+	free(pfd);
+	return arg;
+}
+
+uint8_t mainserv_reactor_enabled(void) {
+	return (reactors_cnt>0)?1:0;
+}
+
+/* starts serving CLTOCS_READ in one of reactors ; callback is called (from reactor thread) after all data has been sent - returns 0 when request can't be accepted */
+uint8_t mainserv_reactor_read(int sock,const uint8_t *data,uint32_t length,void (*callback)(uint8_t status,void *extra),void *extra) {
+	rx_request *rr;
+	reactor *rx;
+	uint32_t i;
+
+	if (reactors_cnt==0) {
+		return 0;
+	}
+	rx = NULL;
+	for (i=0 ; i<reactors_cnt && rx==NULL ; i++) {
+		rx = reactors + ((reactors_next + i) % reactors_cnt);
+		zassert(pthread_mutex_lock(&(rx->lock)));
+		if (rx->reqcnt>=RX_MAX_REQUESTS) {
+			zassert(pthread_mutex_unlock(&(rx->lock)));
+			rx = NULL;
+		}
+	}
+	if (rx==NULL) {
+		return 0;
+	}
+	reactors_next = (reactors_next + 1) % reactors_cnt;
+	rr = malloc(sizeof(rx_request));
+	passert(rr);
+	memset(rr,0,sizeof(rx_request));
+	rr->sock = sock;
+	rr->phase = RX_OPEN;
+	rr->iotail = &(rr->iohead);
+	rr->outtail = &(rr->outhead);
+	rr->lastprogress = rr->lastsend = monotonic_useconds();
+	rr->callback = callback;
+	rr->extra = extra;
+	rr->rx = rx;
+	if (length!=20 && length!=21) {
+		mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"CLTOCS_READ - wrong size (%"PRIu32"/20|21)",length);
+		rr->failed = 1;
+	} else {
+		if (length==21) {
+			rr->protover = get8bit(&data);
+		}
+		rr->chunkid = get64bit(&data);
+		rr->version = get32bit(&data);
+		rr->offset = get32bit(&data);
+		rr->size = get32bit(&data);
+		if (rr->size==0) {
+			mainserv_rx_status(rr,MFS_STATUS_OK); // no bytes to read - just return MFS_STATUS_OK
+		} else if (rr->size>MFSCHUNKSIZE) {
+			mainserv_rx_status(rr,MFS_ERROR_WRONGSIZE);
+		} else if (rr->offset>=MFSCHUNKSIZE || rr->offset+rr->size>MFSCHUNKSIZE) {
+			mainserv_rx_status(rr,MFS_ERROR_WRONGOFFSET);
+		}
+	}
+	rr->next = rx->newhead;
+	rx->newhead = rr;
+	rx->reqcnt++;
+	mainserv_rx_wakeup(rx);
+	zassert(pthread_mutex_unlock(&(rx->lock)));
+	return 1;
+}
+
+static void mainserv_reactor_term(void) {
+	rx_request *rr,*rrn;
+	uint32_t i;
+
+	if (rx_ioqueue==NULL) { // reactors not used
+		return;
+	}
+	for (i=0 ; i<reactors_cnt ; i++) {
+		zassert(pthread_mutex_lock(&(reactors[i].lock)));
+		reactors[i].term = 1;
+		mainserv_rx_wakeup(reactors+i);
+		zassert(pthread_mutex_unlock(&(reactors[i].lock)));
+		zassert(pthread_join(reactors[i].thread_id,NULL));
+	}
+	queue_close(rx_ioqueue);
+	for (i=0 ; i<rx_io_threads_cnt ; i++) {
+		zassert(pthread_join(rx_io_threads[i],NULL));
+	}
+	for (i=0 ; i<reactors_cnt ; i++) {
+		for (rr=reactors[i].head ; rr ; rr=rrn) {
+			rrn = rr->next;
+			mainserv_rx_free_packets(rr->outhead);
+			mainserv_rx_free_packets(rr->iohead);
+			free(rr);
+		}
+		close(reactors[i].pipe[0]);
+		close(reactors[i].pipe[1]);
+		zassert(pthread_mutex_destroy(&(reactors[i].lock)));
+	}
+	free(reactors);
+	free(rx_io_threads);
+	queue_delete(rx_ioqueue);
+	rx_ioqueue = NULL;
+	reactors_cnt = 0;
+}
+
+static int mainserv_reactor_init(void) {
+	uint32_t i,rcnt,iocnt;
+
+	rcnt = cfg_getuint32("READ_REACTOR_THREADS",0);
+	iocnt = cfg_getuint32("READ_REACTOR_IO_THREADS",16);
+	if (rcnt==0) {
+		return 0;
+	}
+	if (rcnt>64) {
+		mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"READ_REACTOR_THREADS is too big - using 64");
+		rcnt = 64;
+	}
+	if (iocnt==0) {
+		iocnt = 1;
+	} else if (iocnt>256) {
+		mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"READ_REACTOR_IO_THREADS is too big - using 256");
+		iocnt = 256;
+	}
+	rx_ioqueue = queue_new(0);
+	reactors = malloc(sizeof(reactor)*rcnt);
+	passert(reactors);
+	rx_io_threads = malloc(sizeof(pthread_t)*iocnt);
+	passert(rx_io_threads);
+	for (i=0 ; i<rcnt ; i++) {
+		if (pipe(reactors[i].pipe)<0) {
+			mfs_log(MFSLOG_ERRNO_SYSLOG_STDERR,MFSLOG_ERR,"read reactor: can't create pipe");
+			return -1;
+		}
+		zassert(pthread_mutex_init(&(reactors[i].lock),NULL));
+		reactors[i].newhead = NULL;
+		reactors[i].iodone = NULL;
+		reactors[i].notified = 0;
+		reactors[i].reqcnt = 0;
+		reactors[i].head = NULL;
+		reactors[i].term = 0;
+		if (lwt_minthread_create(&(reactors[i].thread_id),0,mainserv_rx_thread,reactors+i)<0) {
+			return -1;
+		}
+		reactors_cnt++;
+	}
+	for (i=0 ; i<iocnt ; i++) {
+		if (lwt_minthread_create(rx_io_threads+i,0,mainserv_rx_io_thread,NULL)<0) {
+			return -1;
+		}
+		rx_io_threads_cnt++;
+	}
+	mfs_log(MFSLOG_SYSLOG,MFSLOG_INFO,"read reactor: %"PRIu32" reactor threads, %"PRIu32" i/o threads",rcnt,iocnt);
+	return 0;
+}
+
 typedef struct write_job {
 	uint64_t chunkid;
 	uint32_t writeid;
@@ -516,6 +1451,8 @@ typedef struct write_job {
 	uint32_t size;
 	const uint8_t *crcptr;
 	const uint8_t *buff;
+	uint64_t fwdtime;
+	uint8_t crcok;
 	uint8_t hddstatus;
 	uint8_t netstatus;
 	uint8_t ack;
@@ -540,6 +1477,7 @@ void* mainserv_write_thread(void* arg) {
 	write_job *wrjob;
 	uint64_t gchunkid;
 	uint32_t gversion;
+	uint64_t st;
 	uint8_t status;
 	while (1) {
 		zassert(pthread_mutex_lock(&(wrdata->lock)));
@@ -555,7 +1493,13 @@ void* mainserv_write_thread(void* arg) {
 		gchunkid = wrdata->chunkid;
 		gversion = wrdata->version;
 		zassert(pthread_mutex_unlock(&(wrdata->lock)));
-		status = hdd_write(gchunkid,gversion,wrjob->blocknum,wrjob->buff,wrjob->offset,wrjob->size,wrjob->crcptr);
+		st = monotonic_useconds();
+		if (wrjob->crcok) {
+			status = hdd_write_verified(gchunkid,gversion,wrjob->blocknum,wrjob->buff,wrjob->offset,wrjob->size,wrjob->crcptr);
+		} else {
+			status = hdd_write(gchunkid,gversion,wrjob->blocknum,wrjob->buff,wrjob->offset,wrjob->size,wrjob->crcptr);
+		}
+		mainserv_wlat_add(WLAT_LOCAL,monotonic_useconds()-st);
 		zassert(pthread_mutex_lock(&(wrdata->lock)));
 		wrjob->hddstatus = status;
 		wrjob->ack |= 1;
@@ -571,6 +1515,23 @@ void* mainserv_write_thread(void* arg) {
 	return NULL;
 }
 
+static inline uint8_t mainserv_send_acks(int sock,const uint8_t *buff,uint32_t ackcnt,uint8_t protover,sock_nops *sn) {
+	uint32_t leng;
+	uint8_t r;
+	leng = ackcnt*(8+8+4+1);
+	if (protover) {
+		mainserv_sock_nop_del(sn);
+	}
+	r = (mainserv_towrite(sock,buff,leng,SERV_TIMEOUT)!=(int32_t)leng)?0:1;
+	if (r==0) {
+		mfs_log(MFSLOG_SYSLOG,MFSLOG_NOTICE,"write_middle: 'send(write status)' %s",(errno==EPIPE || errno==ECONNRESET)?"disconnected":"timed out");
+	}
+	if (protover) {
+		mainserv_sock_nop_add(sn);
+	}
+	return r;
+}
+
 uint8_t mainserv_write_middle(int sock,int fwdsock,uint64_t gchunkid,uint32_t gversion,uint8_t protover,sock_nops *sn,sock_nops *fsn) {
 	pthread_t wrthread;
 	write_xchg wrdata;
@@ -584,6 +1545,9 @@ uint8_t mainserv_write_middle(int sock,int fwdsock,uint64_t gchunkid,uint32_t gv
 	uint32_t cmd,leng;
 	uint64_t chunkid;
 	uint32_t writeid;
+	uint32_t datacrc;
+	uint8_t ackbuff[WRITE_ACK_BATCH*(8+8+4+1)];
+	uint32_t ackcnt;
 	uint8_t status;
 	uint8_t gotlast;
 
@@ -657,7 +1621,7 @@ uint8_t mainserv_write_middle(int sock,int fwdsock,uint64_t gchunkid,uint32_t gv
 					myalloc(wrjob,offsetof(write_job,data)+leng+8);
 					wrjob->structsize = offsetof(write_job,data)+leng+8;
 					memcpy(wrjob->data,hdr,8);
-					if (mainserv_toforward(sock,fwdsock,wrjob->data,leng+8,8,0,SERV_TIMEOUT)!=(int32_t)(leng+8)) {
+					if (mainserv_forward_data(sock,fwdsock,wrjob->data,leng+8,&datacrc,SERV_TIMEOUT)!=(int32_t)(leng+8)) {
 						myunalloc(wrjob,wrjob->structsize);
 						mfs_log(MFSLOG_SYSLOG,MFSLOG_NOTICE,"write_middle: 'forward(write data)' timed out");
 						break;
@@ -773,6 +1737,8 @@ uint8_t mainserv_write_middle(int sock,int fwdsock,uint64_t gchunkid,uint32_t gv
 */
 				wrjob->crcptr = rptr;
 				wrjob->buff = rptr+4;
+				wrjob->crcok = (get32bit(&rptr)==datacrc)?1:0;
+				wrjob->fwdtime = monotonic_useconds();
 				wrjob->ack = 0;
 				wrjob->hddstatus = 0xFF;
 				wrjob->netstatus = 0xFF;
@@ -864,6 +1830,7 @@ uint8_t mainserv_write_middle(int sock,int fwdsock,uint64_t gchunkid,uint32_t gv
 					wrjob->netstatus = status;
 					wrjob->ack|=2;
 					wrdata.nethead = wrjob->next;
+					mainserv_wlat_add(WLAT_NEXT,monotonic_useconds()-wrjob->fwdtime);
 				}
 				zassert(pthread_mutex_unlock(&(wrdata.lock)));
 			}
@@ -874,6 +1841,8 @@ uint8_t mainserv_write_middle(int sock,int fwdsock,uint64_t gchunkid,uint32_t gv
 			}
 		}
 		status = MFS_STATUS_OK;
+		ackcnt = 0;
+		wptr = ackbuff;
 		while (status==MFS_STATUS_OK) {
 			uint8_t exitloop;
 			zassert(pthread_mutex_lock(&(wrdata.lock)));
@@ -903,19 +1872,25 @@ uint8_t mainserv_write_middle(int sock,int fwdsock,uint64_t gchunkid,uint32_t gv
 			}
 			myunalloc(wrjob,wrjob->structsize);
 			zassert(pthread_mutex_unlock(&(wrdata.lock)));
-			packet = mainserv_create_packet(&wptr,CSTOCL_WRITE_STATUS,8+4+1);
+			// statuses of all finished writes are sent together
+			put32bit(&wptr,CSTOCL_WRITE_STATUS);
+			put32bit(&wptr,8+4+1);
 			put64bit(&wptr,chunkid);
 			put32bit(&wptr,writeid);
 			put8bit(&wptr,status);
-			if (protover) {
-				mainserv_sock_nop_del(sn);
+			ackcnt++;
+			if (ackcnt==WRITE_ACK_BATCH || status!=MFS_STATUS_OK) {
+				if (mainserv_send_acks(sock,ackbuff,ackcnt,protover,sn)==0) {
+					status = MFS_ERROR_DISCONNECTED; // any error
+				}
+				ackcnt = 0;
+				wptr = ackbuff;
 			}
-			if (mainserv_send_and_free("write status",sock,packet,8+4+1)==0) {
+		}
+		if (ackcnt>0) {
+			if (mainserv_send_acks(sock,ackbuff,ackcnt,protover,sn)==0) {
 				status = MFS_ERROR_DISCONNECTED; // any error
 			}
-			if (protover) {
-				mainserv_sock_nop_add(sn);
-			}
 		}
 		if (sn->error || fsn->error) {
 			status = MFS_ERROR_DISCONNECTED; // any error
@@ -975,6 +1950,7 @@ uint8_t mainserv_write_last(int sock,uint64_t gchunkid,uint32_t gversion,uint8_t
 	uint32_t size;
 	uint16_t blocknum;
 	uint16_t offset;
+	uint64_t st;
 	uint8_t rstat;
 	uint8_t status;
 
@@ -1078,7 +2054,9 @@ uint8_t mainserv_write_last(int sock,uint64_t gchunkid,uint32_t gversion,uint8_t
 				}
 			}
 */
+			st = monotonic_useconds();
 			status = hdd_write(gchunkid,gversion,blocknum,rptr+4,offset,size,rptr);
+			mainserv_wlat_add(WLAT_LOCAL,monotonic_useconds()-st);
 			if (status!=MFS_STATUS_OK) {
 //				mfs_log(MFSLOG_SYSLOG,MFSLOG_DEBUG,"hdd_write error: %s",mfsstrerr(status));
 				rstat = 1;
@@ -1264,6 +2242,7 @@ uint8_t mainserv_write(int sock,const uint8_t *data,uint32_t length) {
 
 void mainserv_term(void) {
 	/* to do: terminate thread */
+	mainserv_reactor_term();
 	conncache_term();
 }
 
@@ -1288,5 +2267,8 @@ int mainserv_init(void) {
 	if (lwt_minthread_create(&rnthread,1,mainserv_sock_nop_sender,NULL)<0) {
 		return -1;
 	}
+	if (mainserv_reactor_init()<0) {
+		return -1;
+	}
 	return 1;
 }
@@ -21,8 +21,11 @@
 #define _MAINSERV_H_
 
 void mainserv_stats(uint64_t *bin,uint64_t *bout,uint32_t *hlopr,uint32_t *hlopw);
+void mainserv_write_latency(uint32_t *nextp50,uint32_t *nextp99,uint32_t *localp50,uint32_t *localp99);
 uint8_t mainserv_read(int sock,const uint8_t *packet,uint32_t length);
 uint8_t mainserv_write(int sock,const uint8_t *packet,uint32_t length);
+uint8_t mainserv_reactor_enabled(void);
+uint8_t mainserv_reactor_read(int sock,const uint8_t *packet,uint32_t length,void (*callback)(uint8_t status,void *extra),void *extra);
 // void mainserv_serve(int sock);
 int mainserv_init(void);
 
@@ -423,6 +423,51 @@ void masterconn_sendregister(masterconn *eptr) {
 	put32bit(&buff,tdchunkcount);
 }
 
+typedef struct _regchunk {
+	uint64_t chunkid;
+	uint32_t version;
+} regchunk;
+
+static int masterconn_regchunk_cmp(const void *a,const void *b) {
+	const regchunk *aa = (const regchunk*)a;
+	const regchunk *bb = (const regchunk*)b;
+	return (aa->chunkid<bb->chunkid)?-1:(aa->chunkid>bb->chunkid)?1:0;
+}
+
+/* sorted list, chunkids as deltas and everything as varints - usually about 2-3 bytes per chunk instead of 12 */
+static void masterconn_sendnextchunks_compressed(masterconn *eptr,uint32_t chunks) {
+	uint8_t *buff,*rawbuff;
+	const uint8_t *rptr;
+	regchunk *rctab;
+	uint64_t *chunkids;
+	uint32_t *versions;
+	uint32_t i;
+
+	rawbuff = malloc(chunks*(8+4));
+	passert(rawbuff);
+	rctab = malloc(sizeof(regchunk)*chunks);
+	passert(rctab);
+	hdd_get_chunks_next_list_data(ChunksPerRegisterPacket,rawbuff);
+	rptr = rawbuff;
+	for (i=0 ; i<chunks ; i++) {
+		rctab[i].chunkid = get64bit(&rptr);
+		rctab[i].version = get32bit(&rptr);
+	}
+	qsort(rctab,chunks,sizeof(regchunk),masterconn_regchunk_cmp);
+	chunkids = (uint64_t*)rawbuff; // reuse raw buffer (exactly chunks*(8+4) bytes)
+	versions = (uint32_t*)(rawbuff+chunks*8);
+	for (i=0 ; i<chunks ; i++) {
+		chunkids[i] = rctab[i].chunkid;
+		versions[i] = rctab[i].version;
+	}
+	free(rctab);
+	buff = masterconn_create_attached_packet(eptr,CSTOMA_REGISTER,1+4+chunklistsize(chunkids,versions,chunks));
+	put8bit(&buff,64);
+	put32bit(&buff,chunks);
+	putchunklist(&buff,chunkids,versions,chunks);
+	free(rawbuff);
+}
+
 void masterconn_sendnextchunks(masterconn *eptr) {
 	uint8_t *buff;
 	uint32_t chunks;
@@ -432,6 +477,8 @@ void masterconn_sendnextchunks(masterconn *eptr) {
 		buff = masterconn_create_attached_packet(eptr,CSTOMA_REGISTER,1);
 		put8bit(&buff,62);
 		eptr->registerstate = REGISTERED;
+	} else if (eptr->masterversion>=VERSION2INT(4,60,0)) {
+		masterconn_sendnextchunks_compressed(eptr,chunks);
 	} else {
 		buff = masterconn_create_attached_packet(eptr,CSTOMA_REGISTER,1+chunks*(8+4));
 		put8bit(&buff,61);
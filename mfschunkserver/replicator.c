@@ -36,6 +36,7 @@
 #include "hddspacemgr.h"
 #include "sockets.h"
 #include "crc.h"
+#include "ecrs.h"
 #include "mfslog.h"
 #include "datapack.h"
 #include "massert.h"
@@ -122,54 +123,17 @@ static inline void replicator_bytesout(uint64_t bytes) {
 	zassert(pthread_mutex_unlock(&statslock));
 }
 
-static void xordata(uint8_t *dst,const uint8_t *src,uint32_t leng) {
-	uint32_t *dst4;
-	const uint32_t *src4;
-#define XOR_ONE_BYTE (*dst++)^=(*src++)
-#define XOR_FOUR_BYTES (*dst4++)^=(*src4++)
-	if (((unsigned long)dst&3)==((unsigned long)src&3)) {
-		while (leng && ((unsigned long)src & 3)) {
-			XOR_ONE_BYTE;
-			leng--;
-		}
-		dst4 = (uint32_t*)dst;
-		src4 = (const uint32_t*)src;
-		while (leng>=32) {
-			XOR_FOUR_BYTES;
-			XOR_FOUR_BYTES;
-			XOR_FOUR_BYTES;
-			XOR_FOUR_BYTES;
-			XOR_FOUR_BYTES;
-			XOR_FOUR_BYTES;
-			XOR_FOUR_BYTES;
-			XOR_FOUR_BYTES;
-			leng-=32;
-		}
-		while (leng>=4) {
-			XOR_FOUR_BYTES;
-			leng-=4;
-		}
-		src = (const uint8_t*)src4;
-		dst = (uint8_t*)dst4;
-		if (leng) do {
-			XOR_ONE_BYTE;
-		} while (--leng);
-	} else {
-		while (leng>=8) {
-			XOR_ONE_BYTE;
-			XOR_ONE_BYTE;
-			XOR_ONE_BYTE;
-			XOR_ONE_BYTE;
-			XOR_ONE_BYTE;
-			XOR_ONE_BYTE;
-			XOR_ONE_BYTE;
-			XOR_ONE_BYTE;
-			leng-=8;
-		}
-		if (leng>0) do {
-			XOR_ONE_BYTE;
-		} while (--leng);
+// part index (as used by ecrs) of EC part chunk or -1
+static int rep_ec_partindex(uint64_t chunkid,uint8_t parts) {
+	uint8_t ecid;
+	ecid = chunkid>>56;
+	if (parts==8 && ecid>=0x20 && ecid<0x20+8+ECRS_MAX_CHKSUM_PARTS) {
+		return ecid-0x20;
+	}
+	if (parts==4 && ecid>=0x10 && ecid<0x10+4+ECRS_MAX_CHKSUM_PARTS) {
+		return ecid-0x10;
 	}
+	return -1;
 }
 
 static int rep_read(repsrc *rs) {
@@ -601,6 +565,12 @@ uint8_t replicate(repmodeenum rmode,uint64_t chunkid,uint32_t version,uint8_t pa
 	uint32_t xcrc,zcrc,bind;
 	uint8_t *wptr;
 	const uint8_t *rptr;
+	uint8_t survivors[MAX_EC_PARTS];
+	uint8_t dsrc[ECRS_MAX_DATA_PARTS];
+	uint8_t coefs[ECRS_MAX_DATA_PARTS][MAX_EC_PARTS];
+	const uint8_t *dotsrc[MAX_EC_PARTS];
+	uint8_t ordered,xoronly,needbuff;
+	int pidx;
 
 	start = monotonic_seconds();
 	progcheck = start + PROGRESS_CHECK;
@@ -631,6 +601,52 @@ uint8_t replicate(repmodeenum rmode,uint64_t chunkid,uint32_t version,uint8_t pa
 		return MFS_ERROR_EINVAL;
 	}
 
+// sources may be any 'parts' different EC parts (data or checksum) - find coefficients needed to rebuild destination
+	ordered = 1;
+	xoronly = 1;
+	needbuff = 0;
+	if (rmode==RECOVER || rmode==JOIN) {
+		for (i=0 ; i<srccnt ; i++) {
+			pidx = rep_ec_partindex(srcchunkid[i],parts);
+			if (pidx<0) {
+				return MFS_ERROR_EINVAL;
+			}
+			survivors[i] = pidx;
+			if (survivors[i]!=i) {
+				ordered = 0;
+			}
+		}
+	}
+	if (rmode==RECOVER) {
+		pidx = rep_ec_partindex(chunkid,parts);
+		if (pidx<0 || ecrs_recover_coefs(parts,survivors,pidx,coefs[0])<0) {
+			return MFS_ERROR_EINVAL;
+		}
+		for (i=0 ; i<srccnt ; i++) {
+			if (coefs[0][i]!=1) {
+				xoronly = 0;
+			}
+		}
+		needbuff = 1;
+	} else if (rmode==JOIN) {
+		for (i=0 ; i<parts ; i++) {
+			dsrc[i] = 0xFF;
+		}
+		for (i=0 ; i<srccnt ; i++) {
+			if (survivors[i]<parts) {
+				dsrc[survivors[i]] = i;
+			}
+		}
+		for (i=0 ; i<parts ; i++) {
+			if (dsrc[i]==0xFF) {
+				if (ecrs_recover_coefs(parts,survivors,i,coefs[i])<0) {
+					return MFS_ERROR_EINVAL;
+				}
+				needbuff = 1;
+			}
+		}
+	}
+
 #ifdef MFSDEBUG
 	mfs_log(MFSLOG_SYSLOG,MFSLOG_DEBUG,"sources: %"PRIu8,srccnt);
 	for (i=0 ; i<srccnt ; i++) {
@@ -652,7 +668,7 @@ uint8_t replicate(repmodeenum rmode,uint64_t chunkid,uint32_t version,uint8_t pa
 	r.opened = 0;
 	r.repsources = malloc(sizeof(repsrc)*srccnt);
 	passert(r.repsources);
-	if (rmode==RECOVER) {
+	if (needbuff) {
 		r.xorbuff = malloc(MFSBLOCKSIZE+4);
 		passert(r.xorbuff);
 	} else {
@@ -793,7 +809,7 @@ uint8_t replicate(repmodeenum rmode,uint64_t chunkid,uint32_t version,uint8_t pa
 			}
 			blocks = (blocks+3) >> 2;
 			blockgroup = 4;
-			if (blocks>0) {
+			if (blocks>0 && ordered) {
 				while (lastsrccnt>0 && r.repsources[lastsrccnt-1].blocks <= ((blocks-1)<<2)) {
 					lastsrccnt--;
 				}
@@ -1070,15 +1086,15 @@ uint8_t replicate(repmodeenum rmode,uint64_t chunkid,uint32_t version,uint8_t pa
 					for (i=0 ; i<srccnt ; i++) {
 						rptr = r.repsources[i].datapackets[bg];
 						rptr += 16;
-						if (i==0) {
-							xcrc = get32bit(&rptr);
-							memcpy(r.xorbuff+4,rptr,MFSBLOCKSIZE);
-						} else {
-							xcrc ^= get32bit(&rptr);
-							xordata(r.xorbuff+4,rptr,MFSBLOCKSIZE);
-						}
+						xcrc ^= get32bit(&rptr);
+						dotsrc[i] = rptr;
+					}
+					if (xoronly) { // crc of xor of even number of blocks
+						ecrs_dotprod(r.xorbuff+4,dotsrc,coefs[0],srccnt,MFSBLOCKSIZE);
+						xcrc ^= zcrc;
+					} else {
+						xcrc = ecrs_dotprod_crc(r.xorbuff+4,dotsrc,coefs[0],srccnt,MFSBLOCKSIZE);
 					}
-					xcrc ^= zcrc;
 					wptr = r.xorbuff;
 					put32bit(&wptr,xcrc);
 					nonzero = 1;
@@ -1115,8 +1131,17 @@ uint8_t replicate(repmodeenum rmode,uint64_t chunkid,uint32_t version,uint8_t pa
 			case JOIN:
 				for (i=0 ; i<readsrccnt ; i++) {
 					for (bg = 0 ; bg < blockgroup ; bg++) {
-						rptr = r.repsources[i].datapackets[bg];
-						status = hdd_write(chunkid,0,(b*parts+i)*blockgroup+bg,rptr+20,0,MFSBLOCKSIZE,rptr+16);
+						if (dsrc[i]!=0xFF) {
+							rptr = r.repsources[dsrc[i]].datapackets[bg]+16;
+						} else { // missing data part - rebuild it from remaining parts
+							for (bind=0 ; bind<srccnt ; bind++) {
+								dotsrc[bind] = r.repsources[bind].datapackets[bg]+20;
+							}
+							wptr = r.xorbuff;
+							put32bit(&wptr,ecrs_dotprod_crc(r.xorbuff+4,dotsrc,coefs[i],srccnt,MFSBLOCKSIZE));
+							rptr = r.xorbuff;
+						}
+						status = hdd_write(chunkid,0,(b*parts+i)*blockgroup+bg,rptr+4,0,MFSBLOCKSIZE,rptr);
 						if (status!=MFS_STATUS_OK) {
 							mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"replicator: write status: %s",mfsstrerr(status));
 							rep_cleanup(&r);
@@ -22,23 +22,45 @@
 #endif
 
 #include <stdlib.h>
+#include <string.h>
 #include <pthread.h>
 #include <inttypes.h>
 
+#include "clocks.h"
+
 #define CSDB_HASHSIZE 256
 #define CSDB_HASH(ip,port) (((ip)*0x7b348943+(port))%(CSDB_HASHSIZE))
 
+// read latency (time to first data packet)
+#define CSDB_LAT_SAMPLES 64
+#define CSDB_LAT_STALE 30000000
+#define CSDB_GLAT_SAMPLES 512
+#define CSDB_GLAT_RECALC 32
+#define CSDB_HEDGE_PERMILLE 50
+#define CSDB_HEDGE_BURST 10
+
 typedef struct _csdbentry {
 	uint32_t ip;
 	uint16_t port;
 	uint32_t readopcnt;
 	uint32_t writeopcnt;
+	uint32_t latewma;
+	uint32_t latp99;
+	uint64_t lastsample;
+	uint32_t latsamples[CSDB_LAT_SAMPLES];
+	uint8_t latpos;
+	uint8_t latcnt;
 	struct _csdbentry *next;
 } csdbentry;
 
 static csdbentry *csdbhtab[CSDB_HASHSIZE];
 static pthread_mutex_t *csdblock;
 
+static uint32_t glatsamples[CSDB_GLAT_SAMPLES];
+static uint32_t glatpos,glatcnt,glatnew;
+static uint32_t glatavg,glatp95,glatp99;
+static uint32_t hedgereads,hedgecnt;
+
 void csdb_init(void) {
 	uint32_t i;
 	for (i=0 ; i<CSDB_HASHSIZE ; i++) {
@@ -46,6 +68,14 @@ void csdb_init(void) {
 	}
 	csdblock = malloc(sizeof(pthread_mutex_t));
 	pthread_mutex_init(csdblock,NULL);
+	glatpos = 0;
+	glatcnt = 0;
+	glatnew = 0;
+	glatavg = 0;
+	glatp95 = 0;
+	glatp99 = 0;
+	hedgereads = 0;
+	hedgecnt = 0;
 }
 
 void csdb_term(void) {
@@ -62,6 +92,38 @@ void csdb_term(void) {
 	}
 }
 
+static inline csdbentry* csdb_newentry(uint32_t ip,uint16_t port,uint32_t hash) {
+	csdbentry *e;
+	e = malloc(sizeof(csdbentry));
+	e->ip = ip;
+	e->port = port;
+	e->readopcnt = 0;
+	e->writeopcnt = 0;
+	e->latewma = 0;
+	e->latp99 = 0;
+	e->lastsample = 0;
+	e->latpos = 0;
+	e->latcnt = 0;
+	e->next = csdbhtab[hash];
+	csdbhtab[hash] = e;
+	return e;
+}
+
+static int csdb_u32cmp(const void *a,const void *b) {
+	uint32_t aa = *((const uint32_t*)a);
+	uint32_t bb = *((const uint32_t*)b);
+	return (aa<bb)?-1:(aa>bb)?1:0;
+}
+
+// percentile (in 1/1000) of given samples - changes order of samples
+static inline uint32_t csdb_percentile(uint32_t *tab,uint32_t cnt,uint32_t permille) {
+	if (cnt==0) {
+		return 0;
+	}
+	qsort(tab,cnt,sizeof(uint32_t),csdb_u32cmp);
+	return tab[((cnt-1)*permille)/1000];
+}
+
 uint32_t csdb_getreadcnt(uint32_t ip,uint16_t port) {
 	uint32_t hash = CSDB_HASH(ip,port);
 	uint32_t result = 0;
@@ -118,13 +180,8 @@ void csdb_readinc(uint32_t ip,uint16_t port) {
 			return;
 		}
 	}
-	e = malloc(sizeof(csdbentry));
-	e->ip = ip;
-	e->port = port;
+	e = csdb_newentry(ip,port,hash);
 	e->readopcnt = 1;
-	e->writeopcnt = 0;
-	e->next = csdbhtab[hash];
-	csdbhtab[hash] = e;
 	pthread_mutex_unlock(csdblock);
 }
 
@@ -153,13 +210,8 @@ void csdb_writeinc(uint32_t ip,uint16_t port) {
 			return;
 		}
 	}
-	e = malloc(sizeof(csdbentry));
-	e->ip = ip;
-	e->port = port;
-	e->readopcnt = 0;
+	e = csdb_newentry(ip,port,hash);
 	e->writeopcnt = 1;
-	e->next = csdbhtab[hash];
-	csdbhtab[hash] = e;
 	pthread_mutex_unlock(csdblock);
 }
 
@@ -176,3 +228,104 @@ void csdb_writedec(uint32_t ip,uint16_t port) {
 	}
 	pthread_mutex_unlock(csdblock);
 }
+
+void csdb_readlatency(uint32_t ip,uint16_t port,uint32_t usec) {
+	uint32_t hash = CSDB_HASH(ip,port);
+	uint32_t tmp[CSDB_GLAT_SAMPLES];
+	uint64_t now,sum;
+	uint32_t i;
+	csdbentry *e;
+	pthread_mutex_lock(csdblock);
+	for (e=csdbhtab[hash] ; e ; e=e->next) {
+		if (e->ip == ip && e->port == port) {
+			break;
+		}
+	}
+	if (e==NULL) {
+		e = csdb_newentry(ip,port,hash);
+	}
+	now = monotonic_useconds();
+	if (e->latcnt==0 || now > e->lastsample + CSDB_LAT_STALE) {
+		e->latewma = usec;
+	} else {
+		e->latewma = (e->latewma * 7 + usec) / 8;
+	}
+	e->lastsample = now;
+	e->latsamples[e->latpos] = usec;
+	e->latpos = (e->latpos + 1) % CSDB_LAT_SAMPLES;
+	if (e->latcnt<CSDB_LAT_SAMPLES) {
+		e->latcnt++;
+	}
+	if (e->latcnt<8 || (e->latpos & 7)==0) {
+		memcpy(tmp,e->latsamples,sizeof(uint32_t)*e->latcnt);
+		e->latp99 = csdb_percentile(tmp,e->latcnt,990);
+	}
+	glatsamples[glatpos] = usec;
+	glatpos = (glatpos + 1) % CSDB_GLAT_SAMPLES;
+	if (glatcnt<CSDB_GLAT_SAMPLES) {
+		glatcnt++;
+	}
+	glatnew++;
+	if (glatnew>=CSDB_GLAT_RECALC || glatcnt<CSDB_GLAT_RECALC) {
+		glatnew = 0;
+		sum = 0;
+		for (i=0 ; i<glatcnt ; i++) {
+			sum += glatsamples[i];
+		}
+		glatavg = sum / glatcnt;
+		memcpy(tmp,glatsamples,sizeof(uint32_t)*glatcnt);
+		glatp95 = csdb_percentile(tmp,glatcnt,950);
+		glatp99 = tmp[((glatcnt-1)*990)/1000];
+	}
+	pthread_mutex_unlock(csdblock);
+}
+
+// returns 0 when there is no recent data
+uint8_t csdb_getreadlatency(uint32_t ip,uint16_t port,uint32_t *ewma,uint32_t *p99) {
+	uint32_t hash = CSDB_HASH(ip,port);
+	uint8_t result = 0;
+	csdbentry *e;
+	pthread_mutex_lock(csdblock);
+	for (e=csdbhtab[hash] ; e ; e=e->next) {
+		if (e->ip == ip && e->port == port) {
+			if (e->latcnt>0 && monotonic_useconds() <= e->lastsample + CSDB_LAT_STALE) {
+				*ewma = e->latewma;
+				*p99 = e->latp99;
+				result = 1;
+			}
+			break;
+		}
+	}
+	pthread_mutex_unlock(csdblock);
+	return result;
+}
+
+void csdb_getlatencystats(uint32_t *avg,uint32_t *p95,uint32_t *p99) {
+	pthread_mutex_lock(csdblock);
+	*avg = glatavg;
+	*p95 = glatp95;
+	*p99 = glatp99;
+	pthread_mutex_unlock(csdblock);
+}
+
+void csdb_readrequest(void) {
+	pthread_mutex_lock(csdblock);
+	hedgereads++;
+	if (hedgereads>=1000000) {
+		hedgereads /= 2;
+		hedgecnt /= 2;
+	}
+	pthread_mutex_unlock(csdblock);
+}
+
+// hedged reads are limited to small fraction of all reads
+uint8_t csdb_hedge_allowed(void) {
+	uint8_t result = 0;
+	pthread_mutex_lock(csdblock);
+	if ((uint64_t)(hedgecnt+1)*1000 <= (uint64_t)hedgereads*CSDB_HEDGE_PERMILLE + CSDB_HEDGE_BURST*1000) {
+		hedgecnt++;
+		result = 1;
+	}
+	pthread_mutex_unlock(csdblock);
+	return result;
+}
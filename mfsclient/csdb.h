@@ -31,5 +31,10 @@ void csdb_readinc(uint32_t ip,uint16_t port);
 void csdb_readdec(uint32_t ip,uint16_t port);
 void csdb_writeinc(uint32_t ip,uint16_t port);
 void csdb_writedec(uint32_t ip,uint16_t port);
+void csdb_readlatency(uint32_t ip,uint16_t port,uint32_t usec);
+uint8_t csdb_getreadlatency(uint32_t ip,uint16_t port,uint32_t *ewma,uint32_t *p99);
+void csdb_getlatencystats(uint32_t *avg,uint32_t *p95,uint32_t *p99);
+void csdb_readrequest(void);
+uint8_t csdb_hedge_allowed(void);
 
 #endif
@@ -41,6 +41,9 @@ typedef struct _cspri {
 } cspri;
 */
 
+// latency (in microseconds) treated as one unit of read priority
+#define CSORDER_LATENCY_UNIT 50
+
 //static uint8_t labelscnt;
 //static uint32_t labelmasks[9][MASKORGROUP];
 parser_data pd;
@@ -180,6 +183,22 @@ static inline void csorder_log_chain_element(uint8_t indx,cspri *chelem) {
 }
 */
 
+// expected wait for read: number of pending operations times measured latency (ewma with some weight of p99)
+static inline uint32_t csorder_readscore(uint32_t ip,uint16_t port) {
+	uint32_t opcnt,ewma,p99;
+	uint64_t score;
+
+	opcnt = csdb_getopcnt(ip,port);
+	if (csdb_getreadlatency(ip,port,&ewma,&p99)==0) {
+		return opcnt; // no recent data - prefer this server to get measurement
+	}
+	score = (uint64_t)(opcnt+1) * (((3 * (uint64_t)ewma + p99) / 4) / CSORDER_LATENCY_UNIT + 1);
+	if (score > 0xFFFFFF) {
+		score = 0xFFFFFF;
+	}
+	return score;
+}
+
 uint32_t csorder_sort(cspri chain[100],uint8_t csdataver,const uint8_t *csdata,uint32_t csdatasize,uint8_t writeflag) {
 	const uint8_t *cp,*cpe;
 //	char labelsbuff[LABELS_BUFF_SIZE];
@@ -208,7 +227,7 @@ uint32_t csorder_sort(cspri chain[100],uint8_t csdataver,const uint8_t *csdata,u
 		if (writeflag) {
 			chain[i].priority += i;
 		} else {
-			chain[i].priority += csdb_getopcnt(chain[i].ip,chain[i].port);
+			chain[i].priority += csorder_readscore(chain[i].ip,chain[i].port);
 		}
 //		csorder_log_chain_element(i,chain+i);
 		i++;
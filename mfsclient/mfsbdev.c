@@ -1625,6 +1625,8 @@ int parse_option(const char *oname,const char *ovalue) {
 		mcfg.readahead_leng = strtoul(ovalue,NULL,0);
 	} else if (strcmp(oname,"mfsreadaheadtrigger")==0) {
 		mcfg.readahead_trigger = strtoul(ovalue,NULL,0);
+	} else if (strcmp(oname,"mfsreadstripes")==0) {
+		mcfg.read_stripes = strtoul(ovalue,NULL,0);
 	} else if (strcmp(oname,"mfserroronlostchunk")==0) {
 		if (*ovalue) {
 			printf("value %s not used in option mfserroronlostchunk\n",ovalue);
@@ -1721,6 +1723,7 @@ void usage(const char *appname) {
 	fprintf(stderr,"\tmfsreadaheadsize=N       define size of all read ahead buffers in MiB (default: 128)\n");
 	fprintf(stderr,"\tmfsreadaheadleng=N       define amount of bytes to be additionally read (default: 2097152 = 2MiB)\n");
 	fprintf(stderr,"\tmfsreadaheadtrigger=N    define amount of bytes read sequentially that turns on read ahead (default: 20971520)\n");
+	fprintf(stderr,"\tmfsreadstripes=N         define maximum number of chunk copies used in parallel to read one large block of data (default: 1)\n");
 	fprintf(stderr,"\tmfserroronlostchunk      when all known chunkservers are connected to the master and the required chunk is missing then immediately finish I/O and return an error\n");
 	fprintf(stderr,"\tmfserroronnospace        when all known chunkservers are connected to the master and there is no free space then immediately finish I/O and return an error\n");
 	fprintf(stderr,"\tmfsioretries=N           define number of retries before I/O error is returned (default: 30)\n");
@@ -1506,6 +1506,7 @@ void mfs_set_defaults(mfscfg *mcfg) {
 	mcfg->logelevateto = MFSLOG_NOTICE;
 	mcfg->master_min_version_maj = 0;
 	mcfg->master_min_version_mid = 0;
+	mcfg->read_stripes = 1;
 }
 
 int mfs_init(mfscfg *mcfg,uint8_t stage) {
@@ -1537,6 +1538,7 @@ int mfs_init(mfscfg *mcfg,uint8_t stage) {
 	mcfgi.logelevateto = mcfg->logelevateto;
 	mcfgi.master_min_version_maj = mcfg->master_min_version_maj;
 	mcfgi.master_min_version_mid = mcfg->master_min_version_mid;
+	mcfgi.read_stripes = mcfg->read_stripes;
 
 	return mfs_int_init(&mcfgi,stage);
 }
@@ -37,6 +37,7 @@ typedef struct _mfscfg {
 	int logelevateto;
 	uint16_t master_min_version_maj;
 	uint16_t master_min_version_mid;
+	int read_stripes;
 } mfscfg;
 
 typedef struct _mfsaclid {
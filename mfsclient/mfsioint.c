@@ -2401,6 +2401,7 @@ void mfs_int_set_defaults(mfs_int_cfg *mcfg) {
 	mcfg->logelevateto = MFSLOG_NOTICE;
 	mcfg->master_min_version_maj = 0;
 	mcfg->master_min_version_mid = 0;
+	mcfg->read_stripes = 1;
 }
 
 int mfs_int_init(mfs_int_cfg *mcfg,uint8_t stage) {
@@ -2471,7 +2472,7 @@ int mfs_int_init(mfs_int_cfg *mcfg,uint8_t stage) {
 
 		csdb_init();
 		delay_init();
-		read_data_init(mcfg->read_cache_mb*1024*1024,mcfg->readahead_leng,mcfg->readahead_trigger,mcfg->io_try_cnt,mcfg->io_timeout,mcfg->min_log_entry,mcfg->error_on_lost_chunk,mcfg->error_on_no_space);
+		read_data_init(mcfg->read_cache_mb*1024*1024,mcfg->readahead_leng,mcfg->readahead_trigger,mcfg->read_stripes,mcfg->io_try_cnt,mcfg->io_timeout,mcfg->min_log_entry,mcfg->error_on_lost_chunk,mcfg->error_on_no_space);
 		write_data_init(mcfg->write_cache_mb*1024*1024,mcfg->io_try_cnt,mcfg->io_timeout,mcfg->min_log_entry,mcfg->error_on_lost_chunk,mcfg->error_on_no_space);
 
 		zassert(pthread_mutex_init(&fdtablock,NULL));
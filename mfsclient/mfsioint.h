@@ -32,6 +32,7 @@ typedef struct _mfs_int_cfg {
 	int logelevateto;
 	uint16_t master_min_version_maj;
 	uint16_t master_min_version_mid;
+	int read_stripes;
 } mfs_int_cfg;
 
 #define MFS_NGROUPS_MAX 256
@@ -230,6 +230,7 @@ struct mfsopts {
 	unsigned readaheadsize;
 	unsigned readaheadleng;
 	unsigned readaheadtrigger;
+	unsigned readstripes;
 	int erroronlostchunk;
 	int erroronnospace;
 	unsigned ioretries;
@@ -307,6 +308,7 @@ static struct fuse_opt mfs_opts_stage2[] = {
 	MFS_OPT("mfsreadaheadsize=%u", readaheadsize, 0),
 	MFS_OPT("mfsreadaheadleng=%u", readaheadleng, 0),
 	MFS_OPT("mfsreadaheadtrigger=%u", readaheadtrigger, 0),
+	MFS_OPT("mfsreadstripes=%u", readstripes, 0),
 	MFS_OPT("mfserroronlostchunk", erroronlostchunk, 1),
 	MFS_OPT("mfserroronnospace", erroronnospace, 1),
 	MFS_OPT("mfsioretries=%u", ioretries, 0),
@@ -442,6 +444,7 @@ static void usage(const char *progname) {
 	fprintf(fd,"    -o mfsreadaheadsize=N       define size of all read ahead buffers in MiB (default: 256)\n");
 	fprintf(fd,"    -o mfsreadaheadleng=N       define amount of bytes to be additionally read (default: 1048576)\n");
 	fprintf(fd,"    -o mfsreadaheadtrigger=N    define amount of bytes read sequentially that turns on read ahead (default: 10 * mfsreadaheadleng)\n");
+	fprintf(fd,"    -o mfsreadstripes=N         define maximum number of chunk copies used in parallel to read one large block of data (default: 1 - no striping)\n");
 	fprintf(fd,"    -o mfserroronlostchunk      when all known chunkservers are connected to the master and the required chunk is missing then immediately finish I/O and return an error\n");
 	fprintf(fd,"    -o mfserroronnospace        when all known chunkservers are connected to the master and there is no free space then immediately finish I/O and return an error\n");
 	fprintf(fd,"    -o mfsioretries=N           define number of retries before I/O error is returned (default: 30)\n");
@@ -937,6 +940,7 @@ uint32_t main_snprint_parameters(char *buff,uint32_t size) {
 	NUMOPT("mfsreadaheadsize","u",readaheadsize);
 	NUMOPT("mfsreadaheadleng","u",readaheadleng);
 	NUMOPT("mfsreadaheadtrigger","u",readaheadtrigger);
+	NUMOPT("mfsreadstripes","u",readstripes);
 	BOOLOPT("mfserroronlostchunk",erroronlostchunk);
 	BOOLOPT("mfserroronnospace",erroronnospace);
 	NUMOPT("mfsioretries","u",ioretries);
@@ -1311,7 +1315,7 @@ int mainloop(struct fuse_args *args,const char* mp,int mt,int fg) {
 	} else {
 		csdb_init();
 		delay_init();
-		read_data_init(mfsopts.readaheadsize*1024*1024,mfsopts.readaheadleng,mfsopts.readaheadtrigger,mfsopts.ioretries,mfsopts.timeout,mfsopts.logretry,mfsopts.erroronlostchunk,mfsopts.erroronnospace);
+		read_data_init(mfsopts.readaheadsize*1024*1024,mfsopts.readaheadleng,mfsopts.readaheadtrigger,mfsopts.readstripes,mfsopts.ioretries,mfsopts.timeout,mfsopts.logretry,mfsopts.erroronlostchunk,mfsopts.erroronnospace);
 		write_data_init(mfsopts.writecachesize*1024*1024,mfsopts.ioretries,mfsopts.timeout,mfsopts.logretry,mfsopts.erroronlostchunk,mfsopts.erroronnospace);
 #if FUSE_VERSION >= 30
 		mfs_init(mfsopts.debug,mfsopts.keepcache,mfsopts.readdirplusminto,mfsopts.direntrycacheto,mfsopts.entrycacheto,mfsopts.attrcacheto,mfsopts.xattrcacheto,mfsopts.groupscacheto,mfsopts.mkdircopysgid,mfsopts.sugidclearmode,1,mfsopts.fsyncmintime,mfsopts.noxattrs,mfsopts.noposixlocks,mfsopts.nobsdlocks); //mfsopts.xattraclsupport);
@@ -1787,6 +1791,7 @@ int main(int argc, char *argv[]) {
 	mfsopts.readaheadsize = 0;
 	mfsopts.readaheadleng = 0;
 	mfsopts.readaheadtrigger = 0;
+	mfsopts.readstripes = 0;
 	mfsopts.erroronlostchunk = 0;
 	mfsopts.erroronnospace = 0;
 	mfsopts.ioretries = 30;
@@ -2060,6 +2065,13 @@ int main(int argc, char *argv[]) {
 	if (mfsopts.readaheadtrigger==0) {
 		mfsopts.readaheadtrigger=mfsopts.readaheadleng*10;
 	}
+	if (mfsopts.readstripes==0) {
+		mfsopts.readstripes=1;
+	}
+	if (mfsopts.readstripes>4) {
+		fprintf(stderr,"read stripes too big (%u) - decreased to 4\n",mfsopts.readstripes);
+		mfsopts.readstripes=4;
+	}
 
 	if (mfsopts.nostdmountoptions==0) {
 		fuse_opt_add_arg(&args, "-o" DEFAULT_OPTIONS);
@@ -73,10 +73,23 @@
 #include "chunkrwlock.h"
 #include "chunksdatacache.h"
 #include "mfsalloc.h"
+#ifndef WIN32
+#include "stats.h"
+#endif
 #include "MFSCommunication.h"
 
 #define CHUNKSERVER_ACTIVITY_TIMEOUT 5.0
 
+// striped reads from many copies of the same chunk
+#define STRIPE_MIN_SIZE 0x100000
+#define STRIPES_MAX 4
+#define STRIPE_STRAGGLER_FACTOR 2.0
+
+// hedged reads - threshold is p95 of recent latencies (clamped to these values)
+#define HEDGE_MIN_THRESHOLD 0.005
+#define HEDGE_MAX_THRESHOLD 1.0
+#define HEDGE_DEFAULT_THRESHOLD 0.1
+
 #define WORKER_IDLE_TIMEOUT 1.0
 
 #define WORKER_BUSY_LAST_REQUEST_TIMEOUT 5.0
@@ -94,6 +107,16 @@
 
 #define READAHEAD_MAX 4
 
+// access pattern detection
+#define RA_PATTERN_RANDOM 0
+#define RA_PATTERN_SEQUENTIAL 1
+#define RA_PATTERN_STRIDED 2
+#define RA_PATTERN_BACKWARD 3
+
+#define RA_STRIDE_CONFIRM 2
+#define RA_STRIDE_MAXDEPTH 8
+#define RA_RATE_PERIOD 0.25
+
 /*
 typedef struct cblock_s {
 	uint8_t data[MFSBLOCKSIZE];
@@ -174,6 +197,8 @@ typedef struct rrequest_s {
 	uint32_t chindx;
 	uint32_t trycnt;
 	double modified;
+	double created;
+	uint8_t raflag; // 0 - demand read ; 1 - read-ahead (not used yet) ; 2 - read-ahead (used)
 	uint8_t refresh;
 	uint8_t mode;
 	uint16_t lcnt;
@@ -189,7 +214,15 @@ typedef struct inodedata_s {
 	uint8_t closing;
 	uint8_t inqueue;
 	uint8_t readahead;
+	uint8_t pattern;
+	uint8_t stridecnt;
+	int64_t stride;
+	uint64_t laststart;
 	uint64_t lastoffset;
+	uint64_t ratebytes;
+	double ratestart;
+	double consrate;	// bytes per second consumed by reader
+	double rlatency;	// average time between request creation and data arrival
 	uint16_t waiting_writers;
 	uint16_t readers_cnt;
 	uint16_t lcnt;
@@ -209,6 +242,7 @@ static pthread_key_t rangesstorage;
 
 static uint32_t readahead_leng;
 static uint32_t readahead_trigger;
+static uint32_t read_stripes;
 
 static uint64_t usectimeout;
 static uint32_t maxretries;
@@ -246,6 +280,72 @@ static pthread_attr_t worker_thattr;
 
 static void *jqueue; //,*dqueue;
 
+enum {
+	RA_SEQUENTIAL_READS,
+	RA_STRIDED_READS,
+	RA_BACKWARD_READS,
+	RA_RANDOM_READS,
+	RA_ISSUED_BYTES,
+	RA_HIT_BYTES,
+	RA_WASTED_BYTES,
+	RD_STRIPED_REQUESTS,
+	RD_STRAGGLER_REISSUES,
+	RD_HEDGED_READS,
+	RD_HEDGE_WINS,
+	RD_LATENCY_AVG,
+	RD_LATENCY_P95,
+	RD_LATENCY_P99,
+	STATNODES
+};
+
+#ifndef WIN32
+static void *statsptr[STATNODES];
+
+static inline void read_statsptr_init(void) {
+	void *s;
+	s = stats_get_subnode(NULL,"readahead",0,0);
+	statsptr[RA_SEQUENTIAL_READS] = stats_get_subnode(s,"sequential_reads",0,1);
+	statsptr[RA_STRIDED_READS] = stats_get_subnode(s,"strided_reads",0,1);
+	statsptr[RA_BACKWARD_READS] = stats_get_subnode(s,"backward_reads",0,1);
+	statsptr[RA_RANDOM_READS] = stats_get_subnode(s,"random_reads",0,1);
+	statsptr[RA_ISSUED_BYTES] = stats_get_subnode(s,"issued_bytes",0,1);
+	statsptr[RA_HIT_BYTES] = stats_get_subnode(s,"hit_bytes",0,1);
+	statsptr[RA_WASTED_BYTES] = stats_get_subnode(s,"wasted_bytes",0,1);
+	s = stats_get_subnode(NULL,"read_stripes",0,0);
+	statsptr[RD_STRIPED_REQUESTS] = stats_get_subnode(s,"striped_requests",0,1);
+	statsptr[RD_STRAGGLER_REISSUES] = stats_get_subnode(s,"straggler_reissues",0,1);
+	s = stats_get_subnode(NULL,"read_hedge",0,0);
+	statsptr[RD_HEDGED_READS] = stats_get_subnode(s,"hedged_reads",0,1);
+	statsptr[RD_HEDGE_WINS] = stats_get_subnode(s,"hedge_wins",0,1);
+	statsptr[RD_LATENCY_AVG] = stats_get_subnode(s,"usec_latency_avg",1,1);
+	statsptr[RD_LATENCY_P95] = stats_get_subnode(s,"usec_latency_p95",1,1);
+	statsptr[RD_LATENCY_P99] = stats_get_subnode(s,"usec_latency_p99",1,1);
+}
+
+static inline void read_stats_add(uint8_t id,uint64_t s) {
+	stats_counter_add(statsptr[id],s);
+}
+
+static inline void read_stats_latency(void) {
+	uint32_t avg,p95,p99;
+	csdb_getlatencystats(&avg,&p95,&p99);
+	stats_counter_set(statsptr[RD_LATENCY_AVG],avg);
+	stats_counter_set(statsptr[RD_LATENCY_P95],p95);
+	stats_counter_set(statsptr[RD_LATENCY_P99],p99);
+}
+#else
+static inline void read_statsptr_init(void) {
+}
+
+static inline void read_stats_add(uint8_t id,uint64_t s) {
+	(void)id;
+	(void)s;
+}
+
+static inline void read_stats_latency(void) {
+}
+#endif
+
 #if HAVE_ATOMICS
 static _Atomic uint64_t total_bytes_rcvd;
 #elif HAVE_SYNCS
@@ -303,7 +403,7 @@ void read_delayed_enqueue(rrequest *rreq,uint32_t usecs) {
 
 /* requests */
 
-static inline rrequest* read_new_request(inodedata *ind,uint64_t *offset,uint64_t blockend) {
+static inline rrequest* read_new_request(inodedata *ind,uint64_t *offset,uint64_t blockend,uint8_t raflag) {
 	uint64_t chunkoffset;
 	uint64_t chunkend;
 	uint32_t chunkleng;
@@ -332,6 +432,11 @@ static inline rrequest* read_new_request(inodedata *ind,uint64_t *offset,uint64_
 #endif
 	rreq->ind = ind;
 	rreq->modified = monotonic_seconds();
+	rreq->created = rreq->modified;
+	rreq->raflag = raflag;
+	if (raflag) {
+		read_stats_add(RA_ISSUED_BYTES,chunkleng);
+	}
 	rreq->wakeup_fd = -1;
 	rreq->waitingworker = 0;
 	rreq->offset = chunkoffset;
@@ -382,6 +487,9 @@ static inline void read_delete_request(rrequest *rreq) {
 	} else {
 		rreq->ind->reqtail = rreq->prev;
 	}
+	if (rreq->raflag==1) {
+		read_stats_add(RA_WASTED_BYTES,rreq->leng);
+	}
 #ifdef HAVE___SYNC_OP_AND_FETCH
 #ifdef RDEBUG
 	rbuffsize = __sync_sub_and_fetch(&reqbufftotalsize,rreq->leng);
@@ -426,6 +534,11 @@ void read_job_end(rrequest *rreq,int status,uint32_t delay) {
 	if (rreq->mode==FILLED) {
 		rreq->mode = READY;
 		rreq->trycnt = 0;
+		if (ind->rlatency==0.0) {
+			ind->rlatency = monotonic_seconds() - rreq->created;
+		} else {
+			ind->rlatency = (ind->rlatency * 7.0 + (monotonic_seconds() - rreq->created)) / 8.0;
+		}
 		zassert(pthread_cond_broadcast(&(rreq->cond)));
 	} else {
 		if (rreq->mode==BREAK) {
@@ -596,13 +709,184 @@ typedef struct _data_source {
 //	uint8_t reqsend;
 	uint32_t sent,tosend,received;
 	double lastrcvd,lastsend;
+	double reqtime,donetime;
 	uint8_t recvbuff[20];
 	uint8_t sendbuff[29];
 	uint32_t reccmd;
 	uint32_t recleng;
 	data_source_state state;
+	uint8_t measured; // latency of this request already measured
+	uint8_t hedge; // index+1 of data source reading the same range
+	uint8_t cancel;
 } data_source;
 
+static inline void read_prepare_request(data_source *ds,uint64_t chunkid,uint32_t version) {
+	uint8_t *wptr;
+
+	wptr = ds->sendbuff;
+	put32bit(&wptr,CLTOCS_READ);
+	if (ds->csver>=VERSION2INT(1,7,32)) {
+		put32bit(&wptr,21);
+		put8bit(&wptr,1);
+		ds->tosend = 29;
+	} else {
+		put32bit(&wptr,20);
+		ds->tosend = 28;
+	}
+	put64bit(&wptr,chunkid);
+	put32bit(&wptr,version);
+	put32bit(&wptr,ds->currpos);
+	put32bit(&wptr,ds->endpos-ds->currpos);
+	ds->sent = 0;
+}
+
+/* stripes: some copy finished its part, while other is much slower - give the rest of slow stripe to the idle connection */
+static inline uint8_t read_stripe_reissue(data_source *datasrc,uint8_t *parts,uint64_t chunkid,uint32_t version,double now) {
+	uint8_t j,k,n;
+	double tj,rj,ek,rk;
+	uint32_t verified;
+
+	if (*parts>=8) {
+		return 0;
+	}
+	for (j=0 ; j<*parts ; j++) {
+		if (datasrc[j].gotstatus && datasrc[j].fd>=0 && datasrc[j].tosend==0 && datasrc[j].received==0 && datasrc[j].donetime>datasrc[j].reqtime && datasrc[j].endpos>datasrc[j].startpos) {
+			break;
+		}
+	}
+	if (j>=*parts) {
+		return 0;
+	}
+	tj = datasrc[j].donetime - datasrc[j].reqtime;
+	rj = (datasrc[j].endpos - datasrc[j].startpos) / tj;
+	for (k=0 ; k<*parts ; k++) {
+		if (datasrc[k].gotstatus==0 && datasrc[k].fd>=0 && datasrc[k].hedge==0 && datasrc[k].endpos>=datasrc[k].currpos+2*MFSBLOCKSIZE) {
+			ek = now - datasrc[k].reqtime;
+			rk = (datasrc[k].currpos - datasrc[k].startpos) / ek;
+			if (ek > STRIPE_STRAGGLER_FACTOR * tj && rk * STRIPE_STRAGGLER_FACTOR < rj) {
+				break;
+			}
+		}
+	}
+	if (k>=*parts) {
+		return 0;
+	}
+	// data from partially received packet is not verified yet
+	verified = datasrc[k].currpos;
+	if (datasrc[k].received>8+20 && datasrc[k].reccmd==CSTOCL_READ_DATA) {
+		verified -= datasrc[k].received-(8+20);
+	}
+	n = *parts;
+	datasrc[n] = datasrc[j]; // connection goes to new slot - old one keeps its finished range
+	datasrc[j].fd = -1;
+	datasrc[n].startpos = verified;
+	datasrc[n].currpos = verified;
+	datasrc[n].endpos = datasrc[k].endpos;
+	datasrc[n].gotstatus = 0;
+	datasrc[n].received = 0;
+	datasrc[n].lastrcvd = now;
+	datasrc[n].reqtime = now;
+	datasrc[n].donetime = 0.0;
+	datasrc[n].measured = 1;
+	read_prepare_request(datasrc+n,chunkid,version);
+	tcpclose(datasrc[k].fd);
+	datasrc[k].fd = -1;
+	datasrc[k].tosend = 0;
+	datasrc[k].currpos = verified;
+	datasrc[k].endpos = verified;
+	datasrc[k].gotstatus = 1;
+	csdb_readinc(datasrc[n].ip,datasrc[n].port);
+	*parts = n+1;
+	read_stats_add(RD_STRAGGLER_REISSUES,1);
+	return 1;
+}
+
+/* hedged read: first copy didn't send anything for too long - ask another copy for the same range, first answer wins */
+static inline uint8_t read_hedge_start(data_source *datasrc,uint8_t *parts,const cspri *chain,uint16_t chainelements,uint16_t *chainused,uint32_t srcip,uint64_t chunkid,uint32_t version,double now,double threshold) {
+	uint8_t k,n;
+	int fd,cres;
+
+	if (*parts>=8 || *chainused>=chainelements) {
+		return 0;
+	}
+	for (k=0 ; k<*parts ; k++) {
+		if (datasrc[k].gotstatus==0 && datasrc[k].fd>=0 && datasrc[k].hedge==0 && datasrc[k].measured==0 && datasrc[k].received==0 && datasrc[k].tosend==0 && datasrc[k].reqtime>0.0 && now - datasrc[k].reqtime > threshold) {
+			break;
+		}
+	}
+	if (k>=*parts) {
+		return 0;
+	}
+	if (csdb_hedge_allowed()==0) {
+		return 0;
+	}
+	n = *parts;
+	datasrc[n].ip = chain[*chainused].ip;
+	datasrc[n].port = chain[*chainused].port;
+	datasrc[n].csver = chain[*chainused].version;
+	(*chainused)++;
+	if (datasrc[n].ip==0 && datasrc[n].port==0) {
+		return 0;
+	}
+	fd = conncache_get(datasrc[n].ip,datasrc[n].port);
+	if (fd>=0) {
+		datasrc[n].state = STATE_CONNECTED;
+	} else {
+		fd = tcpsocket();
+		if (fd<0) {
+			return 0;
+		}
+		if (tcpnonblock(fd)<0 || (srcip && tcpnumbind(fd,srcip,0)<0)) {
+			tcpclose(fd);
+			return 0;
+		}
+		cres = tcpnumconnect(fd,datasrc[n].ip,datasrc[n].port);
+		if (cres<0) {
+			tcpclose(fd);
+			return 0;
+		}
+		datasrc[n].state = (cres==0)?STATE_CONNECTED:STATE_CONNECTING;
+	}
+	if (tcpnodelay(fd)<0) {
+		mfs_log(MFSLOG_SYSLOG,MFSLOG_NOTICE,"readworker: can't set TCP_NODELAY: %s",strerr(errno));
+	}
+	datasrc[n].fd = fd;
+	datasrc[n].startpos = datasrc[k].startpos;
+	datasrc[n].currpos = datasrc[k].currpos;
+	datasrc[n].endpos = datasrc[k].endpos;
+	datasrc[n].gotstatus = 0;
+	datasrc[n].received = 0;
+	datasrc[n].reccmd = 0;
+	datasrc[n].recleng = 0;
+	datasrc[n].lastrcvd = now;
+	datasrc[n].lastsend = now;
+	datasrc[n].reqtime = now;
+	datasrc[n].donetime = 0.0;
+	datasrc[n].measured = 0;
+	datasrc[n].cancel = 0;
+	datasrc[n].hedge = k+1;
+	datasrc[k].hedge = n+1;
+	read_prepare_request(datasrc+n,chunkid,version);
+	csdb_readinc(datasrc[n].ip,datasrc[n].port);
+	*parts = n+1;
+	read_stats_add(RD_HEDGED_READS,1);
+	return 1;
+}
+
+static inline void read_hedge_cancel(data_source *ds) {
+	if (ds->fd>=0) {
+		tcpclose(ds->fd);
+		ds->fd = -1;
+	}
+	ds->gotstatus = 1;
+	ds->tosend = 0;
+	ds->received = 0;
+	ds->currpos = ds->startpos;
+	ds->endpos = ds->startpos;
+	ds->hedge = 0;
+	ds->cancel = 0;
+}
+
 void* read_worker(void *arg) {
 	uint32_t z1,z2,z3;
 	uint8_t *data;
@@ -640,10 +924,10 @@ void* read_worker(void *arg) {
 	uint8_t readanything;
 
 	cspri chain[100];
-	uint16_t chainelements;
+	uint16_t chainelements,chainused;
 
 	uint8_t cnt;
-	uint8_t cpart,part,parts;
+	uint8_t cpart,part,parts,ecparts;
 	data_source_state connect_status;
 
 	uint32_t chindx;
@@ -663,6 +947,7 @@ void* read_worker(void *arg) {
 	double start,now;
 	double workingtime,lrdiff;
 	double timeoutadd;
+	double hedgethreshold;
 	uint8_t firsttime = 1;
 	worker *w = (worker*)arg;
 
@@ -991,8 +1276,30 @@ void* read_worker(void *arg) {
 				continue;
 			}
 			parts = chainelements; // 4 or 8
+			ecparts = parts;
 		} else {
 			parts = 1;
+			ecparts = 0;
+			// large request - read it from many copies at once
+			if (read_stripes>1 && chainelements>1) {
+				uint32_t remaining;
+				remaining = rreq->leng - (rreq->currentpos - (rreq->offset & MFSCHUNKMASK));
+				parts = remaining / STRIPE_MIN_SIZE;
+				if (parts > chainelements) {
+					parts = chainelements;
+				}
+				if (parts > read_stripes) {
+					parts = read_stripes;
+				}
+				if (parts > STRIPES_MAX) {
+					parts = STRIPES_MAX;
+				}
+				if (parts<2) {
+					parts = 1;
+				} else {
+					read_stats_add(RD_STRIPED_REQUESTS,1);
+				}
+			}
 		}
 
 
@@ -1031,6 +1338,23 @@ void* read_worker(void *arg) {
 		for (part=0 ; part<parts ; part++) {
 			csdb_readinc(datasrc[part].ip,datasrc[part].port);
 		}
+		chainused = parts;
+		hedgethreshold = 0.0;
+		if (ecparts==0 && chainelements>parts) {
+			uint32_t avg,p95,p99;
+			csdb_getlatencystats(&avg,&p95,&p99);
+			if (p95==0) { // nothing measured yet
+				hedgethreshold = HEDGE_DEFAULT_THRESHOLD;
+			} else {
+				hedgethreshold = p95 / 1000000.0;
+				if (hedgethreshold < HEDGE_MIN_THRESHOLD) {
+					hedgethreshold = HEDGE_MIN_THRESHOLD;
+				} else if (hedgethreshold > HEDGE_MAX_THRESHOLD) {
+					hedgethreshold = HEDGE_MAX_THRESHOLD;
+				}
+			}
+		}
+		csdb_readrequest();
 
 
 		start = monotonic_seconds();
@@ -1205,6 +1529,11 @@ void* read_worker(void *arg) {
 			datasrc[part].recleng = 0;
 			datasrc[part].lastrcvd = 0.0;
 			datasrc[part].lastsend = 0.0;
+			datasrc[part].reqtime = 0.0;
+			datasrc[part].donetime = 0.0;
+			datasrc[part].measured = 0;
+			datasrc[part].hedge = 0;
+			datasrc[part].cancel = 0;
 			datasrc[part].startpos = 0xFFFFFFFF;
 			datasrc[part].currpos = 0xFFFFFFFF;
 			datasrc[part].endpos = 0xFFFFFFFF;
@@ -1276,14 +1605,14 @@ void* read_worker(void *arg) {
 				}
 //				mfs_log(MFSLOG_SYSLOG,MFSLOG_DEBUG,"rreq->offset: %"PRIu64" ; startpos: %"PRIu32" ; rreq->currentpos: %"PRIu32" ; rleng: %"PRIu32" ; currpos: %"PRIu32" ; endpos: %"PRIu32,rreq->offset,startpos,rreq->currentpos,rleng,currpos,endpos);
 
-				if (parts==8 || parts==4) {
+				if (ecparts) {
 					uint32_t firstcluster,currentcluster,lastcluster;
 					uint32_t firstpartoffset,currentpartoffset,lastpartoffset;
 					int firstpart,currentpart,lastpart;
 
 					uint8_t clusterbits,partmask;
 
-					if (parts==8) {
+					if (ecparts==8) {
 						clusterbits = 21;
 						partmask = 0x7;
 					} else {
@@ -1330,11 +1659,22 @@ void* read_worker(void *arg) {
 					datasrc[0].startpos = startpos;
 					datasrc[0].currpos = currpos;
 					datasrc[0].endpos = endpos;
-				} else { // not supported
+				} else { // stripes - every copy reads its own range (aligned to blocks)
+					uint32_t stripeleng,spos;
+					stripeleng = (endpos - currpos) / parts;
+					spos = currpos;
 					for (part=0 ; part<parts ; part++) {
-						datasrc[part].startpos = 0;
-						datasrc[part].currpos = 0;
-						datasrc[part].endpos = 0;
+						datasrc[part].startpos = spos;
+						datasrc[part].currpos = spos;
+						if (part==parts-1) {
+							spos = endpos;
+						} else {
+							spos = (spos + stripeleng + MFSBLOCKMASK) & ~MFSBLOCKMASK;
+							if (spos > endpos) {
+								spos = endpos;
+							}
+						}
+						datasrc[part].endpos = spos;
 					}
 				}
 			}
@@ -1377,9 +1717,19 @@ void* read_worker(void *arg) {
 				break;
 			}
 
+			if (ecparts==0 && parts>1 && reqsend) {
+				read_stripe_reissue(datasrc,&parts,chunkid,version,now);
+			}
+			if (hedgethreshold>0.0 && reqsend) {
+				read_hedge_start(datasrc,&parts,chain,chainelements,&chainused,srcip,chunkid,version,now,hedgethreshold);
+			}
+
 			lrdiff = 0.0;
 			cpart = 0;
 			for (part=0 ; part<parts ; part++) {
+				if (datasrc[part].gotstatus) {
+					continue;
+				}
 				if (datasrc[part].lastrcvd==0.0) {
 					datasrc[part].lastrcvd = now;
 				} else {
@@ -1421,27 +1771,14 @@ void* read_worker(void *arg) {
 				for (part=0 ; part<parts ; part++) {
 //					mfs_log(MFSLOG_SYSLOG,MFSLOG_DEBUG,"part: %u ; startpos: %"PRIu32" ; currpos: %"PRIu32" ; endpos: %"PRIu32,part,datasrc[part].startpos,datasrc[part].currpos,datasrc[part].endpos);
 					if (datasrc[part].endpos>datasrc[part].currpos) {
-						wptr = datasrc[part].sendbuff;
-						put32bit(&wptr,CLTOCS_READ);
-						if (datasrc[part].csver>=VERSION2INT(1,7,32)) {
-							put32bit(&wptr,21);
-							put8bit(&wptr,1);
-							datasrc[part].tosend = 29;
-						} else {
-							put32bit(&wptr,20);
-							datasrc[part].tosend = 28;
-						}
-						if (parts==1) {
-							put64bit(&wptr,chunkid);
-						} else if (parts==8) {
-							put64bit(&wptr,COMBINE_CHUNKID_AND_ECID(chunkid,0x20|part));
-						} else { // parts==4
-							put64bit(&wptr,COMBINE_CHUNKID_AND_ECID(chunkid,0x10|part));
+						if (ecparts==0) {
+							read_prepare_request(datasrc+part,chunkid,version);
+						} else if (ecparts==8) {
+							read_prepare_request(datasrc+part,COMBINE_CHUNKID_AND_ECID(chunkid,0x20|part),version);
+						} else { // ecparts==4
+							read_prepare_request(datasrc+part,COMBINE_CHUNKID_AND_ECID(chunkid,0x10|part),version);
 						}
-						put32bit(&wptr,version);
-						put32bit(&wptr,datasrc[part].currpos);
-						put32bit(&wptr,datasrc[part].endpos-datasrc[part].currpos);
-						datasrc[part].sent = 0;
+						datasrc[part].reqtime = now;
 					} else {
 						datasrc[part].gotstatus = 1;
 					}
@@ -1454,6 +1791,9 @@ void* read_worker(void *arg) {
 			zassert(pthread_mutex_unlock(&(ind->lock)));
 
 			for (part=0 ; part<parts ; part++) {
+				if (datasrc[part].fd<0 || datasrc[part].state==STATE_CONNECTING) {
+					continue;
+				}
 				if (datasrc[part].tosend==0 && (now - datasrc[part].lastsend > 1.0)) {
 					wptr = datasrc[part].sendbuff;
 					put32bit(&wptr,ANTOAN_NOP);
@@ -1509,7 +1849,7 @@ void* read_worker(void *arg) {
 			for (part=0 ; part<parts ; part++) {
 				if (datasrc[part].tosend>0 || datasrc[part].gotstatus==0) {
 					pfd[desc].fd = datasrc[part].fd;
-					pfd[desc].events = POLLIN;
+					pfd[desc].events = (datasrc[part].state==STATE_CONNECTING)?0:POLLIN;
 					pfd[desc].revents = 0;
 					if (datasrc[part].tosend>0) {
 						pfd[desc].events |= POLLOUT;
@@ -1570,6 +1910,20 @@ void* read_worker(void *arg) {
 			desc = 1;
 			for (part=0 ; part<parts ; part++) {
 				if (datasrc[part].tosend>0 || datasrc[part].gotstatus==0) {
+					if (datasrc[part].state==STATE_CONNECTING) { // hedged read connection
+						if (pfd[desc].revents & (POLLOUT|POLLERR|POLLHUP)) {
+							if (tcpgetstatus(datasrc[part].fd)) {
+								datasrc[part].cancel = 1;
+								if (datasrc[part].hedge) {
+									datasrc[datasrc[part].hedge-1].hedge = 0;
+								}
+							} else {
+								datasrc[part].state = STATE_CONNECTED;
+							}
+						}
+						desc++;
+						continue;
+					}
 					if (pfd[desc].revents&POLLHUP) {
 						if (trycnt >= minlogretry) {
 							univmakestrip(csstrip,datasrc[part].ip);
@@ -1635,6 +1989,23 @@ void* read_worker(void *arg) {
 
 								datasrc[part].reccmd = get32bit(&rptr);
 								datasrc[part].recleng = get32bit(&rptr);
+								if (datasrc[part].reccmd==CSTOCL_READ_DATA && datasrc[part].measured==0) {
+									datasrc[part].measured = 1;
+									csdb_readlatency(datasrc[part].ip,datasrc[part].port,(uint32_t)((datasrc[part].lastrcvd-datasrc[part].reqtime)*1000000.0));
+									if (datasrc[part].hedge) { // first answer - drop the other one
+										cpart = datasrc[part].hedge-1;
+										datasrc[cpart].hedge = 0;
+										datasrc[cpart].cancel = 1;
+										datasrc[part].hedge = 0;
+										if (datasrc[cpart].measured==0) { // slow copy - its latency is at least that long
+											datasrc[cpart].measured = 1;
+											csdb_readlatency(datasrc[cpart].ip,datasrc[cpart].port,(uint32_t)((datasrc[part].lastrcvd-datasrc[cpart].reqtime)*1000000.0));
+										}
+										if (part>cpart) {
+											read_stats_add(RD_HEDGE_WINS,1);
+										}
+									}
+								}
 								if (datasrc[part].reccmd==CSTOCL_READ_STATUS) {
 									if (datasrc[part].recleng!=9) {
 										mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"readworker: got wrong sized status packet from chunkserver (leng:%"PRIu32")",datasrc[part].recleng);
@@ -1710,7 +2081,7 @@ void* read_worker(void *arg) {
 								i = universal_read(datasrc[part].fd,datasrc[part].recvbuff + (datasrc[part].received-8),datasrc[part].recleng - (datasrc[part].received-8));
 							} else {
 								datacurrpos = datasrc[part].currpos;
-								if (parts==8 || parts==4) {
+								if (ecparts) {
 									datacurrpos &= (~0x3FFFF);
 									datacurrpos *= parts;
 									datacurrpos += ((uint32_t)part) << 18;
@@ -1788,9 +2159,9 @@ void* read_worker(void *arg) {
 									rptr = datasrc[part].recvbuff;
 									recchunkid = get64bit(&rptr);
 									recstatus = get8bit(&rptr);
-									if (parts==1) {
+									if (ecparts==0) {
 										expectedchunkid = chunkid;
-									} else if (parts==8) {
+									} else if (ecparts==8) {
 										expectedchunkid = COMBINE_CHUNKID_AND_ECID(chunkid,0x20|part);
 									} else { // parts==4
 										expectedchunkid = COMBINE_CHUNKID_AND_ECID(chunkid,0x10|part);
@@ -1829,6 +2200,7 @@ void* read_worker(void *arg) {
 										break;
 									}
 									datasrc[part].gotstatus = 1;
+									datasrc[part].donetime = monotonic_seconds();
 								} else if (datasrc[part].reccmd==CSTOCL_READ_DATA) {
 									uint64_t expectedchunkid;
 									rptr = datasrc[part].recvbuff;
@@ -1842,12 +2214,12 @@ void* read_worker(void *arg) {
 //									mfs_log(MFSLOG_SYSLOG,MFSLOG_DEBUG,"part: %u ; currpos: %"PRIu32" ; recsize: %"PRIu32,part,datasrc[part].currpos,recsize);
 									datacurrpos = datasrc[part].currpos - recsize;
 //									mfs_log(MFSLOG_SYSLOG,MFSLOG_DEBUG,"part: %u ; start currpos: %"PRIu32,part,datacurrpos);
-									if (parts==8 || parts==4) {
+									if (ecparts) {
 										datacurrpos &= (~0x3FFFF);
 										datacurrpos *= parts;
 										datacurrpos += ((uint32_t)part) << 18;
 										datacurrpos += (datasrc[part].currpos - recsize) & 0x3FFFF;
-										if (parts==8) {
+										if (ecparts==8) {
 											expectedchunkid = COMBINE_CHUNKID_AND_ECID(chunkid,0x20|part);
 										} else { // parts==4
 											expectedchunkid = COMBINE_CHUNKID_AND_ECID(chunkid,0x10|part);
@@ -1894,6 +2266,11 @@ void* read_worker(void *arg) {
 					desc++;
 				}
 			}
+			for (part=0 ; part<parts ; part++) {
+				if (datasrc[part].cancel) {
+					read_hedge_cancel(datasrc+part);
+				}
+			}
 			if (status==EIO) {
 				break;
 			}
@@ -1906,12 +2283,16 @@ void* read_worker(void *arg) {
 #endif
 
 		for (part=0 ; part<parts ; part++){
+			if (datasrc[part].fd<0) {
+				continue;
+			}
 			if (status==0 && datasrc[part].csver>=VERSION2INT(1,7,32)) {
 				conncache_insert(datasrc[part].ip,datasrc[part].port,datasrc[part].fd);
 			} else {
 				tcpclose(datasrc[part].fd);
 			}
 		}
+		read_stats_latency();
 
 		if (status==EINTR) {
 			status=0;
@@ -1932,10 +2313,23 @@ void* read_worker(void *arg) {
 				rreq->currentpos = rreq->offset & MFSCHUNKMASK;
 				memset(rreq->splitcurrpos,0,sizeof(rreq->splitcurrpos));
 			} else {
-				if (parts==1) {
-					rreq->currentpos = datasrc[0].currpos;
+				if (ecparts==0) {
+					uint32_t pos;
+					uint8_t moved;
+					// stripes - keep only continuous range of received data
+					pos = datasrc[0].currpos;
+					do {
+						moved = 0;
+						for (part=1 ; part<parts ; part++) {
+							if (datasrc[part].startpos<=pos && datasrc[part].currpos>pos) {
+								pos = datasrc[part].currpos;
+								moved = 1;
+							}
+						}
+					} while (moved);
+					rreq->currentpos = pos;
 					memset(rreq->splitcurrpos,0,sizeof(rreq->splitcurrpos));
-				} else if (parts==8 || parts==4) {
+				} else {
 					uint32_t minblockpos;
 
 					minblockpos = UINT32_C(0xFFFFFFFF);
@@ -2012,7 +2406,7 @@ void read_data_ranges_free(void* ptr) {
 	}
 }
 
-void read_data_init (uint64_t readaheadsize,uint32_t readaheadleng,uint32_t readaheadtrigger,uint32_t retries,uint32_t timeout,uint32_t logretry,uint8_t erronlostchunk,uint8_t erronnospace) {
+void read_data_init (uint64_t readaheadsize,uint32_t readaheadleng,uint32_t readaheadtrigger,uint32_t readstripes,uint32_t retries,uint32_t timeout,uint32_t logretry,uint8_t erronlostchunk,uint8_t erronnospace) {
 	uint32_t i;
 	size_t mystacksize;
 //	sigset_t oldset;
@@ -2024,7 +2418,9 @@ void read_data_init (uint64_t readaheadsize,uint32_t readaheadleng,uint32_t read
 	minlogretry = logretry;
 	readahead_leng = readaheadleng;
 	readahead_trigger = readaheadtrigger;
+	read_stripes = readstripes;
 	maxreadaheadsize = readaheadsize;
+	read_statsptr_init();
 	erroronlostchunk = erronlostchunk;
 	erroronnospace = erronnospace;
 	reqbufftotalsize = 0;
@@ -2211,6 +2607,136 @@ static inline void read_inode_free(uint32_t indh,inodedata *indf) {
 	}
 }
 
+/* detects access pattern from distance between starts of consecutive reads */
+static inline void read_pattern_detect(inodedata *ind,uint64_t offset,uint32_t size,double now) {
+	int64_t delta;
+
+	if (offset==ind->lastoffset) {
+		ind->pattern = RA_PATTERN_SEQUENTIAL;
+		ind->stridecnt = 0;
+		ind->stride = 0;
+		read_stats_add(RA_SEQUENTIAL_READS,1);
+	} else {
+		delta = (int64_t)offset - (int64_t)ind->laststart;
+		if (delta!=0 && delta==ind->stride) {
+			if (ind->stridecnt<RA_STRIDE_CONFIRM) {
+				ind->stridecnt++;
+			}
+		} else {
+			ind->stride = delta;
+			ind->stridecnt = 0;
+		}
+		if (ind->stridecnt>=RA_STRIDE_CONFIRM && (delta<0 || delta>(int64_t)size)) {
+			if (delta<0) {
+				ind->pattern = RA_PATTERN_BACKWARD;
+				read_stats_add(RA_BACKWARD_READS,1);
+			} else {
+				ind->pattern = RA_PATTERN_STRIDED;
+				read_stats_add(RA_STRIDED_READS,1);
+			}
+		} else {
+			ind->pattern = RA_PATTERN_RANDOM;
+			read_stats_add(RA_RANDOM_READS,1);
+		}
+	}
+	ind->laststart = offset;
+	// consumption rate - idle periods are not counted
+	if (ind->ratestart==0.0 || now > ind->ratestart + 4 * RA_RATE_PERIOD) {
+		ind->ratestart = now;
+		ind->ratebytes = 0;
+	} else if (now >= ind->ratestart + RA_RATE_PERIOD) {
+		if (ind->consrate==0.0) {
+			ind->consrate = ind->ratebytes / (now - ind->ratestart);
+		} else {
+			ind->consrate = (ind->consrate + ind->ratebytes / (now - ind->ratestart)) / 2.0;
+		}
+		ind->ratestart = now;
+		ind->ratebytes = 0;
+	}
+	ind->ratebytes += size;
+}
+
+/* bytes consumed by reader during two average request round trips */
+static inline uint64_t read_ra_bdp(inodedata *ind) {
+	return ind->consrate * ind->rlatency * 2.0;
+}
+
+/* read-ahead window - grows with readahead level, or faster when reader outruns chunkservers */
+static inline uint64_t read_ra_window(inodedata *ind,uint64_t rbuffsize) {
+	uint64_t w,bdp,maxw;
+
+	w = readahead_leng * (1<<((ind->readahead-1)*2));
+	if (rbuffsize < maxreadaheadsize / 2) {
+		bdp = read_ra_bdp(ind);
+		maxw = readahead_leng * (1<<((READAHEAD_MAX-1)*2));
+		if (bdp > maxw) {
+			bdp = maxw;
+		}
+		if (bdp > w) {
+			w = bdp;
+		}
+	}
+	return w;
+}
+
+/* number of records prefetched ahead for strided and backward patterns */
+static inline uint32_t read_ra_stride_depth(inodedata *ind,uint32_t size) {
+	uint64_t d;
+
+	if (ind->pattern!=RA_PATTERN_STRIDED && ind->pattern!=RA_PATTERN_BACKWARD) {
+		return 0;
+	}
+	d = 2;
+	if (size>0) {
+		d += read_ra_bdp(ind) / size;
+	}
+	if (d > RA_STRIDE_MAXDEPTH) {
+		d = RA_STRIDE_MAXDEPTH;
+	}
+	return d;
+}
+
+static inline uint8_t read_ra_range_free(inodedata *ind,uint64_t blockstart,uint64_t blockend) {
+	rrequest *rreq;
+
+	for (rreq = ind->reqhead ; rreq ; rreq=rreq->next) {
+		if (!STATE_NOT_NEEDED(rreq->mode)) {
+			if (!(blockend <= rreq->offset || blockstart >= rreq->offset+rreq->leng)) {
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+static inline void read_ra_stride(inodedata *ind,uint64_t offset,uint32_t size,uint64_t rbuffsize) {
+	uint32_t depth,j;
+	int64_t start;
+	uint64_t blockstart,blockend;
+
+	depth = read_ra_stride_depth(ind,size);
+	for (j=1 ; j<=depth && rbuffsize<maxreadaheadsize ; j++) {
+		start = (int64_t)offset + ind->stride * (int64_t)j;
+		if (start<0 || (uint64_t)start>=ind->fleng) {
+			break;
+		}
+		blockstart = start;
+		blockend = blockstart + size;
+		if (blockend > ind->fleng) {
+			blockend = ind->fleng;
+		}
+		if (read_ra_range_free(ind,blockstart,blockend)) {
+#ifdef RDEBUG
+			fprintf(stderr,"%.6lf: read_data: inode: %"PRIu32" (stride %"PRId64") add new read-ahead rreq (%"PRIu64":%"PRIu64"/%"PRId64")\n",monotonic_seconds(),ind->inode,ind->stride,blockstart,blockend,blockend-blockstart);
+#endif
+			rbuffsize += blockend - blockstart;
+			while (blockstart < blockend) {
+				(void)read_new_request(ind,&blockstart,blockend,1);
+			}
+		}
+	}
+}
+
 // return list of rreq
 int read_data(void *vid, uint64_t offset, uint32_t *size, void **vrhead,struct iovec **iov,uint32_t *iovcnt) {
 	inodedata *ind = (inodedata*)vid;
@@ -2260,6 +2786,8 @@ int read_data(void *vid, uint64_t offset, uint32_t *size, void **vrhead,struct i
 #endif
 
 	if (ind->status==0 && ind->closing==0) {
+		now = monotonic_seconds();
+		read_pattern_detect(ind,offset,*size,now);
 		if (offset==ind->lastoffset) {
 			if (offset==0) { // begin with read-ahead turned on
 				ind->readahead = 1;
@@ -2296,7 +2824,6 @@ int read_data(void *vid, uint64_t offset, uint32_t *size, void **vrhead,struct i
 				lastbyte = ind->fleng;
 			}
 		}
-		now = monotonic_seconds();
 
 		// cleanup unused requests
 		reqno = 0;
@@ -2319,7 +2846,7 @@ int read_data(void *vid, uint64_t offset, uint32_t *size, void **vrhead,struct i
 #endif
 				read_rreq_not_needed(rreq);
 				reqno--;
-			} else if ((lastbyte <= rreq->offset || firstbyte >= rreq->offset+rreq->leng) && reqno>3) {
+			} else if ((lastbyte <= rreq->offset || firstbyte >= rreq->offset+rreq->leng) && reqno>3+read_ra_stride_depth(ind,*size)) {
 #ifdef RDEBUG
 				fprintf(stderr,"%.6lf: read_data: inode: %"PRIu32" - too many requests: free rreq (%"PRIu64":%"PRIu64"/%"PRIu32" ; lcnt:%u ; mode:%s)\n",monotonic_seconds(),ind->inode,rreq->offset,rreq->offset+rreq->leng,rreq->leng,rreq->lcnt,read_data_modename(rreq->mode));
 #endif
@@ -2401,11 +2928,15 @@ int read_data(void *vid, uint64_t offset, uint32_t *size, void **vrhead,struct i
 						rtail = &(rl->next);
 						rreq->lcnt++;
 						added = 1;
+						if (rreq->raflag) {
+							rreq->raflag = 2;
+							read_stats_add(RA_HIT_BYTES,rl->reqleng);
+						}
 						if (ind->readahead && i==edges-2) {
 							// request next block of data
 							if (rreq->next==NULL && rbuffsize<maxreadaheadsize) {
 								blockstart = rreq->offset+rreq->leng;
-								blockend = blockstart + (readahead_leng * (1<<((ind->readahead-1)*2)));
+								blockend = blockstart + read_ra_window(ind,rbuffsize);
 								sassert(blockend>blockstart);
 								raok = 1;
 								for (rreqn = ind->reqhead ; rreqn && raok ; rreqn=rreqn->next) {
@@ -2420,16 +2951,16 @@ int read_data(void *vid, uint64_t offset, uint32_t *size, void **vrhead,struct i
 #ifdef RDEBUG
 										fprintf(stderr,"%.6lf: read_data: inode: %"PRIu32" (middle of existing block) add new read-ahead rreq (%"PRIu64":%"PRIu64"/%"PRId64")\n",monotonic_seconds(),ind->inode,blockstart,blockend,blockend-blockstart);
 #endif
-										read_new_request(ind,&blockstart,blockend);
+										read_new_request(ind,&blockstart,blockend,1);
 									} else if (blockstart<ind->fleng) {
 #ifdef RDEBUG
 										fprintf(stderr,"%.6lf: read_data: inode: %"PRIu32" (middle of existing block) add new read-ahead rreq (%"PRIu64":%"PRIu64"/%"PRId64")\n",monotonic_seconds(),ind->inode,blockstart,ind->fleng,ind->fleng-blockstart);
 #endif
-										read_new_request(ind,&blockstart,ind->fleng);
+										read_new_request(ind,&blockstart,ind->fleng,1);
 									}
 								// and another one if necessary
 									if ((blockstart % MFSCHUNKSIZE) == 0 && rreq->next!=NULL && rreq->next->next==NULL && rbuffsize<maxreadaheadsize) {
-										blockend = blockstart + (readahead_leng * (1<<((ind->readahead-1)*2)));
+										blockend = blockstart + read_ra_window(ind,rbuffsize);
 										sassert(blockend>blockstart);
 										raok = 1;
 										for (rreqn = ind->reqhead ; rreqn && raok ; rreqn=rreqn->next) {
@@ -2444,12 +2975,12 @@ int read_data(void *vid, uint64_t offset, uint32_t *size, void **vrhead,struct i
 #ifdef RDEBUG
 												fprintf(stderr,"%.6lf: read_data: inode: %"PRIu32" (middle of existing block) add new extra read-ahead rreq (%"PRIu64":%"PRIu64"/%"PRId64")\n",monotonic_seconds(),ind->inode,blockstart,blockend,blockend-blockstart);
 #endif
-												read_new_request(ind,&blockstart,blockend);
+												read_new_request(ind,&blockstart,blockend,1);
 											} else if (blockstart<ind->fleng) {
 #ifdef RDEBUG
 												fprintf(stderr,"%.6lf: read_data: inode: %"PRIu32" (middle of existing block) add new extra read-ahead rreq (%"PRIu64":%"PRIu64"/%"PRId64")\n",monotonic_seconds(),ind->inode,blockstart,ind->fleng,ind->fleng-blockstart);
 #endif
-												read_new_request(ind,&blockstart,ind->fleng);
+												read_new_request(ind,&blockstart,ind->fleng,1);
 											}
 										}
 									}
@@ -2463,7 +2994,7 @@ int read_data(void *vid, uint64_t offset, uint32_t *size, void **vrhead,struct i
 				blockstart = etab[i];
 				blockend = etab[i+1];
 				while (blockstart < blockend) {
-					rreq = read_new_request(ind,&blockstart,blockend);
+					rreq = read_new_request(ind,&blockstart,blockend,0);
 					rl = malloc(sizeof(rlist));
 					passert(rl);
 					rl->rreq = rreq;
@@ -2474,7 +3005,7 @@ int read_data(void *vid, uint64_t offset, uint32_t *size, void **vrhead,struct i
 					rtail = &(rl->next);
 					rreq->lcnt++;
 					if (blockstart==blockend && ind->readahead && rbuffsize<maxreadaheadsize && i==edges-2) {
-						blockend = blockstart + (readahead_leng * (1<<((ind->readahead-1)*2)))/2;
+						blockend = blockstart + read_ra_window(ind,rbuffsize)/2;
 						sassert(blockend>blockstart);
 						raok = 1;
 						for (rreqn = ind->reqhead ; rreqn && raok ; rreqn=rreqn->next) {
@@ -2489,12 +3020,12 @@ int read_data(void *vid, uint64_t offset, uint32_t *size, void **vrhead,struct i
 #ifdef RDEBUG
 								fprintf(stderr,"%.6lf: read_data: inode: %"PRIu32" (after new block) add new read-ahead rreq (%"PRIu64":%"PRIu64"/%"PRId64")\n",monotonic_seconds(),ind->inode,blockstart,blockend,blockend-blockstart);
 #endif
-								(void)read_new_request(ind,&blockstart,blockend);
+								(void)read_new_request(ind,&blockstart,blockend,1);
 							} else if (blockstart<ind->fleng) {
 #ifdef RDEBUG
 								fprintf(stderr,"%.6lf: read_data: inode: %"PRIu32" (after new block) add new read-ahead rreq (%"PRIu64":%"PRIu64"/%"PRId64")\n",monotonic_seconds(),ind->inode,blockstart,ind->fleng,ind->fleng-blockstart);
 #endif
-								(void)read_new_request(ind,&blockstart,ind->fleng);
+								(void)read_new_request(ind,&blockstart,ind->fleng,1);
 							}
 						}
 						break;
@@ -2503,6 +3034,10 @@ int read_data(void *vid, uint64_t offset, uint32_t *size, void **vrhead,struct i
 			}
 		}
 
+		if (ind->pattern==RA_PATTERN_STRIDED || ind->pattern==RA_PATTERN_BACKWARD) {
+			read_ra_stride(ind,firstbyte,lastbyte-firstbyte,rbuffsize);
+		}
+
 		*vrhead = rhead;
 
 		cnt = 0;
@@ -2773,7 +3308,15 @@ void* read_data_new(uint32_t inode,uint64_t fleng) {
 	ind->status = 0;
 	ind->inqueue = 0;
 	ind->readahead = 0;
+	ind->pattern = RA_PATTERN_RANDOM;
+	ind->stridecnt = 0;
+	ind->stride = 0;
+	ind->laststart = 0;
 	ind->lastoffset = 0;
+	ind->ratebytes = 0;
+	ind->ratestart = 0.0;
+	ind->consrate = 0.0;
+	ind->rlatency = 0.0;
 //	ind->closewaiting = 0;
 	ind->closing = 0;
 //	ind->mreq_time = 0.0;
@@ -997,6 +997,10 @@
 //	rver==62:	// version 6 / END
 //		( rver:8 ) -
 //	rver==63:	// version 6 / DISCONNECT
+//	rver==64:	// version 6 / CHUNKS (compressed, master 4.60+)
+//		( rver:8 ) N:32 N*[chunkiddelta:varint versionmfr:varint]
+//		entries are sorted by 64-bit chunkid (with ecid in the highest byte), chunkiddelta is the difference from the previous entry (first one from zero),
+//		versionmfr is (version<<1) | (1 when chunk is marked for removal), varints are LEB128 (7 bits per byte, least significant first)
 
 
 // 0x0065
@@ -2304,8 +2308,12 @@
 // N*[ inode:32 pathssize:32 M*[ pathleng:32 path:pathlengB ] ]
 
 // 0x021A
+#define CLTOMA_READERS_INFO (PROTO_BASE+538)
+// -
 
 // 0x021B
+#define MATOCL_READERS_INFO (PROTO_BASE+539)
+// configured:32 running:32 phases:64 phaseusec:64 mainjobs:64 opcnt:8 opcnt*[ type:32 readercnt:64 readerusec:64 readermaxusec:64 serialcnt:64 serialusec:64 ] running*[ jobs:64 busyusec:64 aliveusec:64 ]
 
 // 0x021C
 
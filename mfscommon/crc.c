@@ -24,6 +24,26 @@
 #include <inttypes.h>
 #include <stdlib.h>
 #include "MFSCommunication.h"
+#include "crc.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#  define CRC_HAVE_PCLMUL 1
+#  include <cpuid.h>
+#  include <emmintrin.h>
+#  include <wmmintrin.h>
+#endif
+
+#if defined(__aarch64__) && (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_AES))
+#  define CRC_HAVE_PMULL 1
+#  include <arm_neon.h>
+#  if defined(__linux__)
+#    include <sys/auxv.h>
+#    include <asm/hwcap.h>
+#  endif
+#endif
+
+// below this length the table version is faster than folding (setup + reduction cost)
+#define CRC_FOLD_MINLENG 256
 
 #ifndef CRC_POLY
 #define CRC_POLY 0xEDB88320
@@ -76,7 +96,7 @@ static inline uint32_t swap(uint32_t x) {
 
 // #define CRC_PREFETCH 1
 
-uint32_t mycrc32(uint32_t crc,const void* data,uint32_t leng) {
+static uint32_t crc32_table_calc(uint32_t crc,const void* data,uint32_t leng) {
 	const uint32_t *data4;
 	const uint8_t *data1;
 	uint32_t d0,d1,d2,d3;
@@ -215,7 +235,7 @@ static void crc_generate_combine_tables(void) {
 	}
 }
 
-uint32_t mycrc32_combine(uint32_t crc1, uint32_t crc2, uint32_t leng2) {
+static uint32_t crc32_table_combine(uint32_t crc1, uint32_t crc2, uint32_t leng2) {
 	uint8_t i;
 
 	/* add leng2 zeros to crc1 */
@@ -234,7 +254,394 @@ uint32_t mycrc32_combine(uint32_t crc1, uint32_t crc2, uint32_t leng2) {
 	return crc1^crc2;
 }
 
+/* carry-less multiply versions */
+
+#if defined(CRC_HAVE_PCLMUL) || defined(CRC_HAVE_PMULL)
+
+// folding constants for reflected CRC32 (0xEDB88320) - see Intel paper "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction"
+static const uint64_t crc_fold_k1k2[2] __attribute__((aligned(16))) = {0x0154442bd4ULL,0x01c6e41596ULL}; // x^(4*128+32), x^(4*128-32)
+static const uint64_t crc_fold_k3k4[2] __attribute__((aligned(16))) = {0x01751997d0ULL,0x00ccaa009eULL}; // x^(128+32), x^(128-32)
+static const uint64_t crc_fold_k5k0[2] __attribute__((aligned(16))) = {0x0163cd6124ULL,0x0000000000ULL}; // x^64
+static const uint64_t crc_fold_poly[2] __attribute__((aligned(16))) = {0x01db710641ULL,0x01f7011641ULL}; // P(x)' , mu'
+
+// crc_x8n_table[i][n] = x^(8*n*16^i) mod P(x) - used to multiply crc by x^(8*leng) in combine (one multiplication per non-zero nibble of leng)
+static uint32_t crc_x8n_table[8][16];
+
+static uint32_t crc_multmodp(uint32_t a,uint32_t b) {
+	uint32_t m,p;
+
+	m = UINT32_C(1)<<31;
+	p = 0;
+	for (;;) {
+		if (a & m) {
+			p ^= b;
+			if ((a & (m-1))==0) {
+				break;
+			}
+		}
+		m >>= 1;
+		b = (b&1) ? (b>>1)^CRC_POLY : b>>1;
+	}
+	return p;
+}
+
+static void crc_generate_x8n_table(void) {
+	uint32_t i,n,p;
+
+	p = UINT32_C(1)<<23; // x^8
+	for (i=0 ; i<8 ; i++) {
+		crc_x8n_table[i][0] = UINT32_C(1)<<31; // x^0
+		for (n=1 ; n<16 ; n++) {
+			crc_x8n_table[i][n] = crc_multmodp(crc_x8n_table[i][n-1],p);
+		}
+		p = crc_multmodp(crc_x8n_table[i][15],p); // x^(8*16^(i+1))
+	}
+}
+
+#endif
+
+#ifdef CRC_HAVE_PCLMUL
+
+/* buff must have at least 64 bytes, leng must be multiple of 16, crc is not negated here */
+static __attribute__((target("sse2,pclmul"))) uint32_t crc32_pclmul_fold(uint32_t crc,const uint8_t *buff,uint32_t leng) {
+	__m128i x0,x1,x2,x3,x4,x5,x6,x7,x8,y5,y6,y7,y8;
+
+	x1 = _mm_loadu_si128((const __m128i*)(buff+0x00));
+	x2 = _mm_loadu_si128((const __m128i*)(buff+0x10));
+	x3 = _mm_loadu_si128((const __m128i*)(buff+0x20));
+	x4 = _mm_loadu_si128((const __m128i*)(buff+0x30));
+	x1 = _mm_xor_si128(x1,_mm_cvtsi32_si128(crc));
+	x0 = _mm_load_si128((const __m128i*)crc_fold_k1k2);
+	buff += 64;
+	leng -= 64;
+
+	/* fold by 4 (512 bits at once) */
+	while (leng >= 64) {
+		x5 = _mm_clmulepi64_si128(x1,x0,0x00);
+		x6 = _mm_clmulepi64_si128(x2,x0,0x00);
+		x7 = _mm_clmulepi64_si128(x3,x0,0x00);
+		x8 = _mm_clmulepi64_si128(x4,x0,0x00);
+		x1 = _mm_clmulepi64_si128(x1,x0,0x11);
+		x2 = _mm_clmulepi64_si128(x2,x0,0x11);
+		x3 = _mm_clmulepi64_si128(x3,x0,0x11);
+		x4 = _mm_clmulepi64_si128(x4,x0,0x11);
+		y5 = _mm_loadu_si128((const __m128i*)(buff+0x00));
+		y6 = _mm_loadu_si128((const __m128i*)(buff+0x10));
+		y7 = _mm_loadu_si128((const __m128i*)(buff+0x20));
+		y8 = _mm_loadu_si128((const __m128i*)(buff+0x30));
+		x1 = _mm_xor_si128(_mm_xor_si128(x1,x5),y5);
+		x2 = _mm_xor_si128(_mm_xor_si128(x2,x6),y6);
+		x3 = _mm_xor_si128(_mm_xor_si128(x3,x7),y7);
+		x4 = _mm_xor_si128(_mm_xor_si128(x4,x8),y8);
+		buff += 64;
+		leng -= 64;
+	}
+
+	/* fold 512 bits into 128 */
+	x0 = _mm_load_si128((const __m128i*)crc_fold_k3k4);
+	x5 = _mm_clmulepi64_si128(x1,x0,0x00);
+	x1 = _mm_clmulepi64_si128(x1,x0,0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1,x2),x5);
+	x5 = _mm_clmulepi64_si128(x1,x0,0x00);
+	x1 = _mm_clmulepi64_si128(x1,x0,0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1,x3),x5);
+	x5 = _mm_clmulepi64_si128(x1,x0,0x00);
+	x1 = _mm_clmulepi64_si128(x1,x0,0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1,x4),x5);
+
+	/* remaining 16-byte blocks */
+	while (leng >= 16) {
+		x2 = _mm_loadu_si128((const __m128i*)buff);
+		x5 = _mm_clmulepi64_si128(x1,x0,0x00);
+		x1 = _mm_clmulepi64_si128(x1,x0,0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1,x2),x5);
+		buff += 16;
+		leng -= 16;
+	}
+
+	/* fold 128 bits into 64 */
+	x2 = _mm_clmulepi64_si128(x1,x0,0x10);
+	x3 = _mm_setr_epi32(~0,0,~0,0);
+	x1 = _mm_srli_si128(x1,8);
+	x1 = _mm_xor_si128(x1,x2);
+	x0 = _mm_loadl_epi64((const __m128i*)crc_fold_k5k0);
+	x2 = _mm_srli_si128(x1,4);
+	x1 = _mm_and_si128(x1,x3);
+	x1 = _mm_clmulepi64_si128(x1,x0,0x00);
+	x1 = _mm_xor_si128(x1,x2);
+
+	/* Barrett reduction to 32 bits */
+	x0 = _mm_load_si128((const __m128i*)crc_fold_poly);
+	x2 = _mm_and_si128(x1,x3);
+	x2 = _mm_clmulepi64_si128(x2,x0,0x10);
+	x2 = _mm_and_si128(x2,x3);
+	x2 = _mm_clmulepi64_si128(x2,x0,0x00);
+	x1 = _mm_xor_si128(x1,x2);
+
+	return _mm_cvtsi128_si32(_mm_srli_si128(x1,4));
+}
+
+/* a*b mod P(x) in reflected domain */
+static __attribute__((target("sse2,pclmul"))) uint32_t crc32_pclmul_multmodp(uint32_t a,uint32_t b) {
+	__m128i x0,x1,x2,x3;
+
+	x1 = _mm_clmulepi64_si128(_mm_cvtsi32_si128(a),_mm_cvtsi32_si128(b),0x00);
+	x1 = _mm_slli_epi64(x1,1);
+	x3 = _mm_setr_epi32(~0,0,~0,0);
+	x0 = _mm_load_si128((const __m128i*)crc_fold_poly);
+	x2 = _mm_and_si128(x1,x3);
+	x2 = _mm_clmulepi64_si128(x2,x0,0x10);
+	x2 = _mm_and_si128(x2,x3);
+	x2 = _mm_clmulepi64_si128(x2,x0,0x00);
+	x1 = _mm_xor_si128(x1,x2);
+
+	return _mm_cvtsi128_si32(_mm_srli_si128(x1,4));
+}
+
+static uint32_t crc32_pclmul_calc(uint32_t crc,const void* data,uint32_t leng) {
+	uint32_t bulk;
+
+	if (leng < CRC_FOLD_MINLENG) {
+		return crc32_table_calc(crc,data,leng);
+	}
+	bulk = leng & ~UINT32_C(15);
+	crc = ~crc32_pclmul_fold(~crc,(const uint8_t*)data,bulk);
+	if (bulk < leng) {
+		crc = crc32_table_calc(crc,((const uint8_t*)data)+bulk,leng-bulk);
+	}
+	return crc;
+}
+
+static uint32_t crc32_pclmul_combine(uint32_t crc1, uint32_t crc2, uint32_t leng2) {
+	uint32_t i;
+
+	/* multiply crc1 by x^(8*leng2) - nibble by nibble */
+	for (i=0 ; leng2 ; leng2>>=4,i++) {
+		if (leng2&0xF) {
+			crc1 = crc32_pclmul_multmodp(crc1,crc_x8n_table[i][leng2&0xF]);
+		}
+	}
+	return crc1^crc2;
+}
+
+static uint8_t crc32_pclmul_supported(void) {
+	unsigned int eax,ebx,ecx,edx;
+
+	if (__get_cpuid(1,&eax,&ebx,&ecx,&edx)==0) {
+		return 0;
+	}
+	return ((ecx & bit_PCLMUL) && (edx & bit_SSE2))?1:0;
+}
+
+#endif
+
+#ifdef CRC_HAVE_PMULL
+
+static inline uint64x2_t crc_pmull_lo(uint64x2_t a,uint64x2_t b) {
+	return vreinterpretq_u64_p128(vmull_p64((poly64_t)vgetq_lane_u64(a,0),(poly64_t)vgetq_lane_u64(b,0)));
+}
+
+static inline uint64x2_t crc_pmull_hi(uint64x2_t a,uint64x2_t b) {
+	return vreinterpretq_u64_p128(vmull_p64((poly64_t)vgetq_lane_u64(a,1),(poly64_t)vgetq_lane_u64(b,1)));
+}
+
+static inline uint64x2_t crc_pmull_lohi(uint64x2_t a,uint64x2_t b) {
+	return vreinterpretq_u64_p128(vmull_p64((poly64_t)vgetq_lane_u64(a,0),(poly64_t)vgetq_lane_u64(b,1)));
+}
+
+/* the same algorithm as crc32_pclmul_fold - see comments there */
+static uint32_t crc32_pmull_fold(uint32_t crc,const uint8_t *buff,uint32_t leng) {
+	uint64x2_t x0,x1,x2,x3,x4,x5,x6,x7,x8,y5,y6,y7,y8;
+
+	x1 = vld1q_u64((const uint64_t*)(buff+0x00));
+	x2 = vld1q_u64((const uint64_t*)(buff+0x10));
+	x3 = vld1q_u64((const uint64_t*)(buff+0x20));
+	x4 = vld1q_u64((const uint64_t*)(buff+0x30));
+	x1 = veorq_u64(x1,vcombine_u64(vcreate_u64(crc),vcreate_u64(0)));
+	x0 = vld1q_u64(crc_fold_k1k2);
+	buff += 64;
+	leng -= 64;
+
+	while (leng >= 64) {
+		x5 = crc_pmull_lo(x1,x0);
+		x6 = crc_pmull_lo(x2,x0);
+		x7 = crc_pmull_lo(x3,x0);
+		x8 = crc_pmull_lo(x4,x0);
+		x1 = crc_pmull_hi(x1,x0);
+		x2 = crc_pmull_hi(x2,x0);
+		x3 = crc_pmull_hi(x3,x0);
+		x4 = crc_pmull_hi(x4,x0);
+		y5 = vld1q_u64((const uint64_t*)(buff+0x00));
+		y6 = vld1q_u64((const uint64_t*)(buff+0x10));
+		y7 = vld1q_u64((const uint64_t*)(buff+0x20));
+		y8 = vld1q_u64((const uint64_t*)(buff+0x30));
+		x1 = veorq_u64(veorq_u64(x1,x5),y5);
+		x2 = veorq_u64(veorq_u64(x2,x6),y6);
+		x3 = veorq_u64(veorq_u64(x3,x7),y7);
+		x4 = veorq_u64(veorq_u64(x4,x8),y8);
+		buff += 64;
+		leng -= 64;
+	}
+
+	x0 = vld1q_u64(crc_fold_k3k4);
+	x5 = crc_pmull_lo(x1,x0);
+	x1 = crc_pmull_hi(x1,x0);
+	x1 = veorq_u64(veorq_u64(x1,x2),x5);
+	x5 = crc_pmull_lo(x1,x0);
+	x1 = crc_pmull_hi(x1,x0);
+	x1 = veorq_u64(veorq_u64(x1,x3),x5);
+	x5 = crc_pmull_lo(x1,x0);
+	x1 = crc_pmull_hi(x1,x0);
+	x1 = veorq_u64(veorq_u64(x1,x4),x5);
+
+	while (leng >= 16) {
+		x2 = vld1q_u64((const uint64_t*)buff);
+		x5 = crc_pmull_lo(x1,x0);
+		x1 = crc_pmull_hi(x1,x0);
+		x1 = veorq_u64(veorq_u64(x1,x2),x5);
+		buff += 16;
+		leng -= 16;
+	}
+
+	x2 = crc_pmull_lohi(x1,x0);
+	x3 = vreinterpretq_u64_u32(vcombine_u32(vcreate_u32(UINT64_C(0xFFFFFFFF)),vcreate_u32(UINT64_C(0xFFFFFFFF))));
+	x1 = vreinterpretq_u64_u8(vextq_u8(vreinterpretq_u8_u64(x1),vdupq_n_u8(0),8));
+	x1 = veorq_u64(x1,x2);
+	x0 = vcombine_u64(vcreate_u64(crc_fold_k5k0[0]),vcreate_u64(0));
+	x2 = vreinterpretq_u64_u8(vextq_u8(vreinterpretq_u8_u64(x1),vdupq_n_u8(0),4));
+	x1 = vandq_u64(x1,x3);
+	x1 = crc_pmull_lo(x1,x0);
+	x1 = veorq_u64(x1,x2);
+
+	x0 = vld1q_u64(crc_fold_poly);
+	x2 = vandq_u64(x1,x3);
+	x2 = crc_pmull_lohi(x2,x0);
+	x2 = vandq_u64(x2,x3);
+	x2 = crc_pmull_lo(x2,x0);
+	x1 = veorq_u64(x1,x2);
+
+	return vgetq_lane_u32(vreinterpretq_u32_u64(x1),1);
+}
+
+static uint32_t crc32_pmull_multmodp(uint32_t a,uint32_t b) {
+	uint64_t p,t;
+
+	p = (uint64_t)vmull_p64((poly64_t)a,(poly64_t)b) << 1;
+	t = (uint64_t)vmull_p64((poly64_t)(p & 0xFFFFFFFF),(poly64_t)crc_fold_poly[1]) & 0xFFFFFFFF;
+	t = (uint64_t)vmull_p64((poly64_t)t,(poly64_t)crc_fold_poly[0]);
+	return (p^t)>>32;
+}
+
+static uint32_t crc32_pmull_calc(uint32_t crc,const void* data,uint32_t leng) {
+	uint32_t bulk;
+
+	if (leng < CRC_FOLD_MINLENG) {
+		return crc32_table_calc(crc,data,leng);
+	}
+	bulk = leng & ~UINT32_C(15);
+	crc = ~crc32_pmull_fold(~crc,(const uint8_t*)data,bulk);
+	if (bulk < leng) {
+		crc = crc32_table_calc(crc,((const uint8_t*)data)+bulk,leng-bulk);
+	}
+	return crc;
+}
+
+static uint32_t crc32_pmull_combine(uint32_t crc1, uint32_t crc2, uint32_t leng2) {
+	uint32_t i;
+
+	/* multiply crc1 by x^(8*leng2) - nibble by nibble */
+	for (i=0 ; leng2 ; leng2>>=4,i++) {
+		if (leng2&0xF) {
+			crc1 = crc32_pmull_multmodp(crc1,crc_x8n_table[i][leng2&0xF]);
+		}
+	}
+	return crc1^crc2;
+}
+
+static uint8_t crc32_pmull_supported(void) {
+#if defined(__linux__) && defined(HWCAP_PMULL)
+	return (getauxval(AT_HWCAP) & HWCAP_PMULL)?1:0;
+#else
+	return 1; // compiled with crypto extensions enabled, so assume that CPU has them
+#endif
+}
+
+#endif
+
+/* engine dispatch */
+
+typedef struct _crc_engine {
+	const char *name;
+	uint32_t (*calc)(uint32_t crc,const void* data,uint32_t leng);
+	uint32_t (*combine)(uint32_t crc1, uint32_t crc2, uint32_t leng2);
+	uint8_t (*supported)(void);
+} crc_engine;
+
+static const crc_engine crc_engines[CRC_ENGINES] = {
+	{"table",crc32_table_calc,crc32_table_combine,NULL},
+#ifdef CRC_HAVE_PCLMUL
+	{"pclmul",crc32_pclmul_calc,crc32_pclmul_combine,crc32_pclmul_supported},
+#else
+	{"pclmul",NULL,NULL,NULL},
+#endif
+#ifdef CRC_HAVE_PMULL
+	{"pmull",crc32_pmull_calc,crc32_pmull_combine,crc32_pmull_supported},
+#else
+	{"pmull",NULL,NULL,NULL},
+#endif
+};
+
+static uint8_t crc_current_engine = CRC_ENGINE_TABLE;
+
+uint8_t mycrc32_engine_supported(uint8_t engine) {
+	if (engine>=CRC_ENGINES || crc_engines[engine].calc==NULL) {
+		return 0;
+	}
+	if (crc_engines[engine].supported==NULL) {
+		return 1;
+	}
+	return crc_engines[engine].supported();
+}
+
+uint8_t mycrc32_engine_select(uint8_t engine) {
+	if (mycrc32_engine_supported(engine)==0) {
+		return 0;
+	}
+	crc_current_engine = engine;
+	return 1;
+}
+
+uint8_t mycrc32_engine_current(void) {
+	return crc_current_engine;
+}
+
+const char* mycrc32_engine_name(uint8_t engine) {
+	if (engine>=CRC_ENGINES) {
+		return "unknown";
+	}
+	return crc_engines[engine].name;
+}
+
+uint32_t mycrc32(uint32_t crc,const void* data,uint32_t leng) {
+	return crc_engines[crc_current_engine].calc(crc,data,leng);
+}
+
+uint32_t mycrc32_combine(uint32_t crc1, uint32_t crc2, uint32_t leng2) {
+	return crc_engines[crc_current_engine].combine(crc1,crc2,leng2);
+}
+
 void mycrc32_init(void) {
+	uint8_t engine;
+
 	crc_generate_main_tables();
 	crc_generate_combine_tables();
+#if defined(CRC_HAVE_PCLMUL) || defined(CRC_HAVE_PMULL)
+	crc_generate_x8n_table();
+#endif
+	crc_current_engine = CRC_ENGINE_TABLE;
+	for (engine=CRC_ENGINE_TABLE+1 ; engine<CRC_ENGINES ; engine++) {
+		if (mycrc32_engine_supported(engine)) {
+			crc_current_engine = engine;
+		}
+	}
 }
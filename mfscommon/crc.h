@@ -21,12 +21,22 @@
 #define _CRC_H_
 #include <inttypes.h>
 
+#define CRC_ENGINE_TABLE 0
+#define CRC_ENGINE_PCLMUL 1
+#define CRC_ENGINE_PMULL 2
+#define CRC_ENGINES 3
+
 uint32_t mycrc32(uint32_t crc,const void *block,uint32_t leng);
 uint32_t mycrc32_combine(uint32_t crc1, uint32_t crc2, uint32_t leng2);
 #define mycrc32_zeroblock(crc,zeros) mycrc32_combine((crc)^0xFFFFFFFF,0xFFFFFFFF,(zeros))
 #define mycrc32_zeroexpanded(crc,block,leng,zeros) mycrc32_zeroblock(mycrc32((crc),(block),(leng)),(zeros))
 #define mycrc32_xorblocks(crc,crcblock1,crcblock2,leng) ((crcblock1)^(crcblock2)^mycrc32_zeroblock(crc,leng))
 
+uint8_t mycrc32_engine_supported(uint8_t engine);
+uint8_t mycrc32_engine_select(uint8_t engine);
+uint8_t mycrc32_engine_current(void);
+const char* mycrc32_engine_name(uint8_t engine);
+
 void mycrc32_init(void);
 
 #endif
@@ -296,4 +296,100 @@ static inline uint8_t get8bit(const uint8_t **ptr) {
 	return t8;
 }
 
+/* LEB128-style varints (7 bits per byte, least significant group first) */
+
+static inline uint8_t varintsize(uint64_t val) {
+	uint8_t s;
+	s = 1;
+	while (val>=0x80) {
+		val >>= 7;
+		s++;
+	}
+	return s;
+}
+
+static inline void putvarint(uint8_t **ptr,uint64_t val) {
+	while (val>=0x80) {
+		*(*ptr)++ = (val&0x7F)|0x80;
+		val >>= 7;
+	}
+	*(*ptr)++ = val;
+}
+
+/* returns 0 on success and -1 when the varint doesn't fit before 'end' or is longer than 64 bits */
+static inline int getvarint(const uint8_t **ptr,const uint8_t *end,uint64_t *val) {
+	const uint8_t *p;
+	uint64_t v;
+	uint8_t s;
+
+	p = *ptr;
+	v = 0;
+	s = 0;
+	while (p<end) {
+		if (s>63) {
+			return -1;
+		}
+		v |= (uint64_t)((*p)&0x7F) << s;
+		if (((*p++)&0x80)==0) {
+			*ptr = p;
+			*val = v;
+			return 0;
+		}
+		s += 7;
+	}
+	return -1;
+}
+
+/* compressed chunk lists (CSTOMA_REGISTER rver 64): chunkids have to be sorted, they are stored as deltas ; versions as (version<<1)|mfr, where mfr is the highest bit of the version */
+
+static inline uint64_t chunklistvmfr(uint32_t version) {
+	return ((uint64_t)(version&0x7FFFFFFF)<<1) | (version>>31);
+}
+
+static inline uint32_t chunklistsize(const uint64_t *chunkids,const uint32_t *versions,uint32_t cnt) {
+	uint64_t prevchunkid;
+	uint32_t i,leng;
+
+	leng = 0;
+	prevchunkid = 0;
+	for (i=0 ; i<cnt ; i++) {
+		leng += varintsize(chunkids[i]-prevchunkid);
+		leng += varintsize(chunklistvmfr(versions[i]));
+		prevchunkid = chunkids[i];
+	}
+	return leng;
+}
+
+static inline void putchunklist(uint8_t **ptr,const uint64_t *chunkids,const uint32_t *versions,uint32_t cnt) {
+	uint64_t prevchunkid;
+	uint32_t i;
+
+	prevchunkid = 0;
+	for (i=0 ; i<cnt ; i++) {
+		putvarint(ptr,chunkids[i]-prevchunkid);
+		putvarint(ptr,chunklistvmfr(versions[i]));
+		prevchunkid = chunkids[i];
+	}
+}
+
+/* returns 0 on success and -1 when list is malformed (too short or wrong version) */
+static inline int getchunklist(const uint8_t **ptr,const uint8_t *end,uint64_t *chunkids,uint32_t *versions,uint32_t cnt) {
+	uint64_t chunkid,v;
+	uint32_t i;
+
+	chunkid = 0;
+	for (i=0 ; i<cnt ; i++) {
+		if (getvarint(ptr,end,&v)<0) {
+			return -1;
+		}
+		chunkid += v;
+		if (getvarint(ptr,end,&v)<0 || v>UINT64_C(0xFFFFFFFF)) {
+			return -1;
+		}
+		chunkids[i] = chunkid;
+		versions[i] = (v>>1) | ((v&1)?0x80000000:0);
+	}
+	return 0;
+}
+
 #endif
@@ -96,6 +96,10 @@ void dict_printall(void) {
 	dict_hash_print();
 }
 
+uint8_t dict_stable(void) {
+	return dict_hash_stable();
+}
+
 void* dict_search(const uint8_t *data,uint32_t leng) {
 	return dict_find(data,leng);
 }
@@ -0,0 +1,512 @@
+/*
+ * Copyright (C) 2026 Jakub Kruszona-Zawadzki, Saglabs SA
+ * 
+ * This file is part of MooseFS.
+ * 
+ * MooseFS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 (only).
+ * 
+ * MooseFS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <inttypes.h>
+#include <string.h>
+#include "crc.h"
+#include "xordata.h"
+#include "ecrs.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#  define ECRS_HAVE_X86 1
+#  include <cpuid.h>
+#  include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#  define ECRS_HAVE_NEON 1
+#  include <arm_neon.h>
+#endif
+
+// max number of sources in one dotprod call (tables are kept on stack)
+#define ECRS_MAX_SOURCES (ECRS_MAX_PARTS+1)
+// piece of data calculated and then checksummed in ecrs_dotprod_crc
+#define ECRS_CRC_TILE 16384
+
+// x^8 + x^4 + x^3 + x^2 + 1
+#define ECRS_POLY 0x11D
+
+static uint8_t gf_exp[512];
+static uint8_t gf_log[256];
+// for each multiplier: products of low nibbles (0..15) followed by products of high nibbles (0x00,0x10..0xF0)
+static uint8_t gf_nibtab[256][32];
+
+uint8_t ecrs_gfmul(uint8_t a,uint8_t b) {
+	if (a==0 || b==0) {
+		return 0;
+	}
+	return gf_exp[gf_log[a]+gf_log[b]];
+}
+
+uint8_t ecrs_gfinv(uint8_t a) {
+	if (a==0) {
+		return 0;
+	}
+	return gf_exp[255-gf_log[a]];
+}
+
+static void ecrs_generate_tables(void) {
+	uint32_t i,x;
+
+	x = 1;
+	for (i=0 ; i<255 ; i++) {
+		gf_exp[i] = x;
+		gf_log[x] = i;
+		x <<= 1;
+		if (x & 0x100) {
+			x ^= ECRS_POLY;
+		}
+	}
+	for (i=255 ; i<512 ; i++) {
+		gf_exp[i] = gf_exp[i-255];
+	}
+	gf_log[0] = 0;
+	for (x=0 ; x<256 ; x++) {
+		for (i=0 ; i<16 ; i++) {
+			gf_nibtab[x][i] = ecrs_gfmul(x,i);
+			gf_nibtab[x][16+i] = ecrs_gfmul(x,i<<4);
+		}
+	}
+}
+
+/* generator matrix */
+
+// Cauchy matrix 1/(x[j]+y[i]) with x[j]=dataparts+j and y[i]=i, columns scaled to have first row filled with ones,
+// so every square submatrix is still nonsingular (any 'dataparts' parts are enough to restore data)
+static inline uint8_t ecrs_gen(uint8_t dataparts,uint8_t chksumpart,uint8_t datapart) {
+	return ecrs_gfmul(dataparts^datapart,ecrs_gfinv((dataparts+chksumpart)^datapart));
+}
+
+int ecrs_chksum_coefs(uint8_t dataparts,uint8_t chksumpart,uint8_t *coefs) {
+	uint8_t i;
+
+	if (dataparts==0 || dataparts>ECRS_MAX_DATA_PARTS || chksumpart>=ECRS_MAX_CHKSUM_PARTS) {
+		return -1;
+	}
+	for (i=0 ; i<dataparts ; i++) {
+		coefs[i] = ecrs_gen(dataparts,chksumpart,i);
+	}
+	return 0;
+}
+
+static inline void ecrs_gen_row(uint8_t dataparts,uint8_t part,uint8_t *row) {
+	uint8_t i;
+
+	if (part<dataparts) {
+		for (i=0 ; i<dataparts ; i++) {
+			row[i] = (i==part)?1:0;
+		}
+	} else {
+		for (i=0 ; i<dataparts ; i++) {
+			row[i] = ecrs_gen(dataparts,part-dataparts,i);
+		}
+	}
+}
+
+int ecrs_recover_coefs(uint8_t dataparts,const uint8_t *survivors,uint8_t dstpart,uint8_t *coefs) {
+	uint8_t m[ECRS_MAX_DATA_PARTS][ECRS_MAX_DATA_PARTS];
+	uint8_t inv[ECRS_MAX_DATA_PARTS][ECRS_MAX_DATA_PARTS];
+	uint8_t row[ECRS_MAX_DATA_PARTS];
+	uint8_t i,j,k,p,f;
+	uint32_t usedmask;
+
+	if (dataparts==0 || dataparts>ECRS_MAX_DATA_PARTS || dstpart>=dataparts+ECRS_MAX_CHKSUM_PARTS) {
+		return -1;
+	}
+	usedmask = 0;
+	for (i=0 ; i<dataparts ; i++) {
+		if (survivors[i]>=dataparts+ECRS_MAX_CHKSUM_PARTS || (usedmask & (UINT32_C(1)<<survivors[i]))) {
+			return -1;
+		}
+		usedmask |= UINT32_C(1)<<survivors[i];
+	}
+	for (i=0 ; i<dataparts ; i++) {
+		if (survivors[i]==dstpart) {
+			for (j=0 ; j<dataparts ; j++) {
+				coefs[j] = (i==j)?1:0;
+			}
+			return 0;
+		}
+	}
+	// invert generator rows of survivors (Gauss-Jordan)
+	for (i=0 ; i<dataparts ; i++) {
+		ecrs_gen_row(dataparts,survivors[i],m[i]);
+		for (j=0 ; j<dataparts ; j++) {
+			inv[i][j] = (i==j)?1:0;
+		}
+	}
+	for (k=0 ; k<dataparts ; k++) {
+		for (p=k ; p<dataparts && m[p][k]==0 ; p++) {}
+		if (p==dataparts) {
+			return -1;
+		}
+		if (p!=k) {
+			for (j=0 ; j<dataparts ; j++) {
+				f = m[p][j]; m[p][j] = m[k][j]; m[k][j] = f;
+				f = inv[p][j]; inv[p][j] = inv[k][j]; inv[k][j] = f;
+			}
+		}
+		f = ecrs_gfinv(m[k][k]);
+		for (j=0 ; j<dataparts ; j++) {
+			m[k][j] = ecrs_gfmul(m[k][j],f);
+			inv[k][j] = ecrs_gfmul(inv[k][j],f);
+		}
+		for (i=0 ; i<dataparts ; i++) {
+			if (i!=k && m[i][k]!=0) {
+				f = m[i][k];
+				for (j=0 ; j<dataparts ; j++) {
+					m[i][j] ^= ecrs_gfmul(m[k][j],f);
+					inv[i][j] ^= ecrs_gfmul(inv[k][j],f);
+				}
+			}
+		}
+	}
+	// data = inv * survivors, so dstpart = row(dstpart) * inv * survivors
+	ecrs_gen_row(dataparts,dstpart,row);
+	for (j=0 ; j<dataparts ; j++) {
+		f = 0;
+		for (i=0 ; i<dataparts ; i++) {
+			f ^= ecrs_gfmul(row[i],inv[i][j]);
+		}
+		coefs[j] = f;
+	}
+	return 0;
+}
+
+/* generic version */
+
+static void ecrs_dotprod_generic(uint8_t *dst,const uint8_t * const *src,const uint8_t *coefs,uint8_t cnt,uint32_t leng) {
+	const uint8_t *s,*t;
+	uint8_t i,init;
+	uint32_t pos;
+
+	init = 0;
+	for (i=0 ; i<cnt ; i++) {
+		s = src[i];
+		t = gf_nibtab[coefs[i]];
+		if (coefs[i]==0) {
+			continue;
+		} else if (coefs[i]==1) {
+			if (init) {
+				for (pos=0 ; pos<leng ; pos++) {
+					dst[pos] ^= s[pos];
+				}
+			} else if (dst!=s) {
+				memcpy(dst,s,leng);
+			}
+		} else {
+			if (init) {
+				for (pos=0 ; pos<leng ; pos++) {
+					dst[pos] ^= t[s[pos]&0xF] ^ t[16+(s[pos]>>4)];
+				}
+			} else {
+				for (pos=0 ; pos<leng ; pos++) {
+					dst[pos] = t[s[pos]&0xF] ^ t[16+(s[pos]>>4)];
+				}
+			}
+		}
+		init = 1;
+	}
+	if (init==0) {
+		memset(dst,0,leng);
+	}
+}
+
+static inline void ecrs_dotprod_tail(uint8_t *dst,const uint8_t * const *src,const uint8_t *coefs,uint8_t cnt,uint32_t pos,uint32_t leng) {
+	const uint8_t *tsrc[ECRS_MAX_SOURCES];
+	uint8_t i;
+
+	if (pos<leng) {
+		for (i=0 ; i<cnt ; i++) {
+			tsrc[i] = src[i]+pos;
+		}
+		ecrs_dotprod_generic(dst+pos,tsrc,coefs,cnt,leng-pos);
+	}
+}
+
+#ifdef ECRS_HAVE_X86
+
+/* x86 - split multiplication into two 16-entry table lookups (pshufb) */
+
+static __attribute__((target("ssse3"))) void ecrs_dotprod_ssse3(uint8_t *dst,const uint8_t * const *src,const uint8_t *coefs,uint8_t cnt,uint32_t leng) {
+	__m128i tlo[ECRS_MAX_SOURCES],thi[ECRS_MAX_SOURCES];
+	__m128i mask,v,acc;
+	uint32_t pos;
+	uint8_t i;
+
+	for (i=0 ; i<cnt ; i++) {
+		tlo[i] = _mm_loadu_si128((const __m128i*)(gf_nibtab[coefs[i]]));
+		thi[i] = _mm_loadu_si128((const __m128i*)(gf_nibtab[coefs[i]]+16));
+	}
+	mask = _mm_set1_epi8(0x0F);
+	for (pos=0 ; pos+16<=leng ; pos+=16) {
+		acc = _mm_setzero_si128();
+		for (i=0 ; i<cnt ; i++) {
+			v = _mm_loadu_si128((const __m128i*)(src[i]+pos));
+			acc = _mm_xor_si128(acc,_mm_shuffle_epi8(tlo[i],_mm_and_si128(v,mask)));
+			acc = _mm_xor_si128(acc,_mm_shuffle_epi8(thi[i],_mm_and_si128(_mm_srli_epi64(v,4),mask)));
+		}
+		_mm_storeu_si128((__m128i*)(dst+pos),acc);
+	}
+	ecrs_dotprod_tail(dst,src,coefs,cnt,pos,leng);
+}
+
+static uint8_t ecrs_ssse3_supported(void) {
+	unsigned int eax,ebx,ecx,edx;
+
+	if (__get_cpuid(1,&eax,&ebx,&ecx,&edx)==0) {
+		return 0;
+	}
+	return (ecx & bit_SSSE3)?1:0;
+}
+
+static __attribute__((target("avx2"))) void ecrs_dotprod_avx2(uint8_t *dst,const uint8_t * const *src,const uint8_t *coefs,uint8_t cnt,uint32_t leng) {
+	__m256i tlo[ECRS_MAX_SOURCES],thi[ECRS_MAX_SOURCES];
+	__m256i mask,v0,v1,acc0,acc1;
+	uint32_t pos;
+	uint8_t i;
+
+	for (i=0 ; i<cnt ; i++) {
+		tlo[i] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)(gf_nibtab[coefs[i]])));
+		thi[i] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)(gf_nibtab[coefs[i]]+16)));
+	}
+	mask = _mm256_set1_epi8(0x0F);
+	for (pos=0 ; pos+64<=leng ; pos+=64) {
+		acc0 = _mm256_setzero_si256();
+		acc1 = _mm256_setzero_si256();
+		for (i=0 ; i<cnt ; i++) {
+			v0 = _mm256_loadu_si256((const __m256i*)(src[i]+pos));
+			v1 = _mm256_loadu_si256((const __m256i*)(src[i]+pos+32));
+			acc0 = _mm256_xor_si256(acc0,_mm256_shuffle_epi8(tlo[i],_mm256_and_si256(v0,mask)));
+			acc1 = _mm256_xor_si256(acc1,_mm256_shuffle_epi8(tlo[i],_mm256_and_si256(v1,mask)));
+			acc0 = _mm256_xor_si256(acc0,_mm256_shuffle_epi8(thi[i],_mm256_and_si256(_mm256_srli_epi64(v0,4),mask)));
+			acc1 = _mm256_xor_si256(acc1,_mm256_shuffle_epi8(thi[i],_mm256_and_si256(_mm256_srli_epi64(v1,4),mask)));
+		}
+		_mm256_storeu_si256((__m256i*)(dst+pos),acc0);
+		_mm256_storeu_si256((__m256i*)(dst+pos+32),acc1);
+	}
+	ecrs_dotprod_tail(dst,src,coefs,cnt,pos,leng);
+}
+
+static uint8_t ecrs_avx2_supported(void) {
+	unsigned int eax,ebx,ecx,edx;
+	unsigned int xcr0lo,xcr0hi;
+
+	if (__get_cpuid(1,&eax,&ebx,&ecx,&edx)==0) {
+		return 0;
+	}
+	if ((ecx & bit_OSXSAVE)==0 || (ecx & bit_AVX)==0) {
+		return 0;
+	}
+	__asm__ __volatile__ ("xgetbv" : "=a"(xcr0lo), "=d"(xcr0hi) : "c"(0));
+	if ((xcr0lo & 6)!=6) { // OS doesn't save YMM registers
+		return 0;
+	}
+	if (__get_cpuid_max(0,NULL)<7) {
+		return 0;
+	}
+	__cpuid_count(7,0,eax,ebx,ecx,edx);
+	return (ebx & bit_AVX2)?1:0;
+}
+
+#endif
+
+#ifdef ECRS_HAVE_NEON
+
+static void ecrs_dotprod_neon(uint8_t *dst,const uint8_t * const *src,const uint8_t *coefs,uint8_t cnt,uint32_t leng) {
+	uint8x16_t tlo[ECRS_MAX_SOURCES],thi[ECRS_MAX_SOURCES];
+	uint8x16_t mask,v,acc;
+	uint32_t pos;
+	uint8_t i;
+
+	for (i=0 ; i<cnt ; i++) {
+		tlo[i] = vld1q_u8(gf_nibtab[coefs[i]]);
+		thi[i] = vld1q_u8(gf_nibtab[coefs[i]]+16);
+	}
+	mask = vdupq_n_u8(0x0F);
+	for (pos=0 ; pos+16<=leng ; pos+=16) {
+		acc = vdupq_n_u8(0);
+		for (i=0 ; i<cnt ; i++) {
+			v = vld1q_u8(src[i]+pos);
+			acc = veorq_u8(acc,vqtbl1q_u8(tlo[i],vandq_u8(v,mask)));
+			acc = veorq_u8(acc,vqtbl1q_u8(thi[i],vshrq_n_u8(v,4)));
+		}
+		vst1q_u8(dst+pos,acc);
+	}
+	ecrs_dotprod_tail(dst,src,coefs,cnt,pos,leng);
+}
+
+#endif
+
+/* engine dispatch */
+
+typedef struct _ecrs_engine {
+	const char *name;
+	void (*dotprod)(uint8_t *dst,const uint8_t * const *src,const uint8_t *coefs,uint8_t cnt,uint32_t leng);
+	uint8_t (*supported)(void);
+} ecrs_engine;
+
+static const ecrs_engine ecrs_engines[ECRS_ENGINES] = {
+	{"generic",ecrs_dotprod_generic,NULL},
+#ifdef ECRS_HAVE_X86
+	{"ssse3",ecrs_dotprod_ssse3,ecrs_ssse3_supported},
+	{"avx2",ecrs_dotprod_avx2,ecrs_avx2_supported},
+#else
+	{"ssse3",NULL,NULL},
+	{"avx2",NULL,NULL},
+#endif
+#ifdef ECRS_HAVE_NEON
+	{"neon",ecrs_dotprod_neon,NULL},
+#else
+	{"neon",NULL,NULL},
+#endif
+};
+
+static uint8_t ecrs_current_engine = ECRS_ENGINE_GENERIC;
+
+uint8_t ecrs_engine_supported(uint8_t engine) {
+	if (engine>=ECRS_ENGINES || ecrs_engines[engine].dotprod==NULL) {
+		return 0;
+	}
+	if (ecrs_engines[engine].supported==NULL) {
+		return 1;
+	}
+	return ecrs_engines[engine].supported();
+}
+
+uint8_t ecrs_engine_select(uint8_t engine) {
+	if (ecrs_engine_supported(engine)==0) {
+		return 0;
+	}
+	ecrs_current_engine = engine;
+	return 1;
+}
+
+uint8_t ecrs_engine_current(void) {
+	return ecrs_current_engine;
+}
+
+const char* ecrs_engine_name(uint8_t engine) {
+	if (engine>=ECRS_ENGINES) {
+		return "unknown";
+	}
+	return ecrs_engines[engine].name;
+}
+
+// all coefficients are 0 or 1 - dot product is a plain xor of some sources
+static inline uint8_t ecrs_xor_sources(const uint8_t * const *src,const uint8_t *coefs,uint8_t cnt,const uint8_t **xsrc) {
+	uint8_t i,xcnt;
+
+	xcnt = 0;
+	for (i=0 ; i<cnt ; i++) {
+		if (coefs[i]>1) {
+			return 0xFF;
+		}
+		if (coefs[i]==1) {
+			xsrc[xcnt++] = src[i];
+		}
+	}
+	return xcnt;
+}
+
+void ecrs_dotprod(uint8_t *dst,const uint8_t * const *src,const uint8_t *coefs,uint8_t cnt,uint32_t leng) {
+	const uint8_t *xsrc[ECRS_MAX_SOURCES];
+	uint8_t xcnt;
+
+	if (cnt<=ECRS_MAX_SOURCES) {
+		xcnt = ecrs_xor_sources(src,coefs,cnt,xsrc);
+		if (xcnt!=0xFF) {
+			xordata_multi(dst,xsrc,xcnt,leng);
+			return;
+		}
+	}
+	if (cnt>ECRS_MAX_SOURCES) {
+		ecrs_dotprod(dst,src,coefs,ECRS_MAX_SOURCES,leng);
+		while (cnt>ECRS_MAX_SOURCES) {
+			cnt--;
+			ecrs_muladd(dst,src[cnt],coefs[cnt],leng);
+		}
+		return;
+	}
+	ecrs_engines[ecrs_current_engine].dotprod(dst,src,coefs,cnt,leng);
+}
+
+uint32_t ecrs_dotprod_crc(uint8_t *dst,const uint8_t * const *src,const uint8_t *coefs,uint8_t cnt,uint32_t leng) {
+	const uint8_t *tsrc[ECRS_MAX_SOURCES];
+	uint32_t pos,tl,crc;
+	uint8_t i,xcnt;
+
+	if (cnt>ECRS_MAX_SOURCES) {
+		ecrs_dotprod(dst,src,coefs,cnt,leng);
+		return mycrc32(0,dst,leng);
+	}
+	xcnt = ecrs_xor_sources(src,coefs,cnt,tsrc);
+	if (xcnt!=0xFF) {
+		return xordata_multi_crc(0,dst,tsrc,xcnt,leng);
+	}
+	crc = 0;
+	for (pos=0 ; pos<leng ; pos+=tl) {
+		tl = leng-pos;
+		if (tl>ECRS_CRC_TILE) {
+			tl = ECRS_CRC_TILE;
+		}
+		for (i=0 ; i<cnt ; i++) {
+			tsrc[i] = src[i]+pos;
+		}
+		ecrs_engines[ecrs_current_engine].dotprod(dst+pos,tsrc,coefs,cnt,tl);
+		crc = mycrc32(crc,dst+pos,tl);
+	}
+	return crc;
+}
+
+void ecrs_muladd(uint8_t *dst,const uint8_t *src,uint8_t coef,uint32_t leng) {
+	const uint8_t *tsrc[2];
+	uint8_t tcoefs[2];
+
+	if (coef==0) {
+		return;
+	}
+	if (coef==1) {
+		xordata(dst,src,leng);
+		return;
+	}
+	tsrc[0] = dst;
+	tsrc[1] = src;
+	tcoefs[0] = 1;
+	tcoefs[1] = coef;
+	ecrs_engines[ecrs_current_engine].dotprod(dst,tsrc,tcoefs,2,leng);
+}
+
+void ecrs_init(void) {
+	uint8_t engine;
+
+	ecrs_generate_tables();
+	xordata_init();
+	ecrs_current_engine = ECRS_ENGINE_GENERIC;
+	for (engine=ECRS_ENGINE_GENERIC+1 ; engine<ECRS_ENGINES ; engine++) {
+		if (ecrs_engine_supported(engine)) {
+			ecrs_current_engine = engine;
+		}
+	}
+}
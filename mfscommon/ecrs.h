@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2026 Jakub Kruszona-Zawadzki, Saglabs SA
+ * 
+ * This file is part of MooseFS.
+ * 
+ * MooseFS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 (only).
+ * 
+ * MooseFS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _ECRS_H_
+#define _ECRS_H_
+#include <inttypes.h>
+
+// Reed-Solomon code over GF(2^8) used for EC parts - parts numbered as in chunk ids:
+// 0 .. dataparts-1 are data parts, dataparts .. dataparts+ECRS_MAX_CHKSUM_PARTS-1 are checksum parts
+// first checksum part is always a plain xor of data parts (compatible with single parity EC)
+
+#define ECRS_MAX_DATA_PARTS 8
+#define ECRS_MAX_CHKSUM_PARTS 9
+#define ECRS_MAX_PARTS (ECRS_MAX_DATA_PARTS+ECRS_MAX_CHKSUM_PARTS)
+
+#define ECRS_ENGINE_GENERIC 0
+#define ECRS_ENGINE_SSSE3 1
+#define ECRS_ENGINE_AVX2 2
+#define ECRS_ENGINE_NEON 3
+#define ECRS_ENGINES 4
+
+uint8_t ecrs_gfmul(uint8_t a,uint8_t b);
+uint8_t ecrs_gfinv(uint8_t a);
+
+// coefficients of data parts used to calculate checksum part 'chksumpart' (0 based)
+int ecrs_chksum_coefs(uint8_t dataparts,uint8_t chksumpart,uint8_t *coefs);
+// coefficients of 'survivors' (any 'dataparts' different part numbers) needed to rebuild part 'dstpart'
+int ecrs_recover_coefs(uint8_t dataparts,const uint8_t *survivors,uint8_t dstpart,uint8_t *coefs);
+
+// dst = coefs[0]*src[0] + ... + coefs[cnt-1]*src[cnt-1]
+void ecrs_dotprod(uint8_t *dst,const uint8_t * const *src,const uint8_t *coefs,uint8_t cnt,uint32_t leng);
+// as above, but also returns crc of dst (calculated piece by piece while data is still in L1 cache)
+uint32_t ecrs_dotprod_crc(uint8_t *dst,const uint8_t * const *src,const uint8_t *coefs,uint8_t cnt,uint32_t leng);
+// dst += coef*src
+void ecrs_muladd(uint8_t *dst,const uint8_t *src,uint8_t coef,uint32_t leng);
+
+uint8_t ecrs_engine_supported(uint8_t engine);
+uint8_t ecrs_engine_select(uint8_t engine);
+uint8_t ecrs_engine_current(void);
+const char* ecrs_engine_name(uint8_t engine);
+
+void ecrs_init(void);
+
+#endif
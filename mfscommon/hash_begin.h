@@ -209,6 +209,11 @@ static inline void GLUE_FN_NAME_PREFIX(_hash_move)(void) {
 	} while (moved<HASHTAB_MOVEFACTOR);
 }
 
+// finds move elements while rehash is in progress - they are pure reads only when this returns 1
+static inline uint8_t GLUE_FN_NAME_PREFIX(_hash_stable)(void) {
+	return (GLUE_HASH_TAB_PREFIX(rehashpos)>=GLUE_HASH_TAB_PREFIX(hashsize))?1:0;
+}
+
 static inline ENTRY_TYPE* GLUE_FN_NAME_PREFIX(_find)(HASH_ARGS_TYPE_LIST) {
 	ENTRY_TYPE *e;
 	uint32_t hash;
@@ -29,6 +29,7 @@
 #include <inttypes.h>
 #include <pthread.h>
 
+#include "lwthread.h"
 #include "massert.h"
 
 #ifndef WIN32
@@ -112,3 +113,130 @@ int lwt_minthread_create(pthread_t *th,uint8_t detached,void *(*fn)(void *),void
 	return lwt_thread_create(th,thattr,fn,arg);
 #endif
 }
+
+/* phase pool */
+
+typedef struct _lwt_phasethread {
+	pthread_t thid;
+	void *arg;
+	struct _lwt_phasepool *pp;
+	struct _lwt_phasethread *next;
+} lwt_phasethread;
+
+struct _lwt_phasepool {
+	void (*work)(void *arg);
+	lwt_phasethread *head;
+	pthread_mutex_t lock;
+	pthread_cond_t startcond;
+	pthread_cond_t donecond;
+	uint32_t phaseid;
+	uint32_t helpers;
+	uint32_t joined;
+	uint32_t active;
+	uint8_t term;
+};
+
+static void* lwt_phase_thread(void *arg) {
+	lwt_phasethread *pt = (lwt_phasethread*)arg;
+	lwt_phasepool *pp = pt->pp;
+	uint32_t lastphase;
+
+	zassert(pthread_mutex_lock(&(pp->lock)));
+	lastphase = pp->phaseid;
+	for (;;) {
+		while (pp->term==0 && (lastphase==pp->phaseid || pp->joined>=pp->helpers)) {
+			lastphase = pp->phaseid; // too late for this phase
+			zassert(pthread_cond_wait(&(pp->startcond),&(pp->lock)));
+		}
+		if (pp->term) {
+			break;
+		}
+		lastphase = pp->phaseid;
+		pp->joined++;
+		pp->active++;
+		zassert(pthread_mutex_unlock(&(pp->lock)));
+		pp->work(pt->arg);
+		zassert(pthread_mutex_lock(&(pp->lock)));
+		pp->active--;
+		if (pp->active==0) {
+			zassert(pthread_cond_signal(&(pp->donecond)));
+		}
+	}
+	zassert(pthread_mutex_unlock(&(pp->lock)));
+	return NULL;
+}
+
+lwt_phasepool* lwt_phase_new(void (*work)(void *arg)) {
+	lwt_phasepool *pp;
+
+	pp = malloc(sizeof(lwt_phasepool));
+	passert(pp);
+	pp->work = work;
+	pp->head = NULL;
+	zassert(pthread_mutex_init(&(pp->lock),NULL));
+	zassert(pthread_cond_init(&(pp->startcond),NULL));
+	zassert(pthread_cond_init(&(pp->donecond),NULL));
+	pp->phaseid = 0;
+	pp->helpers = 0;
+	pp->joined = 0;
+	pp->active = 0;
+	pp->term = 0;
+	return pp;
+}
+
+// starts new helper thread ('arg' is passed to its 'work') - returns 0 or error code from pthread_create
+int lwt_phase_addthread(lwt_phasepool *pp,void *arg) {
+	lwt_phasethread *pt;
+	int res;
+
+	pt = malloc(sizeof(lwt_phasethread));
+	passert(pt);
+	pt->arg = arg;
+	pt->pp = pp;
+	res = lwt_minthread_create(&(pt->thid),0,lwt_phase_thread,pt);
+	if (res!=0) {
+		free(pt);
+		return res;
+	}
+	pt->next = pp->head;
+	pp->head = pt;
+	return 0;
+}
+
+// at most 'helpers' threads join the phase - calling thread does its part of work with 'mainarg' and then waits for them
+void lwt_phase_run(lwt_phasepool *pp,uint32_t helpers,void *mainarg) {
+	zassert(pthread_mutex_lock(&(pp->lock)));
+	pp->helpers = helpers;
+	pp->joined = 0;
+	pp->active = 0;
+	pp->phaseid++;
+	zassert(pthread_cond_broadcast(&(pp->startcond)));
+	zassert(pthread_mutex_unlock(&(pp->lock)));
+
+	pp->work(mainarg);
+
+	zassert(pthread_mutex_lock(&(pp->lock)));
+	pp->helpers = pp->joined; // threads that didn't start yet have nothing to do
+	while (pp->active>0) {
+		zassert(pthread_cond_wait(&(pp->donecond),&(pp->lock)));
+	}
+	zassert(pthread_mutex_unlock(&(pp->lock)));
+}
+
+void lwt_phase_term(lwt_phasepool *pp) {
+	lwt_phasethread *pt;
+
+	zassert(pthread_mutex_lock(&(pp->lock)));
+	pp->term = 1;
+	zassert(pthread_cond_broadcast(&(pp->startcond)));
+	zassert(pthread_mutex_unlock(&(pp->lock)));
+	while ((pt=pp->head)!=NULL) {
+		zassert(pthread_join(pt->thid,NULL));
+		pp->head = pt->next;
+		free(pt);
+	}
+	zassert(pthread_cond_destroy(&(pp->donecond)));
+	zassert(pthread_cond_destroy(&(pp->startcond)));
+	zassert(pthread_mutex_destroy(&(pp->lock)));
+	free(pp);
+}
@@ -28,4 +28,12 @@ int lwt_thread_create(pthread_t *th,const pthread_attr_t *attr,void *(*fn)(void
 #endif
 int lwt_minthread_create(pthread_t *th,uint8_t detached,void *(*fn)(void *),void *arg);
 
+// phase pool - helper threads execute 'work' together with the calling thread, lwt_phase_run returns when all of them are done
+typedef struct _lwt_phasepool lwt_phasepool;
+
+lwt_phasepool* lwt_phase_new(void (*work)(void *arg));
+int lwt_phase_addthread(lwt_phasepool *pp,void *arg);
+void lwt_phase_run(lwt_phasepool *pp,uint32_t helpers,void *mainarg);
+void lwt_phase_term(lwt_phasepool *pp);
+
 #endif
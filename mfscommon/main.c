@@ -56,6 +56,14 @@
 #  include <sys/prctl.h>
 #endif
 
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_EPOLL_CREATE1)
+#  include <sys/epoll.h>
+#  define MAIN_USE_EPOLL 1
+#elif defined(HAVE_SYS_EVENT_H) && defined(HAVE_KQUEUE)
+#  include <sys/event.h>
+#  define MAIN_USE_KQUEUE 1
+#endif
+
 #include <syslog.h>
 
 #ifdef USE_IONICE
@@ -199,6 +207,32 @@ typedef struct pollentry {
 static pollentry *pollhead=NULL;
 
 
+// persistent descriptors - registered once and watched by epoll/kqueue (or added to poll table when neither is available)
+typedef struct eventry {
+	int fd;
+	uint8_t events;
+	void (*fun)(void *,uint8_t);
+	void *data;
+	char *fname;
+	struct eventry *next,**prev;
+} eventry;
+
+#define EV_BACKEND_NONE 0
+#define EV_BACKEND_POLL 1
+#define EV_BACKEND_EPOLL 2
+#define EV_BACKEND_KQUEUE 3
+
+#define EV_BATCH 256
+
+#define MAIN_EV_ADDED 0x80
+
+static eventry *evhead=NULL;
+static eventry *evfreehead=NULL; // unregistered entries - freed after current loop (they can still be referenced by pending events)
+static uint32_t evcount=0;
+static uint8_t evbackend=EV_BACKEND_NONE;
+static int evfd=-1;
+
+
 typedef struct eloopentry {
 	void (*fun)(void);
 	char *fname;
@@ -316,6 +350,227 @@ void main_poll_register_fname (void (*desc)(struct pollfd *,uint32_t *),void (*s
 	pollhead = aux;
 }
 
+static void main_ev_init(void) {
+	if (evbackend!=EV_BACKEND_NONE) {
+		return;
+	}
+	evbackend = EV_BACKEND_POLL;
+#if defined(MAIN_USE_EPOLL)
+	evfd = epoll_create1(EPOLL_CLOEXEC);
+	if (evfd>=0) {
+		evbackend = EV_BACKEND_EPOLL;
+	} else {
+		mfs_log(MFSLOG_ERRNO_SYSLOG,MFSLOG_WARNING,"can't create epoll descriptor - using poll");
+	}
+#elif defined(MAIN_USE_KQUEUE)
+	evfd = kqueue();
+	if (evfd>=0) {
+		evbackend = EV_BACKEND_KQUEUE;
+	} else {
+		mfs_log(MFSLOG_ERRNO_SYSLOG,MFSLOG_WARNING,"can't create kqueue descriptor - using poll");
+	}
+#endif
+}
+
+static int main_ev_kernel_set(eventry *e,uint8_t oldevents,uint8_t newevents) {
+#if defined(MAIN_USE_EPOLL)
+	struct epoll_event ev;
+	if (evbackend==EV_BACKEND_EPOLL) {
+		memset(&ev,0,sizeof(ev));
+		ev.events = ((newevents&MAIN_EV_READ)?EPOLLIN:0) | ((newevents&MAIN_EV_WRITE)?EPOLLOUT:0);
+		ev.data.ptr = e;
+		if (newevents&MAIN_EV_ADDED) {
+			return epoll_ctl(evfd,(oldevents&MAIN_EV_ADDED)?EPOLL_CTL_MOD:EPOLL_CTL_ADD,e->fd,&ev);
+		} else {
+			return epoll_ctl(evfd,EPOLL_CTL_DEL,e->fd,&ev);
+		}
+	}
+#elif defined(MAIN_USE_KQUEUE)
+	struct kevent ch[2];
+	int n;
+	if (evbackend==EV_BACKEND_KQUEUE) {
+		n = 0;
+		if ((oldevents^newevents)&MAIN_EV_READ) {
+			EV_SET(ch+n,e->fd,EVFILT_READ,(newevents&MAIN_EV_READ)?EV_ADD:EV_DELETE,0,0,(void*)e);
+			n++;
+		}
+		if ((oldevents^newevents)&MAIN_EV_WRITE) {
+			EV_SET(ch+n,e->fd,EVFILT_WRITE,(newevents&MAIN_EV_WRITE)?EV_ADD:EV_DELETE,0,0,(void*)e);
+			n++;
+		}
+		if (n>0) {
+			return kevent(evfd,ch,n,NULL,0,NULL);
+		}
+		return 0;
+	}
+#else
+	(void)e;
+	(void)oldevents;
+	(void)newevents;
+#endif
+	return 0;
+}
+
+void* main_ev_register_fname (int fd,uint8_t events,void (*fun)(void *,uint8_t),void *data,const char *fname) {
+	eventry *aux;
+
+	main_ev_init();
+	aux = (eventry*)malloc(sizeof(eventry));
+	passert(aux);
+	aux->fd = fd;
+	aux->events = 0;
+	aux->fun = fun;
+	aux->data = data;
+	aux->fname = strdup(fname);
+	events = (events&(MAIN_EV_READ|MAIN_EV_WRITE))|MAIN_EV_ADDED;
+	if (main_ev_kernel_set(aux,0,events)<0) {
+		mfs_log(MFSLOG_ERRNO_SYSLOG,MFSLOG_ERR,"can't add descriptor %d to %s",fd,main_ev_backend());
+		free(aux->fname);
+		free(aux);
+		return NULL;
+	}
+	aux->events = events;
+	aux->next = evhead;
+	if (evhead) {
+		evhead->prev = &(aux->next);
+	}
+	aux->prev = &evhead;
+	evhead = aux;
+	evcount++;
+	return aux;
+}
+
+void main_ev_change(void *x,uint8_t events) {
+	eventry *aux = (eventry*)x;
+
+	events = (events&(MAIN_EV_READ|MAIN_EV_WRITE))|MAIN_EV_ADDED;
+	if (aux->events==events) {
+		return;
+	}
+	if (main_ev_kernel_set(aux,aux->events,events)<0) {
+		mfs_log(MFSLOG_ERRNO_SYSLOG,MFSLOG_WARNING,"can't change events of descriptor %d in %s",aux->fd,main_ev_backend());
+	}
+	aux->events = events;
+}
+
+void main_ev_unregister(void *x) {
+	eventry *aux = (eventry*)x;
+
+	// must be called before descriptor is closed - forked children can still hold it open, so kernel would keep reporting it
+	main_ev_kernel_set(aux,aux->events,0);
+	*(aux->prev) = aux->next;
+	if (aux->next) {
+		aux->next->prev = aux->prev;
+	}
+	evcount--;
+	aux->fun = NULL;
+	aux->next = evfreehead;
+	evfreehead = aux;
+}
+
+const char* main_ev_backend(void) {
+	main_ev_init();
+	switch (evbackend) {
+		case EV_BACKEND_EPOLL:
+			return "epoll";
+		case EV_BACKEND_KQUEUE:
+			return "kqueue";
+	}
+	return "poll";
+}
+
+static inline void main_ev_call(eventry *e,uint8_t events) {
+	if (e->fun!=NULL && events) {
+		LOOP_START;
+		e->fun(e->data,events);
+		LOOP_END(e->fname);
+	}
+}
+
+static void main_ev_dispatch(struct pollfd *pdesc,eventry **evtab,uint32_t evn) {
+	uint32_t i;
+	uint8_t events;
+	if (evbackend==EV_BACKEND_POLL) {
+		for (i=0 ; i<evn ; i++) {
+			events = 0;
+			if (pdesc[i].revents & POLLIN) {
+				events |= MAIN_EV_READ;
+			}
+			if (pdesc[i].revents & POLLOUT) {
+				events |= MAIN_EV_WRITE;
+			}
+			if (pdesc[i].revents & POLLHUP) {
+				events |= MAIN_EV_HUP;
+			}
+			if (pdesc[i].revents & (POLLERR|POLLNVAL)) {
+				events |= MAIN_EV_ERR;
+			}
+			main_ev_call(evtab[i],events);
+		}
+		return;
+	}
+	if (evn==0 || (pdesc[0].revents & POLLIN)==0) {
+		return;
+	}
+#if defined(MAIN_USE_EPOLL)
+	{
+		static struct epoll_event evbuff[EV_BATCH];
+		int n,j;
+
+		n = epoll_wait(evfd,evbuff,EV_BATCH,0);
+		for (j=0 ; j<n ; j++) {
+			events = 0;
+			if (evbuff[j].events & EPOLLIN) {
+				events |= MAIN_EV_READ;
+			}
+			if (evbuff[j].events & EPOLLOUT) {
+				events |= MAIN_EV_WRITE;
+			}
+			if (evbuff[j].events & EPOLLHUP) {
+				events |= MAIN_EV_HUP;
+			}
+			if (evbuff[j].events & EPOLLERR) {
+				events |= MAIN_EV_ERR;
+			}
+			main_ev_call((eventry*)(evbuff[j].data.ptr),events);
+		}
+	}
+#elif defined(MAIN_USE_KQUEUE)
+	{
+		static struct kevent evbuff[EV_BATCH];
+		static const struct timespec zerots = {0,0};
+		int n,j;
+
+		n = kevent(evfd,NULL,0,evbuff,EV_BATCH,&zerots);
+		for (j=0 ; j<n ; j++) {
+			events = 0;
+			if (evbuff[j].flags & EV_ERROR) {
+				events |= MAIN_EV_ERR;
+			} else if (evbuff[j].filter==EVFILT_READ) {
+				events |= MAIN_EV_READ;
+			} else if (evbuff[j].filter==EVFILT_WRITE) {
+				events |= MAIN_EV_WRITE;
+			}
+			if (evbuff[j].flags & EV_EOF) {
+				events |= MAIN_EV_HUP;
+			}
+			main_ev_call((eventry*)(evbuff[j].udata),events);
+		}
+	}
+#endif
+}
+
+static void main_ev_free_unregistered(void) {
+	eventry *e,*en;
+
+	for (e = evfreehead ; e ; e = en) {
+		en = e->next;
+		free(e->fname);
+		free(e);
+	}
+	evfreehead = NULL;
+}
+
 void main_eachloop_register_fname (void (*fun)(void),const char *fname) {
 	eloopentry *aux=(eloopentry*)malloc(sizeof(eloopentry));
 	passert(aux);
@@ -390,6 +645,7 @@ void free_all_registered_entries(void) {
 	rlentry *re,*ren;
 	inentry *ie,*ien;
 	pollentry *pe,*pen;
+	eventry *ve,*ven;
 	eloopentry *ee,*een;
 	timeentry *te,*ten;
 
@@ -430,6 +686,19 @@ void free_all_registered_entries(void) {
 		free(pe);
 	}
 
+	for (ve = evhead ; ve ; ve = ven) {
+		ven = ve->next;
+		free(ve->fname);
+		free(ve);
+	}
+	evhead = NULL;
+	evcount = 0;
+	main_ev_free_unregistered();
+	if (evfd>=0) {
+		close(evfd);
+		evfd = -1;
+	}
+
 	for (ee = eloophead ; ee ; ee = een) {
 		een = ee->next;
 		free(ee->fname);
@@ -601,6 +870,9 @@ int mainloop(void) {
 	FILE *infile;
 	struct pollfd *pdesc;
 	uint32_t ndesc;
+	eventry **evtab;
+	eventry *evit;
+	uint32_t evpos,evn;
 	double loop_end;
 	int i;
 	int t,r;
@@ -609,6 +881,9 @@ int mainloop(void) {
 	t = 0;
 	r = 0;
 	pdesc = malloc(sizeof(struct pollfd)*MFSMAXFILES);
+	passert(pdesc);
+	evtab = malloc(sizeof(eventry*)*MFSMAXFILES);
+	passert(evtab);
 	loop_start = monotonic_seconds();
 	while (t!=3) {
 		if (loop_usleep) {
@@ -623,6 +898,23 @@ int mainloop(void) {
 			pollit->desc(pdesc,&ndesc);
 			LOOP_END(pollit->dname);
 		}
+		evpos = ndesc;
+		evn = 0;
+		if (evbackend==EV_BACKEND_POLL) {
+			for (evit = evhead ; evit != NULL && ndesc < MFSMAXFILES ; evit = evit->next) {
+				pdesc[ndesc].fd = evit->fd;
+				pdesc[ndesc].events = ((evit->events&MAIN_EV_READ)?POLLIN:0) | ((evit->events&MAIN_EV_WRITE)?POLLOUT:0);
+				pdesc[ndesc].revents = 0;
+				evtab[evn++] = evit;
+				ndesc++;
+			}
+		} else if (evcount>0) {
+			pdesc[ndesc].fd = evfd;
+			pdesc[ndesc].events = POLLIN;
+			pdesc[ndesc].revents = 0;
+			evn = 1;
+			ndesc++;
+		}
 		loop_end = monotonic_seconds();
 		if (loop_end - loop_start > 5.0) {
 			mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"long loop detected (%.3lfs)",loop_end-loop_start);
@@ -677,12 +969,14 @@ int mainloop(void) {
 					}
 				}
 			}
+			main_ev_dispatch(pdesc+evpos,evtab,evn);
 			for (pollit = pollhead ; pollit != NULL ; pollit = pollit->next) {
 				LOOP_START;
 				pollit->serve(pdesc);
 				LOOP_END(pollit->sname);
 			}
 		}
+		main_ev_free_unregistered();
 		for (eloopit = eloophead ; eloopit != NULL ; eloopit = eloopit->next) {
 			LOOP_START;
 			eloopit->fun();
@@ -810,6 +1104,7 @@ int mainloop(void) {
 			}
 		}
 	}
+	free(evtab);
 	free(pdesc);
 	return status;
 }
@@ -37,6 +37,7 @@
 #define main_chld_register(p,x) main_chld_register_fname(p,x,STR(x))
 #define main_keepalive_register(x) main_keepalive_register_fname(x,STR(x))
 #define main_poll_register(x,y) main_poll_register_fname(x,y,STR(x),STR(y))
+#define main_ev_register(f,e,x,d) main_ev_register_fname(f,e,x,d,STR(x))
 #define main_eachloop_register(x) main_eachloop_register_fname(x,STR(x))
 #define main_msectime_register(m,o,x) main_msectime_register_fname(m,o,x,STR(x))
 #define main_time_register(s,o,x) main_time_register_fname(s,o,x,STR(x))
@@ -51,6 +52,18 @@ void main_chld_register_fname (pid_t pid,void (*fun)(pid_t,int),const char *fnam
 void main_keepalive_register_fname (void (*fun)(void),const char *fname);
 void main_poll_register_fname (void (*desc)(struct pollfd *,uint32_t *),void (*serve)(struct pollfd *),const char *dname,const char *sname);
 void main_eachloop_register_fname (void (*fun)(void),const char *fname);
+
+// persistent descriptors - watched by epoll/kqueue (level triggered) or by poll when they are not available
+// callback is called in main loop (before 'serve' functions) with ready events
+#define MAIN_EV_READ 1
+#define MAIN_EV_WRITE 2
+#define MAIN_EV_HUP 4
+#define MAIN_EV_ERR 8
+
+void* main_ev_register_fname (int fd,uint8_t events,void (*fun)(void *,uint8_t),void *data,const char *fname);
+void main_ev_change(void *x,uint8_t events);
+void main_ev_unregister(void *x); // has to be called before descriptor is closed
+const char* main_ev_backend(void);
 void* main_msectime_register_fname (uint32_t mseconds,uint32_t offset,void (*fun)(void),const char *fname);
 void* main_time_register_fname (uint32_t seconds,uint32_t offset,void (*fun)(void),const char *fname);
 
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2026 Jakub Kruszona-Zawadzki, Saglabs SA
+ * 
+ * This file is part of MooseFS.
+ * 
+ * MooseFS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 (only).
+ * 
+ * MooseFS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "datapack.h"
+#include "metaindex.h"
+
+static int metaindex_pread(int fd,uint8_t *buff,uint64_t leng,uint64_t offset) {
+	ssize_t r;
+	while (leng>0) {
+		r = pread(fd,buff,leng,offset);
+		if (r<=0) {
+			return -1;
+		}
+		buff += r;
+		offset += r;
+		leng -= r;
+	}
+	return 0;
+}
+
+metaindex* metaindex_load(int fd) {
+	struct stat st;
+	uint8_t tail[8+16];
+	uint8_t *data,*secbuff;
+	const uint8_t *rptr;
+	uint64_t ioffset,ileng,fsize,secbuffsize;
+	uint32_t i,j;
+	metaindex *mi;
+	metaindex_section *ms;
+
+	if (fstat(fd,&st)<0) {
+		return NULL;
+	}
+	fsize = st.st_size;
+	if (fsize<8+16+16+8+8+16) {
+		return NULL;
+	}
+	if (metaindex_pread(fd,tail,8+16,fsize-(8+16))<0) {
+		return NULL;
+	}
+	if (memcmp(tail+8,"[MFS EOF MARKER]",16)!=0) {
+		return NULL;
+	}
+	rptr = tail;
+	ioffset = get64bit(&rptr);
+	if (ioffset<8+16 || ioffset+16+8+8+16>fsize) {
+		return NULL;
+	}
+	ileng = fsize-16-ioffset;	// whole index section with header
+	data = malloc(ileng);
+	if (data==NULL) {
+		return NULL;
+	}
+	if (metaindex_pread(fd,data,ileng,ioffset)<0 || memcmp(data,"INDX 1.0",8)!=0) {
+		free(data);
+		return NULL;
+	}
+	rptr = data+8;
+	if (get64bit(&rptr)!=ileng-16) {
+		free(data);
+		return NULL;
+	}
+	mi = malloc(sizeof(metaindex));
+	if (mi==NULL) {
+		free(data);
+		return NULL;
+	}
+	mi->segsize = get32bit(&rptr);
+	mi->seccnt = get32bit(&rptr);
+	mi->offset = ioffset;
+	mi->secs = NULL;
+	if ((uint64_t)(mi->seccnt)*(8+8+8+8+4) > ileng-16-8-8) {
+		goto err;
+	}
+	mi->secs = malloc(sizeof(metaindex_section)*(mi->seccnt+1));
+	if (mi->secs==NULL) {
+		goto err;
+	}
+	for (i=0 ; i<mi->seccnt ; i++) {
+		mi->secs[i].segs = NULL;
+	}
+	secbuff = data+ileng-8;	// end of sections data
+	for (i=0 ; i<mi->seccnt ; i++) {
+		ms = mi->secs+i;
+		if (rptr+8+8+8+8+4 > secbuff) {
+			goto err;
+		}
+		memcpy(ms->hdr,rptr,8);
+		rptr += 8;
+		ms->offset = get64bit(&rptr);
+		ms->length = get64bit(&rptr);
+		ms->records = get64bit(&rptr);
+		ms->segcnt = get32bit(&rptr);
+		secbuffsize = (uint64_t)(ms->segcnt)*(8+4+4+4);
+		if (secbuffsize > (uint64_t)(secbuff-rptr) || ms->offset+16+ms->length>ioffset) {
+			goto err;
+		}
+		ms->segs = malloc(sizeof(metaindex_segment)*(ms->segcnt+1));
+		if (ms->segs==NULL) {
+			goto err;
+		}
+		for (j=0 ; j<ms->segcnt ; j++) {
+			ms->segs[j].offset = get64bit(&rptr);
+			ms->segs[j].length = get32bit(&rptr);
+			ms->segs[j].records = get32bit(&rptr);
+			ms->segs[j].crc = get32bit(&rptr);
+			if (ms->segs[j].offset<ms->offset+16 || ms->segs[j].offset+ms->segs[j].length>ms->offset+16+ms->length) {
+				goto err;
+			}
+		}
+	}
+	if (rptr!=secbuff) {
+		goto err;
+	}
+	free(data);
+	return mi;
+err:
+	free(data);
+	metaindex_free(mi);
+	return NULL;
+}
+
+const metaindex_section* metaindex_find(const metaindex *mi,const char name[4]) {
+	uint32_t i;
+	for (i=0 ; i<mi->seccnt ; i++) {
+		if (memcmp(mi->secs[i].hdr,name,4)==0) {
+			return mi->secs+i;
+		}
+	}
+	return NULL;
+}
+
+void metaindex_free(metaindex *mi) {
+	uint32_t i;
+	if (mi->secs!=NULL) {
+		for (i=0 ; i<mi->seccnt ; i++) {
+			if (mi->secs[i].segs!=NULL) {
+				free(mi->secs[i].segs);
+			}
+		}
+		free(mi->secs);
+	}
+	free(mi);
+}
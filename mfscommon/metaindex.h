@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2026 Jakub Kruszona-Zawadzki, Saglabs SA
+ * 
+ * This file is part of MooseFS.
+ * 
+ * MooseFS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 (only).
+ * 
+ * MooseFS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _METAINDEX_H_
+#define _METAINDEX_H_
+
+#include <inttypes.h>
+
+// metadata file (format 2.1) ends with index section followed by 'EOF' marker:
+//   "INDX 1.0" ; length:64 ; segsize:32 ; sections:32 ; sections * [ section ] ; indexoffset:64 ; "[MFS EOF MARKER]"
+// section:
+//   header:8 (i.e. "NODE 1.4") ; offset:64 (of section header) ; length:64 ; records:64 ; segments:32 ; segments * [ segment ]
+// segment:
+//   offset:64 (absolute) ; length:32 ; records:32 ; crc:32
+// segments with records>0 contain only whole records (first segment also starts with section specific header),
+// segments with records==0 come from sections without record marks and can be split anywhere
+
+#define METAINDEX_SEGMENT_SIZE 0x400000
+
+typedef struct _metaindex_segment {
+	uint64_t offset;
+	uint32_t length;
+	uint32_t records;
+	uint32_t crc;
+} metaindex_segment;
+
+typedef struct _metaindex_section {
+	uint8_t hdr[8];
+	uint64_t offset;
+	uint64_t length;
+	uint64_t records;
+	uint32_t segcnt;
+	metaindex_segment *segs;
+} metaindex_section;
+
+typedef struct _metaindex {
+	uint32_t segsize;
+	uint32_t seccnt;
+	uint64_t offset;
+	metaindex_section *secs;
+} metaindex;
+
+// reads index from metadata file ; returns NULL when file has no (valid) index
+metaindex* metaindex_load(int fd);
+const metaindex_section* metaindex_find(const metaindex *mi,const char name[4]);
+void metaindex_free(metaindex *mi);
+
+#endif
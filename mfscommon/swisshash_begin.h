@@ -0,0 +1,364 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <inttypes.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+#include "glue.h"
+#include "massert.h"
+
+// open addressing hash map of pointers (swiss table like) - used instead of hash_begin.h when
+// elements don't have to be iterated. Same template parameters as hash_begin.h:
+
+// ENTRY_TYPE - type of record stored in hash map
+// GLUE_FN_NAME_PREFIX - prefix of function names
+// HASH_ARGS_TYPE_LIST - list of find function arguments with types
+// HASH_ARGS_LIST - list of find function arguments (also hash function)
+// GLUE_HASH_TAB_PREFIX - prefix of hash tab name
+// HASH_VALUE_FIELD - (optional) field with hash value - has to be set before calling _add
+//
+// GLUE_FN_NAME_PREFIX(_cmp)(e,args) and GLUE_FN_NAME_PREFIX(_hash)(args) have to be defined,
+// GLUE_FN_NAME_PREFIX(_ehash)(e) is needed only if HASH_VALUE_FIELD is not defined
+
+// layout: slots are divided into groups of 16, every group is 16 control bytes followed by 16 pointers
+// (so control bytes and matching pointer are usually in the same or adjacent cache line). Control byte:
+//   0x00 - empty, 0x01 - deleted, 0x80|h2 - used (h2 - highest 7 bits of hash value)
+// whole group of control bytes is compared at once (SSE2), so usually only one entry is touched per find.
+// growing is incremental - new table is allocated and on every operation few groups of the old one are moved,
+// until then both tables are searched.
+
+#ifndef _SWISSHASH_COMMON_
+#define _SWISSHASH_COMMON_
+
+#define SWISSHASH_GROUP 16
+#define SWISSHASH_EMPTY 0x00
+#define SWISSHASH_DELETED 0x01
+#define SWISSHASH_FULL(h) (0x80|((h)>>25))
+#define SWISSHASH_MINGROUPS 64
+#define SWISSHASH_MOVEFACTOR 4
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+
+static inline uint32_t swisshash_match(const uint8_t *g,uint8_t c) {
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128((const __m128i*)g),_mm_set1_epi8((char)c)));
+}
+
+// empty or deleted
+static inline uint32_t swisshash_match_free(const uint8_t *g) {
+	return (~(uint32_t)_mm_movemask_epi8(_mm_load_si128((const __m128i*)g))) & 0xFFFF;
+}
+#else
+static inline uint32_t swisshash_match(const uint8_t *g,uint8_t c) {
+	uint32_t i,m;
+	m = 0;
+	for (i=0 ; i<SWISSHASH_GROUP ; i++) {
+		m |= (uint32_t)(g[i]==c)<<i;
+	}
+	return m;
+}
+
+static inline uint32_t swisshash_match_free(const uint8_t *g) {
+	uint32_t i,m;
+	m = 0;
+	for (i=0 ; i<SWISSHASH_GROUP ; i++) {
+		m |= (uint32_t)((g[i]&0x80)==0)<<i;
+	}
+	return m;
+}
+#endif
+
+static inline uint32_t swisshash_firstbit(uint32_t m) {
+#if defined(__GNUC__)
+	return __builtin_ctz(m);
+#else
+	uint32_t i = 0;
+	while ((m&1)==0) {
+		m>>=1;
+		i++;
+	}
+	return i;
+#endif
+}
+
+static inline uint8_t* swisshash_alloc(uint32_t groups,uint32_t entrysize) {
+	uint8_t *ctrl;
+	size_t size = (size_t)groups*SWISSHASH_GROUP*(1+entrysize);
+#ifdef HAVE_MMAP
+	ctrl = mmap(NULL,size,PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE,-1,0); // zeroed pages - all slots empty
+	passert(ctrl);
+#else
+	ctrl = malloc(size);
+	passert(ctrl);
+	memset(ctrl,SWISSHASH_EMPTY,size);
+#endif
+	return ctrl;
+}
+
+static inline void swisshash_free(uint8_t *ctrl,uint32_t groups,uint32_t entrysize) {
+#ifdef HAVE_MMAP
+	munmap(ctrl,(size_t)groups*SWISSHASH_GROUP*(1+entrysize));
+#else
+	(void)groups;
+	(void)entrysize;
+	free(ctrl);
+#endif
+}
+
+#endif
+
+#ifdef HASH_VALUE_FIELD
+#define SWISSHASH_EHASH(e) ((e)->HASH_VALUE_FIELD)
+#else
+#define SWISSHASH_EHASH(e) GLUE_FN_NAME_PREFIX(_ehash)(e)
+#endif
+
+static uint8_t *GLUE_HASH_TAB_PREFIX(ctrl);		// control bytes followed by slots
+static uint32_t GLUE_HASH_TAB_PREFIX(groups);
+static uint32_t GLUE_HASH_TAB_PREFIX(used);		// used and deleted slots in current table
+static uint8_t *GLUE_HASH_TAB_PREFIX(oldctrl);		// table being moved (NULL when there is no growing in progress)
+static uint32_t GLUE_HASH_TAB_PREFIX(oldgroups);
+static uint32_t GLUE_HASH_TAB_PREFIX(movepos);
+static uint32_t GLUE_HASH_TAB_PREFIX(hashelem);
+static uint32_t GLUE_HASH_TAB_PREFIX(sizehint);
+
+#define SWISSHASH_GROUPSIZE (SWISSHASH_GROUP*(1+sizeof(ENTRY_TYPE*)))
+
+static inline uint8_t* GLUE_FN_NAME_PREFIX(_group)(uint8_t *ctrl,uint32_t g) {
+	return ctrl+(size_t)g*SWISSHASH_GROUPSIZE;
+}
+
+static inline ENTRY_TYPE** GLUE_FN_NAME_PREFIX(_slots)(uint8_t *cg) {
+	return (ENTRY_TYPE**)(cg+SWISSHASH_GROUP);
+}
+
+static inline void GLUE_FN_NAME_PREFIX(_hash_init)(void) {
+	GLUE_HASH_TAB_PREFIX(ctrl) = NULL;
+	GLUE_HASH_TAB_PREFIX(groups) = 0;
+	GLUE_HASH_TAB_PREFIX(used) = 0;
+	GLUE_HASH_TAB_PREFIX(oldctrl) = NULL;
+	GLUE_HASH_TAB_PREFIX(oldgroups) = 0;
+	GLUE_HASH_TAB_PREFIX(movepos) = 0;
+	GLUE_HASH_TAB_PREFIX(hashelem) = 0;
+	GLUE_HASH_TAB_PREFIX(sizehint) = 0;
+}
+
+static inline void GLUE_FN_NAME_PREFIX(_hash_cleanup)(void) {
+	if (GLUE_HASH_TAB_PREFIX(ctrl)!=NULL) {
+		swisshash_free(GLUE_HASH_TAB_PREFIX(ctrl),GLUE_HASH_TAB_PREFIX(groups),sizeof(ENTRY_TYPE*));
+	}
+	if (GLUE_HASH_TAB_PREFIX(oldctrl)!=NULL) {
+		swisshash_free(GLUE_HASH_TAB_PREFIX(oldctrl),GLUE_HASH_TAB_PREFIX(oldgroups),sizeof(ENTRY_TYPE*));
+	}
+	GLUE_FN_NAME_PREFIX(_hash_init)();
+}
+
+// expected number of elements - used when the table is created (avoids growing while loading data)
+static inline void GLUE_FN_NAME_PREFIX(_hash_presize)(uint32_t elements) {
+	GLUE_HASH_TAB_PREFIX(sizehint) = elements;
+}
+
+static inline void GLUE_FN_NAME_PREFIX(_hash_getusage)(uint64_t *allocated,uint64_t *used) {
+	*allocated = ((uint64_t)(GLUE_HASH_TAB_PREFIX(groups))+GLUE_HASH_TAB_PREFIX(oldgroups))*SWISSHASH_GROUP*(1+sizeof(ENTRY_TYPE*));
+	*used = (uint64_t)(GLUE_HASH_TAB_PREFIX(hashelem))*(1+sizeof(ENTRY_TYPE*));
+}
+
+// number of groups needed to keep load below 1/2 (table is rebuilt when used and deleted slots reach 7/8)
+static inline uint32_t GLUE_FN_NAME_PREFIX(_calc_groups)(uint32_t elements) {
+	uint32_t groups = SWISSHASH_MINGROUPS;
+	while ((uint64_t)groups*SWISSHASH_GROUP < (uint64_t)elements*2 && groups<0x04000000) {
+		groups<<=1;
+	}
+	return groups;
+}
+
+static inline void GLUE_FN_NAME_PREFIX(_insert)(uint8_t *ctrl,uint32_t groups,ENTRY_TYPE *e,uint32_t hashval) {
+	uint32_t g,gmask,step,m,pos;
+	uint8_t *cg;
+
+	gmask = groups-1;
+	g = hashval & gmask;
+	step = 0;
+	for (;;) {
+		cg = GLUE_FN_NAME_PREFIX(_group)(ctrl,g);
+		m = swisshash_match_free(cg);
+		if (m) {
+			pos = swisshash_firstbit(m);
+			if (cg[pos]==SWISSHASH_EMPTY) {
+				GLUE_HASH_TAB_PREFIX(used)++;
+			}
+			cg[pos] = SWISSHASH_FULL(hashval);
+			GLUE_FN_NAME_PREFIX(_slots)(cg)[pos] = e;
+			return;
+		}
+		step++;
+		g = (g+step) & gmask;
+	}
+}
+
+static inline void GLUE_FN_NAME_PREFIX(_hash_move)(void) {
+	uint8_t *cg;
+	ENTRY_TYPE **os;
+	uint32_t moved,pos,m;
+
+	for (moved=0 ; moved<SWISSHASH_MOVEFACTOR && GLUE_HASH_TAB_PREFIX(movepos)<GLUE_HASH_TAB_PREFIX(oldgroups) ; moved++) {
+		cg = GLUE_FN_NAME_PREFIX(_group)(GLUE_HASH_TAB_PREFIX(oldctrl),GLUE_HASH_TAB_PREFIX(movepos));
+		os = GLUE_FN_NAME_PREFIX(_slots)(cg);
+		m = (~swisshash_match_free(cg)) & 0xFFFF;
+		while (m) {
+			pos = swisshash_firstbit(m);
+			m &= m-1;
+			GLUE_FN_NAME_PREFIX(_insert)(GLUE_HASH_TAB_PREFIX(ctrl),GLUE_HASH_TAB_PREFIX(groups),os[pos],SWISSHASH_EHASH(os[pos]));
+			cg[pos] = SWISSHASH_DELETED; // not empty - searches of elements not moved yet have to go through this group
+		}
+		GLUE_HASH_TAB_PREFIX(movepos)++;
+	}
+	if (GLUE_HASH_TAB_PREFIX(movepos)>=GLUE_HASH_TAB_PREFIX(oldgroups)) {
+		swisshash_free(GLUE_HASH_TAB_PREFIX(oldctrl),GLUE_HASH_TAB_PREFIX(oldgroups),sizeof(ENTRY_TYPE*));
+		GLUE_HASH_TAB_PREFIX(oldctrl) = NULL;
+		GLUE_HASH_TAB_PREFIX(oldgroups) = 0;
+		GLUE_HASH_TAB_PREFIX(movepos) = 0;
+	}
+}
+
+// finishes pending growing - after that _find doesn't modify hash table, so it can be used by many threads
+static inline void GLUE_FN_NAME_PREFIX(_hash_finish)(void) {
+	while (GLUE_HASH_TAB_PREFIX(oldctrl)!=NULL) {
+		GLUE_FN_NAME_PREFIX(_hash_move)();
+	}
+}
+
+// finds move elements while growing is in progress - they are pure reads only when this returns 1
+static inline uint8_t GLUE_FN_NAME_PREFIX(_hash_stable)(void) {
+	return (GLUE_HASH_TAB_PREFIX(oldctrl)==NULL)?1:0;
+}
+
+// starts growing (or only cleaning deleted slots when table is mostly deleted slots)
+static inline void GLUE_FN_NAME_PREFIX(_hash_grow)(void) {
+	uint32_t groups;
+
+	GLUE_FN_NAME_PREFIX(_hash_finish)();
+	groups = GLUE_FN_NAME_PREFIX(_calc_groups)(GLUE_HASH_TAB_PREFIX(hashelem)+1);
+	if (groups<GLUE_HASH_TAB_PREFIX(groups)) {
+		groups = GLUE_HASH_TAB_PREFIX(groups);
+	}
+	GLUE_HASH_TAB_PREFIX(oldctrl) = GLUE_HASH_TAB_PREFIX(ctrl);
+	GLUE_HASH_TAB_PREFIX(oldgroups) = GLUE_HASH_TAB_PREFIX(groups);
+	GLUE_HASH_TAB_PREFIX(movepos) = 0;
+	GLUE_HASH_TAB_PREFIX(ctrl) = swisshash_alloc(groups,sizeof(ENTRY_TYPE*));
+	GLUE_HASH_TAB_PREFIX(groups) = groups;
+	GLUE_HASH_TAB_PREFIX(used) = 0;
+}
+
+static inline ENTRY_TYPE* GLUE_FN_NAME_PREFIX(_search)(uint8_t *ctrl,uint32_t groups,uint32_t hashval,HASH_ARGS_TYPE_LIST) {
+	ENTRY_TYPE *e;
+	uint32_t g,gmask,step,m;
+	uint8_t *cg;
+
+	gmask = groups-1;
+	g = hashval & gmask;
+	for (step=0 ; step<groups ; step++) {
+		cg = GLUE_FN_NAME_PREFIX(_group)(ctrl,g);
+		m = swisshash_match(cg,SWISSHASH_FULL(hashval));
+		while (m) {
+			e = GLUE_FN_NAME_PREFIX(_slots)(cg)[swisshash_firstbit(m)];
+			m &= m-1;
+#ifdef HASH_VALUE_FIELD
+			if (e->HASH_VALUE_FIELD==hashval && GLUE_FN_NAME_PREFIX(_cmp)(e,HASH_ARGS_LIST)) {
+#else
+			if (GLUE_FN_NAME_PREFIX(_cmp)(e,HASH_ARGS_LIST)) {
+#endif
+				return e;
+			}
+		}
+		if (swisshash_match(cg,SWISSHASH_EMPTY)) {
+			return NULL;
+		}
+		g = (g+step+1) & gmask;
+	}
+	return NULL;
+}
+
+static inline ENTRY_TYPE* GLUE_FN_NAME_PREFIX(_find_hashed)(uint32_t hashval,HASH_ARGS_TYPE_LIST) {
+	ENTRY_TYPE *e;
+
+	if (GLUE_HASH_TAB_PREFIX(groups)==0) {
+		return NULL;
+	}
+	if (GLUE_HASH_TAB_PREFIX(oldctrl)!=NULL) {
+		GLUE_FN_NAME_PREFIX(_hash_move)();
+	}
+	e = GLUE_FN_NAME_PREFIX(_search)(GLUE_HASH_TAB_PREFIX(ctrl),GLUE_HASH_TAB_PREFIX(groups),hashval,HASH_ARGS_LIST);
+	if (e==NULL && GLUE_HASH_TAB_PREFIX(oldctrl)!=NULL) {
+		e = GLUE_FN_NAME_PREFIX(_search)(GLUE_HASH_TAB_PREFIX(oldctrl),GLUE_HASH_TAB_PREFIX(oldgroups),hashval,HASH_ARGS_LIST);
+	}
+	return e;
+}
+
+static inline ENTRY_TYPE* GLUE_FN_NAME_PREFIX(_find)(HASH_ARGS_TYPE_LIST) {
+	return GLUE_FN_NAME_PREFIX(_find_hashed)(GLUE_FN_NAME_PREFIX(_hash)(HASH_ARGS_LIST),HASH_ARGS_LIST);
+}
+
+static inline uint8_t GLUE_FN_NAME_PREFIX(_remove)(uint8_t *ctrl,uint32_t groups,ENTRY_TYPE *e,uint32_t hashval) {
+	uint32_t g,gmask,step,m,pos;
+	uint8_t *cg;
+
+	gmask = groups-1;
+	g = hashval & gmask;
+	for (step=0 ; step<groups ; step++) {
+		cg = GLUE_FN_NAME_PREFIX(_group)(ctrl,g);
+		m = swisshash_match(cg,SWISSHASH_FULL(hashval));
+		while (m) {
+			pos = swisshash_firstbit(m);
+			m &= m-1;
+			if (GLUE_FN_NAME_PREFIX(_slots)(cg)[pos]==e) {
+				cg[pos] = SWISSHASH_DELETED;
+				return 1;
+			}
+		}
+		if (swisshash_match(cg,SWISSHASH_EMPTY)) {
+			return 0;
+		}
+		g = (g+step+1) & gmask;
+	}
+	return 0;
+}
+
+static inline uint8_t GLUE_FN_NAME_PREFIX(_delete)(ENTRY_TYPE *e) {
+	uint32_t hashval;
+
+	if (GLUE_HASH_TAB_PREFIX(groups)==0) {
+		return 0;
+	}
+	if (GLUE_HASH_TAB_PREFIX(oldctrl)!=NULL) {
+		GLUE_FN_NAME_PREFIX(_hash_move)();
+	}
+	hashval = SWISSHASH_EHASH(e);
+	if (GLUE_FN_NAME_PREFIX(_remove)(GLUE_HASH_TAB_PREFIX(ctrl),GLUE_HASH_TAB_PREFIX(groups),e,hashval) || (GLUE_HASH_TAB_PREFIX(oldctrl)!=NULL && GLUE_FN_NAME_PREFIX(_remove)(GLUE_HASH_TAB_PREFIX(oldctrl),GLUE_HASH_TAB_PREFIX(oldgroups),e,hashval))) {
+		GLUE_HASH_TAB_PREFIX(hashelem)--;
+		return 1;
+	}
+	return 0;
+}
+
+static inline void GLUE_FN_NAME_PREFIX(_add)(ENTRY_TYPE *e) {
+	if (GLUE_HASH_TAB_PREFIX(groups)==0) {
+		GLUE_HASH_TAB_PREFIX(groups) = GLUE_FN_NAME_PREFIX(_calc_groups)(GLUE_HASH_TAB_PREFIX(sizehint));
+		GLUE_HASH_TAB_PREFIX(ctrl) = swisshash_alloc(GLUE_HASH_TAB_PREFIX(groups),sizeof(ENTRY_TYPE*));
+		GLUE_HASH_TAB_PREFIX(used) = 0;
+	}
+	if (GLUE_HASH_TAB_PREFIX(oldctrl)!=NULL) {
+		GLUE_FN_NAME_PREFIX(_hash_move)();
+	}
+	if ((uint64_t)(GLUE_HASH_TAB_PREFIX(used)+1)*8 > (uint64_t)(GLUE_HASH_TAB_PREFIX(groups))*SWISSHASH_GROUP*7) {
+		GLUE_FN_NAME_PREFIX(_hash_grow)();
+	}
+	GLUE_FN_NAME_PREFIX(_insert)(GLUE_HASH_TAB_PREFIX(ctrl),GLUE_HASH_TAB_PREFIX(groups),e,SWISSHASH_EHASH(e));
+	GLUE_HASH_TAB_PREFIX(hashelem)++;
+}
@@ -0,0 +1,2 @@
+#undef SWISSHASH_EHASH
+#undef SWISSHASH_GROUPSIZE
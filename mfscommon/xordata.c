@@ -0,0 +1,331 @@
+/*
+ * Copyright (C) 2026 Jakub Kruszona-Zawadzki, Saglabs SA
+ * 
+ * This file is part of MooseFS.
+ * 
+ * MooseFS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 (only).
+ * 
+ * MooseFS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <inttypes.h>
+#include <string.h>
+#include "crc.h"
+#include "xordata.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#  define XORDATA_HAVE_X86 1
+#  include <cpuid.h>
+#  include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#  define XORDATA_HAVE_NEON 1
+#  include <arm_neon.h>
+#endif
+
+// piece of data xored and then checksummed in xordata_multi_crc (small enough to stay in L1/L2 cache)
+#define XORDATA_CRC_TILE 16384
+// max number of sources handled by xordata_multi_crc in tiles
+#define XORDATA_MAX_SOURCES 32
+
+/* generic - 64-bit words, loads and stores through memcpy, so any alignment is ok */
+
+static inline uint64_t xordata_load64(const uint8_t *p) {
+	uint64_t v;
+	memcpy(&v,p,8);
+	return v;
+}
+
+static inline void xordata_store64(uint8_t *p,uint64_t v) {
+	memcpy(p,&v,8);
+}
+
+static void xordata_multi_tail(uint8_t *dst,const uint8_t * const *src,uint8_t cnt,uint32_t pos,uint32_t leng) {
+	uint8_t i,b;
+
+	while (pos+8<=leng) {
+		uint64_t acc = xordata_load64(src[0]+pos);
+		for (i=1 ; i<cnt ; i++) {
+			acc ^= xordata_load64(src[i]+pos);
+		}
+		xordata_store64(dst+pos,acc);
+		pos += 8;
+	}
+	while (pos<leng) {
+		b = src[0][pos];
+		for (i=1 ; i<cnt ; i++) {
+			b ^= src[i][pos];
+		}
+		dst[pos] = b;
+		pos++;
+	}
+}
+
+static void xordata_multi_generic(uint8_t *dst,const uint8_t * const *src,uint8_t cnt,uint32_t leng) {
+	uint64_t a0,a1,a2,a3;
+	uint32_t pos;
+	uint8_t i;
+
+	for (pos=0 ; pos+32<=leng ; pos+=32) {
+		a0 = xordata_load64(src[0]+pos);
+		a1 = xordata_load64(src[0]+pos+8);
+		a2 = xordata_load64(src[0]+pos+16);
+		a3 = xordata_load64(src[0]+pos+24);
+		for (i=1 ; i<cnt ; i++) {
+			a0 ^= xordata_load64(src[i]+pos);
+			a1 ^= xordata_load64(src[i]+pos+8);
+			a2 ^= xordata_load64(src[i]+pos+16);
+			a3 ^= xordata_load64(src[i]+pos+24);
+		}
+		xordata_store64(dst+pos,a0);
+		xordata_store64(dst+pos+8,a1);
+		xordata_store64(dst+pos+16,a2);
+		xordata_store64(dst+pos+24,a3);
+	}
+	xordata_multi_tail(dst,src,cnt,pos,leng);
+}
+
+#ifdef XORDATA_HAVE_X86
+
+static __attribute__((target("avx2"))) void xordata_multi_avx2(uint8_t *dst,const uint8_t * const *src,uint8_t cnt,uint32_t leng) {
+	__m256i a0,a1,a2,a3;
+	uint32_t pos;
+	uint8_t i;
+
+	for (pos=0 ; pos+128<=leng ; pos+=128) {
+		a0 = _mm256_loadu_si256((const __m256i*)(src[0]+pos));
+		a1 = _mm256_loadu_si256((const __m256i*)(src[0]+pos+32));
+		a2 = _mm256_loadu_si256((const __m256i*)(src[0]+pos+64));
+		a3 = _mm256_loadu_si256((const __m256i*)(src[0]+pos+96));
+		for (i=1 ; i<cnt ; i++) {
+			a0 = _mm256_xor_si256(a0,_mm256_loadu_si256((const __m256i*)(src[i]+pos)));
+			a1 = _mm256_xor_si256(a1,_mm256_loadu_si256((const __m256i*)(src[i]+pos+32)));
+			a2 = _mm256_xor_si256(a2,_mm256_loadu_si256((const __m256i*)(src[i]+pos+64)));
+			a3 = _mm256_xor_si256(a3,_mm256_loadu_si256((const __m256i*)(src[i]+pos+96)));
+		}
+		_mm256_storeu_si256((__m256i*)(dst+pos),a0);
+		_mm256_storeu_si256((__m256i*)(dst+pos+32),a1);
+		_mm256_storeu_si256((__m256i*)(dst+pos+64),a2);
+		_mm256_storeu_si256((__m256i*)(dst+pos+96),a3);
+	}
+	xordata_multi_tail(dst,src,cnt,pos,leng);
+}
+
+static __attribute__((target("avx512f"))) void xordata_multi_avx512(uint8_t *dst,const uint8_t * const *src,uint8_t cnt,uint32_t leng) {
+	__m512i a0,a1,a2,a3;
+	uint32_t pos;
+	uint8_t i;
+
+	for (pos=0 ; pos+256<=leng ; pos+=256) {
+		a0 = _mm512_loadu_si512((const void*)(src[0]+pos));
+		a1 = _mm512_loadu_si512((const void*)(src[0]+pos+64));
+		a2 = _mm512_loadu_si512((const void*)(src[0]+pos+128));
+		a3 = _mm512_loadu_si512((const void*)(src[0]+pos+192));
+		for (i=1 ; i<cnt ; i++) {
+			a0 = _mm512_xor_si512(a0,_mm512_loadu_si512((const void*)(src[i]+pos)));
+			a1 = _mm512_xor_si512(a1,_mm512_loadu_si512((const void*)(src[i]+pos+64)));
+			a2 = _mm512_xor_si512(a2,_mm512_loadu_si512((const void*)(src[i]+pos+128)));
+			a3 = _mm512_xor_si512(a3,_mm512_loadu_si512((const void*)(src[i]+pos+192)));
+		}
+		_mm512_storeu_si512((void*)(dst+pos),a0);
+		_mm512_storeu_si512((void*)(dst+pos+64),a1);
+		_mm512_storeu_si512((void*)(dst+pos+128),a2);
+		_mm512_storeu_si512((void*)(dst+pos+192),a3);
+	}
+	xordata_multi_tail(dst,src,cnt,pos,leng);
+}
+
+// returns XCR0 or 0 when OS doesn't support XSAVE
+static uint32_t xordata_xcr0(void) {
+	unsigned int eax,ebx,ecx,edx;
+	unsigned int xcr0lo,xcr0hi;
+
+	if (__get_cpuid(1,&eax,&ebx,&ecx,&edx)==0) {
+		return 0;
+	}
+	if ((ecx & bit_OSXSAVE)==0 || (ecx & bit_AVX)==0) {
+		return 0;
+	}
+	__asm__ __volatile__ ("xgetbv" : "=a"(xcr0lo), "=d"(xcr0hi) : "c"(0));
+	return xcr0lo;
+}
+
+static uint8_t xordata_avx2_supported(void) {
+	unsigned int eax,ebx,ecx,edx;
+
+	if ((xordata_xcr0() & 6)!=6) { // OS doesn't save YMM registers
+		return 0;
+	}
+	if (__get_cpuid_max(0,NULL)<7) {
+		return 0;
+	}
+	__cpuid_count(7,0,eax,ebx,ecx,edx);
+	return (ebx & bit_AVX2)?1:0;
+}
+
+static uint8_t xordata_avx512_supported(void) {
+	unsigned int eax,ebx,ecx,edx;
+
+	if ((xordata_xcr0() & 0xE6)!=0xE6) { // OS doesn't save ZMM and opmask registers
+		return 0;
+	}
+	if (__get_cpuid_max(0,NULL)<7) {
+		return 0;
+	}
+	__cpuid_count(7,0,eax,ebx,ecx,edx);
+	return (ebx & bit_AVX512F)?1:0;
+}
+
+#endif
+
+#ifdef XORDATA_HAVE_NEON
+
+static void xordata_multi_neon(uint8_t *dst,const uint8_t * const *src,uint8_t cnt,uint32_t leng) {
+	uint8x16_t a0,a1,a2,a3;
+	uint32_t pos;
+	uint8_t i;
+
+	for (pos=0 ; pos+64<=leng ; pos+=64) {
+		a0 = vld1q_u8(src[0]+pos);
+		a1 = vld1q_u8(src[0]+pos+16);
+		a2 = vld1q_u8(src[0]+pos+32);
+		a3 = vld1q_u8(src[0]+pos+48);
+		for (i=1 ; i<cnt ; i++) {
+			a0 = veorq_u8(a0,vld1q_u8(src[i]+pos));
+			a1 = veorq_u8(a1,vld1q_u8(src[i]+pos+16));
+			a2 = veorq_u8(a2,vld1q_u8(src[i]+pos+32));
+			a3 = veorq_u8(a3,vld1q_u8(src[i]+pos+48));
+		}
+		vst1q_u8(dst+pos,a0);
+		vst1q_u8(dst+pos+16,a1);
+		vst1q_u8(dst+pos+32,a2);
+		vst1q_u8(dst+pos+48,a3);
+	}
+	xordata_multi_tail(dst,src,cnt,pos,leng);
+}
+
+#endif
+
+/* engine dispatch */
+
+typedef struct _xordata_engine {
+	const char *name;
+	void (*xormulti)(uint8_t *dst,const uint8_t * const *src,uint8_t cnt,uint32_t leng);
+	uint8_t (*supported)(void);
+} xordata_engine;
+
+static const xordata_engine xordata_engines[XORDATA_ENGINES] = {
+	{"generic",xordata_multi_generic,NULL},
+#ifdef XORDATA_HAVE_X86
+	{"avx2",xordata_multi_avx2,xordata_avx2_supported},
+	{"avx512",xordata_multi_avx512,xordata_avx512_supported},
+#else
+	{"avx2",NULL,NULL},
+	{"avx512",NULL,NULL},
+#endif
+#ifdef XORDATA_HAVE_NEON
+	{"neon",xordata_multi_neon,NULL},
+#else
+	{"neon",NULL,NULL},
+#endif
+};
+
+static uint8_t xordata_current_engine = XORDATA_ENGINE_GENERIC;
+
+uint8_t xordata_engine_supported(uint8_t engine) {
+	if (engine>=XORDATA_ENGINES || xordata_engines[engine].xormulti==NULL) {
+		return 0;
+	}
+	if (xordata_engines[engine].supported==NULL) {
+		return 1;
+	}
+	return xordata_engines[engine].supported();
+}
+
+uint8_t xordata_engine_select(uint8_t engine) {
+	if (xordata_engine_supported(engine)==0) {
+		return 0;
+	}
+	xordata_current_engine = engine;
+	return 1;
+}
+
+uint8_t xordata_engine_current(void) {
+	return xordata_current_engine;
+}
+
+const char* xordata_engine_name(uint8_t engine) {
+	if (engine>=XORDATA_ENGINES) {
+		return "unknown";
+	}
+	return xordata_engines[engine].name;
+}
+
+void xordata(uint8_t *dst,const uint8_t *src,uint32_t leng) {
+	const uint8_t *tsrc[2];
+
+	tsrc[0] = dst;
+	tsrc[1] = src;
+	xordata_engines[xordata_current_engine].xormulti(dst,tsrc,2,leng);
+}
+
+void xordata_multi(uint8_t *dst,const uint8_t * const *src,uint8_t cnt,uint32_t leng) {
+	if (cnt==0) {
+		memset(dst,0,leng);
+	} else if (cnt==1) {
+		if (dst!=src[0]) {
+			memcpy(dst,src[0],leng);
+		}
+	} else {
+		xordata_engines[xordata_current_engine].xormulti(dst,src,cnt,leng);
+	}
+}
+
+uint32_t xordata_multi_crc(uint32_t crc,uint8_t *dst,const uint8_t * const *src,uint8_t cnt,uint32_t leng) {
+	const uint8_t *tsrc[XORDATA_MAX_SOURCES];
+	uint32_t pos,tl;
+	uint8_t i;
+
+	if (cnt>XORDATA_MAX_SOURCES) {
+		xordata_multi(dst,src,cnt,leng);
+		return mycrc32(crc,dst,leng);
+	}
+	for (pos=0 ; pos<leng ; pos+=tl) {
+		tl = leng-pos;
+		if (tl>XORDATA_CRC_TILE) {
+			tl = XORDATA_CRC_TILE;
+		}
+		for (i=0 ; i<cnt ; i++) {
+			tsrc[i] = src[i]+pos;
+		}
+		xordata_multi(dst+pos,tsrc,cnt,tl);
+		crc = mycrc32(crc,dst+pos,tl);
+	}
+	return crc;
+}
+
+void xordata_init(void) {
+	uint8_t engine;
+
+	xordata_current_engine = XORDATA_ENGINE_GENERIC;
+	for (engine=XORDATA_ENGINE_GENERIC+1 ; engine<XORDATA_ENGINES ; engine++) {
+		if (xordata_engine_supported(engine)) {
+			xordata_current_engine = engine;
+		}
+	}
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2026 Jakub Kruszona-Zawadzki, Saglabs SA
+ * 
+ * This file is part of MooseFS.
+ * 
+ * MooseFS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 (only).
+ * 
+ * MooseFS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _XORDATA_H_
+#define _XORDATA_H_
+#include <inttypes.h>
+
+#define XORDATA_ENGINE_GENERIC 0
+#define XORDATA_ENGINE_AVX2 1
+#define XORDATA_ENGINE_AVX512 2
+#define XORDATA_ENGINE_NEON 3
+#define XORDATA_ENGINES 4
+
+// dst ^= src
+void xordata(uint8_t *dst,const uint8_t *src,uint32_t leng);
+// dst = src[0] ^ ... ^ src[cnt-1] (dst may be one of sources, zeros when cnt==0)
+void xordata_multi(uint8_t *dst,const uint8_t * const *src,uint8_t cnt,uint32_t leng);
+// as above, but also returns crc of result - calculated piece by piece while data is still in L1 cache
+uint32_t xordata_multi_crc(uint32_t crc,uint8_t *dst,const uint8_t * const *src,uint8_t cnt,uint32_t leng);
+
+uint8_t xordata_engine_supported(uint8_t engine);
+uint8_t xordata_engine_select(uint8_t engine);
+uint8_t xordata_engine_current(void);
+const char* xordata_engine_name(uint8_t engine);
+
+void xordata_init(void);
+
+#endif
@@ -29,6 +29,7 @@
 #include <fcntl.h>
 #include <poll.h>
 #include <errno.h>
+#include <string.h>
 #ifdef HAVE_WRITEV
 #include <sys/uio.h>
 #endif
@@ -44,11 +45,12 @@
 #include "mfsalloc.h"
 #include "processname.h"
 #include "clocks.h"
+#include "changelog.h"
 #include "errno.h"
 
 #define MAXLOGNUMBER 1000U
 
-enum {BGSAVER_ALIVE,BGSAVER_START,BGSAVER_WRITE,BGSAVER_FINISH,BGSAVER_DONE,BGSAVER_CHANGELOG,BGSAVER_CHANGELOG_ACK,BGSAVER_CHANGELOG_NACK,BGSAVER_ROTATELOG,BGSAVER_TERMINATE};
+enum {BGSAVER_ALIVE,BGSAVER_START,BGSAVER_WRITE,BGSAVER_FINISH,BGSAVER_DONE,BGSAVER_CHANGELOG,BGSAVER_CHANGELOG_ACK,BGSAVER_CHANGELOG_NACK,BGSAVER_ROTATELOG,BGSAVER_ROTATELOG_ACK,BGSAVER_TERMINATE};
 
 enum {FREE,DATA,KILL}; // bgsaverconn.mode
 
@@ -168,6 +170,7 @@ void bgsaver_worker(void) {
 	uint64_t woffset;
 	uint32_t wleng,wcrc;
 	uint32_t speedlimit;
+	char fname[256];
 	uint64_t bytes;
 	double starttime;
 	double last_alive_send;
@@ -188,6 +191,7 @@ void bgsaver_worker(void) {
 	bytes = 0;
 	starttime = 0.0;
 	speedlimit = 0;
+	strcpy(fname,"metadata_download.tmp");
 
 	logfd = -1;
 	chlogbuff = NULL;
@@ -260,18 +264,24 @@ void bgsaver_worker(void) {
 		}
 		switch (cmd) {
 			case BGSAVER_START:
-				if (leng!=4) {
+				if (leng<4 || leng>4+255) {
 					mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"background data writer - leng error (BGSAVER_START packet)");
 					status = 0;
 				} else {
 					rptr = buff;
 					speedlimit = get32bit(&rptr);
+					if (leng>4) { // file name given
+						memcpy(fname,rptr,leng-4);
+						fname[leng-4] = 0;
+					} else {
+						strcpy(fname,"metadata_download.tmp");
+					}
 					if (fd>=0) {
 						close(fd);
 					}
-					fd = open("metadata_download.tmp",O_WRONLY | O_TRUNC | O_CREAT,0666);
+					fd = open(fname,O_WRONLY | O_TRUNC | O_CREAT,0666);
 					if (fd<0) {
-						mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"background data writer - error opening 'metadata_download.tmp'");
+						mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"background data writer - error opening '%s'",fname);
 						status = 0;
 					} else {
 						bytes = 0;
@@ -299,7 +309,7 @@ void bgsaver_worker(void) {
 						ret = write(fd,rptr,wleng);
 #endif /* HAVE_PWRITE */
 						if (ret!=(ssize_t)wleng) {
-							mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"background data writer - error writing 'metadata_download.tmp'");
+							mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"background data writer - error writing '%s'",fname);
 							status = 0;
 						} else if (wcrc != mycrc32(0,rptr,wleng)) {
 							mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"background data writer - crc error (BGSAVER_WRITE packet)");
@@ -330,11 +340,11 @@ void bgsaver_worker(void) {
 				} else {
 					status = 1;
 					if (fsync(fd)<0) {
-						mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"background data writer - error syncing 'metadata_download.tmp'");
+						mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"background data writer - error syncing '%s'",fname);
 						status = 0;
 					}
 					if (close(fd)<0) {
-						mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"background data writer - error closing 'metadata_download.tmp'");
+						mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"background data writer - error closing '%s'",fname);
 						status = 0;
 					}
 					fd = -1;
@@ -437,7 +447,7 @@ void bgsaver_worker(void) {
 				if (fd>=0) {
 					mfs_log(MFSLOG_SYSLOG,MFSLOG_NOTICE,"background data writer - removing unfinished metadata file");
 					close(fd);
-					unlink("metadata_download.tmp");
+					unlink(fname);
 				}
 				goto err;
 				break; // just silent compiler warnings
@@ -447,7 +457,7 @@ void bgsaver_worker(void) {
 		}
 		if (cmd==BGSAVER_START || cmd==BGSAVER_WRITE || cmd==BGSAVER_FINISH) { // status required
 			if (status==0) {
-				unlink("metadata_download.tmp");
+				unlink(fname);
 			}
 			wptr = auxbuff;
 			put32bit(&wptr,BGSAVER_DONE);
@@ -464,6 +474,12 @@ void bgsaver_worker(void) {
 					put32bit(&wptr,timestamp);
 					writeall(eptr->status_pipe[PIPE_WRITE],auxbuff,12);
 				}
+				if (cmd==BGSAVER_ROTATELOG) {
+					wptr = auxbuff;
+					put32bit(&wptr,BGSAVER_ROTATELOG_ACK);
+					put32bit(&wptr,0);
+					writeall(eptr->status_pipe[PIPE_WRITE],auxbuff,8);
+				}
 				chloglostcnt = 0;
 			} else {
 				if (chloglostcnt==0) {
@@ -537,17 +553,26 @@ void bgsaver_cancel(void) {
 }
 
 
-void bgsaver_open(uint32_t speedlimit,void *ud,void (*donefn)(void*,int)) {
+void bgsaver_open(const char *fname,uint32_t speedlimit,void *ud,void (*donefn)(void*,int)) {
 	bgsaverconn *eptr = bgsaversingleton;
 	uint8_t *buff;
+	uint32_t fnleng;
 
 	if (eptr==NULL || eptr->mode!=DATA) {
 		donefn(ud,-1);
 		return;
 	}
 
-	buff = bgsaver_createpacket(eptr,BGSAVER_START,4);
+	fnleng = (fname!=NULL)?strlen(fname):0;
+	if (fnleng>255) {
+		donefn(ud,-1);
+		return;
+	}
+	buff = bgsaver_createpacket(eptr,BGSAVER_START,4+fnleng);
 	put32bit(&buff,speedlimit);
+	if (fnleng>0) {
+		memcpy(buff,fname,fnleng);
+	}
 	eptr->ud = ud;
 	eptr->donefn = donefn;
 }
@@ -587,10 +612,9 @@ void bgsaver_done(bgsaverconn *eptr,const uint8_t *data,uint32_t length) {
 	void *ud;
 	void (*donefn)(void*,int);
 
+	// requests can be pipelined, so 'donefn' stays registered until next request or cancel
 	ud = eptr->ud;
 	donefn = eptr->donefn;
-	eptr->donefn = NULL;
-	eptr->ud = NULL;
 
 	if (length!=1) {
 		mfs_log(MFSLOG_SYSLOG,MFSLOG_ERR,"mallformed packet from bgworker");
@@ -668,6 +692,16 @@ void bgsaver_changelog_nack(bgsaverconn *eptr,const uint8_t *data,uint32_t lengt
 	main_exit();
 }
 
+void bgsaver_rotatelog_ack(bgsaverconn *eptr,const uint8_t *data,uint32_t length) {
+	if (length!=0) {
+		mfs_log(MFSLOG_SYSLOG,MFSLOG_ERR,"mallformed packet from bgworker");
+		eptr->mode = KILL;
+		return;
+	}
+	(void)data;
+	changelog_bgrotated();
+}
+
 void bgsaver_alive(bgsaverconn *eptr,const uint8_t *data,uint32_t length) {
 	(void)eptr;
 	(void)data;
@@ -690,6 +724,9 @@ void bgsaver_gotpacket(bgsaverconn *eptr,uint32_t type,const uint8_t *data,uint3
 		case BGSAVER_CHANGELOG_NACK:
 			bgsaver_changelog_nack(eptr,data,length);
 			break;
+		case BGSAVER_ROTATELOG_ACK:
+			bgsaver_rotatelog_ack(eptr,data,length);
+			break;
 		case BGSAVER_ALIVE:
 			bgsaver_alive(eptr,data,length);
 			break;
@@ -958,6 +995,11 @@ void bgsaver_disconnection_check(void) {
 		eptr->outputhead = NULL;
 		eptr->outputtail = &(eptr->outputhead);
 		eptr->mode = FREE;
+		if (eptr->donefn!=NULL) {
+			eptr->donefn(eptr->ud,-1);
+			eptr->donefn = NULL;
+			eptr->ud = NULL;
+		}
 		if (terminating==0) {
 			mfs_log(MFSLOG_SYSLOG,MFSLOG_ERR,"connection with background data writer has been terminated - exiting");
 			main_exit();
@@ -23,7 +23,9 @@
 #include <inttypes.h>
 
 void bgsaver_cancel(void);
-void bgsaver_open(uint32_t speedlimit,void *ud,void (*donefn)(void*,int));
+// data writes - every request is confirmed by a separate call of 'donefn' (status: 1 - ok ; 0 or -1 - error)
+// fname==NULL means 'metadata_download.tmp'
+void bgsaver_open(const char *fname,uint32_t speedlimit,void *ud,void (*donefn)(void*,int));
 void bgsaver_store(const uint8_t *data,uint64_t offset,uint32_t leng,uint32_t crc,void *ud,void (*donefn)(void*,int));
 void bgsaver_close(void *ud,void (*donefn)(void*,int));
 void bgsaver_changelog(uint64_t version,const char *message);
@@ -33,11 +33,13 @@
 #include "massert.h"
 #include "sockets.h"
 #include "strerr.h"
+#include "mfslog.h"
 #include "crc.h"
 
 #define BIO_TYPE_FILE 0
 #define BIO_TYPE_SOCKET 1
 #define BIO_TYPE_NULL 2
+#define BIO_TYPE_FUNC 3
 
 struct _bio {
 	uint8_t *buff;
@@ -53,6 +55,26 @@ struct _bio {
 	uint8_t eof;
 	int lasterrno;
 	int fd;
+	int32_t (*writefn)(void *ud,const uint8_t *data,uint32_t leng,uint64_t offset);
+	void *ud;
+	// segments
+	bio_segment *segs;
+	uint32_t segcnt;
+	uint32_t segsize;
+	uint32_t segmax;
+	uint64_t segbase;
+	uint64_t segbytes;
+	uint64_t records;
+	uint8_t segactive;
+	uint8_t segopen;
+	uint8_t recmarks;
+	// checking segments during reading
+	const bio_segment *csegs;
+	uint32_t csegcnt;
+	uint32_t csegpos;
+	uint32_t cdone;
+	uint32_t ccrc;
+	uint8_t cignore;
 };
 
 bio* bio_null_open(uint8_t direction) {
@@ -72,6 +94,13 @@ bio* bio_null_open(uint8_t direction) {
 	b->eof = 0;
 	b->lasterrno = 0;
 	b->fd = -1;
+	b->segs = NULL;
+	b->segcnt = 0;
+	b->segmax = 0;
+	b->segactive = 0;
+	b->csegs = NULL;
+	b->csegcnt = 0;
+	b->csegpos = 0;
 	return b;
 }
 
@@ -104,6 +133,13 @@ bio* bio_file_open(const char *fname,uint8_t direction,uint32_t buffersize) {
 	b->eof = 0;
 	b->lasterrno = 0;
 	b->fd = fd;
+	b->segs = NULL;
+	b->segcnt = 0;
+	b->segmax = 0;
+	b->segactive = 0;
+	b->csegs = NULL;
+	b->csegcnt = 0;
+	b->csegpos = 0;
 	return b;
 }
 
@@ -125,6 +161,43 @@ bio* bio_socket_open(int socket,uint8_t direction,uint32_t buffersize,uint32_t m
 	b->eof = 0;
 	b->lasterrno = 0;
 	b->fd = socket;
+	b->segs = NULL;
+	b->segcnt = 0;
+	b->segmax = 0;
+	b->segactive = 0;
+	b->csegs = NULL;
+	b->csegcnt = 0;
+	b->csegpos = 0;
+	return b;
+}
+
+bio* bio_func_open(uint32_t buffersize,int32_t (*writefn)(void *ud,const uint8_t *data,uint32_t leng,uint64_t offset),void *ud) {
+	bio *b;
+	b = malloc(sizeof(bio));
+	passert(b);
+	b->buff = malloc(buffersize);
+	passert(b->buff);
+	b->size = buffersize;
+	b->leng = 0;
+	b->pos = 0;
+	b->msecto = 0;
+	b->fileposition = 0;
+	b->crc = 0;
+	b->direction = BIO_WRITE;
+	b->type = BIO_TYPE_FUNC;
+	b->error = 0;
+	b->eof = 0;
+	b->lasterrno = 0;
+	b->fd = -1;
+	b->writefn = writefn;
+	b->ud = ud;
+	b->segs = NULL;
+	b->segcnt = 0;
+	b->segmax = 0;
+	b->segactive = 0;
+	b->csegs = NULL;
+	b->csegcnt = 0;
+	b->csegpos = 0;
 	return b;
 }
 
@@ -132,6 +205,8 @@ static inline int32_t bio_internal_write(bio *b,const uint8_t *buff,uint32_t len
 	int32_t ret;
 	if (b->type==BIO_TYPE_FILE) {
 		ret = write(b->fd,buff,leng);
+	} else if (b->type==BIO_TYPE_FUNC) {
+		ret = b->writefn(b->ud,buff,leng,b->fileposition);
 	} else if (b->type==BIO_TYPE_SOCKET) {
 		ret = tcptowrite(b->fd,buff,leng,b->msecto,30*b->msecto);
 //		if ((int32_t)leng!=ret) {
@@ -153,6 +228,53 @@ static inline int32_t bio_internal_write(bio *b,const uint8_t *buff,uint32_t len
 	return ret;
 }
 
+// checks crc of segments covered by data read from 'offset' ; returns -1 when damaged segment has to stop reading
+static int bio_check_data(bio *b,const uint8_t *data,uint32_t leng,uint64_t offset) {
+	const bio_segment *s;
+	uint64_t d;
+	uint32_t l;
+	int ret;
+
+	ret = 0;
+	while (leng>0 && b->csegpos<b->csegcnt) {
+		s = b->csegs + b->csegpos;
+		if (offset+leng<=s->offset+b->cdone) {
+			break;
+		}
+		if (offset>s->offset+b->cdone) { // part of segment has been skipped - can't be checked
+			b->csegpos++;
+			b->cdone = 0;
+			b->ccrc = 0;
+			continue;
+		}
+		d = s->offset+b->cdone-offset;
+		data += d;
+		offset += d;
+		leng -= d;
+		l = s->length-b->cdone;
+		if (l>leng) {
+			l = leng;
+		}
+		b->ccrc = mycrc32(b->ccrc,data,l);
+		b->cdone += l;
+		data += l;
+		offset += l;
+		leng -= l;
+		if (b->cdone==s->length) {
+			if (b->ccrc!=s->crc) {
+				mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"metadata segment (offset: %"PRIu64", length: %"PRIu32") - crc error",s->offset,s->length);
+				if (b->cignore==0) {
+					ret = -1;
+				}
+			}
+			b->csegpos++;
+			b->cdone = 0;
+			b->ccrc = 0;
+		}
+	}
+	return ret;
+}
+
 static inline int32_t bio_internal_read(bio *b,uint8_t *buff,uint32_t leng) {
 	int32_t ret;
 	if (b->type==BIO_TYPE_FILE) {
@@ -174,6 +296,12 @@ static inline int32_t bio_internal_read(bio *b,uint8_t *buff,uint32_t leng) {
 	} else if (ret==0) {
 		b->eof = 1;
 	}
+	if (ret>0 && b->csegpos<b->csegcnt && bio_check_data(b,buff,ret,b->fileposition)<0) {
+		b->fileposition += ret;
+		b->lasterrno = EIO;
+		b->error = 1;
+		return 0;
+	}
 	b->fileposition += ret;
 	return ret;
 }
@@ -211,7 +339,7 @@ static inline int bio_fill(bio *b) {
 }
 
 uint64_t bio_file_position(bio *b) {
-	if (b->type!=BIO_TYPE_FILE) {
+	if (b->type!=BIO_TYPE_FILE && b->type!=BIO_TYPE_FUNC) {
 		return 0;
 	}
 	if (b->direction==BIO_WRITE) {
@@ -306,6 +434,118 @@ int64_t bio_read(bio *b,void *vdst,uint64_t len) {
 	}
 }
 
+static inline bio_segment* bio_segment_open(bio *b) {
+	if (b->segcnt>=b->segmax) {
+		b->segmax = (b->segmax==0)?64:(b->segmax*2);
+		b->segs = realloc(b->segs,sizeof(bio_segment)*b->segmax);
+		passert(b->segs);
+	}
+	b->segs[b->segcnt].offset = b->segbase+b->segbytes;
+	b->segs[b->segcnt].length = 0;
+	b->segs[b->segcnt].records = 0;
+	b->segs[b->segcnt].crc = 0;
+	b->segcnt++;
+	b->segopen = 1;
+	return b->segs+(b->segcnt-1);
+}
+
+static inline void bio_segment_write(bio *b,const uint8_t *src,uint64_t len) {
+	bio_segment *s;
+	uint64_t l;
+
+	while (len>0) {
+		if (b->segopen==0 || (b->recmarks==0 && b->segs[b->segcnt-1].length>=b->segsize)) {
+			s = bio_segment_open(b);
+		} else {
+			s = b->segs+(b->segcnt-1);
+		}
+		if (b->recmarks==0) { // data without record marks - segment can be closed anywhere
+			l = b->segsize-s->length;
+		} else {
+			l = 0x40000000;
+		}
+		if (l>len) {
+			l = len;
+		}
+		s->crc = mycrc32(s->crc,src,l);
+		s->length += l;
+		b->segbytes += l;
+		src += l;
+		len -= l;
+	}
+}
+
+void bio_segments_begin(bio *b,uint32_t segsize) {
+	if (b->direction!=BIO_WRITE) {
+		return;
+	}
+	b->segsize = (segsize>0x40000000)?0x40000000:(segsize>0)?segsize:1;
+	b->segcnt = 0;
+	b->segbase = bio_file_position(b);
+	b->segbytes = 0;
+	b->records = 0;
+	b->recmarks = 0;
+	b->segopen = 0;
+	b->segactive = 1;
+}
+
+void bio_record_end(bio *b) {
+	bio_records_end(b,1);
+}
+
+void bio_records_end(bio *b,uint32_t records) {
+	bio_segment *s;
+	uint32_t i;
+
+	if (b->segactive==0) {
+		return;
+	}
+	if (b->recmarks==0) { // first record - everything written so far belongs to it, so join segments
+		b->recmarks = 1;
+		for (i=1 ; i<b->segcnt ; i++) {
+			b->segs[0].crc = mycrc32_combine(b->segs[0].crc,b->segs[i].crc,b->segs[i].length);
+			b->segs[0].length += b->segs[i].length;
+		}
+		if (b->segcnt>1) {
+			b->segcnt = 1;
+		}
+	}
+	if (b->segopen==0) {
+		s = bio_segment_open(b);
+	} else {
+		s = b->segs+(b->segcnt-1);
+	}
+	s->records += records;
+	b->records += records;
+	if (s->length>=b->segsize) {
+		b->segopen = 0;
+	}
+}
+
+void bio_check_segments(bio *b,const bio_segment *segs,uint32_t segcnt,uint8_t ignore) {
+	if (b->direction!=BIO_READ) {
+		return;
+	}
+	b->csegs = segs;
+	b->csegcnt = segcnt;
+	b->csegpos = 0;
+	b->cdone = 0;
+	b->ccrc = 0;
+	b->cignore = ignore;
+}
+
+uint32_t bio_segments_end(bio *b,bio_segment **segs,uint64_t *records) {
+	if (b->segactive==0) {
+		*segs = NULL;
+		*records = 0;
+		return 0;
+	}
+	b->segactive = 0;
+	*segs = b->segs;
+	*records = b->records;
+	return b->segcnt;
+}
+
 int64_t bio_write(bio *b,const void *vsrc,uint64_t len) {
 	int64_t ret,i;
 	const uint8_t *src = (const uint8_t*)vsrc;
@@ -313,6 +553,9 @@ int64_t bio_write(bio *b,const void *vsrc,uint64_t len) {
 		return -1;
 	}
 	b->crc ^= mycrc32(0,src,len);
+	if (b->segactive) {
+		bio_segment_write(b,src,len);
+	}
 	if (b->type==BIO_TYPE_NULL) { // bio_null - just calculate crc
 		return len;
 	}
@@ -364,6 +607,13 @@ int64_t bio_write(bio *b,const void *vsrc,uint64_t len) {
 
 int8_t bio_seek(bio *b,int64_t offset,int whence) {
 	int64_t p;
+	if (b->type==BIO_TYPE_FUNC) { // only absolute positioning of written data
+		if (whence!=SEEK_SET || bio_flush(b)<0) {
+			return -1;
+		}
+		b->fileposition = offset;
+		return 0;
+	}
 	if (b->type!=BIO_TYPE_FILE) {
 		return -1;
 	}
@@ -462,5 +712,8 @@ void bio_close(bio *b) {
 	if (b->buff!=NULL) {
 		free(b->buff);
 	}
+	if (b->segs!=NULL) {
+		free(b->segs);
+	}
 	free(b);
 }
@@ -26,9 +26,18 @@ typedef struct _bio bio;
 
 enum {BIO_READ,BIO_WRITE};
 
+typedef struct _bio_segment {
+	uint64_t offset;
+	uint32_t length;
+	uint32_t records;
+	uint32_t crc;
+} bio_segment;
+
 bio* bio_null_open(uint8_t direction);
 bio* bio_file_open(const char *fname,uint8_t direction,uint32_t buffersize);
 bio* bio_socket_open(int socket,uint8_t direction,uint32_t buffersize,uint32_t msecto);
+// write only bio - buffered data is passed to 'writefn' together with its position in the stream (bio_seek moves this position)
+bio* bio_func_open(uint32_t buffersize,int32_t (*writefn)(void *ud,const uint8_t *data,uint32_t leng,uint64_t offset),void *ud);
 uint64_t bio_file_position(bio *b);
 uint64_t bio_file_size(bio *b);
 uint32_t bio_crc(bio *b);
@@ -45,5 +54,16 @@ int bio_descriptor(bio *b);
 void bio_sync(bio *b);
 void bio_close(bio *b);
 
+// splitting written data into segments with own crc - after first bio_record_end segments are closed only at record ends
+// (when they have at least 'segsize' bytes) ; array returned by bio_segments_end is valid until next bio_segments_begin
+void bio_segments_begin(bio *b,uint32_t segsize);
+void bio_record_end(bio *b);
+void bio_records_end(bio *b,uint32_t records); // as above, but for data containing 'records' whole records
+uint32_t bio_segments_end(bio *b,bio_segment **segs,uint64_t *records);
+
+// checking data during reading - crc of segments (sorted by offset, array has to be valid until reading ends) is checked when
+// the whole segment has been read from file (skipped segments are not checked) ; damaged segment causes read error (EIO) unless 'ignore' is set
+void bio_check_segments(bio *b,const bio_segment *segs,uint32_t segcnt,uint8_t ignore);
+
 
 #endif
@@ -30,6 +30,7 @@
 #include <sys/stat.h>
 
 #include "changelog.h"
+#include "chlogbin.h"
 #include "metadata.h"
 #include "massert.h"
 #include "bgsaver.h"
@@ -42,7 +43,18 @@
 #define MAXLOGLINESIZE 200000U
 #define MAXLOGNUMBER 1000U
 static uint32_t BackLogsNumber;
-static FILE *currentfd;
+static int currentfd;
+static uint8_t currentbinary;
+
+// changes are collected here and written (and synced) once per main loop iteration
+static chlogbin_buff pending = {NULL,0,0,0};
+static uint64_t pendingfirst,pendinglast;
+static uint64_t stats_writes,stats_changes;
+
+// changelog.0.mfs belongs to background writer until it confirms all requested rotations (lines sent to it may be still waiting)
+static uint8_t bgwritten; // lines sent since last rotation request
+static uint32_t bgrotations; // rotations not confirmed yet
+static uint8_t bgrotatewait; // changes are kept in memory until background writer is done
 
 
 #define OLD_CHANGES_BLOCK_SIZE 5000
@@ -72,6 +84,7 @@ static uint32_t ChangelogSecondsToRemember;
 static uint64_t ChangeLogMaxSize;
 
 static uint8_t ChangelogSaveMode;
+static uint8_t ChangelogBinary;
 
 #define SAVEMODE_BACKGROUND 0
 #define SAVEMODE_ASYNC 1
@@ -182,24 +195,31 @@ uint64_t changelog_get_minversion(void) {
 	return old_changes_head->minversion;
 }
 
+static void changelog_bgwait_end(void);
+
 void changelog_rotate(uint8_t rotate_flags) {
-	if (ChangelogSaveMode!=SAVEMODE_BACKGROUND) {
+	if (ChangelogSaveMode!=SAVEMODE_BACKGROUND && bgwritten==0 && bgrotations==0) {
 		rotate_flags |= ROTATE_FLAG_FOREGROUND;
 	}
 	if ((rotate_flags&ROTATE_FLAG_FOREGROUND)==0) { // try to rotate in background
 		if (bgsaver_rotatelog()<0) { // in case of error - switch to foreground
 			rotate_flags |= ROTATE_FLAG_FOREGROUND;
+		} else {
+			bgwritten = 0;
+			bgrotations++;
 		}
 	}
 	if (rotate_flags&ROTATE_FLAG_FOREGROUND) {
 		char logname1[100],logname2[100];
 		uint32_t i;
-		if (currentfd) {
+		changelog_bgwait_end(); // background writer is not used here - it either doesn't work or has been already terminated
+		changelog_flush();
+		if (currentfd>=0) {
 			if (ChangelogSaveMode==SAVEMODE_SYNC) {
-				fsync(fileno(currentfd));
+				fsync(currentfd);
 			}
-			fclose(currentfd);
-			currentfd=NULL;
+			close(currentfd);
+			currentfd=-1;
 		}
 		if (BackLogsNumber>0) {
 			for (i=BackLogsNumber ; i>0 ; i--) {
@@ -216,48 +236,182 @@ void changelog_rotate(uint8_t rotate_flags) {
 	}
 }
 
-void changelog_mr(uint64_t version,const char *data) {
-	if (ChangelogSaveMode==SAVEMODE_BACKGROUND) {
-		bgsaver_changelog(version,data);
-	} else {
-		if (currentfd==NULL) {
-			currentfd = fopen("changelog.0.mfs","a");
-			if (!currentfd) {
-				mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"lost MFS change %"PRIu64": %s",version,data);
+static void changelog_open(void) {
+	struct stat st;
+	uint64_t vleng;
+	uint8_t binary;
+
+	currentfd = open("changelog.0.mfs",O_RDWR | O_CREAT | O_APPEND,0666);
+	if (currentfd<0) {
+		return;
+	}
+	binary = (pending.leng>0)?currentbinary:ChangelogBinary; // changes kept during background rotation are already encoded
+	currentbinary = 0;
+	if (fstat(currentfd,&st)<0 || st.st_size==0) {
+		if (binary) {
+			if (write(currentfd,CHLOGBIN_MAGIC,CHLOGBIN_MAGIC_SIZE)!=CHLOGBIN_MAGIC_SIZE) {
+				close(currentfd);
+				currentfd = -1;
+				return;
 			}
+			currentbinary = 1;
 		}
+	} else if (chlogbin_check_magic(currentfd)) { // existing file is always continued in its own format
+		vleng = chlogbin_validlength(currentfd);
+		if (vleng<(uint64_t)(st.st_size)) {
+			mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"changelog.0.mfs: damaged data found at the end of file - truncating (%"PRIu64"->%"PRIu64")",(uint64_t)(st.st_size),vleng);
+			if (ftruncate(currentfd,vleng)<0) {
+				mfs_log(MFSLOG_ERRNO_SYSLOG,MFSLOG_WARNING,"changelog.0.mfs: truncate error");
+				close(currentfd);
+				currentfd = -1;
+				return;
+			}
+		}
+		currentbinary = 1;
+	}
+	if (currentbinary!=binary && pending.leng>0) { // should never happen - file created by someone else
+		mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"changelog.0.mfs: unexpected file format - lost MFS changes %"PRIu64"-%"PRIu64,pendingfirst,pendinglast);
+		pending.leng = 0;
+	}
+	if (currentbinary && pending.leng==0) {
+		chlogbin_newsession();
+	}
+}
 
-		if (currentfd) {
-			fprintf(currentfd,"%"PRIu64": %s\n",version,data);
-			fflush(currentfd);
-			if (ChangelogSaveMode==SAVEMODE_SYNC) {
-				fsync(fileno(currentfd));
+static void changelog_bgwait_end(void) {
+	bgwritten = 0;
+	bgrotations = 0;
+	if (bgrotatewait) {
+		bgrotatewait = 0;
+		if (currentfd<0) {
+			changelog_open();
+		}
+		changelog_flush();
+	}
+}
+
+// called when background writer confirms log rotation
+void changelog_bgrotated(void) {
+	if (bgrotations>0) {
+		bgrotations--;
+	}
+	if (bgrotations==0 && bgwritten==0) {
+		changelog_bgwait_end();
+	}
+}
+
+static inline void changelog_append_text(uint64_t version,const char *data,uint32_t leng) {
+	uint32_t l;
+
+	if (pending.leng+leng+30>pending.size) {
+		pending.size = ((pending.leng+leng+30)*3)/2+1024;
+		pending.data = realloc(pending.data,pending.size);
+		passert(pending.data);
+	}
+	l = snprintf((char*)(pending.data+pending.leng),pending.size-pending.leng,"%"PRIu64": ",version);
+	pending.leng += l;
+	memcpy(pending.data+pending.leng,data,leng);
+	pending.leng += leng;
+	pending.data[pending.leng++] = '\n';
+}
+
+// 'format' and 'ap' are optional - without them change is stored as text also in binary changelog
+static void changelog_append(uint64_t version,const char *data,uint32_t leng,const char *format,va_list *ap) {
+	if (ChangelogSaveMode==SAVEMODE_BACKGROUND && bgrotatewait==0) {
+		if (currentfd>=0) { // save mode has been changed - background writer appends text lines, so it has to start with a new file (current one may be binary)
+			changelog_flush();
+			fsync(currentfd);
+			close(currentfd);
+			currentfd = -1;
+			changelog_rotate(0);
+		}
+		bgsaver_changelog(version,data);
+		bgwritten = 1;
+		return;
+	}
+	if (currentfd<0 && bgrotatewait==0 && (bgwritten || bgrotations>0)) { // save mode has been changed - file can't be opened before background writer stores its lines and rotates log
+		bgrotatewait = 1;
+		if (bgwritten) {
+			changelog_rotate(0);
+		}
+		if (bgrotatewait) {
+			currentbinary = ChangelogBinary;
+			if (currentbinary) {
+				chlogbin_newsession();
 			}
 		}
 	}
+	if (currentfd<0 && bgrotatewait==0) {
+		changelog_open();
+		if (currentfd<0) {
+			mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"lost MFS change %"PRIu64": %s",version,data);
+			return;
+		}
+	}
+	if (pending.leng==0) {
+		pendingfirst = version;
+	}
+	pendinglast = version;
+	if (currentbinary) {
+		chlogbin_add(&pending,version,data,leng,format,ap);
+	} else {
+		changelog_append_text(version,data,leng);
+	}
+	stats_changes++;
+}
+
+// group commit - all changes made since last call are written using one write (and one fsync in sync mode)
+// must be called before any packet that depends on these changes is sent (replies to clients, commands to chunkservers, changes sent to metaloggers) - it is done in matoclserv/matocsserv/matomlserv write functions
+// exception: just after switching from background mode changes are kept in memory until background writer rotates log (the same guarantee as in background mode)
+void changelog_flush(void) {
+	if (pending.leng==0 || bgrotatewait) {
+		return;
+	}
+	if (currentbinary) {
+		chlogbin_seal(&pending);
+	}
+	if (currentfd<0 || write(currentfd,pending.data,pending.leng)!=(ssize_t)(pending.leng)) {
+		mfs_log(MFSLOG_ERRNO_SYSLOG,MFSLOG_WARNING,"error writing changelog - lost MFS changes %"PRIu64"-%"PRIu64,pendingfirst,pendinglast);
+		if (currentfd>=0) { // reopen file - damaged tail will be truncated
+			close(currentfd);
+			currentfd = -1;
+		}
+	} else if (ChangelogSaveMode==SAVEMODE_SYNC) {
+		fsync(currentfd);
+	}
+	stats_writes++;
+	pending.leng = 0;
+}
+
+void changelog_mr(uint64_t version,const char *data) {
+	changelog_append(version,data,strlen(data),NULL,NULL);
 }
 
 void changelog(const char *format,...) {
 	static char printbuff[MAXLOGLINESIZE];
-	va_list ap;
+	va_list ap,aq;
 	uint32_t leng;
 	uint64_t version;
-
+	uint8_t truncated;
 
 	va_start(ap,format);
+	va_copy(aq,ap);
 	leng = vsnprintf(printbuff,MAXLOGLINESIZE,format,ap);
 	va_end(ap);
 	if (leng>=MAXLOGLINESIZE) {
 		printbuff[MAXLOGLINESIZE-1]='\0';
 		leng=MAXLOGLINESIZE;
+		truncated = 1;
 	} else {
 		leng++;
+		truncated = 0;
 	}
 
 
 	version = meta_version_inc();
 
-	changelog_mr(version,printbuff);
+	changelog_append(version,printbuff,leng-1,truncated?NULL:format,&aq);
+	va_end(aq);
 	changelog_store_logstring(version,(uint8_t*)printbuff,leng);
 	lastchange = monotonic_seconds();
 }
@@ -363,6 +517,11 @@ void changelog_info(FILE *fd) {
 	} else {
 		fprintf(fd,"min_changelog_kept_for_delayed_receivers: -\n");
 	}
+	if (ChangelogSaveMode!=SAVEMODE_BACKGROUND) {
+		fprintf(fd,"changelog_format: %s\n",(currentfd<0)?"-":currentbinary?"binary":"text");
+		fprintf(fd,"changes_written: %"PRIu64"\n",stats_changes);
+		fprintf(fd,"group_commits: %"PRIu64"\n",stats_writes);
+	}
 	fprintf(fd,"\n");
 }
 
@@ -394,6 +553,24 @@ void changelog_reload(void) {
 		mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"CHANGELOG_SAVE_MODE - wrong value - using 0 (write in background)");
 		ChangelogSaveMode = SAVEMODE_BACKGROUND;
 	}
+	ChangelogBinary = cfg_getuint8("CHANGELOG_BINARY",0)?1:0;
+}
+
+void changelog_term(void) {
+	changelog_bgwait_end(); // background writer has been already terminated
+	changelog_flush();
+	if (currentfd>=0) {
+		if (ChangelogSaveMode==SAVEMODE_SYNC) {
+			fsync(currentfd);
+		}
+		close(currentfd);
+		currentfd = -1;
+	}
+	if (pending.data!=NULL) {
+		free(pending.data);
+		pending.data = NULL;
+		pending.size = 0;
+	}
 }
 
 int changelog_init(void) {
@@ -401,7 +578,9 @@ int changelog_init(void) {
 	main_time_register(1,0,changelog_sendnop);
 	main_reload_register(changelog_reload);
 	main_info_register(changelog_info);
-	currentfd = NULL;
+	main_eachloop_register(changelog_flush);
+	main_destruct_register(changelog_term);
+	currentfd = -1;
 	return 0;
 }
 
@@ -415,6 +594,12 @@ uint64_t changelog_findfirstversion(const char *fname) {
 	if (fd<0) {
 		return 0;
 	}
+	if (chlogbin_check_magic(fd)) {
+		fv = chlogbin_findfirstversion(fd);
+		close(fd);
+		return fv;
+	}
+	lseek(fd,0,SEEK_SET);
 	s = read(fd,buff,50);
 	close(fd);
 	if (s<=0) {
@@ -445,6 +630,11 @@ uint64_t changelog_findlastversion(const char *fname) {
 	if (fd<0) {
 		return 0;
 	}
+	if (chlogbin_check_magic(fd)) {
+		lv = chlogbin_findlastversion(fd);
+		close(fd);
+		return lv;
+	}
 	fstat(fd,&st);
 	size = st.st_size;
 	memset(buff,0,32);
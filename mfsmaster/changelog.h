@@ -37,7 +37,9 @@ uint64_t changelog_get_minversion(void);
 #define ROTATE_FLAG_FOREGROUND 2
 
 void changelog_rotate(uint8_t rotate_flags);
+void changelog_bgrotated(void);
 void changelog_mr(uint64_t version,const char *data);
+void changelog_flush(void);
 
 void changelog(const char *format,...) PRINTF_LIKE(1, 2);
 
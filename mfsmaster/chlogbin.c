@@ -0,0 +1,742 @@
+/*
+ * Copyright (C) 2026 Jakub Kruszona-Zawadzki, Saglabs SA
+ * 
+ * This file is part of MooseFS.
+ * 
+ * MooseFS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 (only).
+ * 
+ * MooseFS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "chlogbin.h"
+#include "datapack.h"
+#include "crc.h"
+#include "massert.h"
+
+#define KIND_RESET 0
+#define KIND_TEMPLATE 1
+#define KIND_TEXT 2
+#define CHLOGBIN_FIRSTID 3
+
+enum {ARG_INT,ARG_UINT,ARG_SHORT,ARG_USHORT,ARG_SCHAR,ARG_UCHAR,ARG_LONG,ARG_ULONG,ARG_LLONG,ARG_ULLONG,ARG_SIZE,ARG_CHAR,ARG_STR};
+
+#define LMOD_NONE 0
+#define LMOD_HH 1
+#define LMOD_H 2
+#define LMOD_L 3
+#define LMOD_LL 4
+#define LMOD_Z 5
+
+// parses conversion specification starting at 'f' (just after '%')
+// returns its length (without '%') or 0 for conversions that can't be encoded
+static uint32_t chlogbin_parse_spec(const char *f,uint8_t *lmod,char *conv) {
+	const char *p = f;
+
+	while (*p=='-' || *p=='+' || *p==' ' || *p=='#' || *p=='0') {
+		p++;
+	}
+	while (*p>='0' && *p<='9') {
+		p++;
+	}
+	if (*p=='.') {
+		p++;
+		while (*p>='0' && *p<='9') {
+			p++;
+		}
+	}
+	*lmod = LMOD_NONE;
+	if (p[0]=='h' && p[1]=='h') {
+		*lmod = LMOD_HH;
+		p+=2;
+	} else if (p[0]=='h') {
+		*lmod = LMOD_H;
+		p++;
+	} else if ((p[0]=='l' && p[1]=='l') || p[0]=='q') {
+		*lmod = LMOD_LL;
+		p+=(p[0]=='q')?1:2;
+	} else if (p[0]=='l') {
+		*lmod = LMOD_L;
+		p++;
+	} else if (p[0]=='z') {
+		*lmod = LMOD_Z;
+		p++;
+	}
+	switch (*p) {
+		case 'd':
+		case 'i':
+			if (*lmod==LMOD_Z) {
+				return 0;
+			}
+			break;
+		case 'o':
+		case 'u':
+		case 'x':
+		case 'X':
+			break;
+		case 'c':
+		case 's':
+		case '%':
+			if (*lmod!=LMOD_NONE) {
+				return 0;
+			}
+			break;
+		default:
+			return 0;
+	}
+	*conv = *p;
+	return (p-f)+1;
+}
+
+static inline void chlogbin_reserve(chlogbin_buff *b,uint32_t need) {
+	if (b->leng+need>b->size) {
+		b->size = ((b->leng+need)*3)/2+1024;
+		b->data = realloc(b->data,b->size);
+		passert(b->data);
+	}
+}
+
+static inline void chlogbin_putvarint(chlogbin_buff *b,uint64_t v) {
+	uint8_t *ptr;
+
+	chlogbin_reserve(b,10);
+	ptr = b->data + b->leng;
+	while (v>=0x80) {
+		*ptr++ = (v&0x7F)|0x80;
+		v >>= 7;
+	}
+	*ptr++ = v;
+	b->leng = ptr - b->data;
+}
+
+static inline void chlogbin_putbytes(chlogbin_buff *b,const void *data,uint32_t leng) {
+	chlogbin_reserve(b,leng);
+	memcpy(b->data+b->leng,data,leng);
+	b->leng += leng;
+}
+
+static inline void chlogbin_putsigned(chlogbin_buff *b,int64_t v) {
+	chlogbin_putvarint(b,((uint64_t)v<<1)^(uint64_t)(v>>63));
+}
+
+/* writer */
+
+#define TMPL_HASHSIZE 1024
+#define TMPL_MAXARGS 32
+
+typedef struct _tmplentry {
+	const char *format;
+	uint32_t session;
+	uint32_t id;
+	uint8_t textonly;
+	uint8_t argc;
+	uint8_t argt[TMPL_MAXARGS];
+} tmplentry;
+
+static tmplentry tmpltab[TMPL_HASHSIZE];
+static uint32_t cursession = 1;
+static uint32_t nextid = CHLOGBIN_FIRSTID;
+static uint8_t needreset = 1;
+
+static void chlogbin_template_parse(tmplentry *t,const char *format) {
+	const char *p;
+	uint32_t sl;
+	uint8_t lmod,at;
+	char conv;
+
+	t->format = format;
+	t->session = 0;
+	t->id = 0;
+	t->textonly = 0;
+	t->argc = 0;
+	for (p=format ; *p ; p++) {
+		if (*p!='%') {
+			continue;
+		}
+		sl = chlogbin_parse_spec(p+1,&lmod,&conv);
+		if (sl==0 || t->argc>=TMPL_MAXARGS) {
+			t->textonly = 1;
+			return;
+		}
+		p += sl;
+		if (conv=='%') {
+			continue;
+		}
+		if (conv=='c') {
+			at = ARG_CHAR;
+		} else if (conv=='s') {
+			at = ARG_STR;
+		} else if (conv=='d' || conv=='i') {
+			at = (lmod==LMOD_HH)?ARG_SCHAR:(lmod==LMOD_H)?ARG_SHORT:(lmod==LMOD_L)?ARG_LONG:(lmod==LMOD_LL)?ARG_LLONG:ARG_INT;
+		} else {
+			at = (lmod==LMOD_HH)?ARG_UCHAR:(lmod==LMOD_H)?ARG_USHORT:(lmod==LMOD_L)?ARG_ULONG:(lmod==LMOD_LL)?ARG_ULLONG:(lmod==LMOD_Z)?ARG_SIZE:ARG_UINT;
+		}
+		t->argt[t->argc++] = at;
+	}
+}
+
+static inline tmplentry* chlogbin_template_find(const char *format) {
+	uint32_t h,i;
+	tmplentry *t;
+
+	h = ((uintptr_t)format)*0x9E3779B1U;
+	h >>= 22;
+	for (i=0 ; i<TMPL_HASHSIZE ; i++) {
+		t = tmpltab + ((h+i)%TMPL_HASHSIZE);
+		if (t->format==format) {
+			return t->textonly?NULL:t;
+		}
+		if (t->format==NULL) {
+			chlogbin_template_parse(t,format);
+			return t->textonly?NULL:t;
+		}
+	}
+	return NULL;
+}
+
+// templates are defined in file only once per writer session, so new session has to be started for each newly opened file
+void chlogbin_newsession(void) {
+	cursession++;
+	nextid = CHLOGBIN_FIRSTID;
+	needreset = 1;
+}
+
+void chlogbin_add(chlogbin_buff *b,uint64_t version,const char *text,uint32_t textleng,const char *format,va_list *ap) {
+	tmplentry *t;
+	uint8_t *ptr;
+	uint32_t i,l;
+	const char *s;
+
+	if (b->leng==0) {
+		chlogbin_reserve(b,CHLOGBIN_BLOCK_HEADER);
+		memset(b->data,0,CHLOGBIN_BLOCK_HEADER);
+		ptr = b->data+8;
+		put64bit(&ptr,version);
+		b->leng = CHLOGBIN_BLOCK_HEADER;
+		b->lastversion = version;
+	}
+	if (needreset) {
+		chlogbin_putvarint(b,KIND_RESET);
+		needreset = 0;
+	}
+	t = (format!=NULL && ap!=NULL)?chlogbin_template_find(format):NULL;
+	if (t==NULL) {
+		chlogbin_putvarint(b,KIND_TEXT);
+		chlogbin_putvarint(b,version-b->lastversion);
+		chlogbin_putvarint(b,textleng);
+		chlogbin_putbytes(b,text,textleng);
+	} else {
+		if (t->session!=cursession) {
+			t->session = cursession;
+			t->id = nextid++;
+			l = strlen(format);
+			chlogbin_putvarint(b,KIND_TEMPLATE);
+			chlogbin_putvarint(b,l);
+			chlogbin_putbytes(b,format,l);
+		}
+		chlogbin_putvarint(b,t->id);
+		chlogbin_putvarint(b,version-b->lastversion);
+		for (i=0 ; i<t->argc ; i++) {
+			switch (t->argt[i]) {
+				case ARG_INT:
+					chlogbin_putsigned(b,va_arg(*ap,int));
+					break;
+				case ARG_SHORT:
+					chlogbin_putsigned(b,(short)va_arg(*ap,int));
+					break;
+				case ARG_SCHAR:
+					chlogbin_putsigned(b,(signed char)va_arg(*ap,int));
+					break;
+				case ARG_LONG:
+					chlogbin_putsigned(b,va_arg(*ap,long));
+					break;
+				case ARG_LLONG:
+					chlogbin_putsigned(b,va_arg(*ap,long long));
+					break;
+				case ARG_UINT:
+					chlogbin_putvarint(b,va_arg(*ap,unsigned int));
+					break;
+				case ARG_USHORT:
+					chlogbin_putvarint(b,(unsigned short)va_arg(*ap,unsigned int));
+					break;
+				case ARG_UCHAR:
+					chlogbin_putvarint(b,(unsigned char)va_arg(*ap,unsigned int));
+					break;
+				case ARG_ULONG:
+					chlogbin_putvarint(b,va_arg(*ap,unsigned long));
+					break;
+				case ARG_ULLONG:
+					chlogbin_putvarint(b,va_arg(*ap,unsigned long long));
+					break;
+				case ARG_SIZE:
+					chlogbin_putvarint(b,va_arg(*ap,size_t));
+					break;
+				case ARG_CHAR:
+					chlogbin_reserve(b,1);
+					b->data[b->leng++] = (unsigned char)va_arg(*ap,int);
+					break;
+				case ARG_STR:
+					s = va_arg(*ap,const char*);
+					if (s==NULL) {
+						s = "(null)";
+					}
+					l = strlen(s);
+					chlogbin_putvarint(b,l);
+					chlogbin_putbytes(b,s,l);
+					break;
+			}
+		}
+	}
+	b->lastversion = version;
+	ptr = b->data+16;
+	put64bit(&ptr,version);
+}
+
+// fills length and crc - after that block is ready to be written
+void chlogbin_seal(chlogbin_buff *b) {
+	uint8_t *ptr;
+
+	if (b->leng==0) {
+		return;
+	}
+	ptr = b->data;
+	put32bit(&ptr,b->leng-8);
+	put32bit(&ptr,mycrc32(0,b->data+8,b->leng-8));
+}
+
+/* reader */
+
+struct _chlogbin_reader {
+	FILE *fd;
+	uint8_t *block;
+	uint32_t blocksize;
+	const uint8_t *rptr;
+	const uint8_t *rend;
+	uint64_t version;
+	char **tmpl;
+	uint32_t tmplcnt;
+	uint32_t tmplsize;
+	char *line;
+	uint32_t linesize;
+	uint32_t lineleng;
+};
+
+static inline int chlogbin_getvarint(const uint8_t **ptr,const uint8_t *end,uint64_t *v) {
+	const uint8_t *p = *ptr;
+	uint64_t r;
+	uint8_t s;
+
+	r = 0;
+	s = 0;
+	while (p<end && s<64) {
+		r |= ((uint64_t)(*p&0x7F))<<s;
+		if ((*p&0x80)==0) {
+			*ptr = p+1;
+			*v = r;
+			return 0;
+		}
+		p++;
+		s+=7;
+	}
+	return -1;
+}
+
+static inline void chlogbin_line_reserve(chlogbin_reader *r,uint32_t need) {
+	if (r->lineleng+need+1>r->linesize) {
+		r->linesize = ((r->lineleng+need+1)*3)/2+1024;
+		r->line = realloc(r->line,r->linesize);
+		passert(r->line);
+	}
+}
+
+static inline void chlogbin_line_append(chlogbin_reader *r,const void *data,uint32_t leng) {
+	chlogbin_line_reserve(r,leng);
+	memcpy(r->line+r->lineleng,data,leng);
+	r->lineleng += leng;
+	r->line[r->lineleng] = 0;
+}
+
+static void chlogbin_templates_clear(chlogbin_reader *r) {
+	uint32_t i;
+	for (i=0 ; i<r->tmplcnt ; i++) {
+		free(r->tmpl[i]);
+	}
+	r->tmplcnt = 0;
+}
+
+// rebuilds text of change from its template and arguments
+static int chlogbin_decode(chlogbin_reader *r,const char *format) {
+	const char *p,*lit;
+	uint32_t sl,l;
+	uint8_t lmod;
+	char conv;
+	char spec[64];
+	char *sarg;
+	uint64_t v;
+	int n;
+
+	r->lineleng = 0;
+	chlogbin_line_reserve(r,0);
+	r->line[0] = 0;
+	lit = format;
+	for (p=format ; *p ; p++) {
+		if (*p!='%') {
+			continue;
+		}
+		if (p>lit) {
+			chlogbin_line_append(r,lit,p-lit);
+		}
+		sl = chlogbin_parse_spec(p+1,&lmod,&conv);
+		if (sl==0 || sl+4>sizeof(spec)) {
+			return -1;
+		}
+		lit = p+sl+1;
+		if (conv=='%') {
+			chlogbin_line_append(r,"%",1);
+			p += sl;
+			continue;
+		}
+		// rebuild specification without length modifier
+		l = 0;
+		spec[l++] = '%';
+		while (p[l]!='\0' && strchr("-+ #.0123456789",p[l])!=NULL) {
+			spec[l] = p[l];
+			l++;
+		}
+		if (conv=='s') {
+			if (chlogbin_getvarint(&(r->rptr),r->rend,&v)<0 || v>(uint64_t)(r->rend-r->rptr)) {
+				return -1;
+			}
+			if (l==1) {
+				chlogbin_line_append(r,r->rptr,v);
+				r->rptr += v;
+				p += sl;
+				continue;
+			}
+			sarg = malloc(v+1);
+			passert(sarg);
+			memcpy(sarg,r->rptr,v);
+			sarg[v] = 0;
+			r->rptr += v;
+			spec[l++] = 's';
+			spec[l] = 0;
+			n = snprintf(NULL,0,spec,sarg);
+			if (n>0) {
+				chlogbin_line_reserve(r,n);
+				snprintf(r->line+r->lineleng,n+1,spec,sarg);
+				r->lineleng += n;
+			}
+			free(sarg);
+		} else {
+			if (conv=='c') {
+				if (r->rptr>=r->rend) {
+					return -1;
+				}
+				v = *(r->rptr++);
+			} else if (chlogbin_getvarint(&(r->rptr),r->rend,&v)<0) {
+				return -1;
+			}
+			if (conv!='c') {
+				spec[l++] = 'l';
+				spec[l++] = 'l';
+			}
+			spec[l++] = conv;
+			spec[l] = 0;
+			chlogbin_line_reserve(r,64);
+			if (conv=='c') {
+				n = snprintf(r->line+r->lineleng,64,spec,(int)v);
+			} else if (conv=='d' || conv=='i') {
+				n = snprintf(r->line+r->lineleng,64,spec,(long long)((v>>1)^(-(v&1))));
+			} else {
+				n = snprintf(r->line+r->lineleng,64,spec,(unsigned long long)v);
+			}
+			if (n<0 || n>=64) {
+				return -1;
+			}
+			r->lineleng += n;
+		}
+		p += sl;
+	}
+	if (p>lit) {
+		chlogbin_line_append(r,lit,p-lit);
+	}
+	return 0;
+}
+
+static int chlogbin_readblock(chlogbin_reader *r) {
+	uint8_t hdr[CHLOGBIN_BLOCK_HEADER];
+	const uint8_t *ptr;
+	uint32_t leng,crc;
+	size_t s;
+
+	s = fread(hdr,1,CHLOGBIN_BLOCK_HEADER,r->fd);
+	if (s==0 && feof(r->fd)) {
+		return 0;
+	}
+	if (s!=CHLOGBIN_BLOCK_HEADER) {
+		return -1;
+	}
+	ptr = hdr;
+	leng = get32bit(&ptr);
+	crc = get32bit(&ptr);
+	r->version = get64bit(&ptr);
+	if (leng<16 || leng>CHLOGBIN_MAX_BLOCK) {
+		return -1;
+	}
+	leng -= 16;
+	if (leng>r->blocksize) {
+		free(r->block);
+		r->blocksize = leng;
+		r->block = malloc(r->blocksize);
+		passert(r->block);
+	}
+	if (fread(r->block,1,leng,r->fd)!=leng) {
+		return -1;
+	}
+	if (mycrc32(mycrc32(0,hdr+8,16),r->block,leng)!=crc) {
+		return -1;
+	}
+	r->rptr = r->block;
+	r->rend = r->block + leng;
+	return 1;
+}
+
+chlogbin_reader* chlogbin_reader_new(FILE *fd) {
+	chlogbin_reader *r;
+
+	r = malloc(sizeof(chlogbin_reader));
+	passert(r);
+	r->fd = fd;
+	r->block = NULL;
+	r->blocksize = 0;
+	r->rptr = NULL;
+	r->rend = NULL;
+	r->version = 0;
+	r->tmpl = NULL;
+	r->tmplcnt = 0;
+	r->tmplsize = 0;
+	r->line = NULL;
+	r->linesize = 0;
+	r->lineleng = 0;
+	return r;
+}
+
+// returns 1 - next change, 0 - end of file, -1 - damaged data
+int chlogbin_reader_next(chlogbin_reader *r,uint64_t *version,const char **line) {
+	uint64_t kind,delta,leng;
+	int s;
+
+	for (;;) {
+		if (r->rptr>=r->rend) {
+			s = chlogbin_readblock(r);
+			if (s<=0) {
+				return s;
+			}
+		}
+		if (chlogbin_getvarint(&(r->rptr),r->rend,&kind)<0) {
+			return -1;
+		}
+		if (kind==KIND_RESET) {
+			chlogbin_templates_clear(r);
+			continue;
+		}
+		if (kind==KIND_TEMPLATE) {
+			if (chlogbin_getvarint(&(r->rptr),r->rend,&leng)<0 || leng>(uint64_t)(r->rend-r->rptr)) {
+				return -1;
+			}
+			if (r->tmplcnt>=r->tmplsize) {
+				r->tmplsize = (r->tmplsize==0)?64:(r->tmplsize*2);
+				r->tmpl = realloc(r->tmpl,sizeof(char*)*r->tmplsize);
+				passert(r->tmpl);
+			}
+			r->tmpl[r->tmplcnt] = malloc(leng+1);
+			passert(r->tmpl[r->tmplcnt]);
+			memcpy(r->tmpl[r->tmplcnt],r->rptr,leng);
+			r->tmpl[r->tmplcnt][leng] = 0;
+			r->tmplcnt++;
+			r->rptr += leng;
+			continue;
+		}
+		if (chlogbin_getvarint(&(r->rptr),r->rend,&delta)<0) {
+			return -1;
+		}
+		r->version += delta;
+		if (kind==KIND_TEXT) {
+			if (chlogbin_getvarint(&(r->rptr),r->rend,&leng)<0 || leng>(uint64_t)(r->rend-r->rptr)) {
+				return -1;
+			}
+			r->lineleng = 0;
+			chlogbin_line_append(r,r->rptr,leng);
+			r->rptr += leng;
+		} else {
+			if (kind-CHLOGBIN_FIRSTID>=r->tmplcnt) {
+				return -1;
+			}
+			if (chlogbin_decode(r,r->tmpl[kind-CHLOGBIN_FIRSTID])<0) {
+				return -1;
+			}
+		}
+		*version = r->version;
+		*line = r->line;
+		return 1;
+	}
+}
+
+void chlogbin_reader_free(chlogbin_reader *r) {
+	chlogbin_templates_clear(r);
+	if (r->tmpl!=NULL) {
+		free(r->tmpl);
+	}
+	if (r->block!=NULL) {
+		free(r->block);
+	}
+	if (r->line!=NULL) {
+		free(r->line);
+	}
+	free(r);
+}
+
+/* file scanning */
+
+int chlogbin_check_magic(int fd) {
+	uint8_t buff[CHLOGBIN_MAGIC_SIZE];
+
+	if (lseek(fd,0,SEEK_SET)!=0) {
+		return 0;
+	}
+	if (read(fd,buff,CHLOGBIN_MAGIC_SIZE)!=CHLOGBIN_MAGIC_SIZE) {
+		return 0;
+	}
+	return (memcmp(buff,CHLOGBIN_MAGIC,CHLOGBIN_MAGIC_SIZE)==0)?1:0;
+}
+
+uint64_t chlogbin_findfirstversion(int fd) {
+	uint8_t hdr[CHLOGBIN_BLOCK_HEADER];
+	const uint8_t *ptr;
+	uint32_t leng;
+
+	if (lseek(fd,CHLOGBIN_MAGIC_SIZE,SEEK_SET)!=CHLOGBIN_MAGIC_SIZE) {
+		return 0;
+	}
+	if (read(fd,hdr,CHLOGBIN_BLOCK_HEADER)!=CHLOGBIN_BLOCK_HEADER) {
+		return 0;
+	}
+	ptr = hdr;
+	leng = get32bit(&ptr);
+	if (leng<16 || leng>CHLOGBIN_MAX_BLOCK) {
+		return 0;
+	}
+	ptr += 4;
+	return get64bit(&ptr);
+}
+
+// walks through blocks - returns offset of the end of last valid block ; sets versions of the last two blocks
+static uint64_t chlogbin_scan(int fd,uint8_t checkcrc,uint64_t *lastversion,uint64_t *prevversion,uint64_t *lastoffset) {
+	struct stat st;
+	uint8_t hdr[CHLOGBIN_BLOCK_HEADER];
+	const uint8_t *ptr;
+	uint8_t *buff;
+	uint32_t leng,crc,buffsize;
+	uint64_t offset,fv,lv;
+
+	*lastversion = 0;
+	*prevversion = 0;
+	*lastoffset = 0;
+	if (fstat(fd,&st)<0) {
+		return 0;
+	}
+	buff = NULL;
+	buffsize = 0;
+	offset = CHLOGBIN_MAGIC_SIZE;
+	while (offset+CHLOGBIN_BLOCK_HEADER<=(uint64_t)(st.st_size)) {
+		if (lseek(fd,offset,SEEK_SET)!=(off_t)offset || read(fd,hdr,CHLOGBIN_BLOCK_HEADER)!=CHLOGBIN_BLOCK_HEADER) {
+			break;
+		}
+		ptr = hdr;
+		leng = get32bit(&ptr);
+		crc = get32bit(&ptr);
+		fv = get64bit(&ptr);
+		lv = get64bit(&ptr);
+		if (leng<16 || leng>CHLOGBIN_MAX_BLOCK || lv<fv || offset+8+leng>(uint64_t)(st.st_size)) {
+			break;
+		}
+		if (checkcrc) {
+			if (leng-16>buffsize) {
+				free(buff);
+				buffsize = leng-16;
+				buff = malloc(buffsize);
+				passert(buff);
+			}
+			if (read(fd,buff,leng-16)!=(ssize_t)(leng-16)) {
+				break;
+			}
+			if (mycrc32(mycrc32(0,hdr+8,16),buff,leng-16)!=crc) {
+				break;
+			}
+		}
+		*prevversion = *lastversion;
+		*lastversion = lv;
+		*lastoffset = offset;
+		offset += 8+leng;
+	}
+	if (buff!=NULL) {
+		free(buff);
+	}
+	return offset;
+}
+
+uint64_t chlogbin_findlastversion(int fd) {
+	uint8_t hdr[CHLOGBIN_BLOCK_HEADER];
+	const uint8_t *ptr;
+	uint8_t *buff;
+	uint64_t lastversion,prevversion,lastoffset;
+	uint32_t leng,crc;
+	int ok;
+
+	chlogbin_scan(fd,0,&lastversion,&prevversion,&lastoffset);
+	if (lastversion==0) {
+		return 0;
+	}
+	// only the last block may be damaged (interrupted write) - check its crc
+	ok = 0;
+	if (lseek(fd,lastoffset,SEEK_SET)==(off_t)lastoffset && read(fd,hdr,CHLOGBIN_BLOCK_HEADER)==CHLOGBIN_BLOCK_HEADER) {
+		ptr = hdr;
+		leng = get32bit(&ptr)-16;
+		crc = get32bit(&ptr);
+		buff = malloc(leng+1);
+		passert(buff);
+		if (read(fd,buff,leng)==(ssize_t)leng && mycrc32(mycrc32(0,hdr+8,16),buff,leng)==crc) {
+			ok = 1;
+		}
+		free(buff);
+	}
+	return ok?lastversion:prevversion;
+}
+
+// used before appending to existing file - everything after returned offset should be truncated
+uint64_t chlogbin_validlength(int fd) {
+	uint64_t lastversion,prevversion,lastoffset;
+
+	return chlogbin_scan(fd,1,&lastversion,&prevversion,&lastoffset);
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2026 Jakub Kruszona-Zawadzki, Saglabs SA
+ * 
+ * This file is part of MooseFS.
+ * 
+ * MooseFS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 (only).
+ * 
+ * MooseFS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CHLOGBIN_H_
+#define _CHLOGBIN_H_
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <inttypes.h>
+
+// binary changelog file:
+//   "MFSCLOG1"
+//   blocks (one block per write):
+//     length:32 crc:32 firstversion:64 lastversion:64 records[length-16]
+//     (crc covers versions and records)
+//   record:
+//     kind:varint
+//     kind 0 - forget all templates (written at the beginning of every writer session)
+//     kind 1 - new template - leng:varint format[leng] (ids are given sequentially starting from CHLOGBIN_FIRSTID)
+//     kind 2 - text change - vdelta:varint leng:varint text[leng]
+//     kind >=CHLOGBIN_FIRSTID - change described by template - vdelta:varint args
+//       integers as varints (signed ones zigzag encoded), %c as one byte, strings as leng:varint data[leng]
+//   vdelta is a difference between version of this change and previous one in the block (first one relates to firstversion)
+
+#define CHLOGBIN_MAGIC "MFSCLOG1"
+#define CHLOGBIN_MAGIC_SIZE 8
+#define CHLOGBIN_BLOCK_HEADER 24
+#define CHLOGBIN_MAX_BLOCK 0x4000000
+
+typedef struct _chlogbin_buff {
+	uint8_t *data;
+	uint32_t leng;
+	uint32_t size;
+	uint64_t lastversion;
+} chlogbin_buff;
+
+// writer
+void chlogbin_newsession(void);
+void chlogbin_add(chlogbin_buff *b,uint64_t version,const char *text,uint32_t textleng,const char *format,va_list *ap);
+void chlogbin_seal(chlogbin_buff *b);
+
+// reader
+typedef struct _chlogbin_reader chlogbin_reader;
+
+chlogbin_reader* chlogbin_reader_new(FILE *fd);
+int chlogbin_reader_next(chlogbin_reader *r,uint64_t *version,const char **line);
+void chlogbin_reader_free(chlogbin_reader *r);
+
+int chlogbin_check_magic(int fd);
+uint64_t chlogbin_findfirstversion(int fd);
+uint64_t chlogbin_findlastversion(int fd);
+uint64_t chlogbin_validlength(int fd);
+
+#endif
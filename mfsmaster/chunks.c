@@ -33,12 +33,14 @@
 #include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <pthread.h>
 
 #include "MFSCommunication.h"
 
 #include "main.h"
 #include "cfg.h"
 #include "bio.h"
+#include "loadpipe.h"
 #include "metadata.h"
 #include "matocsserv.h"
 #include "matoclserv.h"
@@ -56,6 +58,7 @@
 #include "buckets.h"
 #include "clocks.h"
 #include "storageclass.h"
+#include "lwthread.h"
 
 #define MINLOOPTIME 60
 #define MAXLOOPTIME 7200
@@ -616,7 +619,8 @@ typedef struct chunk {
 	unsigned storage_mode:4;
 	unsigned all_gequiv:4;
 	unsigned reg_gequiv:4;
-	unsigned unused:4;
+	unsigned storemark:1;
+	unsigned unused:3;
 //	unsigned allvalidcopies:4;
 //	unsigned regularvalidcopies:4;
 //	unsigned allecgequiv:4;
@@ -653,6 +657,21 @@ static uint32_t chunkhashelem;
 static uint64_t nextchunkid=1;
 #define LOCKTIMEOUT 120
 
+// incremental metadata store - chunks with 'storemark' different than 'storemarkcur' haven't been stored yet,
+// so they have to be stored before being modified (only running master changes chunks - 'mr' functions are used only before any store)
+static uint8_t storemarkcur;
+static bio *incstore_fd;
+static uint32_t incstore_pos;
+static uint64_t incstore_nextchunkid;
+
+static void chunk_preserve_slow(chunk *c);
+
+static inline void chunk_preserve(chunk *c) {
+	if (c->storemark!=storemarkcur) {
+		chunk_preserve_slow(c);
+	}
+}
+
 #define UNUSED_DELETE_TIMEOUT (86400*7)
 
 typedef struct _csopchunk {
@@ -773,6 +792,7 @@ static uint32_t LoopTimeMin;
 //static uint32_t HashSteps;
 static uint32_t HashCPTMax;
 static double AcceptableDifference;
+static uint32_t ChunksLoopThreads;
 
 static uint8_t DoNotUseSameIP;
 static uint8_t DoNotUseSameRack;
@@ -1173,6 +1193,31 @@ static inline chunk* chunk_hash_find(uint64_t chunkid) {
 	return NULL;
 }
 
+/* hints the cpu to fetch the bucket (stage 0) or the first chunk in the bucket (stage 1) - used by bulk lookups */
+static inline void chunk_hash_prefetch(uint64_t chunkid,uint8_t stage) {
+#if defined(__GNUC__)
+	uint32_t hash;
+	chunk **chptr;
+
+	if (chunkhashsize==0) {
+		return;
+	}
+	hash = hash32(chunkid) & (chunkhashsize-1);
+	if (chunkrehashpos<chunkhashsize && hash >= chunkrehashpos) {
+		hash -= chunkhashsize/2;
+	}
+	chptr = chunkhashtab[hash>>HASHTAB_LOBITS] + (hash&HASHTAB_MASK);
+	if (stage==0) {
+		__builtin_prefetch(chptr);
+	} else if (*chptr!=NULL) {
+		__builtin_prefetch(*chptr);
+	}
+#else
+	(void)chunkid;
+	(void)stage;
+#endif
+}
+
 static inline void chunk_hash_delete(chunk *c) {
 	chunk **chptr,*cit;
 	uint32_t hash;
@@ -1264,6 +1309,7 @@ chunk* chunk_new(uint64_t chunkid) {
 	newchunk->interrupted = 0;
 	newchunk->writeinprogress = 0;
 	newchunk->flags = 0;
+	newchunk->storemark = storemarkcur;
 	newchunk->operation = NONE;
 	newchunk->slisthead = NULL;
 	newchunk->fhead = FLISTNULLINDX;
@@ -1291,6 +1337,7 @@ chunk* chunk_find(uint64_t chunkid) {
 
 void chunk_delete(chunk* c) {
 	uint32_t indx;
+	chunk_preserve(c);
 	indx = (uint32_t)(c->sclassid) + MAXSCLASS * (c->flags & FLAG_MASK);
 	if (lastchunkptr==c) {
 		lastchunkid=0;
@@ -1388,11 +1435,13 @@ static inline void chunk_state_set_counters(chunk *c,uint8_t storage_mode,uint8_
 }
 
 static inline void chunk_state_set_flags(chunk *c,uint8_t new_flags) {
+	chunk_preserve(c);
 	chunk_state_change(c->sclassid,c->sclassid,c->flags,new_flags,c->storage_mode,c->storage_mode,c->all_gequiv,c->all_gequiv,c->reg_gequiv,c->reg_gequiv);
 	c->flags = new_flags;
 }
 
 static inline void chunk_state_set_sclass(chunk *c,uint8_t new_sclassid) {
+	chunk_preserve(c);
 	chunk_state_change(c->sclassid,new_sclassid,c->flags,c->flags,c->storage_mode,c->storage_mode,c->all_gequiv,c->all_gequiv,c->reg_gequiv,c->reg_gequiv);
 	c->sclassid = new_sclassid;
 }
@@ -2682,6 +2731,7 @@ void chunk_emergency_increase_version(chunk *c) {
 	if (i>0) {	// should always be true !!!
 		c->interrupted = 0;
 		chunk_set_op(c,SET_VERSION);
+		chunk_preserve(c);
 		c->version++;
 		c->allowreadzeros = 0;
 		changelog("%"PRIu32"|SETVERSION(%"PRIu64",%"PRIu32")",(uint32_t)main_time(),c->chunkid,c->version);
@@ -2753,6 +2803,7 @@ static inline int chunk_remove_disconnected_chunks(chunk *c) {
 				}
 			}
 			if (verfixed) {
+				chunk_preserve(c);
 				c->version--;
 				c->allowreadzeros = 0;
 				changelog("%"PRIu32"|SETVERSION(%"PRIu64",%"PRIu32")",(uint32_t)main_time(),c->chunkid,c->version);
@@ -2863,6 +2914,7 @@ static inline uint16_t chunk_compact_and_find_sclassid(chunk *c) {
 		sclassid = fl->sclassid;
 		findx = fl->fcount;
 		if (findx<FLISTFIRSTINDX) {
+			chunk_preserve(c);
 			flist_free(c->fhead);
 			c->fhead = findx;
 		}
@@ -2903,6 +2955,7 @@ int chunk_change_file(uint64_t chunkid,uint8_t prevsclassid,uint8_t newsclassid)
 		mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"serious structure inconsistency: (chunkid:%016"PRIX64")",c->chunkid);
 		return MFS_ERROR_CHUNKLOST;	// MFS_ERROR_STRUCTURE
 	}
+	chunk_preserve(c);
 //	oldsclassid = c->sclassid;
 	if (c->fhead==FLISTONEFILEINDX) {
 		new_calculated_sclassid = newsclassid;
@@ -2974,6 +3027,7 @@ static inline int chunk_delete_file_int(chunk *c,uint8_t sclassid,uint32_t delet
 		return MFS_ERROR_CHUNKLOST;	// MFS_ERROR_STRUCTURE
 	}
 	massert(sclassid>0,"wrong storage class id");
+	chunk_preserve(c);
 	if (c->fhead==FLISTONEFILEINDX) {
 		massert(sclassid==c->sclassid,"wrong chunk sclassid");
 		new_calculated_sclassid = 0;
@@ -3018,6 +3072,7 @@ static inline int chunk_add_file_int(chunk *c,uint8_t sclassid) {
 	uint8_t flags;
 	flist *fl;
 
+	chunk_preserve(c);
 	massert(sclassid>0,"wrong labels set");
 	if (c->fhead==FLISTNULLINDX) {
 		new_calculated_sclassid = sclassid;
@@ -3646,6 +3701,7 @@ int chunk_univ_multi_modify(uint32_t ts,uint8_t mr,uint8_t continueop,uint64_t *
 		if (mr==0 && (oc->lockedto>=ts || chunk_replock_test(ochunkid,ts)) && continueop==0) {
 			return MFS_ERROR_LOCKED;
 		}
+		chunk_preserve(oc);
 		if (oc->fhead==FLISTONEFILEINDX) {
 			c = oc;
 			if (mr==0) {
@@ -3809,6 +3865,7 @@ int chunk_univ_multi_truncate(uint32_t ts,uint8_t mr,uint64_t *nchunkid,uint64_t
 	if (mr==0 && (oc->lockedto>=ts || chunk_replock_test(ochunkid,ts))) {
 		return MFS_ERROR_LOCKED;
 	}
+	chunk_preserve(oc);
 	if (oc->fhead==FLISTONEFILEINDX) {
 		c = oc;
 		if (mr==0) {
@@ -3938,6 +3995,7 @@ int chunk_repair(uint8_t sclassid,uint64_t ochunkid,uint8_t flags,uint32_t *nver
 	if (c->all_gequiv>0) { // chunk is ok
 		return 0;
 	}
+	chunk_preserve(c);
 	chunk_write_counters(c,0);
 	mask8 = 0;
 	mask4 = 0;
@@ -4500,6 +4558,26 @@ void chunk_server_has_chunk(uint16_t csid,uint64_t chunkid,uint8_t ecid,uint32_t
 	}
 }
 
+#define HAS_CHUNKS_PREFETCH 8
+
+/* registration of many chunks at once - 'chunkids' are in wire format (ecid in the highest byte) */
+void chunk_server_has_chunks(uint16_t csid,const uint64_t *chunkids,const uint32_t *versions,uint32_t count) {
+	uint32_t i;
+
+	for (i=0 ; i<count && i<2*HAS_CHUNKS_PREFETCH ; i++) {
+		chunk_hash_prefetch(chunkids[i]&UINT64_C(0x00FFFFFFFFFFFFFF),0);
+	}
+	for (i=0 ; i<count ; i++) {
+		if (i+2*HAS_CHUNKS_PREFETCH<count) {
+			chunk_hash_prefetch(chunkids[i+2*HAS_CHUNKS_PREFETCH]&UINT64_C(0x00FFFFFFFFFFFFFF),0);
+		}
+		if (i+HAS_CHUNKS_PREFETCH<count) {
+			chunk_hash_prefetch(chunkids[i+HAS_CHUNKS_PREFETCH]&UINT64_C(0x00FFFFFFFFFFFFFF),1);
+		}
+		chunk_server_has_chunk(csid,chunkids[i]&UINT64_C(0x00FFFFFFFFFFFFFF),chunkids[i]>>56,versions[i]);
+	}
+}
+
 void chunk_damaged(uint16_t csid,uint64_t chunkid,uint8_t ecid) {
 	chunk *c;
 	slist *s;
@@ -5073,6 +5151,7 @@ void chunk_operation_status(uint64_t chunkid,uint8_t ecid,uint8_t status,uint16_
 			}
 		}
 		if (verfixed) {
+			chunk_preserve(c);
 			c->version--;
 			c->allowreadzeros = 0;
 			changelog("%"PRIu32"|SETVERSION(%"PRIu64",%"PRIu32")",now,c->chunkid,c->version);
@@ -5692,6 +5771,7 @@ static inline uint8_t chunk_fix_wrong_version_ec(chunk *c,uint8_t gequiv,uint8_t
 		}
 		if (bitcount(bestversionmask)>=gequiv) {
 			mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"chunk %016"PRIX64" has only ec parts with wrong version - fixing it",c->chunkid);
+			chunk_preserve(c);
 			c->version = bestversion;
 			for (s=c->slisthead ; s ; s=s->next) {
 				if (s->ecid>=minecid && s->ecid<=maxecid && s->version==bestversion && cstab[s->csid].valid) {
@@ -6471,6 +6551,7 @@ void chunk_do_jobs(chunk *c,uint8_t mode,uint32_t now,uint8_t extrajob) {
 
 				if (bestversion>0 && ((bestversion+1)==c->version || (uint32_t)(c->version)+1==bestversion)) {
 					mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"chunk %016"PRIX64" has only copies (%"PRIu32") with wrong version - fixing it",c->chunkid,wvc+tdw);
+					chunk_preserve(c);
 					c->version = bestversion;
 					for (s=c->slisthead ; s ; s=s->next) {
 						if (s->ecid==0 && s->version==bestversion && cstab[s->csid].valid) {
@@ -8558,6 +8639,7 @@ int chunk_unlock(uint32_t ts,uint64_t chunkid) {
 	if (c==NULL) {
 		return MFS_ERROR_NOCHUNK;
 	}
+	chunk_preserve(c);
 	c->lockedto = ts-1;
 	chunk_write_counters(c,0);
 	chunk_priority_queue_check(c,1);
@@ -8576,12 +8658,198 @@ int chunk_mr_unlock(uint32_t ts,uint64_t chunkid) {
 	if (c==NULL) {
 		return MFS_ERROR_NOCHUNK;
 	}
+	chunk_preserve(c);
 	c->lockedto = ts-1;
 	chunk_write_counters(c,0);
 	return MFS_STATUS_OK;
 }
 
 
+/* danger scan:
+ * when CHUNKS_LOOP_THREADS is set, the whole chunk hash is additionally swept (much faster than by
+ * the standard loop) by the main thread together with scan threads, looking for chunks that should
+ * be placed in priority queues (endangered, undergoal, overgoal, unfinished EC conversions etc.).
+ * The main thread waits for the threads, so nothing is changed during the phase. Found chunks are
+ * enqueued afterwards and handled by the priority part of chunk_jobs_main - all jobs are still sent
+ * by the main thread. Wrong labels (label matching uses shared buffers) are left to the standard loop. */
+
+#define SCAN_MAX_THREADS 64
+#define SCAN_BUCKETS_PER_THREAD 4096
+#define SCAN_SLICE 256
+#define SCAN_DEFER 0xFF
+
+typedef struct _scancand {
+	chunk *c;
+	uint8_t priority;			// SCAN_DEFER - has to be checked by the main thread
+} scancand;
+
+typedef struct _scanthread {
+	scancand *cand;
+	uint32_t candcnt;
+	uint32_t candsize;
+	uint64_t chunks;
+} scanthread;
+
+static scanthread scan_thtab[SCAN_MAX_THREADS+1];	// [0] - main thread
+static uint32_t scan_running = 0;
+static lwt_phasepool *scan_pool = NULL;
+static uint32_t scan_slicepos;
+static uint32_t scan_end;
+static uint32_t scan_now;
+
+static uint32_t scan_pos = 0;
+static uint64_t scan_loopstartusec = 0;
+static uint64_t scan_loopphaseusec = 0;
+static uint64_t scan_loopchunks = 0;
+static uint64_t scan_loopfound = 0;
+static uint32_t scan_loops = 0;
+static uint32_t scan_lastloopend = 0;
+static uint64_t scan_lastloopusec = 0;
+static uint64_t scan_lastloopphaseusec = 0;
+static uint64_t scan_lastloopchunks = 0;
+static uint64_t scan_lastloopfound = 0;
+
+static inline void chunk_scan_candidate(scanthread *st,chunk *c,uint8_t priority) {
+	if (st->candcnt>=st->candsize) {
+		st->candsize = (st->candsize==0)?1024:(st->candsize*2);
+		st->cand = realloc(st->cand,sizeof(scancand)*st->candsize);
+		passert(st->cand);
+	}
+	st->cand[st->candcnt].c = c;
+	st->cand[st->candcnt].priority = priority;
+	st->candcnt++;
+}
+
+static void chunk_scan_work(void *arg) {
+	scanthread *st = (scanthread*)arg;
+	uint32_t pos,end;
+	chunk *c;
+	storagemode *sm;
+	uint8_t j;
+
+	while ((pos = __sync_fetch_and_add(&scan_slicepos,SCAN_SLICE))<scan_end) {
+		end = pos + SCAN_SLICE;
+		if (end>scan_end) {
+			end = scan_end;
+		}
+		for ( ; pos<end ; pos++) {
+			for (c=chunkhashtab[pos>>HASHTAB_LOBITS][pos&HASHTAB_MASK] ; c ; c=c->next) {
+				st->chunks++;
+				// the same conditions as in chunk_priority_queue_check
+				if (c->ondangerlist || c->sclassid==0 || c->fhead==FLISTNULLINDX || c->lockedto>=scan_now+3600) {
+					continue;
+				}
+				// storage modes that need to be modified (temporary copy, EC counters) are left to the main thread
+				if (sclass_keeparch_storagemode_is_temporary(c->sclassid,c->flags)) {
+					chunk_scan_candidate(st,c,SCAN_DEFER);
+					continue;
+				}
+				sm = sclass_get_keeparch_storagemode(c->sclassid,c->flags);
+				if (sm->ec_data_chksum_parts && sm->has_labels && sm->labelscnt && sm->valid_ec_counters<sm->labelscnt) {
+					chunk_scan_candidate(st,c,SCAN_DEFER);
+					continue;
+				}
+				j = chunk_calculate_endanger_priority(c,0);
+				if (j<DANGER_PRIORITIES) {
+					chunk_scan_candidate(st,c,j);
+				}
+			}
+		}
+	}
+}
+
+static void chunk_scan_phase(uint32_t now) {
+	uint32_t i,k,helpers;
+	uint64_t st,usec;
+	scanthread *sth;
+	chunk *c;
+
+	if (ChunksLoopThreads==0 || chunkrehashpos==0) {
+		return;
+	}
+	if (scan_pos>=chunkrehashpos) {
+		scan_pos = 0;
+	}
+	if (scan_pool==NULL) {
+		scan_pool = lwt_phase_new(chunk_scan_work);
+	}
+	st = monotonic_useconds();
+	if (scan_pos==0) {
+		scan_loopstartusec = st;
+		scan_loopphaseusec = 0;
+		scan_loopchunks = 0;
+		scan_loopfound = 0;
+	}
+	scan_end = scan_pos + (ChunksLoopThreads+1) * SCAN_BUCKETS_PER_THREAD;
+	if (scan_end>chunkrehashpos || scan_end<scan_pos) {
+		scan_end = chunkrehashpos;
+	}
+	helpers = (scan_end - scan_pos) / SCAN_BUCKETS_PER_THREAD;
+	if (helpers>ChunksLoopThreads) {
+		helpers = ChunksLoopThreads;
+	}
+	while (scan_running<helpers) {
+		sth = scan_thtab + scan_running + 1;
+		if (lwt_phase_addthread(scan_pool,sth)!=0) {
+			mfs_log(MFSLOG_ERRNO_SYSLOG,MFSLOG_WARNING,"chunks: can't create scan thread");
+			helpers = scan_running;
+			break;
+		}
+		scan_running++;
+	}
+
+	scan_now = now;
+	scan_slicepos = scan_pos;
+	lwt_phase_run(scan_pool,helpers,scan_thtab);
+
+	for (i=0 ; i<=scan_running ; i++) {
+		sth = scan_thtab + i;
+		for (k=0 ; k<sth->candcnt ; k++) {
+			c = sth->cand[k].c;
+			if (sth->cand[k].priority==SCAN_DEFER) {
+				chunk_priority_queue_check(c,0);
+			} else {
+				chunk_priority_enqueue(sth->cand[k].priority,c);
+			}
+			if (c->ondangerlist) {
+				scan_loopfound++;
+			}
+		}
+		sth->candcnt = 0;
+		scan_loopchunks += sth->chunks;
+		sth->chunks = 0;
+	}
+	usec = monotonic_useconds();
+	scan_loopphaseusec += usec - st;
+	scan_pos = scan_end;
+	if (scan_pos>=chunkrehashpos) {
+		scan_loops++;
+		scan_lastloopend = now;
+		scan_lastloopusec = usec - scan_loopstartusec;
+		scan_lastloopphaseusec = scan_loopphaseusec;
+		scan_lastloopchunks = scan_loopchunks;
+		scan_lastloopfound = scan_loopfound;
+	}
+}
+
+static void chunk_scan_term(void) {
+	uint32_t i;
+
+	if (scan_pool!=NULL) {
+		lwt_phase_term(scan_pool);
+		scan_pool = NULL;
+	}
+	scan_running = 0;
+	for (i=0 ; i<=SCAN_MAX_THREADS ; i++) {
+		if (scan_thtab[i].cand!=NULL) {
+			free(scan_thtab[i].cand);
+			scan_thtab[i].cand = NULL;
+		}
+		scan_thtab[i].candsize = 0;
+		scan_thtab[i].candcnt = 0;
+	}
+}
+
 void chunk_do_fast_job(chunk *c,uint32_t now,uint8_t extrajob) {
 
 	chunk_do_jobs(c,JOBS_CHUNK,now,extrajob);
@@ -8730,6 +8998,9 @@ void chunk_jobs_main(void) {
 	}
 #endif
 
+	// find endangered chunks in parallel (only when enabled)
+	chunk_scan_phase(now);
+
 	// then serve standard chunks
 	lc = 0;
 	hashsteps = 1+((chunkrehashpos)/(LoopTimeMin*TicksPerSecond));
@@ -8856,127 +9127,169 @@ uint8_t chunk_is_afterload_needed(uint8_t mver) {
 	return (mver>=0x12)?0:1;
 }
 
-int chunk_load(bio *fd,uint8_t mver,int ignoreflag) {
-	uint8_t hdr[8];
-	uint8_t loadbuff[CHUNKFSIZE];
-	uint8_t pairsbuff[CHUNKDSIZE];
-	const uint8_t *ptr;
-	uint8_t nl;
-	int32_t r,recsize;
-	int32_t dynsize;
-	chunk *c;
-// chunkdata
+typedef struct _chunkload_dec {
 	uint64_t chunkid;
-	uint32_t version,lockedto;
+	uint32_t version;
+	uint32_t lockedto;
+	uint16_t pairs;
 	uint8_t flags;
+} chunkload_dec;
+
+typedef struct _chunkload_state {
+	uint8_t mver;
+	uint8_t recsize;
+	int ignoreflag;
+	uint8_t nl;
+} chunkload_state;
+
+static inline uint16_t chunk_load_pairs(const uint8_t *rec,uint8_t mver) {
+	uint16_t pairs;
+	pairs = (mver<=0x11)?0:rec[17];
+	if (mver>0x10 && (rec[16]&0x80)) {
+		pairs |= 0x100;
+	}
+	return pairs;
+}
+
+static uint32_t chunk_load_frame(const uint8_t *rec,uint32_t have,uint8_t *tag,void *arg) {
+	chunkload_state *cs = (chunkload_state*)arg;
+	const uint8_t *ptr;
+	uint16_t pairs;
+	uint32_t dynsize;
+
+	if (have<cs->recsize) {
+		return cs->recsize;
+	}
+	ptr = rec;
+	if (get64bit(&ptr)==0) {
+		*tag = LOADPIPE_LAST;
+		return cs->recsize;
+	}
+	pairs = chunk_load_pairs(rec,cs->mver);
+	dynsize = 0;
+	if (pairs>0) {
+		dynsize = 4*pairs;
+		if (pairs>1) {
+			dynsize++;
+		}
+	}
+	return cs->recsize+dynsize;
+}
+
+static void chunk_load_decode(uint8_t *rec,uint32_t leng,uint8_t tag,void *dec,void *arg) {
+	chunkload_state *cs = (chunkload_state*)arg;
+	chunkload_dec *cd = (chunkload_dec*)dec;
+	const uint8_t *ptr;
+
+	(void)leng;
+	(void)tag;
+	ptr = rec;
+	cd->chunkid = get64bit(&ptr);
+	cd->version = get32bit(&ptr);
+	cd->lockedto = get32bit(&ptr);
+	if (cs->mver==0x10) {
+		cd->flags = 0;
+	} else {
+		cd->flags = get8bit(&ptr) & 0x7F;
+	}
+	cd->pairs = chunk_load_pairs(rec,cs->mver);
+}
+
+static int chunk_load_apply(const uint8_t *rec,uint32_t leng,uint8_t tag,const void *dec,void *arg) {
+	chunkload_state *cs = (chunkload_state*)arg;
+	const chunkload_dec *cd = (const chunkload_dec*)dec;
+	const uint8_t *ptr;
+	chunk *c;
 	uint16_t pairs;
 	uint8_t sclassid;
 	uint32_t fcount;
 	uint32_t *findxptr;
 	flist *fl;
 
-	nl = 1;
-	chunks = 0;
-	if (bio_read(fd,hdr,8)!=8) {
-		mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"chunks: can't read header");
-		return -1;
-	}
-	ptr = hdr;
-	nextchunkid = get64bit(&ptr);
-	recsize = (mver==0x10)?16:(mver==0x11)?17:CHUNKFSIZE;
-	for (;;) {
-		r = bio_read(fd,loadbuff,recsize);
-		if (r!=recsize) {
-			mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"chunks: read error");
-			return -1;
-		}
-		ptr = loadbuff;
-		chunkid = get64bit(&ptr);
-		version = get32bit(&ptr);
-		lockedto = get32bit(&ptr);
-		if (mver==0x10) {
-			flags = 0;
-		} else {
-			flags = get8bit(&ptr);
-		}
-		if (mver<=0x11) {
-			pairs = 0;
-		} else {
-			pairs = get8bit(&ptr);
-		}
-		if (flags&0x80) {
-			flags &= 0x7F;
-			pairs |= 0x100;
-		}
-		if (pairs>0) {
-			dynsize = 4*pairs;
-			if (pairs>1) {
-				dynsize++;
+	(void)leng;
+	(void)tag;
+	if (cd->chunkid>0) {
+		c = chunk_find(cd->chunkid);
+		if (c!=NULL) {
+			if (cs->nl) {
+				fputc('\n',stderr);
+				cs->nl = 0;
 			}
-			r = bio_read(fd,pairsbuff,dynsize);
-			if (r!=dynsize) {
-				mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"chunks: read error");
+			mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_ERR,"loading chunk %016"PRIX64" error: chunk already exists",cd->chunkid);
+			if (cs->ignoreflag==0) {
+				fprintf(stderr,"use option '-i' to ignore\n");
 				return -1;
 			}
-		}
-		if (chunkid>0) {
-			c = chunk_find(chunkid);
-			if (c!=NULL) {
-				if (nl) {
-					fputc('\n',stderr);
-					nl = 0;
-				}
-				mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_ERR,"loading chunk %016"PRIX64" error: chunk already exists",chunkid);
-				if (ignoreflag==0) {
-					fprintf(stderr,"use option '-i' to ignore\n");
-					return -1;
-				}
-			} else {
-				c = chunk_new(chunkid);
-				c->allowreadzeros = (version&0x80000000)?1:0;
-				c->version = version&0x3FFFFFFF;
-				c->lockedto = lockedto;
-				if (pairs>0) {
-					ptr = pairsbuff;
-					if (pairs>1) {
-						findxptr = &c->fhead;
-						while (pairs>0) {
-							sclassid = get8bit(&ptr);
-							fcount = get24bit(&ptr);
-							fl = flist_get(*findxptr = flist_alloc());
-							fl->sclassid = sclassid;
-							fl->fcount = fcount;
-							fl->nexti = FLISTNULLINDX;
-							findxptr = &(fl->nexti);
-							pairs--;
-						}
-						sclassid = get8bit(&ptr);
-					} else {
+		} else {
+			c = chunk_new(cd->chunkid);
+			c->allowreadzeros = (cd->version&0x80000000)?1:0;
+			c->version = cd->version&0x3FFFFFFF;
+			c->lockedto = cd->lockedto;
+			pairs = cd->pairs;
+			if (pairs>0) {
+				ptr = rec+cs->recsize;
+				if (pairs>1) {
+					findxptr = &c->fhead;
+					while (pairs>0) {
 						sclassid = get8bit(&ptr);
 						fcount = get24bit(&ptr);
-						if (fcount<FLISTFIRSTINDX) {
-							c->fhead = fcount;
-						} else {
-							fl = flist_get(c->fhead = flist_alloc());
-							fl->sclassid = sclassid;
-							fl->fcount = fcount;
-							fl->nexti = FLISTNULLINDX;
-						}
+						fl = flist_get(*findxptr = flist_alloc());
+						fl->sclassid = sclassid;
+						fl->fcount = fcount;
+						fl->nexti = FLISTNULLINDX;
+						findxptr = &(fl->nexti);
+						pairs--;
+					}
+					sclassid = get8bit(&ptr);
+				} else {
+					sclassid = get8bit(&ptr);
+					fcount = get24bit(&ptr);
+					if (fcount<FLISTFIRSTINDX) {
+						c->fhead = fcount;
+					} else {
+						fl = flist_get(c->fhead = flist_alloc());
+						fl->sclassid = sclassid;
+						fl->fcount = fcount;
+						fl->nexti = FLISTNULLINDX;
 					}
-					chunk_state_set_sclass(c,sclassid);
 				}
-				chunk_state_set_flags(c,flags);
+				chunk_state_set_sclass(c,sclassid);
 			}
+			chunk_state_set_flags(c,cd->flags);
+		}
+	} else {
+		if (cd->version==0 && cd->lockedto==0 && cd->flags==0) {
+			return 1;
 		} else {
-			if (version==0 && lockedto==0 && flags==0) {
-				return 0;
-			} else {
-				mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"chunks: wrong ending - chunk zero with version: %"PRIu32" and locked to: %"PRIu32,version,lockedto);
-				return -1;
-			}
+			mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"chunks: wrong ending - chunk zero with version: %"PRIu32" and locked to: %"PRIu32,cd->version,cd->lockedto);
+			return -1;
 		}
 	}
-	return 0;	// unreachable
+	return 0;
+}
+
+int chunk_load(bio *fd,uint8_t mver,int ignoreflag) {
+	uint8_t hdr[8];
+	const uint8_t *ptr;
+	chunkload_state cs;
+	int s;
+
+	chunks = 0;
+	if (bio_read(fd,hdr,8)!=8) {
+		mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"chunks: can't read header");
+		return -1;
+	}
+	ptr = hdr;
+	nextchunkid = get64bit(&ptr);
+	cs.mver = mver;
+	cs.recsize = (mver==0x10)?16:(mver==0x11)?17:CHUNKFSIZE;
+	cs.ignoreflag = ignoreflag;
+	cs.nl = 1;
+	s = loadpipe_run_indexed(fd,sizeof(chunkload_dec),chunk_load_frame,chunk_load_decode,chunk_load_apply,&cs);
+	if (s==-2) {
+		mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"chunks: read error");
+	}
+	return (s<0)?-1:0;
 }
 
 // static uint32_t store_ref_timestamp;
@@ -8985,13 +9298,10 @@ int chunk_load(bio *fd,uint8_t mver,int ignoreflag) {
 //	store_ref_timestamp = ref_timestamp;
 // }
 
-uint8_t chunk_store(bio *fd) {
-	uint8_t hdr[8];
+static int chunk_store_record(bio *fd,chunk *c) {
 	uint8_t storebuff[CHUNKFSIZE];
 	uint8_t pairsbuff[CHUNKDSIZE];
 	uint8_t *ptr,*dptr;
-	uint32_t i;
-	chunk *c;
 // chunkdata
 	uint64_t chunkid;
 	uint32_t version;
@@ -9002,6 +9312,71 @@ uint8_t chunk_store(bio *fd) {
 	uint32_t findx;
 	flist *fl;
 
+	ptr = storebuff;
+	dptr = pairsbuff;
+	chunkid = c->chunkid;
+	put64bit(&ptr,chunkid);
+	version = c->version;
+	if (c->allowreadzeros) {
+		version |= 0x80000000;
+	}
+	put32bit(&ptr,version);
+	lockedto = c->lockedto;
+//	if (lockedto<store_ref_timestamp || c->operation==REPLICATE || c->operation==LOCALSPLIT) {
+//		lockedto = 0;
+//	}
+	put32bit(&ptr,lockedto);
+	flags = c->flags;
+	dynsize = 0;
+	if (c->fhead==FLISTNULLINDX) {
+		pairs = 0;
+	} else if (c->fhead<FLISTFIRSTINDX) {
+		pairs = 1;
+		put8bit(&dptr,c->sclassid);
+		put24bit(&dptr,c->fhead);
+		dynsize = 4;
+	} else {
+		pairs = 0;
+		for (findx = c->fhead ; pairs<CHUNKMAXPAIRS && findx!=FLISTNULLINDX ; findx=fl->nexti) {
+			fl = flist_get(findx);
+			put8bit(&dptr,fl->sclassid);
+			put24bit(&dptr,fl->fcount);
+			dynsize+=4;
+			pairs++;
+		}
+		if (findx!=FLISTNULLINDX) {
+			mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"chunks: too many classes to store !!! - serious data structure error");
+		}
+		if (pairs>1) {
+			put8bit(&dptr,c->sclassid);
+			dynsize++;
+		}
+	}
+	if (pairs>255) {
+		flags |= 0x80;
+		pairs &= 0xFF;
+	}
+	put8bit(&ptr,flags);
+	put8bit(&ptr,pairs);
+	if (bio_write(fd,storebuff,CHUNKFSIZE)!=CHUNKFSIZE) {
+		return -1;
+	}
+	if (dynsize>0) {
+		if (bio_write(fd,pairsbuff,dynsize)!=dynsize) {
+			return -1;
+		}
+	}
+	bio_record_end(fd);
+	return 0;
+}
+
+uint8_t chunk_store(bio *fd) {
+	uint8_t hdr[8];
+	uint8_t storebuff[CHUNKFSIZE];
+	uint8_t *ptr;
+	uint32_t i;
+	chunk *c;
+
 	if (fd==NULL) {
 		return 0x12;
 	}
@@ -9012,60 +9387,9 @@ uint8_t chunk_store(bio *fd) {
 	}
 	for (i=0 ; i<chunkrehashpos ; i++) {
 		for (c=chunkhashtab[i>>HASHTAB_LOBITS][i&HASHTAB_MASK] ; c ; c=c->next) {
-			ptr = storebuff;
-			dptr = pairsbuff;
-			chunkid = c->chunkid;
-			put64bit(&ptr,chunkid);
-			version = c->version;
-			if (c->allowreadzeros) {
-				version |= 0x80000000;
-			}
-			put32bit(&ptr,version);
-			lockedto = c->lockedto;
-//			if (lockedto<store_ref_timestamp || c->operation==REPLICATE || c->operation==LOCALSPLIT) {
-//				lockedto = 0;
-//			}
-			put32bit(&ptr,lockedto);
-			flags = c->flags;
-			dynsize = 0;
-			if (c->fhead==FLISTNULLINDX) {
-				pairs = 0;
-			} else if (c->fhead<FLISTFIRSTINDX) {
-				pairs = 1;
-				put8bit(&dptr,c->sclassid);
-				put24bit(&dptr,c->fhead);
-				dynsize = 4;
-			} else {
-				pairs = 0;
-				for (findx = c->fhead ; pairs<CHUNKMAXPAIRS && findx!=FLISTNULLINDX ; findx=fl->nexti) {
-					fl = flist_get(findx);
-					put8bit(&dptr,fl->sclassid);
-					put24bit(&dptr,fl->fcount);
-					dynsize+=4;
-					pairs++;
-				}
-				if (findx!=FLISTNULLINDX) {
-					mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"chunks: too many classes to store !!! - serious data structure error");
-				}
-				if (pairs>1) {
-					put8bit(&dptr,c->sclassid);
-					dynsize++;
-				}
-			}
-			if (pairs>255) {
-				flags |= 0x80;
-				pairs &= 0xFF;
-			}
-			put8bit(&ptr,flags);
-			put8bit(&ptr,pairs);
-			if (bio_write(fd,storebuff,CHUNKFSIZE)!=CHUNKFSIZE) {
+			if (chunk_store_record(fd,c)<0) {
 				return 0xFF;
 			}
-			if (dynsize>0) {
-				if (bio_write(fd,pairsbuff,dynsize)!=dynsize) {
-					return 0xFF;
-				}
-			}
 		}
 	}
 	memset(storebuff,0,CHUNKFSIZE);
@@ -9075,6 +9399,71 @@ uint8_t chunk_store(bio *fd) {
 	return 0;
 }
 
+/* incremental store */
+
+static void chunk_preserve_slow(chunk *c) {
+	c->storemark = storemarkcur;
+	if (incstore_fd!=NULL) { // write errors are checked by the owner of the stream
+		chunk_store_record(incstore_fd,c);
+	}
+}
+
+void chunk_incstore_begin(bio *fd) {
+	storemarkcur ^= 1;
+	incstore_fd = fd;
+	incstore_pos = 0;
+	incstore_nextchunkid = nextchunkid;
+}
+
+uint8_t chunk_incstore_header(bio *fd) {
+	uint8_t hdr[8];
+	uint8_t *ptr;
+
+	ptr = hdr;
+	put64bit(&ptr,incstore_nextchunkid);
+	incstore_fd = fd;
+	return (bio_write(fd,hdr,8)!=8)?0xFF:0;
+}
+
+int chunk_incstore_step(uint32_t steps) {
+	uint8_t storebuff[CHUNKFSIZE];
+	chunk *c;
+
+	while (incstore_pos<chunkrehashpos) {
+		for (c=chunkhashtab[incstore_pos>>HASHTAB_LOBITS][incstore_pos&HASHTAB_MASK] ; c ; c=c->next) {
+			if (c->storemark!=storemarkcur) {
+				c->storemark = storemarkcur;
+				chunk_store_record(incstore_fd,c);
+			}
+			if (steps>0) {
+				steps--;
+			}
+		}
+		incstore_pos++;
+		if (steps==0) {
+			return 0;
+		}
+	}
+	memset(storebuff,0,CHUNKFSIZE);
+	bio_write(incstore_fd,storebuff,CHUNKFSIZE);
+	incstore_fd = NULL;
+	return 1;
+}
+
+void chunk_incstore_cancel(void) {
+	uint32_t i;
+	chunk *c;
+
+	if (incstore_fd!=NULL) {
+		for (i=0 ; i<chunkrehashpos ; i++) {
+			for (c=chunkhashtab[i>>HASHTAB_LOBITS][i&HASHTAB_MASK] ; c ; c=c->next) {
+				c->storemark = storemarkcur;
+			}
+		}
+		incstore_fd = NULL;
+	}
+}
+
 void chunk_cleanup(void) {
 	uint32_t i,j;
 	discserv *ds;
@@ -9198,6 +9587,7 @@ int chunk_parse_rep_list(char *strlist,double *replist) {
 
 void chunk_term(void) {
 	uint32_t i;
+	chunk_scan_term();
 	chunk_calculate_endanger_priority(NULL,1); // free tabs
 	chunk_do_jobs(NULL,JOBS_TERM,main_time(),0); // free tabs
 	for (i=0 ; i<MAXSCLASS*4 ; i++) {
@@ -9266,6 +9656,11 @@ void chunk_load_cfg_common(void) {
 	}
 	TicksPerSecond = 1000/JobsTimerMilliSeconds;
 
+	ChunksLoopThreads = cfg_getuint32("CHUNKS_LOOP_THREADS",0);
+	if (ChunksLoopThreads>SCAN_MAX_THREADS) {
+		ChunksLoopThreads = SCAN_MAX_THREADS;
+	}
+
 	MaxFailsPerClass = cfg_getuint32("MAX_FAILS_PER_CLASS",5); // debug option
 
 	FailClassCounterResetCalls = cfg_getuint32("FAIL_CLASS_COUNTER_RESET_CALLS",1); // debug option
@@ -9284,6 +9679,20 @@ void chunk_loginfo(FILE *fd) {
 	fprintf(fd,"Hash Chunks Per Tick: %u\n",HashCPTMax);
 	fprintf(fd,"Max Fails Per Class: %u\n",MaxFailsPerClass);
 	fprintf(fd,"Max Rebalance Fails Per Class: %u\n",MaxRebalanceFails);
+	fprintf(fd,"Scan Threads: %u\n",ChunksLoopThreads);
+	fprintf(fd,"\n");
+	fprintf(fd,"[chunk loops]\n");
+	if (chunksinfo_loopend>chunksinfo_loopstart && chunksinfo_loopstart>0) {
+		fprintf(fd,"standard loop: last duration: %"PRIu32" s\n",chunksinfo_loopend-chunksinfo_loopstart);
+	} else {
+		fprintf(fd,"standard loop: not finished yet\n");
+	}
+	if (ChunksLoopThreads>0 || scan_loops>0) {
+		fprintf(fd,"danger scan: loops: %"PRIu32" ; position: %"PRIu32"/%"PRIu32"\n",scan_loops,scan_pos,chunkrehashpos);
+		if (scan_loops>0) {
+			fprintf(fd,"danger scan: last loop (finished at %"PRIu32"): duration: %.3lf s ; time in scan phases: %.3lf s ; chunks: %"PRIu64" ; enqueued: %"PRIu64"\n",scan_lastloopend,scan_lastloopusec/1000000.0,scan_lastloopphaseusec/1000000.0,scan_lastloopchunks,scan_lastloopfound);
+		}
+	}
 	fprintf(fd,"\n");
 	fprintf(fd,"[chunks]\n");
 	for (i=0 ; i<DANGER_PRIORITIES ; i++) {
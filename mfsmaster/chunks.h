@@ -115,6 +115,7 @@ uint8_t chunk_get_mfrstatus(uint16_t csid);
 uint16_t chunk_server_connected(void *ptr);
 
 void chunk_server_has_chunk(uint16_t csid,uint64_t chunkid,uint8_t ecid,uint32_t version);
+void chunk_server_has_chunks(uint16_t csid,const uint64_t *chunkids,const uint32_t *versions,uint32_t count);
 void chunk_damaged(uint16_t csid,uint64_t chunkid,uint8_t ecid);
 void chunk_lost(uint16_t csid,uint64_t chunkid,uint8_t ecid,uint8_t report);
 void chunk_server_register_end(uint16_t csid);
@@ -148,6 +149,12 @@ void chunk_get_memusage(uint64_t allocated[6],uint64_t used[6]);
 uint8_t chunk_is_afterload_needed(uint8_t mver);
 int chunk_load(bio *fd,uint8_t mver,int ignoreflag);
 uint8_t chunk_store(bio *fd);
+// incremental store: chunks modified before 'chunk_incstore_header' are written to 'spoolfd' given to 'chunk_incstore_begin',
+// later ones to the section stream ; chunk_incstore_step returns 1 when all chunks have been stored
+void chunk_incstore_begin(bio *spoolfd);
+uint8_t chunk_incstore_header(bio *fd);
+int chunk_incstore_step(uint32_t steps);
+void chunk_incstore_cancel(void);
 void chunk_cleanup(void);
 void chunk_newfs(void);
 int chunk_strinit(void);
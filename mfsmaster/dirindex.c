@@ -0,0 +1,261 @@
+/*
+ * Copyright (C) 2026 Jakub Kruszona-Zawadzki, Saglabs SA
+ * 
+ * This file is part of MooseFS.
+ * 
+ * MooseFS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 (only).
+ * 
+ * MooseFS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "massert.h"
+#include "dirindex.h"
+
+// two level B+tree - sorted leaves (up to LEAF_SIZE keys each) and sorted table of first keys of leaves
+// new entries in directory always get the lowest edgeid, so full leaves are not split when adding in front
+// (leaves stay full in such case)
+
+#define LEAF_SIZE 255
+#define LEAF_MERGE ((LEAF_SIZE*3)/4)
+
+typedef struct _dileaf {
+	uint32_t cnt;
+	uint64_t keys[LEAF_SIZE];
+	void *ptrs[LEAF_SIZE];
+} dileaf;
+
+typedef struct _dirindex {
+	uint64_t *firstkeys;
+	dileaf **leaves;
+	uint32_t leafcnt;
+	uint32_t leafsize;
+	uint64_t elements;
+} dirindex;
+
+void* dirindex_new(void) {
+	dirindex *di;
+	di = malloc(sizeof(dirindex));
+	passert(di);
+	di->firstkeys = NULL;
+	di->leaves = NULL;
+	di->leafcnt = 0;
+	di->leafsize = 0;
+	di->elements = 0;
+	return di;
+}
+
+void dirindex_free(void *o) {
+	dirindex *di = (dirindex*)o;
+	uint32_t i;
+	for (i=0 ; i<di->leafcnt ; i++) {
+		free(di->leaves[i]);
+	}
+	free(di->leaves);
+	free(di->firstkeys);
+	free(di);
+}
+
+// last leaf with first key <= key (or first leaf)
+static inline uint32_t dirindex_findleaf(dirindex *di,uint64_t key) {
+	uint32_t l,r,m;
+	l = 0;
+	r = di->leafcnt;
+	while (r-l>1) {
+		m = (l+r)/2;
+		if (di->firstkeys[m]<=key) {
+			l = m;
+		} else {
+			r = m;
+		}
+	}
+	return l;
+}
+
+// first position in leaf with key >= given key
+static inline uint32_t dirindex_leafpos(dileaf *dl,uint64_t key) {
+	uint32_t l,r,m;
+	l = 0;
+	r = dl->cnt;
+	while (l<r) {
+		m = (l+r)/2;
+		if (dl->keys[m]<key) {
+			l = m+1;
+		} else {
+			r = m;
+		}
+	}
+	return l;
+}
+
+static inline dileaf* dirindex_newleaf(dirindex *di,uint32_t lpos) {
+	dileaf *dl;
+	if (di->leafcnt>=di->leafsize) {
+		di->leafsize = (di->leafsize>0)?di->leafsize*2:16;
+		di->leaves = realloc(di->leaves,sizeof(dileaf*)*di->leafsize);
+		di->firstkeys = realloc(di->firstkeys,sizeof(uint64_t)*di->leafsize);
+		passert(di->leaves);
+		passert(di->firstkeys);
+	}
+	dl = malloc(sizeof(dileaf));
+	passert(dl);
+	dl->cnt = 0;
+	if (lpos<di->leafcnt) {
+		memmove(di->leaves+lpos+1,di->leaves+lpos,sizeof(dileaf*)*(di->leafcnt-lpos));
+		memmove(di->firstkeys+lpos+1,di->firstkeys+lpos,sizeof(uint64_t)*(di->leafcnt-lpos));
+	}
+	di->leaves[lpos] = dl;
+	di->leafcnt++;
+	return dl;
+}
+
+static inline void dirindex_removeleaf(dirindex *di,uint32_t lpos) {
+	free(di->leaves[lpos]);
+	di->leafcnt--;
+	if (lpos<di->leafcnt) {
+		memmove(di->leaves+lpos,di->leaves+lpos+1,sizeof(dileaf*)*(di->leafcnt-lpos));
+		memmove(di->firstkeys+lpos,di->firstkeys+lpos+1,sizeof(uint64_t)*(di->leafcnt-lpos));
+	}
+}
+
+void dirindex_insert(void *o,uint64_t key,void *ptr) {
+	dirindex *di = (dirindex*)o;
+	dileaf *dl,*nl;
+	uint32_t lpos,pos,half;
+
+	if (di->leafcnt==0) {
+		dirindex_newleaf(di,0);
+	}
+	lpos = dirindex_findleaf(di,key);
+	dl = di->leaves[lpos];
+	pos = dirindex_leafpos(dl,key);
+	if (dl->cnt==LEAF_SIZE) {
+		if (pos==0) { // new first key - separate leaf (typical case - new edges have the lowest ids)
+			if (lpos>0 && di->leaves[lpos-1]->cnt<LEAF_SIZE) {
+				lpos--;
+				dl = di->leaves[lpos];
+				pos = dl->cnt;
+			} else {
+				dl = dirindex_newleaf(di,lpos);
+			}
+		} else if (pos==LEAF_SIZE) {
+			if (lpos+1<di->leafcnt && di->leaves[lpos+1]->cnt<LEAF_SIZE) {
+				lpos++;
+				dl = di->leaves[lpos];
+			} else {
+				lpos++;
+				dl = dirindex_newleaf(di,lpos);
+			}
+			pos = 0;
+		} else {
+			nl = dirindex_newleaf(di,lpos+1);
+			half = LEAF_SIZE/2;
+			memcpy(nl->keys,dl->keys+half,sizeof(uint64_t)*(LEAF_SIZE-half));
+			memcpy(nl->ptrs,dl->ptrs+half,sizeof(void*)*(LEAF_SIZE-half));
+			nl->cnt = LEAF_SIZE-half;
+			dl->cnt = half;
+			di->firstkeys[lpos+1] = nl->keys[0];
+			if (pos>half) {
+				lpos++;
+				dl = nl;
+				pos -= half;
+			}
+		}
+	}
+	if (pos<dl->cnt) {
+		memmove(dl->keys+pos+1,dl->keys+pos,sizeof(uint64_t)*(dl->cnt-pos));
+		memmove(dl->ptrs+pos+1,dl->ptrs+pos,sizeof(void*)*(dl->cnt-pos));
+	}
+	dl->keys[pos] = key;
+	dl->ptrs[pos] = ptr;
+	dl->cnt++;
+	di->firstkeys[lpos] = dl->keys[0];
+	di->elements++;
+}
+
+uint8_t dirindex_delete(void *o,uint64_t key,void *ptr) {
+	dirindex *di = (dirindex*)o;
+	dileaf *dl,*nl;
+	uint32_t lpos,pos;
+
+	if (di->leafcnt==0) {
+		return 0;
+	}
+	lpos = dirindex_findleaf(di,key);
+	dl = di->leaves[lpos];
+	pos = dirindex_leafpos(dl,key);
+	while (pos<dl->cnt && dl->keys[pos]==key && dl->ptrs[pos]!=ptr) {
+		pos++;
+	}
+	if (pos>=dl->cnt || dl->keys[pos]!=key) {
+		return 0;
+	}
+	dl->cnt--;
+	if (pos<dl->cnt) {
+		memmove(dl->keys+pos,dl->keys+pos+1,sizeof(uint64_t)*(dl->cnt-pos));
+		memmove(dl->ptrs+pos,dl->ptrs+pos+1,sizeof(void*)*(dl->cnt-pos));
+	}
+	di->elements--;
+	if (dl->cnt==0) {
+		dirindex_removeleaf(di,lpos);
+		return 1;
+	}
+	di->firstkeys[lpos] = dl->keys[0];
+	// merge with the next leaf when both are sparse
+	if (lpos+1<di->leafcnt) {
+		nl = di->leaves[lpos+1];
+		if (dl->cnt+nl->cnt<=LEAF_MERGE) {
+			memcpy(dl->keys+dl->cnt,nl->keys,sizeof(uint64_t)*nl->cnt);
+			memcpy(dl->ptrs+dl->cnt,nl->ptrs,sizeof(void*)*nl->cnt);
+			dl->cnt += nl->cnt;
+			dirindex_removeleaf(di,lpos+1);
+		}
+	}
+	return 1;
+}
+
+void* dirindex_lowerbound(void *o,uint64_t key) {
+	dirindex *di = (dirindex*)o;
+	dileaf *dl;
+	uint32_t lpos,pos;
+
+	if (di->leafcnt==0) {
+		return NULL;
+	}
+	lpos = dirindex_findleaf(di,key);
+	dl = di->leaves[lpos];
+	pos = dirindex_leafpos(dl,key);
+	if (pos<dl->cnt) {
+		return dl->ptrs[pos];
+	}
+	if (lpos+1<di->leafcnt) {
+		return di->leaves[lpos+1]->ptrs[0];
+	}
+	return NULL;
+}
+
+uint64_t dirindex_elements(void *o) {
+	dirindex *di = (dirindex*)o;
+	return di->elements;
+}
+
+uint64_t dirindex_memusage(void *o) {
+	dirindex *di = (dirindex*)o;
+	return sizeof(dirindex)+(uint64_t)(di->leafsize)*(sizeof(dileaf*)+sizeof(uint64_t))+(uint64_t)(di->leafcnt)*sizeof(dileaf);
+}
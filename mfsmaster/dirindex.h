@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2026 Jakub Kruszona-Zawadzki, Saglabs SA
+ * 
+ * This file is part of MooseFS.
+ * 
+ * MooseFS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 (only).
+ * 
+ * MooseFS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DIRINDEX_H_
+#define _DIRINDEX_H_
+
+#include <inttypes.h>
+
+// ordered index of directory entries (key - edgeid) used by huge directories
+
+void* dirindex_new(void);
+void dirindex_free(void *o);
+void dirindex_insert(void *o,uint64_t key,void *ptr);
+uint8_t dirindex_delete(void *o,uint64_t key,void *ptr);
+void* dirindex_lowerbound(void *o,uint64_t key);
+uint64_t dirindex_elements(void *o);
+uint64_t dirindex_memusage(void *o);
+
+#endif
@@ -38,6 +38,7 @@
 #include <sys/stat.h>
 #include <inttypes.h>
 #include <errno.h>
+#include <pthread.h>
 #ifdef HAVE_SYS_MMAN_H
 #include <sys/mman.h>
 #endif
@@ -53,8 +54,10 @@
 #include "appendres.h"
 #include "openfiles.h"
 #include "xattr.h"
+#include "dictionary.h"
 #include "posixacl.h"
 #include "bio.h"
+#include "loadpipe.h"
 #include "metadata.h"
 #include "datapack.h"
 #include "mfslog.h"
@@ -72,12 +75,16 @@
 #include "patterns.h"
 #include "missinglog.h"
 #include "random.h"
+#include "dirindex.h"
 
-#define HASHTAB_LOBITS 24
-#define HASHTAB_HISIZE (0x80000000>>(HASHTAB_LOBITS))
-#define HASHTAB_LOSIZE (1<<HASHTAB_LOBITS)
-#define HASHTAB_MASK (HASHTAB_LOSIZE-1)
-#define HASHTAB_MOVEFACTOR 5
+// inode numbers are dense (lowest free one is always taken), so nodes are indexed directly by inode number
+#define NODEINDEX_LOBITS 16
+#define NODEINDEX_HISIZE (0x80000000>>(NODEINDEX_LOBITS))
+#define NODEINDEX_LOSIZE (1<<NODEINDEX_LOBITS)
+#define NODEINDEX_MASK (NODEINDEX_LOSIZE-1)
+
+// directories with that many children get edgeid index (see fsnodes_dir_seek) - it's dropped below half of it
+#define DIRINDEX_MIN_ELEMENTS 4096
 
 #define DEFAULT_SCLASS 1
 #define DEFAULT_TRASHTIME 24
@@ -106,7 +113,6 @@ typedef struct _fsedge {
 	struct _fsnode *child,*parent;
 	struct _fsedge *nextchild,*nextparent;
 	struct _fsedge **prevchild,**prevparent;
-	struct _fsedge *next;
 	uint64_t edgeid;
 	uint32_t hashval;
 	uint16_t nleng;
@@ -144,24 +150,29 @@ static uint8_t AtimeMode;
 static uint8_t KeepEmptyFilesInTrash;
 static uint32_t InodeReuseDelay;
 
+// fields used by lookups and permission checks go first - file node (the most common one) takes exactly one cache line
+// nodes are found by inode index (see fsnodes_node_find), so there is no hash chain pointer here
 typedef struct _fsnode {
 	uint32_t inode;
-	uint32_t ctime,mtime,atime;
-	uint32_t uid;
-	uint32_t gid;
 	unsigned xattrflag:1;
 	unsigned aclpermflag:1;
 	unsigned acldefflag:1;
 	unsigned keepmode:1;
 	unsigned type:4;
 	unsigned mode:12;
+	unsigned storemark:1;			// incremental store - see fsnodes_preserve
+	unsigned edgemark:1;
+	unsigned winattr:8;
+	unsigned dirindexed:1;			// directory has an entry in dirindex hash
+	uint32_t uid;
+	uint32_t gid;
+	uint32_t ctime,mtime,atime;
 	uint8_t sclassid;
 	uint8_t eattr;
-	uint8_t winattr;
 	uint16_t trashretention;
 	fsedge *parents;
-	struct _fsnode *next;
 	union _data {
+		struct _fsnode *nextfree;		// unused node (see fsnode_free)
 		struct _ddata {				// type==TYPE_DIRECTORY
 			fsedge *children;
 			uint32_t nlink;
@@ -214,21 +225,21 @@ static fsedge *trash[TRASH_BUCKETS];
 static fsedge *sustained[SUSTAINED_BUCKETS];
 static fsnode *root;
 
-static fsedge **edgehashtab[HASHTAB_HISIZE];
-static uint32_t edgerehashpos;
-static uint32_t edgehashsize;
-static uint32_t edgehashelem;
-
-static fsnode **nodehashtab[HASHTAB_HISIZE];
-static uint32_t noderehashpos;
-static uint32_t nodehashsize;
-static uint32_t nodehashelem;
+static fsnode **nodeindex[NODEINDEX_HISIZE];
+static uint32_t nodeindexslots;	// (highest allocated page + 1) * NODEINDEX_LOSIZE
+static uint32_t nodeindexpages;
+static uint32_t nodeindexelem;
 
 static uint32_t hashelements;
 static uint32_t maxnodeid;
 static uint32_t nodes;
 static uint64_t nextedgeid;
 static uint8_t edgesneedrenumeration;
+static uint64_t takenedgeid; // after renumeration nextedgeid is also used by one of edges (incremental store can't be done then)
+
+// incremental metadata store - nodes with 'storemark' different than 'storemarkcur' haven't been stored yet, edges are
+// stored by parents (directories) or by children (trash and sustained) and 'edgemark' says if this has already happened
+static uint8_t storemarkcur;
 
 static uint64_t trashspace;
 static uint64_t sustainedspace;
@@ -240,6 +251,14 @@ static uint32_t dirnodes;
 static uint64_t *edgeid_id_hashtab;
 static fsedge **edgeid_ptr_hashtab;
 
+// read-only phase (fs_readers_begin/fs_readers_end) - changes wanted by readers are postponed till the end of the phase
+static uint8_t fsreaders;
+static pthread_mutex_t fsreaderslock = PTHREAD_MUTEX_INITIALIZER;
+static fsnode **fsreaders_atime = NULL;
+static uint32_t fsreaders_atimecnt = 0,fsreaders_atimesize = 0;
+static fsedge **fsreaders_edges = NULL;
+static uint32_t fsreaders_edgescnt = 0,fsreaders_edgessize = 0;
+
 static void *snapshot_inodehash;
 
 #define MSGBUFFSIZE 1000000
@@ -356,12 +375,13 @@ CREATE_BUCKET_ALLOCATOR(quotanode,quotanode,10000000/sizeof(quotanode))
 #define fsnode_other_free(n) fsnode_free(n,4)
 
 #define NODE_BUCKET_SIZE 10000000
+#define NODE_BUCKET_HEADER 64
 #define NODE_MAX_INDX 5
 
+// nodes start NODE_BUCKET_HEADER bytes after the beginning of the bucket - with page aligned buckets they are cache line aligned
 typedef struct _fsnode_bucket {
 	uint32_t firstfree;
 	struct _fsnode_bucket *next;
-	uint8_t bucket[1];
 } fsnode_bucket;
 
 static fsnode_bucket *nrbheads[NODE_MAX_INDX];
@@ -379,6 +399,8 @@ static inline void fsnode_init(void) {
 	nrelemsize[3] = offsetof(fsnode,data)+offsetof(struct _devdata,end);
 	nrelemsize[4] = offsetof(fsnode,data)+offsetof(struct _odata,end);
 	for (i=0 ; i<NODE_MAX_INDX ; i++) {
+		// keep nodes aligned (room for 'nextfree' is also guaranteed this way)
+		nrelemsize[i] = (nrelemsize[i]+7) & ~7U;
 		nrbheads[i] = NULL;
 		nrbfreeheads[i] = NULL;
 		nrbucketsize[i] = (NODE_BUCKET_SIZE / nrelemsize[i]) * nrelemsize[i];
@@ -395,7 +417,7 @@ static inline void fsnode_cleanup(void) {
 		for (nrb = nrbheads[i] ; nrb ; nrb=nnrb) {
 			nnrb = nrb->next;
 #ifdef BUCKETS_MMAP_ALLOC
-			munmap(nrb,offsetof(fsnode_bucket,bucket)+nrbucketsize[i]);
+			munmap(nrb,NODE_BUCKET_HEADER+nrbucketsize[i]);
 #else
 			free(nrb);
 #endif
@@ -413,30 +435,36 @@ static inline fsnode* fsnode_malloc(uint8_t indx) {
 	sassert(indx<NODE_MAX_INDX);
 	if (nrbfreeheads[indx]) {
 		ret = nrbfreeheads[indx];
-		nrbfreeheads[indx] = ret->next;
+		nrbfreeheads[indx] = ret->data.nextfree;
 		fsnode_used += nrelemsize[indx];
+		ret->storemark = storemarkcur;
+		ret->edgemark = storemarkcur;
+		ret->dirindexed = 0;
 		return ret;
 	}
 	if (nrbheads[indx]==NULL || nrbheads[indx]->firstfree + nrelemsize[indx] > nrbucketsize[indx]) {
 #ifdef BUCKETS_MMAP_ALLOC
-		nrb = (fsnode_bucket*)mmap(NULL,offsetof(fsnode_bucket,bucket)+nrbucketsize[indx],PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE,-1,0);
+		nrb = (fsnode_bucket*)mmap(NULL,NODE_BUCKET_HEADER+nrbucketsize[indx],PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE,-1,0);
 #else
-		nrb = (fsnode_bucket*)malloc(offsetof(fsnode_bucket,bucket)+nrbucketsize[indx]);
+		nrb = (fsnode_bucket*)malloc(NODE_BUCKET_HEADER+nrbucketsize[indx]);
 #endif
 		passert(nrb);
 		nrb->next = nrbheads[indx];
 		nrb->firstfree = 0;
 		nrbheads[indx] = nrb;
-		fsnode_allocated += (offsetof(fsnode_bucket,bucket)+nrbucketsize[indx]);
+		fsnode_allocated += (NODE_BUCKET_HEADER+nrbucketsize[indx]);
 	}
-	ret = (fsnode*)((nrbheads[indx]->bucket) + (nrbheads[indx]->firstfree));
+	ret = (fsnode*)(((uint8_t*)(nrbheads[indx])) + NODE_BUCKET_HEADER + (nrbheads[indx]->firstfree));
 	nrbheads[indx]->firstfree += nrelemsize[indx];
 	fsnode_used += nrelemsize[indx];
+	ret->storemark = storemarkcur;
+	ret->edgemark = storemarkcur;
+	ret->dirindexed = 0;
 	return ret;
 }
 
 static inline void fsnode_free(fsnode *n,uint8_t indx) {
-	n->next = nrbfreeheads[indx];
+	n->data.nextfree = nrbfreeheads[indx];
 	nrbfreeheads[indx] = n;
 	fsnode_used -= nrelemsize[indx];
 }
@@ -446,6 +474,30 @@ static inline void fsnode_getusage(uint64_t *allocated,uint64_t *used) {
 	*used = fsnode_used;
 }
 
+static void fsnodes_preserve_slow(fsnode *p);
+
+// has to be called before any change of data stored in metadata file (node record or trash/sustained edge)
+static inline void fsnodes_preserve(fsnode *p) {
+	if (p->storemark!=storemarkcur || (p->type!=TYPE_DIRECTORY && p->edgemark!=storemarkcur)) {
+		fsnodes_preserve_slow(p);
+	}
+}
+
+static void fsnodes_preserve_edge_slow(fsedge *e);
+
+// has to be called before removing an edge
+static inline void fsnodes_preserve_edge(fsedge *e) {
+	if (e->parent!=NULL) {
+		if (e->parent->edgemark!=storemarkcur) {
+			fsnodes_preserve_edge_slow(e);
+		}
+		fsnodes_preserve(e->parent);
+	}
+	if (e->child!=NULL) {
+		fsnodes_preserve(e->child);
+	}
+}
+
 
 
 
@@ -508,7 +560,7 @@ static inline fsedge* fsedge_malloc(uint16_t nleng) {
 	sassert(indx<EDGE_MAX_INDX);
 	if (erbfreeheads[indx]) {
 		ret = erbfreeheads[indx];
-		erbfreeheads[indx] = ret->next;
+		erbfreeheads[indx] = ret->nextchild;
 		fsedge_used += EDGE_REC_SIZE(indx);
 		return ret;
 	}
@@ -532,7 +584,7 @@ static inline fsedge* fsedge_malloc(uint16_t nleng) {
 
 static inline void fsedge_free(fsedge *e,uint16_t nleng) {
 	uint16_t indx = EDGE_REC_INDX(nleng);
-	e->next = erbfreeheads[indx];
+	e->nextchild = erbfreeheads[indx];
 	erbfreeheads[indx] = e;
 	fsedge_used -= EDGE_REC_SIZE(indx);
 }
@@ -784,27 +836,6 @@ static inline void chunktab_getusage(uint64_t *allocated,uint64_t *used) {
 
 
 
-void fs_get_memusage(uint64_t allocated[8],uint64_t used[8]) {
-	allocated[0] = sizeof(fsedge*)*edgerehashpos;
-	used[0] = sizeof(fsedge*)*edgehashelem;
-	fsedge_getusage(allocated+1,used+1);
-	allocated[2] = sizeof(fsnode*)*noderehashpos;
-	used[2] = sizeof(fsnode*)*nodehashelem;
-	fsnode_getusage(allocated+3,used+3);
-	freenode_getusage(allocated+4,used+4);
-	chunktab_getusage(allocated+5,used+5);
-	symlink_getusage(allocated+6,used+6);
-	quotanode_getusage(allocated+7,used+7);
-//	statsrec_getusage(allocated+7,used+7);
-}
-
-
-
-
-
-
-
-
 
 
 uint32_t fsnodes_get_next_id(void) {
@@ -984,184 +1015,69 @@ static inline uint32_t fsnodes_hash(uint32_t parentid,uint16_t nleng,const uint8
 	return hash;
 }
 
-static inline uint32_t fsnodes_calc_hash_size(uint32_t elements) {
-	uint32_t res=1;
-	while (elements) {
-		elements>>=1;
-		res<<=1;
-	}
-	if (res==0) {
-		res = UINT32_C(0x80000000);
-	}
-	if (res<HASHTAB_LOSIZE) {
-		return HASHTAB_LOSIZE;
-	}
-	return res;
-}
+#define ENTRY_TYPE fsedge
+#define GLUE_FN_NAME_PREFIX(Y) GLUE(fsnodes_edgetab,Y)
+#define GLUE_HASH_TAB_PREFIX(Y) GLUE(edgetab,Y)
+#define HASH_ARGS_TYPE_LIST fsnode *node,uint16_t nleng,const uint8_t *name
+#define HASH_ARGS_LIST node,nleng,name
+#define HASH_VALUE_FIELD hashval
 
-static inline void fsnodes_edge_hash_init(void) {
-	uint16_t i;
-	edgehashsize = 0;
-	edgehashelem = 0;
-	edgerehashpos = 0;
-	for (i=0 ; i<HASHTAB_HISIZE ; i++) {
-		edgehashtab[i] = NULL;
-	}
+static inline int fsnodes_edgetab_cmp(fsedge *e,fsnode *node,uint16_t nleng,const uint8_t *name) {
+	return (e->parent==node && e->nleng==nleng && memcmp((char*)(e->name),(char*)name,nleng)==0)?1:0;
 }
 
-static inline void fsnodes_edge_hash_cleanup(void) {
-	uint16_t i;
-	edgehashelem = 0;
-	edgehashsize = 0;
-	edgerehashpos = 0;
-	for (i=0 ; i<HASHTAB_HISIZE ; i++) {
-		if (edgehashtab[i]!=NULL) {
-#ifdef HAVE_MMAP
-			munmap(edgehashtab[i],sizeof(fsedge*)*HASHTAB_LOSIZE);
-#else
-			free(edgehashtab[i]);
-#endif
-		}
-		edgehashtab[i] = NULL;
-	}
+static inline uint32_t fsnodes_edgetab_hash(fsnode *node,uint16_t nleng,const uint8_t *name) {
+	return fsnodes_hash(node->inode,nleng,name);
 }
 
-static inline void fsnodes_edge_hash_rehash(void) {
-	uint16_t i;
-	edgerehashpos = edgehashsize;
-	edgehashsize *= 2;
-	for (i=(edgehashsize>>HASHTAB_LOBITS)/2 ; i<edgehashsize>>HASHTAB_LOBITS ; i++) {
-#ifdef HAVE_MMAP
-		edgehashtab[i] = mmap(NULL,sizeof(fsedge*)*HASHTAB_LOSIZE,PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE,-1,0);
-#else
-		edgehashtab[i] = malloc(sizeof(fsedge*)*HASHTAB_LOSIZE);
-#endif
-		passert(edgehashtab[i]);
-	}
+#include "swisshash_begin.h"
+#include "swisshash_end.h"
+
+#undef ENTRY_TYPE
+#undef GLUE_FN_NAME_PREFIX
+#undef GLUE_HASH_TAB_PREFIX
+#undef HASH_ARGS_TYPE_LIST
+#undef HASH_ARGS_LIST
+#undef HASH_VALUE_FIELD
+
+static inline void fsnodes_edge_hash_init(void) {
+	fsnodes_edgetab_hash_init();
 }
 
-static inline void fsnodes_edge_hash_move(void) {
-	uint32_t hash;
-	uint32_t mask;
-	uint32_t moved=0;
-	fsedge **ehptr,**ehptralt,*e;
-	mask = edgehashsize-1;
-	do {
-		if (edgerehashpos>=edgehashsize) { // rehash complete
-			edgerehashpos = edgehashsize;
-			return;
-		}
-		ehptr = edgehashtab[(edgerehashpos - (edgehashsize/2)) >> HASHTAB_LOBITS] + (edgerehashpos & HASHTAB_MASK);
-		ehptralt = edgehashtab[edgerehashpos >> HASHTAB_LOBITS] + (edgerehashpos & HASHTAB_MASK);
-		*ehptralt = NULL;
-		while ((e=*ehptr)!=NULL) {
-			hash = e->hashval & mask;
-			if (hash==edgerehashpos) {
-				*ehptralt = e;
-				*ehptr = e->next;
-				ehptralt = &(e->next);
-				e->next = NULL;
-			} else {
-				ehptr = &(e->next);
-			}
-			moved++;
-		}
-		edgerehashpos++;
-	} while (moved<HASHTAB_MOVEFACTOR);
+static inline void fsnodes_edge_hash_cleanup(void) {
+	fsnodes_edgetab_hash_cleanup();
 }
 
 static inline fsedge* fsnodes_edge_find(fsnode *node,uint16_t nleng,const uint8_t *name) {
-	fsedge *e;
-	uint32_t hash;
-	uint32_t hashval;
-
-	if (edgehashsize==0) {
-		return NULL;
-	}
-	hashval = fsnodes_hash(node->inode,nleng,name);
-	hash = hashval & (edgehashsize-1);
-	if (edgerehashpos<edgehashsize) {
-		fsnodes_edge_hash_move();
-		if (hash >= edgerehashpos) {
-			hash -= edgehashsize/2;
-		}
-	}
-	for (e=edgehashtab[hash>>HASHTAB_LOBITS][hash&HASHTAB_MASK] ; e ; e=e->next) {
-		if (e->parent==node && e->hashval==hashval && e->nleng==nleng && memcmp((char*)(e->name),(char*)name,nleng)==0) {
-			return e;
-		}
-	}
-	return NULL;
+	return fsnodes_edgetab_find(node,nleng,name);
 }
 
 static inline void fsnodes_edge_delete(fsedge *e) {
-	fsedge **ehptr,*eit;
-	uint32_t hash;
+	fsnodes_edgetab_delete(e);
+}
 
-	if (edgehashsize==0) {
-		return;
-	}
-	hash = (e->hashval) & (edgehashsize-1);
-	if (edgerehashpos<edgehashsize) {
-		fsnodes_edge_hash_move();
-		if (hash >= edgerehashpos) {
-			hash -= edgehashsize/2;
-		}
-	}
-	ehptr = edgehashtab[hash>>HASHTAB_LOBITS] + (hash&HASHTAB_MASK);
-	while ((eit=*ehptr)!=NULL) {
-		if (eit==e) {
-			*ehptr = e->next;
-			edgehashelem--;
-			return;
-		}
-		ehptr = &(eit->next);
-	}
+/* 'hashval' has to be equal to fsnodes_hash(e->parent->inode,e->nleng,e->name) */
+static inline void fsnodes_edge_add_hashed(fsedge *e,uint32_t hashval) {
+	e->hashval = hashval;
+	fsnodes_edgetab_hash_presize(hashelements);
+	fsnodes_edgetab_add(e);
 }
 
-static inline void fsnodes_edge_add(fsedge *e) {
-	uint16_t i;
-	uint32_t hash;
+void fs_get_memusage(uint64_t allocated[8],uint64_t used[8]) {
+	fsnodes_edgetab_hash_getusage(allocated,used);
+	fsedge_getusage(allocated+1,used+1);
+	allocated[2] = sizeof(fsnode*)*NODEINDEX_LOSIZE*nodeindexpages;
+	used[2] = sizeof(fsnode*)*nodeindexelem;
+	fsnode_getusage(allocated+3,used+3);
+	freenode_getusage(allocated+4,used+4);
+	chunktab_getusage(allocated+5,used+5);
+	symlink_getusage(allocated+6,used+6);
+	quotanode_getusage(allocated+7,used+7);
+//	statsrec_getusage(allocated+7,used+7);
+}
 
-	if (edgehashsize==0) {
-		edgehashsize = fsnodes_calc_hash_size(hashelements);
-		edgerehashpos = edgehashsize;
-		edgehashelem = 0;
-		for (i=0 ; i<edgehashsize>>HASHTAB_LOBITS ; i++) {
-#ifdef HAVE_MMAP
-			edgehashtab[i] = mmap(NULL,sizeof(fsedge*)*HASHTAB_LOSIZE,PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE,-1,0);
-#else
-			edgehashtab[i] = malloc(sizeof(fsedge*)*HASHTAB_LOSIZE);
-#endif
-			passert(edgehashtab[i]);
-			memset(edgehashtab[i],0,sizeof(fsedge*));
-			if (edgehashtab[i][0]==NULL) {
-				memset(edgehashtab[i],0,sizeof(fsedge*)*HASHTAB_LOSIZE);
-			} else {
-				for (hash=0 ; hash<HASHTAB_LOSIZE ; hash++) {
-					edgehashtab[i][hash] = NULL;
-				}
-			}
-		}
-	}
-	e->hashval = fsnodes_hash(e->parent->inode,e->nleng,e->name);
-	hash = (e->hashval) & (edgehashsize-1);
-	if (edgerehashpos<edgehashsize) {
-		fsnodes_edge_hash_move();
-		if (hash >= edgerehashpos) {
-			hash -= edgehashsize/2;
-		}
-		e->next = edgehashtab[hash>>HASHTAB_LOBITS][hash&HASHTAB_MASK];
-		edgehashtab[hash>>HASHTAB_LOBITS][hash&HASHTAB_MASK] = e;
-		edgehashelem++;
-	} else {
-		e->next = edgehashtab[hash>>HASHTAB_LOBITS][hash&HASHTAB_MASK];
-		edgehashtab[hash>>HASHTAB_LOBITS][hash&HASHTAB_MASK] = e;
-		edgehashelem++;
-		if (edgehashelem>edgehashsize && (edgehashsize>>HASHTAB_LOBITS)<HASHTAB_HISIZE) {
-			fsnodes_edge_hash_rehash();
-		}
-	}
+static inline void fsnodes_edge_add(fsedge *e) {
+	fsnodes_edge_add_hashed(e,fsnodes_hash(e->parent->inode,e->nleng,e->name));
 }
 
 static inline int fsnodes_nameisused(fsnode *node,uint16_t nleng,const uint8_t *name) {
@@ -1242,166 +1158,86 @@ static inline void fsnodes_find_uniqname(fsnode *node,uint8_t req_nleng,const ui
 	}
 }
 
-static inline void fsnodes_node_hash_init(void) {
-	uint16_t i;
-	nodehashsize = 0;
-	nodehashelem = 0;
-	noderehashpos = 0;
-	for (i=0 ; i<HASHTAB_HISIZE ; i++) {
-		nodehashtab[i] = NULL;
+static inline void fsnodes_node_index_init(void) {
+	uint32_t i;
+	nodeindexslots = 0;
+	nodeindexpages = 0;
+	nodeindexelem = 0;
+	for (i=0 ; i<NODEINDEX_HISIZE ; i++) {
+		nodeindex[i] = NULL;
 	}
 }
 
-static inline void fsnodes_node_hash_cleanup(void) {
-	uint16_t i;
-	nodehashelem = 0;
-	nodehashsize = 0;
-	noderehashpos = 0;
-	for (i=0 ; i<HASHTAB_HISIZE ; i++) {
-		if (nodehashtab[i]!=NULL) {
+static inline void fsnodes_node_index_cleanup(void) {
+	uint32_t i;
+	for (i=0 ; i<(nodeindexslots>>NODEINDEX_LOBITS) ; i++) {
+		if (nodeindex[i]!=NULL) {
 #ifdef HAVE_MMAP
-			munmap(nodehashtab[i],sizeof(fsnode*)*HASHTAB_LOSIZE);
+			munmap(nodeindex[i],sizeof(fsnode*)*NODEINDEX_LOSIZE);
 #else
-			free(nodehashtab[i]);
+			free(nodeindex[i]);
 #endif
 		}
-		nodehashtab[i] = NULL;
-	}
-}
-
-static inline void fsnodes_node_hash_rehash(void) {
-	uint16_t i;
-	noderehashpos = nodehashsize;
-	nodehashsize *= 2;
-	for (i=(nodehashsize>>HASHTAB_LOBITS)/2 ; i<nodehashsize>>HASHTAB_LOBITS ; i++) {
-#ifdef HAVE_MMAP
-		nodehashtab[i] = mmap(NULL,sizeof(fsnode*)*HASHTAB_LOSIZE,PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE,-1,0);
-#else
-		nodehashtab[i] = malloc(sizeof(fsnode*)*HASHTAB_LOSIZE);
-#endif
-		passert(nodehashtab[i]);
+		nodeindex[i] = NULL;
 	}
+	nodeindexslots = 0;
+	nodeindexpages = 0;
+	nodeindexelem = 0;
 }
 
-static inline void fsnodes_node_hash_move(void) {
-	uint32_t hash;
-	uint32_t mask;
-	uint32_t moved=0;
-	fsnode **phptr,**phptralt,*p;
-	mask = nodehashsize-1;
-	do {
-		if (noderehashpos>=nodehashsize) { // rehash complete
-			noderehashpos = nodehashsize;
-			return;
-		}
-		phptr = nodehashtab[(noderehashpos - (nodehashsize/2)) >> HASHTAB_LOBITS] + (noderehashpos & HASHTAB_MASK);
-		phptralt = nodehashtab[noderehashpos >> HASHTAB_LOBITS] + (noderehashpos & HASHTAB_MASK);
-		*phptralt = NULL;
-		while ((p=*phptr)!=NULL) {
-			hash = hash32(p->inode) & mask;
-			if (hash==noderehashpos) {
-				*phptralt = p;
-				*phptr = p->next;
-				phptralt = &(p->next);
-				p->next = NULL;
-			} else {
-				phptr = &(p->next);
-			}
-			moved++;
-		}
-		noderehashpos++;
-	} while (moved<HASHTAB_MOVEFACTOR);
+// used by full scans - slots are numbered by inodes ; returns NULL for empty slots
+static inline fsnode* fsnodes_node_slot(uint32_t slot) {
+	fsnode **page = nodeindex[slot>>NODEINDEX_LOBITS];
+	return (page!=NULL)?page[slot&NODEINDEX_MASK]:NULL;
 }
 
 static inline fsnode* fsnodes_node_find(uint32_t inode) {
-	fsnode *p;
-	uint32_t hash;
+	fsnode **page;
 
-	if (nodehashsize==0) {
+	if (inode>=nodeindexslots) {
 		return NULL;
 	}
-	hash = hash32(inode) & (nodehashsize-1);
-	if (noderehashpos<nodehashsize) {
-		fsnodes_node_hash_move();
-		if (hash >= noderehashpos) {
-			hash -= nodehashsize/2;
-		}
-	}
-	for (p=nodehashtab[hash>>HASHTAB_LOBITS][hash&HASHTAB_MASK] ; p ; p=p->next) {
-		if (p->inode==inode) {
-			return p;
-		}
-	}
-	return NULL;
+	page = nodeindex[inode>>NODEINDEX_LOBITS];
+	return (page!=NULL)?page[inode&NODEINDEX_MASK]:NULL;
 }
 
 static inline void fsnodes_node_delete(fsnode *p) {
-	fsnode **phptr,*pit;
-	uint32_t hash;
+	fsnode **page;
 
-	if (nodehashsize==0) {
+	if (p->inode>=nodeindexslots) {
 		return;
 	}
-	hash = hash32(p->inode) & (nodehashsize-1);
-	if (noderehashpos<nodehashsize) {
-		fsnodes_node_hash_move();
-		if (hash >= noderehashpos) {
-			hash -= nodehashsize/2;
-		}
-	}
-	phptr = nodehashtab[hash>>HASHTAB_LOBITS] + (hash&HASHTAB_MASK);
-	while ((pit=*phptr)!=NULL) {
-		if (pit==p) {
-			*phptr = p->next;
-			nodehashelem--;
-			return;
-		}
-		phptr = &(pit->next);
+	page = nodeindex[p->inode>>NODEINDEX_LOBITS];
+	if (page!=NULL && page[p->inode&NODEINDEX_MASK]==p) {
+		page[p->inode&NODEINDEX_MASK] = NULL;
+		nodeindexelem--;
 	}
 }
 
 static inline void fsnodes_node_add(fsnode *p) {
-	uint16_t i;
-	uint32_t hash;
+	uint32_t hi;
+	fsnode **page;
 
-	if (nodehashsize==0) {
-		nodehashsize = fsnodes_calc_hash_size(hashelements);
-		noderehashpos = nodehashsize;
-		nodehashelem = 0;
-		for (i=0 ; i<nodehashsize>>HASHTAB_LOBITS ; i++) {
+	hi = p->inode>>NODEINDEX_LOBITS;
+	massert(hi<NODEINDEX_HISIZE,"inode number too big");
+	page = nodeindex[hi];
+	if (page==NULL) {
 #ifdef HAVE_MMAP
-			nodehashtab[i] = mmap(NULL,sizeof(fsnode*)*HASHTAB_LOSIZE,PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE,-1,0);
+		page = mmap(NULL,sizeof(fsnode*)*NODEINDEX_LOSIZE,PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE,-1,0);
+		passert(page);
 #else
-			nodehashtab[i] = malloc(sizeof(fsnode*)*HASHTAB_LOSIZE);
+		page = malloc(sizeof(fsnode*)*NODEINDEX_LOSIZE);
+		passert(page);
+		memset(page,0,sizeof(fsnode*)*NODEINDEX_LOSIZE);
 #endif
-			passert(nodehashtab[i]);
-			memset(nodehashtab[i],0,sizeof(fsnode*));
-			if (nodehashtab[i][0]==NULL) {
-				memset(nodehashtab[i],0,sizeof(fsnode*)*HASHTAB_LOSIZE);
-			} else {
-				for (hash=0 ; hash<HASHTAB_LOSIZE ; hash++) {
-					nodehashtab[i][hash] = NULL;
-				}
-			}
-		}
-	}
-	hash = hash32(p->inode) & (nodehashsize-1);
-	if (noderehashpos<nodehashsize) {
-		fsnodes_node_hash_move();
-		if (hash >= noderehashpos) {
-			hash -= nodehashsize/2;
-		}
-		p->next = nodehashtab[hash>>HASHTAB_LOBITS][hash&HASHTAB_MASK];
-		nodehashtab[hash>>HASHTAB_LOBITS][hash&HASHTAB_MASK] = p;
-		nodehashelem++;
-	} else {
-		p->next = nodehashtab[hash>>HASHTAB_LOBITS][hash&HASHTAB_MASK];
-		nodehashtab[hash>>HASHTAB_LOBITS][hash&HASHTAB_MASK] = p;
-		nodehashelem++;
-		if (nodehashelem>nodehashsize && (nodehashsize>>HASHTAB_LOBITS)<HASHTAB_HISIZE) {
-			fsnodes_node_hash_rehash();
+		nodeindex[hi] = page;
+		nodeindexpages++;
+		if (nodeindexslots<((hi+1)<<NODEINDEX_LOBITS)) {
+			nodeindexslots = (hi+1)<<NODEINDEX_LOBITS;
 		}
 	}
+	page[p->inode&NODEINDEX_MASK] = p;
+	nodeindexelem++;
 }
 
 
@@ -1469,6 +1305,171 @@ static inline void fsnodes_edgeid_remove(fsedge *e) {
 	}
 }
 
+/* huge directories - children are kept sorted by edgeid (new ones get the lowest id and are added in front),
+ * so readdir continuation (when edgeid is not found in edgeid cache) can find its position using index
+ * instead of scanning the list. Index is built on first such search and updated on link/unlink. */
+
+typedef struct _dirindexentry {
+	uint32_t inode;
+	uint32_t hashval;
+	void *di;
+	struct _dirindexentry *next,**prev;
+} dirindexentry;
+
+static dirindexentry *dirindexhead;
+static uint32_t dirindexcnt;
+
+#define ENTRY_TYPE dirindexentry
+#define GLUE_FN_NAME_PREFIX(Y) GLUE(fsnodes_dirindextab,Y)
+#define GLUE_HASH_TAB_PREFIX(Y) GLUE(dirindextab,Y)
+#define HASH_ARGS_TYPE_LIST uint32_t inode
+#define HASH_ARGS_LIST inode
+#define HASH_VALUE_FIELD hashval
+
+static inline int fsnodes_dirindextab_cmp(dirindexentry *die,uint32_t inode) {
+	return (die->inode==inode)?1:0;
+}
+
+static inline uint32_t fsnodes_dirindextab_hash(uint32_t inode) {
+	return hash32(inode);
+}
+
+#include "swisshash_begin.h"
+#include "swisshash_end.h"
+
+#undef ENTRY_TYPE
+#undef GLUE_FN_NAME_PREFIX
+#undef GLUE_HASH_TAB_PREFIX
+#undef HASH_ARGS_TYPE_LIST
+#undef HASH_ARGS_LIST
+#undef HASH_VALUE_FIELD
+
+static inline void fsnodes_dirindex_init(void) {
+	fsnodes_dirindextab_hash_init();
+	dirindexhead = NULL;
+	dirindexcnt = 0;
+}
+
+static inline void fsnodes_dirindex_cleanup(void) {
+	dirindexentry *die,*ndie;
+	for (die=dirindexhead ; die ; die=ndie) {
+		ndie = die->next;
+		dirindex_free(die->di);
+		free(die);
+	}
+	fsnodes_dirindextab_hash_cleanup();
+	dirindexhead = NULL;
+	dirindexcnt = 0;
+}
+
+static inline void* fsnodes_dirindex_get(fsnode *p) {
+	dirindexentry *die;
+	if (p->dirindexed==0) {
+		return NULL;
+	}
+	die = fsnodes_dirindextab_find(p->inode);
+	sassert(die!=NULL);
+	return die->di;
+}
+
+static inline void fsnodes_dirindex_drop(fsnode *p) {
+	dirindexentry *die;
+	if (p->dirindexed==0) {
+		return;
+	}
+	die = fsnodes_dirindextab_find(p->inode);
+	sassert(die!=NULL);
+	fsnodes_dirindextab_delete(die);
+	*(die->prev) = die->next;
+	if (die->next) {
+		die->next->prev = die->prev;
+	}
+	dirindex_free(die->di);
+	free(die);
+	dirindexcnt--;
+	p->dirindexed = 0;
+}
+
+static inline void* fsnodes_dirindex_build(fsnode *p) {
+	dirindexentry *die;
+	fsedge *e;
+	uint64_t lastid;
+	void *di;
+
+	// index can't be changed by readers and has sense only when edgeids are valid (strictly increasing in children list)
+	if (fsreaders || nextedgeid==EDGEID_MAX || edgesneedrenumeration) {
+		return NULL;
+	}
+	di = dirindex_new();
+	lastid = 0;
+	for (e=p->data.ddata.children ; e ; e=e->nextchild) {
+		if (e->edgeid<=lastid) {
+			dirindex_free(di);
+			return NULL;
+		}
+		lastid = e->edgeid;
+		dirindex_insert(di,e->edgeid,e);
+	}
+	die = malloc(sizeof(dirindexentry));
+	passert(die);
+	die->inode = p->inode;
+	die->hashval = fsnodes_dirindextab_hash(p->inode);
+	die->di = di;
+	die->next = dirindexhead;
+	if (die->next) {
+		die->next->prev = &(die->next);
+	}
+	die->prev = &dirindexhead;
+	dirindexhead = die;
+	fsnodes_dirindextab_add(die);
+	dirindexcnt++;
+	p->dirindexed = 1;
+	return di;
+}
+
+// first child of 'p' with edgeid >= given one
+static inline fsedge* fsnodes_dir_seek(fsnode *p,uint64_t edgeid) {
+	fsedge *e;
+	void *di;
+
+	di = fsnodes_dirindex_get(p);
+	if (di==NULL && p->data.ddata.elements>=DIRINDEX_MIN_ELEMENTS) {
+		di = fsnodes_dirindex_build(p);
+	}
+	if (di!=NULL) {
+		return (fsedge*)dirindex_lowerbound(di,edgeid);
+	}
+	for (e=p->data.ddata.children ; e && e->edgeid<edgeid ; e=e->nextchild) {}
+	return e;
+}
+
+void fs_memusage_info(FILE *fd) {
+	static const char *labels[8] = {"edge hash","edges","node index","nodes","deleted nodes","chunk tabs","symlinks","quota"};
+	uint64_t allocated[8],used[8];
+	uint64_t nodebytes,dielem,dimem;
+	dirindexentry *die;
+	uint32_t i;
+
+	fs_get_memusage(allocated,used);
+	fprintf(fd,"[filesystem memory]\n");
+	for (i=0 ; i<8 ; i++) {
+		fprintf(fd,"%s: allocated: %"PRIu64" ; used: %"PRIu64"\n",labels[i],allocated[i],used[i]);
+	}
+	if (nodes>0) {
+		nodebytes = used[2]+used[3];
+		fprintf(fd,"used bytes per inode (index+nodes): %.2lf ; node sizes (dir,file,symlink,dev,other): %"PRIu32",%"PRIu32",%"PRIu32",%"PRIu32",%"PRIu32"\n",(double)nodebytes/(double)nodes,nrelemsize[0],nrelemsize[1],nrelemsize[2],nrelemsize[3],nrelemsize[4]);
+	}
+	if (dirindexcnt>0) {
+		dielem = dimem = 0;
+		for (die=dirindexhead ; die ; die=die->next) {
+			dielem += dirindex_elements(die->di);
+			dimem += dirindex_memusage(die->di);
+		}
+		fprintf(fd,"directory indexes: %"PRIu32" ; entries: %"PRIu64" ; allocated: %"PRIu64"\n",dirindexcnt,dielem,dimem);
+	}
+	fprintf(fd,"\n");
+}
+
 
 
 
@@ -2422,12 +2423,20 @@ static inline uint32_t fsnodes_checkarchmode(fsnode *obj,uint32_t ts,uint8_t fie
 
 static inline void fsnodes_remove_edge(uint32_t ts,fsedge *e) {
 	statsrecord sr;
+	fsnodes_preserve_edge(e);
 	if (e->parent) {
 		fsnodes_edgeid_remove(e);
 		fsnodes_get_stats(e->child,&sr,0);
 		fsnodes_sub_stats(e->parent,&sr);
 		e->parent->mtime = e->parent->ctime = ts;
 		e->parent->data.ddata.elements--;
+		if (e->parent->dirindexed) {
+			if (e->parent->data.ddata.elements<DIRINDEX_MIN_ELEMENTS/2) {
+				fsnodes_dirindex_drop(e->parent);
+			} else {
+				dirindex_delete(fsnodes_dirindex_get(e->parent),e->edgeid,e);
+			}
+		}
 		switch (e->child->type) {
 			case TYPE_FILE:
 			case TYPE_TRASH:
@@ -2475,6 +2484,8 @@ static inline void fsnodes_link(uint32_t ts,fsnode *parent,fsnode *child,uint16_
 	fsedge *e;
 	statsrecord sr;
 
+	fsnodes_preserve(parent);
+	fsnodes_preserve(child);
 	e = fsedge_malloc(nleng);
 	passert(e);
 	if (nextedgeid<EDGEID_MAX) {
@@ -2492,6 +2503,13 @@ static inline void fsnodes_link(uint32_t ts,fsnode *parent,fsnode *child,uint16_
 	}
 	parent->data.ddata.children = e;
 	e->prevchild = &(parent->data.ddata.children);
+	if (parent->dirindexed) {
+		if (e->edgeid>0) {
+			dirindex_insert(fsnodes_dirindex_get(parent),e->edgeid,e);
+		} else {
+			fsnodes_dirindex_drop(parent);
+		}
+	}
 	e->nextparent = child->parents;
 	if (e->nextparent) {
 		e->nextparent->prevparent = &(e->nextparent);
@@ -3107,7 +3125,18 @@ static inline void fsnodes_readdirdata(uint32_t rootinode,uint32_t uid,uint32_t
 	}
 	*nedgeidp = nedgeid;
 	if (e!=NULL) {
-		fsnodes_edgeid_insert(e);
+		if (fsreaders) {
+			zassert(pthread_mutex_lock(&fsreaderslock));
+			if (fsreaders_edgescnt>=fsreaders_edgessize) {
+				fsreaders_edgessize = (fsreaders_edgessize>0)?fsreaders_edgessize*2:256;
+				fsreaders_edges = (fsedge**)realloc(fsreaders_edges,sizeof(fsedge*)*fsreaders_edgessize);
+				passert(fsreaders_edges);
+			}
+			fsreaders_edges[fsreaders_edgescnt++] = e;
+			zassert(pthread_mutex_unlock(&fsreaderslock));
+		} else {
+			fsnodes_edgeid_insert(e);
+		}
 	}
 }
 
@@ -3193,6 +3222,8 @@ static inline uint8_t fsnodes_append_slice_of_chunks(uint32_t ts,fsnode *dstobj,
 	statsrecord psr,nsr;
 	fsedge *e;
 
+	fsnodes_preserve(dstobj);
+	fsnodes_preserve(srcobj);
 	if (srcobj->data.fdata.length>0) {
 		lastsrcchunk = (srcobj->data.fdata.length-1)>>MFSCHUNKBITS;
 	} else {
@@ -3310,6 +3341,7 @@ static inline void fsnodes_changefilesclassid(fsnode *obj,uint8_t sclassid) {
 	statsrecord psr,nsr;
 	fsedge *e;
 
+	fsnodes_preserve(obj);
 	fsnodes_get_stats(obj,&psr,0);
 	for (i=0 ; i<obj->data.fdata.chunks ; i++) {
 		if (obj->data.fdata.chunktab[i]>0) {
@@ -3330,6 +3362,7 @@ static inline void fsnodes_setlength(fsnode *obj,uint64_t length) {
 	uint64_t chunkid;
 	fsedge *e;
 	statsrecord psr,nsr;
+	fsnodes_preserve(obj);
 	fsnodes_get_stats(obj,&psr,0);
 
 	if (obj->type==TYPE_TRASH) {
@@ -3379,6 +3412,7 @@ static inline void fsnodes_remove_node(uint32_t ts,fsnode *toremove) {
 	if (toremove->parents!=NULL) {
 		return;
 	}
+	fsnodes_preserve(toremove);
 	fsnodes_node_delete(toremove);
 	nodes--;
 	if (toremove->type==TYPE_DIRECTORY) {
@@ -3449,6 +3483,7 @@ static inline void fsnodes_unlink(uint32_t ts,fsedge *e) {
 
 	gototrash = 0;
 	child = e->child;
+	fsnodes_preserve(child);
 	isopen = of_isfileopen(child->inode);
 	if (child->type==TYPE_FILE && child->trashretention>0) {
 		if ((child->data.fdata.length>0) || (child->data.fdata.length==0 && (KeepEmptyFilesInTrash || isopen))) {
@@ -3532,6 +3567,7 @@ static inline int fsnodes_purge(uint32_t ts,fsnode *p) {
 	fsedge *e;
 	e = p->parents;
 
+	fsnodes_preserve(p);
 	if (p->type==TYPE_TRASH) {
 		trashspace -= p->data.fdata.length;
 		trashnodes--;
@@ -3640,6 +3676,7 @@ static inline uint8_t fsnodes_undel(uint32_t ts,fsnode *node) {
 				return MFS_ERROR_EEXIST;
 			}
 			// remove from trash and link to new parent
+			fsnodes_preserve(node);
 			node->type = TYPE_FILE;
 			node->ctime = ts;
 			fsnodes_checkarchmode(node,ts,CHECK_CTIME);
@@ -3894,6 +3931,7 @@ static inline void fsnodes_setsclass_recursive(fsnode *node,uint32_t ts,uint32_t
 				break;
 			}
 			if (set) {
+				fsnodes_preserve(node);
 				if (node->type!=TYPE_DIRECTORY) {
 					fsnodes_changefilesclassid(node,dst_sclassid);
 					(*sinodes)++;
@@ -3926,6 +3964,7 @@ static inline void fsnodes_settrashretention_recursive(fsnode *node,uint32_t ts,
 		if (((node->eattr&EATTR_NOOWNER)==0 && uid!=0 && node->uid!=uid) || (node->eattr&EATTR_IMMUTABLE)) {
 			(*nsinodes)++;
 		} else {
+			fsnodes_preserve(node);
 			set=0;
 			switch (smode&SMODE_TMASK) {
 			case SMODE_SET:
@@ -3971,6 +4010,7 @@ static inline void fsnodes_seteattr_recursive(fsnode *node,uint32_t ts,uint32_t
 	if (((node->eattr&EATTR_NOOWNER)==0 && uid!=0 && node->uid!=uid) || ((node->eattr&EATTR_IMMUTABLE) && (eattr&EATTR_NOOWNER))) {
 		(*nsinodes)++;
 	} else {
+		fsnodes_preserve(node);
 		seattr = eattr;
 		if (node->type!=TYPE_DIRECTORY) {
 			node->eattr &= ~(EATTR_NOECACHE);
@@ -4030,6 +4070,7 @@ static inline void fsnodes_chgarch_recursive(fsnode *node,uint32_t ts,uint32_t u
 			(*chgchunks) += aflagchanged;
 			(*notchgchunks) += (allchunks - aflagchanged);
 			if (cmd==ARCHCTL_CLR) {
+				fsnodes_preserve(node);
 				node->ctime = ts;
 			}
 			fsnodes_check_realsize(node);
@@ -4090,6 +4131,7 @@ static inline void fsnodes_remove_snapshot(fsedge *e,fsnodes_snapshot_params *ar
 	fsedge *ie,*ien;
 	n = e->child;
 	fsnodes_keep_alive_check();
+	fsnodes_preserve(n);
 	if (n->type == TYPE_DIRECTORY) {
 		eattr_back = n->eattr;
 		if (fsnodes_access_ext(n,args->uid,args->gids,args->gid,MODE_MASK_W|MODE_MASK_X,args->sesflags)) {
@@ -4134,6 +4176,7 @@ static inline void fsnodes_snapshot(fsnode *srcnode,fsnode *parentnode,uint32_t
 	}
 	if (newflag==0 && (e=fsnodes_lookup(parentnode,nleng,name))) { // element already exists
 		dstnode = e->child;
+		fsnodes_preserve(dstnode);
 		if (srcnode->type==TYPE_DIRECTORY) {
 			args->existing_object++;
 			if (rec) {
@@ -4899,6 +4942,7 @@ uint8_t fs_univ_trash_recover(uint32_t ts,uint32_t rootinode,uint8_t sesflags,ui
 			}
 			dwd = ndwd;
 		} else { // file at the end
+			fsnodes_preserve(sp);
 			sp->type = TYPE_FILE;
 			sp->ctime = ts;
 			fsnodes_checkarchmode(sp,ts,CHECK_CTIME);
@@ -5391,7 +5435,7 @@ uint8_t fs_path_lookup(uint32_t rootinode,uint8_t sesflags,uint32_t base_inode,u
 		}
 		fsnodes_fill_attr(p,wd,uid,gid[0],auid,agid,sesflags,attr,1);
 	}
-//	stats_lookup++;
+//	__sync_fetch_and_add(&stats_lookup,1);
 	return MFS_STATUS_OK;
 }
 
@@ -5420,7 +5464,7 @@ void fs_statfs(uint32_t rootinode,uint8_t sesflags,uint64_t *totalspace,uint64_t
 		fsnodes_get_stats(rn,&sr,2);
 		*inodes = sr.inodes;
 	}
-	stats_statfs++;
+	__sync_fetch_and_add(&stats_statfs,1);
 }
 
 uint8_t fs_access(uint32_t rootinode,uint8_t sesflags,uint32_t inode,uint32_t uid,uint32_t gids,uint32_t *gid,int modemask) {
@@ -5528,7 +5572,7 @@ uint8_t fs_lookup(uint32_t rootinode,uint8_t sesflags,uint32_t parent,uint16_t n
 			}
 		}
 	}
-	stats_lookup++;
+	__sync_fetch_and_add(&stats_lookup,1);
 	return MFS_STATUS_OK;
 }
 
@@ -5541,7 +5585,7 @@ uint8_t fs_getattr(uint32_t rootinode,uint8_t sesflags,uint32_t inode,uint8_t op
 		return MFS_ERROR_ENOENT;
 	}
 	fsnodes_fill_attr(p,NULL,uid,gid,auid,agid,sesflags,attr,1);
-	stats_getattr++;
+	__sync_fetch_and_add(&stats_getattr,1);
 	return MFS_STATUS_OK;
 }
 
@@ -5638,6 +5682,7 @@ uint8_t fs_try_setlength(uint32_t rootinode,uint8_t sesflags,uint32_t inode,uint
 					if (status!=MFS_STATUS_OK) {
 						return status;
 					}
+					fsnodes_preserve(p);
 					p->data.fdata.chunktab[*indx] = nchunkid;
 					*chunkid = nchunkid;
 					changelog("%"PRIu32"|TRUNC(%"PRIu32",%"PRIu32"):%"PRIu64,(uint32_t)main_time(),inode,*indx,nchunkid);
@@ -5787,6 +5832,7 @@ uint8_t fs_setattr(uint32_t rootinode,uint8_t sesflags,uint32_t inode,uint8_t op
 			}
 		}
 	}
+	fsnodes_preserve(p);
 	// first ignore sugid clears done by kernel
 	if ((setmask&(SET_UID_FLAG|SET_GID_FLAG)) && (setmask&SET_MODE_FLAG)) {	// chown+chmod = chown with sugid clears
 		attrmode |= (p->mode & 06000);
@@ -6063,6 +6109,9 @@ uint8_t fs_univ_set_additional_attributes(uint32_t ts,uint32_t rootinode,uint8_t
 	}
 
 	// all data are parsed correctly, so we can set them now
+	if (checkonly==0) {
+		fsnodes_preserve(p);
+	}
 	if (flags&SET_ALL_WINATTR) {
 		if (checkonly) {
 			if (p->winattr!=winattr) {
@@ -6180,6 +6229,7 @@ uint8_t fs_readlink(uint32_t rootinode,uint8_t sesflags,uint32_t inode,uint32_t
 	*path = p->data.sdata.path;
 	if ((sesflags&SESFLAG_READONLY)==0 && p->atime!=ts) {
 		if ((AtimeMode==ATIME_ALWAYS) || (((p->atime <= p->ctime && ts >= p->ctime) || (p->atime <= p->mtime && ts >= p->mtime) || (p->atime + 86400 < ts)) && AtimeMode==ATIME_RELATIVE_ONLY)) {
+			fsnodes_preserve(p);
 			p->atime = ts;
 			fsnodes_checkarchmode(p,ts,CHECK_ATIME);
 			changelog("%"PRIu32"|ACCESS(%"PRIu32")",ts,inode);
@@ -7174,10 +7224,7 @@ uint8_t fs_readdirfull(uint32_t rootinode,uint8_t sesflags,uint32_t inode,uint8_
 			if (p->type!=TYPE_DIRECTORY) {
 				return MFS_ERROR_ENOTDIR;
 			}
-			e = p->data.ddata.children;
-			while (e && e->edgeid < nedgeid) {
-				e = e->nextchild;
-			}
+			e = fsnodes_dir_seek(p,nedgeid);
 		}
 		*dedge = e;
 	} else {
@@ -7195,6 +7242,55 @@ uint8_t fs_readdirfull(uint32_t rootinode,uint8_t sesflags,uint32_t inode,uint8_
 	return MFS_STATUS_OK;
 }
 
+static inline int fsnodes_dir_atime_needed(fsnode *p,uint32_t ts) {
+	if (p->atime==ts) {
+		return 0;
+	}
+	return ((AtimeMode==ATIME_ALWAYS) || (((p->atime <= p->ctime && ts >= p->ctime) || (p->atime <= p->mtime && ts >= p->mtime) || (p->atime + 86400 < ts)) && AtimeMode==ATIME_RELATIVE_ONLY))?1:0;
+}
+
+static inline void fsnodes_dir_atime_set(fsnode *p,uint32_t ts) {
+	fsnodes_preserve(p);
+	p->atime = ts;
+	fsnodes_checkarchmode(p,ts,CHECK_ATIME);
+	changelog("%"PRIu32"|ACCESS(%"PRIu32")",ts,p->inode);
+}
+
+/* read-only phase:
+ * between fs_readers_begin and fs_readers_end the main thread doesn't modify anything and
+ * fs_lookup, fs_getattr, fs_path_lookup, fs_readdir_*, fs_getxattr, fs_listxattr_* and fs_statfs
+ * can be called from many threads at once. Things these calls would normally change
+ * (directory atime, readdir continuation cache) are remembered and done in fs_readers_end */
+
+int fs_readers_allowed(void) {
+	// edge and directory index lookups move elements to the new table while it grows
+	if (fsnodes_edgetab_hash_stable()==0 || fsnodes_dirindextab_hash_stable()==0) {
+		return 0;
+	}
+	return (xattr_stable() && posix_acl_stable() && dict_stable())?1:0;
+}
+
+void fs_readers_begin(void) {
+	fsreaders = 1;
+}
+
+void fs_readers_end(void) {
+	uint32_t i,ts;
+
+	fsreaders = 0;
+	for (i=0 ; i<fsreaders_edgescnt ; i++) {
+		fsnodes_edgeid_insert(fsreaders_edges[i]);
+	}
+	fsreaders_edgescnt = 0;
+	ts = main_time();
+	for (i=0 ; i<fsreaders_atimecnt ; i++) {
+		if (fsnodes_dir_atime_needed(fsreaders_atime[i],ts)) {
+			fsnodes_dir_atime_set(fsreaders_atime[i],ts);
+		}
+	}
+	fsreaders_atimecnt = 0;
+}
+
 uint8_t fs_readdir_size(uint32_t rootinode,uint8_t sesflags,uint32_t inode,uint32_t uid,uint32_t gids,uint32_t *gid,uint8_t flags,uint32_t maxentries,uint64_t nedgeid,void **dnode,void **dedge,uint32_t *dbuffsize,uint8_t attrmode) {
 	uint64_t r;
 	fsnode *p;
@@ -7225,10 +7321,7 @@ uint8_t fs_readdir_size(uint32_t rootinode,uint8_t sesflags,uint32_t inode,uint3
 				}
 			}
 		} else {
-			e=p->data.ddata.children;
-			while (e && e->edgeid < nedgeid) {
-				e = e->nextchild;
-			}
+			e = fsnodes_dir_seek(p,nedgeid);
 		}
 	} else {
 		p = e->parent;
@@ -7248,15 +7341,22 @@ void fs_readdir_data(uint32_t rootinode,uint8_t sesflags,uint32_t uid,uint32_t g
 	fsedge *e = (fsedge*)dedge;
 	uint32_t ts = main_time();
 
-	if ((sesflags&SESFLAG_READONLY)==0 && p->atime!=ts) {
-		if ((AtimeMode==ATIME_ALWAYS) || (((p->atime <= p->ctime && ts >= p->ctime) || (p->atime <= p->mtime && ts >= p->mtime) || (p->atime + 86400 < ts)) && AtimeMode==ATIME_RELATIVE_ONLY)) {
-			p->atime = ts;
-			fsnodes_checkarchmode(p,ts,CHECK_ATIME);
-			changelog("%"PRIu32"|ACCESS(%"PRIu32")",ts,p->inode);
+	if ((sesflags&SESFLAG_READONLY)==0 && fsnodes_dir_atime_needed(p,ts)) {
+		if (fsreaders) {
+			zassert(pthread_mutex_lock(&fsreaderslock));
+			if (fsreaders_atimecnt>=fsreaders_atimesize) {
+				fsreaders_atimesize = (fsreaders_atimesize>0)?fsreaders_atimesize*2:256;
+				fsreaders_atime = (fsnode**)realloc(fsreaders_atime,sizeof(fsnode*)*fsreaders_atimesize);
+				passert(fsreaders_atime);
+			}
+			fsreaders_atime[fsreaders_atimecnt++] = p;
+			zassert(pthread_mutex_unlock(&fsreaderslock));
+		} else {
+			fsnodes_dir_atime_set(p,ts);
 		}
 	}
 	fsnodes_readdirdata(rootinode,uid,gid,auid,agid,sesflags,p,e,maxentries,nedgeid,dbuff,(flags&GETDIR_FLAG_WITHATTR)?attrmode:0);
-	stats_readdir++;
+	__sync_fetch_and_add(&stats_readdir,1);
 }
 
 uint8_t fs_filechunk(uint32_t rootinode,uint8_t sesflags,uint32_t inode,uint32_t indx,uint64_t *chunkid) {
@@ -7371,6 +7471,7 @@ uint8_t fs_readchunk(uint32_t inode,uint32_t sesflags,uint32_t indx,uint8_t chun
 	*length = p->data.fdata.length;
 	if ((sesflags!=SESFLAG_READONLY)==0 && p->atime!=ts && (chunkopflags&CHUNKOPFLAG_CANMODTIME)) {
 		if ((AtimeMode==ATIME_ALWAYS || AtimeMode==ATIME_FILES_ONLY) || (((p->atime <= p->ctime && ts >= p->ctime) || (p->atime <= p->mtime && ts >= p->mtime) || (p->atime + 86400 < ts)) && (AtimeMode==ATIME_RELATIVE_ONLY || AtimeMode==ATIME_FILES_AND_RELATIVE_ONLY))) {
+			fsnodes_preserve(p);
 			p->atime = ts;
 			fsnodes_checkarchmode(p,ts,CHECK_ATIME);
 			changelog("%"PRIu32"|ACCESS(%"PRIu32")",ts,inode);
@@ -7447,6 +7548,7 @@ uint8_t fs_writechunk(uint32_t inode,uint32_t indx,uint8_t chunkopflags,uint64_t
 	if (fsnodes_test_quota(p,0,lengdiff,sizediff,(sclass_get_keeparch_maxstorage_eights(p->sclassid)*sizediff)/8)) {
 		return MFS_ERROR_QUOTA;
 	}
+	fsnodes_preserve(p);
 	fsnodes_get_stats(p,&psr,0);
 	/* resize chunks structure */
 	if (indx>=p->data.fdata.chunks) {
@@ -7582,6 +7684,7 @@ static inline uint8_t fs_univ_rollback(uint8_t mr,uint32_t ts,uint32_t inode,uin
 		return MFS_ERROR_EINVAL;
 	}
 	if (prevchunkid!=chunkid) {
+		fsnodes_preserve(p);
 		fsnodes_get_stats(p,&psr,0);
 		if (prevchunkid>0) {
 			chunk_add_file(prevchunkid,p->sclassid);
@@ -7686,6 +7789,9 @@ void fs_amtime_update(uint32_t rootinode,uint8_t sesflags,uint32_t *inodetab,uin
 			chg = 0;
 			atime = atimetab[i];
 			mtime = mtimetab[i];
+			if (p->atime<atime || p->mtime<mtime) {
+				fsnodes_preserve(p);
+			}
 			if (p->atime<atime) {
 				if ((AtimeMode==ATIME_ALWAYS || AtimeMode==ATIME_FILES_ONLY) || (((p->atime <= p->ctime && atime >= p->ctime) || (p->atime <= p->mtime && atime >= p->mtime) || (p->atime + 86400 < atime)) && (AtimeMode==ATIME_RELATIVE_ONLY || AtimeMode==ATIME_FILES_AND_RELATIVE_ONLY))) {
 					p->atime = atime;
@@ -7729,6 +7835,7 @@ uint8_t fs_repair(uint32_t rootinode,uint8_t sesflags,uint32_t inode,uint32_t ui
 	if (!fsnodes_access_ext(p,uid,gids,gid,MODE_MASK_W,sesflags)) {
 		return MFS_ERROR_EACCES;
 	}
+	fsnodes_preserve(p);
 	fsnodes_get_stats(p,&psr,0);
 	for (indx=0 ; indx<p->data.fdata.chunks ; indx++) {
 		if (chunk_repair(p->sclassid,p->data.fdata.chunktab[indx],flags,&nversion)) {
@@ -8062,7 +8169,7 @@ uint8_t fs_listxattr_leng(uint32_t rootinode,uint8_t sesflags,uint32_t inode,uin
 
 void fs_listxattr_data(void *xanode,uint8_t *xabuff) {
 	xattr_listattr_data(xanode,xabuff);
-	stats_getxattr++;
+	__sync_fetch_and_add(&stats_getxattr,1);
 }
 
 uint8_t fs_setxattr(uint32_t rootinode,uint8_t sesflags,uint32_t inode,uint8_t opened,uint32_t uid,uint32_t gids,uint32_t *gid,uint8_t anleng,const uint8_t *attrname,uint32_t avleng,const uint8_t *attrvalue,uint8_t mode) {
@@ -8105,6 +8212,7 @@ uint8_t fs_setxattr(uint32_t rootinode,uint8_t sesflags,uint32_t inode,uint8_t o
 	if (status!=MFS_STATUS_OK) {
 		return status;
 	}
+	fsnodes_preserve(p);
 	p->ctime = ts;
 	fsnodes_checkarchmode(p,ts,CHECK_CTIME);
 	changelog("%"PRIu32"|SETXATTR(%"PRIu32",%s,%s,%"PRIu8")",ts,inode,changelog_escape_name(anleng,attrname),changelog_escape_name(avleng,attrvalue),mode);
@@ -8131,7 +8239,7 @@ uint8_t fs_getxattr(uint32_t rootinode,uint8_t sesflags,uint32_t inode,uint8_t o
 	if (xattr_namecheck(anleng,attrname)<0) {
 		return MFS_ERROR_EINVAL;
 	}
-	stats_getxattr++;
+	__sync_fetch_and_add(&stats_getxattr,1);
 	return xattr_getattr(inode,anleng,attrname,avleng,attrvalue);
 }
 
@@ -8186,6 +8294,7 @@ uint8_t fs_setfacl(uint32_t rootinode,uint8_t sesflags,uint32_t inode,uint32_t u
 	if (acltype!=POSIX_ACL_ACCESS && acltype!=POSIX_ACL_DEFAULT) {
 		return MFS_ERROR_EINVAL;
 	}
+	fsnodes_preserve(p);
 	pmode = p->mode;
 	chg = 0;
 	if ((userperm&groupperm&otherperm&mask)==0xFFFF && (namedusers|namedgroups)==0) { // special case (remove)
@@ -8714,10 +8823,7 @@ uint32_t fs_node_info(uint32_t rootinode,uint8_t sesflags,uint8_t eights_mode,ui
 			e = fsnodes_edgeid_find(continueid);
 		}
 		if (e==NULL) {
-			e = p->data.ddata.children;
-			while (e && e->edgeid < continueid) {
-				e = e->nextchild;
-			}
+			e = fsnodes_dir_seek(p,continueid);
 			if (e) {
 				ncontid = e->edgeid;
 			} else {
@@ -8819,8 +8925,8 @@ static inline void fs_add_file_to_chunks(fsnode *f) {
 void fs_add_files_to_chunks(void) {
 	uint32_t i;
 	fsnode *p;
-	for (i=0 ; i<noderehashpos ; i++) {
-		for (p=nodehashtab[i>>HASHTAB_LOBITS][i&HASHTAB_MASK] ; p ; p=p->next) {
+	for (i=0 ; i<nodeindexslots ; i++) {
+		if ((p=fsnodes_node_slot(i))!=NULL) {
 			fs_add_file_to_chunks(p);
 		}
 	}
@@ -9004,8 +9110,8 @@ void fs_test_files(void) {
 		fsinfo_loopstart = fsinfo_loopend;
 		fsinfo_loopend = now;
 	}
-	for (k=0 ; k<(nodehashsize/32768) && i<noderehashpos ; k++,i++) {
-		for (f=nodehashtab[i>>HASHTAB_LOBITS][i&HASHTAB_MASK] ; f ; f=f->next) {
+	for (k=0 ; k<(nodeindexslots/32768) && i<nodeindexslots ; k++,i++) {
+		if ((f=fsnodes_node_slot(i))!=NULL) {
 			if (f->type==TYPE_FILE || f->type==TYPE_TRASH || f->type==TYPE_SUSTAINED) {
 				valid = 1;
 				ugflag = 0;
@@ -9075,6 +9181,7 @@ void fs_test_files(void) {
 								mchunks++;
 								break;
 							case CHUNK_FLOOP_DELETED:
+								fsnodes_preserve(f);
 								f->data.fdata.chunktab[j] = 0;
 								allchunks--;
 								changelog("%"PRIu32"|SETFILECHUNK(%"PRIu32",%"PRIu32",0)",main_time(),f->inode,j);
@@ -9199,7 +9306,7 @@ void fs_test_files(void) {
 			}
 		}
 	}
-	if (i>=noderehashpos) {
+	if (i>=nodeindexslots) {
 		mfs_log(MFSLOG_SYSLOG,MFSLOG_INFO,"structure check loop");
 		i=0;
 	}
@@ -9346,6 +9453,7 @@ uint8_t fs_mr_emptysustained(uint32_t ts,uint32_t bid,uint32_t freeinodes,uint32
 static inline void fs_renumerate_edges(fsnode *p) {
 	fsedge *e;
 	uint64_t fedgeid;
+	fsnodes_dirindex_drop(p);
 	fedgeid = nextedgeid;
 	for (e=p->data.ddata.children ; e ; e=e->nextchild) {
 		fedgeid--;
@@ -9368,6 +9476,7 @@ uint8_t fs_mr_renumerate_edges(uint64_t expected_nextedgeid) {
 	fsnodes_keep_alive_begin();
 	fs_renumerate_edges(root);
 	edgesneedrenumeration = 0;
+	takenedgeid = nextedgeid;
 	if (nextedgeid!=expected_nextedgeid) {
 		mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"RENUMERATEEDGES data mismatch: my:%"PRIu64" != expected:%"PRIu64,nextedgeid,expected_nextedgeid);
 		return MFS_ERROR_MISMATCH;
@@ -9383,6 +9492,7 @@ void fs_renumerate_edge_test(void) {
 		fsnodes_keep_alive_begin();
 		fs_renumerate_edges(root);
 		edgesneedrenumeration = 0;
+		takenedgeid = nextedgeid;
 		changelog("%"PRIu32"|RENUMERATEEDGES():%"PRIu64,main_time(),nextedgeid);
 	}
 }
@@ -9391,6 +9501,7 @@ void fs_cleanupedges(void) {
 	uint32_t bid;
 	fsedge_cleanup();
 	fsnodes_edge_hash_cleanup();
+	fsnodes_dirindex_cleanup();
 	for (bid=0 ; bid<TRASH_BUCKETS ; bid++) {
 		trash[bid] = NULL;
 	}
@@ -9403,7 +9514,7 @@ void fs_cleanupnodes(void) {
 	fsnode_cleanup();
 	chunktab_cleanup();
 	symlink_cleanup();
-	fsnodes_node_hash_cleanup();
+	fsnodes_node_index_cleanup();
 	root = NULL;
 }
 
@@ -9449,15 +9560,8 @@ void fs_cleanup(void) {
 	appendres_cleanall();
 }
 
-static inline void fs_storeedge(fsedge *e,bio *fd,uint8_t *uedgebuff) {
+static inline uint32_t fs_edgerecord(fsedge *e,uint8_t *uedgebuff) {
 	uint8_t *ptr;
-	if (e==NULL) {	// last edge
-		memset(uedgebuff,0,4+4+8+2);
-		if (bio_write(fd,uedgebuff,4+4+8+2)!=(4+4+8+2)) {
-			return;
-		}
-		return;
-	}
 	ptr = uedgebuff;
 	if (e->parent==NULL) {
 		put32bit(&ptr,0);
@@ -9468,80 +9572,131 @@ static inline void fs_storeedge(fsedge *e,bio *fd,uint8_t *uedgebuff) {
 	put64bit(&ptr,e->edgeid);
 	put16bit(&ptr,e->nleng);
 	memcpy(ptr,e->name,e->nleng);
-	if (bio_write(fd,uedgebuff,4+4+8+2+e->nleng)!=(4+4+8+2+e->nleng)) {
-		return;
-	}
+	return 4+4+8+2+e->nleng;
 }
 
-static inline int fs_loadedge(bio *fd,uint8_t mver,int ignoreflag) {
-	uint8_t uedgebuff[4+4+8+2];
-	const uint8_t *ptr;
-	uint32_t parent_id;
-	uint32_t child_id;
-	uint64_t edgeid;
-	uint16_t nleng;
-	uint32_t bid;
-//	uint32_t hpos;
-	fsedge *e;
-	statsrecord sr;
-	static fsedge **root_tail;
-	static uint64_t root_edgeid;
-	static fsedge **current_tail;
-	static uint64_t current_edgeid;
-	static fsnode *current_parent;
-	static uint32_t current_parent_id;
-	static uint32_t current_trash_bid;
-	static uint32_t current_sustained_bid;
-	static uint8_t nl;
-	static ssize_t bsize;
-
-	if (fd==NULL) {
-		current_trash_bid = TRASH_BUCKETS;
-		current_sustained_bid = SUSTAINED_BUCKETS;
-		current_parent_id = 0;
-		current_parent = NULL;
-		current_tail = NULL;
-		root_tail = NULL;
-		root_edgeid = 0;
-		current_edgeid = 0;
-		nl = 1;
-		if (mver<=0x10) {
-			bsize = 4+4+2;
-		} else {
-			bsize = 4+4+8+2;
+static inline void fs_storeedge(fsedge *e,bio *fd,uint8_t *uedgebuff) {
+	uint32_t leng;
+	if (e==NULL) {	// last edge
+		memset(uedgebuff,0,4+4+8+2);
+		if (bio_write(fd,uedgebuff,4+4+8+2)!=(4+4+8+2)) {
+			return;
 		}
-		return 0;
+		return;
+	}
+	leng = fs_edgerecord(e,uedgebuff);
+	if (bio_write(fd,uedgebuff,leng)!=leng) {
+		return;
 	}
+	bio_record_end(fd);
+}
 
-	if (bio_read(fd,uedgebuff,bsize)!=bsize) {
-		int err = errno;
-		if (nl) {
-			fputc('\n',stderr);
-			nl=0;
-		}
-		errno = err;
-		mfs_log(MFSLOG_ERRNO_SYSLOG_STDERR,MFSLOG_ERR,"loading edge: read error");
-		return -1;
+typedef struct _loadedge_dec {
+	fsnode *child;
+	fsnode *parent;
+	uint64_t edgeid;
+	uint32_t parent_id;
+	uint32_t child_id;
+	uint32_t hashval;
+	uint16_t nleng;
+} loadedge_dec;
+
+typedef struct _loadedge_state {
+	uint8_t mver;
+	uint8_t bsize;
+	int ignoreflag;
+	// applying
+	fsedge **root_tail;
+	uint64_t root_edgeid;
+	fsedge **current_tail;
+	uint64_t current_edgeid;
+	fsnode *current_parent;
+	uint32_t current_parent_id;
+	uint32_t current_trash_bid;
+	uint32_t current_sustained_bid;
+	uint8_t nl;
+} loadedge_state;
+
+static uint32_t fs_loadedge_frame(const uint8_t *rec,uint32_t have,uint8_t *tag,void *arg) {
+	loadedge_state *ls = (loadedge_state*)arg;
+	const uint8_t *ptr;
+	uint32_t parent_id,child_id;
+
+	if (have<ls->bsize) {
+		return ls->bsize;
 	}
-	ptr = uedgebuff;
+	ptr = rec;
 	parent_id = get32bit(&ptr);
 	child_id = get32bit(&ptr);
 	if (parent_id==0 && child_id==0) {	// last edge
-		return 1;
+		*tag = LOADPIPE_LAST;
+		return ls->bsize;
+	}
+	ptr = rec+ls->bsize-2;
+	return ls->bsize+get16bit(&ptr);
+}
+
+/* worker thread - node index is not modified during loading edges, so nodes (and hash of edge name) can be found here */
+static void fs_loadedge_decode(uint8_t *rec,uint32_t leng,uint8_t tag,void *dec,void *arg) {
+	loadedge_state *ls = (loadedge_state*)arg;
+	loadedge_dec *ld = (loadedge_dec*)dec;
+	const uint8_t *ptr;
+	uint16_t nleng;
+
+	(void)leng;
+	(void)tag;
+	ptr = rec;
+	ld->parent_id = get32bit(&ptr);
+	ld->child_id = get32bit(&ptr);
+	if (ld->parent_id==0 && ld->child_id==0) {	// last edge
+		return;
 	}
-	if (mver>0x10) {
-		edgeid = get64bit(&ptr);
+	if (ls->mver>0x10) {
+		ld->edgeid = get64bit(&ptr);
 	} else {
-		edgeid = 0;
+		ld->edgeid = 0;
 	}
-	nleng = get16bit(&ptr);
+	ld->nleng = get16bit(&ptr);
+	ld->child = fsnodes_node_find(ld->child_id);
+	if (ld->parent_id>0) {
+		ld->parent = fsnodes_node_find(ld->parent_id);
+	} else {
+		ld->parent = NULL;
+	}
+	ld->hashval = 0;
+	if (ld->parent_id>0 && ld->nleng>0) {
+		nleng = (ld->nleng>MFS_NAME_MAX)?MFS_NAME_MAX:ld->nleng;
+		ld->hashval = fsnodes_hash(ld->parent_id,nleng,rec+ls->bsize);
+	}
+}
+
+static int fs_loadedge_apply(const uint8_t *rec,uint32_t leng,uint8_t tag,const void *dec,void *arg) {
+	loadedge_state *ls = (loadedge_state*)arg;
+	const loadedge_dec *ld = (const loadedge_dec*)dec;
+	uint32_t parent_id;
+	uint32_t child_id;
+	uint64_t edgeid;
+	uint16_t nleng;
+	uint32_t bid;
+	fsedge *e;
+	statsrecord sr;
+
+	(void)leng;
+	(void)tag;
+	parent_id = ld->parent_id;
+	child_id = ld->child_id;
+	if (parent_id==0 && child_id==0) {	// last edge
+		return 1;
+	}
+	edgeid = ld->edgeid;
+	nleng = ld->nleng;
 	if (nleng==0) {
-		if (nl) {
+		if (ls->nl) {
 			fputc('\n',stderr);
-			nl=0;
+			ls->nl=0;
 		}
 		mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_ERR,"loading edge: %"PRIu32"->%"PRIu32" error: empty name",parent_id,child_id);
-		if (ignoreflag==0) {
+		if (ls->ignoreflag==0) {
 			fprintf(stderr,"use option '-i' to generate name replacement\n");
 			return -1;
 		} else {
@@ -9561,13 +9716,11 @@ static inline int fs_loadedge(bio *fd,uint8_t mver,int ignoreflag) {
 		mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"loading edge: %"PRIu32"->%"PRIu32" error: name too long (%"PRIu16") -> truncate",parent_id,child_id,nleng);
 		e = fsedge_malloc(MFS_PATH_MAX);
 		passert(e);
-		bio_skip(fd,nleng-MFS_PATH_MAX);
 		e->nleng = MFS_PATH_MAX;
 	} else if (parent_id>0 && nleng>MFS_NAME_MAX) {
 		mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"loading edge: %"PRIu32"->%"PRIu32" error: name too long (%"PRIu16") -> truncate",parent_id,child_id,nleng);
 		e = fsedge_malloc(MFS_NAME_MAX);
 		passert(e);
-		bio_skip(fd,nleng-MFS_NAME_MAX);
 		e->nleng = MFS_NAME_MAX;
 	} else {
 		e = fsedge_malloc(nleng);
@@ -9575,27 +9728,17 @@ static inline int fs_loadedge(bio *fd,uint8_t mver,int ignoreflag) {
 		e->nleng = nleng;
 	}
 	if (nleng>0) {
-		if (bio_read(fd,(uint8_t*)(e->name),e->nleng)!=e->nleng) {
-			int err = errno;
-			if (nl) {
-				fputc('\n',stderr);
-				nl=0;
-			}
-			errno = err;
-			mfs_log(MFSLOG_ERRNO_SYSLOG_STDERR,MFSLOG_ERR,"loading edge: read error");
-			fsedge_free(e,nleng);
-			return -1;
-		}
+		memcpy((uint8_t*)(e->name),rec+ls->bsize,e->nleng);
 	}
-	e->child = fsnodes_node_find(child_id);
+	e->child = ld->child;
 	if (e->child==NULL) {
-		if (nl) {
+		if (ls->nl) {
 			fputc('\n',stderr);
-			nl=0;
+			ls->nl=0;
 		}
 		mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_ERR,"loading edge: %"PRIu32",%s->%"PRIu32" error: child not found",parent_id,changelog_escape_name(e->nleng,e->name),child_id);
 		fsedge_free(e,nleng);
-		if (ignoreflag==0) {
+		if (ls->ignoreflag==0) {
 			fprintf(stderr,"use option '-i' to ignore all entries pointing to nonexisting objects\n");
 			return -1;
 		}
@@ -9604,58 +9747,54 @@ static inline int fs_loadedge(bio *fd,uint8_t mver,int ignoreflag) {
 	if (parent_id==0) {
 		if (e->child->type==TYPE_TRASH) {
 			bid = child_id % TRASH_BUCKETS;
-			if (bid!=current_trash_bid) {
-				current_tail = trash+bid;
-				while (*current_tail) {
-					current_tail = &((*current_tail)->nextchild);
+			if (bid!=ls->current_trash_bid) {
+				ls->current_tail = trash+bid;
+				while (*ls->current_tail) {
+					ls->current_tail = &((*ls->current_tail)->nextchild);
 				}
 			}
 			e->parent = NULL;
-			*(current_tail) = e;
-			e->prevchild = current_tail;
+			*(ls->current_tail) = e;
+			e->prevchild = ls->current_tail;
 			e->nextchild = NULL;
-			current_tail = &(e->nextchild);
-			current_trash_bid = bid;
+			ls->current_tail = &(e->nextchild);
+			ls->current_trash_bid = bid;
 			trashspace += e->child->data.fdata.length;
 			trashnodes++;
 		} else if (e->child->type==TYPE_SUSTAINED) {
 			bid = child_id % SUSTAINED_BUCKETS;
-			if (bid!=current_sustained_bid) {
-				current_tail = sustained+bid;
-				while (*current_tail) {
-					current_tail = &((*current_tail)->nextchild);
+			if (bid!=ls->current_sustained_bid) {
+				ls->current_tail = sustained+bid;
+				while (*ls->current_tail) {
+					ls->current_tail = &((*ls->current_tail)->nextchild);
 				}
 			}
 			e->parent = NULL;
-			*(current_tail) = e;
-			e->prevchild = current_tail;
+			*(ls->current_tail) = e;
+			e->prevchild = ls->current_tail;
 			e->nextchild = NULL;
-			current_tail = &(e->nextchild);
-			current_sustained_bid = bid;
+			ls->current_tail = &(e->nextchild);
+			ls->current_sustained_bid = bid;
 			sustainedspace += e->child->data.fdata.length;
 			sustainednodes++;
 		} else {
-			if (nl) {
+			if (ls->nl) {
 				fputc('\n',stderr);
-				nl=0;
+				ls->nl=0;
 			}
 			mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_ERR,"loading edge: %"PRIu32",%s->%"PRIu32" error: bad child type (%u)",parent_id,changelog_escape_name(e->nleng,e->name),child_id,e->child->type);
 			fsedge_free(e,nleng);
 			return -1;
 		}
 	} else {
-		if (current_parent_id==parent_id) {
-			e->parent = current_parent;
-		} else {
-			e->parent = fsnodes_node_find(parent_id);
-		}
+		e->parent = ld->parent;
 		if (e->parent==NULL) {
-			if (nl) {
+			if (ls->nl) {
 				fputc('\n',stderr);
-				nl=0;
+				ls->nl=0;
 			}
 			mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_ERR,"loading edge: %"PRIu32",%s->%"PRIu32" error: parent not found",parent_id,changelog_escape_name(e->nleng,e->name),child_id);
-			if (ignoreflag) {
+			if (ls->ignoreflag) {
 				e->parent = fsnodes_node_find(MFS_ROOT_ID);
 				if (e->parent==NULL || e->parent->type!=TYPE_DIRECTORY) {
 					mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_ERR,"loading edge: %"PRIu32",%s->%"PRIu32" root dir not found !!!",parent_id,changelog_escape_name(e->nleng,e->name),child_id);
@@ -9672,12 +9811,12 @@ static inline int fs_loadedge(bio *fd,uint8_t mver,int ignoreflag) {
 			}
 		}
 		if (e->parent->type!=TYPE_DIRECTORY) {
-			if (nl) {
+			if (ls->nl) {
 				fputc('\n',stderr);
-				nl=0;
+				ls->nl=0;
 			}
 			mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_ERR,"loading edge: %"PRIu32",%s->%"PRIu32" error: bad parent type (%u)",parent_id,changelog_escape_name(e->nleng,e->name),child_id,e->parent->type);
-			if (ignoreflag) {
+			if (ls->ignoreflag) {
 				e->parent = fsnodes_node_find(MFS_ROOT_ID);
 				if (e->parent==NULL || e->parent->type!=TYPE_DIRECTORY) {
 					mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_ERR,"loading edge: %"PRIu32",%s->%"PRIu32" root dir not found !!!",parent_id,changelog_escape_name(e->nleng,e->name),child_id);
@@ -9693,61 +9832,69 @@ static inline int fs_loadedge(bio *fd,uint8_t mver,int ignoreflag) {
 				return -1;
 			}
 		}
-		if (parent_id==MFS_ROOT_ID) {	// special case - because of 'ignoreflag' and possibility of attaching orphans into root node
-			if (root_tail==NULL) {
-				root_tail = &(e->parent->data.ddata.children);
-				while (*root_tail) {
-					root_edgeid = (*root_tail)->edgeid;
-					root_tail = &((*root_tail)->nextchild);
+		if (parent_id==MFS_ROOT_ID) {	// special case - because of 'ls->ignoreflag' and possibility of attaching orphans into root node
+			if (ls->root_tail==NULL) {
+				ls->root_tail = &(e->parent->data.ddata.children);
+				while (*ls->root_tail) {
+					ls->root_edgeid = (*ls->root_tail)->edgeid;
+					ls->root_tail = &((*ls->root_tail)->nextchild);
 				}
 			}
-		} else if (current_parent_id!=parent_id) {
+		} else if (ls->current_parent_id!=parent_id) {
 			if (e->parent->data.ddata.children) {
-				if (nl) {
+				if (ls->nl) {
 					fputc('\n',stderr);
-					nl=0;
+					ls->nl=0;
 				}
 				mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_ERR,"loading edge: %"PRIu32",%s->%"PRIu32" error: parent node sequence error",parent_id,changelog_escape_name(e->nleng,e->name),child_id);
-				if (ignoreflag) {
-					current_tail = &(e->parent->data.ddata.children);
-					while (*current_tail) {
-						current_edgeid = (*current_tail)->edgeid;
-						current_tail = &((*current_tail)->nextchild);
+				if (ls->ignoreflag) {
+					ls->current_tail = &(e->parent->data.ddata.children);
+					while (*ls->current_tail) {
+						ls->current_edgeid = (*ls->current_tail)->edgeid;
+						ls->current_tail = &((*ls->current_tail)->nextchild);
 					}
 				} else {
 					fsedge_free(e,nleng);
 					return -1;
 				}
 			} else {
-				current_tail = &(e->parent->data.ddata.children);
-				current_edgeid = 0;
+				ls->current_tail = &(e->parent->data.ddata.children);
+				ls->current_edgeid = 0;
 			}
-			current_parent_id = parent_id;
-			current_parent = e->parent;
+			ls->current_parent_id = parent_id;
+			ls->current_parent = e->parent;
+		}
+		if (edgeid < nextedgeid) { // new edges get ids below nextedgeid (incremental store depends on it)
+			if (edgesneedrenumeration==0) {
+				mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"edgeid mismatch detected - force edgeid renumeration");
+				edgesneedrenumeration = 1;
+			}
+		} else if (edgeid == nextedgeid) {
+			takenedgeid = nextedgeid;
 		}
 		e->nextchild = NULL;
 		if (parent_id==MFS_ROOT_ID) {
-			*(root_tail) = e;
-			e->prevchild = root_tail;
-			root_tail = &(e->nextchild);
-			if (edgeid <= root_edgeid) {
+			*(ls->root_tail) = e;
+			e->prevchild = ls->root_tail;
+			ls->root_tail = &(e->nextchild);
+			if (edgeid <= ls->root_edgeid) {
 				if (edgesneedrenumeration==0) {
 					mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"edgeid mismatch detected - force edgeid renumeration");
 					edgesneedrenumeration = 1;
 				}
 			}
-			root_edgeid = edgeid;
+			ls->root_edgeid = edgeid;
 		} else {
-			*(current_tail) = e;
-			e->prevchild = current_tail;
-			current_tail = &(e->nextchild);
-			if (edgeid <= current_edgeid) {
+			*(ls->current_tail) = e;
+			e->prevchild = ls->current_tail;
+			ls->current_tail = &(e->nextchild);
+			if (edgeid <= ls->current_edgeid) {
 				if (edgesneedrenumeration==0) {
 					mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"edgeid mismatch detected - force edgeid renumeration");
 					edgesneedrenumeration = 1;
 				}
 			}
-			current_edgeid = edgeid;
+			ls->current_edgeid = edgeid;
 		}
 		e->parent->data.ddata.elements++;
 		switch (e->child->type) {
@@ -9772,7 +9919,11 @@ static inline int fs_loadedge(bio *fd,uint8_t mver,int ignoreflag) {
 				e->child->data.odata.nlink++;
 				break;
 		}
-		fsnodes_edge_add(e);
+		if (parent_id==ld->parent_id && nleng>0) {	// name hash already calculated
+			fsnodes_edge_add_hashed(e,ld->hashval);
+		} else {
+			fsnodes_edge_add(e);
+		}
 	}
 	e->nextparent = e->child->parents;
 	if (e->nextparent) {
@@ -9875,104 +10026,300 @@ static inline void fs_storenode(fsnode *f,bio *fd,uint8_t *unodebuff) {
 			}
 		}
 	}
+	bio_record_end(fd);
 }
 
-static inline int fs_loadnode(bio *fd,uint8_t mver,int ignoreflag,uint8_t *unodebuff) {
-	const uint8_t *ptr,*chptr;
-	uint8_t type;
-	uint32_t trashseconds;
-	uint32_t i,indx,pleng,ch,sessionids,sessionid;
-	fsnode *p;
-	static uint8_t nl;
-	uint32_t hdrsize;
+#define LOADNODE_PIECE 65536
 
-	if (fd==NULL || unodebuff==NULL) {
-		nl=1;
-		return 0;
-	}
+#define LOADNODE_TAG_NODE 0
+#define LOADNODE_TAG_CHUNKS 1
+#define LOADNODE_TAG_SKIP 2
 
-	if (bio_read(fd,&type,1)!=1) {
-		return -1;
-	}
-	if (type==0) {	// last node
-		return 1;
-	}
+typedef struct _loadnode_dec {
+	uint32_t inode;
+	uint32_t uid,gid;
+	uint32_t atime,mtime,ctime;
+	uint32_t x;		// rdev / symlink path length / number of chunks
+	uint64_t length;
+	uint16_t mode;
+	uint16_t trashretention;
+	uint16_t sessionids;
+	uint16_t dataoffset;
+	uint8_t type;
+	uint8_t sclassid;
+	uint8_t eattr;
+	uint8_t winattr;
+} loadnode_dec;
+
+typedef struct _loadnode_state {
+	uint8_t mver;
+	int ignoreflag;
+	// framing (reader thread)
+	uint32_t fchleft;
+	uint32_t fsessionids;
+	uint32_t fskipleft;
+	// applying
+	uint8_t nl;
+	fsnode *pending;
+	uint32_t chindx;
+	uint32_t chleft;
+	uint32_t sessionids;
+} loadnode_state;
+
+static inline uint32_t fs_loadnode_hdrsize(uint8_t mver) {
 	if (mver<=0x11) {
-		hdrsize = 4+1+2+6*4;
+		return 4+1+2+6*4;
 	} else if (mver<=0x13) {
-		hdrsize = 4+1+1+2+6*4;
+		return 4+1+1+2+6*4;
 	} else { // mver==0x14
-		hdrsize = 4+1+1+1+2+5*4+2;
+		return 4+1+1+1+2+5*4+2;
 	}
+}
+
+static inline uint8_t fs_loadnode_type(uint8_t type,uint8_t mver) {
 	if (mver<=0x12) {
-		type = fsnodes_type_convert(type);
+		return fsnodes_type_convert(type);
 	}
-	switch (type) {
+	return type;
+}
+
+/* file node with many chunks (and too long symlink path) is split into pieces - node record contains first piece */
+static uint32_t fs_loadnode_frame(const uint8_t *rec,uint32_t have,uint8_t *tag,void *arg) {
+	loadnode_state *ls = (loadnode_state*)arg;
+	const uint8_t *ptr;
+	uint32_t hdrsize,ch,piece,sessionids;
+
+	if (ls->fskipleft>0) {
+		piece = (ls->fskipleft>LOADNODE_PIECE)?LOADNODE_PIECE:ls->fskipleft;
+		if (have>=piece) {
+			ls->fskipleft -= piece;
+		}
+		*tag = LOADNODE_TAG_SKIP;
+		return piece;
+	}
+	if (ls->fchleft>0) {
+		piece = (ls->fchleft>LOADNODE_PIECE)?LOADNODE_PIECE:ls->fchleft;
+		*tag = LOADNODE_TAG_CHUNKS;
+		if (piece==ls->fchleft) {	// last piece - also contains session ids
+			piece = 8*piece+4*ls->fsessionids;
+			if (have>=piece) {
+				ls->fchleft = 0;
+				ls->fsessionids = 0;
+			}
+			return piece;
+		}
+		if (have>=8*piece) {
+			ls->fchleft -= piece;
+		}
+		return 8*piece;
+	}
+	*tag = LOADNODE_TAG_NODE;
+	if (have<1) {
+		return 1;
+	}
+	hdrsize = 1+fs_loadnode_hdrsize(ls->mver);
+	switch (fs_loadnode_type(rec[0],ls->mver)) {
 	case TYPE_DIRECTORY:
 	case TYPE_FIFO:
 	case TYPE_SOCKET:
-		if (bio_read(fd,unodebuff,hdrsize)!=(hdrsize)) {
-			int err = errno;
-			if (nl) {
-				fputc('\n',stderr);
-				nl=0;
-			}
-			errno = err;
-			mfs_log(MFSLOG_ERRNO_SYSLOG_STDERR,MFSLOG_ERR,"loading node: read error");
-			return -1;
-		}
-		break;
+		return hdrsize;
 	case TYPE_BLOCKDEV:
 	case TYPE_CHARDEV:
+		return hdrsize+4;
 	case TYPE_SYMLINK:
-		if (bio_read(fd,unodebuff,hdrsize+4)!=(hdrsize+4)) {
-			int err = errno;
-			if (nl) {
-				fputc('\n',stderr);
-				nl=0;
-			}
-			errno = err;
-			mfs_log(MFSLOG_ERRNO_SYSLOG_STDERR,MFSLOG_ERR,"loading node: read error");
-			return -1;
+		if (have<hdrsize+4) {
+			return hdrsize+4;
+		}
+		ptr = rec+hdrsize;
+		piece = get32bit(&ptr);
+		if (piece>MFS_SYMLINK_MAX) {
+			ls->fskipleft = piece;
+			piece = 0;
+		}
+		return hdrsize+4+piece;
+	case TYPE_FILE:
+	case TYPE_TRASH:
+	case TYPE_SUSTAINED:
+		hdrsize += 8+4;
+		if (ls->mver<=0x13) {
+			hdrsize += 2;
+		}
+		if (have<hdrsize) {
+			return hdrsize;
+		}
+		ptr = rec+hdrsize-((ls->mver<=0x13)?6:4);
+		ch = get32bit(&ptr);
+		sessionids = (ls->mver<=0x13)?get16bit(&ptr):0;
+		if (ch>LOADNODE_PIECE) {
+			piece = hdrsize+8*LOADNODE_PIECE;
+			if (have>=piece) {	// change state only when whole first piece is framed
+				ls->fchleft = ch-LOADNODE_PIECE;
+				ls->fsessionids = sessionids;
+			}
+			return piece;
+		}
+		return hdrsize+8*ch+4*sessionids;
+	default:	// end marker or unrecognized type
+		*tag = LOADNODE_TAG_NODE | LOADPIPE_LAST;
+		return 1;
+	}
+}
+
+static void fs_loadnode_decode(uint8_t *rec,uint32_t leng,uint8_t tag,void *dec,void *arg) {
+	loadnode_state *ls = (loadnode_state*)arg;
+	loadnode_dec *ld = (loadnode_dec*)dec;
+	const uint8_t *ptr;
+	uint8_t mver = ls->mver;
+
+	if ((tag&(~LOADPIPE_LAST))!=LOADNODE_TAG_NODE) {
+		return;
+	}
+	ld->type = (rec[0]==0)?0:fs_loadnode_type(rec[0],mver);
+	if (leng==1) {
+		return;
+	}
+	ptr = rec+1;
+	ld->inode = get32bit(&ptr);
+	ld->sclassid = get8bit(&ptr);
+	if (mver<=0x11) {
+		uint16_t flagsmode = get16bit(&ptr);
+		ld->eattr = flagsmode>>12;
+		ld->winattr = 0;
+		ld->mode = flagsmode&0xFFF;
+	} else {
+		ld->eattr = get8bit(&ptr);
+		if (mver>=0x14) {
+			ld->winattr = get8bit(&ptr);
+		} else {
+			ld->winattr = 0;
 		}
+		ld->mode = get16bit(&ptr);
+	}
+	ld->uid = get32bit(&ptr);
+	ld->gid = get32bit(&ptr);
+	ld->atime = get32bit(&ptr);
+	ld->mtime = get32bit(&ptr);
+	ld->ctime = get32bit(&ptr);
+	if (mver<=0x13) {
+		ld->trashretention = (get32bit(&ptr)+3599)/3600;
+	} else {
+		ld->trashretention = get16bit(&ptr);
+	}
+	ld->x = 0;
+	ld->length = 0;
+	ld->sessionids = 0;
+	switch (ld->type) {
+	case TYPE_BLOCKDEV:
+	case TYPE_CHARDEV:
+	case TYPE_SYMLINK:
+		ld->x = get32bit(&ptr);
 		break;
 	case TYPE_FILE:
 	case TYPE_TRASH:
 	case TYPE_SUSTAINED:
+		ld->length = get64bit(&ptr);
+		ld->x = get32bit(&ptr);
 		if (mver<=0x13) {
-			if (bio_read(fd,unodebuff,hdrsize+8+4+2)!=(hdrsize+8+4+2)) {
-				int err = errno;
-				if (nl) {
-					fputc('\n',stderr);
-					nl=0;
-				}
-				errno = err;
-				mfs_log(MFSLOG_ERRNO_SYSLOG_STDERR,MFSLOG_ERR,"loading node: read error");
-				return -1;
-			}
-		} else {
-			if (bio_read(fd,unodebuff,hdrsize+8+4)!=(hdrsize+8+4)) {
-				int err = errno;
-				if (nl) {
-					fputc('\n',stderr);
-					nl=0;
-				}
-				errno = err;
-				mfs_log(MFSLOG_ERRNO_SYSLOG_STDERR,MFSLOG_ERR,"loading node: read error");
-				return -1;
-			}
+			ld->sessionids = get16bit(&ptr);
 		}
 		break;
-	default:
-		if (nl) {
+	}
+	ld->dataoffset = ptr-rec;
+}
+
+static inline void fs_loadnode_acquire_sessions(const uint8_t *ptr,uint32_t sessionids,uint32_t inode) {
+	while (sessionids) {
+		of_mr_acquire(get32bit(&ptr),inode);
+		sessionids--;
+	}
+}
+
+/* adds fully loaded node to structures */
+static inline int fs_loadnode_finish(loadnode_state *ls,fsnode *p) {
+	if (fsnodes_node_find(p->inode)!=NULL) {
+		if (ls->nl) {
 			fputc('\n',stderr);
-			nl=0;
+			ls->nl=0;
+		}
+		mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_ERR,"loading node %"PRIu32" error: node already exists",p->inode);
+		if (p->type==TYPE_FILE || p->type==TYPE_TRASH || p->type==TYPE_SUSTAINED) {
+			if (p->data.fdata.chunktab!=NULL) {
+				chunktab_free(p->data.fdata.chunktab,p->data.fdata.chunks);
+			}
+		}
+		if (p->type==TYPE_SYMLINK) {
+			if (p->data.sdata.path) {
+				symlink_free(p->data.sdata.path,p->data.sdata.pleng);
+			}
+		}
+		switch (p->type) {
+			case TYPE_DIRECTORY:
+				fsnode_dir_free(p);
+				break;
+			case TYPE_FILE:
+			case TYPE_TRASH:
+			case TYPE_SUSTAINED:
+				fsnode_file_free(p);
+				break;
+			case TYPE_SYMLINK:
+				fsnode_symlink_free(p);
+				break;
+			case TYPE_BLOCKDEV:
+			case TYPE_CHARDEV:
+				fsnode_dev_free(p);
+				break;
+			default:
+				fsnode_other_free(p);
+		}
+		if (ls->ignoreflag==0) {
+			fprintf(stderr,"use option '-i' to ignore\n");
+			return -1;
+		}
+	} else {
+		fsnodes_node_add(p);
+		fsnodes_used_inode(p->inode);
+		nodes++;
+		if (p->type==TYPE_DIRECTORY) {
+			dirnodes++;
+		}
+		if (p->type==TYPE_FILE || p->type==TYPE_TRASH || p->type==TYPE_SUSTAINED) {
+			filenodes++;
 		}
-		mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_ERR,"loading node: unrecognized node type: %"PRIu8,type);
-		return -1;
 	}
-	ptr = unodebuff;
-	switch (type) {
+	return 0;
+}
+
+static int fs_loadnode_apply(const uint8_t *rec,uint32_t leng,uint8_t tag,const void *dec,void *arg) {
+	loadnode_state *ls = (loadnode_state*)arg;
+	const loadnode_dec *ld = (const loadnode_dec*)dec;
+	const uint8_t *ptr;
+	uint32_t i,ch;
+	fsnode *p;
+
+	(void)leng;
+	tag &= ~LOADPIPE_LAST;
+	if (tag==LOADNODE_TAG_SKIP) {
+		return 0;
+	}
+	if (tag==LOADNODE_TAG_CHUNKS) {	// next piece of chunk table
+		p = ls->pending;
+		ptr = rec;
+		ch = (ls->chleft>LOADNODE_PIECE)?LOADNODE_PIECE:ls->chleft;
+		for (i=0 ; i<ch ; i++) {
+			p->data.fdata.chunktab[ls->chindx++] = get64bit(&ptr);
+		}
+		ls->chleft -= ch;
+		if (ls->chleft>0) {
+			return 0;
+		}
+		fs_loadnode_acquire_sessions(ptr,ls->sessionids,p->inode);
+		ls->pending = NULL;
+		return fs_loadnode_finish(ls,p);
+	}
+	if (rec[0]==0) {	// last node
+		return 1;
+	}
+	switch (ld->type) {
 		case TYPE_DIRECTORY:
 			p = fsnode_dir_malloc();
 			break;
@@ -9988,47 +10335,42 @@ static inline int fs_loadnode(bio *fd,uint8_t mver,int ignoreflag,uint8_t *unode
 		case TYPE_CHARDEV:
 			p = fsnode_dev_malloc();
 			break;
-		default:
+		case TYPE_FIFO:
+		case TYPE_SOCKET:
 			p = fsnode_other_malloc();
+			break;
+		default:
+			if (ls->nl) {
+				fputc('\n',stderr);
+				ls->nl=0;
+			}
+			mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_ERR,"loading node: unrecognized node type: %"PRIu8,rec[0]);
+			return -1;
 	}
 	passert(p);
 	p->xattrflag = 0;
 	p->aclpermflag = 0;
 	p->acldefflag = 0;
 	p->keepmode = 0;
-	p->type = type;
-	p->inode = get32bit(&ptr);
-	p->sclassid = get8bit(&ptr);
-	if (type!=TYPE_DIRECTORY && type!=TYPE_FILE && type!=TYPE_TRASH && type!=TYPE_SUSTAINED) {
+	p->type = ld->type;
+	p->inode = ld->inode;
+	p->sclassid = ld->sclassid;
+	if (p->type!=TYPE_DIRECTORY && p->type!=TYPE_FILE && p->type!=TYPE_TRASH && p->type!=TYPE_SUSTAINED) {
 		p->sclassid=0;
 	}
 	sclass_incref(p->sclassid,p->type);
-	if (mver<=0x11) {
-		uint16_t flagsmode = get16bit(&ptr);
-		p->eattr = flagsmode>>12;
-		p->winattr = 0;
-		p->mode = flagsmode&0xFFF;
-	} else {
-		p->eattr = get8bit(&ptr);
-		if (mver>=0x14) {
-			p->winattr = get8bit(&ptr);
-		} else {
-			p->winattr = 0;
-		}
-		p->mode = get16bit(&ptr);
-	}
-	p->uid = get32bit(&ptr);
-	p->gid = get32bit(&ptr);
-	p->atime = get32bit(&ptr);
-	p->mtime = get32bit(&ptr);
-	p->ctime = get32bit(&ptr);
-	if (mver<=0x13) {
-		trashseconds = get32bit(&ptr);
-		p->trashretention = (trashseconds+3599)/3600;
-	} else {
-		p->trashretention = get16bit(&ptr);
-	}
-	switch (type) {
+	p->eattr = ld->eattr;
+	p->winattr = ld->winattr;
+	p->mode = ld->mode;
+	p->uid = ld->uid;
+	p->gid = ld->gid;
+	p->atime = ld->atime;
+	p->mtime = ld->mtime;
+	p->ctime = ld->ctime;
+	p->trashretention = ld->trashretention;
+	p->parents = NULL;
+	ptr = rec+ld->dataoffset;
+	switch (p->type) {
 	case TYPE_DIRECTORY:
 		memset(&(p->data.ddata.stats),0,sizeof(statsrecord));
 		p->data.ddata.quota = NULL;
@@ -10043,34 +10385,21 @@ static inline int fs_loadnode(bio *fd,uint8_t mver,int ignoreflag,uint8_t *unode
 	case TYPE_BLOCKDEV:
 	case TYPE_CHARDEV:
 		p->data.devdata.nlink = 0;
-		p->data.devdata.rdev = get32bit(&ptr);
+		p->data.devdata.rdev = ld->x;
 		break;
 	case TYPE_SYMLINK:
 		p->data.sdata.nlink = 0;
-		pleng = get32bit(&ptr);
-		p->data.sdata.pleng = pleng;
-		if (pleng>0) {
-			if (pleng>MFS_SYMLINK_MAX) {
+		p->data.sdata.pleng = ld->x;
+		if (ld->x>0) {
+			if (ld->x>MFS_SYMLINK_MAX) {	// path itself is skipped (LOADNODE_TAG_SKIP records)
 				p->data.sdata.pleng = 22;
 				p->data.sdata.path = symlink_malloc(p->data.sdata.pleng);
 				passert(p->data.sdata.path);
 				memcpy(p->data.sdata.path,"... path too long ...",p->data.sdata.pleng);
-				bio_skip(fd,pleng);
 			} else {
-				p->data.sdata.path = symlink_malloc(pleng);
+				p->data.sdata.path = symlink_malloc(ld->x);
 				passert(p->data.sdata.path);
-				if (bio_read(fd,p->data.sdata.path,pleng)!=pleng) {
-					int err = errno;
-					if (nl) {
-						fputc('\n',stderr);
-						nl=0;
-					}
-					errno = err;
-					mfs_log(MFSLOG_ERRNO_SYSLOG_STDERR,MFSLOG_ERR,"loading node: read error");
-					symlink_free(p->data.sdata.path,pleng);
-					fsnode_symlink_free(p);
-					return -1;
-				}
+				memcpy(p->data.sdata.path,ptr,ld->x);
 			}
 		} else {
 			p->data.sdata.path = NULL;
@@ -10080,120 +10409,56 @@ static inline int fs_loadnode(bio *fd,uint8_t mver,int ignoreflag,uint8_t *unode
 	case TYPE_TRASH:
 	case TYPE_SUSTAINED:
 		p->data.fdata.nlink = 0;
-		p->data.fdata.length = get64bit(&ptr);
-		ch = get32bit(&ptr);
-		p->data.fdata.chunks = ch;
-		if (mver<=0x13) {
-			sessionids = get16bit(&ptr);
-		} else {
-			sessionids = 0;
-		}
-		if (ch>0) {
-			p->data.fdata.chunktab = chunktab_malloc(ch);
+		p->data.fdata.length = ld->length;
+		p->data.fdata.chunks = ld->x;
+		if (ld->x>0) {
+			p->data.fdata.chunktab = chunktab_malloc(ld->x);
 			passert(p->data.fdata.chunktab);
 		} else {
 			p->data.fdata.chunktab = NULL;
 		}
-		indx = 0;
-		while (ch>65536) {
-			chptr = ptr;
-			if (bio_read(fd,(uint8_t*)ptr,8*65536)!=(8*65536)) {
-				int err = errno;
-				if (nl) {
-					fputc('\n',stderr);
-					nl=0;
-				}
-				errno = err;
-				mfs_log(MFSLOG_ERRNO_SYSLOG_STDERR,MFSLOG_ERR,"loading node: read error");
-				if (p->data.fdata.chunktab) {
-					chunktab_free(p->data.fdata.chunktab,p->data.fdata.chunks);
-				}
-				fsnode_file_free(p);
-				return -1;
-			}
-			for (i=0 ; i<65536 ; i++) {
-				p->data.fdata.chunktab[indx] = get64bit(&chptr);
-				indx++;
-			}
-			ch-=65536;
-		}
-		if (bio_read(fd,(uint8_t*)ptr,8*ch+4*sessionids)!=(8*ch+4*sessionids)) {
-			int err = errno;
-			if (nl) {
-				fputc('\n',stderr);
-				nl=0;
-			}
-			errno = err;
-			mfs_log(MFSLOG_ERRNO_SYSLOG_STDERR,MFSLOG_ERR,"loading node: read error");
-			if (p->data.fdata.chunktab) {
-				chunktab_free(p->data.fdata.chunktab,p->data.fdata.chunks);
-			}
-			fsnode_file_free(p);
-			return -1;
-		}
+		ch = (ld->x>LOADNODE_PIECE)?LOADNODE_PIECE:ld->x;
 		for (i=0 ; i<ch ; i++) {
-			p->data.fdata.chunktab[indx] = get64bit(&ptr);
-			indx++;
+			p->data.fdata.chunktab[i] = get64bit(&ptr);
 		}
-
-		while (sessionids) {
-			sessionid = get32bit(&ptr);
-			of_mr_acquire(sessionid,p->inode);
-			sessionids--;
+		if (ld->x>ch) {	// rest of chunk table is in following records
+			ls->pending = p;
+			ls->chindx = ch;
+			ls->chleft = ld->x-ch;
+			ls->sessionids = ld->sessionids;
+			return 0;
 		}
+		fs_loadnode_acquire_sessions(ptr,ld->sessionids,p->inode);
+		break;
 	}
-	p->parents = NULL;
-	if (fsnodes_node_find(p->inode)!=NULL) {
-		if (nl) {
+	return fs_loadnode_finish(ls,p);
+}
+
+static int fs_loadnodes_common(bio *fd,uint8_t mver,int ignoreflag) {
+	loadnode_state ls;
+	fsnode *p;
+	int s;
+
+	memset(&ls,0,sizeof(ls));
+	ls.mver = mver;
+	ls.ignoreflag = ignoreflag;
+	ls.nl = 1;
+	s = loadpipe_run(fd,sizeof(loadnode_dec),fs_loadnode_frame,fs_loadnode_decode,fs_loadnode_apply,&ls);
+	if (ls.pending!=NULL) {	// read error in the middle of chunk table
+		p = ls.pending;
+		chunktab_free(p->data.fdata.chunktab,p->data.fdata.chunks);
+		fsnode_file_free(p);
+	}
+	if (s==-2) {
+		int err = errno;
+		if (ls.nl) {
 			fputc('\n',stderr);
-			nl=0;
-		}
-		mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_ERR,"loading node %"PRIu32" error: node already exists",p->inode);
-		if (p->type==TYPE_FILE || p->type==TYPE_TRASH || p->type==TYPE_SUSTAINED) {
-			if (p->data.fdata.chunktab!=NULL) {
-				chunktab_free(p->data.fdata.chunktab,p->data.fdata.chunks);
-			}
-		}
-		if (p->type==TYPE_SYMLINK) {
-			if (p->data.sdata.path) {
-				symlink_free(p->data.sdata.path,p->data.sdata.pleng);
-			}
-		}
-		switch (p->type) {
-			case TYPE_DIRECTORY:
-				fsnode_dir_free(p);
-				break;
-			case TYPE_FILE:
-			case TYPE_TRASH:
-			case TYPE_SUSTAINED:
-				fsnode_file_free(p);
-				break;
-			case TYPE_SYMLINK:
-				fsnode_symlink_free(p);
-				break;
-			case TYPE_BLOCKDEV:
-			case TYPE_CHARDEV:
-				fsnode_dev_free(p);
-				break;
-			default:
-				fsnode_other_free(p);
-		}
-		if (ignoreflag==0) {
-			fprintf(stderr,"use option '-i' to ignore\n");
-			return -1;
-		}
-	} else {
-		fsnodes_node_add(p);
-		fsnodes_used_inode(p->inode);
-		nodes++;
-		if (type==TYPE_DIRECTORY) {
-			dirnodes++;
-		}
-		if (type==TYPE_FILE || type==TYPE_TRASH || type==TYPE_SUSTAINED) {
-			filenodes++;
+			ls.nl=0;
 		}
+		errno = err;
+		mfs_log(MFSLOG_ERRNO_SYSLOG_STDERR,MFSLOG_ERR,"loading node: read error");
 	}
-	return 0;
+	return (s<0)?-1:0;
 }
 
 uint8_t fs_storenodes(bio *fd) {
@@ -10214,8 +10479,8 @@ uint8_t fs_storenodes(bio *fd) {
 	}
 
 	auxbuff = malloc(1+4+1+1+1+2+4+4+4+4+4+2+8+4+2+8*65536+4*65536+4);
-	for (i=0 ; i<noderehashpos ; i++) {
-		for (p=nodehashtab[i>>HASHTAB_LOBITS][i&HASHTAB_MASK] ; p && bio_error(fd)==0 ; p=p->next) {
+	for (i=0 ; i<nodeindexslots ; i++) {
+		if ((p=fsnodes_node_slot(i))!=NULL && bio_error(fd)==0) {
 			fs_storenode(p,fd,auxbuff);
 		}
 	}
@@ -10271,6 +10536,377 @@ uint8_t fs_storeedges(bio *fd) {
 	return 0;
 }
 
+/* incremental store (without fork) - see metadata.c
+ *
+ * Marks are flipped when store begins, so every object becomes 'not stored'. Then nodes are stored by scanning
+ * the hash table in small steps, and every node (and edge) which is about to be changed or removed is stored
+ * first (fsnodes_preserve), so the file describes metadata exactly as they were when store began.
+ * Edges have to be grouped by parents, so they are stored by directories (removed edges are kept in memory
+ * until their group is stored). New edges have lower ids than all edges which existed when store began.
+ */
+
+#define INCSTORE_IDLE 0
+#define INCSTORE_NODES 1
+#define INCSTORE_EDGES 2
+
+#define SPOOL_DIR 0
+#define SPOOL_TRASH 1
+#define SPOOL_SUSTAINED 2
+
+#define SPOOL_HASHSIZE 65536
+
+typedef struct _spooledge {
+	uint64_t edgeid;
+	uint32_t leng;
+	struct _spooledge *next;
+	uint8_t data[1];
+} spooledge;
+
+typedef struct _spoolgroup {
+	uint32_t id;
+	uint8_t kind;
+	uint32_t cnt;
+	spooledge *head;
+	struct _spoolgroup *next;
+} spoolgroup;
+
+static spoolgroup **spoolhash = NULL;
+static uint64_t spooledges;
+static uint64_t spoolbytes;
+
+static uint8_t incstore_phase = INCSTORE_IDLE;
+static uint8_t incstore_step;
+static uint32_t incstore_pos;
+static bio *incstore_fd;
+static uint8_t *incstore_buff;
+static uint64_t incstore_nextedgeid;
+
+static void fs_spool_edge(uint8_t kind,uint32_t id,fsedge *e) {
+	spoolgroup *g;
+	spooledge *se;
+	uint32_t hash;
+
+	hash = (hash32(id)+kind) & (SPOOL_HASHSIZE-1);
+	for (g=spoolhash[hash] ; g!=NULL && (g->id!=id || g->kind!=kind) ; g=g->next) {}
+	if (g==NULL) {
+		g = malloc(sizeof(spoolgroup));
+		passert(g);
+		g->id = id;
+		g->kind = kind;
+		g->cnt = 0;
+		g->head = NULL;
+		g->next = spoolhash[hash];
+		spoolhash[hash] = g;
+	}
+	se = malloc(offsetof(spooledge,data)+4+4+8+2+e->nleng);
+	passert(se);
+	se->edgeid = e->edgeid;
+	se->leng = fs_edgerecord(e,se->data);
+	se->next = g->head;
+	g->head = se;
+	g->cnt++;
+	spooledges++;
+	spoolbytes += se->leng;
+}
+
+static spoolgroup* fs_spool_detach(uint8_t kind,uint32_t id) {
+	spoolgroup *g,**gp;
+
+	gp = spoolhash + ((hash32(id)+kind) & (SPOOL_HASHSIZE-1));
+	while ((g=*gp)!=NULL) {
+		if (g->id==id && g->kind==kind) {
+			*gp = g->next;
+			return g;
+		}
+		gp = &(g->next);
+	}
+	return NULL;
+}
+
+static int fs_spool_cmp(const void *a,const void *b) {
+	const spooledge *aa = *((const spooledge**)a);
+	const spooledge *bb = *((const spooledge**)b);
+	return (aa->edgeid<bb->edgeid)?-1:(aa->edgeid>bb->edgeid)?1:0;
+}
+
+static inline void fs_spool_write(spooledge *se) {
+	if (bio_write(incstore_fd,se->data,se->leng)==se->leng) {
+		bio_record_end(incstore_fd);
+	}
+}
+
+static void fs_spool_free(spoolgroup *g) {
+	spooledge *se,*nse;
+
+	for (se=g->head ; se ; se=nse) {
+		nse = se->next;
+		free(se);
+	}
+	free(g);
+}
+
+// stores edges of given directory - old edges still present in the list merged with removed ones (both sorted by edgeid)
+static void fs_incstore_dir(uint32_t inode,fsedge *list) {
+	spoolgroup *g;
+	spooledge **tab,*se;
+	uint32_t i,cnt;
+	fsedge *e;
+
+	g = fs_spool_detach(SPOOL_DIR,inode);
+	tab = NULL;
+	cnt = 0;
+	if (g!=NULL) {
+		tab = malloc(sizeof(spooledge*)*g->cnt);
+		passert(tab);
+		for (se=g->head ; se ; se=se->next) {
+			tab[cnt++] = se;
+		}
+		qsort(tab,cnt,sizeof(spooledge*),fs_spool_cmp);
+	}
+	i = 0;
+	for (e=list ; e ; e=e->nextchild) {
+		if (e->edgeid<=incstore_nextedgeid) { // created after store began
+			continue;
+		}
+		while (i<cnt && tab[i]->edgeid<e->edgeid) {
+			fs_spool_write(tab[i++]);
+		}
+		fs_storeedge(e,incstore_fd,incstore_buff);
+	}
+	while (i<cnt) {
+		fs_spool_write(tab[i++]);
+	}
+	if (g!=NULL) {
+		free(tab);
+		fs_spool_free(g);
+	}
+}
+
+// stores trash or sustained edges from one bucket
+static void fs_incstore_detached(uint8_t kind,uint32_t bid,fsedge *list) {
+	spoolgroup *g;
+	spooledge *se;
+	fsedge *e;
+
+	g = fs_spool_detach(kind,bid);
+	if (g!=NULL) {
+		for (se=g->head ; se ; se=se->next) {
+			fs_spool_write(se);
+		}
+		fs_spool_free(g);
+	}
+	for (e=list ; e ; e=e->nextchild) {
+		if (e->child->edgemark!=storemarkcur) {
+			e->child->edgemark = storemarkcur;
+			fs_storeedge(e,incstore_fd,incstore_buff);
+		}
+	}
+}
+
+static void fsnodes_preserve_slow(fsnode *p) {
+	if (p->storemark!=storemarkcur) {
+		p->storemark = storemarkcur;
+		if (incstore_phase==INCSTORE_NODES) {
+			fs_storenode(p,incstore_fd,incstore_buff);
+		}
+	}
+	if (p->type!=TYPE_DIRECTORY && p->edgemark!=storemarkcur) {
+		p->edgemark = storemarkcur;
+		if (incstore_phase!=INCSTORE_IDLE && p->parents!=NULL) {
+			if (p->type==TYPE_TRASH) {
+				fs_spool_edge(SPOOL_TRASH,p->inode % TRASH_BUCKETS,p->parents);
+			} else if (p->type==TYPE_SUSTAINED) {
+				fs_spool_edge(SPOOL_SUSTAINED,p->inode % SUSTAINED_BUCKETS,p->parents);
+			}
+		}
+	}
+}
+
+static void fsnodes_preserve_edge_slow(fsedge *e) {
+	if (incstore_phase!=INCSTORE_IDLE && e->edgeid>incstore_nextedgeid) {
+		fs_spool_edge(SPOOL_DIR,e->parent->inode,e);
+	}
+}
+
+// returns -1 when edge ids can't tell old edges from new ones (before renumeration or just after it)
+int fs_incstore_begin(void) {
+	if (incstore_phase!=INCSTORE_IDLE || nextedgeid==EDGEID_MAX || nextedgeid==takenedgeid || edgesneedrenumeration) {
+		return -1;
+	}
+	if (spoolhash==NULL) {
+		spoolhash = malloc(sizeof(spoolgroup*)*SPOOL_HASHSIZE);
+		passert(spoolhash);
+	}
+	memset(spoolhash,0,sizeof(spoolgroup*)*SPOOL_HASHSIZE);
+	spooledges = 0;
+	spoolbytes = 0;
+	incstore_buff = malloc(1+4+1+1+1+2+4+4+4+4+4+2+8+4+2+8*65536+4*65536+4);
+	passert(incstore_buff);
+	incstore_fd = NULL;
+	incstore_pos = 0;
+	incstore_nextedgeid = nextedgeid;
+	storemarkcur ^= 1;
+	incstore_phase = INCSTORE_NODES;
+	return 0;
+}
+
+// has to be called just after fs_incstore_begin - all nodes and edges are written to 'fd' from now on
+uint8_t fs_incstore_nodes_header(bio *fd) {
+	uint8_t hdr[8];
+	uint8_t *ptr;
+
+	ptr = hdr;
+	put32bit(&ptr,maxnodeid);
+	put32bit(&ptr,nodes);
+	incstore_fd = fd;
+	return (bio_write(fd,hdr,8)!=8)?0xFF:0;
+}
+
+// returns 1 when all nodes have been stored
+int fs_incstore_nodes(uint32_t steps) {
+	fsnode *p;
+
+	while (incstore_pos<nodeindexslots) {
+		if ((p=fsnodes_node_slot(incstore_pos))!=NULL) {
+			if (p->storemark!=storemarkcur) {
+				p->storemark = storemarkcur;
+				fs_storenode(p,incstore_fd,incstore_buff);
+				if (p->type!=TYPE_DIRECTORY && p->type!=TYPE_TRASH && p->type!=TYPE_SUSTAINED) {
+					p->edgemark = storemarkcur;
+				}
+			}
+			if (steps>0) {
+				steps--;
+			}
+		}
+		incstore_pos++;
+		if (steps==0) {
+			return 0;
+		}
+	}
+	fs_storenode(NULL,incstore_fd,NULL);	// end marker
+	return 1;
+}
+
+void fs_incstore_edges_begin(void) {
+	uint8_t hdr[8];
+	uint8_t *ptr;
+
+	ptr = hdr;
+	put64bit(&ptr,incstore_nextedgeid);
+	bio_write(incstore_fd,hdr,8);
+	incstore_phase = INCSTORE_EDGES;
+	incstore_step = 0;
+	incstore_pos = 0;
+}
+
+// returns 1 when all edges have been stored
+int fs_incstore_edges(uint32_t steps) {
+	spoolgroup *g,**gp;
+	fsnode *p;
+
+	while (steps>0) {
+		switch (incstore_step) {
+			case 0: // directories
+				if (incstore_pos>=nodeindexslots) {
+					incstore_step++;
+					incstore_pos = 0;
+					break;
+				}
+				if ((p=fsnodes_node_slot(incstore_pos))!=NULL) {
+					if (p->type==TYPE_DIRECTORY && p->edgemark!=storemarkcur) {
+						p->edgemark = storemarkcur;
+						fs_incstore_dir(p->inode,p->data.ddata.children);
+					}
+					if (steps>0) {
+						steps--;
+					}
+				}
+				incstore_pos++;
+				break;
+			case 1: // directories removed during store
+				if (incstore_pos>=SPOOL_HASHSIZE) {
+					incstore_step++;
+					incstore_pos = 0;
+					break;
+				}
+				gp = spoolhash + incstore_pos;
+				while ((g=*gp)!=NULL) {
+					if (g->kind==SPOOL_DIR) {
+						fs_incstore_dir(g->id,NULL);
+						if (steps>0) {
+							steps--;
+						}
+					} else {
+						gp = &(g->next);
+					}
+				}
+				incstore_pos++;
+				break;
+			case 2:
+				if (incstore_pos>=TRASH_BUCKETS) {
+					incstore_step++;
+					incstore_pos = 0;
+					break;
+				}
+				fs_incstore_detached(SPOOL_TRASH,incstore_pos,trash[incstore_pos]);
+				incstore_pos++;
+				steps--;
+				break;
+			case 3:
+				if (incstore_pos>=SUSTAINED_BUCKETS) {
+					incstore_step++;
+					incstore_pos = 0;
+					break;
+				}
+				fs_incstore_detached(SPOOL_SUSTAINED,incstore_pos,sustained[incstore_pos]);
+				incstore_pos++;
+				steps--;
+				break;
+			default:
+				fs_storeedge(NULL,incstore_fd,incstore_buff);	// end marker
+				fs_incstore_cancel();
+				return 1;
+		}
+	}
+	return 0;
+}
+
+// also called at the end of store - if it wasn't finished then marks all objects as stored (marks have to be consistent for the next store)
+void fs_incstore_cancel(void) {
+	uint32_t i;
+	spoolgroup *g,*ng;
+	fsnode *p;
+
+	if (incstore_phase==INCSTORE_IDLE) {
+		return;
+	}
+	if (incstore_step<4 || incstore_phase==INCSTORE_NODES) {
+		for (i=0 ; i<nodeindexslots ; i++) {
+			if ((p=fsnodes_node_slot(i))!=NULL) {
+				p->storemark = storemarkcur;
+				p->edgemark = storemarkcur;
+			}
+		}
+	}
+	for (i=0 ; i<SPOOL_HASHSIZE ; i++) {
+		for (g=spoolhash[i] ; g ; g=ng) {
+			ng = g->next;
+			fs_spool_free(g);
+		}
+		spoolhash[i] = NULL;
+	}
+	free(incstore_buff);
+	incstore_buff = NULL;
+	incstore_fd = NULL;
+	incstore_phase = INCSTORE_IDLE;
+}
+
+void fs_incstore_info(uint64_t *edgescnt,uint64_t *bytes) {
+	*edgescnt = spooledges;
+	*bytes = spoolbytes;
+}
+
 int fs_lostnode(fsnode *p) {
 	uint8_t artname[40];
 	uint32_t i,l;
@@ -10295,8 +10931,8 @@ int fs_checknodes(void) {
 	uint8_t nl;
 	fsnode *p;
 	nl=1;
-	for (i=0 ; i<noderehashpos ; i++) {
-		for (p=nodehashtab[i>>HASHTAB_LOBITS][i&HASHTAB_MASK] ; p ; p=p->next) {
+	for (i=0 ; i<nodeindexslots ; i++) {
+		if ((p=fsnodes_node_slot(i))!=NULL) {
 			if (p->parents==NULL && p!=root) {
 				if (nl) {
 					fputc('\n',stderr);
@@ -10313,26 +10949,15 @@ int fs_checknodes(void) {
 }
 
 int fs_importnodes(bio *fd,uint32_t mni,int ignoreflag) {
-	int s;
-	uint8_t *auxbuff;
 	maxnodeid = mni;
 	hashelements = 1;
 
 	fsnodes_init_freebitmask();
 
-	auxbuff = malloc(4+1+1+1+2+4+4+4+4+4+4+8+4+2+8*65536+4*65536+4);
-	fs_loadnode(NULL,0,ignoreflag,NULL);
-	do {
-		s = fs_loadnode(fd,0x10,ignoreflag,auxbuff);
-	} while (s==0);
-	free(auxbuff);
-
-	return (s<0)?-1:0;
+	return fs_loadnodes_common(fd,0x10,ignoreflag);
 }
 
 int fs_loadnodes(bio *fd,uint8_t mver,int ignoreflag) {
-	int s;
-	uint8_t *auxbuff;
 	uint8_t hdr[8];
 	const uint8_t *ptr;
 
@@ -10353,18 +10978,12 @@ int fs_loadnodes(bio *fd,uint8_t mver,int ignoreflag) {
 	}
 	fsnodes_init_freebitmask();
 
-	auxbuff = malloc(4+1+1+1+2+4+4+4+4+4+4+8+4+2+8*65536+4*65536+4);
-	fs_loadnode(NULL,0,ignoreflag,NULL);
-	do {
-		s = fs_loadnode(fd,mver,ignoreflag,auxbuff);
-	} while (s==0);
-	free(auxbuff);
-
-	return (s<0)?-1:0;
+	return fs_loadnodes_common(fd,mver,ignoreflag);
 }
 
 int fs_loadedges(bio *fd,uint8_t mver,int ignoreflag) {
 	int s;
+	loadedge_state ls;
 	uint8_t hdr[8];
 	const uint8_t *ptr;
 
@@ -10380,11 +10999,23 @@ int fs_loadedges(bio *fd,uint8_t mver,int ignoreflag) {
 		edgesneedrenumeration = 1;
 	}
 
-	fs_loadedge(NULL,mver,ignoreflag);	// init
-	do {
-		s = fs_loadedge(fd,mver,ignoreflag);
-	} while (s==0);
-
+	memset(&ls,0,sizeof(ls));
+	ls.mver = mver;
+	ls.bsize = (mver<=0x10)?(4+4+2):(4+4+8+2);
+	ls.ignoreflag = ignoreflag;
+	ls.current_trash_bid = TRASH_BUCKETS;
+	ls.current_sustained_bid = SUSTAINED_BUCKETS;
+	ls.nl = 1;
+	s = loadpipe_run_indexed(fd,sizeof(loadedge_dec),fs_loadedge_frame,fs_loadedge_decode,fs_loadedge_apply,&ls);
+	if (s==-2) {
+		int err = errno;
+		if (ls.nl) {
+			fputc('\n',stderr);
+			ls.nl=0;
+		}
+		errno = err;
+		mfs_log(MFSLOG_ERRNO_SYSLOG_STDERR,MFSLOG_ERR,"loading edge: read error");
+	}
 	return (s<0)?-1:0;
 }
 
@@ -10664,6 +11295,7 @@ int fs_set_root_times(uint32_t ts) {
 	if (root==NULL) {
 		return -1;
 	}
+	fsnodes_preserve(root);
 	root->ctime = root->mtime = root->atime = ts;
 	return 0;
 }
@@ -10759,8 +11391,9 @@ int fs_strinit(void) {
 	freetail = &(freelist);
 	freelastts = 0;
 	fsnodes_edgeid_init();
-	fsnodes_node_hash_init();
+	fsnodes_node_index_init();
 	fsnodes_edge_hash_init();
+	fsnodes_dirindex_init();
 	fsnode_init();
 	fsedge_init();
 	symlink_init();
@@ -10770,6 +11403,7 @@ int fs_strinit(void) {
 	snapshot_inodehash = chash_new();
 
 	main_reload_register(fs_reload);
+	main_info_register(fs_memusage_info);
 	main_msectime_register(100,0,fs_test_files);
 	main_time_register(1,0,fsnodes_check_all_quotas);
 	main_time_register(1,0,fs_emptytrash);
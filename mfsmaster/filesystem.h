@@ -109,6 +109,10 @@ uint8_t fs_append_slice(uint32_t rootinode,uint8_t sesflags,uint8_t flags,uint32
 uint8_t fs_readdir_size(uint32_t rootinode,uint8_t sesflags,uint32_t inode,uint32_t uid,uint32_t gids,uint32_t *gid,uint8_t flags,uint32_t maxentries,uint64_t nedgeid,void **dnode,void **dedge,uint32_t *dbuffsize,uint8_t attrmode);
 void fs_readdir_data(uint32_t rootinode,uint8_t sesflags,uint32_t uid,uint32_t gid,uint32_t auid,uint32_t agid,uint8_t flags,uint32_t maxentries,uint64_t *nedgeid,void *dnode,void *dedge,uint8_t *dbuff,uint8_t attrmode);
 
+int fs_readers_allowed(void);
+void fs_readers_begin(void);
+void fs_readers_end(void);
+
 uint8_t fs_filechunk(uint32_t rootinode,uint8_t sesflags,uint32_t inode,uint32_t indx,uint64_t *chunkid);
 uint8_t fs_checkfile(uint32_t rootinode,uint8_t sesflags,uint32_t inode,uint8_t mode,uint32_t chunkcount[2774]);
 
@@ -216,6 +220,14 @@ uint8_t fs_storenodes(bio *fd);
 uint8_t fs_storeedges(bio *fd);
 uint8_t fs_storefree(bio *fd);
 uint8_t fs_storequota(bio *fd);
+// incremental store of NODE and EDGE sections (both written to 'fd' given to fs_incstore_nodes_header)
+int fs_incstore_begin(void);
+uint8_t fs_incstore_nodes_header(bio *fd);
+int fs_incstore_nodes(uint32_t steps);
+void fs_incstore_edges_begin(void);
+int fs_incstore_edges(uint32_t steps);
+void fs_incstore_cancel(void);
+void fs_incstore_info(uint64_t *edgescnt,uint64_t *bytes);
 
 uint8_t fs_mr_renumerate_edges(uint64_t expected_nextedgeid);
 void fs_renumerate_edge_test(void);
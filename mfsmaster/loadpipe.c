@@ -0,0 +1,568 @@
+/*
+ * Copyright (C) 2026 Jakub Kruszona-Zawadzki, Saglabs SA
+ * 
+ * This file is part of MooseFS.
+ * 
+ * MooseFS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 (only).
+ * 
+ * MooseFS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "bio.h"
+#include "loadpipe.h"
+#include "lwthread.h"
+#include "massert.h"
+#include "mfslog.h"
+#include "crc.h"
+
+#define LOADPIPE_BATCH_SIZE 0x100000
+#define LOADPIPE_BATCH_RECS 8192
+#define LOADPIPE_MAX_WORKERS 64
+
+enum {BATCH_FREE,BATCH_READ,BATCH_DECODING,BATCH_DONE};
+
+// batch errors
+#define BATCH_ERR_READ 1
+#define BATCH_ERR_CRC 2
+#define BATCH_ERR_FRAME 3
+
+typedef struct _lpbatch {
+	uint8_t *data;
+	uint32_t dsize;
+	uint32_t dleng;
+	uint32_t *recpos;
+	uint8_t *rectag;
+	uint32_t reccnt;
+	uint32_t recmax;
+	uint8_t *dec;
+	uint8_t state;
+	uint8_t last;
+	uint8_t error;
+	int lerrno;
+} lpbatch;
+
+typedef struct _loadpipe {
+	bio *fd;
+	int rfd;
+	const metaindex_section *ms;
+	uint32_t skip;
+	uint32_t decsize;
+	loadpipe_frame_fn framefn;
+	loadpipe_decode_fn decodefn;
+	void *arg;
+	lpbatch *batches;
+	uint32_t slots;
+	uint64_t rseq,dseq;
+	uint8_t readerdone;
+	uint8_t stop;
+	pthread_mutex_t lock;
+	pthread_cond_t readcond;	// reader waits for free batch
+	pthread_cond_t decodecond;	// workers wait for read batch
+	pthread_cond_t applycond;	// applier waits for decoded batch
+} loadpipe;
+
+static uint32_t LoadWorkers = 4;
+static const metaindex_section *LoadSection = NULL;
+static uint8_t LoadSectionIgnore = 0;
+
+void loadpipe_set_workers(uint32_t workers) {
+	if (workers>LOADPIPE_MAX_WORKERS) {
+		workers = LOADPIPE_MAX_WORKERS;
+	}
+	LoadWorkers = workers;
+}
+
+uint32_t loadpipe_get_workers(void) {
+	return LoadWorkers;
+}
+
+static inline void loadpipe_batch_init(lpbatch *b,uint32_t decsize) {
+	b->dsize = LOADPIPE_BATCH_SIZE;
+	b->data = malloc(b->dsize);
+	passert(b->data);
+	b->recpos = malloc(sizeof(uint32_t)*LOADPIPE_BATCH_RECS);
+	passert(b->recpos);
+	b->rectag = malloc(LOADPIPE_BATCH_RECS);
+	passert(b->rectag);
+	b->dec = malloc((size_t)decsize*LOADPIPE_BATCH_RECS);
+	passert(b->dec);
+	b->dleng = 0;
+	b->reccnt = 0;
+	b->recmax = LOADPIPE_BATCH_RECS;
+	b->state = BATCH_FREE;
+	b->last = 0;
+	b->error = 0;
+	b->lerrno = 0;
+}
+
+static inline void loadpipe_batch_free(lpbatch *b) {
+	free(b->data);
+	free(b->recpos);
+	free(b->rectag);
+	free(b->dec);
+}
+
+static inline uint32_t loadpipe_batch_recleng(lpbatch *b,uint32_t i) {
+	return ((i+1<b->reccnt)?b->recpos[i+1]:b->dleng) - b->recpos[i];
+}
+
+/* reads records until batch is full or last record has been read */
+static void loadpipe_batch_fill(loadpipe *lp,lpbatch *b) {
+	uint32_t start,have,need;
+	uint8_t tag;
+	int64_t r;
+
+	b->dleng = 0;
+	b->reccnt = 0;
+	b->last = 0;
+	b->error = 0;
+	while (b->reccnt<LOADPIPE_BATCH_RECS && b->dleng<LOADPIPE_BATCH_SIZE) {
+		start = b->dleng;
+		have = 0;
+		tag = 0;
+		while ((need = lp->framefn(b->data+start,have,&tag,lp->arg))>have) {
+			if (start+need>b->dsize) {
+				b->dsize = start+need;
+				if (b->dsize<2*LOADPIPE_BATCH_SIZE) {
+					b->dsize = 2*LOADPIPE_BATCH_SIZE;
+				}
+				b->data = realloc(b->data,b->dsize);
+				passert(b->data);
+			}
+			r = bio_read(lp->fd,b->data+start+have,need-have);
+			if (r!=(int64_t)(need-have)) {
+				b->lerrno = bio_error(lp->fd)?bio_lasterrno(lp->fd):0;
+				b->error = BATCH_ERR_READ;
+				b->last = 1;
+				return;
+			}
+			have = need;
+		}
+		b->recpos[b->reccnt] = start;
+		b->rectag[b->reccnt] = tag;
+		b->reccnt++;
+		b->dleng = start+have;
+		if (tag&LOADPIPE_LAST) {
+			b->last = 1;
+			return;
+		}
+	}
+}
+
+static inline void loadpipe_batch_decode(loadpipe *lp,lpbatch *b) {
+	uint32_t i;
+	for (i=0 ; i<b->reccnt ; i++) {
+		lp->decodefn(b->data+b->recpos[i],loadpipe_batch_recleng(b,i),b->rectag[i],b->dec+(size_t)i*lp->decsize,lp->arg);
+	}
+}
+
+static void* loadpipe_reader(void *arg) {
+	loadpipe *lp = (loadpipe*)arg;
+	lpbatch *b;
+	uint8_t last;
+
+	zassert(pthread_mutex_lock(&(lp->lock)));
+	do {
+		b = lp->batches + (lp->rseq % lp->slots);
+		while (b->state!=BATCH_FREE && lp->stop==0) {
+			zassert(pthread_cond_wait(&(lp->readcond),&(lp->lock)));
+		}
+		if (lp->stop) {
+			break;
+		}
+		zassert(pthread_mutex_unlock(&(lp->lock)));
+		loadpipe_batch_fill(lp,b);
+		last = b->last;
+		zassert(pthread_mutex_lock(&(lp->lock)));
+		b->state = BATCH_READ;
+		lp->rseq++;
+		zassert(pthread_cond_signal(&(lp->decodecond)));
+	} while (last==0);
+	lp->readerdone = 1;
+	zassert(pthread_cond_broadcast(&(lp->decodecond)));
+	zassert(pthread_mutex_unlock(&(lp->lock)));
+	return NULL;
+}
+
+static void* loadpipe_worker(void *arg) {
+	loadpipe *lp = (loadpipe*)arg;
+	lpbatch *b;
+
+	zassert(pthread_mutex_lock(&(lp->lock)));
+	while (1) {
+		while (lp->dseq==lp->rseq && lp->readerdone==0 && lp->stop==0) {
+			zassert(pthread_cond_wait(&(lp->decodecond),&(lp->lock)));
+		}
+		if (lp->stop || lp->dseq==lp->rseq) {
+			break;
+		}
+		b = lp->batches + (lp->dseq % lp->slots);
+		lp->dseq++;
+		b->state = BATCH_DECODING;
+		zassert(pthread_mutex_unlock(&(lp->lock)));
+		loadpipe_batch_decode(lp,b);
+		zassert(pthread_mutex_lock(&(lp->lock)));
+		b->state = BATCH_DONE;
+		zassert(pthread_cond_broadcast(&(lp->applycond)));
+	}
+	zassert(pthread_mutex_unlock(&(lp->lock)));
+	return NULL;
+}
+
+int loadpipe_run(bio *fd,uint32_t decsize,loadpipe_frame_fn framefn,loadpipe_decode_fn decodefn,loadpipe_apply_fn applyfn,void *arg) {
+	loadpipe lp;
+	lpbatch *b;
+	pthread_t rth;
+	pthread_t wth[LOADPIPE_MAX_WORKERS];
+	uint32_t i,workers;
+	uint64_t aseq;
+	int ret,lerrno;
+	uint8_t last;
+
+	lp.fd = fd;
+	lp.decsize = decsize;
+	lp.framefn = framefn;
+	lp.decodefn = decodefn;
+	lp.arg = arg;
+	lp.rseq = 0;
+	lp.dseq = 0;
+	lp.readerdone = 0;
+	lp.stop = 0;
+	workers = LoadWorkers;
+	lp.slots = (workers>0)?(2*workers+2):1;
+	lp.batches = malloc(sizeof(lpbatch)*lp.slots);
+	passert(lp.batches);
+	for (i=0 ; i<lp.slots ; i++) {
+		loadpipe_batch_init(lp.batches+i,decsize);
+	}
+
+	ret = 0;
+	lerrno = 0;
+	if (workers==0) { // everything in this thread
+		b = lp.batches;
+		do {
+			loadpipe_batch_fill(&lp,b);
+			loadpipe_batch_decode(&lp,b);
+			for (i=0 ; i<b->reccnt && ret==0 ; i++) {
+				ret = applyfn(b->data+b->recpos[i],loadpipe_batch_recleng(b,i),b->rectag[i],b->dec+(size_t)i*decsize,arg);
+			}
+			if (ret==0 && b->error) {
+				ret = -2;
+				lerrno = b->lerrno;
+			}
+		} while (ret==0 && b->last==0);
+	} else {
+		zassert(pthread_mutex_init(&(lp.lock),NULL));
+		zassert(pthread_cond_init(&(lp.readcond),NULL));
+		zassert(pthread_cond_init(&(lp.decodecond),NULL));
+		zassert(pthread_cond_init(&(lp.applycond),NULL));
+		zassert(lwt_minthread_create(&rth,0,loadpipe_reader,&lp));
+		for (i=0 ; i<workers ; i++) {
+			zassert(lwt_minthread_create(wth+i,0,loadpipe_worker,&lp));
+		}
+		aseq = 0;
+		do {
+			b = lp.batches + (aseq % lp.slots);
+			zassert(pthread_mutex_lock(&(lp.lock)));
+			while (b->state!=BATCH_DONE) {
+				zassert(pthread_cond_wait(&(lp.applycond),&(lp.lock)));
+			}
+			zassert(pthread_mutex_unlock(&(lp.lock)));
+			for (i=0 ; i<b->reccnt && ret==0 ; i++) {
+				ret = applyfn(b->data+b->recpos[i],loadpipe_batch_recleng(b,i),b->rectag[i],b->dec+(size_t)i*decsize,arg);
+			}
+			if (ret==0 && b->error) {
+				ret = -2;
+				lerrno = b->lerrno;
+			}
+			last = b->last;
+			zassert(pthread_mutex_lock(&(lp.lock)));
+			b->state = BATCH_FREE;
+			zassert(pthread_cond_signal(&(lp.readcond)));
+			zassert(pthread_mutex_unlock(&(lp.lock)));
+			aseq++;
+		} while (ret==0 && last==0);
+		zassert(pthread_mutex_lock(&(lp.lock)));
+		lp.stop = 1;
+		zassert(pthread_cond_broadcast(&(lp.readcond)));
+		zassert(pthread_cond_broadcast(&(lp.decodecond)));
+		zassert(pthread_mutex_unlock(&(lp.lock)));
+		zassert(pthread_join(rth,NULL));
+		for (i=0 ; i<workers ; i++) {
+			zassert(pthread_join(wth[i],NULL));
+		}
+		zassert(pthread_cond_destroy(&(lp.applycond)));
+		zassert(pthread_cond_destroy(&(lp.decodecond)));
+		zassert(pthread_cond_destroy(&(lp.readcond)));
+		zassert(pthread_mutex_destroy(&(lp.lock)));
+	}
+	for (i=0 ; i<lp.slots ; i++) {
+		loadpipe_batch_free(lp.batches+i);
+	}
+	free(lp.batches);
+	if (ret==1) {
+		ret = 0;
+	}
+	if (ret==-2) {
+		errno = lerrno;
+	}
+	return ret;
+}
+
+/* indexed sections - segments contain only whole records, so workers read (with crc check), frame and decode them independently */
+
+void loadpipe_set_section(const metaindex_section *ms,uint8_t ignoreflag) {
+	LoadSection = ms;
+	LoadSectionIgnore = ignoreflag;
+}
+
+static inline void loadpipe_batch_grow(lpbatch *b,uint32_t decsize) {
+	b->recmax *= 2;
+	b->recpos = realloc(b->recpos,sizeof(uint32_t)*b->recmax);
+	passert(b->recpos);
+	b->rectag = realloc(b->rectag,b->recmax);
+	passert(b->rectag);
+	b->dec = realloc(b->dec,(size_t)decsize*b->recmax);
+	passert(b->dec);
+}
+
+static void loadpipe_segment_fill(loadpipe *lp,lpbatch *b,uint32_t segno) {
+	const metaindex_segment *seg = lp->ms->segs+segno;
+	uint32_t start,have,need;
+	uint8_t tag;
+	ssize_t r;
+
+	b->dleng = 0;
+	b->reccnt = 0;
+	b->last = 0;
+	b->error = 0;
+	if (seg->length>b->dsize) {
+		b->dsize = seg->length;
+		b->data = realloc(b->data,b->dsize);
+		passert(b->data);
+	}
+	for (start=0 ; start<seg->length ; start+=r) {
+		r = pread(lp->rfd,b->data+start,seg->length-start,seg->offset+start);
+		if (r<=0) {
+			b->lerrno = (r<0)?errno:0;
+			b->error = BATCH_ERR_READ;
+			return;
+		}
+	}
+	if (mycrc32(0,b->data,seg->length)!=seg->crc) {
+		b->error = BATCH_ERR_CRC;
+		return;
+	}
+	start = (segno==0)?lp->skip:0;
+	b->dleng = start;
+	while (start<seg->length) {
+		have = 0;
+		tag = 0;
+		while ((need = lp->framefn(b->data+start,have,&tag,lp->arg))>have) {
+			if (need>seg->length-start) { // record crosses segment boundary
+				b->error = BATCH_ERR_FRAME;
+				return;
+			}
+			have = need;
+		}
+		if (have==0) {
+			b->error = BATCH_ERR_FRAME;
+			return;
+		}
+		if (b->reccnt>=b->recmax) {
+			loadpipe_batch_grow(b,lp->decsize);
+		}
+		b->recpos[b->reccnt] = start;
+		b->rectag[b->reccnt] = tag;
+		b->reccnt++;
+		start += have;
+		b->dleng = start;
+		if (tag&LOADPIPE_LAST) {
+			b->last = 1;
+			break;
+		}
+	}
+	loadpipe_batch_decode(lp,b);
+}
+
+static void* loadpipe_segment_worker(void *arg) {
+	loadpipe *lp = (loadpipe*)arg;
+	lpbatch *b;
+	uint32_t segno;
+
+	zassert(pthread_mutex_lock(&(lp->lock)));
+	while (1) {
+		while (lp->stop==0 && lp->rseq<lp->ms->segcnt && lp->batches[lp->rseq % lp->slots].state!=BATCH_FREE) {
+			zassert(pthread_cond_wait(&(lp->readcond),&(lp->lock)));
+		}
+		if (lp->stop || lp->rseq>=lp->ms->segcnt) {
+			break;
+		}
+		segno = lp->rseq++;
+		b = lp->batches + (segno % lp->slots);
+		b->state = BATCH_DECODING;
+		zassert(pthread_mutex_unlock(&(lp->lock)));
+		loadpipe_segment_fill(lp,b,segno);
+		zassert(pthread_mutex_lock(&(lp->lock)));
+		b->state = BATCH_DONE;
+		zassert(pthread_cond_broadcast(&(lp->applycond)));
+	}
+	zassert(pthread_mutex_unlock(&(lp->lock)));
+	return NULL;
+}
+
+static int loadpipe_segments_run(bio *fd,const metaindex_section *ms,uint32_t skip,uint8_t ignoreflag,uint32_t decsize,loadpipe_frame_fn framefn,loadpipe_decode_fn decodefn,loadpipe_apply_fn applyfn,void *arg) {
+	static const char *errstr[] = {"","read error","crc error","wrong record boundaries"};
+	loadpipe lp;
+	lpbatch *b;
+	pthread_t wth[LOADPIPE_MAX_WORKERS];
+	const metaindex_segment *seg;
+	uint32_t i,workers,aseq;
+	uint64_t endoffset;
+	int ret,lerrno;
+	uint8_t last;
+
+	lp.fd = fd;
+	lp.rfd = bio_descriptor(fd);
+	lp.ms = ms;
+	lp.skip = skip;
+	lp.decsize = decsize;
+	lp.framefn = framefn;
+	lp.decodefn = decodefn;
+	lp.arg = arg;
+	lp.rseq = 0;
+	lp.stop = 0;
+	workers = LoadWorkers;
+	if (workers>ms->segcnt) {
+		workers = ms->segcnt;
+	}
+	lp.slots = workers+2;
+	if (lp.slots>ms->segcnt) {
+		lp.slots = ms->segcnt;
+	}
+	lp.batches = malloc(sizeof(lpbatch)*lp.slots);
+	passert(lp.batches);
+	for (i=0 ; i<lp.slots ; i++) {
+		loadpipe_batch_init(lp.batches+i,decsize);
+	}
+	zassert(pthread_mutex_init(&(lp.lock),NULL));
+	zassert(pthread_cond_init(&(lp.readcond),NULL));
+	zassert(pthread_cond_init(&(lp.applycond),NULL));
+	for (i=0 ; i<workers ; i++) {
+		zassert(lwt_minthread_create(wth+i,0,loadpipe_segment_worker,&lp));
+	}
+
+	ret = 0;
+	lerrno = 0;
+	last = 0;
+	endoffset = ms->segs[0].offset+skip;
+	for (aseq=0 ; aseq<ms->segcnt && ret==0 && last==0 ; aseq++) {
+		b = lp.batches + (aseq % lp.slots);
+		seg = ms->segs+aseq;
+		zassert(pthread_mutex_lock(&(lp.lock)));
+		while (b->state!=BATCH_DONE) {
+			zassert(pthread_cond_wait(&(lp.applycond),&(lp.lock)));
+		}
+		zassert(pthread_mutex_unlock(&(lp.lock)));
+		if (b->error) {
+			mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"metadata section %c%c%c%c, segment %"PRIu32" (offset: %"PRIu64", length: %"PRIu32") - %s",ms->hdr[0],ms->hdr[1],ms->hdr[2],ms->hdr[3],aseq,seg->offset,seg->length,errstr[b->error]);
+			if (ignoreflag) {
+				mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_NOTICE,"all data from this segment will be lost !!!");
+				endoffset = seg->offset+seg->length;
+			} else if (b->error==BATCH_ERR_READ) {
+				ret = -2;
+				lerrno = b->lerrno;
+			} else {
+				ret = -1;
+			}
+		} else {
+			for (i=0 ; i<b->reccnt && ret==0 ; i++) {
+				ret = applyfn(b->data+b->recpos[i],loadpipe_batch_recleng(b,i),b->rectag[i],b->dec+(size_t)i*decsize,arg);
+			}
+			if (ret>=0) {
+				endoffset = seg->offset+((i<b->reccnt)?b->recpos[i]:b->dleng);
+			}
+			last = b->last;
+		}
+		zassert(pthread_mutex_lock(&(lp.lock)));
+		b->state = BATCH_FREE;
+		zassert(pthread_cond_broadcast(&(lp.readcond)));
+		zassert(pthread_mutex_unlock(&(lp.lock)));
+	}
+	if (ret==0 && last==0) {
+		if (ignoreflag) {
+			mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_NOTICE,"metadata section %c%c%c%c - end marker not found - ignoring",ms->hdr[0],ms->hdr[1],ms->hdr[2],ms->hdr[3]);
+		} else {
+			mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_ERR,"metadata section %c%c%c%c - end marker not found",ms->hdr[0],ms->hdr[1],ms->hdr[2],ms->hdr[3]);
+			ret = -1;
+		}
+	}
+
+	zassert(pthread_mutex_lock(&(lp.lock)));
+	lp.stop = 1;
+	zassert(pthread_cond_broadcast(&(lp.readcond)));
+	zassert(pthread_mutex_unlock(&(lp.lock)));
+	for (i=0 ; i<workers ; i++) {
+		zassert(pthread_join(wth[i],NULL));
+	}
+	zassert(pthread_cond_destroy(&(lp.applycond)));
+	zassert(pthread_cond_destroy(&(lp.readcond)));
+	zassert(pthread_mutex_destroy(&(lp.lock)));
+	for (i=0 ; i<lp.slots ; i++) {
+		loadpipe_batch_free(lp.batches+i);
+	}
+	free(lp.batches);
+	if (ret>=0 && bio_seek(fd,endoffset,SEEK_SET)<0) { // the rest is read sequentially
+		lerrno = errno;
+		ret = -2;
+	}
+	if (ret==1) {
+		ret = 0;
+	}
+	if (ret==-2) {
+		errno = lerrno;
+	}
+	return ret;
+}
+
+int loadpipe_run_indexed(bio *fd,uint32_t decsize,loadpipe_frame_fn framefn,loadpipe_decode_fn decodefn,loadpipe_apply_fn applyfn,void *arg) {
+	const metaindex_section *ms;
+	uint64_t pos;
+	uint32_t i;
+
+	ms = LoadSection;
+	LoadSection = NULL;
+	if (ms==NULL || ms->segcnt==0 || LoadWorkers==0) {
+		return loadpipe_run(fd,decsize,framefn,decodefn,applyfn,arg);
+	}
+	pos = bio_file_position(fd);
+	if (pos<ms->segs[0].offset || pos>=ms->segs[0].offset+ms->segs[0].length) {
+		return loadpipe_run(fd,decsize,framefn,decodefn,applyfn,arg);
+	}
+	for (i=0 ; i+1<ms->segcnt ; i++) {
+		if (ms->segs[i].records==0) { // segments not aligned to records
+			return loadpipe_run(fd,decsize,framefn,decodefn,applyfn,arg);
+		}
+	}
+	return loadpipe_segments_run(fd,ms,pos-ms->segs[0].offset,LoadSectionIgnore,decsize,framefn,decodefn,applyfn,arg);
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2026 Jakub Kruszona-Zawadzki, Saglabs SA
+ * 
+ * This file is part of MooseFS.
+ * 
+ * MooseFS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 (only).
+ * 
+ * MooseFS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LOADPIPE_H_
+#define _LOADPIPE_H_
+
+#include <inttypes.h>
+
+#include "bio.h"
+#include "metaindex.h"
+
+// pipelined loader of metadata sections made of variable length records:
+//   one thread reads records from bio and groups them into batches (framing only),
+//   worker threads decode batches (decode function - must not touch any global structures except read-only ones),
+//   calling thread applies decoded records in file order (apply function - all allocations, hash tables, lists etc.)
+
+#define LOADPIPE_LAST 0x80
+
+// returns number of bytes needed to frame record 'rec' having 'have' bytes already read (record is complete when result<=have)
+// '*tag' (initially zero) can be set to any value passed later to decode and apply functions ; LOADPIPE_LAST bit has to be set
+// for the last record in section (also for malformed record - apply function should report it)
+// called in file order, so it can keep state in 'arg' (must not share it with decode function)
+typedef uint32_t (*loadpipe_frame_fn)(const uint8_t *rec,uint32_t have,uint8_t *tag,void *arg);
+// decodes record into 'dec' (record data can be modified in place)
+typedef void (*loadpipe_decode_fn)(uint8_t *rec,uint32_t leng,uint8_t tag,void *dec,void *arg);
+// applies decoded record (called in file order) ; returns 0 - ok, 1 - end of section, -1 - error
+typedef int (*loadpipe_apply_fn)(const uint8_t *rec,uint32_t leng,uint8_t tag,const void *dec,void *arg);
+
+void loadpipe_set_workers(uint32_t workers);
+uint32_t loadpipe_get_workers(void);
+// returns: 0 - ok, -1 - error reported by apply function, -2 - read error (errno is set)
+int loadpipe_run(bio *fd,uint32_t decsize,loadpipe_frame_fn framefn,loadpipe_decode_fn decodefn,loadpipe_apply_fn applyfn,void *arg);
+// index of the section that is going to be loaded by next loadpipe_run_indexed (NULL - no index) ; with 'ignoreflag' damaged segments are skipped
+void loadpipe_set_section(const metaindex_section *ms,uint8_t ignoreflag);
+// as loadpipe_run, but when section has been set workers read (checking crc), frame and decode whole segments in parallel
+// (framing function can't keep any state then) ; without index falls back to loadpipe_run
+int loadpipe_run_indexed(bio *fd,uint32_t decsize,loadpipe_frame_fn framefn,loadpipe_decode_fn decodefn,loadpipe_apply_fn applyfn,void *arg);
+
+#endif
@@ -37,6 +37,7 @@
 #include <inttypes.h>
 #include <netinet/in.h>
 #include <sys/resource.h>
+#include <pthread.h>
 #ifdef HAVE_WRITEV
 #include <sys/uio.h>
 #endif
@@ -55,6 +56,7 @@
 #include "flocklocks.h"
 #include "posixlocks.h"
 #include "metadata.h"
+#include "changelog.h"
 #include "random.h"
 #include "exports.h"
 #include "datacachemgr.h"
@@ -73,6 +75,7 @@
 #include "iptosesid.h"
 #include "mfsalloc.h"
 #include "multilan.h"
+#include "lwthread.h"
 
 #define MaxPacketSize CLTOMA_MAXPACKETSIZE
 
@@ -101,7 +104,9 @@ typedef struct matoclserventry {
 	uint8_t registered;
 	uint8_t mode;				//0 - not active, 1 - read header, 2 - read packet
 	int sock;				//socket number
-	int32_t pdescpos;
+	void *ev;				//main loop event handle
+	uint8_t evrevents;			//events reported since last serve
+	uint8_t active;				//on active list (or being served)
 	double lastread,lastwrite;		//time of last activity
 	uint8_t input_hdr[8];
 	uint8_t *input_startptr;
@@ -129,11 +134,16 @@ typedef struct matoclserventry {
 
 	void *sesdata;
 
-	struct matoclserventry *next;
+	uint8_t readerctx;			// copy of entry used by reader thread (see matoclserv_readers_phase)
+
+	struct matoclserventry *anext;		//active list
+	struct matoclserventry *next,**prev;
 } matoclserventry;
 
 //static session *sessionshead=NULL;
 static matoclserventry *matoclservhead=NULL;
+static matoclserventry *matoclservactive=NULL; // connections to be served in next loop (got events, new output to send etc.)
+static uint8_t matoclservinserve=0; // active connections are processed by matoclserv_serve just now
 static int lsock;
 static int32_t lsockpdescpos;
 
@@ -213,6 +223,68 @@ static uint64_t stats_mounts_brcvd = 0;
 static uint64_t stats_mounts_bsent = 0;
 static uint32_t stats_lcnt = 0;
 
+// read-only operations - during 'readers phase' executed in parallel by reader threads
+#define READERS_MAX_THREADS 64
+#define READERS_MAX_JOBS 4096
+#define READERS_MIN_JOBS 32		// waking up threads is more expensive than executing a few operations
+#define READERS_JOBS_PER_THREAD 16
+#define READERS_OPS 6
+
+static const uint32_t readers_optypes[READERS_OPS] = {CLTOMA_FUSE_LOOKUP,CLTOMA_FUSE_GETATTR,CLTOMA_FUSE_READDIR,CLTOMA_FUSE_GETXATTR,CLTOMA_PATH_LOOKUP,CLTOMA_FUSE_STATFS};
+
+typedef struct _readerjob {
+	matoclserventry *eptr;
+	matoclserventry shadow;		// handler works on copy with its own output queue
+	in_packetstruct *ipack;
+	uint64_t usec;
+} readerjob;
+
+typedef struct _readerthread {
+	uint32_t *gid;
+	uint32_t gidleng;
+	uint64_t jobs;
+	uint64_t busyusec;
+	uint64_t startusec;
+} readerthread;
+
+static uint32_t ReaderThreads;
+
+static readerthread readers_thtab[READERS_MAX_THREADS];
+static uint32_t readers_running = 0;
+static pthread_key_t readers_key;
+static lwt_phasepool *readers_pool = NULL;
+static pthread_mutex_t readers_dcmlock = PTHREAD_MUTEX_INITIALIZER;
+static readerjob *readers_jobs = NULL;
+static uint32_t readers_jobcnt = 0;
+static uint32_t readers_jobpos = 0;
+
+static uint64_t readers_phases = 0;
+static uint64_t readers_phaseusec = 0;
+static uint64_t readers_mainjobs = 0;
+static uint64_t readers_opcnt[READERS_OPS];
+static uint64_t readers_opusec[READERS_OPS];
+static uint64_t readers_opmaxusec[READERS_OPS];
+static uint64_t serial_opcnt[READERS_OPS];
+static uint64_t serial_opusec[READERS_OPS];
+
+static inline int matoclserv_readers_opindex(uint32_t type) {
+	switch (type) {
+		case CLTOMA_FUSE_LOOKUP:
+			return 0;
+		case CLTOMA_FUSE_GETATTR:
+			return 1;
+		case CLTOMA_FUSE_READDIR:
+			return 2;
+		case CLTOMA_FUSE_GETXATTR:
+			return 3;
+		case CLTOMA_PATH_LOOKUP:
+			return 4;
+		case CLTOMA_FUSE_STATFS:
+			return 5;
+	}
+	return -1;
+}
+
 void matoclserv_stats(uint64_t stats[12]) {
 	stats[0] = stats_prcvd;
 	stats[1] = stats_psent;
@@ -240,6 +312,17 @@ void matoclserv_stats(uint64_t stats[12]) {
 	stats_lcnt = 0;
 }
 
+static inline void matoclserv_activate(matoclserventry *eptr) {
+	if (eptr->active==0) {
+		eptr->active = 1;
+		eptr->anext = matoclservactive;
+		matoclservactive = eptr;
+		if (matoclservinserve==0 && eptr->evrevents==0 && eptr->ev!=NULL) { // activated outside serve (chunk operation finished etc.) - poll has to return at once
+			main_ev_change(eptr->ev,(eptr->input_end?0:MAIN_EV_READ)|MAIN_EV_WRITE);
+		}
+	}
+}
+
 uint8_t* matoclserv_create_packet(matoclserventry *eptr,uint32_t type,uint32_t size) {
 	out_packetstruct *outpacket;
 	uint8_t *ptr;
@@ -259,6 +342,9 @@ uint8_t* matoclserv_create_packet(matoclserventry *eptr,uint32_t type,uint32_t s
 	outpacket->next = NULL;
 	*(eptr->outputtail) = outpacket;
 	eptr->outputtail = &(outpacket->next);
+	if (eptr->readerctx==0) {
+		matoclserv_activate(eptr);
+	}
 	return ptr;
 }
 
@@ -1523,6 +1609,39 @@ void matoclserv_memory_info(matoclserventry *eptr,const uint8_t *data,uint32_t l
 	put64bit(&ptr,used[7]);
 }
 
+void matoclserv_readers_info(matoclserventry *eptr,const uint8_t *data,uint32_t length) {
+	uint8_t *ptr;
+	uint32_t i;
+	uint64_t now;
+	(void)data;
+	if (length!=0) {
+		mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"CLTOMA_READERS_INFO - wrong size (%"PRIu32"/0)",length);
+		eptr->mode = KILL;
+		return;
+	}
+	ptr = matoclserv_create_packet(eptr,MATOCL_READERS_INFO,33+READERS_OPS*44+readers_running*24);
+	put32bit(&ptr,ReaderThreads);
+	put32bit(&ptr,readers_running);
+	put64bit(&ptr,readers_phases);
+	put64bit(&ptr,readers_phaseusec);
+	put64bit(&ptr,readers_mainjobs);
+	put8bit(&ptr,READERS_OPS);
+	for (i=0 ; i<READERS_OPS ; i++) {
+		put32bit(&ptr,readers_optypes[i]);
+		put64bit(&ptr,readers_opcnt[i]);
+		put64bit(&ptr,readers_opusec[i]);
+		put64bit(&ptr,readers_opmaxusec[i]);
+		put64bit(&ptr,serial_opcnt[i]);
+		put64bit(&ptr,serial_opusec[i]);
+	}
+	now = monotonic_useconds();
+	for (i=0 ; i<readers_running ; i++) {
+		put64bit(&ptr,readers_thtab[i].jobs);
+		put64bit(&ptr,readers_thtab[i].busyusec);
+		put64bit(&ptr,now-readers_thtab[i].startusec);
+	}
+}
+
 void matoclserv_fstest_info(matoclserventry *eptr,const uint8_t *data,uint32_t length) {
 	uint32_t loopstart,loopend,files,ugfiles,mfiles,mtfiles,msfiles,chunks,ugchunks,mchunks,msgbuffleng;
 	char *msgbuff;
@@ -2386,24 +2505,37 @@ void matoclserv_fuse_time_sync(matoclserventry *eptr,const uint8_t *data,uint32_
 }
 
 uint32_t* matoclserv_gid_storage(uint32_t gids) {
-	static uint32_t *gid=NULL;
-	static uint32_t gidleng=0;
+	static uint32_t *mgid=NULL;
+	static uint32_t mgidleng=0;
+	uint32_t **gid;
+	uint32_t *gidleng;
+	readerthread *rt;
+
+	rt = (readers_running>0)?pthread_getspecific(readers_key):NULL;
+	if (rt!=NULL) { // reader thread - use its own buffer
+		gid = &(rt->gid);
+		gidleng = &(rt->gidleng);
+	} else {
+		gid = &mgid;
+		gidleng = &mgidleng;
+	}
 	if (gids==0) {
-		if (gid!=NULL) {
-			free(gid);
+		if (*gid!=NULL) {
+			free(*gid);
 		}
-		gidleng=0;
+		*gid = NULL;
+		*gidleng=0;
 		return NULL;
 	} else {
-		if (gidleng<gids) {
-			gidleng = (gids+255)&UINT32_C(0xFFFFFF00);
-			if (gid!=NULL) {
-				free(gid);
+		if (*gidleng<gids) {
+			*gidleng = (gids+255)&UINT32_C(0xFFFFFF00);
+			if (*gid!=NULL) {
+				free(*gid);
 			}
-			gid = malloc(sizeof(uint32_t)*gidleng);
-			passert(gid);
+			*gid = malloc(sizeof(uint32_t)*(*gidleng));
+			passert(*gid);
 		}
-		return gid;
+		return *gid;
 	}
 }
 
@@ -2634,7 +2766,13 @@ void matoclserv_fuse_lookup(matoclserventry *eptr,const uint8_t *data,uint32_t l
 	}
 	if (eptr->version>=VERSION2INT(3,0,40)) {
 		uint8_t sesflags = sessions_get_sesflags(eptr->sesdata);
-		status = fs_lookup(sessions_get_rootinode(eptr->sesdata),sesflags,inode,nleng,name,uid,gids,gid,auid,agid,&newinode,attr,1,&accmode,&filenode,&validchunk,&chunkid);
+		if (eptr->readerctx) { // chunk checks modify chunk structures - client will ask for first chunk itself
+			validchunk = 0;
+			chunkid = 0;
+			status = fs_lookup(sessions_get_rootinode(eptr->sesdata),sesflags,inode,nleng,name,uid,gids,gid,auid,agid,&newinode,attr,0,&accmode,&filenode,NULL,NULL);
+		} else {
+			status = fs_lookup(sessions_get_rootinode(eptr->sesdata),sesflags,inode,nleng,name,uid,gids,gid,auid,agid,&newinode,attr,1,&accmode,&filenode,&validchunk,&chunkid);
+		}
 		if (status==MFS_STATUS_OK) {
 			uint32_t version;
 			uint8_t split;
@@ -2649,6 +2787,9 @@ void matoclserv_fuse_lookup(matoclserventry *eptr,const uint8_t *data,uint32_t l
 				lflags &= LOOKUP_ACCESS_MODES_RO;
 			}
 			if (filenode && (lflags&LOOKUP_ACCESS_MODES_IO)!=0) { // can be read and/or written
+				if (eptr->readerctx) {
+					zassert(pthread_mutex_lock(&readers_dcmlock));
+				}
 				if (knowflags) {
 					if ((lflags&LOOKUP_DIRECTMODE)==0) {
 						if (dcm_open(newinode,sessions_get_id(eptr->sesdata))) {
@@ -2672,6 +2813,9 @@ void matoclserv_fuse_lookup(matoclserventry *eptr,const uint8_t *data,uint32_t l
 						}
 					}
 				}
+				if (eptr->readerctx) {
+					zassert(pthread_mutex_unlock(&readers_dcmlock));
+				}
 				if (validchunk && (sessions_get_disables(eptr->sesdata)&DISABLE_READ)==0) {
 					if (chunkid>0) {
 						if (chunk_get_version_and_csdata(2,chunkid,eptr->peerip,&version,&count,cs_data,&split)==MFS_STATUS_OK) {
@@ -6672,6 +6816,9 @@ void matoclserv_gotpacket(matoclserventry *eptr,uint32_t type,const uint8_t *dat
 			case CLTOMA_MEMORY_INFO:
 				matoclserv_memory_info(eptr,data,length);
 				break;
+			case CLTOMA_READERS_INFO:
+				matoclserv_readers_info(eptr,data,length);
+				break;
 			case CLTOAN_MODULE_INFO:
 				matoclserv_module_info(eptr,data,length);
 				break;
@@ -6973,6 +7120,9 @@ void matoclserv_gotpacket(matoclserventry *eptr,uint32_t type,const uint8_t *dat
 			case CLTOMA_MEMORY_INFO:
 				matoclserv_memory_info(eptr,data,length);
 				break;
+			case CLTOMA_READERS_INFO:
+				matoclserv_readers_info(eptr,data,length);
+				break;
 			case CLTOAN_MODULE_INFO:
 				matoclserv_module_info(eptr,data,length);
 				break;
@@ -7135,11 +7285,20 @@ void matoclserv_parse(matoclserventry *eptr) {
 	in_packetstruct *ipack;
 	uint64_t starttime;
 	uint64_t currtime;
+	uint64_t opstart;
+	int opidx;
 
 	starttime = monotonic_useconds();
 	currtime = starttime;
 	while (eptr->mode==DATA && (ipack = eptr->inputhead)!=NULL && starttime+10000>currtime) {
-		matoclserv_gotpacket(eptr,ipack->type,ipack->data,ipack->leng);
+		if ((opidx = matoclserv_readers_opindex(ipack->type))>=0) {
+			opstart = monotonic_useconds();
+			matoclserv_gotpacket(eptr,ipack->type,ipack->data,ipack->leng);
+			serial_opcnt[opidx]++;
+			serial_opusec[opidx] += monotonic_useconds()-opstart;
+		} else {
+			matoclserv_gotpacket(eptr,ipack->type,ipack->data,ipack->leng);
+		}
 		eptr->inputhead = ipack->next;
 		free(ipack);
 		if (eptr->inputhead==NULL) {
@@ -7153,6 +7312,167 @@ void matoclserv_parse(matoclserventry *eptr) {
 	}
 }
 
+/* readers phase:
+ * main thread is the only one that modifies metadata, so before it starts parsing packets it can
+ * execute leading read-only packets (lookup,getattr,readdir etc.) of all connections together with
+ * reader threads. Nothing is changed during the phase (filesystem postpones its changes till
+ * fs_readers_end), answers are put into per-job queues and appended in order to the connections. */
+
+static inline void matoclserv_readers_dispatch(matoclserventry *eptr,uint32_t type,const uint8_t *data,uint32_t length) {
+	switch (type) {
+		case CLTOMA_FUSE_LOOKUP:
+			matoclserv_fuse_lookup(eptr,data,length);
+			break;
+		case CLTOMA_FUSE_GETATTR:
+			matoclserv_fuse_getattr(eptr,data,length);
+			break;
+		case CLTOMA_FUSE_READDIR:
+			matoclserv_fuse_readdir(eptr,data,length);
+			break;
+		case CLTOMA_FUSE_GETXATTR:
+			matoclserv_fuse_getxattr(eptr,data,length);
+			break;
+		case CLTOMA_PATH_LOOKUP:
+			matoclserv_path_lookup(eptr,data,length);
+			break;
+		case CLTOMA_FUSE_STATFS:
+			matoclserv_fuse_statfs(eptr,data,length);
+			break;
+	}
+}
+
+static void matoclserv_readers_work(void *arg) {
+	readerthread *rt = (readerthread*)arg;
+	readerjob *job;
+	uint32_t i;
+	uint64_t st,jobs,busy;
+
+	if (rt!=NULL) {
+		zassert(pthread_setspecific(readers_key,rt));
+	}
+	jobs = 0;
+	busy = 0;
+	while ((i = __sync_fetch_and_add(&readers_jobpos,1))<readers_jobcnt) {
+		job = readers_jobs + i;
+		st = monotonic_useconds();
+		matoclserv_readers_dispatch(&(job->shadow),job->ipack->type,job->ipack->data,job->ipack->leng);
+		job->usec = monotonic_useconds() - st;
+		jobs++;
+		busy += job->usec;
+	}
+	if (rt!=NULL) {
+		rt->jobs += jobs;
+		rt->busyusec += busy;
+	} else {
+		readers_mainjobs += jobs;
+	}
+}
+
+static inline void matoclserv_readers_phase(matoclserventry *ahead) {
+	matoclserventry *eptr;
+	in_packetstruct *ipack;
+	readerjob *job;
+	uint32_t i,helpers;
+	uint64_t st;
+	int opidx;
+
+	if (readers_jobs==NULL) {
+		readers_jobs = malloc(sizeof(readerjob)*READERS_MAX_JOBS);
+		passert(readers_jobs);
+	}
+	readers_jobcnt = 0;
+	for (eptr=ahead ; eptr && readers_jobcnt<READERS_MAX_JOBS ; eptr=eptr->anext) {
+		if (eptr->mode!=DATA || eptr->registered!=REGISTERED || eptr->sesdata==NULL) {
+			continue;
+		}
+		for (ipack=eptr->inputhead ; ipack!=NULL && readers_jobcnt<READERS_MAX_JOBS && matoclserv_readers_opindex(ipack->type)>=0 ; ipack=ipack->next) {
+			job = readers_jobs + readers_jobcnt;
+			job->eptr = eptr;
+			job->ipack = ipack;
+			job->usec = 0;
+			memcpy(&(job->shadow),eptr,sizeof(matoclserventry));
+			job->shadow.outputhead = NULL;
+			job->shadow.outputtail = &(job->shadow.outputhead);
+			job->shadow.readerctx = 1;
+			job->shadow.next = NULL;
+			job->shadow.anext = NULL;
+			readers_jobcnt++;
+		}
+	}
+	if (readers_jobcnt<READERS_MIN_JOBS) { // let them be parsed as usual
+		readers_jobcnt = 0;
+		return;
+	}
+
+	helpers = readers_jobcnt/READERS_JOBS_PER_THREAD;
+	if (helpers>ReaderThreads) {
+		helpers = ReaderThreads;
+	}
+	while (readers_running<helpers) {
+		readers_thtab[readers_running].gid = NULL;
+		readers_thtab[readers_running].gidleng = 0;
+		readers_thtab[readers_running].jobs = 0;
+		readers_thtab[readers_running].busyusec = 0;
+		readers_thtab[readers_running].startusec = monotonic_useconds();
+		if (lwt_phase_addthread(readers_pool,readers_thtab+readers_running)!=0) {
+			mfs_log(MFSLOG_ERRNO_SYSLOG,MFSLOG_WARNING,"main master server module: can't create reader thread");
+			helpers = readers_running;
+			break;
+		}
+		readers_running++;
+	}
+
+	st = monotonic_useconds();
+	fs_readers_begin();
+	readers_jobpos = 0;
+	lwt_phase_run(readers_pool,helpers,NULL);
+	fs_readers_end();
+	readers_phases++;
+	readers_phaseusec += monotonic_useconds() - st;
+
+	for (i=0 ; i<readers_jobcnt ; i++) {
+		job = readers_jobs + i;
+		eptr = job->eptr;
+		opidx = matoclserv_readers_opindex(job->ipack->type);
+		readers_opcnt[opidx]++;
+		readers_opusec[opidx] += job->usec;
+		if (job->usec > readers_opmaxusec[opidx]) {
+			readers_opmaxusec[opidx] = job->usec;
+		}
+		if (job->shadow.outputhead!=NULL) {
+			*(eptr->outputtail) = job->shadow.outputhead;
+			eptr->outputtail = job->shadow.outputtail;
+		}
+		if (job->shadow.mode==KILL) {
+			eptr->mode = KILL;
+		}
+		massert(eptr->inputhead==job->ipack,"reader job doesn't match connection input queue");
+		eptr->inputhead = job->ipack->next;
+		if (eptr->inputhead==NULL) {
+			eptr->inputtail = &(eptr->inputhead);
+		}
+		free(job->ipack);
+	}
+	readers_jobcnt = 0;
+}
+
+static void matoclserv_readers_term(void) {
+	uint32_t i;
+
+	lwt_phase_term(readers_pool);
+	readers_pool = NULL;
+	for (i=0 ; i<readers_running ; i++) {
+		if (readers_thtab[i].gid!=NULL) {
+			free(readers_thtab[i].gid);
+		}
+	}
+	readers_running = 0;
+	if (readers_jobs!=NULL) {
+		free(readers_jobs);
+		readers_jobs = NULL;
+	}
+}
+
 void matoclserv_write(matoclserventry *eptr,double now) {
 	out_packetstruct *opack;
 	int32_t i;
@@ -7162,6 +7482,7 @@ void matoclserv_write(matoclserventry *eptr,double now) {
 	uint32_t leng;
 	uint32_t left;
 
+	changelog_flush(); // changes have to be stored before any packet depending on them is sent
 	for (;;) {
 		leng = 0;
 		for (iovdata=0,opack=eptr->outputhead ; iovdata<100 && opack!=NULL ; iovdata++,opack=opack->next) {
@@ -7206,6 +7527,7 @@ void matoclserv_write(matoclserventry *eptr,double now) {
 		}
 	}
 #else
+	changelog_flush(); // changes have to be stored before any packet depending on them is sent
 	for (;;) {
 		opack = eptr->outputhead;
 		if (opack==NULL) {
@@ -7240,75 +7562,76 @@ void matoclserv_write(matoclserventry *eptr,double now) {
 
 void matoclserv_desc(struct pollfd *pdesc,uint32_t *ndesc) {
 	uint32_t pos = *ndesc;
-	matoclserventry *eptr;
 
 	pdesc[pos].fd = lsock;
 	pdesc[pos].events = POLLIN;
 	lsockpdescpos = pos;
 	pos++;
-//		FD_SET(lsock,rset);
-//		max = lsock;
-	for (eptr=matoclservhead ; eptr ; eptr=eptr->next) {
-		pdesc[pos].fd = eptr->sock;
-		pdesc[pos].events = 0;
-		eptr->pdescpos = pos;
-//		i=eptr->sock;
-		if (eptr->input_end==0) {
-			pdesc[pos].events |= POLLIN;
-//			FD_SET(i,rset);
-//			if (i>max) {
-//				max=i;
-//			}
-		}
-		if (eptr->outputhead!=NULL) {
-			pdesc[pos].events |= POLLOUT;
-//			FD_SET(i,wset);
-//			if (i>max) {
-//				max=i;
-//			}
-		}
-		pos++;
-	}
 	*ndesc = pos;
-//	return max;
 }
 
-void matoclserv_disconnection_loop(void) {
-	matoclserventry *eptr,**kptr;
+void matoclserv_ev(void *data,uint8_t events) {
+	matoclserventry *eptr = (matoclserventry*)data;
+
+	eptr->evrevents |= events;
+	matoclserv_activate(eptr);
+}
+
+static void matoclserv_kill(matoclserventry *eptr) {
 	in_packetstruct *ipptr,*ipaptr;
 	out_packetstruct *opptr,*opaptr;
 
-	kptr = &matoclservhead;
-	while ((eptr=*kptr)) {
-		if (eptr->mode == KILL) {
-			matoclserv_beforedisconnect(eptr);
-			tcpclose(eptr->sock);
-			if (eptr->input_packet) {
-				free(eptr->input_packet);
-			}
-			ipptr = eptr->inputhead;
-			while (ipptr) {
-				ipaptr = ipptr;
-				ipptr = ipptr->next;
-				free(ipaptr);
-			}
-			opptr = eptr->outputhead;
-			while (opptr) {
-				opaptr = opptr;
-				opptr = opptr->next;
-				free(opaptr);
-			}
-			*kptr = eptr->next;
-			free(eptr);
-		} else {
-			kptr = &(eptr->next);
+	eptr->active = 1; // never put it on active list again
+	matoclserv_beforedisconnect(eptr);
+	if (eptr->ev!=NULL) {
+		main_ev_unregister(eptr->ev);
+	}
+	tcpclose(eptr->sock);
+	if (eptr->input_packet) {
+		free(eptr->input_packet);
+	}
+	ipptr = eptr->inputhead;
+	while (ipptr) {
+		ipaptr = ipptr;
+		ipptr = ipptr->next;
+		free(ipaptr);
+	}
+	opptr = eptr->outputhead;
+	while (opptr) {
+		opaptr = opptr;
+		opptr = opptr->next;
+		free(opaptr);
+	}
+	*(eptr->prev) = eptr->next;
+	if (eptr->next) {
+		eptr->next->prev = eptr->prev;
+	}
+	free(eptr);
+}
+
+// called once per second - things that don't depend on descriptor events
+void matoclserv_check_connections(void) {
+	double now;
+	matoclserventry *eptr;
+
+	now = monotonic_seconds();
+	for (eptr=matoclservhead ; eptr ; eptr=eptr->next) {
+		if (eptr->lastwrite+1.0<now && eptr->outputhead==NULL) {
+			uint8_t *ptr = matoclserv_create_packet(eptr,ANTOAN_NOP,4);	// 4 byte length because of 'msgid'
+			*((uint32_t*)ptr) = 0;
+		}
+		if (eptr->lastread+eptr->timeout<now) {
+			eptr->mode = KILL;
+		}
+		if (eptr->mode!=DATA) { // killed or finished outside serve loop
+			matoclserv_activate(eptr);
 		}
 	}
 }
 
 void matoclserv_serve(struct pollfd *pdesc) {
 	double now;
-	matoclserventry *eptr;
+	matoclserventry *eptr,*ahead,*again;
 	int ns;
 	static double lastaction = 0.0;
 	double timeoutadd;
@@ -7336,9 +7659,15 @@ void matoclserv_serve(struct pollfd *pdesc) {
 			eptr = malloc(sizeof(matoclserventry));
 			passert(eptr);
 			eptr->next = matoclservhead;
+			if (matoclservhead) {
+				matoclservhead->prev = &(eptr->next);
+			}
+			eptr->prev = &matoclservhead;
 			matoclservhead = eptr;
 			eptr->sock = ns;
-			eptr->pdescpos = -1;
+			eptr->evrevents = 0;
+			eptr->active = 0;
+			eptr->anext = NULL;
 			tcpgetpeer(ns,&(eptr->peerip),NULL);
 			eptr->strip = univallocstrip(eptr->peerip);
 			eptr->registered = NOTREGISTERED;
@@ -7369,43 +7698,78 @@ void matoclserv_serve(struct pollfd *pdesc) {
 			eptr->working_flags = 0;
 
 			eptr->sesdata = NULL;
+			eptr->readerctx = 0;
 			memset(eptr->passwordrnd,0,32);
+
+			eptr->ev = main_ev_register(ns,MAIN_EV_READ,matoclserv_ev,eptr);
+			if (eptr->ev==NULL) {
+				eptr->mode = KILL;
+				matoclserv_activate(eptr);
+			}
 		}
 	}
 
+// only connections that got events (or have something to do) are served
+	matoclservinserve = 1;
+	ahead = matoclservactive;
+	matoclservactive = NULL;
+
 // read
-	for (eptr=matoclservhead ; eptr ; eptr=eptr->next) {
-		if (eptr->pdescpos>=0) {
-			if ((pdesc[eptr->pdescpos].revents & (POLLERR|POLLIN))==POLLIN && eptr->mode!=KILL) {
-				matoclserv_read(eptr,now);
-			}
-			if (pdesc[eptr->pdescpos].revents & (POLLERR|POLLHUP)) {
-				eptr->input_end = 1;
-			}
+	for (eptr=ahead ; eptr ; eptr=eptr->anext) {
+		if ((eptr->evrevents & (MAIN_EV_ERR|MAIN_EV_READ))==MAIN_EV_READ && eptr->mode!=KILL) {
+			matoclserv_read(eptr,now);
+		}
+		if (eptr->evrevents & (MAIN_EV_ERR|MAIN_EV_HUP)) {
+			eptr->input_end = 1;
+		}
+		eptr->evrevents = 0;
+		if (ReaderThreads==0) {
+			matoclserv_parse(eptr);
 		}
-		matoclserv_parse(eptr);
 	}
-
-// write
-	for (eptr=matoclservhead ; eptr ; eptr=eptr->next) {
-		if (eptr->lastwrite+1.0<now && eptr->outputhead==NULL) {
-			uint8_t *ptr = matoclserv_create_packet(eptr,ANTOAN_NOP,4);	// 4 byte length because of 'msgid'
-			*((uint32_t*)ptr) = 0;
+	if (ReaderThreads>0) {
+		if (fs_readers_allowed()) {
+			matoclserv_readers_phase(ahead);
 		}
-		if (eptr->pdescpos>=0) {
-			if ((((pdesc[eptr->pdescpos].events & POLLOUT)==0 && (eptr->outputhead)) || (pdesc[eptr->pdescpos].revents & POLLOUT)) && eptr->mode!=KILL) {
-				matoclserv_write(eptr,now);
-			}
+		for (eptr=ahead ; eptr ; eptr=eptr->anext) {
+			matoclserv_parse(eptr);
 		}
-		if (eptr->lastread+eptr->timeout<now) {
-			eptr->mode = KILL;
+	}
+
+// write
+	again = NULL;
+	while (ahead!=NULL) {
+		eptr = ahead;
+		ahead = eptr->anext;
+		if (ahead==NULL) { // connections that got packets during parsing
+			ahead = matoclservactive;
+			matoclservactive = NULL;
+		}
+		eptr->active = 0;
+		if (eptr->outputhead!=NULL && eptr->mode!=KILL) {
+			matoclserv_write(eptr,now);
 		}
 		if (eptr->mode==FINISH && eptr->outputhead==NULL) {
 			eptr->mode = KILL;
 		}
+		if (eptr->mode==KILL) {
+			matoclserv_kill(eptr);
+			continue;
+		}
+		main_ev_change(eptr->ev,(eptr->input_end?0:MAIN_EV_READ)|(eptr->outputhead!=NULL?MAIN_EV_WRITE:0));
+		if (eptr->mode==DATA && eptr->inputhead!=NULL) { // not everything has been parsed
+			eptr->active = 1;
+			eptr->anext = again;
+			again = eptr;
+		}
 	}
-
-	matoclserv_disconnection_loop();
+	while (again!=NULL) {
+		eptr = again;
+		again = eptr->anext;
+		eptr->anext = matoclservactive;
+		matoclservactive = eptr;
+	}
+	matoclservinserve = 0;
 }
 
 void matoclserv_keep_alive(void) {
@@ -7416,6 +7780,9 @@ void matoclserv_keep_alive(void) {
 	for (eptr=matoclservhead ; eptr ; eptr=eptr->next) {
 		if (eptr->mode == DATA && eptr->input_end==0) {
 			matoclserv_read(eptr,now);
+			if (eptr->inputhead!=NULL) {
+				matoclserv_activate(eptr);
+			}
 		}
 	}
 	for (eptr=matoclservhead ; eptr ; eptr=eptr->next) {
@@ -7448,6 +7815,9 @@ void matoclserv_term(void) {
 
 	eptr = matoclservhead;
 	while (eptr) {
+		if (eptr->ev!=NULL) {
+			main_ev_unregister(eptr->ev);
+		}
 		if (eptr->input_packet) {
 			free(eptr->input_packet);
 		}
@@ -7468,6 +7838,7 @@ void matoclserv_term(void) {
 		free(eaptr);
 	}
 	matoclservhead=NULL;
+	matoclservactive=NULL;
 
 	for (i=0 ; i<CHUNKHASHSIZE ; i++) {
 		for (swc = swchunkshash[i] ; swc ; swc = swcn) {
@@ -7485,6 +7856,7 @@ void matoclserv_term(void) {
 	}
 
 	matoclserv_read(NULL,0.0); // free internal read buffer
+	matoclserv_readers_term();
 	matoclserv_gid_storage(0); // free supplementary groups buffer
 
 	free(ListenHost);
@@ -7508,11 +7880,11 @@ int matoclserv_no_more_pending_jobs(void) {
 }
 
 void matoclserv_disconnect_all(void) {
-	matoclserventry *eptr;
-	for (eptr=matoclservhead ; eptr ; eptr=eptr->next) {
-		eptr->mode = KILL;
+	matoclservactive = NULL;
+	while (matoclservhead) {
+		matoclserv_kill(matoclservhead);
 	}
-	matoclserv_disconnection_loop();
+	matoclservactive = NULL;
 }
 
 void matoclserv_reload_common(void) {
@@ -7541,6 +7913,11 @@ void matoclserv_reload_common(void) {
 	if (ForceTimeout>65535) {
 		ForceTimeout=65535;
 	}
+
+	ReaderThreads = cfg_getuint32("MATOCL_READER_THREADS",0);
+	if (ReaderThreads>READERS_MAX_THREADS) {
+		ReaderThreads = READERS_MAX_THREADS;
+	}
 }
 
 void matoclserv_reload(void) {
@@ -7624,6 +8001,8 @@ int matoclserv_init(void) {
 	master_processid <<= 32;
 	master_processid |= random();
 
+	zassert(pthread_key_create(&readers_key,NULL));
+	readers_pool = lwt_phase_new(matoclserv_readers_work);
 	matoclserv_reload_common();
 
 	if (cfg_isdefined("MATOCL_LISTEN_HOST") || cfg_isdefined("MATOCL_LISTEN_PORT") || !(cfg_isdefined("MATOCU_LISTEN_HOST") || cfg_isdefined("MATOCU_LISTEN_HOST"))) {
@@ -7659,8 +8038,11 @@ int matoclserv_init(void) {
 	mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_INFO,"main master server module: listen on %s:%s",ListenHost,ListenPort);
 
 	matoclservhead = NULL;
+	matoclservactive = NULL;
+	mfs_log(MFSLOG_SYSLOG,MFSLOG_INFO,"main master server module: using %s for client connections",main_ev_backend());
 
 	main_time_register(1,0,matoclserv_timeout_waiting_ops);
+	main_time_register(1,0,matoclserv_check_connections);
 	main_reload_register(matoclserv_reload);
 	main_destruct_register(matoclserv_term);
 	main_poll_register(matoclserv_desc,matoclserv_serve);
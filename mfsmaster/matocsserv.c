@@ -58,6 +58,7 @@
 #include "labelparser.h"
 #include "multilan.h"
 #include "md5.h"
+#include "changelog.h"
 #include "bitops.h"
 #include "mfsalloc.h"
 
@@ -80,6 +81,9 @@
 
 #define SOMETHING_OVER_ANY_LIMIT 10000000
 
+#define REGBATCH_SLICE 1024
+#define REGBATCH_LOOP_TIME 0.005
+
 // ReserveSpaceMode
 enum{RESERVE_BYTES,RESERVE_PERCENT,RESERVE_CHUNKSERVER_USED,RESERVE_CHUNKSERVER_TOTAL};
 
@@ -167,6 +171,10 @@ typedef struct matocsserventry {
 
 	uint8_t passwordrnd[32];
 
+	uint64_t *regchunkids;		// decoded compressed registration packet waiting for processing (chunkids with ecid)
+	uint32_t *regversions;
+	uint32_t regsize,regcount,regpos;
+
 	uint32_t lreplreadok[REPL_REASONS];
 	uint32_t lreplreaderr[REPL_REASONS];
 	uint32_t lreplwriteok[REPL_REASONS];
@@ -2565,16 +2573,71 @@ static uint32_t matocsserv_remap_ip(uint32_t csip) {
 	return csip;
 }
 
+/* compressed registration packets are decoded at once, but chunks are registered in slices from the main loop (see matocsserv_regbatch_loop), ack is sent after the last slice */
+static void matocsserv_regbatch_process(matocsserventry *eptr,uint32_t maxcnt) {
+	uint32_t cnt;
+	uint8_t *p;
+
+	cnt = eptr->regcount - eptr->regpos;
+	if (cnt>maxcnt) {
+		cnt = maxcnt;
+	}
+	chunk_server_has_chunks(eptr->csid,eptr->regchunkids+eptr->regpos,eptr->regversions+eptr->regpos,cnt);
+	eptr->regpos += cnt;
+	if (eptr->regpos>=eptr->regcount) {
+		eptr->regcount = 0;
+		eptr->regpos = 0;
+		p = matocsserv_create_packet(eptr,MATOCS_MASTER_ACK,1);
+		put8bit(&p,0);
+	}
+}
+
+static inline void matocsserv_regbatch_flush(matocsserventry *eptr) {
+	if (eptr->regpos<eptr->regcount) {
+		matocsserv_regbatch_process(eptr,eptr->regcount);
+	}
+}
+
+static void matocsserv_regbatch_free(matocsserventry *eptr) {
+	if (eptr->regchunkids!=NULL) {
+		free(eptr->regchunkids);
+		free(eptr->regversions);
+	}
+	eptr->regchunkids = NULL;
+	eptr->regversions = NULL;
+	eptr->regsize = 0;
+	eptr->regcount = 0;
+	eptr->regpos = 0;
+}
+
+static void matocsserv_regbatch_loop(void) {
+	matocsserventry *eptr;
+	uint8_t work;
+	double st;
+
+	st = monotonic_seconds();
+	do {
+		work = 0;
+		for (eptr=matocsservhead ; eptr ; eptr=eptr->next) {
+			if (eptr->mode!=KILL && eptr->regpos<eptr->regcount) {
+				matocsserv_regbatch_process(eptr,REGBATCH_SLICE);
+				work = 1;
+			}
+		}
+	} while (work && monotonic_seconds()-st<REGBATCH_LOOP_TIME);
+}
+
 void matocsserv_register(matocsserventry *eptr,const uint8_t *data,uint32_t length) {
 	uint64_t chunkid;
 	uint32_t chunkversion;
 	uint32_t i,chunkcount;
+	const uint8_t *endptr;
 	uint8_t rversion;
 	uint8_t ecid;
 	uint16_t csid;
 	double us,ts;
 
-	if ((length&1)==0) {
+	if ((length&1)==0 && (length==0 || eptr->csptr==NULL || data[0]!=64)) { // only compressed chunk list (after BEGIN packet) can have even length
 		mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"CSTOMA_REGISTER: chunkserver is too old");
 		eptr->mode = KILL;
 		return;
@@ -2631,6 +2694,11 @@ void matocsserv_register(matocsserventry *eptr,const uint8_t *data,uint32_t leng
 				eptr->mode = KILL;
 				return;
 			}
+			if (sclass_ec_version()>2 && eptr->version<VERSION2INT(4,60,0)) {
+				mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"CSTOMA_REGISTER: chunkserver is too old - erasure coding with more than one checksum part needs chunkservers at least 4.60.x");
+				eptr->mode = KILL;
+				return;
+			}
 			if (eptr->timeout==0) {
 				eptr->timeout = DefaultTimeout;
 			} else if (eptr->timeout<10) {
@@ -2707,6 +2775,46 @@ void matocsserv_register(matocsserventry *eptr,const uint8_t *data,uint32_t leng
 				put8bit(&p,0);
 			}
 			return;
+		} else if (rversion==64) {
+			if (length<5) {
+				mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"CSTOMA_REGISTER (CHUNKS COMPRESSED) - wrong size (%"PRIu32"/5+)",length);
+				eptr->mode = KILL;
+				return;
+			}
+			if (eptr->csptr==NULL) {
+				mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"CSTOMA_REGISTER (CHUNKS COMPRESSED) - CHUNKS packet before proper BEGIN packet");
+				eptr->mode = KILL;
+				return;
+			}
+			chunkcount = get32bit(&data);
+			if (chunkcount>(length-5)/2) {
+				mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"CSTOMA_REGISTER (CHUNKS COMPRESSED) - wrong size (%"PRIu32"/5+N*2..) ; N: %"PRIu32,length,chunkcount);
+				eptr->mode = KILL;
+				return;
+			}
+			if (chunkcount>eptr->regsize) {
+				matocsserv_regbatch_free(eptr);
+				eptr->regsize = chunkcount;
+				eptr->regchunkids = malloc(sizeof(uint64_t)*chunkcount);
+				passert(eptr->regchunkids);
+				eptr->regversions = malloc(sizeof(uint32_t)*chunkcount);
+				passert(eptr->regversions);
+			}
+			endptr = data+(length-5);
+			if (getchunklist(&data,endptr,eptr->regchunkids,eptr->regversions,chunkcount)<0 || data!=endptr) {
+				mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"CSTOMA_REGISTER (CHUNKS COMPRESSED) - malformed chunk list");
+				eptr->mode = KILL;
+				return;
+			}
+			eptr->newchunkdelay = NEWCHUNKDELAY;
+			eptr->receivingchunks |= TRANSFERRING_NEW_CHUNKS;
+			receivingchunks |= TRANSFERRING_NEW_CHUNKS;
+			eptr->regcount = chunkcount;
+			eptr->regpos = 0;
+			if (chunkcount==0) {
+				matocsserv_regbatch_process(eptr,0);
+			}
+			return;
 		} else if (rversion==62) {
 			if (length!=1) {
 				mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"CSTOMA_REGISTER (END) - wrong size (%"PRIu32"/1)",length);
@@ -2733,7 +2841,7 @@ void matocsserv_register(matocsserventry *eptr,const uint8_t *data,uint32_t leng
 			}
 			eptr->mode = KILL;
 		} else {
-			mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"CSTOMA_REGISTER - register version not supported (%"PRIu8"/60..63)",rversion);
+			mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"CSTOMA_REGISTER - register version not supported (%"PRIu8"/60..64)",rversion);
 			eptr->mode = KILL;
 			return;
 		}
@@ -3044,6 +3152,9 @@ void matocsserv_gotpacket(matocsserventry *eptr,uint32_t type,const uint8_t *dat
 		eptr->mode = KILL;
 		return;
 	}
+	if (type!=ANTOAN_NOP && type!=CSTOMA_SPACE && type!=CSTOMA_CURRENT_LOAD) { // keep order of chunk related packets
+		matocsserv_regbatch_flush(eptr);
+	}
 	switch (type) {
 		case ANTOAN_NOP:
 			break;
@@ -3273,6 +3384,7 @@ void matocsserv_write(matocsserventry *eptr,double now) {
 	uint32_t leng;
 	uint32_t left;
 
+	changelog_flush(); // changes have to be stored before any packet depending on them is sent
 	for (;;) {
 		leng = 0;
 		for (iovdata=0,opack=eptr->outputhead ; iovdata<100 && opack!=NULL ; iovdata++,opack=opack->next) {
@@ -3315,6 +3427,7 @@ void matocsserv_write(matocsserventry *eptr,double now) {
 		}
 	}
 #else
+	changelog_flush(); // changes have to be stored before any packet depending on them is sent
 	for (;;) {
 		opack = eptr->outputhead;
 		if (opack==NULL) {
@@ -3392,6 +3505,7 @@ void matocsserv_disconnection_loop(void) {
 			}
 			csdb_lost_connection(eptr->csptr);
 			tcpclose(eptr->sock);
+			matocsserv_regbatch_free(eptr);
 			if (eptr->input_packet) {
 				free(eptr->input_packet);
 			}
@@ -3509,6 +3623,12 @@ void matocsserv_serve(struct pollfd *pdesc) {
 
 			memset(eptr->passwordrnd,0,32);
 
+			eptr->regchunkids = NULL;
+			eptr->regversions = NULL;
+			eptr->regsize = 0;
+			eptr->regcount = 0;
+			eptr->regpos = 0;
+
 			memset(eptr->lreplreadok,0,sizeof(uint32_t)*REPL_REASONS);
 			memset(eptr->lreplreaderr,0,sizeof(uint32_t)*REPL_REASONS);
 			memset(eptr->lreplwriteok,0,sizeof(uint32_t)*REPL_REASONS);
@@ -3618,6 +3738,7 @@ void matocsserv_term(void) {
 			opptr = opptr->next;
 			free(opaptr);
 		}
+		matocsserv_regbatch_free(eptr);
 		if (eptr->servdesc) {
 			free(eptr->servdesc);
 		}
@@ -3898,6 +4019,7 @@ int matocsserv_init(void) {
 	main_time_register(60,0,matocsserv_reason_counters);
 	main_time_register(10,0,matocsserv_broadcast_timeout);
 	main_eachloop_register(matocsserv_recalculate_server_counters);
+	main_eachloop_register(matocsserv_regbatch_loop);
 //	main_time_register(TIMEMODE_SKIP_LATE,60,0,matocsserv_status);
 	return 0;
 }
@@ -954,6 +954,7 @@ void matomlserv_write(matomlserventry *eptr,double now) {
 	uint32_t leng;
 	uint32_t left;
 
+	changelog_flush(); // changes have to be stored before any packet depending on them is sent
 	for (;;) {
 		leng = 0;
 		for (iovdata=0,opack=eptr->outputhead ; iovdata<100 && opack!=NULL ; iovdata++,opack=opack->next) {
@@ -996,6 +997,7 @@ void matomlserv_write(matomlserventry *eptr,double now) {
 		}
 	}
 #else
+	changelog_flush(); // changes have to be stored before any packet depending on them is sent
 	for (;;) {
 		opack = eptr->outputhead;
 		if (opack==NULL) {
@@ -25,12 +25,14 @@
 #include "mfslog.h"
 #include "sharedpointer.h"
 #include "restore.h"
+#include "chlogbin.h"
 #include "clocks.h"
 
 #define BSIZE 200000
 
 typedef struct _hentry {
 	FILE *fd;
+	chlogbin_reader *bin;
 	void *shfilename;
 	char *buff;
 	size_t bsize;
@@ -88,23 +90,43 @@ void merger_heap_sort_up(void) {
 
 
 void merger_nextentry(uint32_t pos) {
-	if (getline(&(heap[pos].buff),&(heap[pos].bsize),heap[pos].fd)!=-1) {
-		int64_t nextid = strtoll(heap[pos].buff,&(heap[pos].ptr),10);
+	int64_t nextid;
+	uint64_t version;
+	const char *line;
+	int s;
+
+	if (heap[pos].bin!=NULL) {
+		s = chlogbin_reader_next(heap[pos].bin,&version,&line);
+		if (s<=0) {
+			if (s<0) {
+				mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"found damaged block in binary changelog: %s (last correct id: %"PRIu64")\n",(char*)shp_get(heap[pos].shfilename),heap[pos].nextid);
+			}
+			heap[pos].nextid = INT64_C(-1);
+			return;
+		}
+		nextid = version;
+		heap[pos].ptr = (char*)line;
+	} else if (getline(&(heap[pos].buff),&(heap[pos].bsize),heap[pos].fd)!=-1) {
+		nextid = strtoll(heap[pos].buff,&(heap[pos].ptr),10);
 		if (heap[pos].ptr[0]==':' && heap[pos].ptr[1]==' ') {
 			heap[pos].ptr += 2;
 		}
-		if (heap[pos].nextid<0 || (nextid>heap[pos].nextid && nextid<heap[pos].nextid+maxidhole)) {
-			heap[pos].nextid = nextid;
-		} else {
-			mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"found garbage at the end of file: %s (last correct id: %"PRIu64")\n",(char*)shp_get(heap[pos].shfilename),heap[pos].nextid);
-			heap[pos].nextid = INT64_C(-1);
-		}
 	} else {
 		heap[pos].nextid = INT64_C(-1);
+		return;
+	}
+	if (heap[pos].nextid<0 || (nextid>heap[pos].nextid && nextid<heap[pos].nextid+maxidhole)) {
+		heap[pos].nextid = nextid;
+	} else {
+		mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"found garbage at the end of file: %s (last correct id: %"PRIu64")\n",(char*)shp_get(heap[pos].shfilename),heap[pos].nextid);
+		heap[pos].nextid = INT64_C(-1);
 	}
 }
 
 void merger_delete_entry(void) {
+	if (heap[heapsize].bin) {
+		chlogbin_reader_free(heap[heapsize].bin);
+	}
 	if (heap[heapsize].fd) {
 		fclose(heap[heapsize].fd);
 	}
@@ -119,6 +141,13 @@ void merger_delete_entry(void) {
 void merger_new_entry(const char *filename) {
 	// printf("add file: %s\n",filename);
 	if ((heap[heapsize].fd = fopen(filename,"r"))!=NULL) {
+		char magic[CHLOGBIN_MAGIC_SIZE];
+		if (fread(magic,1,CHLOGBIN_MAGIC_SIZE,heap[heapsize].fd)==CHLOGBIN_MAGIC_SIZE && memcmp(magic,CHLOGBIN_MAGIC,CHLOGBIN_MAGIC_SIZE)==0) {
+			heap[heapsize].bin = chlogbin_reader_new(heap[heapsize].fd);
+		} else {
+			heap[heapsize].bin = NULL;
+			rewind(heap[heapsize].fd);
+		}
 		heap[heapsize].shfilename = shp_new(strdup(filename),free);
 		heap[heapsize].buff = malloc(BSIZE);
 		heap[heapsize].bsize = BSIZE;
@@ -127,6 +156,7 @@ void merger_new_entry(const char *filename) {
 		merger_nextentry(heapsize);
 	} else {
 		mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"can't open changelog file: %s\n",filename);
+		heap[heapsize].bin = NULL;
 		heap[heapsize].shfilename = NULL;
 		heap[heapsize].buff = NULL;
 		heap[heapsize].bsize = 0;
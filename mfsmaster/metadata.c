@@ -42,6 +42,9 @@
 #include "MFSCommunication.h"
 
 #include "bio.h"
+#include "bgsaver.h"
+#include "loadpipe.h"
+#include "metaindex.h"
 #include "sessions.h"
 #include "dictionary.h"
 #include "xattr.h"
@@ -161,49 +164,144 @@ static void meta_chlog_keep_free(void) {
 	}
 }
 
-int meta_store_chunk(bio *fd,uint8_t (*storefn)(bio *),const char chunkname[4]) {
-	uint8_t hdr[16];
-	uint8_t *ptr;
-	uint8_t mver;
-	uint64_t offbegin=0,offend;
+static metaindex_section *storeindex = NULL;
+static uint32_t storeindexcnt = 0;
+static uint32_t storeindexsize = 0;
 
-	if (storefn==NULL) {
-		memcpy(hdr,"[MFS EOF MARKER]",16);
-	} else {
-		memcpy(hdr,chunkname,4);
-		mver = storefn(NULL);
-		hdr[4] = ' ';
-		hdr[5] = '0'+((mver>>4)&0xF);
-		hdr[6] = '.';
-		hdr[7] = '0'+(mver&0xF);
-		offbegin = bio_file_position(fd);
-		memset(hdr+8,0xFF,8);
+static void meta_index_clear(void) {
+	uint32_t i;
+	for (i=0 ; i<storeindexcnt ; i++) {
+		free(storeindex[i].segs);
+	}
+	storeindexcnt = 0;
+}
+
+static void meta_index_add(const uint8_t hdr[8],uint64_t offset,const bio_segment *segs,uint32_t segcnt,uint64_t records) {
+	metaindex_section *ms;
+	uint32_t i;
+
+	if (storeindexcnt>=storeindexsize) {
+		storeindexsize = (storeindexsize==0)?32:(storeindexsize*2);
+		storeindex = realloc(storeindex,sizeof(metaindex_section)*storeindexsize);
+		passert(storeindex);
+	}
+	ms = storeindex+storeindexcnt;
+	memcpy(ms->hdr,hdr,8);
+	ms->offset = offset;
+	ms->length = 0;
+	ms->records = records;
+	ms->segcnt = segcnt;
+	ms->segs = malloc(sizeof(metaindex_segment)*(segcnt+1));
+	passert(ms->segs);
+	for (i=0 ; i<segcnt ; i++) {
+		ms->segs[i].offset = segs[i].offset;
+		ms->segs[i].length = segs[i].length;
+		ms->segs[i].records = segs[i].records;
+		ms->segs[i].crc = segs[i].crc;
+		ms->length += segs[i].length;
+	}
+	storeindexcnt++;
+}
+
+// trailing index - see metaindex.h
+static int meta_store_index(bio *fd) {
+	uint8_t *buff,*ptr;
+	uint64_t ioffset,ileng;
+	uint32_t i,j;
+	int ret;
+
+	ileng = 4+4+8;
+	for (i=0 ; i<storeindexcnt ; i++) {
+		ileng += 8+8+8+8+4+(uint64_t)(storeindex[i].segcnt)*(8+4+4+4);
+	}
+	ioffset = bio_file_position(fd);
+	buff = malloc(16+ileng);
+	passert(buff);
+	ptr = buff;
+	memcpy(ptr,"INDX 1.0",8);
+	ptr += 8;
+	put64bit(&ptr,ileng);
+	put32bit(&ptr,METAINDEX_SEGMENT_SIZE);
+	put32bit(&ptr,storeindexcnt);
+	for (i=0 ; i<storeindexcnt ; i++) {
+		memcpy(ptr,storeindex[i].hdr,8);
+		ptr += 8;
+		put64bit(&ptr,storeindex[i].offset);
+		put64bit(&ptr,storeindex[i].length);
+		put64bit(&ptr,storeindex[i].records);
+		put32bit(&ptr,storeindex[i].segcnt);
+		for (j=0 ; j<storeindex[i].segcnt ; j++) {
+			put64bit(&ptr,storeindex[i].segs[j].offset);
+			put32bit(&ptr,storeindex[i].segs[j].length);
+			put32bit(&ptr,storeindex[i].segs[j].records);
+			put32bit(&ptr,storeindex[i].segs[j].crc);
+		}
 	}
+	put64bit(&ptr,ioffset);
+	ret = (bio_write(fd,buff,16+ileng)!=(int64_t)(16+ileng))?-1:0;
+	free(buff);
+	meta_index_clear();
+	return ret;
+}
+
+// section header with unknown length - length is written by meta_store_section_end
+static int meta_store_section_begin(bio *fd,uint8_t mver,const char chunkname[4],uint8_t hdr[16],uint64_t *offbegin) {
+	memcpy(hdr,chunkname,4);
+	hdr[4] = ' ';
+	hdr[5] = '0'+((mver>>4)&0xF);
+	hdr[6] = '.';
+	hdr[7] = '0'+(mver&0xF);
+	*offbegin = bio_file_position(fd);
+	memset(hdr+8,0xFF,8);
 	if (bio_write(fd,hdr,16)!=(size_t)16) {
 		return -1;
 	}
+	bio_segments_begin(fd,METAINDEX_SEGMENT_SIZE);
+	return 0;
+}
 
-	if (storefn) {
-		storefn(fd);
-		if (bio_error(fd)) {
-			mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"error writing section '%c%c%c%c'",chunkname[0],chunkname[1],chunkname[2],chunkname[3]);
-		}
-
-		if (offbegin!=0) {
-			offend = bio_file_position(fd);
-			ptr = hdr+8;
-			put64bit(&ptr,offend-offbegin-16);
-			bio_seek(fd,offbegin+8,SEEK_SET);
-			if (bio_write(fd,hdr+8,8)!=(size_t)8) {
-				mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"error updating size of section '%c%c%c%c'",chunkname[0],chunkname[1],chunkname[2],chunkname[3]);
-				return -1;
-			}
-			bio_seek(fd,offend,SEEK_SET);
+static int meta_store_section_end(bio *fd,uint8_t hdr[16],uint64_t offbegin) {
+	uint8_t *ptr;
+	uint64_t offend;
+	bio_segment *segs;
+	uint32_t segcnt;
+	uint64_t records;
+
+	segcnt = bio_segments_end(fd,&segs,&records);
+	meta_index_add(hdr,offbegin,segs,segcnt,records);
+	if (bio_error(fd)) {
+		mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"error writing section '%c%c%c%c'",hdr[0],hdr[1],hdr[2],hdr[3]);
+	}
+
+	if (offbegin!=0) {
+		offend = bio_file_position(fd);
+		ptr = hdr+8;
+		put64bit(&ptr,offend-offbegin-16);
+		bio_seek(fd,offbegin+8,SEEK_SET);
+		if (bio_write(fd,hdr+8,8)!=(size_t)8) {
+			mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"error updating size of section '%c%c%c%c'",hdr[0],hdr[1],hdr[2],hdr[3]);
+			return -1;
 		}
+		bio_seek(fd,offend,SEEK_SET);
 	}
 	return 0;
 }
 
+int meta_store_chunk(bio *fd,uint8_t (*storefn)(bio *),const char chunkname[4]) {
+	uint8_t hdr[16];
+	uint64_t offbegin;
+
+	if (storefn==NULL) {
+		memcpy(hdr,"[MFS EOF MARKER]",16);
+		return (bio_write(fd,hdr,16)!=(size_t)16)?-1:0;
+	}
+	if (meta_store_section_begin(fd,storefn(NULL),chunkname,hdr,&offbegin)<0) {
+		return -1;
+	}
+	storefn(fd);
+	return meta_store_section_end(fd,hdr,offbegin);
+}
+
 void meta_store(bio *fd,const char *crcfname) {
 	bio *crcfd;
 	uint8_t hdr[16];
@@ -222,6 +320,7 @@ void meta_store(bio *fd,const char *crcfname) {
 	} else {
 		crcfd = NULL;
 	}
+	meta_index_clear();
 
 	ptr = hdr;
 	put64bit(&ptr,metaversion);
@@ -290,6 +389,10 @@ void meta_store(bio *fd,const char *crcfname) {
 		return;
 	}
 	STORE_CRC("CHNK")
+	if (meta_store_index(fd)<0) {
+		return;
+	}
+	bio_crc(fd); // index contains file offsets (zeros in crc only mode), so it is not part of crc data
 	if (meta_store_chunk(fd,NULL,NULL)<0) {
 		return;
 	}
@@ -378,6 +481,96 @@ uint8_t meta_check_metadatafile(const char *name,uint64_t *ver,uint64_t *id) {
 	return META_CHECK_OK;
 }
 
+// index of loaded file - segments are checked while data is read (by bio or by loadpipe workers)
+static metaindex *loadindex = NULL;
+static bio_segment *loadsegs = NULL;
+static uint32_t loadsegcnt = 0;
+
+static int meta_loadseg_cmp(const void *a,const void *b) {
+	const bio_segment *aa = (const bio_segment*)a;
+	const bio_segment *bb = (const bio_segment*)b;
+	return (aa->offset<bb->offset)?-1:(aa->offset>bb->offset)?1:0;
+}
+
+static void meta_loadindex_free(void) {
+	loadpipe_set_section(NULL,0);
+	if (loadindex!=NULL) {
+		metaindex_free(loadindex);
+		loadindex = NULL;
+	}
+	if (loadsegs!=NULL) {
+		free(loadsegs);
+		loadsegs = NULL;
+	}
+	loadsegcnt = 0;
+}
+
+// loads index (has to be called before first read) ; segments of each section have to cover whole section
+static void meta_loadindex_init(bio *fd) {
+	const metaindex_section *ms;
+	uint64_t pos;
+	uint32_t i,j,k;
+
+	loadindex = metaindex_load(bio_descriptor(fd));
+	if (loadindex==NULL) {
+		return;
+	}
+	loadsegcnt = 0;
+	for (i=0 ; i<loadindex->seccnt ; i++) {
+		ms = loadindex->secs+i;
+		pos = ms->offset+16;
+		for (j=0 ; j<ms->segcnt ; j++) {
+			if (ms->segs[j].offset!=pos) {
+				break;
+			}
+			pos += ms->segs[j].length;
+		}
+		if (j<ms->segcnt || pos!=ms->offset+16+ms->length) {
+			meta_loadindex_free();
+			return;
+		}
+		loadsegcnt += ms->segcnt;
+	}
+	loadsegs = malloc(sizeof(bio_segment)*(loadsegcnt+1));
+	passert(loadsegs);
+	k = 0;
+	for (i=0 ; i<loadindex->seccnt ; i++) {
+		ms = loadindex->secs+i;
+		for (j=0 ; j<ms->segcnt ; j++) {
+			loadsegs[k].offset = ms->segs[j].offset;
+			loadsegs[k].length = ms->segs[j].length;
+			loadsegs[k].records = ms->segs[j].records;
+			loadsegs[k].crc = ms->segs[j].crc;
+			k++;
+		}
+	}
+	qsort(loadsegs,loadsegcnt,sizeof(bio_segment),meta_loadseg_cmp);
+	for (k=1 ; k<loadsegcnt ; k++) {
+		if (loadsegs[k].offset<loadsegs[k-1].offset+loadsegs[k-1].length) { // overlapping sections
+			meta_loadindex_free();
+			return;
+		}
+	}
+	bio_check_segments(fd,loadsegs,loadsegcnt,ignoreflag?1:0);
+}
+
+// index entry of section which header has been just read
+static const metaindex_section* meta_loadindex_section(bio *fd,const uint8_t hdr[8]) {
+	uint64_t offset;
+	uint32_t i;
+
+	if (loadindex==NULL) {
+		return NULL;
+	}
+	offset = bio_file_position(fd)-16;
+	for (i=0 ; i<loadindex->seccnt ; i++) {
+		if (loadindex->secs[i].offset==offset && memcmp(loadindex->secs[i].hdr,hdr,8)==0) {
+			return loadindex->secs+i;
+		}
+	}
+	return NULL;
+}
+
 int meta_load(bio *fd,uint8_t fver,uint8_t *afterload) {
 	uint8_t hdr[16];
 	const uint8_t *ptr;
@@ -457,6 +650,7 @@ int meta_load(bio *fd,uint8_t fver,uint8_t *afterload) {
 			if (sleng<UINT64_C(0xFFFFFFFFFFFFFFFF)) {
 				offbegin = bio_file_position(fd);
 			}
+			loadpipe_set_section(meta_loadindex_section(fd,hdr),ignoreflag?1:0);
 			profdata = monotonic_seconds();
 			mver = (((hdr[5]-'0')&0xF)<<4)+((hdr[7]-'0')&0xF);
 			if (memcmp(hdr,"NODE",4)==0) {
@@ -638,6 +832,9 @@ int meta_load(bio *fd,uint8_t fver,uint8_t *afterload) {
 					return -1;
 				}
 				*afterload = chunk_is_afterload_needed(mver);
+			} else if (memcmp(hdr,"INDX",4)==0) { // already loaded by meta_loadindex_init
+				bio_skip(fd,sleng);
+				continue;
 			} else {
 				hdr[8]=0;
 				if (ignoreflag) {
@@ -671,7 +868,7 @@ int meta_file_storeall(const char *fname) {
 	if (fd==NULL) {
 		return -1;
 	}
-	if (bio_write(fd,MFSSIGNATURE "M 2.0",8)!=(size_t)8) {
+	if (bio_write(fd,MFSSIGNATURE "M 2.1",8)!=(size_t)8) {
 		mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"error writing metadata signature in emergency mode, file name: %s",fname);
 	} else {
 		meta_store(fd,NULL);
@@ -840,6 +1037,377 @@ void meta_storeended(pid_t pid,int status) {
 	metasaverkilled = 0;
 }
 
+static void meta_rotate_backups(void) {
+	char metaname1[100],metaname2[100];
+	int n;
+
+	if (BackMetaCopies>0) {
+		for (n=BackMetaCopies-1 ; n>0 ; n--) {
+			snprintf(metaname1,100,"metadata.mfs.back.%"PRIu32,n+1);
+			snprintf(metaname2,100,"metadata.mfs.back.%"PRIu32,n);
+			rename(metaname2,metaname1);
+		}
+		rename("metadata.mfs.back","metadata.mfs.back.1");
+	}
+}
+
+/* incremental store (METADATA_SAVE_MODE = 1)
+ *
+ * Metadata are stored without fork. Small sections and sections that follow EDGE are serialized into memory when
+ * store begins, nodes, edges and chunks are stored in small steps from the main loop. Objects changed during store
+ * are written before they are changed (see fs_incstore_begin and chunk_incstore_begin), so the file describes
+ * metadata exactly as they were when store began (changes made later are in changelogs). Data are written by
+ * the background data writer (bgsaver), crc file is the same as the one written by the forked store process.
+ */
+
+#define INCSTORE_FNAME "metadata_store.tmp"
+#define INCSTORE_WRITE_SIZE 0x100000
+#define INCSTORE_MAX_PENDING 8
+#define INCSTORE_STEPS 10000
+#define INCSTORE_SLICE 0.01
+#define INCSTORE_TAIL_BASE 1 // tail sections are stored at non zero offset, so meta_store_chunk writes their lengths
+
+#define INCSTORE_IDLE 0
+#define INCSTORE_NODES 1
+#define INCSTORE_EDGES 2
+#define INCSTORE_CHUNKS 3
+#define INCSTORE_CLOSING 4
+
+typedef struct _meta_membuff {
+	uint8_t *data;
+	uint64_t base;
+	uint64_t leng;
+	uint64_t size;
+} meta_membuff;
+
+static const struct {
+	uint8_t (*storefn)(bio *);
+	const char name[5];
+} meta_tailsections[] = {
+	{fs_storefree,"FREE"},
+	{fs_storequota,"QUOT"},
+	{xattr_store,"XATR"},
+	{posix_acl_store,"PACL"},
+	{of_store,"OPEN"},
+	{flock_store,"FLCK"},
+	{posix_lock_store,"PLCK"},
+	{csdb_store,"CSDB"}
+};
+
+#define INCSTORE_TAIL_SECTIONS (sizeof(meta_tailsections)/sizeof(meta_tailsections[0]))
+
+static uint8_t MetaSaveMode;
+static uint8_t incstore_state = INCSTORE_IDLE;
+static uint8_t incstore_error;
+static uint8_t incstore_broken;
+static uint8_t incstore_lastfailed = 0;
+static uint32_t incstore_pending;
+static bio *incstore_fd; // file stream (bgsaver)
+static bio *incstore_tailfd;
+static bio *incstore_spoolfd; // chunks changed before CHNK section
+static meta_membuff incstore_tail;
+static meta_membuff incstore_spool;
+static uint32_t incstore_tailidx;
+static uint32_t incstore_tailcrc[INCSTORE_TAIL_SECTIONS];
+static uint32_t incstore_chunkcrc;
+static uint8_t incstore_hdr[16];
+static uint64_t incstore_offbegin;
+static uint8_t incstore_crcbuff[16+8*(8+INCSTORE_TAIL_SECTIONS)];
+static uint8_t *incstore_crcptr;
+
+int meta_storeall(int bg,uint8_t dontstore);
+
+static int32_t meta_membuff_write(void *ud,const uint8_t *data,uint32_t leng,uint64_t offset) {
+	meta_membuff *mb = (meta_membuff*)ud;
+	uint64_t end;
+
+	offset -= mb->base;
+	end = offset+leng;
+	if (end>mb->size) {
+		mb->size = end + (end/2) + 0x10000;
+		mb->data = realloc(mb->data,mb->size);
+		passert(mb->data);
+	}
+	memcpy(mb->data+offset,data,leng);
+	if (end>mb->leng) {
+		mb->leng = end;
+	}
+	return leng;
+}
+
+static bio* meta_membuff_open(meta_membuff *mb,uint64_t base) {
+	bio *fd;
+
+	mb->data = NULL;
+	mb->base = base;
+	mb->leng = 0;
+	mb->size = 0;
+	fd = bio_func_open(INCSTORE_WRITE_SIZE,meta_membuff_write,mb);
+	if (base>0) {
+		bio_seek(fd,base,SEEK_SET);
+	}
+	return fd;
+}
+
+static void meta_membuff_close(bio *fd,meta_membuff *mb) {
+	if (fd!=NULL) {
+		bio_close(fd);
+	}
+	free(mb->data);
+	mb->data = NULL;
+	mb->leng = 0;
+	mb->size = 0;
+}
+
+static void meta_incstore_done(void *ud,int status) {
+	(void)ud;
+	if (incstore_pending>0) {
+		incstore_pending--;
+	}
+	if (status!=1) {
+		incstore_error = 1;
+		if (status<0) { // no connection with bgsaver - remaining requests won't be confirmed
+			incstore_broken = 1;
+		}
+	}
+}
+
+static int32_t meta_incstore_write(void *ud,const uint8_t *data,uint32_t leng,uint64_t offset) {
+	uint32_t pos,l;
+
+	(void)ud;
+	for (pos=0 ; pos<leng ; pos+=l) {
+		l = leng-pos;
+		if (l>INCSTORE_WRITE_SIZE) {
+			l = INCSTORE_WRITE_SIZE;
+		}
+		incstore_pending++;
+		bgsaver_store(data+pos,offset+pos,l,mycrc32(0,data+pos,l),NULL,meta_incstore_done);
+	}
+	return leng;
+}
+
+static void meta_incstore_crc(const char section[4],uint32_t crc) {
+	memcpy(incstore_crcptr,section,4);
+	incstore_crcptr += 4;
+	put32bit(&incstore_crcptr,crc);
+}
+
+static int meta_index_cmp(const void *a,const void *b) {
+	const metaindex_section *aa = (const metaindex_section*)a;
+	const metaindex_section *bb = (const metaindex_section*)b;
+	return (aa->offset<bb->offset)?-1:(aa->offset>bb->offset)?1:0;
+}
+
+// tail sections have been serialized at the beginning of store - copy them to the file and move their index entries
+static void meta_incstore_tail(void) {
+	metaindex_section *ms;
+	uint64_t delta;
+	uint32_t i,j;
+
+	bio_sync(incstore_tailfd);
+	delta = bio_file_position(incstore_fd) - INCSTORE_TAIL_BASE;
+	for (i=0 ; i<INCSTORE_TAIL_SECTIONS ; i++) {
+		ms = storeindex + incstore_tailidx + i;
+		ms->offset += delta;
+		for (j=0 ; j<ms->segcnt ; j++) {
+			ms->segs[j].offset += delta;
+		}
+		meta_incstore_crc(meta_tailsections[i].name,incstore_tailcrc[i]);
+	}
+	bio_write(incstore_fd,incstore_tail.data,incstore_tail.leng);
+	bio_crc(incstore_fd); // crc of these sections is already known
+	meta_membuff_close(incstore_tailfd,&incstore_tail);
+	incstore_tailfd = NULL;
+}
+
+// CHNK section begins with chunks changed during store of previous sections (spooled in memory together with segment data)
+static void meta_incstore_chunks_begin(void) {
+	bio_segment *segs;
+	uint32_t i,segcnt,spoolcrc;
+	uint64_t records;
+
+	meta_store_section_begin(incstore_fd,chunk_store(NULL),"CHNK",incstore_hdr,&incstore_offbegin);
+	chunk_incstore_header(incstore_fd);
+	incstore_chunkcrc = bio_crc(incstore_fd);
+	bio_sync(incstore_spoolfd);
+	spoolcrc = bio_crc(incstore_spoolfd);
+	segcnt = bio_segments_end(incstore_spoolfd,&segs,&records);
+	for (i=0 ; i<segcnt ; i++) {
+		bio_write(incstore_fd,incstore_spool.data+segs[i].offset,segs[i].length);
+		bio_records_end(incstore_fd,segs[i].records);
+	}
+	bio_crc(incstore_fd); // records have been written to spool separately, so use crc of spool
+	incstore_chunkcrc ^= spoolcrc;
+	meta_membuff_close(incstore_spoolfd,&incstore_spool);
+	incstore_spoolfd = NULL;
+}
+
+static void meta_incstore_chunks_end(void) {
+	meta_store_section_end(incstore_fd,incstore_hdr,incstore_offbegin);
+	meta_incstore_crc("CHNK",incstore_chunkcrc ^ bio_crc(incstore_fd));
+	qsort(storeindex,storeindexcnt,sizeof(metaindex_section),meta_index_cmp);
+	meta_store_index(incstore_fd);
+	bio_crc(incstore_fd);
+	meta_store_chunk(incstore_fd,NULL,NULL);
+	meta_incstore_crc("TAIL",bio_crc(incstore_fd));
+	bio_sync(incstore_fd);
+	incstore_pending++;
+	bgsaver_close(NULL,meta_incstore_done);
+	incstore_state = INCSTORE_CLOSING;
+}
+
+static void meta_incstore_release(void) {
+	fs_incstore_cancel();
+	chunk_incstore_cancel();
+	if (incstore_fd!=NULL) {
+		bio_close(incstore_fd);
+		incstore_fd = NULL;
+	}
+	meta_membuff_close(incstore_tailfd,&incstore_tail);
+	incstore_tailfd = NULL;
+	meta_membuff_close(incstore_spoolfd,&incstore_spool);
+	incstore_spoolfd = NULL;
+	meta_index_clear();
+	incstore_state = INCSTORE_IDLE;
+}
+
+static void meta_incstore_finish(void) {
+	bio *crcfd;
+
+	meta_incstore_release();
+	if (incstore_error==0) {
+		meta_rotate_backups();
+		if (rename(INCSTORE_FNAME,"metadata.mfs.back")<0) {
+			mfs_log(MFSLOG_ERRNO_SYSLOG,MFSLOG_ERR,"can't rename "INCSTORE_FNAME" -> metadata.mfs.back");
+			incstore_error = 1;
+		}
+	}
+	if (incstore_error) {
+		unlink(INCSTORE_FNAME);
+		storestarttime = 0.0;
+		incstore_lastfailed = 1;
+		mfs_log(MFSLOG_SYSLOG,MFSLOG_ERR,"incremental metadata store failed - store metadata using forked process");
+		if (meta_storeall(1,0)<=0) {
+			mfs_log(MFSLOG_SYSLOG,MFSLOG_ERR,"can't store metadata - exiting");
+			main_exit();
+		}
+		return;
+	}
+	unlink("metadata.mfs");
+	crcfd = bio_file_open("metadata.crc",BIO_WRITE,1024);
+	if (crcfd!=NULL) {
+		bio_write(crcfd,incstore_crcbuff,incstore_crcptr-incstore_crcbuff);
+		bio_close(crcfd);
+	}
+	laststoretime = monotonic_seconds()-storestarttime;
+	storestarttime = 0.0;
+	mfs_log(MFSLOG_SYSLOG,MFSLOG_INFO,"incremental store has finished - store time: %.3lf seconds",laststoretime);
+	laststorestatus = LASTSTORE_META_STORED_BG;
+	lastsuccessfulstore = main_time();
+	meta_process_crcdata();
+}
+
+static void meta_incstore_loop(void) {
+	double deadline;
+
+	if (incstore_state==INCSTORE_IDLE) {
+		return;
+	}
+	if (incstore_state==INCSTORE_CLOSING) {
+		if (incstore_pending==0 || incstore_broken) {
+			meta_incstore_finish();
+		}
+		return;
+	}
+	if (incstore_error) { // do not wait for the end - close file and let finish function clean everything
+		fs_incstore_cancel();
+		chunk_incstore_cancel();
+		incstore_pending++;
+		bgsaver_close(NULL,meta_incstore_done);
+		incstore_state = INCSTORE_CLOSING;
+		return;
+	}
+	deadline = monotonic_seconds()+INCSTORE_SLICE;
+	while (incstore_pending<INCSTORE_MAX_PENDING && incstore_state!=INCSTORE_CLOSING && monotonic_seconds()<deadline) {
+		switch (incstore_state) {
+			case INCSTORE_NODES:
+				if (fs_incstore_nodes(INCSTORE_STEPS)) {
+					meta_store_section_end(incstore_fd,incstore_hdr,incstore_offbegin);
+					meta_incstore_crc("NODE",bio_crc(incstore_fd));
+					meta_store_section_begin(incstore_fd,fs_storeedges(NULL),"EDGE",incstore_hdr,&incstore_offbegin);
+					fs_incstore_edges_begin();
+					incstore_state = INCSTORE_EDGES;
+				}
+				break;
+			case INCSTORE_EDGES:
+				if (fs_incstore_edges(INCSTORE_STEPS)) {
+					meta_store_section_end(incstore_fd,incstore_hdr,incstore_offbegin);
+					meta_incstore_crc("EDGE",bio_crc(incstore_fd));
+					meta_incstore_tail();
+					meta_incstore_chunks_begin();
+					incstore_state = INCSTORE_CHUNKS;
+				}
+				break;
+			case INCSTORE_CHUNKS:
+				if (chunk_incstore_step(INCSTORE_STEPS)) {
+					meta_incstore_chunks_end();
+				}
+				break;
+		}
+	}
+}
+
+// everything except nodes, edges and chunks is stored here, so all sections describe the same moment
+static int meta_incstore_start(void) {
+	uint32_t i;
+
+	if (fs_incstore_begin()<0) {
+		mfs_log(MFSLOG_SYSLOG,MFSLOG_NOTICE,"incremental metadata store can't be done now (edge ids have to be renumerated) - store metadata using forked process");
+		return -1;
+	}
+	incstore_error = 0;
+	incstore_broken = 0;
+	incstore_pending = 1;
+	bgsaver_open(INCSTORE_FNAME,0,NULL,meta_incstore_done);
+	if (incstore_broken) {
+		mfs_log(MFSLOG_SYSLOG,MFSLOG_WARNING,"incremental metadata store can't be done (no connection with background data writer) - store metadata using forked process");
+		fs_incstore_cancel();
+		return -1;
+	}
+	incstore_fd = bio_func_open(INCSTORE_WRITE_SIZE,meta_incstore_write,NULL);
+	incstore_tailfd = meta_membuff_open(&incstore_tail,INCSTORE_TAIL_BASE);
+	incstore_spoolfd = meta_membuff_open(&incstore_spool,0);
+	meta_index_clear();
+
+	incstore_crcptr = incstore_crcbuff;
+	put64bit(&incstore_crcptr,metaversion);
+	put64bit(&incstore_crcptr,metaid);
+	bio_write(incstore_fd,MFSSIGNATURE "M 2.1",8);
+	bio_write(incstore_fd,incstore_crcbuff,16);
+	meta_incstore_crc("HEAD",bio_crc(incstore_fd));
+	meta_store_chunk(incstore_fd,sessions_store,"SESS");
+	meta_incstore_crc("SESS",bio_crc(incstore_fd));
+	meta_store_chunk(incstore_fd,sclass_store,"SCLA");
+	meta_incstore_crc("SCLA",bio_crc(incstore_fd));
+	meta_store_chunk(incstore_fd,patterns_store,"PATT");
+	meta_incstore_crc("PATT",bio_crc(incstore_fd));
+
+	incstore_tailidx = storeindexcnt;
+	for (i=0 ; i<INCSTORE_TAIL_SECTIONS ; i++) {
+		meta_store_chunk(incstore_tailfd,meta_tailsections[i].storefn,meta_tailsections[i].name);
+		incstore_tailcrc[i] = bio_crc(incstore_tailfd);
+	}
+
+	bio_segments_begin(incstore_spoolfd,METAINDEX_SEGMENT_SIZE);
+	chunk_incstore_begin(incstore_spoolfd);
+	meta_store_section_begin(incstore_fd,fs_storenodes(NULL),"NODE",incstore_hdr,&incstore_offbegin);
+	fs_incstore_nodes_header(incstore_fd);
+	incstore_state = INCSTORE_NODES;
+	storestarttime = monotonic_seconds();
+	return 0;
+}
+
 int meta_storeall(int bg,uint8_t dontstore) {
 	bio *fd;
 	int i,estat;
@@ -854,6 +1422,10 @@ int meta_storeall(int bg,uint8_t dontstore) {
 		mfs_log(MFSLOG_SYSLOG,MFSLOG_ERR,"previous metadata save process hasn't finished yet - do not start another one");
 		return -1;
 	}
+	if (incstore_state!=INCSTORE_IDLE) {
+		mfs_log(MFSLOG_SYSLOG,MFSLOG_ERR,"previous incremental metadata store hasn't finished yet - do not start another one");
+		return -1;
+	}
 //	if (stat("metadata.mfs.back.tmp",&sb)==0) {
 //		mfs_log(MFSLOG_SYSLOG,MFSLOG_ERR,"previous metadata save process hasn't finished yet - do not start another one");
 //		return -1;
@@ -873,6 +1445,13 @@ int meta_storeall(int bg,uint8_t dontstore) {
 			close(mfd);
 		}
 	}
+	if (bg && dontstore==0 && MetaSaveMode==1) {
+		if (incstore_lastfailed) { // previous incremental store failed - this time use fork
+			incstore_lastfailed = 0;
+		} else if (meta_incstore_start()==0) {
+			return 1;
+		}
+	}
 	if (bg) {
 		if (pipe(pfd)<0) {
 			pfd[0]=-1;
@@ -948,7 +1527,7 @@ int meta_storeall(int bg,uint8_t dontstore) {
 				}
 			}
 		}
-		if (bio_write(fd,MFSSIGNATURE "M 2.0",8)!=(size_t)8) {
+		if (bio_write(fd,MFSSIGNATURE "M 2.1",8)!=(size_t)8) {
 			mfs_log(MFSLOG_SYSLOG,MFSLOG_NOTICE,"error writing metadata signature");
 		} else {
 			meta_store(fd,"metadata.crc");
@@ -976,16 +1555,7 @@ int meta_storeall(int bg,uint8_t dontstore) {
 		} else {
 			bio_close(fd);
 			if (dontstore==0) {
-				if (BackMetaCopies>0) {
-					char metaname1[100],metaname2[100];
-					int n;
-					for (n=BackMetaCopies-1 ; n>0 ; n--) {
-						snprintf(metaname1,100,"metadata.mfs.back.%"PRIu32,n+1);
-						snprintf(metaname2,100,"metadata.mfs.back.%"PRIu32,n);
-						rename(metaname2,metaname1);
-					}
-					rename("metadata.mfs.back","metadata.mfs.back.1");
-				}
+				meta_rotate_backups();
 				rename("metadata.mfs.back.tmp","metadata.mfs.back");
 				unlink("metadata.mfs");
 			}
@@ -1065,7 +1635,7 @@ void meta_store_task(void) {
 		changelog_rotate(ROTATE_FLAG_BROADCAST);
 	}
 	if ((htime % MetaSaveFreq) == 0) {
-		if (metasaverpid>=0 && last_store_htime + STORE_TIMEOUT > rhtime) { // previous save still in progress - silently ignore this request
+		if ((metasaverpid>=0 || incstore_state!=INCSTORE_IDLE) && last_store_htime + STORE_TIMEOUT > rhtime) { // previous save still in progress - silently ignore this request
 			return;
 		}
 		last_store_htime = rhtime;
@@ -1139,6 +1709,13 @@ void meta_cleanup(void) {
 }
 
 int meta_mayexit(void) {
+	if (incstore_state!=INCSTORE_IDLE) {
+		mfs_log(MFSLOG_SYSLOG,MFSLOG_NOTICE,"incremental metadata store has been cancelled due to termination");
+		bgsaver_cancel();
+		meta_incstore_release();
+		unlink(INCSTORE_FNAME);
+		storestarttime = 0.0;
+	}
 	if (metasaverpid>0) {
 		if (metasaverkilled==0) {
 			if (kill(metasaverpid,SIGKILL)<0) {
@@ -1174,6 +1751,11 @@ void meta_term(void) {
 	}
 }
 
+static void meta_loadfile_close(bio *fd) {
+	bio_close(fd);
+	meta_loadindex_free();
+}
+
 int meta_loadfile(const char *filename) {
 	bio *fd;
 	uint8_t fver;
@@ -1181,24 +1763,26 @@ int meta_loadfile(const char *filename) {
 	uint8_t hdr[8];
 
 	al = 0;
+	loadpipe_set_workers(cfg_getuint32("METADATA_LOAD_THREADS",4));
 
 	fd = bio_file_open(filename,BIO_READ,META_FILE_BUFFER_SIZE);
 	if (fd==NULL) {
 		mfs_log(MFSLOG_ERRNO_SYSLOG_STDERR,MFSLOG_WARNING,"error opening metadata");
 		return -1;
 	}
+	meta_loadindex_init(fd);
 
 	if (bio_read(fd,hdr,8)!=8) {
 		if (bio_error(fd)) {
 			errno=bio_lasterrno(fd);
 			mfs_log(MFSLOG_ERRNO_SYSLOG_STDERR,MFSLOG_WARNING,"error reading metadata");
 		}
-		bio_close(fd);
+		meta_loadfile_close(fd);
 		return -1;
 	}
 
 	if (memcmp(hdr,"MFSM NEW",8)==0) {
-		bio_close(fd);
+		meta_loadfile_close(fd);
 		fs_new();
 		chunk_newfs();
 		sessions_new();
@@ -1212,13 +1796,18 @@ int meta_loadfile(const char *filename) {
 	}
 	if (memcmp(hdr,MFSSIGNATURE "M ",5)==0 && hdr[5]>='1' && hdr[5]<='9' && hdr[6]=='.' && hdr[7]>='0' && hdr[7]<='9') {
 		fver = ((hdr[5]-'0')<<4)+(hdr[7]-'0');
+		if (fver<0x21) {
+			meta_loadindex_free();
+		} else if (loadindex==NULL) {
+			mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"metadata index not found or damaged - segments will not be checked");
+		}
 		if (meta_load(fd,fver,&al)<0) {
 			if (bio_error(fd)) {
 				errno=bio_lasterrno(fd);
 				mfs_log(MFSLOG_ERRNO_SYSLOG_STDERR,MFSLOG_WARNING,"error reading metadata");
 			}
 			meta_cleanup();
-			bio_close(fd);
+			meta_loadfile_close(fd);
 			return -2;
 		}
 	} else {
@@ -1228,17 +1817,17 @@ int meta_loadfile(const char *filename) {
 		} else {
 			mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"wrong metadata header");
 		}
-		bio_close(fd);
+		meta_loadfile_close(fd);
 		return -2;
 	}
 	if (bio_error(fd)!=0) {
 		errno=bio_lasterrno(fd);
 		mfs_log(MFSLOG_ERRNO_SYSLOG_STDERR,MFSLOG_WARNING,"error reading metadata");
 		meta_cleanup();
-		bio_close(fd);
+		meta_loadfile_close(fd);
 		return -2;
 	}
-	bio_close(fd);
+	meta_loadfile_close(fd);
 	if (al) {
 		fs_afterload();
 	} else {
@@ -1727,6 +2316,12 @@ void meta_reload(void) {
 		MetaSaveOffset = MetaSaveOffset % 60*24;
 	}
 
+	MetaSaveMode = cfg_getuint8("METADATA_SAVE_MODE",0);
+	if (MetaSaveMode>1) {
+		mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"METADATA_SAVE_MODE - unknown mode (%"PRIu8") - using fork",MetaSaveMode);
+		MetaSaveMode = 0;
+	}
+
 	BackMetaCopies = cfg_getuint32("BACK_META_KEEP_PREVIOUS",1);
 	if (BackMetaCopies>99) {
 		mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_WARNING,"BACK_META_KEEP_PREVIOUS is too high (>99) - decreasing");
@@ -1873,6 +2468,11 @@ void meta_log_extra_info(FILE *fd) {
 	if (metasaverpid>=0) {
 		fprintf(fd,"background store in progress; process pid: %d\n",(int)metasaverpid);
 	}
+	if (incstore_state!=INCSTORE_IDLE) {
+		uint64_t spooledges,spoolbytes;
+		fs_incstore_info(&spooledges,&spoolbytes);
+		fprintf(fd,"incremental store in progress; phase: %s ; spooled edges: %"PRIu64" (%"PRIu64" bytes) ; pending writes: %"PRIu32"\n",(incstore_state==INCSTORE_NODES)?"nodes":(incstore_state==INCSTORE_EDGES)?"edges":(incstore_state==INCSTORE_CHUNKS)?"chunks":"closing",spooledges,spoolbytes,incstore_pending);
+	}
 	if (storestarttime>0) {
 		fprintf(fd,"store started %.2lf seconds ego\n",monotonic_seconds()-storestarttime);
 	}
@@ -1897,6 +2497,7 @@ int meta_init(void) {
 	main_reload_register(meta_reload);
 	main_info_register(meta_log_extra_info);
 	main_time_register(STORE_UNIT,0,meta_store_task);
+	main_eachloop_register(meta_incstore_loop);
 	main_mayexit_register(meta_mayexit);
 	main_destruct_register(meta_term);
 	fs_renumerate_edge_test();
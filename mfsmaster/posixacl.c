@@ -95,6 +95,10 @@ static acl_node* posix_acl_create(uint32_t inode,uint8_t acltype) {
 	return acn;
 }
 
+uint8_t posix_acl_stable(void) {
+	return posix_acl_xxx_hash_stable();
+}
+
 uint16_t posix_acl_getmode(uint32_t inode) {
 	acl_node *acn;
 
@@ -24,6 +24,7 @@
 
 #include "bio.h"
 
+uint8_t posix_acl_stable(void);
 uint16_t posix_acl_getmode(uint32_t inode);
 void posix_acl_setmode(uint32_t inode,uint16_t mode);
 uint8_t posix_acl_accmode(uint32_t inode,uint32_t auid,uint32_t agids,uint32_t *agid,uint32_t fuid,uint32_t fgid);
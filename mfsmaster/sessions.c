@@ -1052,9 +1052,9 @@ uint8_t sessions_check_trashretention(void *vsesdata,uint8_t smode,uint32_t tras
 
 void sessions_inc_stats(void *vsesdata,uint8_t statid) {
 	session *sesdata = (session*)vsesdata;
-	if (sesdata && statid<SESSION_STATS) {
-		sesdata->chouropstats[statid]++;
-		sesdata->cminopstats[statid]++;
+	if (sesdata && statid<SESSION_STATS) { // also called from reader threads (matoclserv)
+		__sync_fetch_and_add(sesdata->chouropstats+statid,1);
+		__sync_fetch_and_add(sesdata->cminopstats+statid,1);
 	}
 }
 
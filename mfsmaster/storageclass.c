@@ -44,7 +44,6 @@
 #define CHLOGSTRSIZE (4*MAXLABELSCNT*(SCLASS_EXPR_MAX_SIZE*2+1)+1)
 
 #define MAX_EC_LEVEL 9
-#define REDUCED_EC_LEVEL 1
 
 #define COMPAT_ECMODE 8
 
@@ -73,7 +72,7 @@ static uint32_t firstneverused=0;
 
 static uint8_t ec_current_version = 0;
 
-static uint8_t MaxECRedundancyLevel = 1;
+static uint8_t MaxECRedundancyLevel = MAX_EC_LEVEL;
 
 static uint8_t DefaultECMODE = 8; // = Default number of data parts
 
@@ -191,6 +190,11 @@ static uint8_t sclass_check_ec(uint8_t ec_new_version) {
 			return 0;
 		}
 	}
+	if (ec_new_version>=3) { // more than one checksum part (Reed-Solomon) - only chunkservers have to know it
+		if (matocsserv_get_min_cs_version()<VERSION2INT(4,60,0)) {
+			return 0;
+		}
+	}
 	changelog("%"PRIu32"|SCECVERSION(%u)",main_time(),ec_new_version);
 	ec_current_version = ec_new_version;
 	return 1;
@@ -348,6 +352,11 @@ uint8_t sclass_create_entry(uint8_t nleng,const uint8_t *name,uint8_t dleng,cons
 				return MFS_ERROR_INCOMPATVERSION;
 			}
 		}
+		if ((arch->ec_data_chksum_parts&0xF)>1) {
+			if (sclass_check_ec(3)==0) {
+				return MFS_ERROR_INCOMPATVERSION;
+			}
+		}
 		if (arch->labelscnt==0 || arch->labelscnt>2 || (arch->ec_data_chksum_parts&0xF)>MaxECRedundancyLevel) {
 			return MFS_ERROR_EINVAL;
 		}
@@ -372,6 +381,11 @@ uint8_t sclass_create_entry(uint8_t nleng,const uint8_t *name,uint8_t dleng,cons
 				return MFS_ERROR_INCOMPATVERSION;
 			}
 		}
+		if ((trash->ec_data_chksum_parts&0xF)>1) {
+			if (sclass_check_ec(3)==0) {
+				return MFS_ERROR_INCOMPATVERSION;
+			}
+		}
 		if (trash->labelscnt==0 || trash->labelscnt>2 || (trash->ec_data_chksum_parts&0xF)>MaxECRedundancyLevel) {
 			return MFS_ERROR_EINVAL;
 		}
@@ -443,6 +457,11 @@ uint8_t sclass_change_entry(uint8_t nleng,const uint8_t *name,uint16_t chgmask,u
 					return MFS_ERROR_INCOMPATVERSION;
 				}
 			}
+			if ((arch->ec_data_chksum_parts&0xF)>1) {
+				if (sclass_check_ec(3)==0) {
+					return MFS_ERROR_INCOMPATVERSION;
+				}
+			}
 			if (arch->labelscnt==0 || arch->labelscnt>2 || (arch->ec_data_chksum_parts&0xF)>MaxECRedundancyLevel) {
 				return MFS_ERROR_EINVAL;
 			}
@@ -469,6 +488,11 @@ uint8_t sclass_change_entry(uint8_t nleng,const uint8_t *name,uint16_t chgmask,u
 					return MFS_ERROR_INCOMPATVERSION;
 				}
 			}
+			if ((trash->ec_data_chksum_parts&0xF)>1) {
+				if (sclass_check_ec(3)==0) {
+					return MFS_ERROR_INCOMPATVERSION;
+				}
+			}
 			if (trash->labelscnt==0 || trash->labelscnt>2 || (trash->ec_data_chksum_parts&0xF)>MaxECRedundancyLevel) {
 				return MFS_ERROR_EINVAL;
 			}
@@ -623,6 +647,9 @@ uint8_t sclass_mr_set_entry(uint8_t nleng,const uint8_t *name,uint16_t esclassid
 		if ((arch->ec_data_chksum_parts>>4)==4 && ec_current_version<2) {
 			return MFS_ERROR_MISMATCH;
 		}
+		if ((arch->ec_data_chksum_parts&0xF)>1 && ec_current_version<3) {
+			return MFS_ERROR_MISMATCH;
+		}
 		if (arch->labelscnt==0 || arch->labelscnt>2 || (arch->ec_data_chksum_parts&0xF)>MAX_EC_LEVEL) {
 			return MFS_ERROR_EINVAL;
 		}
@@ -645,6 +672,9 @@ uint8_t sclass_mr_set_entry(uint8_t nleng,const uint8_t *name,uint16_t esclassid
 		if ((trash->ec_data_chksum_parts>>4)==4 && ec_current_version<2) {
 			return MFS_ERROR_MISMATCH;
 		}
+		if ((trash->ec_data_chksum_parts&0xF)>1 && ec_current_version<3) {
+			return MFS_ERROR_MISMATCH;
+		}
 		if (trash->labelscnt==0 || trash->labelscnt>2 || (trash->ec_data_chksum_parts&0xF)>MAX_EC_LEVEL) {
 			return MFS_ERROR_EINVAL;
 		}
@@ -1125,6 +1155,16 @@ storagemode* sclass_get_keeparch_storagemode(uint16_t sclassid,uint8_t flags) {
 	return &(sclasstab[sclassid].keep);
 }
 
+// returns 1 when sclass_get_keeparch_storagemode would return shared temporary record (not safe to be used by other threads)
+uint8_t sclass_keeparch_storagemode_is_temporary(uint16_t sclassid,uint8_t flags) {
+	if ((flags & 2)==2 && (sclasstab[sclassid].trash.labelscnt>0 || sclasstab[sclassid].trash.ec_data_chksum_parts)) {
+		return ((sclasstab[sclassid].trash.ec_data_chksum_parts&0xF)>MaxECRedundancyLevel)?1:0;
+	} else if ((flags & 1)==1 && (sclasstab[sclassid].arch.labelscnt>0 || sclasstab[sclassid].arch.ec_data_chksum_parts)) {
+		return ((sclasstab[sclassid].arch.ec_data_chksum_parts&0xF)>MaxECRedundancyLevel)?1:0;
+	}
+	return 0;
+}
+
 uint64_t sclass_get_joining_priority(uint16_t sclassid) {
 	uint64_t ret;
 	ret = sclasstab[sclassid].priority; // PRIORITY
@@ -1801,6 +1841,17 @@ int sclass_load(bio *fd,uint8_t mver,int ignoreflag) {
 					mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_NOTICE,"loading storage class data: sclassid: %"PRIu16" - data format error (arch.ec_data_chksum_parts: 0x%02"PRIX8" ; trash.ec_data_chksum_parts: 0x%02"PRIX8" ; ec_current_version: %u) - ignoring",sclassid,arch.ec_data_chksum_parts,trash.ec_data_chksum_parts,ec_current_version);
 				}
 			}
+			if (((arch.ec_data_chksum_parts&0xF)>1 || (trash.ec_data_chksum_parts&0xF)>1) && ec_current_version<3) {
+				ec_current_version = 3;
+				if (ignoreflag==0) {
+					mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_ERR,"loading storage class data: sclassid: %"PRIu16" - data format error (arch.ec_data_chksum_parts: 0x%02"PRIX8" ; trash.ec_data_chksum_parts: 0x%02"PRIX8" ; ec_current_version: %u)",sclassid,arch.ec_data_chksum_parts,trash.ec_data_chksum_parts,ec_current_version);
+					free(databuff);
+					databuff = NULL;
+					return -1;
+				} else {
+					mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_NOTICE,"loading storage class data: sclassid: %"PRIu16" - data format error (arch.ec_data_chksum_parts: 0x%02"PRIX8" ; trash.ec_data_chksum_parts: 0x%02"PRIX8" ; ec_current_version: %u) - ignoring",sclassid,arch.ec_data_chksum_parts,trash.ec_data_chksum_parts,ec_current_version);
+				}
+			}
 			if (sclassid>=MAXSCLASS) {
 				if (ignoreflag) {
 					mfs_log(MFSLOG_SYSLOG_STDERR,MFSLOG_NOTICE,"loading storage class data: bad sclassid (%"PRIu16") - ignore",sclassid);
@@ -2268,7 +2319,7 @@ void sclass_reload(void) {
 int sclass_init(void) {
 	uint32_t i;
 
-	MaxECRedundancyLevel = REDUCED_EC_LEVEL;
+	MaxECRedundancyLevel = MAX_EC_LEVEL;
 	sclass_reload();
 	for (i=0 ; i<MAXSCLASS ; i++) {
 		sclasstab[i].nleng = 0;
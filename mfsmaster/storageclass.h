@@ -83,6 +83,7 @@ uint8_t sclass_get_keeparch_storage_eights(uint16_t sclassid,uint8_t keepflag);
 uint8_t sclass_get_keeparch_maxstorage_eights(uint16_t sclassid);
 storagemode* sclass_get_create_storagemode(uint16_t sclassid);
 storagemode* sclass_get_keeparch_storagemode(uint16_t sclassid,uint8_t flags);
+uint8_t sclass_keeparch_storagemode_is_temporary(uint16_t sclassid,uint8_t flags);
 uint8_t sclass_calc_goal_equivalent(storagemode *sm);
 uint8_t sclass_is_predefined(uint16_t sclassid);
 // uint32_t sclass_get_priority(uint16_t sclassid);
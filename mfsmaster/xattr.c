@@ -222,6 +222,10 @@ uint8_t xattr_setattr(uint32_t inode,uint8_t anleng,const uint8_t *attrname,uint
 	return MFS_STATUS_OK;
 }
 
+uint8_t xattr_stable(void) {
+	return xattr_hash_stable();
+}
+
 uint8_t xattr_getattr(uint32_t inode,uint8_t anleng,const uint8_t *attrname,uint32_t *avleng,const uint8_t **attrvalue) {
 	xattrentry *xe;
 	xattrpair *xp;
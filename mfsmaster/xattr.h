@@ -26,6 +26,7 @@
 int xattr_namecheck(uint8_t anleng,const uint8_t *attrname);
 void xattr_removeinode(uint32_t inode);
 uint8_t xattr_setattr(uint32_t inode,uint8_t anleng,const uint8_t *attrname,uint32_t avleng,const uint8_t *attrvalue,uint8_t mode);
+uint8_t xattr_stable(void);
 uint8_t xattr_getattr(uint32_t inode,uint8_t anleng,const uint8_t *attrname,uint32_t *avleng,const uint8_t **attrvalue);
 uint8_t xattr_listattr_leng(uint32_t inode,void **xanode,uint32_t *xasize);
 void xattr_listattr_data(void *xanode,uint8_t *xabuff);
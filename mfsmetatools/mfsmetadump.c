@@ -29,6 +29,7 @@
 #include <inttypes.h>
 
 #include "labelparser.h"
+#include "metaindex.h"
 #include "MFSCommunication.h"
 #include "datapack.h"
 #include "idstr.h"
@@ -947,6 +948,33 @@ int csdb_load(FILE *fd,uint8_t mver) {
 	return 0;
 }
 
+int index_load(FILE *fd,uint8_t mver,uint64_t sleng) {
+	metaindex *mi;
+	const metaindex_section *ms;
+	uint32_t i,j;
+
+	if (mver>0x10) {
+		fprintf(stderr,"loading index: unsupported format\n");
+		return -1;
+	}
+	mi = metaindex_load(fileno(fd));
+	if (mi==NULL) {
+		fprintf(stderr,"loading index: index damaged\n");
+		return -1;
+	}
+	printf("# segment size: %"PRIu32" ; sections: %"PRIu32"\n",mi->segsize,mi->seccnt);
+	for (i=0 ; i<mi->seccnt ; i++) {
+		ms = mi->secs+i;
+		printf("SECTION|n:%c%c%c%c%c%c%c%c|o:%"PRIu64"|l:%"PRIu64"|r:%"PRIu64"|s:%"PRIu32"\n",dispchar(ms->hdr[0]),dispchar(ms->hdr[1]),dispchar(ms->hdr[2]),dispchar(ms->hdr[3]),dispchar(ms->hdr[4]),dispchar(ms->hdr[5]),dispchar(ms->hdr[6]),dispchar(ms->hdr[7]),ms->offset,ms->length,ms->records,ms->segcnt);
+		for (j=0 ; j<ms->segcnt ; j++) {
+			printf("SEGMENT|o:%"PRIu64"|l:%"PRIu32"|r:%"PRIu32"|c:%08"PRIX32"\n",ms->segs[j].offset,ms->segs[j].length,ms->segs[j].records,ms->segs[j].crc);
+		}
+	}
+	metaindex_free(mi);
+	fseeko(fd,sleng,SEEK_CUR);
+	return 0;
+}
+
 int of_load(FILE *fd,uint8_t mver) {
 	uint8_t loadbuff[8];
 	const uint8_t *ptr;
@@ -1591,6 +1619,18 @@ int fs_load(FILE *fd,uint8_t fver,const char section[4]) {
 		}
 	}
 
+	if (fver>=0x21 && section[0]!=0 && memcmp(section,"HEAD",4)!=0) { // jump directly to requested section
+		metaindex *mi;
+		const metaindex_section *ms;
+
+		mi = metaindex_load(fileno(fd));
+		if (mi!=NULL) {
+			ms = metaindex_find(mi,section);
+			fseeko(fd,(ms!=NULL)?ms->offset:mi->offset,SEEK_SET);
+			metaindex_free(mi);
+		}
+	}
+
 	while (1) {
 		if (fread(hdr,1,16,fd)!=16) {
 			printf("can't read section header\n");
@@ -1687,6 +1727,11 @@ int fs_load(FILE *fd,uint8_t fver,const char section[4]) {
 					printf("error reading metadata (CHNK)\n");
 					return -1;
 				}
+			} else if (memcmp(hdr,"INDX",4)==0) {
+				if (index_load(fd,mver,sleng)<0) {
+					printf("error reading metadata (INDX)\n");
+					return -1;
+				}
 			} else {
 				printf("unknown file part\n");
 				if (hexdump(fd,sleng)<0) {
@@ -1788,6 +1833,7 @@ void usage(const char *appname) {
 	printf("\tPLCK - posix locks (lockf,ioctl) data\n");
 	printf("\tCSDB - active chunkservers\n");
 	printf("\tCHNK - chunks\n");
+	printf("\tINDX - sections index\n");
 	exit(1);
 }
 
@@ -6,6 +6,13 @@ ANTOAN_NOP = 0
 ANTOCS_CLEAR_ERRORS        = (PROTO_BASE+306)
 CSTOAN_CLEAR_ERRORS        = (PROTO_BASE+307)
 
+CLTOMA_PATH_LOOKUP         = (PROTO_BASE+390)
+CLTOMA_FUSE_STATFS         = (PROTO_BASE+402)
+CLTOMA_FUSE_LOOKUP         = (PROTO_BASE+406)
+CLTOMA_FUSE_GETATTR        = (PROTO_BASE+408)
+CLTOMA_FUSE_READDIR        = (PROTO_BASE+428)
+CLTOMA_FUSE_GETXATTR       = (PROTO_BASE+478)
+
 CLTOMA_CSERV_LIST          = (PROTO_BASE+500)
 MATOCL_CSERV_LIST          = (PROTO_BASE+501)
 CLTOAN_CHART_DATA          = (PROTO_BASE+506)
@@ -38,6 +45,8 @@ CLTOMA_LIST_ACQUIRED_LOCKS = (PROTO_BASE+534)
 MATOCL_LIST_ACQUIRED_LOCKS = (PROTO_BASE+535)
 CLTOMA_MASS_RESOLVE_PATHS  = (PROTO_BASE+536)
 MATOCL_MASS_RESOLVE_PATHS  = (PROTO_BASE+537)
+CLTOMA_READERS_INFO        = (PROTO_BASE+538)
+MATOCL_READERS_INFO        = (PROTO_BASE+539)
 CLTOMA_SCLASS_INFO         = (PROTO_BASE+542)
 MATOCL_SCLASS_INFO         = (PROTO_BASE+543)
 CLTOMA_MISSING_CHUNKS      = (PROTO_BASE+544)
@@ -1,4 +1,4 @@
-VERSION = "4.59.2"
+VERSION = "4.60.0"
 
 PROTO_BASE = 0
 
@@ -260,7 +260,7 @@ class DataProvider:
 		data,length = self.master().command(CLTOMA_MEMORY_INFO,MATOCL_MEMORY_INFO)
 		if length>=176 and length%16==0:
 			memusage = struct.unpack(">QQQQQQQQQQQQQQQQQQQQQQ",data[:176])
-			memlabels = ["Chunk hash","Chunks","CS lists","Edge hash","Edges","Node hash","Nodes","Deleted nodes","Chunk tabs","Symlinks","Quota"]
+			memlabels = ["Chunk hash","Chunks","CS lists","Edge hash","Edges","Node index","Nodes","Deleted nodes","Chunk tabs","Symlinks","Quota"]
 			abrlabels = ["c.h.","c.","c.l.","e.h.","e.","n.h.","n.","d.n.","c.t.","s.","q."]
 			totalused = 0
 			totalallocated = 0
@@ -271,6 +271,26 @@ class DataProvider:
 		else:
 			raise RuntimeError("MFS packet malformed (MATOCL_MEMORY_INFO)")
 
+	def get_readers_info(self):
+		data,length = self.master().command(CLTOMA_READERS_INFO,MATOCL_READERS_INFO)
+		if length<33:
+			raise RuntimeError("MFS packet malformed (MATOCL_READERS_INFO)")
+		configured,running,phases,phaseusec,mainjobs,opcnt = struct.unpack(">LLQQQB",data[:33])
+		if length!=33+opcnt*44+running*24:
+			raise RuntimeError("MFS packet malformed (MATOCL_READERS_INFO)")
+		opnames = {CLTOMA_FUSE_LOOKUP:"lookup",CLTOMA_FUSE_GETATTR:"getattr",CLTOMA_FUSE_READDIR:"readdir",CLTOMA_FUSE_GETXATTR:"getxattr",CLTOMA_PATH_LOOKUP:"path lookup",CLTOMA_FUSE_STATFS:"statfs"}
+		pos = 33
+		ops = []
+		for i in range(opcnt):
+			optype,rcnt,rusec,rmaxusec,scnt,susec = struct.unpack(">LQQQQQ",data[pos:pos+44])
+			ops.append((opnames.get(optype,"type %u" % optype),rcnt,rusec,rmaxusec,scnt,susec))
+			pos += 44
+		threads = []
+		for i in range(running):
+			threads.append(struct.unpack(">QQQ",data[pos:pos+24]))
+			pos += 24
+		return ReadersInfo(configured,running,phases,phaseusec,mainjobs,ops,threads)
+
 	# Returns a list of all chunkservers in the cluster
 	# CSorder - order of chunkservers in the list, None - no ordering, Default - order by IP address and port nunmber	
 	# CSrev - reverse order in the returned list
@@ -264,6 +264,16 @@ class MemoryUsage:
 		self.totalallocated = totalallocated
 		self.memusage = memusage
 
+class ReadersInfo:
+	def __init__(self,configured,running,phases,phaseusec,mainjobs,ops,threads):
+		self.configured = configured
+		self.running = running
+		self.phases = phases
+		self.phaseusec = phaseusec
+		self.mainjobs = mainjobs
+		self.ops = ops           # list of (name,readercnt,readerusec,readermaxusec,serialcnt,serialusec)
+		self.threads = threads   # list of (jobs,busyusec,aliveusec)
+
 class ChunkServer:
 	def __init__(self,oip,ip,donotresolve,port,csid,v1,v2,v3,flags,used,total,chunks,tdused,tdtotal,tdchunks,errcnt,queue,gracetime,labels,mfrstatus,maintenanceto):
 		self.oip = oip
@@ -41,7 +41,7 @@ class Organization:
 			# Define menu & subsections structure
 			if cl.leaderfound():
 				self.menu_tree = [
-					["IN", ["IG", "IM", "LI", "IC", "IL", "MF", "MU"]],
+					["IN", ["IG", "IM", "LI", "IC", "IL", "MF", "MU", "RT"]],
 					["CS", ["CS"]],
 					["MB", ["MB"]],
 					["HD", ["HD"]],
@@ -91,6 +91,7 @@ class Organization:
 				"FL":("Filesystem Self-check Loop",lambda: cl.leaderfound() and guimode), #GUI only
 				"CL":("Chunks Housekeeping Loop",  lambda: cl.leaderfound() and guimode), #GUI only
 				"MU":("Memory Usage",              lambda: cl.leaderfound() and cl.master()!=None),
+				"RT":("Reader Threads",            lambda: cl.leaderfound() and cl.master()!=None and cl.master().version_at_least(4,59,2)),
 			"CS":("Chunkservers",                lambda: cl.master()!=None),
 			"HD":("Disks",                     lambda: cl.master()!=None),
 			"EX":("Exports",                   lambda: cl.master()!=None),
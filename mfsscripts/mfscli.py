@@ -247,6 +247,13 @@ ccchartslist = [
 		('hddmfr',45,6,'Number of folders (hard drives) that are marked for removal'),
 		('hdddmg',46,6,'Number of folders (hard drives) that are marked as damaged'),
 		('udiff',47,8,'Difference in usage percent between the most and least used disk'),
+		('wnextp50',48,6,'Write chain - median time of waiting for next chunk server (in microseconds)'),
+		('wnextp99',49,6,'Write chain - 99th percentile of time of waiting for next chunk server (in microseconds)'),
+		('wlocalp50',50,6,'Write chain - median time of local block writes (in microseconds)'),
+		('wlocalp99',51,6,'Write chain - 99th percentile of time of local block writes (in microseconds)'),
+		('bchits',52,6,'Number of reads served from block cache'),
+		('bcmisses',53,6,'Number of reads not found in block cache'),
+		('bchitratio',54,8,'Block cache hit ratio'),
 		('cpu',100,0,'Cpu usage (total sys+user)')
 ]
 ccchartsabr = {
@@ -290,7 +297,7 @@ for opt,val in opts:
 		val=""
 	if opt=='-h':
 		print("usage:")
-		print("\t%s [-hjpn28] [-H master_host] [-P master_port] [-f 0..3] -S(IN|IG|IM|IC|IL|MF|MU|CS|MB|HD|EX|MD|MS|MO|OF|AL|RP|SC|PA|QU|MC|CC) [-s separator] [-o order_id [-r]] [-m mode_id] [i id] [-a master_data_count] [-b master_data_desc] [-c chunkserver_data_count] [-d chunkserver_data_desc]" % sys.argv[0])
+		print("\t%s [-hjpn28] [-H master_host] [-P master_port] [-f 0..3] -S(IN|IG|IM|IC|IL|MF|MU|RT|CS|MB|HD|EX|MD|MS|MO|OF|AL|RP|SC|PA|QU|MC|CC) [-s separator] [-o order_id [-r]] [-m mode_id] [i id] [-a master_data_count] [-b master_data_desc] [-c chunkserver_data_count] [-d chunkserver_data_desc]" % sys.argv[0])
 		print("\t%s [-hjpn28] [-H master_host] [-P master_port] [-f 0..3] -C(RC/ip/port|TR/ip/port|BW/ip/port|M[01]/ip/port|RS/sessionid)" % sys.argv[0])
 		print("\t%s -v" % sys.argv[0])
 		print("\ncommon:\n")
@@ -316,13 +323,14 @@ for opt,val in opts:
 			print("\t\t-f3 : use utf-8 frames (double - default for utf-8 encodings)")
 		print("\nmonitoring:\n")
 		print("\t-S data set : defines data set to be displayed")
-		print("\t\t-SIN : show full master info (includes: SIG, SIM, SLI, SIC, SIL, SMF, SMU")
+		print("\t\t-SIN : show full master info (includes: SIG, SIM, SLI, SIC, SIL, SMF, SMU, SRT")
 		print("\t\t-SIG : show only general cluster summary")
 		print("\t\t-SIM : show only masters states")
 		print("\t\t-SIC : show only chunks info (target/current redundancy level matrices)")
 		print("\t\t-SIL : show only self-check loops info (with messages)")
 		print("\t\t-SMF : show only missing chunks/files")
 		print("\t\t-SMU : show only master memory usage")
+		print("\t\t-SRT : show only master reader threads statistics")
 		print("\t\t-SCS : show connected chunk servers")
 		print("\t\t-SMB : show connected metadata backup servers")
 		print("\t\t-SHD : show hdd data")
@@ -422,6 +430,8 @@ for opt,val in opts:
 			sectionset.append("IG")
 		if 'MU' in val:
 			sectionset.append("MU")
+		if 'RT' in val:
+			sectionset.append("RT")
 		if 'IC' in val:
 			sectionset.append("IC")
 			if lastmode!=None: ICmatrix = lastmode
@@ -2110,6 +2120,59 @@ if org.shall_render("MU"):
 	except Exception:
 		print_exception()
 
+# reader threads tables
+if org.shall_render("RT"):
+	try:
+		ri = dataprovider.get_readers_info()
+		if jsonmode:
+			json_rt_dict = {"configured": ri.configured, "running": ri.running, "phases": ri.phases, "phase_usec": ri.phaseusec, "main_thread_jobs": ri.mainjobs}
+			json_rt_ops = []
+			for name,rcnt,rusec,rmaxusec,scnt,susec in ri.ops:
+				json_rt_ops.append({"operation": name, "reader_count": rcnt, "reader_usec": rusec, "reader_max_usec": rmaxusec, "serial_count": scnt, "serial_usec": susec})
+			json_rt_dict["operations"] = json_rt_ops
+			json_rt_threads = []
+			for jobs,busyusec,aliveusec in ri.threads:
+				json_rt_threads.append({"jobs": jobs, "busy_usec": busyusec, "alive_usec": aliveusec})
+			json_rt_dict["threads"] = json_rt_threads
+			json_in_dict["reader_threads"] = json_rt_dict
+		else:
+			if ttymode:
+				tab = Table("Reader Threads (configured: %u ; running: %u ; phases: %u ; main thread jobs: %u)" % (ri.configured,ri.running,ri.phases,ri.mainjobs),7)
+				tab.header("",("executed by readers","",3),("executed serially","",2),"")
+				tab.header("operation",("---","",5),"")
+				tab.header("","count","avg time","max time","count","avg time","% by readers")
+				tab.defattr("l","r","r","r","r","r","r")
+			else:
+				tab = Table("reader threads operations",6)
+				tab.header("operation","reader count","reader usec","reader max usec","serial count","serial usec")
+			for name,rcnt,rusec,rmaxusec,scnt,susec in ri.ops:
+				if ttymode:
+					ravg = ("%.2f us" % (float(rusec)/rcnt)) if rcnt>0 else "-"
+					savg = ("%.2f us" % (float(susec)/scnt)) if scnt>0 else "-"
+					rmax = ("%u us" % rmaxusec) if rcnt>0 else "-"
+					rperc = ("%.2f %%" % (100.0*rcnt/(rcnt+scnt))) if rcnt+scnt>0 else "-"
+					tab.append(name,rcnt,ravg,rmax,scnt,savg,rperc)
+				else:
+					tab.append(name,rcnt,rusec,rmaxusec,scnt,susec)
+			print(myunicode(tab))
+			if ri.running>0:
+				if ttymode:
+					tab = Table("Reader Threads Utilization",4)
+					tab.header("thread","jobs","busy time","utilization")
+					tab.defattr("r","r","r","r")
+				else:
+					tab = Table("reader threads utilization",4)
+					tab.header("thread","jobs","busy usec","alive usec")
+				for i,(jobs,busyusec,aliveusec) in enumerate(ri.threads):
+					if ttymode:
+						utilization = ("%.2f %%" % (100.0*busyusec/aliveusec)) if aliveusec>0 else "-"
+						tab.append(i,jobs,"%.3f s" % (busyusec/1000000.0),utilization)
+					else:
+						tab.append(i,jobs,busyusec,aliveusec)
+				print(myunicode(tab))
+	except Exception:
+		print_exception()
+
 if jsonmode and len(json_in_dict)>0:
 	jcollect["dataset"]["info"] = json_in_dict
 
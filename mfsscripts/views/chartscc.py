@@ -30,6 +30,9 @@ def render(dp, fields, vld):
 		(17,'hlopw','number of high-level write operations (per minute)','',''),
 		(18,'rtime','time of data read operations','',''),
 		(19,'wtime','time of data write operations','',''),
+		(49,'wnextp99','write chain - 99th percentile of time of waiting for next chunk server','',''),
+		(51,'wlocalp99','write chain - 99th percentile of time of local block writes','',''),
+		(54,'bchitratio','block cache hit ratio (percent)','',''),
 		(20,'repl','number of chunk replications (per minute)','',''),
 		(21,'create','number of chunk creations (per minute)','',''),
 		(22,'delete','number of chunk deletions (per minute)','',''),
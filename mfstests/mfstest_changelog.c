@@ -0,0 +1,495 @@
+/*
+ * Copyright (C) 2026 Jakub Kruszona-Zawadzki, Saglabs SA
+ *
+ * This file is part of MooseFS.
+ *
+ * MooseFS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 (only).
+ *
+ * MooseFS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "changelog.h"
+#include "chlogbin.h"
+#include "crc.h"
+
+#include "mfstest.h"
+
+#define CHANGES 100
+
+/* master environment needed by changelog.c */
+
+static uint8_t savemode,binary;
+static uint64_t metaversion;
+static int bglogfd = -1;
+
+uint8_t cfg_getuint8(const char *name,const uint8_t def) {
+	if (strcmp(name,"CHANGELOG_SAVE_MODE")==0) {
+		return savemode;
+	}
+	if (strcmp(name,"CHANGELOG_BINARY")==0) {
+		return binary;
+	}
+	return def;
+}
+
+uint16_t cfg_getuint16(const char *name,const uint16_t def) {
+	(void)name;
+	return def;
+}
+
+uint32_t cfg_getuint32(const char *name,const uint32_t def) {
+	(void)name;
+	return def;
+}
+
+uint32_t main_time(void) {
+	return 1000000;
+}
+
+void* main_time_register_fname(uint32_t seconds,uint32_t offset,void (*fun)(void),const char *fname) {
+	(void)seconds;
+	(void)offset;
+	(void)fun;
+	(void)fname;
+	return NULL;
+}
+
+void main_reload_register_fname(void (*fun)(void),const char *fname) {
+	(void)fun;
+	(void)fname;
+}
+
+void main_info_register_fname(void (*fun)(FILE *),const char *fname) {
+	(void)fun;
+	(void)fname;
+}
+
+void main_eachloop_register_fname(void (*fun)(void),const char *fname) {
+	(void)fun;
+	(void)fname;
+}
+
+void main_destruct_register_fname(void (*fun)(void),const char *fname) {
+	(void)fun;
+	(void)fname;
+}
+
+uint64_t meta_version_inc(void) {
+	return metaversion++;
+}
+
+uint64_t meta_version(void) {
+	return metaversion;
+}
+
+uint64_t meta_chlog_keep_version(void) {
+	return metaversion;
+}
+
+uint64_t matomlserv_get_min_version(void) {
+	return metaversion;
+}
+
+void matomlserv_broadcast_logstring(uint64_t version,uint8_t *logstr,uint32_t logstrsize) {
+	(void)version;
+	(void)logstr;
+	(void)logstrsize;
+}
+
+void matomlserv_broadcast_logrotate(void) {
+}
+
+/* background writer - requests are queued and processed later (as in separate process), 'changelog.0.mfs' is kept opened until rotation */
+typedef struct _bgrequest {
+	uint64_t version; // 0 - rotate
+	char *message;
+	struct _bgrequest *next;
+} bgrequest;
+
+static bgrequest *bghead = NULL,**bgtail = &bghead;
+
+static void bgsaver_queue(uint64_t version,const char *message) {
+	bgrequest *r;
+
+	r = malloc(sizeof(bgrequest));
+	r->version = version;
+	r->message = (message!=NULL)?strdup(message):NULL;
+	r->next = NULL;
+	*bgtail = r;
+	bgtail = &(r->next);
+}
+
+void bgsaver_changelog(uint64_t version,const char *message) {
+	bgsaver_queue(version,message);
+}
+
+int bgsaver_rotatelog(void) {
+	bgsaver_queue(0,NULL);
+	return 0;
+}
+
+static void bgsaver_process(void) {
+	char buff[1000];
+	char logname1[100],logname2[100];
+	bgrequest *r;
+	uint32_t i;
+	int l;
+
+	while ((r=bghead)!=NULL) {
+		bghead = r->next;
+		if (r->version==0) {
+			if (bglogfd>=0) {
+				close(bglogfd);
+				bglogfd = -1;
+			}
+			for (i=50 ; i>0 ; i--) {
+				snprintf(logname1,100,"changelog.%"PRIu32".mfs",i);
+				snprintf(logname2,100,"changelog.%"PRIu32".mfs",i-1);
+				rename(logname2,logname1);
+			}
+			changelog_bgrotated();
+		} else {
+			if (bglogfd<0) {
+				bglogfd = open("changelog.0.mfs",O_WRONLY | O_CREAT | O_APPEND,0666);
+			}
+			l = snprintf(buff,1000,"%"PRIu64": %s\n",r->version,r->message);
+			if (bglogfd<0 || write(bglogfd,buff,l)!=l) {
+				printf("background writer: write error\n");
+			}
+			free(r->message);
+		}
+		free(r);
+	}
+	bgtail = &bghead;
+}
+
+void changelog_reload(void);
+void changelog_term(void);
+
+static void add_changes(void) {
+	uint32_t i;
+
+	for (i=0 ; i<CHANGES ; i++) {
+		changelog("%"PRIu32"|ACCESS(%"PRIu32")",main_time(),i+1);
+		if (i%10==9) {
+			changelog_flush();
+		}
+	}
+	changelog_flush();
+}
+
+// background writer is late - lines sent before mode change are processed after some changes made in new mode
+static void set_mode(uint8_t mode) {
+	savemode = mode;
+	changelog_reload();
+	add_changes();
+	bgsaver_process();
+	add_changes();
+}
+
+/* checks all changelog files from the oldest one - returns number of found changes and sets 'errors' (damaged data and holes in versions) */
+static uint64_t check_changelogs(uint32_t *binfiles,uint32_t *errors) {
+	char fname[100];
+	char line[1000];
+	struct stat st;
+	chlogbin_reader *r;
+	const char *bline;
+	FILE *fd;
+	uint64_t expected,version;
+	int i,s;
+
+	expected = 1;
+	*binfiles = 0;
+	*errors = 0;
+	for (i=50 ; i>=0 ; i--) {
+		snprintf(fname,100,"changelog.%d.mfs",i);
+		if (stat(fname,&st)<0) {
+			continue;
+		}
+		fd = fopen(fname,"r");
+		if (chlogbin_check_magic(fileno(fd))) {
+			(*binfiles)++;
+			if (chlogbin_validlength(fileno(fd))!=(uint64_t)(st.st_size)) {
+				printf("%s: damaged tail\n",fname);
+				(*errors)++;
+			}
+			fseek(fd,CHLOGBIN_MAGIC_SIZE,SEEK_SET);
+			r = chlogbin_reader_new(fd);
+			while ((s=chlogbin_reader_next(r,&version,&bline))>0) {
+				if (version!=expected) {
+					(*errors)++;
+				}
+				expected = version+1;
+			}
+			if (s<0) {
+				(*errors)++;
+			}
+			chlogbin_reader_free(r);
+		} else {
+			rewind(fd);
+			while (fgets(line,1000,fd)!=NULL) {
+				version = strtoull(line,NULL,10);
+				if (version!=expected) {
+					(*errors)++;
+				}
+				expected = version+1;
+			}
+		}
+		fclose(fd);
+		unlink(fname);
+	}
+	return expected-1;
+}
+
+/* binary format round trip - every change has to be decoded to exactly the same text as printf gives */
+
+#define BINFILE "chlogbin.mfs"
+#define BINCHANGES 100
+
+static chlogbin_buff binbuff = {NULL,0,0,0};
+static char *binexpected[BINCHANGES];
+static uint32_t bincnt;
+static uint64_t binversion;
+
+static void bin_change(const char *format,...) {
+	char text[1000];
+	va_list ap,aq;
+	int l;
+
+	va_start(ap,format);
+	va_copy(aq,ap);
+	l = vsnprintf(text,1000,format,ap);
+	chlogbin_add(&binbuff,binversion,text,l,format,&aq);
+	va_end(aq);
+	va_end(ap);
+	binexpected[bincnt++] = strdup(text);
+	binversion++;
+}
+
+// change stored without format (as changes received from other master)
+static void bin_text(const char *text) {
+	chlogbin_add(&binbuff,binversion,text,strlen(text),NULL,NULL);
+	binexpected[bincnt++] = strdup(text);
+	binversion++;
+}
+
+static void bin_flush(int fd) {
+	chlogbin_seal(&binbuff);
+	if (write(fd,binbuff.data,binbuff.leng)!=(ssize_t)(binbuff.leng)) {
+		printf("write error\n");
+	}
+	binbuff.leng = 0;
+}
+
+// each kind of change uses its own format (templates are identified by format pointer)
+static void bin_add_strings(void) {
+	bin_change("%"PRIu32"|CREATE(%"PRIu32",%s):%"PRIu32,main_time(),1U,"",2U);
+	bin_change("%"PRIu32"|CREATE(%"PRIu32",%s):%"PRIu32,main_time(),1U,"a|b|c",3U);
+	bin_change("%s|%s|%s","","|","x");
+}
+
+static void bin_add_signed(void) {
+	bin_change("%"PRIu32"|SIGNED(%d,%"PRId64",%hd,%hhd,%ld)",main_time(),-1,INT64_MIN,(short)-32768,(signed char)-128,-123456789L);
+	bin_change("%"PRIu32"|SIGNED(%d,%"PRId64",%hd,%hhd,%ld)",main_time(),INT32_MAX,INT64_MAX,(short)32767,(signed char)127,0L);
+}
+
+static void bin_add_chars(void) {
+	bin_change("%c%c|CHAR(%c)",'A','|','z');
+}
+
+static void bin_add_flags(void) {
+	bin_change("[%5u|%-6s|%08"PRIx64"|%+d|% d|%.3s|%#o|%#x|%X|%%|%-4c]",42U,"ab",UINT64_C(0xABCDEF),7,-7,"abcdef",8U,255U,0xBEEFU,'q');
+}
+
+static void bin_add_text(void) {
+	bin_change("%"PRIu32"|RATIO(%.2f)",main_time(),0.5);	// floats can't be encoded - text record
+	bin_text("1000000|SESSION(7)");
+}
+
+// reads whole file - returns number of differences ; 'status' - expected result of the last chlogbin_reader_next
+static uint32_t bin_check(uint64_t firstversion,uint32_t expcnt,int status) {
+	chlogbin_reader *r;
+	const char *line;
+	uint64_t version;
+	uint32_t i,errors;
+	FILE *fd;
+	int s;
+
+	fd = fopen(BINFILE,"r");
+	if (fd==NULL) {
+		return 1;
+	}
+	errors = 0;
+	if (chlogbin_check_magic(fileno(fd))==0) {
+		errors++;
+	}
+	fseek(fd,CHLOGBIN_MAGIC_SIZE,SEEK_SET);
+	r = chlogbin_reader_new(fd);
+	i = 0;
+	while ((s=chlogbin_reader_next(r,&version,&line))>0) {
+		if (i>=expcnt || version!=firstversion+i || strcmp(line,binexpected[i])!=0) {
+			printf("change %"PRIu64": '%s' (expected: '%s')\n",version,line,(i<expcnt)?binexpected[i]:"");
+			errors++;
+		}
+		i++;
+	}
+	if (i!=expcnt || s!=status) {
+		errors++;
+	}
+	chlogbin_reader_free(r);
+	fclose(fd);
+	return errors;
+}
+
+static void bin_test(void) {
+	struct stat st;
+	uint64_t goodlength,goodversion;
+	uint32_t goodcnt,i;
+	uint8_t byte;
+	int fd;
+
+	fd = open(BINFILE,O_RDWR | O_CREAT | O_TRUNC,0666);
+	if (fd<0 || write(fd,CHLOGBIN_MAGIC,CHLOGBIN_MAGIC_SIZE)!=CHLOGBIN_MAGIC_SIZE) {
+		printf("can't create %s\n",BINFILE);
+	}
+	bincnt = 0;
+	binversion = 1000;
+
+	// first writer session
+	chlogbin_newsession();
+	bin_add_strings();
+	bin_flush(fd);
+	bin_add_signed();
+	bin_add_chars();
+	bin_add_flags();
+	bin_flush(fd);
+	bin_add_text();
+	bin_add_strings();
+	bin_flush(fd);
+
+	// second session appended to the same file - templates get new ids (in different order), reader has to forget old ones
+	chlogbin_newsession();
+	bin_add_flags();
+	bin_add_chars();
+	bin_flush(fd);
+	bin_add_signed();
+	bin_add_strings();
+	bin_flush(fd);
+
+	mfstest_assert_uint32_eq(bin_check(1000,bincnt,0),0);
+	fstat(fd,&st);
+	goodlength = st.st_size;
+	goodversion = binversion-1;
+	goodcnt = bincnt;
+	mfstest_assert_uint64_eq(chlogbin_validlength(fd),goodlength);
+	mfstest_assert_uint64_eq(chlogbin_findfirstversion(fd),1000);
+	mfstest_assert_uint64_eq(chlogbin_findlastversion(fd),goodversion);
+
+	// last block damaged (interrupted write) - it has to be ignored
+	bin_add_flags();
+	bin_add_strings();
+	bin_flush(fd);
+	fstat(fd,&st);
+	if (pread(fd,&byte,1,st.st_size-1)!=1) {
+		printf("read error\n");
+	}
+	byte ^= 0xFF;
+	if (pwrite(fd,&byte,1,st.st_size-1)!=1) {
+		printf("write error\n");
+	}
+	mfstest_assert_uint64_eq(chlogbin_validlength(fd),goodlength);
+	mfstest_assert_uint64_eq(chlogbin_findlastversion(fd),goodversion);
+	mfstest_assert_uint32_eq(bin_check(1000,goodcnt,-1),0);
+
+	// last block cut in the middle of header
+	if (ftruncate(fd,goodlength+10)<0) {
+		printf("truncate error\n");
+	}
+	mfstest_assert_uint64_eq(chlogbin_validlength(fd),goodlength);
+	mfstest_assert_uint64_eq(chlogbin_findlastversion(fd),goodversion);
+
+	// after truncation file is valid again
+	if (ftruncate(fd,chlogbin_validlength(fd))<0) {
+		printf("truncate error\n");
+	}
+	mfstest_assert_uint32_eq(bin_check(1000,goodcnt,0),0);
+
+	close(fd);
+	unlink(BINFILE);
+	for (i=0 ; i<bincnt ; i++) {
+		free(binexpected[i]);
+	}
+	free(binbuff.data);
+}
+
+int main(void) {
+	char dname[] = "/tmp/mfstest_changelog.XXXXXX";
+	uint32_t binfiles,errors;
+
+	mfstest_init();
+	mycrc32_init();
+
+	if (mkdtemp(dname)==NULL || chdir(dname)<0) {
+		printf("can't create temporary directory\n");
+		return 1;
+	}
+	metaversion = 1;
+
+	mfstest_start(changelog_savemode_switch);
+	binary = 1;
+	savemode = 1;
+	changelog_init();
+	add_changes();	// binary file written by master
+	set_mode(0);	// background writer (text) - has to start new file
+	set_mode(2);	// master has to wait for background writer and start new file
+	set_mode(0);
+	set_mode(1);
+	set_mode(0);
+	bgsaver_process();
+	changelog_term();
+	mfstest_assert_uint64_eq(check_changelogs(&binfiles,&errors),11*CHANGES);
+	mfstest_assert_uint32_eq(binfiles,3);
+	mfstest_assert_uint32_eq(errors,0);
+
+	// the same starting in sync mode
+	metaversion = 1;
+	savemode = 2;
+	changelog_reload();
+	add_changes();
+	set_mode(0);
+	set_mode(2);
+	bgsaver_process();
+	changelog_term();
+	mfstest_assert_uint64_eq(check_changelogs(&binfiles,&errors),5*CHANGES);
+	mfstest_assert_uint32_eq(binfiles,2);
+	mfstest_assert_uint32_eq(errors,0);
+	mfstest_end();
+
+	mfstest_start(chlogbin_roundtrip);
+	bin_test();
+	mfstest_end();
+
+	if (bglogfd>=0) {
+		close(bglogfd);
+	}
+	rmdir(dname);
+	mfstest_return();
+}
@@ -76,31 +76,8 @@ uint32_t simple_pseudo_random(void) {
 	return (v << 16) + u;
 }
 
-int main(void) {
-	uint8_t *speedtestblock;
-	uint8_t *rblock,*sblock,*xblock;
+static void crc32_check_engine(uint8_t *rblock,uint8_t *sblock,uint8_t *xblock) {
 	uint32_t i,j,s,crc,crc1,crc2;
-	double st,en,corr,mycrctime,refcrctime;
-
-	rblock = malloc(sizeof(uint8_t)*65536);
-	sblock = malloc(sizeof(uint8_t)*65536);
-	xblock = malloc(sizeof(uint8_t)*65536);
-	if (rblock==NULL || sblock==NULL || xblock==NULL) {
-		return 99;
-	}
-
-	mfstest_init();
-
-	// tabble generation
-	mycrc32_init();
-
-	mfstest_start(crc32);
-
-	for (i=0 ; i<65536 ; i++) {
-		rblock[i] = simple_pseudo_random();
-		sblock[i] = simple_pseudo_random();
-		xblock[i] = rblock[i] ^ sblock[i];
-	}
 
 	printf("mycrc32 - different starting values\n");
 
@@ -118,6 +95,11 @@ int main(void) {
 			mfstest_assert_uint32_eq(mycrc32(0,sblock+i,1000+j),crc32_reference(0,sblock+i,1000+j));
 		}
 	}
+	for (i=0 ; i<16 ; i++) {
+		for (j=0 ; j<=320 ; j+=(j<64)?1:17) {
+			mfstest_assert_uint32_eq(mycrc32(0,sblock+i,j),crc32_reference(0,sblock+i,j));
+		}
+	}
 
 	printf("mycrc32_combine - calculate crc of concatenated blocks\n");
 
@@ -130,6 +112,12 @@ int main(void) {
 			mfstest_assert_uint32_eq(mycrc32_combine(crc1,crc2,j-i),crc);
 		}
 	}
+	for (j = 0 ; j <= 64 ; j++) {
+		crc = crc32_reference(0,sblock,1000+j);
+		crc1 = crc32_reference(0,sblock,1000);
+		crc2 = crc32_reference(0,sblock+1000,j);
+		mfstest_assert_uint32_eq(mycrc32_combine(crc1,crc2,j),crc);
+	}
 
 	printf("mycrc32_xorblocks - calculate crc of xored blocks\n");
 
@@ -141,6 +129,10 @@ int main(void) {
 			mfstest_assert_uint32_eq(mycrc32_xorblocks(s,crc32_reference(s,rblock,j),crc32_reference(s,sblock,j),j),crc32_reference(s,xblock,j));
 		}
 	}
+}
+
+static void crc32_check_zeroexpand(uint8_t *rblock,uint8_t *sblock) {
+	uint32_t i,j,s;
 
 	printf("mycrc32_zeroexpand - calculate crc of block expanded by zeros\n");
 
@@ -159,6 +151,80 @@ int main(void) {
 			mfstest_assert_uint32_eq(mycrc32_zeroexpanded(s,rblock,(j-i),i),crc32_reference(s,sblock,j));
 		}
 	}
+}
+
+#define BENCH_DATA_SIZE (32*1024*1024)
+
+/* throughput of current engine for given block size (in MB/s) */
+static double crc32_bench_calc(uint8_t *block,uint32_t bsize,double corr,uint32_t *crcsum) {
+	uint32_t i,loops,crc;
+	double st,en;
+
+	loops = BENCH_DATA_SIZE / bsize;
+	crc = 0;
+	st = monotonic_seconds();
+	for (i=0 ; i<loops ; i++) {
+		crc ^= mycrc32(i,block,bsize);
+	}
+	en = monotonic_seconds();
+	*crcsum ^= crc;
+	return (BENCH_DATA_SIZE/(1024.0*1024.0))/((en-st)-corr);
+}
+
+/* combine operations per second (in millions) */
+static double crc32_bench_combine(double corr,uint32_t *crcsum) {
+	uint32_t i,crc;
+	double st,en;
+
+	crc = 0;
+	st = monotonic_seconds();
+	for (i=0 ; i<1000000 ; i++) {
+		crc = mycrc32_combine(crc,i,(i&0xFFFF)+1);
+	}
+	en = monotonic_seconds();
+	*crcsum ^= crc;
+	return 1.0/((en-st)-corr);
+}
+
+int main(void) {
+	uint8_t *speedtestblock;
+	uint8_t *rblock,*sblock,*xblock;
+	uint32_t i,crc1,crc2,bsize;
+	uint32_t crcsum[CRC_ENGINES];
+	uint8_t engine,bestengine;
+	double st,en,corr,mycrctime,refcrctime;
+
+	rblock = malloc(sizeof(uint8_t)*65536);
+	sblock = malloc(sizeof(uint8_t)*65536);
+	xblock = malloc(sizeof(uint8_t)*65536);
+	if (rblock==NULL || sblock==NULL || xblock==NULL) {
+		return 99;
+	}
+
+	mfstest_init();
+
+	// tabble generation
+	mycrc32_init();
+	bestengine = mycrc32_engine_current();
+
+	mfstest_start(crc32);
+
+	for (i=0 ; i<65536 ; i++) {
+		rblock[i] = simple_pseudo_random();
+		sblock[i] = simple_pseudo_random();
+		xblock[i] = rblock[i] ^ sblock[i];
+	}
+
+	for (engine=0 ; engine<CRC_ENGINES ; engine++) {
+		if (mycrc32_engine_select(engine)) {
+			printf("engine: %s\n",mycrc32_engine_name(engine));
+			crc32_check_engine(rblock,sblock,xblock);
+		}
+	}
+	mycrc32_engine_select(bestengine);
+	printf("default engine: %s\n",mycrc32_engine_name(bestengine));
+
+	crc32_check_zeroexpand(rblock,sblock);
 
 	printf("mycrc32 speed\n");
 
@@ -198,9 +264,42 @@ int main(void) {
 	mfstest_assert_uint32_eq(crc1,crc2);
 	printf("block 16M ; mycrc32: %.2lfMB/s ; crc32: %.2lfMB/s ; speedup: %.2lf\n",16.0/mycrctime,16.0/refcrctime,refcrctime / mycrctime);
 
+	printf("engine throughput (MB/s)\n");
+	printf("%8s","bsize");
+	for (engine=0 ; engine<CRC_ENGINES ; engine++) {
+		crcsum[engine] = 0;
+		if (mycrc32_engine_supported(engine)) {
+			printf(" ; %10s",mycrc32_engine_name(engine));
+		}
+	}
+	printf("\n");
+	for (bsize=1024 ; bsize<=65536 ; bsize*=2) {
+		printf("%7uk",bsize/1024);
+		for (engine=0 ; engine<CRC_ENGINES ; engine++) {
+			if (mycrc32_engine_select(engine)) {
+				printf(" ; %10.2lf",crc32_bench_calc(rblock,bsize,corr,crcsum+engine));
+			}
+		}
+		printf("\n");
+	}
+	printf("%8s","combine");
+	for (engine=0 ; engine<CRC_ENGINES ; engine++) {
+		if (mycrc32_engine_select(engine)) {
+			printf(" ; %9.2lfM",crc32_bench_combine(corr,crcsum+engine));
+		}
+	}
+	printf(" (ops/s)\n");
+	for (engine=1 ; engine<CRC_ENGINES ; engine++) {
+		if (mycrc32_engine_supported(engine)) {
+			mfstest_assert_uint32_eq(crcsum[engine],crcsum[CRC_ENGINE_TABLE]);
+		}
+	}
+	mycrc32_engine_select(bestengine);
+
 	mfstest_end();
 	mfstest_return();
 
+	free(speedtestblock);
 	free(xblock);
 	free(sblock);
 	free(rblock);
@@ -24,11 +24,17 @@
 
 #include "mfstest.h"
 
+#define CHUNKS 1000
+
 int main(void) {
 	uint64_t buff[2];
 	uint8_t *wp;
 	const uint8_t *rp;
-	uint32_t i;
+	uint32_t i,errors,leng;
+	uint64_t v64;
+	static uint64_t chunkids[CHUNKS],rchunkids[CHUNKS];
+	static uint32_t versions[CHUNKS],rversions[CHUNKS];
+	static uint8_t chlbuff[CHUNKS*(10+5)];
 
 	mfstest_init();
 
@@ -130,6 +136,68 @@ int main(void) {
 		mfstest_assert_uint8_eq(rp[i],((15-i)*0x10)+i);
 	}
 	mfstest_end();
+
+	mfstest_start(varint);
+	wp = (uint8_t*)buff;
+	putvarint(&wp,0);
+	putvarint(&wp,0x7F);
+	putvarint(&wp,0x80);
+	putvarint(&wp,UINT64_C(0xFFFFFFFFFFFFFFFF));
+	mfstest_assert_uint32_eq(wp-(uint8_t*)buff,1+1+2+10);
+	mfstest_assert_uint8_eq(varintsize(0x80),2);
+	mfstest_assert_uint8_eq(varintsize(UINT64_C(0xFFFFFFFFFFFFFFFF)),10);
+
+	rp = (uint8_t*)buff;
+	mfstest_assert_int32_eq(getvarint(&rp,wp,&v64),0);
+	mfstest_assert_uint64_eq(v64,0);
+	mfstest_assert_int32_eq(getvarint(&rp,wp,&v64),0);
+	mfstest_assert_uint64_eq(v64,0x7F);
+	mfstest_assert_int32_eq(getvarint(&rp,wp,&v64),0);
+	mfstest_assert_uint64_eq(v64,0x80);
+	mfstest_assert_int32_eq(getvarint(&rp,wp-1,&v64),-1);
+	mfstest_assert_int32_eq(getvarint(&rp,wp,&v64),0);
+	mfstest_assert_uint64_eq(v64,UINT64_C(0xFFFFFFFFFFFFFFFF));
+	mfstest_end();
+
+	mfstest_start(chunklist);
+	// sorted chunkids with small and huge gaps (ecid in the highest byte), versions with and without 'mfr' bit
+	v64 = 0;
+	for (i=0 ; i<CHUNKS ; i++) {
+		v64 += (i%100==99)?UINT64_C(0x0100000000000000):(1+(i*7919)%300);
+		chunkids[i] = v64;
+		versions[i] = ((i*2654435761U)&0x7FFFFFFF) | ((i%3==0)?0x80000000:0);
+	}
+	versions[0] = 0;
+	versions[1] = 0xFFFFFFFF;
+	wp = chlbuff;
+	putchunklist(&wp,chunkids,versions,CHUNKS);
+	leng = wp-chlbuff;
+	mfstest_assert_uint32_eq(leng,chunklistsize(chunkids,versions,CHUNKS));
+	mfstest_assert_uint32(leng,<,CHUNKS*(8+4));
+
+	rp = chlbuff;
+	mfstest_assert_int32_eq(getchunklist(&rp,chlbuff+leng,rchunkids,rversions,CHUNKS),0);
+	mfstest_assert_uint32_eq(rp-chlbuff,leng);
+	errors = 0;
+	for (i=0 ; i<CHUNKS ; i++) {
+		if (rchunkids[i]!=chunkids[i] || rversions[i]!=versions[i]) {
+			errors++;
+		}
+	}
+	mfstest_assert_uint32_eq(errors,0);
+
+	rp = chlbuff;
+	mfstest_assert_int32_eq(getchunklist(&rp,chlbuff+leng-1,rchunkids,rversions,CHUNKS),-1);
+	rp = chlbuff;
+	mfstest_assert_int32_eq(getchunklist(&rp,chlbuff+leng,rchunkids,rversions,CHUNKS+1),-1);
+	// version field wider than 32 bits
+	wp = chlbuff;
+	putvarint(&wp,1);
+	putvarint(&wp,UINT64_C(0x100000000));
+	rp = chlbuff;
+	mfstest_assert_int32_eq(getchunklist(&rp,wp,rchunkids,rversions,1),-1);
+	mfstest_end();
+
 	mfstest_return();
 }
 
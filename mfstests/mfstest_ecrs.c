@@ -0,0 +1,308 @@
+/*
+ * Copyright (C) 2026 Jakub Kruszona-Zawadzki, Saglabs SA
+ * 
+ * This file is part of MooseFS.
+ * 
+ * MooseFS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 (only).
+ * 
+ * MooseFS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "clocks.h"
+#include "crc.h"
+#include "ecrs.h"
+
+#include "mfstest.h"
+
+#define TEST_LENG (1024+13)
+#define BENCH_LENG 65536
+#define BENCH_DATA_SIZE (64*1024*1024)
+
+uint32_t simple_pseudo_random(void) {
+	static uint32_t u=1249853491;
+	static uint32_t v=3456394786;
+
+	v = 36969*(v & 65535) + (v >> 16);
+	u = 18000*(u & 65535) + (u >> 16);
+
+	return (v << 16) + u;
+}
+
+/* bit by bit multiplication - reference */
+static uint8_t gfmul_reference(uint8_t a,uint8_t b) {
+	uint16_t r,x;
+
+	r = 0;
+	x = a;
+	while (b) {
+		if (b&1) {
+			r ^= x;
+		}
+		x <<= 1;
+		if (x&0x100) {
+			x ^= 0x11D;
+		}
+		b >>= 1;
+	}
+	return r;
+}
+
+static void dotprod_reference(uint8_t *dst,uint8_t **src,const uint8_t *coefs,uint8_t cnt,uint32_t leng) {
+	uint32_t pos;
+	uint8_t i,r;
+
+	for (pos=0 ; pos<leng ; pos++) {
+		r = 0;
+		for (i=0 ; i<cnt ; i++) {
+			r ^= gfmul_reference(coefs[i],src[i][pos]);
+		}
+		dst[pos] = r;
+	}
+}
+
+static void ecrs_check_gf(void) {
+	uint32_t a,b;
+	uint8_t coefs[ECRS_MAX_DATA_PARTS];
+	uint8_t ok;
+
+	printf("gf(2^8) - multiplication and inversion\n");
+	ok = 1;
+	for (a=0 ; a<256 ; a++) {
+		for (b=0 ; b<256 ; b++) {
+			if (ecrs_gfmul(a,b)!=gfmul_reference(a,b)) {
+				ok = 0;
+			}
+		}
+		if (a>0 && ecrs_gfmul(a,ecrs_gfinv(a))!=1) {
+			ok = 0;
+		}
+	}
+	mfstest_assert_uint8_eq(ok,1);
+
+	printf("first checksum part is xor of data parts\n");
+	for (a=4 ; a<=8 ; a+=4) {
+		mfstest_assert_int32_eq(ecrs_chksum_coefs(a,0,coefs),0);
+		ok = 1;
+		for (b=0 ; b<a ; b++) {
+			if (coefs[b]!=1) {
+				ok = 0;
+			}
+		}
+		mfstest_assert_uint8_eq(ok,1);
+	}
+	mfstest_assert_int32_eq(ecrs_chksum_coefs(8,ECRS_MAX_CHKSUM_PARTS,coefs),-1);
+	mfstest_assert_int32_eq(ecrs_chksum_coefs(ECRS_MAX_DATA_PARTS+1,0,coefs),-1);
+}
+
+static void ecrs_check_dotprod(uint8_t **src,uint8_t *dst,uint8_t *ref) {
+	uint8_t coefs[ECRS_MAX_PARTS];
+	uint32_t leng,i;
+	uint8_t cnt,off;
+
+	printf("ecrs_dotprod - compare with reference\n");
+	for (cnt=0 ; cnt<=ECRS_MAX_PARTS ; cnt++) {
+		for (i=0 ; i<cnt ; i++) {
+			switch (simple_pseudo_random()%4) {
+				case 0:
+					coefs[i] = 0;
+					break;
+				case 1:
+					coefs[i] = 1;
+					break;
+				default:
+					coefs[i] = simple_pseudo_random();
+			}
+		}
+		for (off=0 ; off<3 ; off++) {
+			leng = TEST_LENG-off*7;
+			dotprod_reference(ref,src,coefs,cnt,leng);
+			ecrs_dotprod(dst+off,(const uint8_t * const *)src,coefs,cnt,leng);
+			mfstest_assert_int32_eq(memcmp(dst+off,ref,leng),0);
+		}
+	}
+
+	printf("ecrs_dotprod_crc - compare with reference\n");
+	for (cnt=0 ; cnt<=ECRS_MAX_PARTS ; cnt++) {
+		for (i=0 ; i<cnt ; i++) {
+			coefs[i] = (cnt&1)?simple_pseudo_random():1;
+		}
+		dotprod_reference(ref,src,coefs,cnt,BENCH_LENG-cnt);
+		mfstest_assert_uint32_eq(ecrs_dotprod_crc(dst,(const uint8_t * const *)src,coefs,cnt,BENCH_LENG-cnt),mycrc32(0,ref,BENCH_LENG-cnt));
+		mfstest_assert_int32_eq(memcmp(dst,ref,BENCH_LENG-cnt),0);
+	}
+
+	printf("ecrs_muladd - compare with reference\n");
+	for (i=0 ; i<8 ; i++) {
+		coefs[0] = 1;
+		coefs[1] = (i<2)?i:simple_pseudo_random();
+		memcpy(dst,src[0],TEST_LENG);
+		dotprod_reference(ref,src,coefs,2,TEST_LENG);
+		ecrs_muladd(dst,src[1],coefs[1],TEST_LENG);
+		mfstest_assert_int32_eq(memcmp(dst,ref,TEST_LENG),0);
+	}
+}
+
+static void ecrs_check_recovery(uint8_t **parts,uint8_t *dst,uint8_t dataparts,uint8_t chksumparts) {
+	uint8_t coefs[ECRS_MAX_DATA_PARTS];
+	uint8_t survivors[ECRS_MAX_DATA_PARTS];
+	uint8_t *survptr[ECRS_MAX_DATA_PARTS];
+	uint32_t mask,allparts,errors,checks;
+	uint8_t i,j,p;
+
+	allparts = dataparts+chksumparts;
+	// checksum parts
+	for (i=0 ; i<chksumparts ; i++) {
+		ecrs_chksum_coefs(dataparts,i,coefs);
+		ecrs_dotprod(parts[dataparts+i],(const uint8_t * const *)parts,coefs,dataparts,TEST_LENG);
+	}
+	// every subset of 'dataparts' parts should be enough to rebuild all other parts
+	errors = 0;
+	checks = 0;
+	for (mask=0 ; mask<(UINT32_C(1)<<allparts) ; mask++) {
+		if (__builtin_popcount(mask)!=dataparts) {
+			continue;
+		}
+		for (i=0,j=0 ; i<allparts ; i++) {
+			if (mask & (UINT32_C(1)<<i)) {
+				survivors[j] = i;
+				survptr[j] = parts[i];
+				j++;
+			}
+		}
+		for (p=0 ; p<allparts ; p++) {
+			if (mask & (UINT32_C(1)<<p)) {
+				continue;
+			}
+			if (ecrs_recover_coefs(dataparts,survivors,p,coefs)<0) {
+				errors++;
+			} else {
+				ecrs_dotprod(dst,(const uint8_t * const *)survptr,coefs,dataparts,TEST_LENG);
+				if (memcmp(dst,parts[p],TEST_LENG)!=0) {
+					errors++;
+				}
+			}
+			checks++;
+		}
+	}
+	printf("EC%u+%u: %u rebuilds\n",dataparts,chksumparts,checks);
+	mfstest_assert_uint32_eq(errors,0);
+}
+
+/* encoding throughput (data MB/s) */
+static double ecrs_bench_encode(uint8_t **parts,uint8_t dataparts,uint8_t chksumparts,double corr) {
+	uint8_t coefs[ECRS_MAX_DATA_PARTS];
+	uint32_t loops,l;
+	uint8_t i;
+	double st,en;
+
+	loops = BENCH_DATA_SIZE / (BENCH_LENG * dataparts);
+	st = monotonic_seconds();
+	for (l=0 ; l<loops ; l++) {
+		for (i=0 ; i<chksumparts ; i++) {
+			ecrs_chksum_coefs(dataparts,i,coefs);
+			ecrs_dotprod(parts[dataparts+i],(const uint8_t * const *)parts,coefs,dataparts,BENCH_LENG);
+		}
+	}
+	en = monotonic_seconds();
+	return ((double)loops*BENCH_LENG*dataparts/(1024.0*1024.0))/((en-st)-corr);
+}
+
+int main(void) {
+	uint8_t *parts[ECRS_MAX_PARTS];
+	uint8_t *dst,*ref;
+	uint32_t i,j;
+	uint8_t engine,bestengine,m;
+	double st,corr;
+
+	for (i=0 ; i<ECRS_MAX_PARTS ; i++) {
+		parts[i] = malloc(BENCH_LENG);
+		if (parts[i]==NULL) {
+			return 99;
+		}
+	}
+	dst = malloc(BENCH_LENG+8);
+	ref = malloc(BENCH_LENG);
+	if (dst==NULL || ref==NULL) {
+		return 99;
+	}
+
+	mfstest_init();
+
+	mycrc32_init();
+	ecrs_init();
+	bestengine = ecrs_engine_current();
+
+	mfstest_start(ecrs);
+
+	for (i=0 ; i<ECRS_MAX_PARTS ; i++) {
+		for (j=0 ; j<BENCH_LENG ; j++) {
+			parts[i][j] = simple_pseudo_random();
+		}
+	}
+
+	ecrs_check_gf();
+
+	for (engine=0 ; engine<ECRS_ENGINES ; engine++) {
+		if (ecrs_engine_select(engine)) {
+			printf("engine: %s\n",ecrs_engine_name(engine));
+			ecrs_check_dotprod(parts,dst,ref);
+			for (m=1 ; m<=4 ; m++) {
+				ecrs_check_recovery(parts,dst,4,m);
+				ecrs_check_recovery(parts,dst,8,m);
+			}
+		}
+	}
+	ecrs_engine_select(bestengine);
+	printf("default engine: %s\n",ecrs_engine_name(bestengine));
+
+	ecrs_check_recovery(parts,dst,4,ECRS_MAX_CHKSUM_PARTS);
+	ecrs_check_recovery(parts,dst,8,ECRS_MAX_CHKSUM_PARTS);
+
+	st = monotonic_seconds();
+	corr = monotonic_seconds();
+	corr -= st;
+
+	printf("encoding throughput (data MB/s)\n");
+	printf("%8s","code");
+	for (engine=0 ; engine<ECRS_ENGINES ; engine++) {
+		if (ecrs_engine_supported(engine)) {
+			printf(" ; %10s",ecrs_engine_name(engine));
+		}
+	}
+	printf("\n");
+	for (i=4 ; i<=8 ; i+=4) {
+		for (m=1 ; m<=4 ; m++) {
+			printf("  EC%"PRIu32"+%"PRIu8,i,m);
+			for (engine=0 ; engine<ECRS_ENGINES ; engine++) {
+				if (ecrs_engine_select(engine)) {
+					printf(" ; %10.2lf",ecrs_bench_encode(parts,i,m,corr));
+				}
+			}
+			printf("\n");
+		}
+	}
+	ecrs_engine_select(bestengine);
+
+	mfstest_end();
+	mfstest_return();
+
+	free(ref);
+	free(dst);
+	for (i=0 ; i<ECRS_MAX_PARTS ; i++) {
+		free(parts[i]);
+	}
+}
@@ -0,0 +1,219 @@
+/*
+ * Copyright (C) 2026 Jakub Kruszona-Zawadzki, Saglabs SA
+ * 
+ * This file is part of MooseFS.
+ * 
+ * MooseFS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 (only).
+ * 
+ * MooseFS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "hashfn.h"
+#include "clocks.h"
+#include "glue.h"
+
+#include "mfstest.h"
+
+#define ELEMENTS 1000000
+#define LOOKUPS 4000000
+
+typedef struct _testentry {
+	uint32_t key;
+	uint32_t hashval;
+	struct _testentry *next;
+} testentry;
+
+/* chained hash (hash_begin.h) */
+
+#define ENTRY_TYPE testentry
+#define GLUE_FN_NAME_PREFIX(Y) GLUE(chtab,Y)
+#define GLUE_HASH_TAB_PREFIX(Y) GLUE(chtab,Y)
+#define HASH_ARGS_TYPE_LIST uint32_t key
+#define HASH_ARGS_LIST key
+
+static inline int chtab_cmp(testentry *e,uint32_t key) {
+	return (e->key==key);
+}
+
+static inline uint32_t chtab_hash(uint32_t key) {
+	return hash32(key);
+}
+
+static inline uint32_t chtab_ehash(testentry *e) {
+	return hash32(e->key);
+}
+
+static inline void chtab_print(testentry *e) {
+	printf("%"PRIu32,e->key);
+}
+
+#include "hash_begin.h"
+#include "hash_end.h"
+
+#undef ENTRY_TYPE
+#undef GLUE_FN_NAME_PREFIX
+#undef GLUE_HASH_TAB_PREFIX
+#undef HASH_ARGS_TYPE_LIST
+#undef HASH_ARGS_LIST
+
+/* open addressing hash (swisshash_begin.h) */
+
+#define ENTRY_TYPE testentry
+#define GLUE_FN_NAME_PREFIX(Y) GLUE(swtab,Y)
+#define GLUE_HASH_TAB_PREFIX(Y) GLUE(swtab,Y)
+#define HASH_ARGS_TYPE_LIST uint32_t key
+#define HASH_ARGS_LIST key
+#define HASH_VALUE_FIELD hashval
+
+static inline int swtab_cmp(testentry *e,uint32_t key) {
+	return (e->key==key);
+}
+
+static inline uint32_t swtab_hash(uint32_t key) {
+	return hash32(key);
+}
+
+#include "swisshash_begin.h"
+#include "swisshash_end.h"
+
+#undef ENTRY_TYPE
+#undef GLUE_FN_NAME_PREFIX
+#undef GLUE_HASH_TAB_PREFIX
+#undef HASH_ARGS_TYPE_LIST
+#undef HASH_ARGS_LIST
+#undef HASH_VALUE_FIELD
+
+static uint32_t lookup_chtab(uint32_t base,uint32_t *found) {
+	uint32_t i,f;
+	f = 0;
+	for (i=0 ; i<LOOKUPS ; i++) {
+		if (chtab_find(base+(i*7919)%ELEMENTS)!=NULL) {
+			f++;
+		}
+	}
+	*found = f;
+	return LOOKUPS;
+}
+
+static uint32_t lookup_swtab(uint32_t base,uint32_t *found) {
+	uint32_t i,f;
+	f = 0;
+	for (i=0 ; i<LOOKUPS ; i++) {
+		if (swtab_find(base+(i*7919)%ELEMENTS)!=NULL) {
+			f++;
+		}
+	}
+	*found = f;
+	return LOOKUPS;
+}
+
+int main(void) {
+	testentry *tab;
+	uint32_t i,found,errors;
+	uint64_t alloc,used;
+	double st,hitch,missch,hitsw,misssw;
+
+	mfstest_init();
+
+	tab = malloc(sizeof(testentry)*ELEMENTS);
+
+	mfstest_start(swisshash);
+
+	swtab_hash_init();
+	for (i=0 ; i<ELEMENTS ; i++) {
+		tab[i].key = i;
+		tab[i].hashval = swtab_hash(i);
+		swtab_add(tab+i);
+	}
+	// growing is incremental, so some of the lookups below are done on both tables
+	errors = 0;
+	for (i=0 ; i<ELEMENTS ; i++) {
+		if (swtab_find(i)!=tab+i) {
+			errors++;
+		}
+	}
+	mfstest_assert_uint32_eq(errors,0);
+	for (i=0 ; i<ELEMENTS ; i+=2) {
+		mfstest_assert_uint8_eq(swtab_delete(tab+i),1);
+	}
+	mfstest_assert_uint8_eq(swtab_delete(tab),0);
+	errors = 0;
+	for (i=0 ; i<ELEMENTS ; i++) {
+		if (swtab_find(i)!=((i&1)?tab+i:NULL)) {
+			errors++;
+		}
+	}
+	mfstest_assert_uint32_eq(errors,0);
+	for (i=0 ; i<ELEMENTS ; i+=2) {
+		swtab_add(tab+i);
+	}
+	for (i=ELEMENTS ; i<2*ELEMENTS ; i++) {
+		if (swtab_find(i)!=NULL) {
+			errors++;
+		}
+	}
+	mfstest_assert_uint32_eq(errors,0);
+	swtab_hash_finish();
+	mfstest_assert_uint8_eq(swtab_hash_stable(),1);
+	swtab_hash_getusage(&alloc,&used);
+	mfstest_assert_uint64_eq(used,(uint64_t)ELEMENTS*(1+sizeof(testentry*)));
+
+	mfstest_end();
+
+	mfstest_start(chained_vs_swisshash);
+
+	chtab_hash_init();
+	for (i=0 ; i<ELEMENTS ; i++) {
+		chtab_add(tab+i);
+	}
+	while (chtab_hash_stable()==0) {
+		chtab_find(0);
+	}
+
+	st = monotonic_seconds();
+	lookup_chtab(0,&found);
+	hitch = LOOKUPS / (monotonic_seconds()-st);
+	mfstest_assert_uint32_eq(found,LOOKUPS);
+	st = monotonic_seconds();
+	lookup_chtab(ELEMENTS,&found);
+	missch = LOOKUPS / (monotonic_seconds()-st);
+	mfstest_assert_uint32_eq(found,0);
+
+	st = monotonic_seconds();
+	lookup_swtab(0,&found);
+	hitsw = LOOKUPS / (monotonic_seconds()-st);
+	mfstest_assert_uint32_eq(found,LOOKUPS);
+	st = monotonic_seconds();
+	lookup_swtab(ELEMENTS,&found);
+	misssw = LOOKUPS / (monotonic_seconds()-st);
+	mfstest_assert_uint32_eq(found,0);
+
+	printf("%10s ; %12s ; %12s ; %10s\n","hash","hits/s","misses/s","bytes/elem");
+	// chained: bucket table + 'next' pointer in every element
+	printf("%10s ; %11.2lfM ; %11.2lfM ; %10.2lf\n","chained",hitch/1e6,missch/1e6,(double)(chtabhashsize*sizeof(testentry*))/ELEMENTS+sizeof(testentry*));
+	printf("%10s ; %11.2lfM ; %11.2lfM ; %10.2lf\n","swiss",hitsw/1e6,misssw/1e6,(double)alloc/ELEMENTS);
+
+	mfstest_end();
+
+	for (i=0 ; i<ELEMENTS ; i++) {
+		chtab_delete(tab+i);
+	}
+	chtab_hash_cleanup();
+	swtab_hash_cleanup();
+	free(tab);
+
+	mfstest_return();
+}
@@ -0,0 +1,252 @@
+/*
+ * Copyright (C) 2026 Jakub Kruszona-Zawadzki, Saglabs SA
+ * 
+ * This file is part of MooseFS.
+ * 
+ * MooseFS is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 2 (only).
+ * 
+ * MooseFS is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see
+ * <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "clocks.h"
+#include "crc.h"
+#include "xordata.h"
+
+#include "mfstest.h"
+
+#define MAX_SOURCES 17
+#define TEST_LENG (3*4096+77)
+
+uint32_t simple_pseudo_random(void) {
+	static uint32_t u=1249853491;
+	static uint32_t v=3456394786;
+
+	v = 36969*(v & 65535) + (v >> 16);
+	u = 18000*(u & 65535) + (u >> 16);
+
+	return (v << 16) + u;
+}
+
+static void xor_reference(uint8_t *dst,uint8_t **src,uint8_t cnt,uint32_t leng) {
+	uint32_t pos;
+	uint8_t i;
+
+	memset(dst,0,leng);
+	for (i=0 ; i<cnt ; i++) {
+		for (pos=0 ; pos<leng ; pos++) {
+			dst[pos] ^= src[i][pos];
+		}
+	}
+}
+
+/* byte by byte / 4-byte words version used before - for comparison only */
+static void xordata_legacy(uint8_t *dst,const uint8_t *src,uint32_t leng) {
+	uint32_t *dst4;
+	const uint32_t *src4;
+	if (((unsigned long)dst&3)==((unsigned long)src&3)) {
+		while (leng && ((unsigned long)src & 3)) {
+			(*dst++)^=(*src++);
+			leng--;
+		}
+		dst4 = (uint32_t*)dst;
+		src4 = (const uint32_t*)src;
+		while (leng>=4) {
+			(*dst4++)^=(*src4++);
+			leng-=4;
+		}
+		src = (const uint8_t*)src4;
+		dst = (uint8_t*)dst4;
+	}
+	while (leng) {
+		(*dst++)^=(*src++);
+		leng--;
+	}
+}
+
+static void xordata_check(uint8_t **src,uint8_t *dst,uint8_t *ref) {
+	uint8_t *tsrc[MAX_SOURCES];
+	uint32_t leng,crc;
+	uint8_t cnt,i,doff,soff;
+
+	printf("xordata - unaligned buffers\n");
+	for (doff=0 ; doff<8 ; doff++) {
+		for (soff=0 ; soff<8 ; soff++) {
+			leng = TEST_LENG-doff-soff;
+			memcpy(dst+doff,src[0],leng);
+			tsrc[0] = src[0];
+			tsrc[1] = src[1]+soff;
+			xor_reference(ref,tsrc,2,leng);
+			xordata(dst+doff,src[1]+soff,leng);
+			mfstest_assert_int32_eq(memcmp(dst+doff,ref,leng),0);
+		}
+	}
+
+	printf("xordata_multi - compare with reference\n");
+	for (cnt=0 ; cnt<=MAX_SOURCES ; cnt++) {
+		for (doff=0 ; doff<3 ; doff++) {
+			leng = TEST_LENG-doff*5;
+			for (i=0 ; i<cnt ; i++) {
+				tsrc[i] = src[i]+((i+doff)&7);
+			}
+			xor_reference(ref,tsrc,cnt,leng);
+			xordata_multi(dst+doff,(const uint8_t * const *)tsrc,cnt,leng);
+			mfstest_assert_int32_eq(memcmp(dst+doff,ref,leng),0);
+		}
+	}
+
+	printf("xordata_multi - destination is one of sources\n");
+	memcpy(dst,src[0],TEST_LENG);
+	tsrc[0] = src[1];
+	tsrc[1] = dst;
+	tsrc[2] = src[2];
+	xor_reference(ref,src,3,TEST_LENG);
+	xordata_multi(dst,(const uint8_t * const *)tsrc,3,TEST_LENG);
+	mfstest_assert_int32_eq(memcmp(dst,ref,TEST_LENG),0);
+
+	printf("xordata_multi_crc - compare with separate xor and crc\n");
+	for (cnt=0 ; cnt<=MAX_SOURCES ; cnt+=4) {
+		for (doff=0 ; doff<3 ; doff++) {
+			leng = TEST_LENG-doff*4099;
+			xor_reference(ref,src,cnt,leng);
+			crc = xordata_multi_crc(0,dst+doff,(const uint8_t * const *)src,cnt,leng);
+			mfstest_assert_int32_eq(memcmp(dst+doff,ref,leng),0);
+			mfstest_assert_uint32_eq(crc,mycrc32(0,ref,leng));
+		}
+	}
+}
+
+#define BENCH_LENG 65536
+#define BENCH_DATA_SIZE (256*1024*1024)
+
+/* xor of 'cnt' blocks (as in EC recovery) - throughput in source MB/s */
+static double xordata_bench(uint8_t **src,uint8_t *dst,uint8_t cnt,uint8_t off,uint8_t mode,double corr) {
+	const uint8_t *tsrc[MAX_SOURCES];
+	uint32_t loops,l,crc;
+	uint8_t i;
+	double st,en;
+
+	for (i=0 ; i<cnt ; i++) {
+		tsrc[i] = src[i]+off;
+	}
+	loops = BENCH_DATA_SIZE / (BENCH_LENG * cnt);
+	crc = 0;
+	st = monotonic_seconds();
+	for (l=0 ; l<loops ; l++) {
+		switch (mode) {
+			case 0: // legacy - copy and xor one by one
+				memcpy(dst,tsrc[0],BENCH_LENG);
+				for (i=1 ; i<cnt ; i++) {
+					xordata_legacy(dst,tsrc[i],BENCH_LENG);
+				}
+				break;
+			case 1:
+				xordata_multi(dst,tsrc,cnt,BENCH_LENG);
+				break;
+			case 2:
+				xordata_multi(dst,tsrc,cnt,BENCH_LENG);
+				crc ^= mycrc32(0,dst,BENCH_LENG);
+				break;
+			case 3:
+				crc ^= xordata_multi_crc(0,dst,tsrc,cnt,BENCH_LENG);
+				break;
+		}
+	}
+	en = monotonic_seconds();
+	dst[0] ^= crc; // prevent optimizing out crc calculation
+	return ((double)loops*BENCH_LENG*cnt/(1024.0*1024.0))/((en-st)-corr);
+}
+
+int main(void) {
+	uint8_t *src[MAX_SOURCES];
+	uint8_t *dst,*ref;
+	uint32_t i,j;
+	uint8_t engine,bestengine,cnt,off;
+	double st,corr;
+
+	for (i=0 ; i<MAX_SOURCES ; i++) {
+		src[i] = malloc(BENCH_LENG+8);
+		if (src[i]==NULL) {
+			return 99;
+		}
+	}
+	dst = malloc(BENCH_LENG+8);
+	ref = malloc(BENCH_LENG);
+	if (dst==NULL || ref==NULL) {
+		return 99;
+	}
+
+	mfstest_init();
+
+	mycrc32_init();
+	xordata_init();
+	bestengine = xordata_engine_current();
+
+	mfstest_start(xordata);
+
+	for (i=0 ; i<MAX_SOURCES ; i++) {
+		for (j=0 ; j<BENCH_LENG+8 ; j++) {
+			src[i][j] = simple_pseudo_random();
+		}
+	}
+
+	for (engine=0 ; engine<XORDATA_ENGINES ; engine++) {
+		if (xordata_engine_select(engine)) {
+			printf("engine: %s\n",xordata_engine_name(engine));
+			xordata_check(src,dst,ref);
+		}
+	}
+	xordata_engine_select(bestengine);
+	printf("default engine: %s\n",xordata_engine_name(bestengine));
+
+	st = monotonic_seconds();
+	corr = monotonic_seconds();
+	corr -= st;
+
+	printf("xor throughput (source MB/s)\n");
+	printf("%20s ; %10s","sources","legacy");
+	for (engine=0 ; engine<XORDATA_ENGINES ; engine++) {
+		if (xordata_engine_supported(engine)) {
+			printf(" ; %10s",xordata_engine_name(engine));
+		}
+	}
+	printf("\n");
+	for (cnt=4 ; cnt<=8 ; cnt+=4) {
+		for (off=0 ; off<2 ; off++) {
+			printf("%3u blocks %9s ; %10.2lf",cnt,off?"unaligned":"aligned",xordata_bench(src,dst+off,cnt,off,0,corr));
+			for (engine=0 ; engine<XORDATA_ENGINES ; engine++) {
+				if (xordata_engine_select(engine)) {
+					printf(" ; %10.2lf",xordata_bench(src,dst+off,cnt,off,1,corr));
+				}
+			}
+			printf("\n");
+		}
+	}
+	xordata_engine_select(bestengine);
+
+	printf("xor + crc throughput (source MB/s, engine: %s)\n",xordata_engine_name(bestengine));
+	for (cnt=4 ; cnt<=8 ; cnt+=4) {
+		printf("%3u blocks ; separate: %10.2lf ; fused: %10.2lf\n",cnt,xordata_bench(src,dst,cnt,0,2,corr),xordata_bench(src,dst,cnt,0,3,corr));
+	}
+
+	mfstest_end();
+	mfstest_return();
+
+	free(ref);
+	free(dst);
+	for (i=0 ; i<MAX_SOURCES ; i++) {
+		free(src[i]);
+	}
+}